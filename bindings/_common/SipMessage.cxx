@@ -258,6 +258,7 @@ const tsip_header_t* SipMessage::getSipHeader(const char* name, unsigned index /
     }
 
 
+    tsip_message_parse_lazy_headers(m_pSipMessage); // headers not parsed by the transport layer
     tsk_list_foreach(item, m_pSipMessage->headers) {
         if(tsk_striequals(tsip_header_get_name_2(TSIP_HEADER(item->data)), name)) {
             if(pos++ >= index) {
@@ -0,0 +1,75 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tdav_audio_kernels.h
+ * @brief Audio kernels used on every frame (G.711, gain, sample format and channels conversion).
+ *
+ * The kernels are vectorized (SSE2, AVX2 or NEON) when the CPU supports it. The best implementation is selected at runtime, the first time
+ * one of the kernels is used (or when @ref tdav_init() is called), with a portable C fallback.
+ */
+#ifndef TINYDAV_AUDIO_KERNELS_H
+#define TINYDAV_AUDIO_KERNELS_H
+
+#include "tinydav_config.h"
+
+#include "tsk_common.h"
+
+TDAV_BEGIN_DECLS
+
+typedef enum tdav_audio_kernels_isa_e {
+    tdav_audio_kernels_isa_auto, /* best supported by the CPU */
+    tdav_audio_kernels_isa_c,
+    tdav_audio_kernels_isa_sse2,
+    tdav_audio_kernels_isa_avx2,
+    tdav_audio_kernels_isa_neon,
+}
+tdav_audio_kernels_isa_t;
+
+TINYDAV_API int tdav_audio_kernels_init();
+TINYDAV_API int tdav_audio_kernels_select(tdav_audio_kernels_isa_t isa);
+TINYDAV_API const char* tdav_audio_kernels_get_name();
+
+/* G.711 (table-driven, bit-exact with linear2ulaw(), ulaw2linear(), linear2alaw() and alaw2linear()) */
+TINYDAV_API void tdav_audio_g711u_encode(uint8_t* out, const int16_t* in, tsk_size_t count);
+TINYDAV_API void tdav_audio_g711u_decode(int16_t* out, const uint8_t* in, tsk_size_t count);
+TINYDAV_API void tdav_audio_g711a_encode(uint8_t* out, const int16_t* in, tsk_size_t count);
+TINYDAV_API void tdav_audio_g711a_decode(int16_t* out, const uint8_t* in, tsk_size_t count);
+
+/* Multiplies the samples by 2^gain, saturating to [-32768, 32767] */
+TINYDAV_API void tdav_audio_gain_apply_s16(int16_t* buffer, tsk_size_t count, int32_t gain);
+
+/* Sample format conversion. The floats are not normalized: [-32768.f, 32767.f] (as expected by the resamplers). */
+TINYDAV_API void tdav_audio_s16_to_float(float* out, const int16_t* in, tsk_size_t count);
+TINYDAV_API void tdav_audio_float_to_s16(int16_t* out, const float* in, tsk_size_t count);
+
+/* Channels conversion. "frames" is the number of samples per channel. "in" and "out" must not overlap. */
+TINYDAV_API void tdav_audio_stereo_to_mono_s16(int16_t* out, const int16_t* in, tsk_size_t frames);
+TINYDAV_API void tdav_audio_mono_to_stereo_s16(int16_t* out, const int16_t* in, tsk_size_t frames);
+
+/* Mixing. The sum is accumulated on 32 bits and saturated once, when the output is computed. */
+TINYDAV_API uint64_t tdav_audio_energy_s16(const int16_t* in, tsk_size_t count); /* sum of the squares */
+TINYDAV_API void tdav_audio_mix_accumulate_s16(int32_t* acc, const int16_t* in, tsk_size_t count); /* acc += in */
+TINYDAV_API void tdav_audio_mix_minus_s16(int16_t* out, const int32_t* acc, const int16_t* own, tsk_size_t count); /* out = SAT16(acc - own), "own" is optional */
+
+TDAV_END_DECLS
+
+#endif /* TINYDAV_AUDIO_KERNELS_H */
@@ -0,0 +1,121 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tdav_audio_mixer.h
+ * @brief N-way audio conference mixer.
+ *
+ * Every "ptime" milliseconds the mixer pulls one decoded frame from each participant, selects the loudest participants (active speakers),
+ * mixes them and pushes to each participant the mix without its own voice ("mix-minus"). Only the active speakers are mixed which means
+ * the cost doesn't grow with the number of listeners.
+ *
+ * Audio sessions are added using @ref tdav_audio_mixer_add_session(): the frames are pulled from the session's consumer (jitter buffer) and pushed
+ * to the session's encoder (producer callback). The sessions should use the mixer consumer and producer (no sound card), registered using
+ * @ref tdav_audio_mixer_plugins_register().
+ */
+#ifndef TINYDAV_AUDIO_MIXER_H
+#define TINYDAV_AUDIO_MIXER_H
+
+#include "tinydav_config.h"
+
+#include "tinymedia/tmedia_consumer.h"
+#include "tinymedia/tmedia_producer.h"
+
+#include "tsk_list.h"
+#include "tsk_thread.h"
+#include "tsk_safeobj.h"
+
+TDAV_BEGIN_DECLS
+
+#if !defined(TDAV_AUDIO_MIXER_MAX_SPEAKERS)
+#	define TDAV_AUDIO_MIXER_MAX_SPEAKERS	3
+#endif
+#if !defined(TDAV_AUDIO_MIXER_SILENCE_LEVEL)
+#	define TDAV_AUDIO_MIXER_SILENCE_LEVEL	1024 /* mean square, ~ -50 dBFS */
+#endif
+
+struct tmedia_session_s;
+
+// Pulls one frame (16-bit mono samples). Returns the number of bytes copied (missing samples are considered as silence).
+typedef tsk_size_t (*tdav_audio_mixer_pull_cb_f)(const void* usrdata, void* buffer, tsk_size_t size);
+// Pushes the mix for this participant
+typedef int (*tdav_audio_mixer_push_cb_f)(const void* usrdata, const void* buffer, tsk_size_t size);
+
+typedef struct tdav_audio_mixer_participant_s {
+    TSK_DECLARE_OBJECT;
+
+    uint64_t id;
+    tdav_audio_mixer_pull_cb_f pull;
+    tdav_audio_mixer_push_cb_f push;
+    const void* usrdata;
+    struct tmedia_session_s* session; // set if added using tdav_audio_mixer_add_session()
+
+    int16_t* frame; // last frame pulled
+    uint64_t level; // smoothed energy (mean square)
+    tsk_bool_t speaking;
+}
+tdav_audio_mixer_participant_t;
+typedef tsk_list_t tdav_audio_mixer_participants_L_t;
+
+typedef struct tdav_audio_mixer_s {
+    TSK_DECLARE_OBJECT;
+
+    uint32_t rate;
+    uint32_t ptime;
+    uint32_t frame_samples;
+    uint32_t max_speakers;
+
+    tdav_audio_mixer_participants_L_t* participants;
+    tdav_audio_mixer_participant_t** speakers;
+    uint32_t speakers_count;
+
+    int32_t* acc; // sum of the active speakers
+    int16_t* mix; // mix sent to the listeners
+    int16_t* mix_minus; // mix sent to an active speaker
+
+    tsk_thread_handle_t* tid[1];
+    tsk_bool_t started;
+    uint64_t ticks;
+
+    TSK_DECLARE_SAFEOBJ;
+}
+tdav_audio_mixer_t;
+
+TINYDAV_API tdav_audio_mixer_t* tdav_audio_mixer_create(uint32_t rate, uint32_t ptime, uint32_t max_speakers);
+TINYDAV_API int tdav_audio_mixer_add_participant(tdav_audio_mixer_t* self, uint64_t id, tdav_audio_mixer_pull_cb_f pull, tdav_audio_mixer_push_cb_f push, const void* usrdata);
+TINYDAV_API int tdav_audio_mixer_add_session(tdav_audio_mixer_t* self, struct tmedia_session_s* session);
+TINYDAV_API int tdav_audio_mixer_remove_participant(tdav_audio_mixer_t* self, uint64_t id);
+TINYDAV_API tsk_size_t tdav_audio_mixer_get_participants_count(tdav_audio_mixer_t* self);
+TINYDAV_API tsk_bool_t tdav_audio_mixer_is_speaking(tdav_audio_mixer_t* self, uint64_t id);
+TINYDAV_API int tdav_audio_mixer_process(tdav_audio_mixer_t* self);
+TINYDAV_API int tdav_audio_mixer_start(tdav_audio_mixer_t* self);
+TINYDAV_API int tdav_audio_mixer_stop(tdav_audio_mixer_t* self);
+
+TINYDAV_API int tdav_audio_mixer_plugins_register();
+
+TINYDAV_GEXTERN const tsk_object_def_t *tdav_audio_mixer_def_t;
+TINYDAV_GEXTERN const tsk_object_def_t *tdav_audio_mixer_participant_def_t;
+TINYDAV_GEXTERN const tmedia_consumer_plugin_def_t *tdav_consumer_audio_mixer_plugin_def_t;
+TINYDAV_GEXTERN const tmedia_producer_plugin_def_t *tdav_producer_audio_mixer_plugin_def_t;
+
+TDAV_END_DECLS
+
+#endif /* TINYDAV_AUDIO_MIXER_H */
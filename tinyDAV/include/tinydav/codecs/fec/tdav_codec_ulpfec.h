@@ -35,9 +35,23 @@ TDAV_BEGIN_DECLS
 struct tdav_codec_ulpfec_s;
 struct trtp_rtp_packet_s;
 
+/** callback for recovered media packets */
+typedef int (*tdav_codec_ulpfec_rtppacket_cb_f)(const void* callback_data, const struct trtp_rtp_packet_s* packet);
+
+typedef struct tdav_codec_ulpfec_stats_s {
+    uint64_t media_count; // number of media packets received
+    uint64_t fec_count; // number of FEC packets received
+    uint64_t recovered_count; // number of media packets recovered using the FEC packets
+    uint64_t unrecoverable_count; // number of FEC packets dropped before all their media packets were received or recovered
+}
+tdav_codec_ulpfec_stats_t;
+
 int tdav_codec_ulpfec_enc_reset(struct tdav_codec_ulpfec_s* self);
 int tdav_codec_ulpfec_enc_protect(struct tdav_codec_ulpfec_s* self, const struct trtp_rtp_packet_s* rtp_packet);
 tsk_size_t tdav_codec_ulpfec_enc_serialize(const struct tdav_codec_ulpfec_s* self, void** out_data, tsk_size_t* out_max_size);
+int tdav_codec_ulpfec_set_callback(struct tdav_codec_ulpfec_s* self, tdav_codec_ulpfec_rtppacket_cb_f callback, const void* callback_data);
+int tdav_codec_ulpfec_dec_put(struct tdav_codec_ulpfec_s* self, const struct trtp_rtp_packet_s* rtp_packet);
+int tdav_codec_ulpfec_dec_get_stats(const struct tdav_codec_ulpfec_s* self, tdav_codec_ulpfec_stats_t* stats);
 
 TINYDAV_GEXTERN const tmedia_codec_plugin_def_t *tdav_codec_ulpfec_plugin_def_t;
 
@@ -52,6 +52,8 @@ typedef struct tdav_session_av_s {
     tsk_bool_t is_fb_nack_neg; // a=rtcp-fb:* nack
     tsk_bool_t is_fb_googremb_neg; // a=rtcp-fb:* goog-remb
     tsk_bool_t is_fb_doubsjcng_neg; // a=rtcp-fb:* doubs-jcng
+    tsk_bool_t is_fb_twcc_neg; // a=rtcp-fb:* transport-cc
+    uint8_t twcc_ext_id; // a=extmap:<id> draft-holmer-rmcat-transport-wide-cc-extensions-01 (zero if not negotiated)
     tsk_bool_t use_srtp;
     tsk_bool_t is_webrtc2sip_mode_enabled;
     uint32_t rtp_ssrc;
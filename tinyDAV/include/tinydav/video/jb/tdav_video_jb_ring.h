@@ -0,0 +1,60 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango(DOT)org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tdav_video_jb_ring.h
+ * @brief Video Jitter Buffer using a ring of slots indexed by RTP sequence number
+ *
+ * Alternative to "tdav_video_jb" with the same callbacks: O(1) insertion and lookup, the packets are copied into
+ * preallocated slots (no allocation per packet or per frame) and delivered to the decoder as views over these slots.
+ */
+#ifndef TINYDAV_VIDEO_JB_RING_H
+#define TINYDAV_VIDEO_JB_RING_H
+
+#include "tinydav_config.h"
+
+#include "tinydav/video/jb/tdav_video_jb.h"
+
+TDAV_BEGIN_DECLS
+
+typedef struct tdav_video_jb_ring_stats_s {
+    uint64_t pkts_received; // number of packets stored
+    uint64_t pkts_dup; // number of duplicated packets
+    uint64_t pkts_late; // number of packets received after their frame was decoded
+    uint64_t pkts_lost; // number of packets missing when their frame was decoded
+    uint64_t pkts_nacked; // number of sequence numbers signaled as lost (RTCP-NACK)
+    uint64_t frames_decoded; // number of frames sent to the decoder
+    uint64_t frames_incomplete; // number of frames sent to the decoder with missing packets
+    uint64_t resets; // number of times the ring overflowed and was flushed
+}
+tdav_video_jb_ring_stats_t;
+
+struct tdav_video_jb_ring_s* tdav_video_jb_ring_create();
+int tdav_video_jb_ring_set_callback(struct tdav_video_jb_ring_s* self, tdav_video_jb_cb_f callback, const void* usr_data);
+int tdav_video_jb_ring_get_qcong(struct tdav_video_jb_ring_s* self, float* q);
+int tdav_video_jb_ring_get_stats(struct tdav_video_jb_ring_s* self, tdav_video_jb_ring_stats_t* stats);
+int tdav_video_jb_ring_start(struct tdav_video_jb_ring_s* self);
+int tdav_video_jb_ring_put(struct tdav_video_jb_ring_s* self, const struct trtp_rtp_packet_s* rtp_pkt);
+int tdav_video_jb_ring_stop(struct tdav_video_jb_ring_s* self);
+
+TDAV_END_DECLS
+
+#endif /* TINYDAV_VIDEO_JB_RING_H */
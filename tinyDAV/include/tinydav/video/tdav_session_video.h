@@ -47,6 +47,7 @@ typedef struct tdav_session_video_s {
     TDAV_DECLARE_SESSION_AV;
 
     struct tdav_video_jb_s* jb;
+    struct tdav_video_jb_ring_s* jb_ring; // alternative to "jb" (see "tmedia_defaults_set_videojb_ring_enabled()")
     tsk_bool_t jb_enabled;
     tsk_bool_t zero_artifacts;
     tsk_bool_t fps_changed;
@@ -135,6 +136,12 @@ typedef struct tdav_session_video_s {
 	float qavg_lowest;
 	signed num_enc_avg_time_high;
 
+    // send-side bandwidth estimation (transport-wide congestion control)
+    struct {
+        int32_t bw_kbps; // last target applied to the encoder, zero if none
+        uint64_t time; // last feedback
+    } twcc;
+
 }
 tdav_session_video_t;
 
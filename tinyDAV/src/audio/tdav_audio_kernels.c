@@ -0,0 +1,766 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tdav_audio_kernels.c
+ * @brief Audio kernels used on every frame (G.711, gain, sample format and channels conversion).
+ */
+#include "tinydav/audio/tdav_audio_kernels.h"
+
+#include "tinydav/codecs/g711/g711.h"
+
+#include "tsk_debug.h"
+
+#if !defined(TDAV_AUDIO_KERNELS_HAVE_SSE2)
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define TDAV_AUDIO_KERNELS_HAVE_SSE2	1
+#	else
+#		define TDAV_AUDIO_KERNELS_HAVE_SSE2	0
+#	endif
+#endif /* TDAV_AUDIO_KERNELS_HAVE_SSE2 */
+
+// AVX2 code is compiled using the "target" attribute (no need for "-mavx2") and only used if the CPU supports it
+#if !defined(TDAV_AUDIO_KERNELS_HAVE_AVX2)
+#	if TDAV_AUDIO_KERNELS_HAVE_SSE2 && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#		define TDAV_AUDIO_KERNELS_HAVE_AVX2	1
+#	else
+#		define TDAV_AUDIO_KERNELS_HAVE_AVX2	0
+#	endif
+#endif /* TDAV_AUDIO_KERNELS_HAVE_AVX2 */
+
+#if !defined(TDAV_AUDIO_KERNELS_HAVE_NEON)
+#	if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(_M_ARM64)
+#		define TDAV_AUDIO_KERNELS_HAVE_NEON	1
+#	else
+#		define TDAV_AUDIO_KERNELS_HAVE_NEON	0
+#	endif
+#endif /* TDAV_AUDIO_KERNELS_HAVE_NEON */
+
+#if TDAV_AUDIO_KERNELS_HAVE_SSE2
+#	include <emmintrin.h>
+#endif
+#if TDAV_AUDIO_KERNELS_HAVE_AVX2
+#	include <immintrin.h>
+#	define TDAV_AUDIO_KERNELS_AVX2_FUN __attribute__((target("avx2")))
+#endif
+#if TDAV_AUDIO_KERNELS_HAVE_NEON
+#	include <arm_neon.h>
+#endif
+
+#define TDAV_AUDIO_SAT16(v) ((int16_t)((v) > 32767 ? 32767 : ((v) < -32768 ? -32768 : (v))))
+
+typedef struct tdav_audio_kernels_s {
+    const char* name;
+    tdav_audio_kernels_isa_t isa;
+    void (*gain_apply_s16)(int16_t* buffer, tsk_size_t count, int32_t gain);
+    void (*s16_to_float)(float* out, const int16_t* in, tsk_size_t count);
+    void (*float_to_s16)(int16_t* out, const float* in, tsk_size_t count);
+    void (*stereo_to_mono_s16)(int16_t* out, const int16_t* in, tsk_size_t frames);
+    void (*mono_to_stereo_s16)(int16_t* out, const int16_t* in, tsk_size_t frames);
+    uint64_t (*energy_s16)(const int16_t* in, tsk_size_t count);
+    void (*mix_accumulate_s16)(int32_t* acc, const int16_t* in, tsk_size_t count);
+    void (*mix_minus_s16)(int16_t* out, const int32_t* acc, const int16_t* own, tsk_size_t count);
+}
+tdav_audio_kernels_t;
+
+static const tdav_audio_kernels_t* __kernels = tsk_null;
+
+// G.711 tables: the encoders only use the 14 (u-law) or 13 (A-law) most significant bits
+static uint8_t __g711u_enc_table[1 << 14];
+static uint8_t __g711a_enc_table[1 << 13];
+static int16_t __g711u_dec_table[256];
+static int16_t __g711a_dec_table[256];
+static volatile tsk_bool_t __g711_tables_ready = tsk_false;
+
+#define TDAV_AUDIO_KERNELS_ENSURE() if (!__kernels) tdav_audio_kernels_select(tdav_audio_kernels_isa_auto)
+#define TDAV_AUDIO_G711_ENSURE() if (!__g711_tables_ready) _tdav_audio_g711_tables_build()
+
+static void _tdav_audio_g711_tables_build()
+{
+    // Concurrent calls write the same values: no lock needed
+    int32_t i;
+    for (i = 0; i < (1 << 14); ++i) {
+        __g711u_enc_table[i] = linear2ulaw((short)(uint16_t)(i << 2));
+    }
+    for (i = 0; i < (1 << 13); ++i) {
+        __g711a_enc_table[i] = linear2alaw((short)(uint16_t)(i << 3));
+    }
+    for (i = 0; i < 256; ++i) {
+        __g711u_dec_table[i] = ulaw2linear((unsigned char)i);
+        __g711a_dec_table[i] = alaw2linear((unsigned char)i);
+    }
+    __g711_tables_ready = tsk_true;
+}
+
+/* ============ C ================= */
+
+static void _tdav_audio_gain_apply_s16_c(int16_t* buffer, tsk_size_t count, int32_t gain)
+{
+    tsk_size_t i;
+    const int32_t factor = (1 << gain);
+    for (i = 0; i < count; ++i) {
+        const int32_t v = buffer[i] * factor;
+        buffer[i] = TDAV_AUDIO_SAT16(v);
+    }
+}
+
+static void _tdav_audio_s16_to_float_c(float* out, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i;
+    for (i = 0; i < count; ++i) {
+        out[i] = (float)in[i];
+    }
+}
+
+static void _tdav_audio_float_to_s16_c(int16_t* out, const float* in, tsk_size_t count)
+{
+    tsk_size_t i;
+    for (i = 0; i < count; ++i) {
+        const float v = in[i];
+        out[i] = (v >= 32767.f) ? 32767 : ((v <= -32768.f) ? -32768 : (int16_t)(v + (v >= 0.f ? 0.5f : -0.5f)));
+    }
+}
+
+static void _tdav_audio_stereo_to_mono_s16_c(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i;
+    for (i = 0; i < frames; ++i) {
+        out[i] = (int16_t)((in[(i << 1)] + in[(i << 1) + 1]) >> 1);
+    }
+}
+
+static void _tdav_audio_mono_to_stereo_s16_c(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i;
+    for (i = 0; i < frames; ++i) {
+        out[(i << 1)] = out[(i << 1) + 1] = in[i];
+    }
+}
+
+static uint64_t _tdav_audio_energy_s16_c(const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i;
+    uint64_t energy = 0;
+    for (i = 0; i < count; ++i) {
+        energy += (uint32_t)(in[i] * in[i]);
+    }
+    return energy;
+}
+
+static void _tdav_audio_mix_accumulate_s16_c(int32_t* acc, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i;
+    for (i = 0; i < count; ++i) {
+        acc[i] += in[i];
+    }
+}
+
+static void _tdav_audio_mix_minus_s16_c(int16_t* out, const int32_t* acc, const int16_t* own, tsk_size_t count)
+{
+    tsk_size_t i;
+    if (own) {
+        for (i = 0; i < count; ++i) {
+            const int32_t v = acc[i] - own[i];
+            out[i] = TDAV_AUDIO_SAT16(v);
+        }
+    }
+    else {
+        for (i = 0; i < count; ++i) {
+            out[i] = TDAV_AUDIO_SAT16(acc[i]);
+        }
+    }
+}
+
+static const tdav_audio_kernels_t __kernels_c = {
+    "c",
+    tdav_audio_kernels_isa_c,
+    _tdav_audio_gain_apply_s16_c,
+    _tdav_audio_s16_to_float_c,
+    _tdav_audio_float_to_s16_c,
+    _tdav_audio_stereo_to_mono_s16_c,
+    _tdav_audio_mono_to_stereo_s16_c,
+    _tdav_audio_energy_s16_c,
+    _tdav_audio_mix_accumulate_s16_c,
+    _tdav_audio_mix_minus_s16_c,
+};
+
+/* ============ SSE2 ================= */
+
+#if TDAV_AUDIO_KERNELS_HAVE_SSE2
+
+static void _tdav_audio_gain_apply_s16_sse2(int16_t* buffer, tsk_size_t count, int32_t gain)
+{
+    tsk_size_t i = 0;
+    const __m128i shift = _mm_cvtsi32_si128(gain);
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&buffer[i]);
+        __m128i lo = _mm_sll_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), shift);
+        __m128i hi = _mm_sll_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16), shift);
+        _mm_storeu_si128((__m128i*)&buffer[i], _mm_packs_epi32(lo, hi));
+    }
+    _tdav_audio_gain_apply_s16_c(&buffer[i], (count - i), gain);
+}
+
+static void _tdav_audio_s16_to_float_sse2(float* out, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&in[i]);
+        _mm_storeu_ps(&out[i], _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)));
+        _mm_storeu_ps(&out[i + 4], _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)));
+    }
+    _tdav_audio_s16_to_float_c(&out[i], &in[i], (count - i));
+}
+
+static void _tdav_audio_float_to_s16_sse2(int16_t* out, const float* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    // clamped before the conversion: out of range values are converted to INT_MIN
+    const __m128 min = _mm_set1_ps(-32768.f), max = _mm_set1_ps(32767.f);
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&in[i]), min), max));
+        __m128i hi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&in[i + 4]), min), max));
+        _mm_storeu_si128((__m128i*)&out[i], _mm_packs_epi32(lo, hi));
+    }
+    _tdav_audio_float_to_s16_c(&out[i], &in[i], (count - i));
+}
+
+static void _tdav_audio_stereo_to_mono_s16_sse2(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i = 0;
+    const __m128i ones = _mm_set1_epi16(1);
+    for (; i + 8 <= frames; i += 8) {
+        __m128i lo = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i*)&in[(i << 1)]), ones), 1);
+        __m128i hi = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i*)&in[(i << 1) + 8]), ones), 1);
+        _mm_storeu_si128((__m128i*)&out[i], _mm_packs_epi32(lo, hi));
+    }
+    _tdav_audio_stereo_to_mono_s16_c(&out[i], &in[(i << 1)], (frames - i));
+}
+
+static void _tdav_audio_mono_to_stereo_s16_sse2(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&in[i]);
+        _mm_storeu_si128((__m128i*)&out[(i << 1)], _mm_unpacklo_epi16(x, x));
+        _mm_storeu_si128((__m128i*)&out[(i << 1) + 8], _mm_unpackhi_epi16(x, x));
+    }
+    _tdav_audio_mono_to_stereo_s16_c(&out[(i << 1)], &in[i], (frames - i));
+}
+
+static uint64_t _tdav_audio_energy_s16_sse2(const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    uint64_t energy[2];
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&in[i]);
+        __m128i sq = _mm_madd_epi16(x, x); // up to 2^31: unsigned
+        sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(sq, zero), _mm_unpackhi_epi32(sq, zero)));
+    }
+    _mm_storeu_si128((__m128i*)energy, sum);
+    return energy[0] + energy[1] + _tdav_audio_energy_s16_c(&in[i], (count - i));
+}
+
+static void _tdav_audio_mix_accumulate_s16_sse2(int32_t* acc, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&in[i]);
+        _mm_storeu_si128((__m128i*)&acc[i], _mm_add_epi32(_mm_loadu_si128((const __m128i*)&acc[i]), _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)));
+        _mm_storeu_si128((__m128i*)&acc[i + 4], _mm_add_epi32(_mm_loadu_si128((const __m128i*)&acc[i + 4]), _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)));
+    }
+    _tdav_audio_mix_accumulate_s16_c(&acc[i], &in[i], (count - i));
+}
+
+static void _tdav_audio_mix_minus_s16_sse2(int16_t* out, const int32_t* acc, const int16_t* own, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)&acc[i]);
+        __m128i hi = _mm_loadu_si128((const __m128i*)&acc[i + 4]);
+        if (own) {
+            __m128i x = _mm_loadu_si128((const __m128i*)&own[i]);
+            lo = _mm_sub_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+            hi = _mm_sub_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+        }
+        _mm_storeu_si128((__m128i*)&out[i], _mm_packs_epi32(lo, hi));
+    }
+    _tdav_audio_mix_minus_s16_c(&out[i], &acc[i], own ? &own[i] : tsk_null, (count - i));
+}
+
+static const tdav_audio_kernels_t __kernels_sse2 = {
+    "sse2",
+    tdav_audio_kernels_isa_sse2,
+    _tdav_audio_gain_apply_s16_sse2,
+    _tdav_audio_s16_to_float_sse2,
+    _tdav_audio_float_to_s16_sse2,
+    _tdav_audio_stereo_to_mono_s16_sse2,
+    _tdav_audio_mono_to_stereo_s16_sse2,
+    _tdav_audio_energy_s16_sse2,
+    _tdav_audio_mix_accumulate_s16_sse2,
+    _tdav_audio_mix_minus_s16_sse2,
+};
+
+#endif /* TDAV_AUDIO_KERNELS_HAVE_SSE2 */
+
+/* ============ AVX2 ================= */
+
+#if TDAV_AUDIO_KERNELS_HAVE_AVX2
+
+// _mm256_packs_epi32() works on each 128-bit lane: the lanes are unpacked the same way to keep the samples in order
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static void _tdav_audio_gain_apply_s16_avx2(int16_t* buffer, tsk_size_t count, int32_t gain)
+{
+    tsk_size_t i = 0;
+    const __m128i shift = _mm_cvtsi32_si128(gain);
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)&buffer[i]);
+        __m256i lo = _mm256_sll_epi32(_mm256_srai_epi32(_mm256_unpacklo_epi16(x, x), 16), shift);
+        __m256i hi = _mm256_sll_epi32(_mm256_srai_epi32(_mm256_unpackhi_epi16(x, x), 16), shift);
+        _mm256_storeu_si256((__m256i*)&buffer[i], _mm256_packs_epi32(lo, hi));
+    }
+    _tdav_audio_gain_apply_s16_c(&buffer[i], (count - i), gain);
+}
+
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static void _tdav_audio_s16_to_float_avx2(float* out, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&in[i]));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&in[i + 8]));
+        _mm256_storeu_ps(&out[i], _mm256_cvtepi32_ps(lo));
+        _mm256_storeu_ps(&out[i + 8], _mm256_cvtepi32_ps(hi));
+    }
+    _tdav_audio_s16_to_float_c(&out[i], &in[i], (count - i));
+}
+
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static void _tdav_audio_float_to_s16_avx2(int16_t* out, const float* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    const __m256 min = _mm256_set1_ps(-32768.f), max = _mm256_set1_ps(32767.f);
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&in[i]), min), max));
+        __m256i hi = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&in[i + 8]), min), max));
+        // packs -> [0-3, 8-11 | 4-7, 12-15]
+        _mm256_storeu_si256((__m256i*)&out[i], _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8));
+    }
+    _tdav_audio_float_to_s16_c(&out[i], &in[i], (count - i));
+}
+
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static void _tdav_audio_stereo_to_mono_s16_avx2(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i = 0;
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (; i + 16 <= frames; i += 16) {
+        __m256i lo = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)&in[(i << 1)]), ones), 1);
+        __m256i hi = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_loadu_si256((const __m256i*)&in[(i << 1) + 16]), ones), 1);
+        _mm256_storeu_si256((__m256i*)&out[i], _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8));
+    }
+    _tdav_audio_stereo_to_mono_s16_c(&out[i], &in[(i << 1)], (frames - i));
+}
+
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static void _tdav_audio_mono_to_stereo_s16_avx2(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)&in[i]);
+        __m256i lo = _mm256_unpacklo_epi16(x, x); // [0-3 | 8-11]
+        __m256i hi = _mm256_unpackhi_epi16(x, x); // [4-7 | 12-15]
+        _mm256_storeu_si256((__m256i*)&out[(i << 1)], _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)&out[(i << 1) + 16], _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    _tdav_audio_mono_to_stereo_s16_c(&out[(i << 1)], &in[i], (frames - i));
+}
+
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static uint64_t _tdav_audio_energy_s16_avx2(const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    uint64_t energy[4];
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)&in[i]);
+        __m256i sq = _mm256_madd_epi16(x, x);
+        sum = _mm256_add_epi64(sum, _mm256_add_epi64(_mm256_unpacklo_epi32(sq, zero), _mm256_unpackhi_epi32(sq, zero)));
+    }
+    _mm256_storeu_si256((__m256i*)energy, sum);
+    return energy[0] + energy[1] + energy[2] + energy[3] + _tdav_audio_energy_s16_c(&in[i], (count - i));
+}
+
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static void _tdav_audio_mix_accumulate_s16_avx2(int32_t* acc, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&in[i]));
+        _mm256_storeu_si256((__m256i*)&acc[i], _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)&acc[i]), x));
+    }
+    _tdav_audio_mix_accumulate_s16_c(&acc[i], &in[i], (count - i));
+}
+
+TDAV_AUDIO_KERNELS_AVX2_FUN
+static void _tdav_audio_mix_minus_s16_avx2(int16_t* out, const int32_t* acc, const int16_t* own, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)&acc[i]);
+        __m256i hi = _mm256_loadu_si256((const __m256i*)&acc[i + 8]);
+        if (own) {
+            lo = _mm256_sub_epi32(lo, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&own[i])));
+            hi = _mm256_sub_epi32(hi, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&own[i + 8])));
+        }
+        _mm256_storeu_si256((__m256i*)&out[i], _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8));
+    }
+    _tdav_audio_mix_minus_s16_c(&out[i], &acc[i], own ? &own[i] : tsk_null, (count - i));
+}
+
+static const tdav_audio_kernels_t __kernels_avx2 = {
+    "avx2",
+    tdav_audio_kernels_isa_avx2,
+    _tdav_audio_gain_apply_s16_avx2,
+    _tdav_audio_s16_to_float_avx2,
+    _tdav_audio_float_to_s16_avx2,
+    _tdav_audio_stereo_to_mono_s16_avx2,
+    _tdav_audio_mono_to_stereo_s16_avx2,
+    _tdav_audio_energy_s16_avx2,
+    _tdav_audio_mix_accumulate_s16_avx2,
+    _tdav_audio_mix_minus_s16_avx2,
+};
+
+static tsk_bool_t _tdav_audio_kernels_cpu_has_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? tsk_true : tsk_false;
+}
+
+#endif /* TDAV_AUDIO_KERNELS_HAVE_AVX2 */
+
+/* ============ NEON ================= */
+
+#if TDAV_AUDIO_KERNELS_HAVE_NEON
+
+static void _tdav_audio_gain_apply_s16_neon(int16_t* buffer, tsk_size_t count, int32_t gain)
+{
+    tsk_size_t i = 0;
+    const int16x8_t shift = vdupq_n_s16((int16_t)gain);
+    for (; i + 8 <= count; i += 8) {
+        vst1q_s16(&buffer[i], vqshlq_s16(vld1q_s16(&buffer[i]), shift));
+    }
+    _tdav_audio_gain_apply_s16_c(&buffer[i], (count - i), gain);
+}
+
+static void _tdav_audio_s16_to_float_neon(float* out, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t x = vld1q_s16(&in[i]);
+        vst1q_f32(&out[i], vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))));
+        vst1q_f32(&out[i + 4], vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))));
+    }
+    _tdav_audio_s16_to_float_c(&out[i], &in[i], (count - i));
+}
+
+static int32x4_t _tdav_audio_float_round_neon(float32x4_t x)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return vcvtnq_s32_f32(x);
+#else
+    // vcvtq_s32_f32() truncates: add +/-0.5 (same sign as x)
+    const uint32x4_t half = vorrq_u32(vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000)), vreinterpretq_u32_f32(vdupq_n_f32(0.5f)));
+    return vcvtq_s32_f32(vaddq_f32(x, vreinterpretq_f32_u32(half)));
+#endif
+}
+
+static void _tdav_audio_float_to_s16_neon(int16_t* out, const float* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = _tdav_audio_float_round_neon(vld1q_f32(&in[i]));
+        int32x4_t hi = _tdav_audio_float_round_neon(vld1q_f32(&in[i + 4]));
+        vst1q_s16(&out[i], vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    _tdav_audio_float_to_s16_c(&out[i], &in[i], (count - i));
+}
+
+static void _tdav_audio_stereo_to_mono_s16_neon(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t lr = vld2q_s16(&in[(i << 1)]);
+        vst1q_s16(&out[i], vhaddq_s16(lr.val[0], lr.val[1]));
+    }
+    _tdav_audio_stereo_to_mono_s16_c(&out[i], &in[(i << 1)], (frames - i));
+}
+
+static void _tdav_audio_mono_to_stereo_s16_neon(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t lr;
+        lr.val[0] = lr.val[1] = vld1q_s16(&in[i]);
+        vst2q_s16(&out[(i << 1)], lr);
+    }
+    _tdav_audio_mono_to_stereo_s16_c(&out[(i << 1)], &in[i], (frames - i));
+}
+
+static uint64_t _tdav_audio_energy_s16_neon(const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    uint64x2_t sum = vdupq_n_u64(0);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t x = vld1q_s16(&in[i]);
+        // each square is up to 2^30: the pairwise sum is up to 2^31 (unsigned)
+        uint32x4_t sq = vreinterpretq_u32_s32(vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+        sum = vpadalq_u32(sum, sq);
+        sq = vreinterpretq_u32_s32(vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+        sum = vpadalq_u32(sum, sq);
+    }
+    return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1) + _tdav_audio_energy_s16_c(&in[i], (count - i));
+}
+
+static void _tdav_audio_mix_accumulate_s16_neon(int32_t* acc, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t x = vld1q_s16(&in[i]);
+        vst1q_s32(&acc[i], vaddw_s16(vld1q_s32(&acc[i]), vget_low_s16(x)));
+        vst1q_s32(&acc[i + 4], vaddw_s16(vld1q_s32(&acc[i + 4]), vget_high_s16(x)));
+    }
+    _tdav_audio_mix_accumulate_s16_c(&acc[i], &in[i], (count - i));
+}
+
+static void _tdav_audio_mix_minus_s16_neon(int16_t* out, const int32_t* acc, const int16_t* own, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = vld1q_s32(&acc[i]);
+        int32x4_t hi = vld1q_s32(&acc[i + 4]);
+        if (own) {
+            int16x8_t x = vld1q_s16(&own[i]);
+            lo = vsubw_s16(lo, vget_low_s16(x));
+            hi = vsubw_s16(hi, vget_high_s16(x));
+        }
+        vst1q_s16(&out[i], vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    _tdav_audio_mix_minus_s16_c(&out[i], &acc[i], own ? &own[i] : tsk_null, (count - i));
+}
+
+static const tdav_audio_kernels_t __kernels_neon = {
+    "neon",
+    tdav_audio_kernels_isa_neon,
+    _tdav_audio_gain_apply_s16_neon,
+    _tdav_audio_s16_to_float_neon,
+    _tdav_audio_float_to_s16_neon,
+    _tdav_audio_stereo_to_mono_s16_neon,
+    _tdav_audio_mono_to_stereo_s16_neon,
+    _tdav_audio_energy_s16_neon,
+    _tdav_audio_mix_accumulate_s16_neon,
+    _tdav_audio_mix_minus_s16_neon,
+};
+
+#endif /* TDAV_AUDIO_KERNELS_HAVE_NEON */
+
+/* ============ Public API ================= */
+
+int tdav_audio_kernels_init()
+{
+    int ret;
+    TDAV_AUDIO_G711_ENSURE();
+    if ((ret = tdav_audio_kernels_select(tdav_audio_kernels_isa_auto)) == 0) {
+        TSK_DEBUG_INFO("Audio kernels: %s", __kernels->name);
+    }
+    return ret;
+}
+
+// Returns -2 if the instruction set is not supported by the CPU (or not built in)
+int tdav_audio_kernels_select(tdav_audio_kernels_isa_t isa)
+{
+    switch (isa) {
+    case tdav_audio_kernels_isa_auto: {
+#if TDAV_AUDIO_KERNELS_HAVE_AVX2
+        if (_tdav_audio_kernels_cpu_has_avx2()) {
+            __kernels = &__kernels_avx2;
+            return 0;
+        }
+#endif
+#if TDAV_AUDIO_KERNELS_HAVE_SSE2
+        __kernels = &__kernels_sse2;
+#elif TDAV_AUDIO_KERNELS_HAVE_NEON
+        __kernels = &__kernels_neon;
+#else
+        __kernels = &__kernels_c;
+#endif
+        return 0;
+    }
+    case tdav_audio_kernels_isa_c: {
+        __kernels = &__kernels_c;
+        return 0;
+    }
+#if TDAV_AUDIO_KERNELS_HAVE_SSE2
+    case tdav_audio_kernels_isa_sse2: {
+        __kernels = &__kernels_sse2;
+        return 0;
+    }
+#endif
+#if TDAV_AUDIO_KERNELS_HAVE_AVX2
+    case tdav_audio_kernels_isa_avx2: {
+        if (_tdav_audio_kernels_cpu_has_avx2()) {
+            __kernels = &__kernels_avx2;
+            return 0;
+        }
+        break;
+    }
+#endif
+#if TDAV_AUDIO_KERNELS_HAVE_NEON
+    case tdav_audio_kernels_isa_neon: {
+        __kernels = &__kernels_neon;
+        return 0;
+    }
+#endif
+    default:
+        break;
+    }
+    return -2;
+}
+
+const char* tdav_audio_kernels_get_name()
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    return __kernels->name;
+}
+
+void tdav_audio_g711u_encode(uint8_t* out, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    TDAV_AUDIO_G711_ENSURE();
+    for (; i + 4 <= count; i += 4) {
+        out[i] = __g711u_enc_table[((uint16_t)in[i]) >> 2];
+        out[i + 1] = __g711u_enc_table[((uint16_t)in[i + 1]) >> 2];
+        out[i + 2] = __g711u_enc_table[((uint16_t)in[i + 2]) >> 2];
+        out[i + 3] = __g711u_enc_table[((uint16_t)in[i + 3]) >> 2];
+    }
+    for (; i < count; ++i) {
+        out[i] = __g711u_enc_table[((uint16_t)in[i]) >> 2];
+    }
+}
+
+void tdav_audio_g711u_decode(int16_t* out, const uint8_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    TDAV_AUDIO_G711_ENSURE();
+    for (; i + 4 <= count; i += 4) {
+        out[i] = __g711u_dec_table[in[i]];
+        out[i + 1] = __g711u_dec_table[in[i + 1]];
+        out[i + 2] = __g711u_dec_table[in[i + 2]];
+        out[i + 3] = __g711u_dec_table[in[i + 3]];
+    }
+    for (; i < count; ++i) {
+        out[i] = __g711u_dec_table[in[i]];
+    }
+}
+
+void tdav_audio_g711a_encode(uint8_t* out, const int16_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    TDAV_AUDIO_G711_ENSURE();
+    for (; i + 4 <= count; i += 4) {
+        out[i] = __g711a_enc_table[((uint16_t)in[i]) >> 3];
+        out[i + 1] = __g711a_enc_table[((uint16_t)in[i + 1]) >> 3];
+        out[i + 2] = __g711a_enc_table[((uint16_t)in[i + 2]) >> 3];
+        out[i + 3] = __g711a_enc_table[((uint16_t)in[i + 3]) >> 3];
+    }
+    for (; i < count; ++i) {
+        out[i] = __g711a_enc_table[((uint16_t)in[i]) >> 3];
+    }
+}
+
+void tdav_audio_g711a_decode(int16_t* out, const uint8_t* in, tsk_size_t count)
+{
+    tsk_size_t i = 0;
+    TDAV_AUDIO_G711_ENSURE();
+    for (; i + 4 <= count; i += 4) {
+        out[i] = __g711a_dec_table[in[i]];
+        out[i + 1] = __g711a_dec_table[in[i + 1]];
+        out[i + 2] = __g711a_dec_table[in[i + 2]];
+        out[i + 3] = __g711a_dec_table[in[i + 3]];
+    }
+    for (; i < count; ++i) {
+        out[i] = __g711a_dec_table[in[i]];
+    }
+}
+
+void tdav_audio_gain_apply_s16(int16_t* buffer, tsk_size_t count, int32_t gain)
+{
+    if (gain <= 0 || !buffer) {
+        return;
+    }
+    TDAV_AUDIO_KERNELS_ENSURE();
+    __kernels->gain_apply_s16(buffer, count, TSK_MIN(gain, 15));
+}
+
+void tdav_audio_s16_to_float(float* out, const int16_t* in, tsk_size_t count)
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    __kernels->s16_to_float(out, in, count);
+}
+
+void tdav_audio_float_to_s16(int16_t* out, const float* in, tsk_size_t count)
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    __kernels->float_to_s16(out, in, count);
+}
+
+void tdav_audio_stereo_to_mono_s16(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    __kernels->stereo_to_mono_s16(out, in, frames);
+}
+
+void tdav_audio_mono_to_stereo_s16(int16_t* out, const int16_t* in, tsk_size_t frames)
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    __kernels->mono_to_stereo_s16(out, in, frames);
+}
+
+uint64_t tdav_audio_energy_s16(const int16_t* in, tsk_size_t count)
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    return __kernels->energy_s16(in, count);
+}
+
+void tdav_audio_mix_accumulate_s16(int32_t* acc, const int16_t* in, tsk_size_t count)
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    __kernels->mix_accumulate_s16(acc, in, count);
+}
+
+void tdav_audio_mix_minus_s16(int16_t* out, const int32_t* acc, const int16_t* own, tsk_size_t count)
+{
+    TDAV_AUDIO_KERNELS_ENSURE();
+    __kernels->mix_minus_s16(out, acc, own, count);
+}
@@ -0,0 +1,614 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tdav_audio_mixer.c
+ * @brief N-way audio conference mixer.
+ */
+#include "tinydav/audio/tdav_audio_mixer.h"
+
+#include "tinydav/audio/tdav_audio_kernels.h"
+#include "tinydav/audio/tdav_consumer_audio.h"
+#include "tinydav/audio/tdav_producer_audio.h"
+#include "tinydav/tdav_session_av.h"
+
+#include "tinymedia/tmedia_session.h"
+
+#include "tsk_thread.h"
+#include "tsk_time.h"
+#include "tsk_memory.h"
+#include "tsk_debug.h"
+
+static int _tdav_audio_mixer_pred_participant_by_id(const tsk_list_item_t *item, const void *id)
+{
+    const tdav_audio_mixer_participant_t* participant = (const tdav_audio_mixer_participant_t*)item->data;
+    return (participant && participant->id == *((const uint64_t*)id)) ? 0 : -1;
+}
+
+// Current speakers are favored to avoid switching between two participants with the same level
+#define _tdav_audio_mixer_participant_score(participant) ((participant)->speaking ? ((participant)->level + ((participant)->level >> 1)) : (participant)->level)
+
+static tsk_size_t _tdav_audio_mixer_session_pull(const void* usrdata, void* buffer, tsk_size_t size)
+{
+    const tdav_session_av_t* base = (const tdav_session_av_t*)usrdata;
+    return base->consumer ? tdav_consumer_audio_get(TDAV_CONSUMER_AUDIO(base->consumer), buffer, size) : 0;
+}
+
+static int _tdav_audio_mixer_session_push(const void* usrdata, const void* buffer, tsk_size_t size)
+{
+    const tdav_session_av_t* base = (const tdav_session_av_t*)usrdata;
+    if (base->producer && base->producer->enc_cb.callback) {
+        return base->producer->enc_cb.callback(base->producer->enc_cb.callback_data, buffer, size);
+    }
+    return 0;
+}
+
+static void* TSK_STDCALL _tdav_audio_mixer_run(void* param)
+{
+    tdav_audio_mixer_t* self = (tdav_audio_mixer_t*)param;
+    uint64_t next = tsk_time_now(), now;
+
+    TSK_DEBUG_INFO("Audio mixer thread - ENTER");
+
+    while (self->started) {
+        tdav_audio_mixer_process(self);
+        next += self->ptime;
+        now = tsk_time_now();
+        if (next > now) {
+            tsk_thread_sleep(next - now);
+        }
+        else if ((now - next) > (self->ptime * 5)) {
+            TSK_DEBUG_WARN("Audio mixer is late by %llu ms", (now - next));
+            next = now;
+        }
+    }
+
+    TSK_DEBUG_INFO("Audio mixer thread - EXIT");
+
+    return tsk_null;
+}
+
+tdav_audio_mixer_t* tdav_audio_mixer_create(uint32_t rate, uint32_t ptime, uint32_t max_speakers)
+{
+    tdav_audio_mixer_t* self;
+    if (!rate || !ptime || !max_speakers) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if (!(self = tsk_object_new(tdav_audio_mixer_def_t))) {
+        TSK_DEBUG_ERROR("Failed to create audio mixer");
+        return tsk_null;
+    }
+    self->rate = rate;
+    self->ptime = ptime;
+    self->frame_samples = ((rate * ptime) / 1000);
+    self->max_speakers = max_speakers;
+    if (!(self->speakers = tsk_calloc(max_speakers, sizeof(tdav_audio_mixer_participant_t*)))
+            || !(self->acc = tsk_calloc(self->frame_samples, sizeof(int32_t)))
+            || !(self->mix = tsk_calloc(self->frame_samples, sizeof(int16_t)))
+            || !(self->mix_minus = tsk_calloc(self->frame_samples, sizeof(int16_t)))) {
+        TSK_DEBUG_ERROR("Failed to allocate buffers");
+        TSK_OBJECT_SAFE_FREE(self);
+    }
+    return self;
+}
+
+int tdav_audio_mixer_add_participant(tdav_audio_mixer_t* self, uint64_t id, tdav_audio_mixer_pull_cb_f pull, tdav_audio_mixer_push_cb_f push, const void* usrdata)
+{
+    tdav_audio_mixer_participant_t* participant;
+    int ret = 0;
+
+    if (!self || (!pull && !push)) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_safeobj_lock(self);
+
+    if (tsk_list_find_object_by_pred(self->participants, _tdav_audio_mixer_pred_participant_by_id, &id)) {
+        TSK_DEBUG_ERROR("Participant with id = %llu already in the mixer", id);
+        ret = -2;
+        goto bail;
+    }
+    if (!(participant = tsk_object_new(tdav_audio_mixer_participant_def_t))) {
+        TSK_DEBUG_ERROR("Failed to create participant");
+        ret = -3;
+        goto bail;
+    }
+    if (!(participant->frame = tsk_calloc(self->frame_samples, sizeof(int16_t)))) {
+        TSK_DEBUG_ERROR("Failed to allocate frame");
+        TSK_OBJECT_SAFE_FREE(participant);
+        ret = -4;
+        goto bail;
+    }
+    participant->id = id;
+    participant->pull = pull;
+    participant->push = push;
+    participant->usrdata = usrdata;
+    tsk_list_push_back_data(self->participants, (void**)&participant);
+
+bail:
+    tsk_safeobj_unlock(self);
+    return ret;
+}
+
+/**
+* Adds an audio session to the mixer. Must be called before starting the session: the consumer and producer are configured to
+* use the mixer's rate (mono) and the session's resamplers will convert to/from the codec's rate.
+*/
+int tdav_audio_mixer_add_session(tdav_audio_mixer_t* self, struct tmedia_session_s* session)
+{
+    tdav_session_av_t* base = (tdav_session_av_t*)session;
+    const tdav_audio_mixer_participant_t* participant;
+    int ret;
+
+    if (!self || !session || session->type != tmedia_audio || !base->consumer || !base->producer) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    base->consumer->audio.out.rate = self->rate;
+    base->consumer->audio.out.channels = 1;
+    base->producer->audio.rate = self->rate;
+    base->producer->audio.channels = 1;
+
+    if ((ret = tdav_audio_mixer_add_participant(self, session->id, _tdav_audio_mixer_session_pull, _tdav_audio_mixer_session_push, session))) {
+        return ret;
+    }
+    tsk_safeobj_lock(self);
+    if ((participant = (const tdav_audio_mixer_participant_t*)tsk_list_find_object_by_pred(self->participants, _tdav_audio_mixer_pred_participant_by_id, &session->id))) {
+        ((tdav_audio_mixer_participant_t*)participant)->session = tsk_object_ref(session);
+    }
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+int tdav_audio_mixer_remove_participant(tdav_audio_mixer_t* self, uint64_t id)
+{
+    tsk_bool_t removed;
+    uint32_t i;
+
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_safeobj_lock(self);
+    // the speakers array holds weak references
+    for (i = 0; i < self->speakers_count; ++i) {
+        if (self->speakers[i]->id == id) {
+            self->speakers[i] = self->speakers[--self->speakers_count];
+            break;
+        }
+    }
+    removed = tsk_list_remove_item_by_pred(self->participants, _tdav_audio_mixer_pred_participant_by_id, &id);
+    tsk_safeobj_unlock(self);
+
+    return removed ? 0 : -2;
+}
+
+tsk_size_t tdav_audio_mixer_get_participants_count(tdav_audio_mixer_t* self)
+{
+    tsk_size_t count;
+    if (!self) {
+        return 0;
+    }
+    tsk_safeobj_lock(self);
+    count = tsk_list_count_all(self->participants);
+    tsk_safeobj_unlock(self);
+    return count;
+}
+
+tsk_bool_t tdav_audio_mixer_is_speaking(tdav_audio_mixer_t* self, uint64_t id)
+{
+    const tdav_audio_mixer_participant_t* participant;
+    tsk_bool_t speaking = tsk_false;
+    if (!self) {
+        return tsk_false;
+    }
+    tsk_safeobj_lock(self);
+    if ((participant = (const tdav_audio_mixer_participant_t*)tsk_list_find_object_by_pred(self->participants, _tdav_audio_mixer_pred_participant_by_id, &id))) {
+        speaking = participant->speaking;
+    }
+    tsk_safeobj_unlock(self);
+    return speaking;
+}
+
+/**
+* Mixes one frame: called every "ptime" milliseconds by the mixer's thread or by the application (external clock).
+*/
+int tdav_audio_mixer_process(tdav_audio_mixer_t* self)
+{
+    tsk_list_item_t* item;
+    tdav_audio_mixer_participant_t* participant;
+    tsk_size_t frame_size, size;
+    uint64_t energy, score;
+    uint32_t i, j;
+
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    frame_size = (self->frame_samples * sizeof(int16_t));
+
+    tsk_safeobj_lock(self);
+
+    // pull the frames, update the levels and select the loudest participants (top-K)
+    self->speakers_count = 0;
+    tsk_list_foreach(item, self->participants) {
+        participant = (tdav_audio_mixer_participant_t*)item->data;
+        size = participant->pull ? TSK_MIN(participant->pull(participant->usrdata, participant->frame, frame_size), frame_size) : 0;
+        if (size < frame_size) {
+            memset(((uint8_t*)participant->frame) + size, 0, (frame_size - size));
+        }
+        energy = size ? (tdav_audio_energy_s16(participant->frame, self->frame_samples) / self->frame_samples) : 0;
+        participant->level = ((participant->level * 3) + energy) >> 2;
+        if (participant->level < TDAV_AUDIO_MIXER_SILENCE_LEVEL) {
+            participant->speaking = tsk_false;
+            continue;
+        }
+        score = _tdav_audio_mixer_participant_score(participant);
+        for (i = self->speakers_count; i > 0 && _tdav_audio_mixer_participant_score(self->speakers[i - 1]) < score; --i) ;
+        if (i < self->max_speakers) {
+            if (self->speakers_count == self->max_speakers) {
+                self->speakers[self->speakers_count - 1]->speaking = tsk_false; // evicted
+                --self->speakers_count;
+            }
+            for (j = self->speakers_count; j > i; --j) {
+                self->speakers[j] = self->speakers[j - 1];
+            }
+            self->speakers[i] = participant;
+            ++self->speakers_count;
+        }
+        else {
+            participant->speaking = tsk_false;
+        }
+    }
+    // the flag is updated at the end because it's used by the score
+    for (i = 0; i < self->speakers_count; ++i) {
+        self->speakers[i]->speaking = tsk_true;
+    }
+
+    // mix the active speakers only
+    memset(self->acc, 0, (self->frame_samples * sizeof(int32_t)));
+    for (i = 0; i < self->speakers_count; ++i) {
+        tdav_audio_mix_accumulate_s16(self->acc, self->speakers[i]->frame, self->frame_samples);
+    }
+    tdav_audio_mix_minus_s16(self->mix, self->acc, tsk_null, self->frame_samples);
+
+    // listeners get the same mix, speakers get the mix without their own voice
+    tsk_list_foreach(item, self->participants) {
+        participant = (tdav_audio_mixer_participant_t*)item->data;
+        if (!participant->push) {
+            continue;
+        }
+        if (participant->speaking) {
+            tdav_audio_mix_minus_s16(self->mix_minus, self->acc, participant->frame, self->frame_samples);
+            participant->push(participant->usrdata, self->mix_minus, frame_size);
+        }
+        else {
+            participant->push(participant->usrdata, self->mix, frame_size);
+        }
+    }
+    ++self->ticks;
+
+    tsk_safeobj_unlock(self);
+
+    return 0;
+}
+
+int tdav_audio_mixer_start(tdav_audio_mixer_t* self)
+{
+    int ret = 0;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    if (!self->started) {
+        self->started = tsk_true;
+        if ((ret = tsk_thread_create(&self->tid[0], _tdav_audio_mixer_run, self)) != 0) {
+            TSK_DEBUG_ERROR("Failed to create audio mixer thread");
+            self->started = tsk_false;
+        }
+    }
+    tsk_safeobj_unlock(self);
+    return ret;
+}
+
+int tdav_audio_mixer_stop(tdav_audio_mixer_t* self)
+{
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    self->started = tsk_false;
+    if (self->tid[0]) {
+        tsk_thread_join(&self->tid[0]);
+    }
+    return 0;
+}
+
+/**
+* Replaces the sound card plugins by the mixer's consumer and producer. To be used by conference bridges.
+*/
+int tdav_audio_mixer_plugins_register()
+{
+    int ret;
+    tmedia_consumer_plugin_unregister_by_type(tmedia_audio);
+    tmedia_producer_plugin_unregister_by_type(tmedia_audio);
+    if ((ret = tmedia_consumer_plugin_register(tdav_consumer_audio_mixer_plugin_def_t))) {
+        return ret;
+    }
+    return tmedia_producer_plugin_register(tdav_producer_audio_mixer_plugin_def_t);
+}
+
+
+//=================================================================================================
+//	Audio mixer participant object definition
+//
+static tsk_object_t* tdav_audio_mixer_participant_ctor(tsk_object_t * self, va_list * app)
+{
+    tdav_audio_mixer_participant_t *participant = self;
+    if (participant) {
+    }
+    return self;
+}
+static tsk_object_t* tdav_audio_mixer_participant_dtor(tsk_object_t * self)
+{
+    tdav_audio_mixer_participant_t *participant = self;
+    if (participant) {
+        TSK_FREE(participant->frame);
+        TSK_OBJECT_SAFE_FREE(participant->session);
+    }
+    return self;
+}
+static int tdav_audio_mixer_participant_cmp(const tsk_object_t *_p1, const tsk_object_t *_p2)
+{
+    const tdav_audio_mixer_participant_t *p1 = _p1, *p2 = _p2;
+    if (p1 && p2) {
+        return (p1->id == p2->id) ? 0 : ((p1->id > p2->id) ? 1 : -1);
+    }
+    return (p1 ? 1 : (p2 ? -1 : 0));
+}
+static const tsk_object_def_t tdav_audio_mixer_participant_def_s = {
+    sizeof(tdav_audio_mixer_participant_t),
+    tdav_audio_mixer_participant_ctor,
+    tdav_audio_mixer_participant_dtor,
+    tdav_audio_mixer_participant_cmp,
+};
+const tsk_object_def_t *tdav_audio_mixer_participant_def_t = &tdav_audio_mixer_participant_def_s;
+
+
+//=================================================================================================
+//	Audio mixer object definition
+//
+static tsk_object_t* tdav_audio_mixer_ctor(tsk_object_t * self, va_list * app)
+{
+    tdav_audio_mixer_t *mixer = self;
+    if (mixer) {
+        mixer->participants = tsk_list_create();
+        tsk_safeobj_init(mixer);
+    }
+    return self;
+}
+static tsk_object_t* tdav_audio_mixer_dtor(tsk_object_t * self)
+{
+    tdav_audio_mixer_t *mixer = self;
+    if (mixer) {
+        tdav_audio_mixer_stop(mixer);
+        TSK_OBJECT_SAFE_FREE(mixer->participants);
+        TSK_FREE(mixer->speakers);
+        TSK_FREE(mixer->acc);
+        TSK_FREE(mixer->mix);
+        TSK_FREE(mixer->mix_minus);
+        tsk_safeobj_deinit(mixer);
+        TSK_DEBUG_INFO("*** Audio mixer destroyed ***");
+    }
+    return self;
+}
+static const tsk_object_def_t tdav_audio_mixer_def_s = {
+    sizeof(tdav_audio_mixer_t),
+    tdav_audio_mixer_ctor,
+    tdav_audio_mixer_dtor,
+    tsk_null,
+};
+const tsk_object_def_t *tdav_audio_mixer_def_t = &tdav_audio_mixer_def_s;
+
+
+/* ============ Mixer consumer (no sound card, the frames are pulled by the mixer) ================= */
+
+typedef struct tdav_consumer_audio_mixer_s {
+    TDAV_DECLARE_CONSUMER_AUDIO;
+
+    tsk_bool_t started;
+}
+tdav_consumer_audio_mixer_t;
+
+static int tdav_consumer_audio_mixer_set(tmedia_consumer_t* self, const tmedia_param_t* param)
+{
+    return tdav_consumer_audio_set(TDAV_CONSUMER_AUDIO(self), param);
+}
+
+static int tdav_consumer_audio_mixer_prepare(tmedia_consumer_t* self, const tmedia_codec_t* codec)
+{
+    if (!self || !codec) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    self->audio.ptime = TMEDIA_CODEC_PTIME_AUDIO_DECODING(codec);
+    self->audio.in.channels = TMEDIA_CODEC_CHANNELS_AUDIO_DECODING(codec);
+    self->audio.in.rate = TMEDIA_CODEC_RATE_DECODING(codec);
+    // keep the values set by the mixer
+    if (!self->audio.out.rate) {
+        self->audio.out.rate = self->audio.in.rate;
+    }
+    if (!self->audio.out.channels) {
+        self->audio.out.channels = self->audio.in.channels;
+    }
+    return 0;
+}
+
+static int tdav_consumer_audio_mixer_start(tmedia_consumer_t* self)
+{
+    ((tdav_consumer_audio_mixer_t*)self)->started = tsk_true;
+    return 0;
+}
+
+static int tdav_consumer_audio_mixer_consume(tmedia_consumer_t* self, const void* buffer, tsk_size_t size, const tsk_object_t* proto_hdr)
+{
+    if (!self || !buffer || !size) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!((tdav_consumer_audio_mixer_t*)self)->started) {
+        return -2;
+    }
+    return tdav_consumer_audio_put(TDAV_CONSUMER_AUDIO(self), buffer, size, proto_hdr); /*thread-safe*/
+}
+
+static int tdav_consumer_audio_mixer_pause(tmedia_consumer_t* self)
+{
+    return 0;
+}
+
+static int tdav_consumer_audio_mixer_stop(tmedia_consumer_t* self)
+{
+    ((tdav_consumer_audio_mixer_t*)self)->started = tsk_false;
+    return 0;
+}
+
+static tsk_object_t* tdav_consumer_audio_mixer_ctor(tsk_object_t * self, va_list * app)
+{
+    tdav_consumer_audio_mixer_t *consumer = self;
+    if (consumer) {
+        /* init base */
+        tdav_consumer_audio_init(TDAV_CONSUMER_AUDIO(consumer));
+    }
+    return self;
+}
+static tsk_object_t* tdav_consumer_audio_mixer_dtor(tsk_object_t * self)
+{
+    tdav_consumer_audio_mixer_t *consumer = self;
+    if (consumer) {
+        /* deinit base */
+        tdav_consumer_audio_deinit(TDAV_CONSUMER_AUDIO(consumer));
+    }
+    return self;
+}
+static const tsk_object_def_t tdav_consumer_audio_mixer_def_s = {
+    sizeof(tdav_consumer_audio_mixer_t),
+    tdav_consumer_audio_mixer_ctor,
+    tdav_consumer_audio_mixer_dtor,
+    tdav_consumer_audio_cmp,
+};
+static const tmedia_consumer_plugin_def_t tdav_consumer_audio_mixer_plugin_def_s = {
+    &tdav_consumer_audio_mixer_def_s,
+
+    tmedia_audio,
+    "Audio mixer consumer",
+
+    tdav_consumer_audio_mixer_set,
+    tdav_consumer_audio_mixer_prepare,
+    tdav_consumer_audio_mixer_start,
+    tdav_consumer_audio_mixer_consume,
+    tdav_consumer_audio_mixer_pause,
+    tdav_consumer_audio_mixer_stop
+};
+const tmedia_consumer_plugin_def_t *tdav_consumer_audio_mixer_plugin_def_t = &tdav_consumer_audio_mixer_plugin_def_s;
+
+
+/* ============ Mixer producer (no sound card, the frames are pushed by the mixer) ================= */
+
+typedef struct tdav_producer_audio_mixer_s {
+    TDAV_DECLARE_PRODUCER_AUDIO;
+}
+tdav_producer_audio_mixer_t;
+
+static int tdav_producer_audio_mixer_set(tmedia_producer_t* self, const tmedia_param_t* param)
+{
+    return tdav_producer_audio_set(TDAV_PRODUCER_AUDIO(self), param);
+}
+
+static int tdav_producer_audio_mixer_prepare(tmedia_producer_t* self, const tmedia_codec_t* codec)
+{
+    if (!self || !codec) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    // rate and channels set by the mixer
+    self->audio.ptime = TMEDIA_CODEC_PTIME_AUDIO_ENCODING(codec);
+    return 0;
+}
+
+static int tdav_producer_audio_mixer_start(tmedia_producer_t* self)
+{
+    return 0;
+}
+
+static int tdav_producer_audio_mixer_pause(tmedia_producer_t* self)
+{
+    return 0;
+}
+
+static int tdav_producer_audio_mixer_stop(tmedia_producer_t* self)
+{
+    return 0;
+}
+
+static tsk_object_t* tdav_producer_audio_mixer_ctor(tsk_object_t * self, va_list * app)
+{
+    tdav_producer_audio_mixer_t *producer = self;
+    if (producer) {
+        /* init base */
+        tdav_producer_audio_init(TDAV_PRODUCER_AUDIO(producer));
+    }
+    return self;
+}
+static tsk_object_t* tdav_producer_audio_mixer_dtor(tsk_object_t * self)
+{
+    tdav_producer_audio_mixer_t *producer = self;
+    if (producer) {
+        /* deinit base */
+        tdav_producer_audio_deinit(TDAV_PRODUCER_AUDIO(producer));
+    }
+    return self;
+}
+static const tsk_object_def_t tdav_producer_audio_mixer_def_s = {
+    sizeof(tdav_producer_audio_mixer_t),
+    tdav_producer_audio_mixer_ctor,
+    tdav_producer_audio_mixer_dtor,
+    tdav_producer_audio_cmp,
+};
+static const tmedia_producer_plugin_def_t tdav_producer_audio_mixer_plugin_def_s = {
+    &tdav_producer_audio_mixer_def_s,
+
+    tmedia_audio,
+    "Audio mixer producer",
+
+    tdav_producer_audio_mixer_set,
+    tdav_producer_audio_mixer_prepare,
+    tdav_producer_audio_mixer_start,
+    tdav_producer_audio_mixer_pause,
+    tdav_producer_audio_mixer_stop
+};
+const tmedia_producer_plugin_def_t *tdav_producer_audio_mixer_plugin_def_t = &tdav_producer_audio_mixer_plugin_def_s;
@@ -28,6 +28,7 @@
 
 //#include "tinydav/codecs/dtmf/tdav_codec_dtmf.h"
 #include "tinydav/audio/tdav_consumer_audio.h"
+#include "tinydav/audio/tdav_audio_kernels.h"
 
 #include "tinymedia/tmedia_resampler.h"
 #include "tinymedia/tmedia_denoise.h"
@@ -677,25 +678,20 @@ static int tdav_session_audio_set_ro(tmedia_session_t* self, const tsdp_header_M
 static void _tdav_session_audio_apply_gain(void* buffer, int len, int bps, int gain)
 {
     register int i;
-    int max_val;
-
-    max_val = (1 << (bps - 1 - gain)) - 1;
 
+    if (gain <= 0) {
+        return;
+    }
     if (bps == 8) {
         int8_t *buff = buffer;
+        const int32_t factor = (1 << TSK_MIN(gain, 7));
         for (i = 0; i < len; i++) {
-            if (buff[i] > -max_val && buff[i] < max_val) {
-                buff[i] = buff[i] << gain;
-            }
+            const int32_t v = buff[i] * factor;
+            buff[i] = (int8_t)(v > 127 ? 127 : (v < -128 ? -128 : v));
         }
     }
     else if (bps == 16) {
-        int16_t *buff = buffer;
-        for (i = 0; i < len / 2; i++) {
-            if (buff[i] > -max_val && buff[i] < max_val) {
-                buff[i] = buff[i] << gain;
-            }
-        }
+        tdav_audio_gain_apply_s16((int16_t*)buffer, (tsk_size_t)(len >> 1), gain);
     }
 }
 
@@ -23,6 +23,8 @@
 
 #include <speex/speex_resampler.h>
 
+#include "tinydav/audio/tdav_audio_kernels.h"
+
 #include "tsk_memory.h"
 #include "tsk_debug.h"
 
@@ -128,10 +130,7 @@ static tsk_size_t tdav_speex_resampler_process(tmedia_resampler_t* self, const v
             if (resampler->bytes_per_sample == sizeof(spx_int16_t)) {
                 err = speex_resampler_process_int(resampler->state, 0, (const spx_int16_t *)in_data, (spx_uint32_t *)&in_size_in_sample, resampler->tmp_buffer.ptr, &_out_size_in_sample);
                 if (err == RESAMPLER_ERR_SUCCESS) {
-                    spx_int16_t* pout_data = (spx_int16_t*)(out_data);
-                    for (i = 0, j = 0; i < _out_size_in_sample; ++i, j += 2) {
-                        pout_data[j] = pout_data[j + 1] = *(((const spx_int16_t*)resampler->tmp_buffer.ptr) + i);
-                    }
+                    tdav_audio_mono_to_stereo_s16((int16_t*)out_data, (const int16_t*)resampler->tmp_buffer.ptr, _out_size_in_sample);
                 }
             }
             else {
@@ -153,11 +152,8 @@ static tsk_size_t tdav_speex_resampler_process(tmedia_resampler_t* self, const v
                                                   (const spx_int16_t *)in_data, (spx_uint32_t *)&in_size_in_sample,
                                                   (spx_int16_t *)resampler->tmp_buffer.ptr, &_out_size2_in_sample);
                 if (err == RESAMPLER_ERR_SUCCESS) {
-                    spx_int16_t* pout_data = (spx_int16_t*)(out_data);
                     _out_size_in_sample = (spx_uint32_t)resampler->out_size;
-                    for (i = 0, j = 0; j < _out_size2_in_sample; ++i, j += 2) {
-                        pout_data[i] = *(((const spx_int16_t*)resampler->tmp_buffer.ptr) + j);
-                    }
+                    tdav_audio_stereo_to_mono_s16((int16_t*)out_data, (const int16_t*)resampler->tmp_buffer.ptr, (_out_size2_in_sample >> 1));
                 }
             }
             else {
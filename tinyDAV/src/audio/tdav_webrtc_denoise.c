@@ -23,6 +23,7 @@
 * @brief Google WebRTC Denoiser (Noise suppression, AGC, AEC) Plugin
 */
 #include "tinydav/audio/tdav_webrtc_denoise.h"
+#include "tinydav/audio/tdav_audio_kernels.h"
 
 #if HAVE_WEBRTC && (!defined(HAVE_WEBRTC_DENOISE) || HAVE_WEBRTC_DENOISE)
 
@@ -498,22 +499,13 @@ static int _tdav_webrtc_resampler_process(tdav_webrtc_resampler_t *p_self, const
     }
     _n_buff_size_in_samples = p_self->in.n_buff_size_in_samples;
     if (p_self->in.x_pin.n_sample_size != p_self->out.x_pin.n_sample_size) {
-        tsk_size_t index;
         if (p_self->in.x_pin.n_sample_size == sizeof(int16_t)) {
             // int16_t -> float
-            const int16_t* p_src = (const int16_t*)p_buff_ptr;
-            float* p_dst = (float*)p_self->p_bufftmp_ptr;
-            for (index = 0; index < _n_buff_size_in_samples; ++index) {
-                p_dst[index] = (float)p_src[index];
-            }
+            tdav_audio_s16_to_float((float*)p_self->p_bufftmp_ptr, (const int16_t*)p_buff_ptr, _n_buff_size_in_samples);
         }
         else {
-            // float -> int16_t
-            const float* p_src = (const float*)p_buff_ptr;
-            int16_t* p_dst = (int16_t*)p_self->p_bufftmp_ptr;
-            for (index = 0; index < _n_buff_size_in_samples; ++index) {
-                p_dst[index] = (int16_t)p_src[index];
-            }
+            // float -> int16_t (saturated)
+            tdav_audio_float_to_s16((int16_t*)p_self->p_bufftmp_ptr, (const float*)p_buff_ptr, _n_buff_size_in_samples);
         }
         _p_buff_ptr = p_self->p_bufftmp_ptr;
         _n_buff_size_in_bytes = p_self->in.n_buff_size_in_bytes;
@@ -30,6 +30,19 @@
 #include "tsk_debug.h"
 
 #define TDAV_FEC_PKT_HDR_SIZE	10
+#define TDAV_FEC_MEDIA_WINDOW	256 // number of media packets kept to recover the lost ones. MUST be power of 2 and greater than 48 (longest mask).
+#define TDAV_FEC_MEDIA_MASK		(TDAV_FEC_MEDIA_WINDOW - 1)
+#define TDAV_FEC_PKTS_MAX		32 // maximum number of FEC packets waiting for missing media packets
+
+// media packet received or recovered
+typedef struct tdav_fec_media_s {
+    tsk_bool_t set;
+    uint16_t seq_num;
+    uint8_t* ptr; // serialized packet: fixed header followed by the protected bytes (CSRC list, extension, payload and padding)
+    tsk_size_t size;
+    tsk_size_t capacity;
+}
+tdav_fec_media_t;
 
 typedef struct tdav_codec_ulpfec_s {
     TMEDIA_DECLARE_CODEC_VIDEO;
@@ -37,6 +50,20 @@ typedef struct tdav_codec_ulpfec_s {
     struct {
         struct tdav_fec_pkt_s* pkt;
     } encoder;
+
+    struct {
+        tdav_codec_ulpfec_rtppacket_cb_f callback;
+        const void* callback_data;
+        tdav_fec_media_t media[TDAV_FEC_MEDIA_WINDOW]; // indexed by sequence number
+        uint16_t seq_num_last; // highest media sequence number
+        tsk_list_t* pkts; // FEC packets with missing media packets
+        uint32_t ssrc;
+        struct {
+            uint8_t* ptr;
+            tsk_size_t size;
+        } buffer; // packet being recovered
+        tdav_codec_ulpfec_stats_t stats;
+    } decoder;
 }
 tdav_codec_ulpfec_t;
 
@@ -200,11 +227,22 @@ int tdav_codec_ulpfec_enc_reset(tdav_codec_ulpfec_t* self)
 
 int tdav_codec_ulpfec_enc_protect(tdav_codec_ulpfec_t* self, const trtp_rtp_packet_t* rtp_packet)
 {
+    uint16_t offset;
     if (!self || !self->encoder.pkt || !rtp_packet || !rtp_packet->header) {
         TSK_DEBUG_ERROR("invalid parameter");
         return -1;
     }
 
+    // the mask covers up to 48 packets starting at the first one (SN base)
+    offset = self->encoder.pkt->hdr.SN_base.set ? (uint16_t)(rtp_packet->header->seq_num - self->encoder.pkt->hdr.SN_base.value) : 0;
+    if (offset >= 48) {
+        TSK_DEBUG_INFO("Too many packets to protect, seq_num=%u not protected", rtp_packet->header->seq_num);
+        return 0;
+    }
+    if (offset >= 16) {
+        self->encoder.pkt->hdr.L = 1;
+    }
+
     // Packet
     self->encoder.pkt->hdr.P ^= rtp_packet->header->padding;
     self->encoder.pkt->hdr.X ^= rtp_packet->header->extension;
@@ -215,9 +253,6 @@ int tdav_codec_ulpfec_enc_protect(tdav_codec_ulpfec_t* self, const trtp_rtp_pack
         self->encoder.pkt->hdr.SN_base.value = rtp_packet->header->seq_num;
         self->encoder.pkt->hdr.SN_base.set = 1;
     }
-    else {
-        self->encoder.pkt->hdr.SN_base.value = TSK_MIN(self->encoder.pkt->hdr.SN_base.value, rtp_packet->header->seq_num);
-    }
     self->encoder.pkt->hdr.TS ^= rtp_packet->header->timestamp;
     self->encoder.pkt->hdr.length ^= (trtp_rtp_packet_guess_serialbuff_size(rtp_packet) - TRTP_RTP_HEADER_MIN_SIZE);
 
@@ -242,13 +277,17 @@ int tdav_codec_ulpfec_enc_protect(tdav_codec_ulpfec_t* self, const trtp_rtp_pack
                 level0->payload.size = 0;
                 return -3;
             }
+            memset(&level0->payload.ptr[level0->payload.size], 0, (rtp_packet->payload.size - level0->payload.size)); // shorter packets are zero-padded
             level0->payload.size = rtp_packet->payload.size;
         }
         for (i = 0; i < rtp_packet->payload.size; ++i) {
             level0->payload.ptr[i] ^= rtp_payload[i];
         }
+        if (self->encoder.pkt->hdr.L && level0->hdr.mask_size != 48) {
+            level0->hdr.mask <<= 32; // 16 -> 48 bits, MSB is always SN base
+        }
         level0->hdr.mask_size = self->encoder.pkt->hdr.L ? 48 : 16;
-        level0->hdr.mask |= (uint64_t)((uint64_t)1 << (level0->hdr.mask_size - (rtp_packet->header->seq_num - self->encoder.pkt->hdr.SN_base.value)));
+        level0->hdr.mask |= ((uint64_t)1 << (level0->hdr.mask_size - 1 - offset));
         level0->hdr.length = (uint16_t)(TSK_MAX(level0->hdr.length, rtp_packet->payload.size));
     }
 
@@ -340,12 +379,321 @@ static tsk_size_t tdav_codec_ulpfec_encode(tmedia_codec_t* self, const void* in_
     return 0;
 }
 
-static tsk_size_t tdav_codec_ulpfec_decode(tmedia_codec_t* self, const void* in_data, tsk_size_t in_size, void** out_data, tsk_size_t* out_max_size, const tsk_object_t* proto_hdr)
+// parses an FEC packet (RFC 5109 - 7. FEC Packet Format)
+static tdav_fec_pkt_t* _tdav_codec_ulpfec_dec_parse(const uint8_t* pdata, tsk_size_t size)
 {
-    TSK_DEBUG_ERROR("Not expected to be called");
+    tdav_fec_pkt_t* pkt;
+    tdav_fec_level_t* level;
+    tsk_size_t level_hdr_size;
+
+    if (size < TDAV_FEC_PKT_HDR_SIZE) {
+        TSK_DEBUG_ERROR("FEC packet too short (%u)", (unsigned)size);
+        return tsk_null;
+    }
+    if (!(pkt = tsk_object_new(tdav_fec_pkt_def_t))) {
+        TSK_DEBUG_ERROR("Failed to create FEC packet");
+        return tsk_null;
+    }
+
+    pkt->hdr.E = (pdata[0] >> 7);
+    pkt->hdr.L = (pdata[0] >> 6) & 0x01;
+    pkt->hdr.P = (pdata[0] >> 5) & 0x01;
+    pkt->hdr.X = (pdata[0] >> 4) & 0x01;
+    pkt->hdr.CC = (pdata[0] & 0x0F);
+    pkt->hdr.M = (pdata[1] >> 7);
+    pkt->hdr.PT = (pdata[1] & 0x7F);
+    pkt->hdr.SN_base.value = (pdata[2] << 8) | pdata[3];
+    pkt->hdr.SN_base.set = 1;
+    pkt->hdr.TS = ((uint32_t)pdata[4] << 24) | ((uint32_t)pdata[5] << 16) | ((uint32_t)pdata[6] << 8) | (uint32_t)pdata[7];
+    pkt->hdr.length = (pdata[8] << 8) | pdata[9];
+    pdata += TDAV_FEC_PKT_HDR_SIZE;
+    size -= TDAV_FEC_PKT_HDR_SIZE;
+
+    // 7.4. FEC Level Header for FEC Packets: one or more levels
+    level_hdr_size = pkt->hdr.L ? 8 : 4;
+    while (size >= level_hdr_size) {
+        tsk_size_t i;
+        if (!(level = tsk_object_new(tdav_fec_level_def_t))) {
+            TSK_DEBUG_ERROR("Failed to create level");
+            break;
+        }
+        level->hdr.length = (pdata[0] << 8) | pdata[1];
+        level->hdr.mask_size = pkt->hdr.L ? 48 : 16;
+        for (i = 2; i < level_hdr_size; ++i) {
+            level->hdr.mask = (level->hdr.mask << 8) | pdata[i];
+        }
+        pdata += level_hdr_size;
+        size -= level_hdr_size;
+        if (level->hdr.length > size) {
+            TSK_DEBUG_ERROR("Invalid FEC level length (%u > %u)", (unsigned)level->hdr.length, (unsigned)size);
+            TSK_OBJECT_SAFE_FREE(level);
+            break;
+        }
+        if (level->hdr.length && (level->payload.ptr = tsk_malloc(level->hdr.length))) {
+            memcpy(level->payload.ptr, pdata, level->hdr.length);
+            level->payload.size = level->hdr.length;
+        }
+        pdata += level->hdr.length;
+        size -= level->hdr.length;
+        tsk_list_push_back_data(pkt->levels, (void**)&level);
+    }
+
+    if (TSK_LIST_IS_EMPTY(pkt->levels)) {
+        TSK_DEBUG_ERROR("FEC packet without level");
+        TSK_OBJECT_SAFE_FREE(pkt);
+    }
+    return pkt;
+}
+
+static TSK_INLINE const tdav_fec_media_t* _tdav_codec_ulpfec_dec_media_get(const tdav_codec_ulpfec_t* self, uint16_t seq_num)
+{
+    const tdav_fec_media_t* media = &self->decoder.media[seq_num & TDAV_FEC_MEDIA_MASK];
+    return (media->set && media->seq_num == seq_num) ? media : tsk_null;
+}
+
+// saves a serialized media packet
+static int _tdav_codec_ulpfec_dec_media_put(tdav_codec_ulpfec_t* self, uint16_t seq_num, const trtp_rtp_packet_t* rtp_packet, const uint8_t* data, tsk_size_t size)
+{
+    tdav_fec_media_t* media = &self->decoder.media[seq_num & TDAV_FEC_MEDIA_MASK];
+    tsk_size_t xsize = rtp_packet ? trtp_rtp_packet_guess_serialbuff_size(rtp_packet) : size;
+
+    if (media->capacity < xsize) {
+        if (!(media->ptr = tsk_realloc(media->ptr, xsize))) {
+            TSK_DEBUG_ERROR("Failed to realloc size %u", (unsigned)xsize);
+            media->capacity = media->size = 0;
+            media->set = tsk_false;
+            return -1;
+        }
+        media->capacity = xsize;
+    }
+    media->size = rtp_packet ? trtp_rtp_packet_serialize_to(rtp_packet, media->ptr, media->capacity) : size;
+    if (!rtp_packet) {
+        memcpy(media->ptr, data, size);
+    }
+    media->seq_num = seq_num;
+    media->set = (media->size >= TRTP_RTP_HEADER_MIN_SIZE);
+    if ((int16_t)(seq_num - self->decoder.seq_num_last) > 0) {
+        self->decoder.seq_num_last = seq_num;
+    }
+    return 0;
+}
+
+/* RFC 5109 - 8. Protection Operation / 9. Recovery Procedures
+* Recovers the single media packet missing from the mask of the FEC packet.
+* @retval 1 if a packet was recovered, 0 if all the packets are present, -1 if more than one packet is missing, -2 if the missing packet is not fully protected.
+*/
+static int _tdav_codec_ulpfec_dec_recover(tdav_codec_ulpfec_t* self, const tdav_fec_pkt_t* pkt)
+{
+    const tdav_fec_level_t* level0 = (const tdav_fec_level_t*)TSK_LIST_FIRST_DATA(pkt->levels);
+    const tsk_list_item_t* item;
+    const tdav_fec_media_t* media;
+    trtp_rtp_packet_t* rtp_packet;
+    uint16_t seq_num, seq_num_missing = 0, length;
+    uint32_t timestamp;
+    uint8_t b0, b1;
+    tsk_size_t i, j, offset, missing = 0;
+    uint8_t* out;
+
+    // the FEC header protects all the packets of the first level
+    for (i = 0; i < level0->hdr.mask_size; ++i) {
+        if (level0->hdr.mask & ((uint64_t)1 << (level0->hdr.mask_size - 1 - i))) {
+            seq_num = (uint16_t)(pkt->hdr.SN_base.value + i);
+            if (!_tdav_codec_ulpfec_dec_media_get(self, seq_num)) {
+                if (++missing > 1) {
+                    return -1;
+                }
+                seq_num_missing = seq_num;
+            }
+        }
+    }
+    if (!missing) {
+        return 0;
+    }
+
+    // 9.1. Recovery of the RTP header: XOR of the FEC header with the headers of the other packets
+    b0 = (pkt->hdr.P << 5) | (pkt->hdr.X << 4) | pkt->hdr.CC;
+    b1 = (pkt->hdr.M << 7) | pkt->hdr.PT;
+    timestamp = pkt->hdr.TS;
+    length = pkt->hdr.length;
+    for (i = 0; i < level0->hdr.mask_size; ++i) {
+        if (level0->hdr.mask & ((uint64_t)1 << (level0->hdr.mask_size - 1 - i))) {
+            if ((media = _tdav_codec_ulpfec_dec_media_get(self, (uint16_t)(pkt->hdr.SN_base.value + i)))) {
+                b0 ^= media->ptr[0];
+                b1 ^= media->ptr[1];
+                timestamp ^= ((uint32_t)media->ptr[4] << 24) | ((uint32_t)media->ptr[5] << 16) | ((uint32_t)media->ptr[6] << 8) | (uint32_t)media->ptr[7];
+                length ^= (uint16_t)(media->size - TRTP_RTP_HEADER_MIN_SIZE);
+            }
+        }
+    }
+
+    if (self->decoder.buffer.size < (TRTP_RTP_HEADER_MIN_SIZE + (tsk_size_t)length)) {
+        if (!(self->decoder.buffer.ptr = tsk_realloc(self->decoder.buffer.ptr, (TRTP_RTP_HEADER_MIN_SIZE + length)))) {
+            TSK_DEBUG_ERROR("Failed to realloc size %u", (unsigned)(TRTP_RTP_HEADER_MIN_SIZE + length));
+            self->decoder.buffer.size = 0;
+            return -3;
+        }
+        self->decoder.buffer.size = (TRTP_RTP_HEADER_MIN_SIZE + length);
+    }
+    out = self->decoder.buffer.ptr;
+    out[0] = (TRTP_RTP_VERSION << 6) | (b0 & 0x3F);
+    out[1] = b1;
+    out[2] = (seq_num_missing >> 8);
+    out[3] = (seq_num_missing & 0xFF);
+    out[4] = (timestamp >> 24);
+    out[5] = (timestamp >> 16) & 0xFF;
+    out[6] = (timestamp >> 8) & 0xFF;
+    out[7] = (timestamp & 0xFF);
+    out[8] = (self->decoder.ssrc >> 24);
+    out[9] = (self->decoder.ssrc >> 16) & 0xFF;
+    out[10] = (self->decoder.ssrc >> 8) & 0xFF;
+    out[11] = (self->decoder.ssrc & 0xFF);
+    out += TRTP_RTP_HEADER_MIN_SIZE;
+
+    // 9.2. Recovery of the payload: level #k protects the "length(k)" bytes following the ones protected by level #k-1
+    offset = 0;
+    tsk_list_foreach(item, pkt->levels) {
+        const tdav_fec_level_t* level = (const tdav_fec_level_t*)item->data;
+        tsk_size_t count;
+        if (offset >= length) {
+            break;
+        }
+        if (!(level->hdr.mask & ((uint64_t)1 << (level->hdr.mask_size - 1 - (uint16_t)(seq_num_missing - pkt->hdr.SN_base.value))))) {
+            break; // the next bytes of the missing packet are not protected
+        }
+        count = TSK_MIN(level->payload.size, (length - offset));
+        memcpy(&out[offset], level->payload.ptr, count);
+        for (i = 0; i < level->hdr.mask_size; ++i) {
+            if (level->hdr.mask & ((uint64_t)1 << (level->hdr.mask_size - 1 - i))) {
+                if ((media = _tdav_codec_ulpfec_dec_media_get(self, (uint16_t)(pkt->hdr.SN_base.value + i)))) {
+                    const uint8_t* in = &media->ptr[TRTP_RTP_HEADER_MIN_SIZE + offset];
+                    tsk_size_t in_size = (media->size - TRTP_RTP_HEADER_MIN_SIZE);
+                    in_size = (in_size > offset) ? TSK_MIN((in_size - offset), count) : 0; // shorter packets are zero-padded
+                    for (j = 0; j < in_size; ++j) {
+                        out[offset + j] ^= in[j];
+                    }
+                }
+            }
+        }
+        offset += level->payload.size;
+    }
+    if (offset < length) {
+        TSK_DEBUG_INFO("FEC: seq_num=%u only partially protected (%u/%u)", seq_num_missing, (unsigned)offset, (unsigned)length);
+        return -2;
+    }
+
+    if (!(rtp_packet = trtp_rtp_packet_deserialize(self->decoder.buffer.ptr, (TRTP_RTP_HEADER_MIN_SIZE + length)))) {
+        TSK_DEBUG_ERROR("Failed to deserialize recovered packet with seq_num=%u", seq_num_missing);
+        return -4;
+    }
+    TSK_DEBUG_INFO("FEC: recovered seq_num=%u", seq_num_missing);
+    ++self->decoder.stats.recovered_count;
+    _tdav_codec_ulpfec_dec_media_put(self, seq_num_missing, tsk_null, self->decoder.buffer.ptr, (TRTP_RTP_HEADER_MIN_SIZE + length));
+    if (self->decoder.callback) {
+        self->decoder.callback(self->decoder.callback_data, rtp_packet);
+    }
+    TSK_OBJECT_SAFE_FREE(rtp_packet);
+    return 1;
+}
+
+// tries to recover the missing packets using all FEC packets until there is no progress (a recovered packet could help another FEC packet)
+static int _tdav_codec_ulpfec_dec_process(tdav_codec_ulpfec_t* self)
+{
+    tsk_list_item_t *item, *next;
+    tsk_bool_t progress;
+    int ret;
+
+    do {
+        progress = tsk_false;
+        for (item = self->decoder.pkts->head; item; item = next) {
+            const tdav_fec_pkt_t* pkt = (const tdav_fec_pkt_t*)item->data;
+            next = item->next;
+            // media packets of the mask already overwritten?
+            if ((int16_t)(self->decoder.seq_num_last - pkt->hdr.SN_base.value) >= (TDAV_FEC_MEDIA_WINDOW - 48)) {
+                ++self->decoder.stats.unrecoverable_count;
+                tsk_list_remove_item(self->decoder.pkts, item);
+                continue;
+            }
+            ret = _tdav_codec_ulpfec_dec_recover(self, pkt);
+            if (ret == 1) {
+                progress = tsk_true;
+            }
+            if (ret >= 0) {
+                // all the packets protected by this FEC packet are now available
+                tsk_list_remove_item(self->decoder.pkts, item);
+            }
+        }
+    }
+    while (progress);
+
+    return 0;
+}
+
+/** Sets the callback called with the media packets recovered using the FEC packets */
+int tdav_codec_ulpfec_set_callback(tdav_codec_ulpfec_t* self, tdav_codec_ulpfec_rtppacket_cb_f callback, const void* callback_data)
+{
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    self->decoder.callback = callback;
+    self->decoder.callback_data = callback_data;
+    return 0;
+}
+
+/** Saves a received media packet to allow recovering the lost ones. Could call the callback if the packet completes an FEC packet (e.g. retransmitted after a NACK). */
+int tdav_codec_ulpfec_dec_put(tdav_codec_ulpfec_t* self, const trtp_rtp_packet_t* rtp_packet)
+{
+    if (!self || !rtp_packet || !rtp_packet->header) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    ++self->decoder.stats.media_count;
+    if (_tdav_codec_ulpfec_dec_media_put(self, rtp_packet->header->seq_num, rtp_packet, tsk_null, 0) != 0) {
+        return -2;
+    }
+    if (!TSK_LIST_IS_EMPTY(self->decoder.pkts)) {
+        return _tdav_codec_ulpfec_dec_process(self);
+    }
+    return 0;
+}
+
+int tdav_codec_ulpfec_dec_get_stats(const tdav_codec_ulpfec_t* self, tdav_codec_ulpfec_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    *stats = self->decoder.stats;
     return 0;
 }
 
+// Called with the payload of the FEC packets, the recovered media packets are passed to the callback
+static tsk_size_t tdav_codec_ulpfec_decode(tmedia_codec_t* self, const void* in_data, tsk_size_t in_size, void** out_data, tsk_size_t* out_max_size, const tsk_object_t* proto_hdr)
+{
+    tdav_codec_ulpfec_t* ulpfec = (tdav_codec_ulpfec_t*)self;
+    const trtp_rtp_header_t* rtp_hdr = (const trtp_rtp_header_t*)proto_hdr;
+    tdav_fec_pkt_t* pkt;
+
+    if (!ulpfec || !in_data || !in_size || !rtp_hdr) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return 0;
+    }
+
+    ++ulpfec->decoder.stats.fec_count;
+    if (!(pkt = _tdav_codec_ulpfec_dec_parse((const uint8_t*)in_data, in_size))) {
+        return 0;
+    }
+    ulpfec->decoder.ssrc = rtp_hdr->ssrc; // same SSRC as the protected media packets
+    if (tsk_list_count(ulpfec->decoder.pkts, tsk_null, tsk_null) >= TDAV_FEC_PKTS_MAX) {
+        ++ulpfec->decoder.stats.unrecoverable_count;
+        tsk_list_remove_first_item(ulpfec->decoder.pkts);
+    }
+    tsk_list_push_back_data(ulpfec->decoder.pkts, (void**)&pkt);
+    _tdav_codec_ulpfec_dec_process(ulpfec);
+
+    return 0; // must be always zero
+}
+
 static tsk_bool_t tdav_codec_ulpfec_sdp_att_match(const tmedia_codec_t* codec, const char* att_name, const char* att_value)
 {
     return tsk_true;
@@ -370,6 +718,10 @@ static tsk_object_t* tdav_codec_ulpfec_ctor(tsk_object_t * self, va_list * app)
             TSK_DEBUG_ERROR("Failed to create FEC packet");
             return tsk_null;
         }
+        if (!(ulpfec->decoder.pkts = tsk_list_create())) {
+            TSK_DEBUG_ERROR("Failed to create FEC packets list");
+            return tsk_null;
+        }
     }
     return self;
 }
@@ -382,6 +734,14 @@ static tsk_object_t* tdav_codec_ulpfec_dtor(tsk_object_t * self)
         tmedia_codec_video_deinit(ulpfec);
         /* deinit self */
         TSK_OBJECT_SAFE_FREE(ulpfec->encoder.pkt);
+        TSK_OBJECT_SAFE_FREE(ulpfec->decoder.pkts);
+        TSK_FREE(ulpfec->decoder.buffer.ptr);
+        {
+            tsk_size_t i;
+            for (i = 0; i < TDAV_FEC_MEDIA_WINDOW; ++i) {
+                TSK_FREE(ulpfec->decoder.media[i].ptr);
+            }
+        }
     }
 
     return self;
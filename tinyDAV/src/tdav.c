@@ -62,6 +62,7 @@ static struct tsk_plugin_s* __dll_plugin_ipsec_wfp = tsk_null; /* IPSec implemen
 // Sessions
 #include "tinymedia/tmedia_session_ghost.h"
 #include "tinydav/audio/tdav_session_audio.h"
+#include "tinydav/audio/tdav_audio_kernels.h"
 #include "tinydav/video/tdav_session_video.h"
 #include "tinydav/msrp/tdav_session_msrp.h"
 #include "tinydav/bfcp/tdav_session_bfcp.h"
@@ -180,6 +181,9 @@ int tdav_init()
 #   endif
 #endif
 
+    /* === Audio kernels (G.711 tables, SIMD selection) === */
+    tdav_audio_kernels_init();
+
     /* === stand-alone plugins === */
 #if TDAV_HAVE_PLUGIN_EXT_WIN32
     {
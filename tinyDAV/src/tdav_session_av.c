@@ -76,6 +76,12 @@ static const tsk_bool_t __have_libsrtp = tsk_false;
 #	define TDAV_DTLS_CONNECTION_ATT		0
 #endif
 
+// draft-holmer-rmcat-transport-wide-cc-extensions-01: RTP header extension carrying the transport-wide sequence number
+#define TDAV_TWCC_EXT_URI		"http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01"
+#if !defined(TDAV_TWCC_EXT_ID)
+#	define TDAV_TWCC_EXT_ID		5 // offered id, must be within [1-14] (RFC 5285 one-byte header)
+#endif
+
 static void* TSK_STDCALL _tdav_session_av_error_async_thread(void* usrdata);
 static int _tdav_session_av_raise_error_async(struct tdav_session_av_s* self, tsk_bool_t is_fatal, const char* reason);
 #if HAVE_SRTP
@@ -188,6 +194,7 @@ static const tsdp_header_A_t* _sdp_findA_at(const sdp_headerM_Or_Message* sdp, c
 static int _sdp_add_headerA(sdp_headerM_Or_Message* sdp, const char* field, const char* value);
 static RTP_PROFILE_T _sdp_profile_from_string(const char* profile);
 static const char* _sdp_profile_to_string(RTP_PROFILE_T profile);
+static uint8_t _sdp_extmap_find_id(const tsdp_header_M_t* m, const char* uri);
 static int32_t _sdp_acaps_indexof(const sdp_acap_xt (*acaps)[SDP_CAPS_COUNT_MAX], int32_t tag);
 static const sdp_acap_xt* _sdp_acaps_find_by_field(const sdp_acap_xt (*acaps)[SDP_CAPS_COUNT_MAX], const char* field, int32_t index);
 static int _sdp_acaps_from_sdp(const sdp_headerM_Or_Message* sdp, sdp_acap_xt (*acaps)[SDP_CAPS_COUNT_MAX], tsk_bool_t reset);
@@ -590,13 +597,14 @@ int tdav_session_av_start(tdav_session_av_t* self, const tmedia_codec_t* best_co
     }
 
     // Check if "RTCP-NACK", "RTC-FIR", "RTCP-GOOG-REMB", "RTCP-DOUBS-JCNG".... are supported by the selected encoder
-    self->is_fb_fir_neg = self->is_fb_nack_neg = self->is_fb_googremb_neg = self->is_fb_doubsjcng_neg = tsk_false;
+    self->is_fb_fir_neg = self->is_fb_nack_neg = self->is_fb_googremb_neg = self->is_fb_doubsjcng_neg = self->is_fb_twcc_neg = tsk_false;
     if (TMEDIA_SESSION(self)->M.ro) {
         // a=rtcp-fb:* ccm fir
         // a=rtcp-fb:* nack
         // a=rtcp-fb:* goog-remb
         // a=rtcp-fb:* doubs-jcng
-        char attr_fir[256], attr_nack[256], attr_goog_remb[256], attr_doubs_jcng[256];
+        // a=rtcp-fb:* transport-cc
+        char attr_fir[256], attr_nack[256], attr_goog_remb[256], attr_doubs_jcng[256], attr_twcc[256];
         int index = 0;
         const tsdp_header_A_t* A;
 
@@ -604,6 +612,7 @@ int tdav_session_av_start(tdav_session_av_t* self, const tmedia_codec_t* best_co
         sprintf(attr_nack, "%s nack", best_codec->neg_format);
         sprintf(attr_goog_remb, "%s goog-remb", best_codec->neg_format);
         sprintf(attr_doubs_jcng, "%s doubs-jcng", best_codec->neg_format);
+        sprintf(attr_twcc, "%s transport-cc", best_codec->neg_format);
 
         while ((A = tsdp_header_M_findA_at(TMEDIA_SESSION(self)->M.ro, "rtcp-fb", index++))) {
             if (!self->is_fb_fir_neg) {
@@ -618,6 +627,9 @@ int tdav_session_av_start(tdav_session_av_t* self, const tmedia_codec_t* best_co
             if (!self->is_fb_doubsjcng_neg) {
                 self->is_fb_doubsjcng_neg = (tsk_striequals(A->value, "* doubs-jcng") || tsk_striequals(A->value, attr_doubs_jcng));
             }
+            if (!self->is_fb_twcc_neg) {
+                self->is_fb_twcc_neg = (tsk_striequals(A->value, "* transport-cc") || tsk_striequals(A->value, attr_twcc));
+            }
         }
     }
 
@@ -666,6 +678,13 @@ int tdav_session_av_start(tdav_session_av_t* self, const tmedia_codec_t* best_co
             // forward up/down bandwidth info to rctp session (used in RTCP-REMB)
             ret = trtp_manager_set_app_bw_and_jcng(self->rtp_manager, bandwidth_max_upload_kbps, bandwidth_max_download_kbps, 1.f /*jcng_q*/);
         }
+        // transport-wide congestion control (video only): the RTP manager numbers the outgoing packets, reports the arrival times
+        // of the incoming ones and estimates the upload bandwidth from the remote feedback. Must be set after the bandwidth.
+        ret = trtp_manager_set_twcc_ext_id(self->rtp_manager,
+                                           (self->congestion_ctrl_enabled && self->is_fb_twcc_neg && (self->media_type & tmedia_video || (self->media_type & tmedia_bfcp_video) == tmedia_bfcp_video)) ? self->twcc_ext_id : 0);
+        // video only: the packets of each encoded frame are spread over time at the target bitrate instead of being sent back-to-back
+        ret = trtp_manager_set_pacing(self->rtp_manager,
+                                      (tmedia_defaults_get_video_pacing_enabled() && (self->media_type & tmedia_video || (self->media_type & tmedia_bfcp_video) == tmedia_bfcp_video)));
 
         // because of AudioUnit under iOS => prepare both consumer and producer then start() at the same time
         /* prepare consumer and producer */
@@ -919,6 +938,15 @@ const tsdp_header_M_t* tdav_session_av_get_lo(tdav_session_av_t* self, tsk_bool_
                                           TSDP_HEADER_A_VA_ARGS("rtcp-fb", "* goog-remb"),
                                           TSDP_HEADER_A_VA_ARGS("rtcp-fb", "* doubs-jcng"),
                                           tsk_null);
+                // draft-holmer-rmcat-transport-wide-cc-extensions-01 (answer only if offered)
+                if (self->congestion_ctrl_enabled && (!base->M.ro || self->twcc_ext_id)) {
+                    char extmap[128];
+                    sprintf(extmap, "%u %s", (unsigned)(self->twcc_ext_id ? self->twcc_ext_id : TDAV_TWCC_EXT_ID), TDAV_TWCC_EXT_URI);
+                    tsdp_header_M_add_headers(base->M.lo,
+                                              TSDP_HEADER_A_VA_ARGS("rtcp-fb", "* transport-cc"),
+                                              TSDP_HEADER_A_VA_ARGS("extmap", extmap),
+                                              tsk_null);
+                }
                 // https://tools.ietf.org/html/rfc4574
                 // http://tools.ietf.org/html/rfc4796
                 tsk_itoa(base->id, &session_id);
@@ -1446,6 +1474,9 @@ int tdav_session_av_set_ro(tdav_session_av_t* self, const struct tsdp_header_M_s
         self->avpf_mode_neg = _sdp_str_contains(base->M.ro->proto, "AVPF") ? tmedia_mode_mandatory : tmedia_mode_none;
     }
 
+    /* Transport-wide congestion control */
+    self->twcc_ext_id = _sdp_extmap_find_id(base->M.ro, TDAV_TWCC_EXT_URI);
+
     /* RFC 5939 - Session Description Protocol (SDP) Capability Negotiation */
     {
         sdp_acaps_xt acaps;
@@ -1548,7 +1579,7 @@ int tdav_session_av_set_ro(tdav_session_av_t* self, const struct tsdp_header_M_s
         int ret;
         if(is_srtp_sdes_local_enabled) {
             const tsdp_header_A_t* A;
-            const char* cryptos[2] = { tsk_null };
+            const char* cryptos[SRTP_CRYPTO_TYPES_MAX] = { tsk_null };
 
             /* 1. check crypto lines from the SDP */
             i = 0;
@@ -2057,6 +2088,20 @@ static const char* _sdp_profile_to_string(RTP_PROFILE_T profile)
     return tsk_null;
 }
 
+// RFC 5285 - 5.  SDP Signaling Design: "a=extmap:<value>["/"<direction>] <URI> <extensionattributes>"
+// returns zero if not found or if the id can't be used with the one-byte header
+static uint8_t _sdp_extmap_find_id(const tsdp_header_M_t* m, const char* uri)
+{
+    const tsdp_header_A_t* A;
+    int index = 0, id;
+    while ((A = tsdp_header_M_findA_at(m, "extmap", index++))) {
+        if (_sdp_str_contains(A->value, uri) && (id = atoi(A->value)) >= 1 && id <= 14) {
+            return (uint8_t)id;
+        }
+    }
+    return 0;
+}
+
 _SDP_DECLARE_INDEX_OF(acap);
 
 static const sdp_acap_xt* _sdp_acaps_find_by_field(const sdp_acap_xt (*acaps)[SDP_CAPS_COUNT_MAX], const char* field, int32_t index)
@@ -89,7 +89,11 @@ tdav_video_frame_t* tdav_video_frame_create(trtp_rtp_packet_t* rtp_pkt)
     }
 
     if((frame = tsk_object_new(tdav_video_frame_def_t))) {
-        rtp_pkt = tsk_object_ref(rtp_pkt);
+        // "rtp_pkt" could be a view over the network buffer
+        if(!(rtp_pkt = trtp_rtp_packet_retain(rtp_pkt))) {
+            TSK_OBJECT_SAFE_FREE(frame);
+            return tsk_null;
+        }
         frame->payload_type = rtp_pkt->header->payload_type;
         frame->timestamp = rtp_pkt->header->timestamp;
         frame->highest_seq_num = rtp_pkt->header->seq_num;
@@ -120,13 +124,12 @@ int tdav_video_frame_put(tdav_video_frame_t* self, trtp_rtp_packet_t* rtp_pkt)
     }
 #endif
 
-    rtp_pkt = tsk_object_ref(rtp_pkt);
     self->highest_seq_num = TSK_MAX(self->highest_seq_num, rtp_pkt->header->seq_num);
     tsk_list_lock(self->pkts);
     if (tdav_video_frame_find_by_seq_num(self, rtp_pkt->header->seq_num)) {
         TSK_DEBUG_INFO("JB: Packet with seq_num=%hu duplicated", rtp_pkt->header->seq_num);
     }
-    else {
+    else if((rtp_pkt = trtp_rtp_packet_retain(rtp_pkt))) { // "rtp_pkt" could be a view over the network buffer
         tsk_list_push_ascending_data(self->pkts, (void**)&rtp_pkt);
     }
     tsk_list_unlock(self->pkts);
@@ -0,0 +1,654 @@
+/*
+ * Copyright (C) 2011-2015 Mamadou DIOP
+ * Copyright (C) 2011-2015 Doubango Telecom <http://www.doubango.org>
+ *
+ * This file is part of Open Source Doubango Framework.
+ *
+ * DOUBANGO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * DOUBANGO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with DOUBANGO.
+ *
+ */
+
+/**@file tdav_video_jb_ring.c
+ * @brief Video Jitter Buffer using a ring of slots indexed by RTP sequence number
+ *
+ * The slot for a packet is "seq_num & TDAV_VIDEO_JB_RING_MASK". The ring covers the sequence numbers in [seq_num_base, seq_num_base + TDAV_VIDEO_JB_RING_SIZE):
+ * "seq_num_base" is the first packet not decoded yet (or being decoded). A frame is the run of packets with the same timestamp, ended by the marker bit.
+ */
+#include "tinydav/video/jb/tdav_video_jb_ring.h"
+
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+
+#include "tsk_time.h"
+#include "tsk_memory.h"
+#include "tsk_thread.h"
+#include "tsk_condwait.h"
+#include "tsk_safeobj.h"
+#include "tsk_debug.h"
+
+// Number of slots (log2). Must be large enough to hold "latency_max" frames.
+#if !defined(TDAV_VIDEO_JB_RING_SIZE_LOG2)
+#	if TDAV_UNDER_MOBILE /* to avoid too high memory usage */
+#		define TDAV_VIDEO_JB_RING_SIZE_LOG2	9 /* 512 packets */
+#	else
+#		define TDAV_VIDEO_JB_RING_SIZE_LOG2	11 /* 2048 packets, more than one second at 1080p */
+#	endif
+#endif
+#define TDAV_VIDEO_JB_RING_SIZE		(1 << TDAV_VIDEO_JB_RING_SIZE_LOG2)
+#define TDAV_VIDEO_JB_RING_MASK		(TDAV_VIDEO_JB_RING_SIZE - 1)
+// Preallocated memory per slot. Bigger packets get their own buffer.
+#if !defined(TDAV_VIDEO_JB_RING_SLOT_SIZE)
+#	define TDAV_VIDEO_JB_RING_SLOT_SIZE	1500
+#endif
+
+// same defaults as "tdav_video_jb"
+#define TDAV_VIDEO_JB_RING_FPS			TDAV_VIDEO_JB_RING_FPS_MAX
+#define TDAV_VIDEO_JB_RING_FPS_MIN		10
+#define TDAV_VIDEO_JB_RING_FPS_MAX		120
+#define TDAV_VIDEO_JB_RING_FPS_PROB		(TDAV_VIDEO_JB_RING_FPS << 1)
+#define TDAV_VIDEO_JB_RING_RATE			90 /* KHz */
+#define TDAV_VIDEO_JB_RING_LATENCY_MIN	2 /* Must be > 0 */
+#define TDAV_VIDEO_JB_RING_LATENCY_MAX	15 /* Default, will be updated using fps */
+
+typedef struct tdav_video_jb_ring_slot_s {
+    uint8_t* ptr; // serialized RTP packet
+    tsk_size_t size;
+    tsk_size_t capacity;
+    tsk_bool_t owned; // whether "ptr" was allocated for this slot (packet bigger than TDAV_VIDEO_JB_RING_SLOT_SIZE)
+
+    tsk_bool_t used;
+    uint16_t seq_num; // valid if "used" or "nack_count" > 0
+    uint32_t timestamp;
+    tsk_bool_t marker;
+    uint8_t nack_count; // number of times the missing packet was signaled
+}
+tdav_video_jb_ring_slot_t;
+
+typedef struct tdav_video_jb_ring_s {
+    TSK_DECLARE_OBJECT;
+
+    tsk_bool_t started;
+    int32_t fps;
+    int32_t fps_prob;
+    int32_t avg_duration;
+    int32_t rate; // in Khz
+    uint32_t last_timestamp;
+    int64_t frames_count;
+
+    tsk_size_t latency_min;
+    tsk_size_t latency_max;
+
+    tsk_bool_t synced; // whether the sequence numbers are valid
+    tsk_bool_t decoding; // whether a frame was sent to the decoder since the sync
+    tsk_bool_t overflow; // flush requested by put()
+    uint16_t seq_num_base; // lowest sequence number owned by the ring (first packet being decoded or "seq_num_next")
+    uint16_t seq_num_next; // first packet of the next frame to decode
+    uint16_t seq_num_highest; // highest sequence number received
+    uint32_t timestamp_highest; // timestamp of the newest frame
+
+    tdav_video_jb_ring_slot_t slots[TDAV_VIDEO_JB_RING_SIZE];
+    uint8_t* slab; // preallocated memory for all slots
+
+    tsk_thread_handle_t* decode_thread[1];
+    tsk_condwait_handle_t* decode_thread_cond;
+
+    tdav_video_jb_cb_f callback;
+    // to avoid locking use different cb_data
+    tdav_video_jb_cb_data_xt cb_data_rtp;
+    tdav_video_jb_cb_data_xt cb_data_any;
+    uint32_t ssrc;
+
+    tdav_video_jb_ring_stats_t stats;
+
+    TSK_DECLARE_SAFEOBJ;
+}
+tdav_video_jb_ring_t;
+
+#define _tdav_video_jb_ring_slot(self, seq_num) (&(self)->slots[(seq_num) & TDAV_VIDEO_JB_RING_MASK])
+#define _tdav_video_jb_ring_has(self, seq_num) (_tdav_video_jb_ring_slot((self), (seq_num))->used && _tdav_video_jb_ring_slot((self), (seq_num))->seq_num == (seq_num))
+
+static int _tdav_video_jb_ring_set_defaults(tdav_video_jb_ring_t* self);
+static void* TSK_STDCALL _tdav_video_jb_ring_decode_thread_func(void *arg);
+
+static tsk_object_t* tdav_video_jb_ring_ctor(tsk_object_t * self, va_list * app)
+{
+    tdav_video_jb_ring_t *jb = self;
+    if (jb) {
+        tsk_size_t i;
+        if (!(jb->slab = tsk_malloc(TDAV_VIDEO_JB_RING_SIZE * TDAV_VIDEO_JB_RING_SLOT_SIZE))) {
+            TSK_DEBUG_ERROR("Failed to allocate %u bytes", (unsigned)(TDAV_VIDEO_JB_RING_SIZE * TDAV_VIDEO_JB_RING_SLOT_SIZE));
+            return tsk_null;
+        }
+        for (i = 0; i < TDAV_VIDEO_JB_RING_SIZE; ++i) {
+            jb->slots[i].ptr = &jb->slab[i * TDAV_VIDEO_JB_RING_SLOT_SIZE];
+            jb->slots[i].capacity = TDAV_VIDEO_JB_RING_SLOT_SIZE;
+        }
+        if (!(jb->decode_thread_cond = tsk_condwait_create())) {
+            TSK_DEBUG_ERROR("Failed to create condition var");
+            return tsk_null;
+        }
+        jb->cb_data_rtp.type = tdav_video_jb_cb_data_type_rtp;
+
+        tsk_safeobj_init(jb);
+    }
+    return self;
+}
+static tsk_object_t* tdav_video_jb_ring_dtor(tsk_object_t * self)
+{
+    tdav_video_jb_ring_t *jb = self;
+    if (jb) {
+        tsk_size_t i;
+        if (jb->started) {
+            tdav_video_jb_ring_stop(jb);
+        }
+        if (jb->decode_thread_cond) {
+            tsk_condwait_destroy(&jb->decode_thread_cond);
+        }
+        for (i = 0; i < TDAV_VIDEO_JB_RING_SIZE; ++i) {
+            if (jb->slots[i].owned) {
+                TSK_FREE(jb->slots[i].ptr);
+            }
+        }
+        TSK_FREE(jb->slab);
+        tsk_safeobj_deinit(jb);
+    }
+
+    return self;
+}
+static const tsk_object_def_t tdav_video_jb_ring_def_s = {
+    sizeof(tdav_video_jb_ring_t),
+    tdav_video_jb_ring_ctor,
+    tdav_video_jb_ring_dtor,
+    tsk_null,
+};
+
+tdav_video_jb_ring_t* tdav_video_jb_ring_create()
+{
+    tdav_video_jb_ring_t* jb;
+
+    if ((jb = tsk_object_new(&tdav_video_jb_ring_def_s))) {
+        if (_tdav_video_jb_ring_set_defaults(jb) != 0) {
+            TSK_OBJECT_SAFE_FREE(jb);
+        }
+    }
+    return jb;
+}
+
+#define tdav_video_jb_ring_reset_fps_prob(self) {\
+(self)->fps_prob = TDAV_VIDEO_JB_RING_FPS_PROB; \
+(self)->last_timestamp = 0; \
+(self)->avg_duration = 0; \
+}
+
+int tdav_video_jb_ring_set_callback(tdav_video_jb_ring_t* self, tdav_video_jb_cb_f callback, const void* usr_data)
+{
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    self->callback = callback;
+    self->cb_data_any.usr_data = usr_data;
+    self->cb_data_rtp.usr_data = usr_data;
+    return 0;
+}
+
+// Congestion quality metrics based (same as "tdav_video_jb_get_qcong()")
+int tdav_video_jb_ring_get_qcong(tdav_video_jb_ring_t* self, float* q)
+{
+    float lm;
+    if (!self || !q) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    lm = (float)self->latency_max;
+    if (lm <= 0.f) {
+        *q = 1.f;
+    }
+    else {
+        *q = 1.f - (self->frames_count / lm);
+    }
+    *q = TSK_CLAMP(0.0001f, *q, 1.f);
+    return 0;
+}
+
+int tdav_video_jb_ring_get_stats(tdav_video_jb_ring_t* self, tdav_video_jb_ring_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    *stats = self->stats;
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+int tdav_video_jb_ring_start(tdav_video_jb_ring_t* self)
+{
+    int ret = 0;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (self->started) {
+        return 0;
+    }
+
+    self->started = tsk_true;
+
+    if (!self->decode_thread[0]) {
+        ret = tsk_thread_create(&self->decode_thread[0], _tdav_video_jb_ring_decode_thread_func, self);
+        if (ret != 0 || !self->decode_thread[0]) {
+            TSK_DEBUG_ERROR("Failed to create new thread");
+        }
+        ret = tsk_thread_set_priority(self->decode_thread[0], TSK_THREAD_PRIORITY_TIME_CRITICAL);
+    }
+
+    return ret;
+}
+
+// signals the lost packets in [seq_num_start, seq_num_end), must be called with the lock held
+static void _tdav_video_jb_ring_signal_loss(tdav_video_jb_ring_t* self, uint16_t seq_num_start, uint16_t seq_num_end, uint8_t nack_count_max)
+{
+    tdav_video_jb_ring_slot_t* slot;
+    uint16_t seq_num, range_start = 0;
+    tsk_size_t range_count = 0;
+
+    for (seq_num = seq_num_start; ; ++seq_num) {
+        tsk_bool_t request = tsk_false;
+        if (seq_num != seq_num_end && !_tdav_video_jb_ring_has(self, seq_num)) {
+            slot = _tdav_video_jb_ring_slot(self, seq_num);
+            if (slot->seq_num != seq_num) {
+                slot->seq_num = seq_num;
+                slot->nack_count = 0;
+            }
+            if ((request = (slot->nack_count < nack_count_max))) {
+                ++slot->nack_count;
+            }
+        }
+        if (request) {
+            if (!range_count++) {
+                range_start = seq_num;
+            }
+        }
+        else if (range_count) {
+            // report the whole range at once, the session will split it into RTCP-NACK FCIs
+            self->stats.pkts_nacked += range_count;
+            if (self->callback) {
+                self->cb_data_any.type = tdav_video_jb_cb_data_type_fl;
+                self->cb_data_any.ssrc = self->ssrc;
+                self->cb_data_any.fl.seq_num = range_start;
+                self->cb_data_any.fl.count = range_count;
+                self->callback(&self->cb_data_any);
+            }
+            range_count = 0;
+        }
+        if (seq_num == seq_num_end) {
+            break;
+        }
+    }
+}
+
+int tdav_video_jb_ring_put(tdav_video_jb_ring_t* self, const trtp_rtp_packet_t* rtp_pkt)
+{
+    tdav_video_jb_ring_slot_t* slot;
+    tsk_size_t size;
+    uint16_t seq_num;
+    int32_t diff;
+
+    if (!self || !rtp_pkt || !rtp_pkt->header) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    if (!self->started) {
+        TSK_DEBUG_INFO("Video jitter buffer not started");
+        return 0;
+    }
+
+    seq_num = rtp_pkt->header->seq_num;
+
+    tsk_safeobj_lock(self);
+
+    if (!self->synced) {
+        self->seq_num_base = self->seq_num_next = seq_num;
+        self->seq_num_highest = (uint16_t)(seq_num - 1);
+        self->timestamp_highest = (rtp_pkt->header->timestamp - 1);
+        self->synced = tsk_true;
+        self->decoding = tsk_false;
+    }
+    else if (!self->decoding && (int16_t)(seq_num - self->seq_num_next) < 0 && (uint16_t)(self->seq_num_highest - seq_num) < TDAV_VIDEO_JB_RING_SIZE) {
+        // reordered before the first frame is decoded
+        self->seq_num_base = self->seq_num_next = seq_num;
+    }
+    self->ssrc = rtp_pkt->header->ssrc;
+
+    if ((int16_t)(seq_num - self->seq_num_next) < 0) {
+        TSK_DEBUG_INFO("--------Frame already Decoded [seqnum=%u]------------", seq_num);
+        ++self->stats.pkts_late;
+        goto bail;
+    }
+    if ((uint16_t)(seq_num - self->seq_num_base) >= TDAV_VIDEO_JB_RING_SIZE) {
+        TSK_DEBUG_INFO("Video jitter buffer overflow [%u - %u]", self->seq_num_base, seq_num);
+        self->overflow = tsk_true;
+        tsk_condwait_signal(self->decode_thread_cond);
+        goto bail;
+    }
+
+    slot = _tdav_video_jb_ring_slot(self, seq_num);
+    if (slot->used && slot->seq_num == seq_num) {
+        TSK_DEBUG_INFO("JB: Packet with seq_num=%hu duplicated", seq_num);
+        ++self->stats.pkts_dup;
+        goto bail;
+    }
+
+    // copy the packet into the slot
+    size = trtp_rtp_packet_guess_serialbuff_size(rtp_pkt);
+    if (size > slot->capacity) {
+        uint8_t* ptr = slot->owned ? slot->ptr : tsk_null;
+        if (!(ptr = tsk_realloc(ptr, size))) {
+            TSK_DEBUG_ERROR("Failed to allocate %u bytes", (unsigned)size);
+            goto bail;
+        }
+        slot->ptr = ptr;
+        slot->capacity = size;
+        slot->owned = tsk_true;
+    }
+    if (!(slot->size = trtp_rtp_packet_serialize_to(rtp_pkt, slot->ptr, slot->capacity))) {
+        goto bail;
+    }
+    slot->seq_num = seq_num;
+    slot->timestamp = rtp_pkt->header->timestamp;
+    slot->marker = rtp_pkt->header->marker;
+    slot->used = tsk_true;
+    ++self->stats.pkts_received;
+
+    diff = (int16_t)(seq_num - self->seq_num_highest);
+    if (diff > 0) {
+        if (diff > 1) {
+            TSK_DEBUG_INFO("Packet loss (from JB) [%hu - %hu]", self->seq_num_highest, seq_num);
+            tdav_video_jb_ring_reset_fps_prob(self);
+            _tdav_video_jb_ring_signal_loss(self, (uint16_t)(self->seq_num_highest + 1), seq_num, 1);
+        }
+        self->seq_num_highest = seq_num;
+
+        // new frame?
+        if ((int32_t)(rtp_pkt->header->timestamp - self->timestamp_highest) > 0) {
+            self->timestamp_highest = rtp_pkt->header->timestamp;
+            // compute avg frame duration
+            if (self->last_timestamp && self->last_timestamp < rtp_pkt->header->timestamp) {
+                uint32_t duration = (rtp_pkt->header->timestamp - self->last_timestamp)/self->rate;
+                self->avg_duration = self->avg_duration ? ((self->avg_duration + duration) >> 1) : duration;
+                --self->fps_prob;
+            }
+            self->last_timestamp = rtp_pkt->header->timestamp;
+            ++self->frames_count;
+
+            if (self->fps_prob <= 0 && self->avg_duration) {
+                // compute FPS using timestamp values
+                int32_t fps_new = (1000 / self->avg_duration);
+                int32_t fps_old = self->fps;
+                self->fps = TSK_CLAMP(TDAV_VIDEO_JB_RING_FPS_MIN, fps_new, TDAV_VIDEO_JB_RING_FPS_MAX);
+                self->latency_max = self->fps; // maximum = 1 second
+                TSK_DEBUG_INFO("According to rtp-timestamps ...FPS = %d (clipped to %d) latency_max=%u", fps_new, self->fps, (unsigned)self->latency_max);
+                tdav_video_jb_ring_reset_fps_prob(self);
+                if (self->callback && (fps_old != self->fps)) {
+                    self->cb_data_any.type = tdav_video_jb_cb_data_type_fps_changed;
+                    self->cb_data_any.ssrc = rtp_pkt->header->ssrc;
+                    self->cb_data_any.fps.new = self->fps; // clipped value
+                    self->cb_data_any.fps.old = fps_old;
+                    self->callback(&self->cb_data_any);
+                }
+            }
+        }
+    }
+
+bail:
+    tsk_safeobj_unlock(self);
+
+    return 0;
+}
+
+int tdav_video_jb_ring_stop(tdav_video_jb_ring_t* self)
+{
+    int ret;
+    tsk_size_t i;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!self->started) {
+        return 0;
+    }
+
+    TSK_DEBUG_INFO("tdav_video_jb_ring_stop()");
+
+    self->started = tsk_false;
+
+    ret = tsk_condwait_broadcast(self->decode_thread_cond);
+
+    if (self->decode_thread[0]) {
+        ret = tsk_thread_join(&self->decode_thread[0]);
+    }
+
+    // clear pending frames
+    tsk_safeobj_lock(self);
+    for (i = 0; i < TDAV_VIDEO_JB_RING_SIZE; ++i) {
+        self->slots[i].used = tsk_false;
+        self->slots[i].nack_count = 0;
+    }
+    _tdav_video_jb_ring_set_defaults(self);
+    tsk_safeobj_unlock(self);
+
+    return ret;
+}
+
+static int _tdav_video_jb_ring_set_defaults(tdav_video_jb_ring_t* self)
+{
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    self->fps = TDAV_VIDEO_JB_RING_FPS;
+    self->fps_prob = TDAV_VIDEO_JB_RING_FPS_PROB;
+    self->avg_duration = 0;
+    self->last_timestamp = 0;
+    self->rate = TDAV_VIDEO_JB_RING_RATE;
+    self->frames_count = 0;
+    self->synced = tsk_false;
+    self->overflow = tsk_false;
+
+    self->latency_min = TDAV_VIDEO_JB_RING_LATENCY_MIN;
+    self->latency_max = TDAV_VIDEO_JB_RING_LATENCY_MAX;
+
+    return 0;
+}
+
+/* Finds the packets of the next frame to decode, must be called with the lock held.
+* @param seq_num_end Sequence number following the last packet of the frame.
+* @param missing_count Number of packets missing in the frame.
+* @retval True if the frame is complete: no packet missing and the marker bit received.
+*/
+static tsk_bool_t _tdav_video_jb_ring_frame_get(tdav_video_jb_ring_t* self, uint16_t* seq_num_end, tsk_size_t* missing_count)
+{
+    const tdav_video_jb_ring_slot_t* slot;
+    uint16_t seq_num, seq_num_stop = (uint16_t)(self->seq_num_highest + 1);
+    uint32_t timestamp;
+    tsk_bool_t marker = tsk_false;
+
+    *seq_num_end = self->seq_num_next;
+    *missing_count = 0;
+
+    // first packet of the frame
+    for (seq_num = self->seq_num_next; seq_num != seq_num_stop && !_tdav_video_jb_ring_has(self, seq_num); ++seq_num) ;
+    if (seq_num == seq_num_stop) {
+        return tsk_false;
+    }
+    timestamp = _tdav_video_jb_ring_slot(self, seq_num)->timestamp;
+
+    for (; seq_num != seq_num_stop; ++seq_num) {
+        if (!_tdav_video_jb_ring_has(self, seq_num)) {
+            continue;
+        }
+        slot = _tdav_video_jb_ring_slot(self, seq_num);
+        if (slot->timestamp != timestamp) {
+            break; // next frame
+        }
+        *seq_num_end = (uint16_t)(seq_num + 1);
+        if ((marker = slot->marker)) {
+            break;
+        }
+    }
+    // packets missing before the last one of the frame
+    for (seq_num = self->seq_num_next; seq_num != *seq_num_end; ++seq_num) {
+        if (!_tdav_video_jb_ring_has(self, seq_num)) {
+            ++(*missing_count);
+        }
+    }
+    return (marker && !*missing_count);
+}
+
+static void* TSK_STDCALL _tdav_video_jb_ring_decode_thread_func(void *arg)
+{
+    tdav_video_jb_ring_t* jb = (tdav_video_jb_ring_t*)arg;
+    tdav_video_jb_ring_slot_t* slot;
+    trtp_rtp_packet_view_t view;
+    trtp_rtp_packet_t* pkt;
+    uint64_t next_decode_duration = 0, now, _now, latency = 0;
+    uint16_t seq_num, seq_num_end;
+    tsk_size_t missing_count;
+    tsk_bool_t complete, postpone, cleaning_delay = tsk_false;
+
+    TSK_DEBUG_INFO("Video jitter buffer (ring) thread - ENTER");
+
+    while (jb->started) {
+        now = tsk_time_now();
+        if (next_decode_duration > 0) {
+            tsk_condwait_timedwait(jb->decode_thread_cond, next_decode_duration);
+        }
+
+        if (!jb->started) {
+            break;
+        }
+
+        // ring overflow (decoder too slow or too much jitter): flush and request an IDR
+        if (jb->overflow) {
+            tsk_safeobj_lock(jb);
+            if (jb->overflow) { // check again with the lock held
+                for (seq_num = 0; seq_num < TDAV_VIDEO_JB_RING_SIZE; ++seq_num) {
+                    jb->slots[seq_num].used = tsk_false;
+                    jb->slots[seq_num].nack_count = 0;
+                }
+                jb->frames_count = 0;
+                jb->synced = tsk_false;
+                jb->overflow = tsk_false;
+                ++jb->stats.resets;
+                tdav_video_jb_ring_reset_fps_prob(jb);
+                if (jb->callback) {
+                    jb->cb_data_any.type = tdav_video_jb_cb_data_type_tmfr;
+                    jb->cb_data_any.ssrc = jb->ssrc;
+                    jb->callback(&jb->cb_data_any);
+                }
+            }
+            tsk_safeobj_unlock(jb);
+            next_decode_duration = 0;
+            continue;
+        }
+
+        // same policy as "tdav_video_jb": wait for "latency_min" frames, or decode after "latency_max" iterations
+        if (jb->frames_count >= (int64_t)jb->latency_min || (jb->frames_count > 0 && latency >= jb->latency_max)) {
+            postpone = tsk_false;
+            latency = 0;
+
+            tsk_safeobj_lock(jb);
+            complete = jb->synced && _tdav_video_jb_ring_frame_get(jb, &seq_num_end, &missing_count);
+            if (!jb->synced || (!complete && seq_num_end == jb->seq_num_next)) {
+                jb->frames_count = 0; // nothing to decode
+                postpone = tsk_true;
+            }
+            else if (!complete && jb->frames_count < (int64_t)jb->latency_max) {
+                // is it still acceptable to wait for missing packets? request them again (only one time)
+                TSK_DEBUG_INFO("Time to decode frame...but some RTP packets are missing (seq_num=[%u - %u], missing_count=%u). Postpone :(", jb->seq_num_next, seq_num_end, (unsigned)missing_count);
+                _tdav_video_jb_ring_signal_loss(jb, jb->seq_num_next, seq_num_end, 2);
+                postpone = tsk_true;
+            }
+            else {
+                if (!complete) {
+                    TSK_DEBUG_INFO("frames_count(%lld)>=latency_max(%u)...decoding video frame even if pkts are missing :(", jb->frames_count, (unsigned)jb->latency_max);
+                    jb->stats.pkts_lost += missing_count;
+                    ++jb->stats.frames_incomplete;
+                }
+                // the slots in [seq_num_base, seq_num_end) are read without the lock: put() will consider these packets as late
+                // and won't reuse the slots until "seq_num_base" is updated
+                jb->seq_num_base = jb->seq_num_next;
+                jb->seq_num_next = seq_num_end;
+                jb->decoding = tsk_true;
+                if (jb->frames_count > 0) {
+                    --jb->frames_count;
+                }
+                ++jb->stats.frames_decoded;
+            }
+            tsk_safeobj_unlock(jb);
+
+            if (!postpone) {
+                for (seq_num = jb->seq_num_base; seq_num != seq_num_end && jb->started; ++seq_num) {
+                    slot = _tdav_video_jb_ring_slot(jb, seq_num);
+                    if (!slot->used || slot->seq_num != seq_num) {
+                        continue;
+                    }
+                    // view over the slot: no allocation, no copy
+                    if (jb->callback && (pkt = trtp_rtp_packet_view_init(&view, slot->ptr, slot->size)) && pkt->payload.size) {
+                        jb->cb_data_rtp.rtp.pkt = pkt;
+                        jb->callback(&jb->cb_data_rtp);
+                    }
+                }
+
+                tsk_safeobj_lock(jb);
+                for (seq_num = jb->seq_num_base; seq_num != seq_num_end; ++seq_num) {
+                    slot = _tdav_video_jb_ring_slot(jb, seq_num);
+                    slot->used = tsk_false;
+                    slot->nack_count = 0;
+                }
+                jb->seq_num_base = jb->seq_num_next;
+                tsk_safeobj_unlock(jb);
+            }
+        }
+        else {
+            if (jb->frames_count > 0) { // there are pending frames but we cannot display them yet -> increase latency
+                latency++;
+            }
+        }
+
+        if (cleaning_delay || jb->frames_count > (int64_t)jb->latency_max) {
+            next_decode_duration = 0;
+            cleaning_delay = ((jb->frames_count << 1) > (int64_t)jb->latency_max); // cleanup up2 half
+        }
+        else {
+            next_decode_duration = (1000 / jb->fps);
+            _now = tsk_time_now();
+            if (_now > now) {
+                if ((_now - now) > next_decode_duration) {
+                    next_decode_duration = 0;
+                }
+                else {
+                    next_decode_duration -= (_now - now);
+                }
+            }
+        }
+    }
+
+    TSK_DEBUG_INFO("Video jitter buffer (ring) thread - EXIT");
+
+    return tsk_null;
+}
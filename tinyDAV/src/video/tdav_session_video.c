@@ -27,6 +27,7 @@
 #include "tinydav/video/tdav_session_video.h"
 #include "tinydav/video/tdav_converter_video.h"
 #include "tinydav/video/jb/tdav_video_jb.h"
+#include "tinydav/video/jb/tdav_video_jb_ring.h"
 #include "tinydav/codecs/fec/tdav_codec_red.h"
 #include "tinydav/codecs/fec/tdav_codec_ulpfec.h"
 
@@ -67,6 +68,9 @@
 // Interval to compute average quality metrics
 #define TDAV_SESSION_VIDEO_QOS_COMPUTE_INTERVAL					3000
 
+// The quality metrics set the upload bandwidth again when no RTCP-TWCC is received during this time
+#define TDAV_SESSION_VIDEO_TWCC_TIMEOUT							(TDAV_SESSION_VIDEO_QOS_COMPUTE_INTERVAL << 1)
+
 // The maximum number of pakcet loss allowed
 #define TDAV_SESSION_VIDEO_PKT_LOSS_MAX_COUNT_TO_REQUEST_FIR	50
 
@@ -115,6 +119,8 @@ static int _tdav_session_video_codec_set_int32(tdav_session_video_t* self, const
 static int _tdav_session_video_jb_cb(const tdav_video_jb_cb_data_xt* data);
 static int _tdav_session_video_open_decoder(tdav_session_video_t* self, uint8_t payload_type);
 static int _tdav_session_video_decode(tdav_session_video_t* self, const trtp_rtp_packet_t* packet);
+static int _tdav_session_video_jb_put(tdav_session_video_t* self, const trtp_rtp_packet_t* packet);
+static int _tdav_session_video_ulpfec_cb(const void* callback_data, const struct trtp_rtp_packet_s* packet);
 static int _tdav_session_video_set_callbacks(tmedia_session_t* self);
 static int _tdav_session_video_timer_cb(const void* arg, tsk_timer_id_t timer_id);
 static int _tdav_session_video_get_bw_usage_est(tdav_session_video_t* self, uint64_t* bw_kbps, tsk_bool_t in, tsk_bool_t reset);
@@ -205,6 +211,11 @@ static int tdav_session_video_raw_cb(const tmedia_video_encode_result_xt* result
             packet->payload.size = result->buffer.size;
             s = trtp_manager_send_rtp_packet(base->rtp_manager, packet, tsk_false); // encrypt and send data
             ++base->rtp_manager->rtp.seq_num; // seq_num must be incremented here (before the bail) because already used by SRTP context
+            if (base->rtp_manager->rtp.serial_buffer.last && (((const uint8_t*)base->rtp_manager->rtp.serial_buffer.last)[0] & 0x10)) {
+                // header extension added by the manager (transport-wide sequence number): kept as the first bytes of the saved payload
+                // so that the retransmissions (and FEC) are identical to the original packet (also required by SRTP authentication)
+                packet->header->extension = 1;
+            }
             if(s < TRTP_RTP_HEADER_MIN_SIZE) {
                 // without audio session iOS "audio" background mode is useless and UDP sockets will be closed: e.g. GE's video-only sessions
 #if TDAV_UNDER_IPHONE
@@ -221,7 +232,7 @@ static int tdav_session_video_raw_cb(const tmedia_video_encode_result_xt* result
             // Save packet
             if (base->avpf_mode_neg && (s > TRTP_RTP_HEADER_MIN_SIZE)) {
                 trtp_rtp_packet_t* packet_avpf = tsk_object_ref(packet);
-                // when SRTP is used, "serial_buffer" will contains the encoded buffer with both RTP header and payload
+                // when SRTP is used, "serial_buffer.last" will contains the encoded buffer with both RTP header and payload
                 // Hack the RTP packet payload to point to the the SRTP data instead of unencrypted ptr
                 packet_avpf->payload.size = (s - rtp_hdr_size);
                 packet_avpf->payload.data_const = tsk_null;
@@ -229,7 +240,7 @@ static int tdav_session_video_raw_cb(const tmedia_video_encode_result_xt* result
                     TSK_DEBUG_ERROR("failed to allocate buffer");
                     goto bail;
                 }
-                memcpy(packet_avpf->payload.data, (((const uint8_t*)base->rtp_manager->rtp.serial_buffer.ptr) + rtp_hdr_size), packet_avpf->payload.size);
+                memcpy(packet_avpf->payload.data, (((const uint8_t*)base->rtp_manager->rtp.serial_buffer.last) + rtp_hdr_size), packet_avpf->payload.size);
                 tsk_list_lock(video->avpf.packets);
                 if(video->avpf.count > video->avpf.max) {
                     tsk_list_remove_first_item(video->avpf.packets);
@@ -251,7 +262,7 @@ static int tdav_session_video_raw_cb(const tmedia_video_encode_result_xt* result
             // Send FEC packet
             // FIXME: protect only Intra and Params packets
             if(base->ulpfec.codec && (s > TRTP_RTP_HEADER_MIN_SIZE)) {
-                packet->payload.data_const = (((const uint8_t*)base->rtp_manager->rtp.serial_buffer.ptr) + rtp_hdr_size);
+                packet->payload.data_const = (((const uint8_t*)base->rtp_manager->rtp.serial_buffer.last) + rtp_hdr_size);
                 packet->payload.size = (s - rtp_hdr_size);
                 ret = tdav_codec_ulpfec_enc_protect((struct tdav_codec_ulpfec_s*)base->ulpfec.codec, packet);
                 if(result->last_chunck) {
@@ -460,7 +471,8 @@ static int tdav_session_video_producer_enc_cb(const void* callback_data, const v
             }
         }
 
-        // Encode data
+        // Encode data: all RTP packets produced for the frame are sent at once
+        trtp_manager_send_batch_begin(base->rtp_manager);
         tsk_mutex_lock(video->encoder.h_mutex);
         if (video->started && codec_encoder->opened && !video->encoder.size_changed) { // stop() function locks the encoder mutex before changing "started"
             if (video->encoder.conv_buffer && yuv420p_size) {
@@ -473,6 +485,7 @@ static int tdav_session_video_producer_enc_cb(const void* callback_data, const v
             }
         }
         tsk_mutex_unlock(video->encoder.h_mutex);
+        trtp_manager_send_batch_flush(base->rtp_manager);
 
         if (out_size) {
             /* Never called, see tdav_session_video_raw_cb() */
@@ -529,14 +542,33 @@ static int tdav_session_video_rtp_cb(const void* callback_data, const trtp_rtp_p
             TSK_DEBUG_ERROR("No ULPFEC codec could be found");
             return -2;
         }
-        // FIXME: do something
+        // Recover lost packets: "_tdav_session_video_ulpfec_cb" called for each one
+        base->ulpfec.codec->plugin->decode(
+            base->ulpfec.codec,
+            (packet->payload.data ? packet->payload.data : packet->payload.data_const), packet->payload.size,
+            tsk_null, tsk_null,
+            packet->header
+        );
         return 0;
     }
     else {
-        return video->jb
-               ? tdav_video_jb_put(video->jb, (trtp_rtp_packet_t*)packet)
-               : _tdav_session_video_decode(video, packet);
+        if (base->ulpfec.codec) {
+            // keep a copy to recover the lost packets (could call "_tdav_session_video_ulpfec_cb" before returning)
+            tdav_codec_ulpfec_dec_put((struct tdav_codec_ulpfec_s*)base->ulpfec.codec, packet);
+        }
+        return _tdav_session_video_jb_put(video, packet);
+    }
+}
+
+// ULPFEC callback (FEC decoder -> JitterBuffer or Decoder)
+static int _tdav_session_video_ulpfec_cb(const void* callback_data, const struct trtp_rtp_packet_s* packet)
+{
+    tdav_session_video_t* video = (tdav_session_video_t*)callback_data;
+    if (!video || !packet) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
     }
+    return _tdav_session_video_jb_put(video, packet);
 }
 
 // RTCP callback (Network -> This)
@@ -630,6 +662,23 @@ static int tdav_session_video_rtcp_cb(const void* callback_data, const trtp_rtcp
         switch(rtpfb->fci_type) {
         default:
             break;
+        case trtp_rtcp_rtpfb_fci_type_twcc: {
+            // already processed by the RTP manager (send-side bandwidth estimation): forward the new target to the encoder
+            int32_t bw_kbps;
+            if (base->congestion_ctrl_enabled && trtp_manager_get_bwe_target_kbps(base->rtp_manager, &bw_kbps) == 0) {
+                if (base->bandwidth_max_upload_kbps > 0) {
+                    bw_kbps = TSK_MIN(bw_kbps, base->bandwidth_max_upload_kbps);
+                }
+                // do not reconfigure the encoder for small changes (<5%)
+                if (!video->twcc.bw_kbps || (TSK_ABS(bw_kbps - video->twcc.bw_kbps) * 20) > video->twcc.bw_kbps) {
+                    TSK_DEBUG_INFO("RTCP-TWCC: changing bw_up from %dkbps to %dkbps", video->twcc.bw_kbps, bw_kbps);
+                    _tdav_session_video_bw_kbps(video, bw_kbps);
+                    video->twcc.bw_kbps = bw_kbps;
+                }
+                video->twcc.time = tsk_time_now();
+            }
+            break;
+        }
         case trtp_rtcp_rtpfb_fci_type_nack: {
             if(rtpfb->nack.blp && rtpfb->nack.pid) {
                 tsk_size_t i;
@@ -659,7 +708,7 @@ static int tdav_session_video_rtcp_cb(const void* callback_data, const trtp_rtcp
                                 if(pkt_rtp->header->seq_num == pid) {
                                     ++r;
                                     TSK_DEBUG_INFO("NACK Found, pid=%d, blp=%u, r=%u", pid, blp, r);
-                                    trtp_manager_send_rtp_packet(base->rtp_manager, pkt_rtp, tsk_true);
+                                    trtp_manager_send_rtp_packet_2(base->rtp_manager, pkt_rtp, tsk_true, trtp_pacer_priority_retransmission); // ahead of the queued media when pacing
                                     break;
                                 }
                                 if(item == video->avpf.packets->tail) {
@@ -767,6 +816,18 @@ static int _tdav_session_video_codec_set_int32(tdav_session_video_t* self, const
 	return ret;
 }
 
+// From network to jitter buffer (or codec if the jitter buffer is disabled)
+static int _tdav_session_video_jb_put(tdav_session_video_t* self, const trtp_rtp_packet_t* packet)
+{
+    if (self->jb) {
+        return tdav_video_jb_put(self->jb, (trtp_rtp_packet_t*)packet);
+    }
+    if (self->jb_ring) {
+        return tdav_video_jb_ring_put(self->jb_ring, packet);
+    }
+    return _tdav_session_video_decode(self, packet);
+}
+
 // From jitter buffer to codec
 static int _tdav_session_video_jb_cb(const tdav_video_jb_cb_data_xt* data)
 {
@@ -1197,6 +1258,12 @@ static int tdav_session_video_start(tmedia_session_t* self)
             return ret;
         }
     }
+    if (video->jb_ring) {
+        if ((ret = tdav_video_jb_ring_start(video->jb_ring))) {
+            TSK_DEBUG_ERROR("Failed to start jitter buffer");
+            return ret;
+        }
+    }
 
     if ((ret = tdav_session_av_start(base, video->encoder.codec))) {
         TSK_DEBUG_ERROR("tdav_session_av_start(video) failed");
@@ -1239,6 +1306,9 @@ static int tdav_session_video_stop(tmedia_session_t* self)
     if (video->jb) {
         ret = tdav_video_jb_stop(video->jb);
     }
+    if (video->jb_ring) {
+        ret = tdav_video_jb_ring_stop(video->jb_ring);
+    }
     // clear AVPF packets and wait for the dtor() before destroying the list
     tsk_list_lock(video->avpf.packets);
     tsk_list_clear_items(video->avpf.packets);
@@ -1299,13 +1369,14 @@ static int tdav_session_video_set_ro(tmedia_session_t* self, const tsdp_header_M
     // Check if "RTCP-NACK" and "RTC-FIR" are supported
     {
         const tmedia_codec_t* codec;
-        base->is_fb_fir_neg = base->is_fb_nack_neg = base->is_fb_googremb_neg = base->is_fb_doubsjcng_neg = tsk_false;
+        base->is_fb_fir_neg = base->is_fb_nack_neg = base->is_fb_googremb_neg = base->is_fb_doubsjcng_neg = base->is_fb_twcc_neg = tsk_false;
         if ((codec = tdav_session_av_get_best_neg_codec(base))) {
             // a=rtcp-fb:* ccm fir
             // a=rtcp-fb:* nack
             // a=rtcp-fb:* goog-remb
             // a=rtcp-fb:* doubs-jcng
-            char attr_fir[256], attr_nack[256], attr_goog_remb[256], attr_doubs_jcng[256];
+            // a=rtcp-fb:* transport-cc
+            char attr_fir[256], attr_nack[256], attr_goog_remb[256], attr_doubs_jcng[256], attr_twcc[256];
             int index = 0;
             const tsdp_header_A_t* A;
 
@@ -1313,6 +1384,7 @@ static int tdav_session_video_set_ro(tmedia_session_t* self, const tsdp_header_M
             sprintf(attr_nack, "%s nack", codec->neg_format);
             sprintf(attr_goog_remb, "%s goog-remb", codec->neg_format);
             sprintf(attr_doubs_jcng, "%s doubs-jcng", codec->neg_format);
+            sprintf(attr_twcc, "%s transport-cc", codec->neg_format);
 
             while ((A = tsdp_header_M_findA_at(m, "rtcp-fb", index++))) {
                 if (!base->is_fb_fir_neg) {
@@ -1327,6 +1399,9 @@ static int tdav_session_video_set_ro(tmedia_session_t* self, const tsdp_header_M
                 if (!base->is_fb_doubsjcng_neg) {
                     base->is_fb_doubsjcng_neg = (tsk_striequals(A->value, "* doubs-jcng") || tsk_striequals(A->value, attr_doubs_jcng));
                 }
+                if (!base->is_fb_twcc_neg) {
+                    base->is_fb_twcc_neg = (tsk_striequals(A->value, "* transport-cc") || tsk_striequals(A->value, attr_twcc));
+                }
             }
         }
     }
@@ -1515,7 +1590,14 @@ static int _tdav_session_video_timer_cb(const void* arg, tsk_timer_id_t timer_id
 				// Also update the bandwidth when quality is > 90% and saved qvag is < 90% or ref bw is < base bw
 				update_qavg |= (qavg > 0.9f && (session->qos_metrics.qvag < 0.9f || bw_up_ref_kbps < bw_up_base_kbps));
 
-                if (update_qavg) {
+                // The send-side bandwidth estimation (RTCP-TWCC) already sets the upload bandwidth: only keep the quality metrics up to date
+                if (video->twcc.bw_kbps && (tsk_time_now() - video->twcc.time) < TDAV_SESSION_VIDEO_TWCC_TIMEOUT) {
+                    bw_up_new_kbps = video->twcc.bw_kbps;
+                    if (update_qavg) {
+                        session->qos_metrics.qvag = qavg;
+                    }
+                }
+                else if (update_qavg) {
                     // Update the upload bandwidth
                     int32_t bw_up_max_kbps = base->bandwidth_max_upload_kbps; // user-defined maximum
 
@@ -1688,9 +1770,9 @@ static int _tdav_session_video_report_bw_usage_and_jcng(tdav_session_video_t* se
         tsk_bool_t update_info = (tsk_time_now() - self->last_sendreport_time) > TDAV_SESSION_VIDEO_QOS_COMPUTE_INTERVAL;
         if (update_info) {
             float jcng_q = 1.f;
-            if (self->jb && self->jb_enabled) {
+            if ((self->jb || self->jb_ring) && self->jb_enabled) {
                 float q5 = 1.f;
-                if ((ret = tdav_video_jb_get_qcong(self->jb, &q5)) == 0) {
+                if ((ret = (self->jb ? tdav_video_jb_get_qcong(self->jb, &q5) : tdav_video_jb_ring_get_qcong(self->jb_ring, &q5))) == 0) {
                     jcng_q = q5;
                 }
             }
@@ -1714,6 +1796,10 @@ static int _tdav_session_video_set_callbacks(tmedia_session_t* self)
             if(TMEDIA_CODEC(item->data)->plugin == tdav_codec_red_plugin_def_t) {
                 tdav_codec_red_set_callback((struct tdav_codec_red_s *)(item->data), tdav_session_video_rtp_cb, self);
             }
+            // set ULPFEC callback: recovered packets to decode and send to the consumer
+            else if(TMEDIA_CODEC(item->data)->plugin == tdav_codec_ulpfec_plugin_def_t) {
+                tdav_codec_ulpfec_set_callback((struct tdav_codec_ulpfec_s *)(item->data), _tdav_session_video_ulpfec_cb, self);
+            }
         }
     }
     return 0;
@@ -1745,11 +1831,20 @@ static int _tdav_session_video_init(tdav_session_video_t *p_self, tmedia_type_t
         return -2;
     }
     if (p_self->jb_enabled) {
-        if (!p_self->jb && !(p_self->jb = tdav_video_jb_create())) {
-            TSK_DEBUG_ERROR("Failed to create jitter buffer");
-            return -3;
+        if (tmedia_defaults_get_videojb_ring_enabled()) {
+            if (!p_self->jb_ring && !(p_self->jb_ring = tdav_video_jb_ring_create())) {
+                TSK_DEBUG_ERROR("Failed to create jitter buffer");
+                return -3;
+            }
+            tdav_video_jb_ring_set_callback(p_self->jb_ring, _tdav_session_video_jb_cb, p_self);
+        }
+        else {
+            if (!p_self->jb && !(p_self->jb = tdav_video_jb_create())) {
+                TSK_DEBUG_ERROR("Failed to create jitter buffer");
+                return -3;
+            }
+            tdav_video_jb_set_callback(p_self->jb, _tdav_session_video_jb_cb, p_self);
         }
-        tdav_video_jb_set_callback(p_self->jb, _tdav_session_video_jb_cb, p_self);
     }
 
     /* producer's callbacks */
@@ -1808,6 +1903,7 @@ static tsk_object_t* tdav_session_video_dtor(tsk_object_t * self)
         TSK_OBJECT_SAFE_FREE(video->avpf.packets);
 
         TSK_OBJECT_SAFE_FREE(video->jb);
+        TSK_OBJECT_SAFE_FREE(video->jb_ring);
 
         /* timer manager */
         if (video->timer.mgr) {
@@ -25,11 +25,19 @@
 #include "tinydav.h"
 
 #include "test_sessions.h"
+#include "test_audio_kernels.h"
+#include "test_audio_mixer.h"
+#include "test_ulpfec.h"
+#include "test_video_jb.h"
 
 #define LOOP						0
 
 #define RUN_TEST_ALL				0
 #define RUN_TEST_SESSIONS			1
+#define RUN_TEST_AUDIO_KERNELS		0
+#define RUN_TEST_AUDIO_MIXER		0
+#define RUN_TEST_ULPFEC				0
+#define RUN_TEST_VIDEO_JB			0
 
 // Codecs : http://www.itu.int/rec/T-REC-G.191-200509-S/en
 
@@ -50,6 +58,22 @@ int main()
         test_sessions();
 #endif
 
+#if RUN_TEST_AUDIO_KERNELS || RUN_TEST_ALL
+        test_audio_kernels();
+#endif
+
+#if RUN_TEST_AUDIO_MIXER || RUN_TEST_ALL
+        test_audio_mixer();
+#endif
+
+#if RUN_TEST_ULPFEC || RUN_TEST_ALL
+        test_ulpfec();
+#endif
+
+#if RUN_TEST_VIDEO_JB || RUN_TEST_ALL
+        test_video_jb();
+#endif
+
     }
     while(LOOP);
 
@@ -0,0 +1,189 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef _TINYDEV_TEST_AUDIO_KERNELS_H
+#define _TINYDEV_TEST_AUDIO_KERNELS_H
+
+#include "tinydav/audio/tdav_audio_kernels.h"
+#include "tinydav/codecs/g711/g711.h"
+
+#include "tsk_time.h"
+
+#define TEST_AUDIO_KERNELS_SAMPLES		1003 /* odd to test the tails */
+#define TEST_AUDIO_KERNELS_FRAME		320 /* 20ms @ 16kHz */
+#define TEST_AUDIO_KERNELS_LOOP			100000
+
+#define TEST_AUDIO_KERNELS_CHECK(cond, name) \
+	if (!(cond)) { TSK_DEBUG_ERROR("[%s] '%s' failed at index %u", tdav_audio_kernels_get_name(), name, (unsigned)i); break; }
+
+#define TEST_AUDIO_KERNELS_BENCH(name, code) { \
+	uint64_t _start = tsk_time_now(), _duration; \
+	for (j = 0; j < TEST_AUDIO_KERNELS_LOOP; ++j) { code; } \
+	_duration = TSK_MAX(tsk_time_now() - _start, 1); \
+	TSK_DEBUG_INFO("[%s] %-16s %8.1f Msamples/s", isa_name, name, ((double)TEST_AUDIO_KERNELS_LOOP * TEST_AUDIO_KERNELS_FRAME) / (_duration * 1000.0)); \
+}
+
+static void test_audio_kernels_check()
+{
+    static int16_t s16[TEST_AUDIO_KERNELS_SAMPLES << 1], s16_out[TEST_AUDIO_KERNELS_SAMPLES << 1];
+    static float f32[TEST_AUDIO_KERNELS_SAMPLES];
+    static int32_t acc[TEST_AUDIO_KERNELS_SAMPLES];
+    uint64_t energy = 0;
+    tsk_size_t i;
+
+    for (i = 0; i < (TEST_AUDIO_KERNELS_SAMPLES << 1); ++i) {
+        s16[i] = (int16_t)(rand() - (RAND_MAX >> 1));
+    }
+
+    // gain (saturating)
+    memcpy(s16_out, s16, sizeof(s16));
+    tdav_audio_gain_apply_s16(s16_out, TEST_AUDIO_KERNELS_SAMPLES, 3);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        int32_t v = s16[i] * 8;
+        TEST_AUDIO_KERNELS_CHECK(s16_out[i] == (v > 32767 ? 32767 : (v < -32768 ? -32768 : v)), "gain");
+    }
+
+    // int16 <-> float
+    tdav_audio_s16_to_float(f32, s16, TEST_AUDIO_KERNELS_SAMPLES);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        TEST_AUDIO_KERNELS_CHECK(f32[i] == (float)s16[i], "s16_to_float");
+        f32[i] = (f32[i] * 1.7f) + 0.25f; // out of range and not integral values
+    }
+    tdav_audio_float_to_s16(s16_out, f32, TEST_AUDIO_KERNELS_SAMPLES);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        int32_t v = (int32_t)(f32[i] + (f32[i] >= 0.f ? 0.5f : -0.5f));
+        v = (v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+        TEST_AUDIO_KERNELS_CHECK(TSK_ABS(s16_out[i] - v) <= 1 /* rounding of the halves */, "float_to_s16");
+    }
+
+    // stereo <-> mono
+    tdav_audio_stereo_to_mono_s16(s16_out, s16, TEST_AUDIO_KERNELS_SAMPLES);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        TEST_AUDIO_KERNELS_CHECK(s16_out[i] == ((s16[(i << 1)] + s16[(i << 1) + 1]) >> 1), "stereo_to_mono");
+    }
+    tdav_audio_mono_to_stereo_s16(s16_out, s16, TEST_AUDIO_KERNELS_SAMPLES);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        TEST_AUDIO_KERNELS_CHECK(s16_out[(i << 1)] == s16[i] && s16_out[(i << 1) + 1] == s16[i], "mono_to_stereo");
+    }
+
+    // mixing
+    s16[0] = s16[1] = -32768; // largest square
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        energy += (uint64_t)(s16[i] * s16[i]);
+    }
+    if (tdav_audio_energy_s16(s16, TEST_AUDIO_KERNELS_SAMPLES) != energy) {
+        TSK_DEBUG_ERROR("[%s] 'energy' failed", tdav_audio_kernels_get_name());
+    }
+    memset(acc, 0, sizeof(acc));
+    tdav_audio_mix_accumulate_s16(acc, s16, TEST_AUDIO_KERNELS_SAMPLES);
+    tdav_audio_mix_accumulate_s16(acc, &s16[TEST_AUDIO_KERNELS_SAMPLES], TEST_AUDIO_KERNELS_SAMPLES);
+    tdav_audio_mix_accumulate_s16(acc, s16, TEST_AUDIO_KERNELS_SAMPLES);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        TEST_AUDIO_KERNELS_CHECK(acc[i] == ((s16[i] << 1) + s16[TEST_AUDIO_KERNELS_SAMPLES + i]), "mix_accumulate");
+    }
+    tdav_audio_mix_minus_s16(s16_out, acc, s16, TEST_AUDIO_KERNELS_SAMPLES);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        int32_t v = (s16[i] + s16[TEST_AUDIO_KERNELS_SAMPLES + i]);
+        TEST_AUDIO_KERNELS_CHECK(s16_out[i] == (v > 32767 ? 32767 : (v < -32768 ? -32768 : v)), "mix_minus");
+    }
+    tdav_audio_mix_minus_s16(s16_out, acc, tsk_null, TEST_AUDIO_KERNELS_SAMPLES);
+    for (i = 0; i < TEST_AUDIO_KERNELS_SAMPLES; ++i) {
+        TEST_AUDIO_KERNELS_CHECK(s16_out[i] == (acc[i] > 32767 ? 32767 : (acc[i] < -32768 ? -32768 : acc[i])), "mix");
+    }
+}
+
+static void test_audio_kernels_bench(const char* isa_name)
+{
+    static int16_t s16[TEST_AUDIO_KERNELS_FRAME << 1], s16_out[TEST_AUDIO_KERNELS_FRAME << 1];
+    static float f32[TEST_AUDIO_KERNELS_FRAME];
+    static uint8_t g711[TEST_AUDIO_KERNELS_FRAME];
+    tsk_size_t i, j;
+
+    for (i = 0; i < (TEST_AUDIO_KERNELS_FRAME << 1); ++i) {
+        s16[i] = (int16_t)(rand() - (RAND_MAX >> 1));
+    }
+
+    if (!isa_name) {
+        // reference: the sample by sample implementations used before the kernels
+        isa_name = "ref";
+        TEST_AUDIO_KERNELS_BENCH("g711u_encode", for (i = 0; i < TEST_AUDIO_KERNELS_FRAME; ++i) g711[i] = linear2ulaw(s16[i]));
+        TEST_AUDIO_KERNELS_BENCH("g711u_decode", for (i = 0; i < TEST_AUDIO_KERNELS_FRAME; ++i) s16_out[i] = ulaw2linear(g711[i]));
+        TEST_AUDIO_KERNELS_BENCH("g711a_encode", for (i = 0; i < TEST_AUDIO_KERNELS_FRAME; ++i) g711[i] = linear2alaw(s16[i]));
+        TEST_AUDIO_KERNELS_BENCH("g711a_decode", for (i = 0; i < TEST_AUDIO_KERNELS_FRAME; ++i) s16_out[i] = alaw2linear(g711[i]));
+        return;
+    }
+    TEST_AUDIO_KERNELS_BENCH("g711u_encode", tdav_audio_g711u_encode(g711, s16, TEST_AUDIO_KERNELS_FRAME));
+    TEST_AUDIO_KERNELS_BENCH("g711u_decode", tdav_audio_g711u_decode(s16_out, g711, TEST_AUDIO_KERNELS_FRAME));
+    TEST_AUDIO_KERNELS_BENCH("g711a_encode", tdav_audio_g711a_encode(g711, s16, TEST_AUDIO_KERNELS_FRAME));
+    TEST_AUDIO_KERNELS_BENCH("g711a_decode", tdav_audio_g711a_decode(s16_out, g711, TEST_AUDIO_KERNELS_FRAME));
+    TEST_AUDIO_KERNELS_BENCH("gain", memcpy(s16_out, s16, sizeof(s16)); tdav_audio_gain_apply_s16(s16_out, TEST_AUDIO_KERNELS_FRAME, 2));
+    TEST_AUDIO_KERNELS_BENCH("s16_to_float", tdav_audio_s16_to_float(f32, s16, TEST_AUDIO_KERNELS_FRAME));
+    TEST_AUDIO_KERNELS_BENCH("float_to_s16", tdav_audio_float_to_s16(s16_out, f32, TEST_AUDIO_KERNELS_FRAME));
+    TEST_AUDIO_KERNELS_BENCH("stereo_to_mono", tdav_audio_stereo_to_mono_s16(s16_out, s16, TEST_AUDIO_KERNELS_FRAME));
+    TEST_AUDIO_KERNELS_BENCH("mono_to_stereo", tdav_audio_mono_to_stereo_s16(s16_out, s16, TEST_AUDIO_KERNELS_FRAME));
+}
+
+void test_audio_kernels()
+{
+    static const tdav_audio_kernels_isa_t isas[] = {
+        tdav_audio_kernels_isa_c, tdav_audio_kernels_isa_sse2, tdav_audio_kernels_isa_avx2, tdav_audio_kernels_isa_neon
+    };
+    int32_t i;
+    int16_t s16;
+    uint8_t g711;
+
+    // G.711: must be bit-exact with the reference implementation
+    for (i = -32768; i <= 32767; ++i) {
+        s16 = (int16_t)i;
+        tdav_audio_g711u_encode(&g711, &s16, 1);
+        if (g711 != linear2ulaw(s16)) {
+            TSK_DEBUG_ERROR("g711u_encode(%d) failed", i);
+            break;
+        }
+        tdav_audio_g711a_encode(&g711, &s16, 1);
+        if (g711 != linear2alaw(s16)) {
+            TSK_DEBUG_ERROR("g711a_encode(%d) failed", i);
+            break;
+        }
+    }
+    for (i = 0; i < 256; ++i) {
+        g711 = (uint8_t)i;
+        tdav_audio_g711u_decode(&s16, &g711, 1);
+        if (s16 != ulaw2linear(g711)) {
+            TSK_DEBUG_ERROR("g711u_decode(%d) failed", i);
+        }
+        tdav_audio_g711a_decode(&s16, &g711, 1);
+        if (s16 != alaw2linear(g711)) {
+            TSK_DEBUG_ERROR("g711a_decode(%d) failed", i);
+        }
+    }
+
+    test_audio_kernels_bench(tsk_null);
+    for (i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+        if (tdav_audio_kernels_select(isas[i]) == 0) {
+            test_audio_kernels_check();
+            test_audio_kernels_bench(tdav_audio_kernels_get_name());
+        }
+    }
+    tdav_audio_kernels_select(tdav_audio_kernels_isa_auto);
+}
+
+#endif /* _TINYDEV_TEST_AUDIO_KERNELS_H */
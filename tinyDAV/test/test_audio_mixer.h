@@ -0,0 +1,146 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef _TINYDEV_TEST_AUDIO_MIXER_H
+#define _TINYDEV_TEST_AUDIO_MIXER_H
+
+#include "tinydav/audio/tdav_audio_mixer.h"
+
+#include "tsk_time.h"
+
+#include <math.h>
+
+#define TEST_AUDIO_MIXER_PARTICIPANTS	100
+#define TEST_AUDIO_MIXER_RATE			16000
+#define TEST_AUDIO_MIXER_PTIME			20
+#define TEST_AUDIO_MIXER_FRAME			((TEST_AUDIO_MIXER_RATE * TEST_AUDIO_MIXER_PTIME) / 1000)
+#define TEST_AUDIO_MIXER_TICKS			500 /* 10 seconds */
+
+typedef struct test_audio_mixer_participant_s {
+    int16_t frame[TEST_AUDIO_MIXER_FRAME];
+    int16_t last[TEST_AUDIO_MIXER_FRAME];
+    uint64_t pushed;
+}
+test_audio_mixer_participant_t;
+
+static tsk_size_t test_audio_mixer_pull(const void* usrdata, void* buffer, tsk_size_t size)
+{
+    const test_audio_mixer_participant_t* participant = (const test_audio_mixer_participant_t*)usrdata;
+    size = TSK_MIN(size, sizeof(participant->frame));
+    memcpy(buffer, participant->frame, size);
+    return size;
+}
+
+static int test_audio_mixer_push(const void* usrdata, const void* buffer, tsk_size_t size)
+{
+    test_audio_mixer_participant_t* participant = (test_audio_mixer_participant_t*)usrdata;
+    memcpy(participant->last, buffer, TSK_MIN(size, sizeof(participant->last)));
+    participant->pushed += size;
+    return 0;
+}
+
+static void test_audio_mixer_mix_minus()
+{
+    static test_audio_mixer_participant_t participants[3];
+    tdav_audio_mixer_t* mixer = tdav_audio_mixer_create(TEST_AUDIO_MIXER_RATE, TEST_AUDIO_MIXER_PTIME, 3);
+    tsk_size_t i;
+
+    memset(participants, 0, sizeof(participants));
+    for (i = 0; i < TEST_AUDIO_MIXER_FRAME; ++i) {
+        participants[0].frame[i] = 1000;
+        participants[1].frame[i] = 2000; // participants[2] is silent
+    }
+    for (i = 0; i < 3; ++i) {
+        tdav_audio_mixer_add_participant(mixer, i, test_audio_mixer_pull, test_audio_mixer_push, &participants[i]);
+    }
+    tdav_audio_mixer_process(mixer);
+    tdav_audio_mixer_process(mixer);
+
+    if (participants[0].last[0] != 2000 || participants[1].last[0] != 1000 || participants[2].last[0] != 3000) {
+        TSK_DEBUG_ERROR("Invalid mix-minus: %d, %d, %d", participants[0].last[0], participants[1].last[0], participants[2].last[0]);
+    }
+    if (!tdav_audio_mixer_is_speaking(mixer, 0) || !tdav_audio_mixer_is_speaking(mixer, 1) || tdav_audio_mixer_is_speaking(mixer, 2)) {
+        TSK_DEBUG_ERROR("Invalid active speakers");
+    }
+    tdav_audio_mixer_remove_participant(mixer, 1);
+    tdav_audio_mixer_process(mixer);
+    if (tdav_audio_mixer_get_participants_count(mixer) != 2 || participants[0].last[0] != 0 || participants[2].last[0] != 1000) {
+        TSK_DEBUG_ERROR("Invalid mix after removing a participant");
+    }
+
+    // real-time clock
+    participants[0].pushed = 0;
+    tdav_audio_mixer_start(mixer);
+    tsk_thread_sleep(TEST_AUDIO_MIXER_PTIME * 10);
+    tdav_audio_mixer_stop(mixer);
+    if (participants[0].pushed < (5 * TEST_AUDIO_MIXER_FRAME * sizeof(int16_t))) {
+        TSK_DEBUG_ERROR("Mixer thread: %llu bytes pushed", participants[0].pushed);
+    }
+    TSK_OBJECT_SAFE_FREE(mixer);
+}
+
+static void test_audio_mixer_bench(uint32_t max_speakers, uint32_t talkers)
+{
+    static test_audio_mixer_participant_t participants[TEST_AUDIO_MIXER_PARTICIPANTS];
+    tdav_audio_mixer_t* mixer = tdav_audio_mixer_create(TEST_AUDIO_MIXER_RATE, TEST_AUDIO_MIXER_PTIME, max_speakers);
+    uint64_t start, duration;
+    tsk_size_t i, j;
+
+    for (i = 0; i < TEST_AUDIO_MIXER_PARTICIPANTS; ++i) {
+        // a few talkers, the others are background noise
+        const double amplitude = (i < talkers) ? (1000.0 + (i * 100.0)) : 8.0;
+        for (j = 0; j < TEST_AUDIO_MIXER_FRAME; ++j) {
+            participants[i].frame[j] = (int16_t)(amplitude * sin((2.0 * 3.14159265 * (200.0 + (i * 10.0)) * j) / TEST_AUDIO_MIXER_RATE));
+        }
+        participants[i].pushed = 0;
+        tdav_audio_mixer_add_participant(mixer, i, test_audio_mixer_pull, test_audio_mixer_push, &participants[i]);
+    }
+
+    start = tsk_time_now();
+    for (i = 0; i < TEST_AUDIO_MIXER_TICKS; ++i) {
+        tdav_audio_mixer_process(mixer);
+    }
+    duration = TSK_MAX(tsk_time_now() - start, 1);
+
+    for (i = 0; i < TEST_AUDIO_MIXER_PARTICIPANTS; ++i) {
+        if (participants[i].pushed != (TEST_AUDIO_MIXER_TICKS * TEST_AUDIO_MIXER_FRAME * sizeof(int16_t))) {
+            TSK_DEBUG_ERROR("Participant %u: %llu bytes pushed", (unsigned)i, participants[i].pushed);
+        }
+        if (tdav_audio_mixer_is_speaking(mixer, i) != (i >= (talkers - TSK_MIN(max_speakers, talkers)) && i < talkers)) { // the loudest talkers
+            TSK_DEBUG_ERROR("Participant %u: unexpected active speaker state", (unsigned)i);
+        }
+    }
+    TSK_DEBUG_INFO("Audio mixer: %u participants @ %u Hz, %u talking, %u active speakers max: %.3f ms per %u ms frame (%.2f%% of one core)",
+                   TEST_AUDIO_MIXER_PARTICIPANTS, TEST_AUDIO_MIXER_RATE, talkers, max_speakers,
+                   (double)duration / TEST_AUDIO_MIXER_TICKS, TEST_AUDIO_MIXER_PTIME, (duration * 100.0) / (TEST_AUDIO_MIXER_TICKS * TEST_AUDIO_MIXER_PTIME));
+
+    TSK_OBJECT_SAFE_FREE(mixer);
+}
+
+void test_audio_mixer()
+{
+    test_audio_mixer_mix_minus();
+    test_audio_mixer_bench(TDAV_AUDIO_MIXER_MAX_SPEAKERS, 5);
+    test_audio_mixer_bench(TDAV_AUDIO_MIXER_MAX_SPEAKERS, TEST_AUDIO_MIXER_PARTICIPANTS);
+    test_audio_mixer_bench(TEST_AUDIO_MIXER_PARTICIPANTS, TEST_AUDIO_MIXER_PARTICIPANTS); // everybody mixed
+}
+
+#endif /* _TINYDEV_TEST_AUDIO_MIXER_H */
@@ -0,0 +1,257 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef _TINYDEV_TEST_ULPFEC_H
+#define _TINYDEV_TEST_ULPFEC_H
+
+#include "tinydav/codecs/fec/tdav_codec_ulpfec.h"
+
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+
+#define TEST_ULPFEC_SSRC			0x12345678
+#define TEST_ULPFEC_PT_MEDIA		100
+#define TEST_ULPFEC_PT_FEC			122
+#define TEST_ULPFEC_FRAMES			1000
+#define TEST_ULPFEC_FRAME_PKTS		8 /* packets per video frame (one FEC packet per frame) */
+#define TEST_ULPFEC_PAY_MAX			1200
+#define TEST_ULPFEC_LOSS_PERCENT	5
+
+typedef struct test_ulpfec_ctx_s {
+    uint8_t payloads[TEST_ULPFEC_FRAME_PKTS][TEST_ULPFEC_PAY_MAX];
+    tsk_size_t sizes[TEST_ULPFEC_FRAME_PKTS];
+    uint16_t seq_num_first;
+    tsk_bool_t available[TEST_ULPFEC_FRAME_PKTS];
+    uint64_t recovered;
+    uint64_t corrupted;
+}
+test_ulpfec_ctx_t;
+
+static uint32_t __test_ulpfec_rand = 1;
+static uint32_t test_ulpfec_rand()
+{
+    __test_ulpfec_rand = (__test_ulpfec_rand * 1103515245 + 12345);
+    return (__test_ulpfec_rand >> 16) & 0x7FFF;
+}
+
+static int test_ulpfec_cb(const void* callback_data, const struct trtp_rtp_packet_s* packet)
+{
+    test_ulpfec_ctx_t* ctx = (test_ulpfec_ctx_t*)callback_data;
+    uint16_t index = (uint16_t)(packet->header->seq_num - ctx->seq_num_first);
+    const void* payload = packet->payload.data ? packet->payload.data : packet->payload.data_const;
+    if (index >= TEST_ULPFEC_FRAME_PKTS || ctx->available[index]) {
+        ++ctx->corrupted;
+        return -1;
+    }
+    if (packet->header->ssrc != TEST_ULPFEC_SSRC || packet->header->payload_type != TEST_ULPFEC_PT_MEDIA || packet->header->marker != (index == TEST_ULPFEC_FRAME_PKTS - 1)
+            || packet->payload.size != ctx->sizes[index] || memcmp(payload, ctx->payloads[index], ctx->sizes[index])) {
+        TSK_DEBUG_ERROR("Recovered packet with seq_num=%u doesn't match the original", packet->header->seq_num);
+        ++ctx->corrupted;
+        return -2;
+    }
+    ctx->available[index] = tsk_true;
+    ++ctx->recovered;
+    return 0;
+}
+
+// random losses on single-level FEC packets (one per frame) as produced by the video session
+static void test_ulpfec_loss()
+{
+    static test_ulpfec_ctx_t ctx;
+    tmedia_codec_t *encoder, *decoder;
+    trtp_rtp_packet_t* packet;
+    tdav_codec_ulpfec_stats_t stats;
+    void* fec_ptr = tsk_null;
+    tsk_size_t fec_size = 0, fec_len, i, j;
+    uint16_t seq_num = 65000, seq_num_fec = 0; // wraps
+    uint32_t timestamp = 0;
+    uint64_t lost = 0, frames_broken = 0, frames_broken_fec = 0;
+    tsk_bool_t dropped;
+
+    tmedia_codec_plugin_register(tdav_codec_ulpfec_plugin_def_t);
+    encoder = tmedia_codec_create(TMEDIA_CODEC_FORMAT_ULPFEC);
+    decoder = tmedia_codec_create(TMEDIA_CODEC_FORMAT_ULPFEC);
+    if (!encoder || !decoder) {
+        TSK_DEBUG_ERROR("Failed to create ULPFEC codecs");
+        goto bail;
+    }
+    tdav_codec_ulpfec_set_callback((struct tdav_codec_ulpfec_s*)decoder, test_ulpfec_cb, &ctx);
+
+    for (i = 0; i < TEST_ULPFEC_FRAMES; ++i, timestamp += 3000) {
+        memset(ctx.available, 0, sizeof(ctx.available));
+        ctx.seq_num_first = seq_num;
+        dropped = tsk_false;
+        for (j = 0; j < TEST_ULPFEC_FRAME_PKTS; ++j, ++seq_num) {
+            tsk_size_t k;
+            ctx.sizes[j] = (j == TEST_ULPFEC_FRAME_PKTS - 1) ? (100 + (test_ulpfec_rand() % (TEST_ULPFEC_PAY_MAX - 100))) : TEST_ULPFEC_PAY_MAX;
+            for (k = 0; k < ctx.sizes[j]; ++k) {
+                ctx.payloads[j][k] = (uint8_t)test_ulpfec_rand();
+            }
+            packet = trtp_rtp_packet_create(TEST_ULPFEC_SSRC, seq_num, timestamp, TEST_ULPFEC_PT_MEDIA, (j == TEST_ULPFEC_FRAME_PKTS - 1));
+            packet->payload.data_const = ctx.payloads[j];
+            packet->payload.size = ctx.sizes[j];
+            tdav_codec_ulpfec_enc_protect((struct tdav_codec_ulpfec_s*)encoder, packet);
+            if ((test_ulpfec_rand() % 100) < TEST_ULPFEC_LOSS_PERCENT) {
+                ++lost;
+                dropped = tsk_true;
+            }
+            else {
+                ctx.available[j] = tsk_true;
+                tdav_codec_ulpfec_dec_put((struct tdav_codec_ulpfec_s*)decoder, packet);
+            }
+            TSK_OBJECT_SAFE_FREE(packet);
+        }
+        fec_len = tdav_codec_ulpfec_enc_serialize((const struct tdav_codec_ulpfec_s*)encoder, &fec_ptr, &fec_size);
+        tdav_codec_ulpfec_enc_reset((struct tdav_codec_ulpfec_s*)encoder);
+        if ((test_ulpfec_rand() % 100) >= TEST_ULPFEC_LOSS_PERCENT) {
+            packet = trtp_rtp_packet_create(TEST_ULPFEC_SSRC, seq_num_fec++, timestamp, TEST_ULPFEC_PT_FEC, tsk_true);
+            decoder->plugin->decode(decoder, fec_ptr, fec_len, tsk_null, tsk_null, packet->header);
+            TSK_OBJECT_SAFE_FREE(packet);
+        }
+        frames_broken += dropped ? 1 : 0;
+        for (j = 0; j < TEST_ULPFEC_FRAME_PKTS && ctx.available[j]; ++j) ;
+        frames_broken_fec += (j < TEST_ULPFEC_FRAME_PKTS) ? 1 : 0;
+    }
+
+    tdav_codec_ulpfec_dec_get_stats((const struct tdav_codec_ulpfec_s*)decoder, &stats);
+    TSK_DEBUG_INFO("ULPFEC: lost=%llu recovered=%llu (%.1f%%), corrupted=%llu, frames needing keyframe: without FEC=%llu with FEC=%llu (%llu requests avoided)",
+                   lost, ctx.recovered, lost ? ((ctx.recovered * 100.0) / lost) : 0.0, ctx.corrupted,
+                   frames_broken, frames_broken_fec, (frames_broken - frames_broken_fec));
+    if (ctx.corrupted || stats.recovered_count != ctx.recovered) {
+        TSK_DEBUG_ERROR("Invalid recovered packets");
+    }
+    if (!ctx.recovered || frames_broken_fec >= frames_broken) {
+        TSK_DEBUG_ERROR("No frame recovered");
+    }
+
+bail:
+    TSK_FREE(fec_ptr);
+    TSK_OBJECT_SAFE_FREE(encoder);
+    TSK_OBJECT_SAFE_FREE(decoder);
+    tmedia_codec_plugin_unregister(tdav_codec_ulpfec_plugin_def_t);
+}
+
+// two levels: level #0 protects the first 16 bytes of packets 0-3, level #1 the next 24 bytes of packets 0-1 only (RFC 5109 - 10.3)
+#define TEST_ULPFEC_ML_LEN0	16
+#define TEST_ULPFEC_ML_LEN1	24
+#define TEST_ULPFEC_ML_SIZE	(10 + 4 + TEST_ULPFEC_ML_LEN0 + 4 + TEST_ULPFEC_ML_LEN1)
+
+static void test_ulpfec_multi_level_build(uint8_t fec[TEST_ULPFEC_ML_SIZE], const test_ulpfec_ctx_t* ctx)
+{
+    uint8_t* level1 = &fec[10 + 4 + TEST_ULPFEC_ML_LEN0];
+    tsk_size_t i, j;
+    uint16_t length = 0;
+
+    memset(fec, 0, TEST_ULPFEC_ML_SIZE);
+    for (i = 0; i < 4; ++i) {
+        // FEC header: P/X/CC=0, marker on packet #3 only, same PT and TS
+        fec[1] ^= (uint8_t)(TEST_ULPFEC_PT_MEDIA | ((i == 3) ? 0x80 : 0x00));
+        length ^= (uint16_t)ctx->sizes[i];
+        for (j = 0; j < TEST_ULPFEC_ML_LEN0 && j < ctx->sizes[i]; ++j) {
+            fec[10 + 4 + j] ^= ctx->payloads[i][j];
+        }
+        for (j = TEST_ULPFEC_ML_LEN0; i < 2 && j < ctx->sizes[i]; ++j) {
+            level1[4 + (j - TEST_ULPFEC_ML_LEN0)] ^= ctx->payloads[i][j];
+        }
+    }
+    fec[2] = (ctx->seq_num_first >> 8);
+    fec[3] = (ctx->seq_num_first & 0xFF);
+    fec[8] = (length >> 8);
+    fec[9] = (length & 0xFF);
+    fec[11] = TEST_ULPFEC_ML_LEN0;
+    fec[12] = 0xF0; // packets 0-3
+    level1[1] = TEST_ULPFEC_ML_LEN1;
+    level1[2] = 0xC0; // packets 0-1
+}
+
+static void test_ulpfec_multi_level()
+{
+    static const tsk_size_t sizes[4] = { 40, 30, 40, 35 };
+    static const int lost[2][2] = { { 1, 3 }, { 3, -1 } };
+    uint8_t fec[TEST_ULPFEC_ML_SIZE];
+    static test_ulpfec_ctx_t ctx;
+    tmedia_codec_t* decoder;
+    trtp_rtp_packet_t* packet;
+    tsk_size_t i, j, k;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.seq_num_first = 100;
+    for (i = 0; i < 4; ++i) {
+        ctx.sizes[i] = sizes[i];
+        for (j = 0; j < sizes[i]; ++j) {
+            ctx.payloads[i][j] = (uint8_t)test_ulpfec_rand();
+        }
+    }
+    test_ulpfec_multi_level_build(fec, &ctx);
+
+    tmedia_codec_plugin_register(tdav_codec_ulpfec_plugin_def_t);
+    for (k = 0; k < 2; ++k) {
+        if (!(decoder = tmedia_codec_create(TMEDIA_CODEC_FORMAT_ULPFEC))) {
+            TSK_DEBUG_ERROR("Failed to create ULPFEC codec");
+            break;
+        }
+        tdav_codec_ulpfec_set_callback((struct tdav_codec_ulpfec_s*)decoder, test_ulpfec_cb, &ctx);
+        memset(ctx.available, 0, sizeof(ctx.available));
+        ctx.recovered = 0;
+
+        for (i = 0; i < 4; ++i) {
+            if ((int)i != lost[k][0] && (int)i != lost[k][1]) {
+                packet = trtp_rtp_packet_create(TEST_ULPFEC_SSRC, (uint16_t)(ctx.seq_num_first + i), 0, TEST_ULPFEC_PT_MEDIA, (i == 3));
+                packet->payload.data_const = ctx.payloads[i];
+                packet->payload.size = ctx.sizes[i];
+                ctx.available[i] = tsk_true;
+                tdav_codec_ulpfec_dec_put((struct tdav_codec_ulpfec_s*)decoder, packet);
+                TSK_OBJECT_SAFE_FREE(packet);
+            }
+        }
+        packet = trtp_rtp_packet_create(TEST_ULPFEC_SSRC, 0, 0, TEST_ULPFEC_PT_FEC, tsk_false);
+        decoder->plugin->decode(decoder, fec, sizeof(fec), tsk_null, tsk_null, packet->header);
+        TSK_OBJECT_SAFE_FREE(packet);
+        // both cases: nothing could be recovered (two packets missing or bytes of packet #3 not protected by level #1)
+        if (ctx.recovered) {
+            TSK_DEBUG_ERROR("[%u] Unexpected recovered packet", (unsigned)k);
+        }
+        if (lost[k][1] == 3) {
+            // packet #3 received late: packet #1 recovered using both levels
+            packet = trtp_rtp_packet_create(TEST_ULPFEC_SSRC, (uint16_t)(ctx.seq_num_first + 3), 0, TEST_ULPFEC_PT_MEDIA, tsk_true);
+            packet->payload.data_const = ctx.payloads[3];
+            packet->payload.size = ctx.sizes[3];
+            ctx.available[3] = tsk_true;
+            tdav_codec_ulpfec_dec_put((struct tdav_codec_ulpfec_s*)decoder, packet);
+            TSK_OBJECT_SAFE_FREE(packet);
+            if (ctx.recovered != 1 || !ctx.available[1]) {
+                TSK_DEBUG_ERROR("[%u] Multi-level recovery failed", (unsigned)k);
+            }
+        }
+        if (ctx.corrupted) {
+            TSK_DEBUG_ERROR("[%u] Invalid recovered packet", (unsigned)k);
+        }
+        TSK_OBJECT_SAFE_FREE(decoder);
+    }
+    tmedia_codec_plugin_unregister(tdav_codec_ulpfec_plugin_def_t);
+}
+
+static void test_ulpfec()
+{
+    test_ulpfec_loss();
+    test_ulpfec_multi_level();
+}
+
+#endif /* _TINYDEV_TEST_ULPFEC_H */
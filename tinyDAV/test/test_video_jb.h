@@ -0,0 +1,239 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef _TINYDEV_TEST_VIDEO_JB_H
+#define _TINYDEV_TEST_VIDEO_JB_H
+
+#include "tinydav/video/jb/tdav_video_jb.h"
+#include "tinydav/video/jb/tdav_video_jb_ring.h"
+
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+
+#include "tsk_time.h"
+#include "tsk_thread.h"
+
+#define TEST_VIDEO_JB_SSRC			0x11223344
+#define TEST_VIDEO_JB_PT			100
+#define TEST_VIDEO_JB_FRAMES		60
+#define TEST_VIDEO_JB_FRAME_PKTS	20
+#define TEST_VIDEO_JB_SEQ_FIRST		65000 /* wraps */
+#define TEST_VIDEO_JB_PAY_SIZE		1200
+
+/* 1080p: ~8Mbps at 30fps -> ~35KB per frame */
+#define TEST_VIDEO_JB_BENCH_FRAMES		300
+#define TEST_VIDEO_JB_BENCH_FRAME_PKTS	30
+
+typedef struct test_video_jb_ctx_s {
+    uint16_t seq_nums[TEST_VIDEO_JB_FRAMES * TEST_VIDEO_JB_FRAME_PKTS];
+    tsk_size_t count;
+    tsk_size_t errors;
+    struct {
+        uint16_t seq_num;
+        tsk_size_t count;
+    } losses[512];
+    tsk_size_t losses_count;
+    tsk_size_t tmfr;
+}
+test_video_jb_ctx_t;
+
+static int test_video_jb_cb(const tdav_video_jb_cb_data_xt* data)
+{
+    test_video_jb_ctx_t* ctx = (test_video_jb_ctx_t*)data->usr_data;
+    switch (data->type) {
+    case tdav_video_jb_cb_data_type_rtp: {
+        const uint8_t* payload = (const uint8_t*)(data->rtp.pkt->payload.data ? data->rtp.pkt->payload.data : data->rtp.pkt->payload.data_const);
+        // the payload starts with the sequence number
+        if (data->rtp.pkt->payload.size != TEST_VIDEO_JB_PAY_SIZE || payload[0] != (data->rtp.pkt->header->seq_num >> 8) || payload[1] != (data->rtp.pkt->header->seq_num & 0xFF)) {
+            ++ctx->errors;
+        }
+        if (ctx->count < sizeof(ctx->seq_nums) / sizeof(ctx->seq_nums[0])) {
+            ctx->seq_nums[ctx->count++] = data->rtp.pkt->header->seq_num;
+        }
+        break;
+    }
+    case tdav_video_jb_cb_data_type_fl: {
+        if (ctx->losses_count < sizeof(ctx->losses) / sizeof(ctx->losses[0])) {
+            ctx->losses[ctx->losses_count].seq_num = data->fl.seq_num;
+            ctx->losses[ctx->losses_count++].count = data->fl.count;
+        }
+        break;
+    }
+    case tdav_video_jb_cb_data_type_tmfr: {
+        ++ctx->tmfr;
+        break;
+    }
+    default:
+        break;
+    }
+    return 0;
+}
+
+static trtp_rtp_packet_t* test_video_jb_packet(uint8_t* payload, uint16_t seq_num, uint32_t timestamp, tsk_bool_t marker)
+{
+    trtp_rtp_packet_t* packet = trtp_rtp_packet_create(TEST_VIDEO_JB_SSRC, seq_num, timestamp, TEST_VIDEO_JB_PT, marker);
+    payload[0] = (seq_num >> 8);
+    payload[1] = (seq_num & 0xFF);
+    packet->payload.data_const = payload;
+    packet->payload.size = TEST_VIDEO_JB_PAY_SIZE;
+    return packet;
+}
+
+// reordering and losses: packets delivered in order, loss ranges reported once
+static void test_video_jb_ring_loss()
+{
+    static test_video_jb_ctx_t ctx;
+    static uint8_t payloads[2][TEST_VIDEO_JB_PAY_SIZE]; // one for the packet kept to be reordered
+    static const uint16_t lost_index[] = { 105, 106, 107, 250 }; // two ranges: [105 - 107] and [250]
+    struct tdav_video_jb_ring_s* jb;
+    trtp_rtp_packet_t *packet, *packet_prev = tsk_null;
+    tdav_video_jb_ring_stats_t stats;
+    tsk_size_t i, j, index, expected = 0;
+    uint16_t seq_num;
+
+    memset(&ctx, 0, sizeof(ctx));
+    if (!(jb = tdav_video_jb_ring_create())) {
+        TSK_DEBUG_ERROR("Failed to create jitter buffer");
+        return;
+    }
+    tdav_video_jb_ring_set_callback(jb, test_video_jb_cb, &ctx);
+    tdav_video_jb_ring_start(jb);
+
+    for (i = 0; i < TEST_VIDEO_JB_FRAMES; ++i) {
+        for (j = 0; j < TEST_VIDEO_JB_FRAME_PKTS; ++j) {
+            index = (i * TEST_VIDEO_JB_FRAME_PKTS) + j;
+            seq_num = (uint16_t)(TEST_VIDEO_JB_SEQ_FIRST + index);
+            if (index == lost_index[0] || index == lost_index[1] || index == lost_index[2] || index == lost_index[3]) {
+                continue;
+            }
+            ++expected;
+            packet = test_video_jb_packet(payloads[index & 1], seq_num, (uint32_t)(i * 3000), (j == TEST_VIDEO_JB_FRAME_PKTS - 1));
+            // swap every 7th packet with the next one
+            if ((index % 7) == 0 && !packet_prev) {
+                packet_prev = packet;
+                continue;
+            }
+            tdav_video_jb_ring_put(jb, packet);
+            TSK_OBJECT_SAFE_FREE(packet);
+            if (packet_prev) {
+                tdav_video_jb_ring_put(jb, packet_prev);
+                TSK_OBJECT_SAFE_FREE(packet_prev);
+            }
+        }
+        tsk_thread_sleep(1000 / 30);
+    }
+    if (packet_prev) {
+        tdav_video_jb_ring_put(jb, packet_prev);
+        TSK_OBJECT_SAFE_FREE(packet_prev);
+    }
+    tsk_thread_sleep(1000);
+    tdav_video_jb_ring_get_stats(jb, &stats);
+    tdav_video_jb_ring_stop(jb);
+
+    TSK_DEBUG_INFO("Video JB (ring): delivered=%u/%u, frames=%llu (incomplete=%llu), lost=%llu, nacked=%llu, losses reported=%u",
+                   (unsigned)ctx.count, (unsigned)expected, stats.frames_decoded, stats.frames_incomplete, stats.pkts_lost, stats.pkts_nacked, (unsigned)ctx.losses_count);
+    if (ctx.count != expected || ctx.errors) {
+        TSK_DEBUG_ERROR("Invalid packets delivered");
+    }
+    for (i = 1; i < ctx.count; ++i) {
+        if ((int16_t)(ctx.seq_nums[i] - ctx.seq_nums[i - 1]) <= 0) {
+            TSK_DEBUG_ERROR("Packets not in order: %u after %u", ctx.seq_nums[i], ctx.seq_nums[i - 1]);
+            break;
+        }
+    }
+    // each range is reported when the gap is detected then requested again one time before decoding the frame
+    // (the reordered packets are also reported when the gap is detected)
+    for (i = 0, j = 0, index = 0; i < ctx.losses_count; ++i) {
+        if (ctx.losses[i].seq_num == (uint16_t)(TEST_VIDEO_JB_SEQ_FIRST + lost_index[0])) {
+            j += (ctx.losses[i].count == 3) ? 1 : 100;
+        }
+        else if (ctx.losses[i].seq_num == (uint16_t)(TEST_VIDEO_JB_SEQ_FIRST + lost_index[3])) {
+            index += (ctx.losses[i].count == 1) ? 1 : 100;
+        }
+        else if (ctx.losses[i].count != 1 || ((uint16_t)(ctx.losses[i].seq_num - TEST_VIDEO_JB_SEQ_FIRST) % 7) != 0) {
+            index += 100;
+        }
+    }
+    if (j != 2 || index != 2) {
+        TSK_DEBUG_ERROR("Invalid loss ranges");
+    }
+    if (stats.pkts_lost != 4 || stats.frames_incomplete != 2) {
+        TSK_DEBUG_ERROR("Invalid stats");
+    }
+
+    TSK_OBJECT_SAFE_FREE(jb);
+}
+
+// CPU used by the network thread to insert the packets (the decode thread runs at the same time)
+static void test_video_jb_bench()
+{
+    static test_video_jb_ctx_t ctx;
+    static uint8_t payload[TEST_VIDEO_JB_PAY_SIZE];
+    struct tdav_video_jb_s* jb_list;
+    struct tdav_video_jb_ring_s* jb_ring;
+    trtp_rtp_packet_t* packet;
+    uint64_t time_list = 0, time_ring = 0, time_start;
+    tsk_size_t i, j;
+    uint16_t seq_num;
+
+    memset(&ctx, 0, sizeof(ctx));
+    jb_list = tdav_video_jb_create();
+    jb_ring = tdav_video_jb_ring_create();
+    if (!jb_list || !jb_ring) {
+        TSK_DEBUG_ERROR("Failed to create jitter buffers");
+        goto bail;
+    }
+    tdav_video_jb_set_callback(jb_list, test_video_jb_cb, &ctx);
+    tdav_video_jb_ring_set_callback(jb_ring, test_video_jb_cb, &ctx);
+    tdav_video_jb_start(jb_list);
+    tdav_video_jb_ring_start(jb_ring);
+
+    for (i = 0; i < TEST_VIDEO_JB_BENCH_FRAMES; ++i) {
+        for (j = 0; j < TEST_VIDEO_JB_BENCH_FRAME_PKTS; ++j) {
+            seq_num = (uint16_t)((i * TEST_VIDEO_JB_BENCH_FRAME_PKTS) + j);
+            packet = test_video_jb_packet(payload, seq_num, (uint32_t)(i * 3000), (j == TEST_VIDEO_JB_BENCH_FRAME_PKTS - 1));
+            time_start = tsk_time_now();
+            tdav_video_jb_put(jb_list, packet);
+            time_list += (tsk_time_now() - time_start);
+            time_start = tsk_time_now();
+            tdav_video_jb_ring_put(jb_ring, packet);
+            time_ring += (tsk_time_now() - time_start);
+            TSK_OBJECT_SAFE_FREE(packet);
+        }
+        tsk_thread_sleep(1000 / 30);
+    }
+    tdav_video_jb_stop(jb_list);
+    tdav_video_jb_ring_stop(jb_ring);
+
+    TSK_DEBUG_INFO("Video JB: %u packets inserted in %llu ms (list) and %llu ms (ring)",
+                   (unsigned)(TEST_VIDEO_JB_BENCH_FRAMES * TEST_VIDEO_JB_BENCH_FRAME_PKTS), time_list, time_ring);
+
+bail:
+    TSK_OBJECT_SAFE_FREE(jb_list);
+    TSK_OBJECT_SAFE_FREE(jb_ring);
+}
+
+static void test_video_jb()
+{
+    test_video_jb_ring_loss();
+    test_video_jb_bench();
+}
+
+#endif /* _TINYDEV_TEST_VIDEO_JB_H */
@@ -125,6 +125,8 @@ TINYMEDIA_API int tmedia_defaults_set_bypass_decoding(tsk_bool_t enabled);
 TINYMEDIA_API tsk_bool_t tmedia_defaults_get_bypass_decoding();
 TINYMEDIA_API int tmedia_defaults_set_videojb_enabled(tsk_bool_t enabled);
 TINYMEDIA_API tsk_bool_t tmedia_defaults_get_videojb_enabled();
+TINYMEDIA_API int tmedia_defaults_set_videojb_ring_enabled(tsk_bool_t enabled);
+TINYMEDIA_API tsk_bool_t tmedia_defaults_get_videojb_ring_enabled();
 TINYMEDIA_API int tmedia_defaults_set_video_zeroartifacts_enabled(tsk_bool_t enabled);
 TINYMEDIA_API tsk_bool_t tmedia_defaults_get_video_zeroartifacts_enabled();
 TINYMEDIA_API int tmedia_defaults_set_rtpbuff_size(tsk_size_t rtpbuff_size);
@@ -146,6 +148,13 @@ TINYMEDIA_API int tmedia_defaults_set_webproxy_auto_detect(tsk_bool_t auto_detec
 TINYMEDIA_API tsk_bool_t tmedia_defaults_get_webproxy_auto_detect();
 TINYMEDIA_API int tmedia_defaults_set_webproxy_info(const char* type, const char* host, unsigned short port, const char* login, const char* password);
 TINYMEDIA_API int tmedia_defaults_get_webproxy_info(const char** type, const char** host, unsigned short* port, const char** login, const char** password);
+TINYMEDIA_API int tmedia_defaults_set_media_workers(int32_t count, tsk_bool_t cpu_affinity);
+TINYMEDIA_API int32_t tmedia_defaults_get_media_workers_count();
+TINYMEDIA_API tsk_bool_t tmedia_defaults_get_media_workers_affinity();
+TINYMEDIA_API int tmedia_defaults_set_video_pacing_enabled(tsk_bool_t enabled);
+TINYMEDIA_API tsk_bool_t tmedia_defaults_get_video_pacing_enabled();
+TINYMEDIA_API int tmedia_defaults_set_media_reactor_threads(int32_t count);
+TINYMEDIA_API int32_t tmedia_defaults_get_media_reactor_threads();
 
 TMEDIA_END_DECLS
 
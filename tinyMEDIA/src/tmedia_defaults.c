@@ -81,6 +81,7 @@ static tsk_bool_t __iceturn_enabled = tsk_false; // Whether TURN for ICE (relay
 static tsk_bool_t __bypass_encoding_enabled = tsk_false;
 static tsk_bool_t __bypass_decoding_enabled = tsk_false;
 static tsk_bool_t __videojb_enabled = tsk_true;
+static tsk_bool_t __videojb_ring_enabled = tsk_false; // Whether to use the ring-buffer video jitter buffer (seq-indexed slots) instead of the list-based one
 static tsk_bool_t __video_zeroartifacts_enabled = tsk_false; // Requires from remote parties to support AVPF (RTCP-FIR/NACK/PLI)
 static tsk_size_t __rtpbuff_size = 0x1FFFE; // Network buffer size used for RTP (SO_RCVBUF, SO_SNDBUF)
 static tsk_size_t __avpf_tail_min = 20; // Min size for tail used to honor RTCP-NACK requests
@@ -99,6 +100,10 @@ static char* __webproxy_host = tsk_null;
 static unsigned short __webproxy_port = 0;
 static char* __webproxy_login = tsk_null;
 static char* __webproxy_password = tsk_null;
+static int32_t __media_workers_count = 0; // Number of threads decoding the incoming RTP packets. Zero to decode on the network thread.
+static tsk_bool_t __media_workers_affinity = tsk_false; // Whether to bind each media worker thread to its own CPU.
+static tsk_bool_t __video_pacing_enabled = tsk_false; // Whether to spread the RTP packets of each encoded video frame over time instead of sending them back-to-back.
+static int32_t __media_reactor_threads = 0; // Number of threads reading the RTP/RTCP sockets of all sessions. Zero to use two threads per session, negative for one per CPU.
 
 int tmedia_defaults_set_profile(tmedia_profile_t profile)
 {
@@ -662,6 +667,16 @@ tsk_bool_t tmedia_defaults_get_videojb_enabled()
     return __videojb_enabled;
 }
 
+int tmedia_defaults_set_videojb_ring_enabled(tsk_bool_t enabled)
+{
+    __videojb_ring_enabled = enabled;
+    return 0;
+}
+tsk_bool_t tmedia_defaults_get_videojb_ring_enabled()
+{
+    return __videojb_ring_enabled;
+}
+
 int tmedia_defaults_set_video_zeroartifacts_enabled(tsk_bool_t enabled)
 {
     __video_zeroartifacts_enabled = enabled;
@@ -823,3 +838,46 @@ int tmedia_defaults_get_webproxy_info(const char** type, const char** host, unsi
     }
     return 0;
 }
+
+int tmedia_defaults_set_media_workers(int32_t count, tsk_bool_t cpu_affinity)
+{
+    if (count < 0 || count > 64) {
+        TSK_DEBUG_ERROR("%d not valid as media workers count", count);
+        return -1;
+    }
+    __media_workers_count = count;
+    __media_workers_affinity = cpu_affinity;
+    return 0;
+}
+int32_t tmedia_defaults_get_media_workers_count()
+{
+    return __media_workers_count;
+}
+tsk_bool_t tmedia_defaults_get_media_workers_affinity()
+{
+    return __media_workers_affinity;
+}
+
+int tmedia_defaults_set_video_pacing_enabled(tsk_bool_t enabled)
+{
+    __video_pacing_enabled = enabled;
+    return 0;
+}
+tsk_bool_t tmedia_defaults_get_video_pacing_enabled()
+{
+    return __video_pacing_enabled;
+}
+
+int tmedia_defaults_set_media_reactor_threads(int32_t count)
+{
+    if (count > 64) {
+        TSK_DEBUG_ERROR("%d not valid as media reactor threads count", count);
+        return -1;
+    }
+    __media_reactor_threads = count;
+    return 0;
+}
+int32_t tmedia_defaults_get_media_reactor_threads()
+{
+    return __media_reactor_threads;
+}
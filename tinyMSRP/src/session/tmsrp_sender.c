@@ -140,7 +140,6 @@ bail:
 
 static void* TSK_STDCALL run(void* self)
 {
-    tsk_list_item_t *curr;
     tmsrp_sender_t *sender = (tmsrp_sender_t*)self;
     tmsrp_data_out_t *data_out;
     tsk_buffer_t* chunck, *message = tsk_buffer_create_null();
@@ -155,10 +154,7 @@ static void* TSK_STDCALL run(void* self)
 
     TSK_RUNNABLE_RUN_BEGIN(sender);
 
-    if((curr = TSK_RUNNABLE_POP_FIRST(sender))) {
-        if(!(data_out = (tmsrp_data_out_t*)curr->data)) {
-            continue;
-        }
+    if((data_out = (tmsrp_data_out_t*)tsk_runnable_pop(TSK_RUNNABLE(sender)))) {
 
         error = tsk_false;
         start = 1;
@@ -233,7 +229,7 @@ static void* TSK_STDCALL run(void* self)
         }
 
 
-        tsk_object_unref(curr);
+        tsk_object_unref(data_out);
     }
 
     TSK_RUNNABLE_RUN_END(self);
@@ -2731,7 +2731,6 @@ bail:
 static void* TSK_STDCALL _tnet_ice_ctx_run(void* self)
 {
     // No need to take ref(ctx) because this thread will be stopped by the dtor() before memory free.
-    tsk_list_item_t *curr;
     tnet_ice_ctx_t *ctx = (tnet_ice_ctx_t *)(self);
     tnet_ice_event_t *e;
 
@@ -2743,8 +2742,8 @@ static void* TSK_STDCALL _tnet_ice_ctx_run(void* self)
     // do not move before "TSK_RUNNABLE_RUN_BEGIN(ctx)", otherwise it'll be required to stop the "runnable" to have "ctx->refCount==0"
     ctx = tsk_object_ref(ctx);
 
-    if (ctx->is_started && (curr = TSK_RUNNABLE_POP_FIRST(ctx))) {
-        e = (tnet_ice_event_t*)curr->data;
+    // events raised while the context is stopped are dropped (the queue must be drained to avoid spinning)
+    if ((e = (tnet_ice_event_t*)tsk_runnable_pop(TSK_RUNNABLE(ctx))) && ctx->is_started) {
         switch (e->type) {
         case tnet_ice_event_type_action: {
             if (e->action) {
@@ -2759,8 +2758,8 @@ static void* TSK_STDCALL _tnet_ice_ctx_run(void* self)
             break;
         }
         }
-        tsk_object_unref(curr);
     }
+    TSK_OBJECT_SAFE_FREE(e);
 
     if (!(ctx = tsk_object_unref(ctx))) {
         goto exit;
@@ -146,6 +146,40 @@
 #   endif
 #endif
 
+/* have epoll()? (Linux only)
+* When enabled, "tnet_transport_epoll.c" is used instead of "tnet_transport_poll.c". Requires USE_POLL.
+* Set TNET_EPOLL_EDGE_TRIGGERED to 1 to use edge-triggered notifications.
+*/
+#if !defined(USE_EPOLL)
+#	define USE_EPOLL	0
+#endif
+#if !defined(TNET_EPOLL_EDGE_TRIGGERED)
+#	define TNET_EPOLL_EDGE_TRIGGERED	0
+#endif
+
+/* have recvmmsg()? (Linux >= 2.6.33)
+* Used to read several datagrams with a single system call (see tnet_transport_set_recv_batching()).
+* With autotools the value comes from "config.h".
+*/
+#if !defined(HAVE_RECVMMSG)
+#	if !defined(HAVE_CONFIG_H) && defined(__linux__) && !defined(__ANDROID__) && !defined(ANDROID)
+#		define HAVE_RECVMMSG	1
+#	else
+#		define HAVE_RECVMMSG	0
+#	endif
+#endif
+
+/* have sendmmsg()? (Linux >= 3.0)
+* Used to send several datagrams with a single system call (see tnet_transport_sendto_batch()).
+*/
+#if !defined(HAVE_SENDMMSG)
+#	if !defined(HAVE_CONFIG_H) && defined(__linux__) && !defined(__ANDROID__) && !defined(ANDROID)
+#		define HAVE_SENDMMSG	1
+#	else
+#		define HAVE_SENDMMSG	0
+#	endif
+#endif
+
 #endif /* _TINYNET_H_ */
 
 
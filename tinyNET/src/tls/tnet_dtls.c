@@ -633,8 +633,9 @@ int tnet_dtls_socket_do_handshake(tnet_dtls_socket_handle_t* handle, const struc
 #endif /* SRTP_MAX_KEY_LEN */
 #define EXTRACTOR_dtls_srtp_text "EXTRACTOR-dtls_srtp"
 #define EXTRACTOR_dtls_srtp_text_len 19
-            uint8_t keying_material[SRTP_MAX_KEY_LEN << 1];
-            static const tsk_size_t keying_material_size = sizeof(keying_material);
+#define AEAD_AES_256_GCM_KEY_LEN ((256 >> 3) + (96 >> 3)) // rfc7714 14.2.  SRTP Protection Profiles
+            uint8_t keying_material[TSK_MAX(SRTP_MAX_KEY_LEN, AEAD_AES_256_GCM_KEY_LEN) << 1];
+            tsk_size_t keying_material_size = ((128 >> 3) + (112 >> 3)) << 1; // AES_CM_128_HMAC_SHA1_80 and AES_CM_128_HMAC_SHA1_32
             /*if(socket->use_srtp)*/{
                 SRTP_PROTECTION_PROFILE *p = SSL_get_selected_srtp_profile(socket->ssl);
                 if (!p) {
@@ -644,11 +645,19 @@ int tnet_dtls_socket_do_handshake(tnet_dtls_socket_handle_t* handle, const struc
                 }
                 // alert user
                 _tnet_dtls_socket_raise_event(socket, tnet_dtls_socket_event_type_dtls_srtp_profile_selected, p->name, tsk_strlen(p->name));
+#if defined(SRTP_AEAD_AES_128_GCM) && defined(SRTP_AEAD_AES_256_GCM)
+                if (p->id == SRTP_AEAD_AES_128_GCM) {
+                    keying_material_size = ((128 >> 3) + (96 >> 3)) << 1;
+                }
+                else if (p->id == SRTP_AEAD_AES_256_GCM) {
+                    keying_material_size = AEAD_AES_256_GCM_KEY_LEN << 1;
+                }
+#endif /* SRTP_AEAD_AES_128_GCM && SRTP_AEAD_AES_256_GCM */
 
                 memset(keying_material, 0, sizeof(keying_material));
 
                 // rfc5764 - 4.2.  Key Derivation
-                ret = SSL_export_keying_material(socket->ssl, keying_material, sizeof(keying_material), EXTRACTOR_dtls_srtp_text, EXTRACTOR_dtls_srtp_text_len, tsk_null, 0, 0);
+                ret = SSL_export_keying_material(socket->ssl, keying_material, keying_material_size, EXTRACTOR_dtls_srtp_text, EXTRACTOR_dtls_srtp_text_len, tsk_null, 0, 0);
                 if (ret != 1) {
                     // alert listener
                     _tnet_dtls_socket_raise_event_dataless(socket, tnet_dtls_socket_event_type_error);
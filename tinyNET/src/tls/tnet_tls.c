@@ -29,7 +29,21 @@
 #include "tsk_string.h"
 #include "tsk_memory.h"
 #include "tsk_debug.h"
+#include "tsk_time.h"
+#include "tsk_thread.h"
 #include "tsk_safeobj.h"
+#include "tsk_mutex.h"
+
+#if HAVE_OPENSSL
+#	include <openssl/rand.h>
+#	if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#		include <openssl/core_names.h>
+#		define TNET_TLS_HMAC_CTX	EVP_MAC_CTX
+#	else
+#		include <openssl/hmac.h>
+#		define TNET_TLS_HMAC_CTX	HMAC_CTX
+#	endif
+#endif
 
 #define TNET_TLS_TIMEOUT		2000
 #define TNET_TLS_RETRY_COUNT	10
@@ -43,10 +57,253 @@ typedef struct tnet_tls_socket_s {
     SSL *ssl;
 #endif
 
+    struct {
+        tnet_tls_handshake_state_t state;
+        uint64_t expiry; // time at which the transport gives up
+    } handshake;
+
+    char* dest; // "host:port", client sessions cache key
+
     TSK_DECLARE_SAFEOBJ;
 }
 tnet_tls_socket_t;
 
+#if HAVE_OPENSSL
+typedef struct tnet_tls_ticket_key_s {
+    uint8_t name[16];
+    uint8_t aes[32];
+    uint8_t hmac[32];
+    uint64_t created;
+}
+tnet_tls_ticket_key_t;
+
+typedef struct tnet_tls_session_s {
+    char* dest;
+    SSL_SESSION* session;
+    uint64_t used;
+}
+tnet_tls_session_t;
+
+// Process-wide state, protected by "__tnet_tls_mutex" (ticket keys shared by all the server contexts)
+static tnet_tls_ticket_key_t __tnet_tls_ticket_keys[TNET_TLS_TICKET_KEY_COUNT]; // current key first
+static tnet_tls_session_t __tnet_tls_sessions[TNET_TLS_SESSION_CACHE_SIZE];
+static tnet_tls_stats_t __tnet_tls_stats = { 0 };
+static tsk_mutex_handle_t* volatile __tnet_tls_mutex = tsk_null;
+
+static void _tnet_tls_lock()
+{
+    tsk_mutex_lock(tsk_mutex_get_once(&__tnet_tls_mutex));
+}
+
+static void _tnet_tls_unlock()
+{
+    tsk_mutex_unlock(__tnet_tls_mutex);
+}
+
+/* Must be called with the lock held */
+static int _tnet_tls_ticket_keys_rotate()
+{
+    tnet_tls_ticket_key_t key;
+    if (RAND_bytes(key.name, sizeof(key.name)) != 1 || RAND_bytes(key.aes, sizeof(key.aes)) != 1 || RAND_bytes(key.hmac, sizeof(key.hmac)) != 1) {
+        TSK_DEBUG_ERROR("RAND_bytes failed [%s]", ERR_error_string(ERR_get_error(), tsk_null));
+        return -1;
+    }
+    key.created = tsk_time_now();
+    memmove(&__tnet_tls_ticket_keys[1], &__tnet_tls_ticket_keys[0], sizeof(__tnet_tls_ticket_keys) - sizeof(__tnet_tls_ticket_keys[0]));
+    __tnet_tls_ticket_keys[0] = key;
+    ++__tnet_tls_stats.ticket_key_rotations;
+    return 0;
+}
+
+static int _tnet_tls_ticket_hmac_init(TNET_TLS_HMAC_CTX* hctx, uint8_t* key, tsk_size_t size)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[3];
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key, size);
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "sha256", 0);
+    params[2] = OSSL_PARAM_construct_end();
+    return (EVP_MAC_CTX_set_params(hctx, params) == 1) ? 0 : -1;
+#else
+    return (HMAC_Init_ex(hctx, key, (int)size, EVP_sha256(), tsk_null) == 1) ? 0 : -1;
+#endif
+}
+
+/* Encrypts new tickets with the current key and decrypts the ones issued with the previous keys (renewed) */
+static int _tnet_tls_ticket_key_cb(SSL* ssl, unsigned char key_name[16], unsigned char iv[EVP_MAX_IV_LENGTH], EVP_CIPHER_CTX* cctx, TNET_TLS_HMAC_CTX* hctx, int enc)
+{
+    tnet_tls_ticket_key_t key;
+    int i, ret = -1;
+
+    _tnet_tls_lock();
+    if (enc) {
+        if (!__tnet_tls_ticket_keys[0].created || (tsk_time_now() - __tnet_tls_ticket_keys[0].created) >= TNET_TLS_TICKET_KEY_LIFETIME) {
+            if (_tnet_tls_ticket_keys_rotate() != 0 && !__tnet_tls_ticket_keys[0].created) {
+                _tnet_tls_unlock();
+                return -1;
+            }
+        }
+        key = __tnet_tls_ticket_keys[0], i = 0;
+    }
+    else {
+        for (i = 0; i < TNET_TLS_TICKET_KEY_COUNT; ++i) {
+            if (__tnet_tls_ticket_keys[i].created && memcmp(key_name, __tnet_tls_ticket_keys[i].name, sizeof(__tnet_tls_ticket_keys[i].name)) == 0) {
+                key = __tnet_tls_ticket_keys[i];
+                break;
+            }
+        }
+    }
+    _tnet_tls_unlock();
+
+    if (enc) {
+        memcpy(key_name, key.name, sizeof(key.name));
+        if (RAND_bytes(iv, 16) == 1 && EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), tsk_null, key.aes, iv) == 1 && _tnet_tls_ticket_hmac_init(hctx, key.hmac, sizeof(key.hmac)) == 0) {
+            ret = 1;
+        }
+    }
+    else if (i == TNET_TLS_TICKET_KEY_COUNT) {
+        ret = 0; // unknown or expired key: full handshake
+    }
+    else if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), tsk_null, key.aes, iv) == 1 && _tnet_tls_ticket_hmac_init(hctx, key.hmac, sizeof(key.hmac)) == 0) {
+#if defined(TLS1_3_VERSION)
+        ret = (i || SSL_version(ssl) >= TLS1_3_VERSION) ? 2 : 1; // TLS 1.3 tickets should only be used once: always issue a new one
+#else
+        ret = i ? 2 : 1;
+#endif
+    }
+    memset(&key, 0, sizeof(key));
+    return ret;
+}
+
+/* Called with new client sessions (for TLS 1.3 after the handshake), takes ownership of the session */
+static int _tnet_tls_session_new_cb(SSL* ssl, SSL_SESSION* session)
+{
+    const tnet_tls_socket_t* socket = SSL_get_app_data(ssl);
+    tnet_tls_session_t* entry = tsk_null;
+    SSL_SESSION* old_session = tsk_null;
+    int i;
+
+    if (!socket || !socket->dest) {
+        return 0;
+    }
+
+    _tnet_tls_lock();
+    for (i = 0; i < TNET_TLS_SESSION_CACHE_SIZE; ++i) {
+        if (__tnet_tls_sessions[i].dest && tsk_striequals(__tnet_tls_sessions[i].dest, socket->dest)) {
+            entry = &__tnet_tls_sessions[i];
+            break;
+        }
+        if (!entry || !__tnet_tls_sessions[i].dest || (entry->dest && __tnet_tls_sessions[i].used < entry->used)) {
+            entry = &__tnet_tls_sessions[i]; // free or least recently used
+        }
+    }
+    if (!entry->dest || !tsk_striequals(entry->dest, socket->dest)) {
+        if (!entry->dest) {
+            ++__tnet_tls_stats.client_sessions;
+        }
+        tsk_strupdate(&entry->dest, socket->dest);
+    }
+    old_session = entry->session;
+    entry->session = session;
+    entry->used = tsk_time_now();
+    _tnet_tls_unlock();
+
+    if (old_session) {
+        SSL_SESSION_free(old_session);
+    }
+    return 1;
+}
+
+/* Returns a copy of the session cached for the destination: OpenSSL marks the sessions used by connections not cleanly shut down as not resumable */
+static SSL_SESSION* _tnet_tls_session_get(const char* dest)
+{
+    SSL_SESSION* session = tsk_null;
+    int i;
+
+    _tnet_tls_lock();
+    for (i = 0; i < TNET_TLS_SESSION_CACHE_SIZE; ++i) {
+        if (__tnet_tls_sessions[i].dest && tsk_striequals(__tnet_tls_sessions[i].dest, dest)) {
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            if (!SSL_SESSION_is_resumable(__tnet_tls_sessions[i].session)) {
+                break;
+            }
+#endif
+            session = __tnet_tls_sessions[i].session;
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+            SSL_SESSION_up_ref(session);
+#else
+            CRYPTO_add(&session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#endif
+            __tnet_tls_sessions[i].used = tsk_time_now();
+            break;
+        }
+    }
+    _tnet_tls_unlock();
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if (session) { // copied outside of the lock
+        SSL_SESSION* copy = SSL_SESSION_dup(session);
+        SSL_SESSION_free(session);
+        session = copy;
+    }
+#endif
+
+    return session;
+}
+/* Advances the handshake as far as possible without blocking. The role must be set. */
+static tnet_tls_handshake_state_t _tnet_tls_socket_handshake(tnet_tls_socket_t* socket, tsk_bool_t syscall_is_pending)
+{
+    int ret;
+
+    tsk_safeobj_lock(socket);
+
+    if (socket->handshake.state == tnet_tls_handshake_state_done || socket->handshake.state == tnet_tls_handshake_state_failed) {
+        goto bail;
+    }
+    if (socket->handshake.state == tnet_tls_handshake_state_none) {
+        socket->handshake.expiry = tsk_time_now() + TNET_TLS_HANDSHAKE_TIMEOUT;
+    }
+
+    ERR_clear_error();
+    if ((ret = SSL_do_handshake(socket->ssl)) == 1) {
+        tsk_bool_t resumed = SSL_session_reused(socket->ssl) ? tsk_true : tsk_false;
+        socket->handshake.state = tnet_tls_handshake_state_done;
+        TSK_DEBUG_INFO("TLS handshake completed (fd=%d, resumed=%d)", socket->fd, resumed);
+        _tnet_tls_lock();
+        if (SSL_is_server(socket->ssl)) {
+            ++(*(resumed ? &__tnet_tls_stats.server_resumed : &__tnet_tls_stats.server_full));
+        }
+        else {
+            ++(*(resumed ? &__tnet_tls_stats.client_resumed : &__tnet_tls_stats.client_full));
+        }
+        _tnet_tls_unlock();
+    }
+    else {
+        switch ((ret = SSL_get_error(socket->ssl, ret))) {
+        case SSL_ERROR_WANT_READ:
+            socket->handshake.state = tnet_tls_handshake_state_want_read;
+            break;
+        case SSL_ERROR_WANT_WRITE:
+            socket->handshake.state = tnet_tls_handshake_state_want_write;
+            break;
+        case SSL_ERROR_SYSCALL:
+            if (syscall_is_pending) { // outgoing connection not established yet
+                socket->handshake.state = tnet_tls_handshake_state_want_write;
+                break;
+            }
+        /* fall-through */
+        default:
+            socket->handshake.state = tnet_tls_handshake_state_failed;
+            TSK_DEBUG_ERROR("TLS handshake failed (fd=%d) [%d, %s]", socket->fd, ret, ERR_error_string(ERR_get_error(), tsk_null));
+            break;
+        }
+    }
+
+bail:
+    tsk_safeobj_unlock(socket);
+    return socket->handshake.state;
+}
+#endif
+
 tsk_bool_t tnet_tls_is_supported()
 {
 #if HAVE_OPENSSL
@@ -79,12 +336,14 @@ tnet_tls_socket_handle_t* tnet_tls_socket_create(tnet_fd_t fd, struct ssl_ctx_st
             TSK_OBJECT_SAFE_FREE(socket);
             return tsk_null;
         }
+        SSL_set_app_data(socket->ssl, socket);
     }
     return socket;
 #endif
 }
 
-int tnet_tls_socket_connect(tnet_tls_socket_handle_t* self)
+/* The sessions are cached per destination ("host:port"), none if "host" is null */
+int tnet_tls_socket_connect_2(tnet_tls_socket_handle_t* self, const char* host, tnet_port_t port)
 {
 #if !HAVE_OPENSSL
     TSK_DEBUG_ERROR("You MUST enable OpenSSL");
@@ -98,18 +357,20 @@ int tnet_tls_socket_connect(tnet_tls_socket_handle_t* self)
         return -1;
     }
 
-    if((ret = SSL_connect(socket->ssl)) != 1) {
-        ret = SSL_get_error(socket->ssl, ret);
-        if(ret == SSL_ERROR_WANT_WRITE || ret == SSL_ERROR_WANT_READ || ret == SSL_ERROR_SYSCALL) {
-            ret = 0; /* up to the caller to check that the socket is writable and valid */
-        }
-        else {
-            TSK_DEBUG_ERROR("SSL_connect failed [%d, %s]", ret, ERR_error_string(ERR_get_error(), tsk_null));
+    if(!tsk_strnullORempty(host)) {
+        SSL_SESSION* session;
+        tsk_sprintf(&socket->dest, "%s:%u", host, (unsigned)port);
+        if((session = _tnet_tls_session_get(socket->dest))) {
+            if(SSL_set_session(socket->ssl, session) != 1) {
+                TSK_DEBUG_WARN("SSL_set_session(%s) failed [%s]", socket->dest, ERR_error_string(ERR_get_error(), tsk_null));
+            }
+            SSL_SESSION_free(session);
         }
     }
-    else {
-        ret = 0;
-    }
+
+    SSL_set_connect_state(socket->ssl);
+    /* the transport carries on when the socket is readable/writable */
+    ret = (_tnet_tls_socket_handshake(socket, tsk_true) == tnet_tls_handshake_state_failed) ? -3 : 0;
 
     return ret;
 #endif
@@ -121,7 +382,6 @@ int tnet_tls_socket_accept(tnet_tls_socket_handle_t* self)
     TSK_DEBUG_ERROR("You MUST enable OpenSSL");
     return -200;
 #else
-    int ret = -1;
     tnet_tls_socket_t* socket = self;
 
     if(!self) {
@@ -129,39 +389,9 @@ int tnet_tls_socket_accept(tnet_tls_socket_handle_t* self)
         return -1;
     }
 
-    if((ret = SSL_accept(socket->ssl)) != 1) {
-        ret = SSL_get_error(socket->ssl, ret);
-        if(ret == SSL_ERROR_WANT_READ) {
-            int retval;
-            fd_set rfds;
-            while (1) {
-                FD_ZERO(&rfds);
-                FD_SET(socket->fd, &rfds);
-                retval = select(socket->fd + 1, &rfds, NULL, NULL, NULL);
-                if (retval == -1) {
-                    TNET_PRINT_LAST_ERROR("select() failed");
-                }
-                else if (retval) {
-                    if (FD_ISSET(socket->fd, &rfds)) {
-                        ret = SSL_accept(socket->ssl);
-                        ret = SSL_get_error(socket->ssl, ret);
-                        if (ret == SSL_ERROR_WANT_READ) {
-                            continue;
-                        }
-                        else {
-                            if(ret == SSL_ERROR_NONE) {
-                                return 0;
-                            }
-                            break;
-                        }
-                    }
-                }
-                else {
-                    break;
-                }
-            }
-        }
-        TSK_DEBUG_ERROR("SSL_accept() failed with error code [%d, %s]", ret, ERR_error_string(ERR_get_error(), tsk_null));
+    /* never wait for the client here: the socket is non-blocking and the transport carries on when it's readable/writable */
+    SSL_set_accept_state(socket->ssl);
+    if(_tnet_tls_socket_handshake(socket, tsk_false) == tnet_tls_handshake_state_failed) {
         return -3;
     }
 
@@ -169,6 +399,97 @@ int tnet_tls_socket_accept(tnet_tls_socket_handle_t* self)
 #endif
 }
 
+/* Returns the new state. Must only be called once the role is set (see @ref tnet_tls_socket_connect() and @ref tnet_tls_socket_accept()). */
+tnet_tls_handshake_state_t tnet_tls_socket_do_handshake(tnet_tls_socket_handle_t* self)
+{
+#if !HAVE_OPENSSL
+    TSK_DEBUG_ERROR("You MUST enable OpenSSL");
+    return tnet_tls_handshake_state_failed;
+#else
+    if(!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tnet_tls_handshake_state_failed;
+    }
+    return _tnet_tls_socket_handshake((tnet_tls_socket_t*)self, tsk_false);
+#endif
+}
+
+int tnet_tls_ctx_enable_resumption(struct ssl_ctx_st* ssl_ctx, tsk_bool_t is_server)
+{
+#if !HAVE_OPENSSL
+    TSK_DEBUG_ERROR("You MUST enable OpenSSL");
+    return -200;
+#else
+    static const unsigned char __session_id_context[] = "doubango";
+
+    if(!ssl_ctx) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    if(is_server) {
+        SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_set_session_id_context(ssl_ctx, __session_id_context, sizeof(__session_id_context) - 1);
+        SSL_CTX_set_timeout(ssl_ctx, (long)(((TNET_TLS_TICKET_KEY_COUNT - 1) * (uint64_t)TNET_TLS_TICKET_KEY_LIFETIME) / 1000)); // tickets must not outlive their key
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        if(SSL_CTX_set_tlsext_ticket_key_evp_cb(ssl_ctx, _tnet_tls_ticket_key_cb) != 1) {
+#else
+        if(SSL_CTX_set_tlsext_ticket_key_cb(ssl_ctx, _tnet_tls_ticket_key_cb) != 1) {
+#endif
+            TSK_DEBUG_ERROR("Failed to set the session ticket callback [%s]", ERR_error_string(ERR_get_error(), tsk_null));
+            return -2;
+        }
+    }
+    else {
+        SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ssl_ctx, _tnet_tls_session_new_cb);
+    }
+    return 0;
+#endif
+}
+
+int tnet_tls_rotate_ticket_keys()
+{
+#if !HAVE_OPENSSL
+    TSK_DEBUG_ERROR("You MUST enable OpenSSL");
+    return -200;
+#else
+    int ret;
+    _tnet_tls_lock();
+    ret = _tnet_tls_ticket_keys_rotate();
+    _tnet_tls_unlock();
+    return ret;
+#endif
+}
+
+int tnet_tls_get_stats(tnet_tls_stats_t* stats)
+{
+#if !HAVE_OPENSSL
+    TSK_DEBUG_ERROR("You MUST enable OpenSSL");
+    return -200;
+#else
+    if(!stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    _tnet_tls_lock();
+    *stats = __tnet_tls_stats;
+    _tnet_tls_unlock();
+    return 0;
+#endif
+}
+
+tsk_bool_t tnet_tls_socket_is_handshaking(const tnet_tls_socket_handle_t* self)
+{
+    const tnet_tls_socket_t* socket = self;
+    return socket && (socket->handshake.state == tnet_tls_handshake_state_want_read || socket->handshake.state == tnet_tls_handshake_state_want_write);
+}
+
+uint64_t tnet_tls_socket_get_handshake_expiry(const tnet_tls_socket_handle_t* self)
+{
+    return tnet_tls_socket_is_handshaking(self) ? ((const tnet_tls_socket_t*)self)->handshake.expiry : 0;
+}
+
 int tnet_tls_socket_write(tnet_tls_socket_handle_t* self, const void* data, tsk_size_t size)
 {
 #if !HAVE_OPENSSL
@@ -232,22 +553,9 @@ int tnet_tls_socket_recv(tnet_tls_socket_handle_t* self, void** data, tsk_size_t
 
     /* SSL handshake has completed? */
     if(*isEncrypted) {
-        char* buffer[1024];
-        if((ret = SSL_read(socket->ssl, buffer, sizeof(buffer))) <= 0) {
-            ret = SSL_get_error(socket->ssl, ret);
-            if(ret == SSL_ERROR_WANT_WRITE || ret == SSL_ERROR_WANT_READ) {
-                ret = 0;
-            }
-            else {
-                TSK_DEBUG_ERROR("SSL_read failed [%d, %s]", ret, ERR_error_string(ERR_get_error(), tsk_null));
-            }
-            *size = 0;
-        }
-        else {
-            *size = ret;
-            ret = 0;
-        }
-
+        /* do not use SSL_read() to drive the handshake: application data sent right after it would be lost */
+        ret = (_tnet_tls_socket_handshake(socket, tsk_false) == tnet_tls_handshake_state_failed) ? -3 : 0;
+        *size = 0;
         goto bail;
     }
 
@@ -255,8 +563,12 @@ int tnet_tls_socket_recv(tnet_tls_socket_handle_t* self, void** data, tsk_size_t
 ssl_read:
     if(rcount && ((ret = SSL_read(socket->ssl, (((uint8_t*)*data)+read), (int)to_read)) <= 0)) {
         ret = SSL_get_error(socket->ssl, ret);
-        if(ret == SSL_ERROR_WANT_WRITE || ret == SSL_ERROR_WANT_READ) {
-            if(!(ret = tnet_sockfd_waitUntil(socket->fd, TNET_TLS_TIMEOUT, (ret == SSL_ERROR_WANT_WRITE)))) {
+        if(ret == SSL_ERROR_WANT_READ) { /* e.g. only post-handshake messages (session tickets): the transport calls us again when more data is received */
+            *size = 0;
+            ret = 0;
+        }
+        else if(ret == SSL_ERROR_WANT_WRITE) {
+            if(!(ret = tnet_sockfd_waitUntil(socket->fd, TNET_TLS_TIMEOUT, tsk_true))) {
                 rcount--;
                 goto ssl_read;
             }
@@ -322,6 +634,7 @@ static tsk_object_t* tnet_tls_socket_dtor(tsk_object_t * self)
             SSL_free(socket->ssl);
         }
 #endif
+        TSK_FREE(socket->dest);
         tsk_safeobj_deinit(socket);
     }
     return self;
@@ -45,16 +45,57 @@
 
 TNET_BEGIN_DECLS
 
+#if !defined(TNET_TLS_HANDSHAKE_TIMEOUT)
+#	define TNET_TLS_HANDSHAKE_TIMEOUT	10000 /* milliseconds: the transports close the sockets not done with the handshake within this delay */
+#endif
+#if !defined(TNET_TLS_TICKET_KEY_LIFETIME)
+#	define TNET_TLS_TICKET_KEY_LIFETIME	(12 * 3600 * 1000) /* milliseconds: new session tickets are encrypted with another key after this delay */
+#endif
+#if !defined(TNET_TLS_TICKET_KEY_COUNT)
+#	define TNET_TLS_TICKET_KEY_COUNT	3 /* current key and previous ones still accepted (the tickets are then renewed) */
+#endif
+#if !defined(TNET_TLS_SESSION_CACHE_SIZE)
+#	define TNET_TLS_SESSION_CACHE_SIZE	256 /* client sessions (one per destination), the least recently used is evicted */
+#endif
+
 typedef void tnet_tls_socket_handle_t;
 struct ssl_ctx_st;
 
-int tnet_tls_socket_connect(tnet_tls_socket_handle_t* self);
+/* process-wide, all transports */
+typedef struct tnet_tls_stats_s {
+    uint64_t server_full;
+    uint64_t server_resumed;
+    uint64_t client_full;
+    uint64_t client_resumed;
+    uint64_t ticket_key_rotations;
+    uint32_t client_sessions; // cached
+}
+tnet_tls_stats_t;
+
+typedef enum tnet_tls_handshake_state_e {
+    tnet_tls_handshake_state_none, // not started (e.g. listening socket)
+    tnet_tls_handshake_state_want_read,
+    tnet_tls_handshake_state_want_write,
+    tnet_tls_handshake_state_done,
+    tnet_tls_handshake_state_failed
+}
+tnet_tls_handshake_state_t;
+
+int tnet_tls_socket_connect_2(tnet_tls_socket_handle_t* self, const char* host, tnet_port_t port);
+#define tnet_tls_socket_connect(self) tnet_tls_socket_connect_2((self), tsk_null, 0)
 int tnet_tls_socket_accept(tnet_tls_socket_handle_t* self);
+tnet_tls_handshake_state_t tnet_tls_socket_do_handshake(tnet_tls_socket_handle_t* self);
+tsk_bool_t tnet_tls_socket_is_handshaking(const tnet_tls_socket_handle_t* self);
+uint64_t tnet_tls_socket_get_handshake_expiry(const tnet_tls_socket_handle_t* self);
 int tnet_tls_socket_write(tnet_tls_socket_handle_t* self, const void* data, tsk_size_t size);
 #define tnet_tls_socket_send(self, data, size) tnet_tls_socket_write(self, data, size)
 int tnet_tls_socket_recv(tnet_tls_socket_handle_t* self, void** data, tsk_size_t *size, tsk_bool_t *isEncrypted);
 
+int tnet_tls_ctx_enable_resumption(struct ssl_ctx_st* ssl_ctx, tsk_bool_t is_server);
+
 TINYNET_API tsk_bool_t tnet_tls_is_supported();
+TINYNET_API int tnet_tls_rotate_ticket_keys();
+TINYNET_API int tnet_tls_get_stats(tnet_tls_stats_t* stats);
 TINYNET_API tnet_tls_socket_handle_t* tnet_tls_socket_create(tnet_fd_t fd, struct ssl_ctx_st* ssl_ctx);
 
 TINYNET_GEXTERN const tsk_object_def_t *tnet_tls_socket_def_t;
@@ -25,8 +25,10 @@
 #include "tnet_utils.h"
 #include "tnet_proxy_node_socks_plugin.h"
 #include "tnet_proxy_plugin.h"
+#include "tnet_transport.h"
 
 #include "tsk_time.h"
+#include "tsk_object_cache.h"
 #include "tsk_debug.h"
 
 #include <stdlib.h> /* srand */
@@ -140,6 +142,10 @@ int tnet_startup()
     PRINT_ERROR("SSL is disabled :(");
 #endif
 
+    // objects created for each received packet: recycle their memory
+    tsk_object_cache_enable(tsk_list_item_def_t, "tsk_list_item_t", 0);
+    tsk_object_cache_enable(tnet_transport_event_def_t, "tnet_transport_event_t", 0);
+
     __tnet_started = tsk_true;
 
 bail:
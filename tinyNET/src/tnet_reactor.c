@@ -0,0 +1,565 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file tnet_reactor.c
+ * @brief Shared event loops reading datagram sockets on behalf of any number of owners.
+ *
+ * Each shard owns a thread, an fd-indexed table of the attached sockets and a pipe used to wake up the thread.
+ * The sockets are watched using epoll() when "USE_EPOLL" is enabled, poll() otherwise (the "pollfd" array is rebuilt when the table changes).
+ * The shard's mutex is held while the callbacks are called: once @ref tnet_reactor_detach() returns, the owner's callback will not be called anymore.
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE /* recvmmsg() */
+#endif
+#include "tnet_reactor.h"
+#include "tnet_transport.h" /* TNET_TRANSPORT_BATCH_MAX_COUNT, TNET_TRANSPORT_BATCH_MTU */
+#include "tnet_utils.h"
+#include "tnet_poll.h"
+
+#include "tsk_thread.h"
+#include "tsk_mutex.h"
+#include "tsk_memory.h"
+#include "tsk_debug.h"
+
+#if TNET_REACTOR_SUPPORTED
+
+#if USE_EPOLL
+#	include <sys/epoll.h>
+#endif
+#include <string.h> /* memset() */
+
+#if !defined(TNET_REACTOR_MAX_EVENTS)
+#   define TNET_REACTOR_MAX_EVENTS		256 /* Maximum number of events returned by a single epoll_wait() */
+#endif
+#if !defined(TNET_REACTOR_MIN_SOCKETS)
+#   define TNET_REACTOR_MIN_SOCKETS		64 /* Initial size of the fd-indexed sockets table */
+#endif
+
+/* Same as the epoll transport: the generation is used to ignore events queued for an fd which was detached and reused within the same epoll_wait() batch */
+#define TNET_REACTOR_DATA(fd, generation)		((((uint64_t)(generation)) << 32) | ((uint32_t)(fd)))
+#define TNET_REACTOR_DATA_FD(data)				((tnet_fd_t)((uint32_t)((data) & 0xFFFFFFFF)))
+#define TNET_REACTOR_DATA_GENERATION(data)		((uint32_t)((data) >> 32))
+
+typedef struct tnet_reactor_socket_s {
+    tnet_reactor_cb_f fun; // null if the slot is free
+    const void* usrdata;
+    uint32_t generation;
+}
+tnet_reactor_socket_t;
+
+typedef struct tnet_reactor_shard_s {
+    TSK_DECLARE_OBJECT;
+
+    int32_t index;
+    tsk_thread_handle_t* h_thread;
+    tsk_mutex_handle_t* mutex; // protects "sockets" and held while the callbacks are called
+    tnet_reactor_socket_t* sockets; // indexed by fd
+    tsk_size_t sockets_size;
+    tsk_size_t count; // number of attached sockets
+    uint32_t generation;
+    tsk_bool_t running;
+    tnet_fd_t pipeR;
+    tnet_fd_t pipeW;
+#if USE_EPOLL
+    int epfd;
+    struct epoll_event events[TNET_REACTOR_MAX_EVENTS];
+#else
+    tsk_bool_t dirty; // "sockets" changed: "ufds" must be rebuilt
+    tnet_pollfd_t* ufds; // "pipeR" then the attached sockets
+    tsk_size_t ufds_count;
+    tsk_size_t ufds_size;
+#endif
+
+    uint8_t buffers[TNET_TRANSPORT_BATCH_MAX_COUNT][TNET_TRANSPORT_BATCH_MTU];
+    struct sockaddr_storage addrs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+}
+tnet_reactor_shard_t;
+static const tsk_object_def_t *tnet_reactor_shard_def_t;
+
+// The shards are created on demand and live until the process exits
+static tnet_reactor_shard_t* __tnet_reactor_shards[TNET_REACTOR_MAX_COUNT] = { tsk_null };
+static tsk_mutex_handle_t* volatile __tnet_reactor_shards_mutex = tsk_null;
+static int32_t __tnet_reactor_threads = 0; // zero means one per CPU
+
+static void* TSK_STDCALL _tnet_reactor_shard_run(void* arg);
+
+static void _tnet_reactor_shards_lock()
+{
+    tsk_mutex_lock(tsk_mutex_get_once(&__tnet_reactor_shards_mutex));
+}
+
+static void _tnet_reactor_shards_unlock()
+{
+    tsk_mutex_unlock(__tnet_reactor_shards_mutex);
+}
+
+static tnet_reactor_shard_t* _tnet_reactor_shard_create(int32_t index)
+{
+    tnet_reactor_shard_t* shard;
+    if (!(shard = tsk_object_new(tnet_reactor_shard_def_t))) {
+        TSK_DEBUG_ERROR("Failed to create reactor shard");
+        return tsk_null;
+    }
+    shard->index = index;
+    shard->running = tsk_true;
+#if USE_EPOLL
+    if (shard->epfd < 0) {
+        TSK_OBJECT_SAFE_FREE(shard);
+        return tsk_null;
+    }
+#endif
+    if (!shard->mutex || shard->pipeR == TNET_INVALID_FD || tsk_thread_create(&shard->h_thread, _tnet_reactor_shard_run, shard) != 0) {
+        TSK_DEBUG_ERROR("Failed to start reactor shard #%d", index);
+        shard->running = tsk_false;
+        TSK_OBJECT_SAFE_FREE(shard);
+        return tsk_null;
+    }
+    tsk_thread_set_priority(shard->h_thread, TSK_THREAD_PRIORITY_TIME_CRITICAL);
+    TSK_DEBUG_INFO("Reactor shard #%d started", index);
+    return shard;
+}
+
+// Gets the shard with the fewest sockets
+static tnet_reactor_shard_t* _tnet_reactor_shard_select()
+{
+    int32_t i, count = __tnet_reactor_threads ? __tnet_reactor_threads : tsk_thread_get_cpu_count();
+    tnet_reactor_shard_t* best = tsk_null;
+
+    count = TSK_MIN(TSK_MAX(count, 1), TNET_REACTOR_MAX_COUNT);
+    _tnet_reactor_shards_lock();
+    for (i = 0; i < count; ++i) {
+        if (!__tnet_reactor_shards[i]) {
+            __tnet_reactor_shards[i] = _tnet_reactor_shard_create(i);
+        }
+        if (__tnet_reactor_shards[i] && (!best || __tnet_reactor_shards[i]->count < best->count)) {
+            best = __tnet_reactor_shards[i];
+        }
+    }
+    _tnet_reactor_shards_unlock();
+
+    return best;
+}
+
+static void _tnet_reactor_shard_signal(tnet_reactor_shard_t* self)
+{
+    static const char c = '\0';
+    if (write(self->pipeW, &c, 1) < 0 && tnet_geterrno() != TNET_ERROR_EAGAIN) {
+        TNET_PRINT_LAST_ERROR("Failed to write to the pipe");
+    }
+}
+
+// must be called with the shard locked
+static int _tnet_reactor_shard_add(tnet_reactor_shard_t* self, tnet_fd_t fd, tnet_reactor_cb_f fun, const void* usrdata)
+{
+#if USE_EPOLL
+    struct epoll_event ev;
+#endif
+    if ((tsk_size_t)fd >= self->sockets_size) {
+        tsk_size_t size = TSK_MAX(TSK_MAX((tsk_size_t)TNET_REACTOR_MIN_SOCKETS, (self->sockets_size << 1)), (tsk_size_t)(fd + 1));
+        tnet_reactor_socket_t* sockets;
+        if (!(sockets = tsk_realloc(self->sockets, size * sizeof(tnet_reactor_socket_t)))) {
+            TSK_DEBUG_ERROR("Failed to allocate sockets table with size = %u", (unsigned)size);
+            return -1;
+        }
+        memset(&sockets[self->sockets_size], 0, (size - self->sockets_size) * sizeof(tnet_reactor_socket_t));
+        self->sockets = sockets;
+        self->sockets_size = size;
+    }
+    if (self->sockets[fd].fun) {
+        TSK_DEBUG_ERROR("Socket %d already attached", fd);
+        return -2;
+    }
+    self->sockets[fd].generation = ++self->generation;
+#if USE_EPOLL
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = TNET_REACTOR_DATA(fd, self->sockets[fd].generation);
+    if (epoll_ctl(self->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        TNET_PRINT_LAST_ERROR("epoll_ctl(EPOLL_CTL_ADD, %d) failed", fd);
+        return -3;
+    }
+#else
+    self->dirty = tsk_true;
+#endif
+    self->sockets[fd].fun = fun;
+    self->sockets[fd].usrdata = usrdata;
+    ++self->count;
+    return 0;
+}
+
+// must be called with the shard locked
+static tsk_bool_t _tnet_reactor_shard_remove(tnet_reactor_shard_t* self, tnet_fd_t fd)
+{
+    if ((tsk_size_t)fd >= self->sockets_size || !self->sockets[fd].fun) {
+        return tsk_false;
+    }
+#if USE_EPOLL
+    if (epoll_ctl(self->epfd, EPOLL_CTL_DEL, fd, tsk_null) != 0) {
+        TSK_DEBUG_WARN("epoll_ctl(EPOLL_CTL_DEL, %d) failed", fd);
+    }
+#else
+    self->dirty = tsk_true;
+#endif
+    self->sockets[fd].fun = tsk_null;
+    self->sockets[fd].usrdata = tsk_null;
+    --self->count;
+    return tsk_true;
+}
+
+// must be called with the shard locked: reads the pending datagrams (up to TNET_TRANSPORT_BATCH_MAX_COUNT) and forwards them to the owner
+static void _tnet_reactor_shard_recv(tnet_reactor_shard_t* self, tnet_fd_t fd)
+{
+    tsk_size_t i, count = 0, sizes[TNET_TRANSPORT_BATCH_MAX_COUNT];
+    int ret;
+#if HAVE_RECVMMSG
+    struct mmsghdr msgs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+    struct iovec iovecs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < TNET_TRANSPORT_BATCH_MAX_COUNT; ++i) {
+        iovecs[i].iov_base = self->buffers[i];
+        iovecs[i].iov_len = TNET_TRANSPORT_BATCH_MTU;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &self->addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(self->addrs[i]);
+    }
+    // errors (e.g. ICMP port unreachable reported on the next read) are ignored: the socket stays attached until detached by its owner
+    ret = recvmmsg(fd, msgs, TNET_TRANSPORT_BATCH_MAX_COUNT, MSG_DONTWAIT, tsk_null);
+    for (i = 0; i < (tsk_size_t)TSK_MAX(ret, 0); ++i) {
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            TSK_DEBUG_WARN("Dropping datagram bigger than %u bytes", (unsigned)TNET_TRANSPORT_BATCH_MTU);
+            continue;
+        }
+        if (msgs[i].msg_len > 0) {
+            if (count != i) {
+                memcpy(self->buffers[count], self->buffers[i], msgs[i].msg_len);
+                self->addrs[count] = self->addrs[i];
+            }
+            sizes[count++] = msgs[i].msg_len;
+        }
+    }
+#else
+    for (i = 0; i < TNET_TRANSPORT_BATCH_MAX_COUNT; ++i) {
+        tsk_size_t pending = 0;
+        if (i > 0 && (tnet_ioctlt(fd, FIONREAD, &pending) != 0 || !pending)) {
+            break;
+        }
+        if ((ret = tnet_sockfd_recvfrom(fd, self->buffers[count], TNET_TRANSPORT_BATCH_MTU, 0, (struct sockaddr*)&self->addrs[count])) < 0) {
+            break;
+        }
+        if (ret > 0) {
+            sizes[count++] = (tsk_size_t)ret;
+        }
+    }
+#endif
+    // the callback could detach the socket (recursive mutex)
+    for (i = 0; i < count && self->sockets[fd].fun; ++i) {
+        self->sockets[fd].fun(self->sockets[fd].usrdata, fd, self->buffers[i], sizes[i], &self->addrs[i]);
+    }
+}
+
+static void _tnet_reactor_shard_drain_pipe(tnet_reactor_shard_t* self)
+{
+    char buffer[64];
+    while (read(self->pipeR, buffer, sizeof(buffer)) == sizeof(buffer)) ;
+}
+
+#if !USE_EPOLL
+// must be called with the shard locked
+static int _tnet_reactor_shard_rebuild(tnet_reactor_shard_t* self)
+{
+    tsk_size_t fd;
+    if ((self->count + 1) > self->ufds_size) {
+        tsk_size_t size = TSK_MAX((self->count + 1), (self->ufds_size << 1));
+        if (!(self->ufds = tsk_realloc(self->ufds, size * sizeof(tnet_pollfd_t)))) {
+            TSK_DEBUG_ERROR("Failed to allocate pollfd array with size = %u", (unsigned)size);
+            self->ufds_size = self->ufds_count = 0;
+            return -1;
+        }
+        self->ufds_size = size;
+    }
+    self->ufds[0].fd = self->pipeR;
+    self->ufds[0].events = TNET_POLLIN;
+    self->ufds[0].revents = 0;
+    self->ufds_count = 1;
+    for (fd = 0; fd < self->sockets_size; ++fd) {
+        if (self->sockets[fd].fun) {
+            self->ufds[self->ufds_count].fd = (tnet_fd_t)fd;
+            self->ufds[self->ufds_count].events = TNET_POLLIN;
+            self->ufds[self->ufds_count].revents = 0;
+            ++self->ufds_count;
+        }
+    }
+    self->dirty = tsk_false;
+    return 0;
+}
+#endif /* !USE_EPOLL */
+
+static void* TSK_STDCALL _tnet_reactor_shard_run(void* arg)
+{
+    tnet_reactor_shard_t* self = (tnet_reactor_shard_t*)arg;
+    tnet_fd_t fd;
+    int i, ret;
+
+    TSK_DEBUG_INFO("Reactor shard #%d - ENTER", self->index);
+
+    while (self->running) {
+#if USE_EPOLL
+        if ((ret = epoll_wait(self->epfd, self->events, TNET_REACTOR_MAX_EVENTS, -1)) < 0) {
+            if (tnet_geterrno() == TNET_ERROR_INTR) {
+                continue;
+            }
+            TNET_PRINT_LAST_ERROR("epoll_wait() failed");
+            break;
+        }
+        tsk_mutex_lock(self->mutex);
+        for (i = 0; i < ret && self->running; ++i) {
+            fd = TNET_REACTOR_DATA_FD(self->events[i].data.u64);
+            if (fd == self->pipeR) {
+                _tnet_reactor_shard_drain_pipe(self);
+            }
+            else if ((tsk_size_t)fd < self->sockets_size && self->sockets[fd].fun && self->sockets[fd].generation == TNET_REACTOR_DATA_GENERATION(self->events[i].data.u64)) {
+                _tnet_reactor_shard_recv(self, fd);
+            }
+        }
+        tsk_mutex_unlock(self->mutex);
+#else
+        tsk_mutex_lock(self->mutex);
+        if (self->dirty) {
+            _tnet_reactor_shard_rebuild(self);
+        }
+        tsk_mutex_unlock(self->mutex);
+        // only this thread changes "ufds"
+        if ((ret = tnet_poll(self->ufds, (tnet_nfds_t)self->ufds_count, -1)) < 0) {
+            if (tnet_geterrno() == TNET_ERROR_INTR) {
+                continue;
+            }
+            TNET_PRINT_LAST_ERROR("poll() failed");
+            break;
+        }
+        tsk_mutex_lock(self->mutex);
+        for (i = 0; i < (int)self->ufds_count && ret > 0 && self->running; ++i) {
+            if (!self->ufds[i].revents) {
+                continue;
+            }
+            --ret;
+            fd = self->ufds[i].fd;
+            if (fd == self->pipeR) {
+                _tnet_reactor_shard_drain_pipe(self);
+            }
+            else if ((tsk_size_t)fd < self->sockets_size && self->sockets[fd].fun) { // otherwise, detached while polling
+                _tnet_reactor_shard_recv(self, fd);
+            }
+        }
+        tsk_mutex_unlock(self->mutex);
+#endif
+    }
+
+    TSK_DEBUG_INFO("Reactor shard #%d - EXIT", self->index);
+    return tsk_null;
+}
+
+#endif /* TNET_REACTOR_SUPPORTED */
+
+/**@ingroup tnet_reactor_group
+* Sets the number of event loop threads. Only the threads not started yet are affected.
+* @param count The number of threads within [0, TNET_REACTOR_MAX_COUNT]. Zero means one per CPU (default).
+*/
+int tnet_reactor_set_threads(int32_t count)
+{
+    if (count < 0 || count > TNET_REACTOR_MAX_COUNT) {
+        TSK_DEBUG_ERROR("%d not valid as reactor threads count", count);
+        return -1;
+    }
+#if TNET_REACTOR_SUPPORTED
+    __tnet_reactor_threads = count;
+#endif
+    return 0;
+}
+
+/**@ingroup tnet_reactor_group
+* Starts watching datagram sockets. All the sockets are served by the same thread, the one with the fewest sockets.
+* The sockets must be non-blocking and must not be added to a started transport.
+* @param fds The sockets to watch.
+* @param fun The function to call for each datagram received.
+* @param usrdata Opaque data to forward to @a fun.
+* @retval Zero if succeed and non-zero error code otherwise (e.g. not supported on this platform).
+*/
+int tnet_reactor_attach(const tnet_fd_t* fds, tsk_size_t count, tnet_reactor_cb_f fun, const void* usrdata)
+{
+#if TNET_REACTOR_SUPPORTED
+    tnet_reactor_shard_t* shard;
+    tsk_size_t i;
+    int ret = 0;
+
+    if (!fds || !count || !fun) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    for (i = 0; i < count; ++i) {
+        if (fds[i] == TNET_INVALID_FD) {
+            TSK_DEBUG_ERROR("Invalid socket");
+            return -1;
+        }
+    }
+    if (!(shard = _tnet_reactor_shard_select())) {
+        return -2;
+    }
+    tsk_mutex_lock(shard->mutex);
+    for (i = 0; i < count; ++i) {
+        if ((ret = _tnet_reactor_shard_add(shard, fds[i], fun, usrdata))) {
+            while (i-- > 0) {
+                _tnet_reactor_shard_remove(shard, fds[i]);
+            }
+            break;
+        }
+    }
+    tsk_mutex_unlock(shard->mutex);
+#if !USE_EPOLL
+    _tnet_reactor_shard_signal(shard); // rebuild the pollfd array
+#endif
+    if (ret == 0) {
+        TSK_DEBUG_INFO("%u socket(s) attached to reactor shard #%d (%u sockets)", (unsigned)count, shard->index, (unsigned)shard->count);
+    }
+    return ret;
+#else
+    TSK_DEBUG_ERROR("Reactor not supported on this platform");
+    return -2;
+#endif
+}
+
+/**@ingroup tnet_reactor_group
+* Stops watching sockets. When this function returns the owner's callback is not running and will not be called again for these sockets.
+* Must not be called while holding a lock also used in the callback.
+*/
+int tnet_reactor_detach(const tnet_fd_t* fds, tsk_size_t count)
+{
+#if TNET_REACTOR_SUPPORTED
+    tnet_reactor_shard_t* shard;
+    tsk_size_t i;
+    int32_t j;
+
+    if (!fds || !count) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    for (j = 0; j < TNET_REACTOR_MAX_COUNT; ++j) {
+        _tnet_reactor_shards_lock();
+        shard = __tnet_reactor_shards[j];
+        _tnet_reactor_shards_unlock();
+        if (!shard) {
+            break; // created in order
+        }
+        tsk_mutex_lock(shard->mutex);
+        for (i = 0; i < count; ++i) {
+            if (fds[i] != TNET_INVALID_FD) {
+                _tnet_reactor_shard_remove(shard, fds[i]);
+            }
+        }
+        tsk_mutex_unlock(shard->mutex);
+#if !USE_EPOLL
+        _tnet_reactor_shard_signal(shard); // stop polling the sockets before they are closed
+#endif
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+
+#if TNET_REACTOR_SUPPORTED
+//=================================================================================================
+//	Reactor shard object definition
+//
+static tsk_object_t* tnet_reactor_shard_ctor(tsk_object_t * self, va_list * app)
+{
+    tnet_reactor_shard_t *shard = self;
+    if (shard) {
+        tnet_fd_t pipes[2];
+        shard->pipeR = shard->pipeW = TNET_INVALID_FD;
+        shard->mutex = tsk_mutex_create();
+        if (pipe(pipes) == 0) {
+            shard->pipeR = pipes[0];
+            shard->pipeW = pipes[1];
+            tnet_sockfd_set_nonblocking(shard->pipeR);
+            tnet_sockfd_set_nonblocking(shard->pipeW);
+        }
+        else {
+            TNET_PRINT_LAST_ERROR("Failed to create new pipes.");
+        }
+#if USE_EPOLL
+        if ((shard->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            TNET_PRINT_LAST_ERROR("epoll_create1() failed");
+        }
+        else if (shard->pipeR != TNET_INVALID_FD) {
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u64 = TNET_REACTOR_DATA(shard->pipeR, 0);
+            if (epoll_ctl(shard->epfd, EPOLL_CTL_ADD, shard->pipeR, &ev) != 0) {
+                TNET_PRINT_LAST_ERROR("epoll_ctl(EPOLL_CTL_ADD, %d) failed", shard->pipeR);
+            }
+        }
+#else
+        shard->dirty = tsk_true;
+#endif
+    }
+    return self;
+}
+static tsk_object_t* tnet_reactor_shard_dtor(tsk_object_t * self)
+{
+    tnet_reactor_shard_t *shard = self;
+    if (shard) {
+        if (shard->h_thread) {
+            shard->running = tsk_false;
+            _tnet_reactor_shard_signal(shard);
+            tsk_thread_join(&shard->h_thread);
+        }
+#if USE_EPOLL
+        if (shard->epfd >= 0) {
+            close(shard->epfd);
+        }
+#else
+        TSK_FREE(shard->ufds);
+#endif
+        if (shard->pipeR != TNET_INVALID_FD) {
+            close(shard->pipeR);
+        }
+        if (shard->pipeW != TNET_INVALID_FD) {
+            close(shard->pipeW);
+        }
+        TSK_FREE(shard->sockets);
+        if (shard->mutex) {
+            tsk_mutex_destroy(&shard->mutex);
+        }
+    }
+    return self;
+}
+static const tsk_object_def_t tnet_reactor_shard_def_s = {
+    sizeof(tnet_reactor_shard_t),
+    tnet_reactor_shard_ctor,
+    tnet_reactor_shard_dtor,
+    tsk_null,
+};
+static const tsk_object_def_t *tnet_reactor_shard_def_t = &tnet_reactor_shard_def_s;
+#endif /* TNET_REACTOR_SUPPORTED */
@@ -0,0 +1,56 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file tnet_reactor.h
+ * @brief Shared event loops reading datagram sockets on behalf of any number of owners.
+ *
+ * Unlike @ref tnet_transport_start() which starts two threads per transport, a fixed number of threads (shards, one per CPU by default)
+ * poll all the sockets attached to the reactor and call the owner's callback with the datagrams received.
+ * The sockets of an owner (e.g. RTP and RTCP sockets of a media session) are served by the same shard, so their callbacks are never called concurrently.
+ */
+#ifndef TNET_REACTOR_H
+#define TNET_REACTOR_H
+
+#include "tinynet_config.h"
+
+#include "tnet_types.h"
+
+TNET_BEGIN_DECLS
+
+/* Requires poll() or epoll() and pipes */
+#define TNET_REACTOR_SUPPORTED	(USE_POLL && !TNET_UNDER_WINDOWS)
+
+#if !defined(TNET_REACTOR_MAX_COUNT)
+#	define TNET_REACTOR_MAX_COUNT	64 /* Maximum number of event loop threads */
+#endif
+
+/** Called on the shard's thread for each datagram received. "data" is only valid until the function returns.
+* @retval Zero if succeed and non-zero error code otherwise.
+*/
+typedef int (*tnet_reactor_cb_f)(const void* usrdata, tnet_fd_t local_fd, const void* data, tsk_size_t size, const struct sockaddr_storage* remote_addr);
+
+TINYNET_API int tnet_reactor_set_threads(int32_t count);
+TINYNET_API int tnet_reactor_attach(const tnet_fd_t* fds, tsk_size_t count, tnet_reactor_cb_f fun, const void* usrdata);
+TINYNET_API int tnet_reactor_detach(const tnet_fd_t* fds, tsk_size_t count);
+
+TNET_END_DECLS
+
+#endif /* TNET_REACTOR_H */
@@ -88,10 +88,11 @@ static int tnet_socket_close(tnet_socket_t *sock);
 * @param type The type of the socket. See @ref tnet_socket_type_t.
 * @param nonblocking Indicates whether to create non-blocking socket.
 * @param bindsocket Indicates whether to bind the newly created socket or not.
+* @param reuseport Indicates whether other sockets could bind to the same address and port (SO_REUSEPORT). All these sockets must set this option.
 * @retval @ref tnet_socket_t object.
 * @sa @ref tnet_socket_create.
 */
-tnet_socket_t* tnet_socket_create_2(const char* host, tnet_port_t port_, tnet_socket_type_t type, tsk_bool_t nonblocking, tsk_bool_t bindsocket)
+tnet_socket_t* tnet_socket_create_3(const char* host, tnet_port_t port_, tnet_socket_type_t type, tsk_bool_t nonblocking, tsk_bool_t bindsocket, tsk_bool_t reuseport)
 {
     tnet_socket_t *sock;
     if ((sock = tsk_object_new(tnet_socket_def_t))) {
@@ -155,6 +156,13 @@ tnet_socket_t* tnet_socket_create_2(const char* host, tnet_port_t port_, tnet_so
                 }
             }
 
+            if (reuseport) {
+                if ((status = tnet_sockfd_reuseport(sock->fd, 1))) {
+                    tnet_socket_close(sock);
+                    continue;
+                }
+            }
+
             if (bindsocket) {
                 /* Bind the socket */
                 if ((status = bind(sock->fd, ptr->ai_addr, (int)ptr->ai_addrlen))) {
@@ -222,6 +230,15 @@ bail:
     return sock;
 }
 
+/**@ingroup tnet_socket_group
+* Creates a new socket.
+* @sa @ref tnet_socket_create_3.
+*/
+tnet_socket_t* tnet_socket_create_2(const char* host, tnet_port_t port, tnet_socket_type_t type, tsk_bool_t nonblocking, tsk_bool_t bindsocket)
+{
+    return tnet_socket_create_3(host, port, type, nonblocking, bindsocket, tsk_false);
+}
+
 /**@ingroup tnet_socket_group
 * Creates a non-blocking socket and bind it.
 * To check that the returned socket is valid use @ref TNET_SOCKET_IS_VALID function.
@@ -26,6 +26,9 @@
  * Stream transport can manage TCP, TLS and SCTP sockets. Datagram socket can only manage UDP sockets. <br>
  * A transport can hold both IPv4 and IPv6 sockets.
  */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+#endif
 #include "tnet_transport.h"
 #include "tnet_proxy_plugin.h"
 #include "tnet_proxydetect.h"
@@ -41,6 +44,20 @@
 #include "tsk_buffer.h"
 
 #include <string.h> /* memcpy, ...(<#void * #>, <#const void * #>, <#tsk_size_t #>) */
+#if defined(__linux__)
+#	include <netinet/udp.h> /* UDP_SEGMENT */
+#endif
+
+/* UDP Generic Segmentation Offload (Linux >= 4.18): several same-sized datagrams handed to the kernel as a single buffer */
+#if !defined(TNET_HAVE_UDP_GSO)
+#	if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+#		define TNET_HAVE_UDP_GSO	1
+#	else
+#		define TNET_HAVE_UDP_GSO	0
+#	endif
+#endif
+#define TNET_UDP_GSO_MAX_SEGMENTS	64 /* UDP_MAX_SEGMENTS */
+#define TNET_UDP_GSO_MAX_SIZE		65000 /* must fit into a single IP datagram */
 
 #ifndef TNET_CIPHER_LIST
 #	define TNET_CIPHER_LIST  "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH"
@@ -68,6 +85,20 @@ extern int tnet_transport_unprepare(tnet_transport_t *transport);
 extern void* TSK_STDCALL tnet_transport_mainthread(void *param);
 extern int tnet_transport_stop(tnet_transport_t *transport);
 
+/** Datagrams received with a single call to tnet_transport_recv_batch(). Pooled per transport. */
+typedef struct tnet_transport_batch_s {
+    TSK_DECLARE_OBJECT;
+
+    tsk_size_t count;
+    tsk_size_t capacity; // number of buffers allocated in "buffers"
+    tsk_size_t sizes[TNET_TRANSPORT_BATCH_MAX_COUNT];
+    struct sockaddr_storage addrs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+    uint8_t* buffers; // "capacity" buffers of TNET_TRANSPORT_BATCH_MTU bytes
+}
+tnet_transport_batch_t;
+#define TNET_TRANSPORT_BATCH_BUFFER(batch, index) ((batch)->buffers + ((index) * TNET_TRANSPORT_BATCH_MTU))
+static const tsk_object_def_t *tnet_transport_batch_def_t;
+
 static void* TSK_STDCALL run(void* self);
 static int _tnet_transport_dtls_cb(const void* usrdata, tnet_dtls_socket_event_type_t e, const tnet_dtls_socket_handle_t* handle, const void* data, tsk_size_t size);
 
@@ -107,6 +138,10 @@ static int _tnet_transport_ssl_init(tnet_transport_t* transport)
                 TSK_DEBUG_ERROR("SSL_CTX_set_cipher_list failed [%s]", ERR_error_string(ERR_get_error(), tsk_null));
                 return -4;
             }
+            // reconnecting peers skip the asymmetric operations: session tickets (server) and sessions cached per destination (client)
+            if (tnet_tls_ctx_enable_resumption(transport->tls.ctx_client, tsk_false) != 0 || tnet_tls_ctx_enable_resumption(transport->tls.ctx_server, tsk_true) != 0) {
+                return -7;
+            }
         }
 #if HAVE_OPENSSL_DTLS
         if ((transport->dtls.enabled = is_dtls)) {
@@ -159,6 +194,16 @@ static int _tnet_transport_ssl_deinit(tnet_transport_t* transport)
 }
 
 tnet_transport_t* tnet_transport_create(const char* host, tnet_port_t port, tnet_socket_type_t type, const char* description)
+{
+    return tnet_transport_create_3(host, port, type, tsk_false, description);
+}
+
+/**@ingroup tnet_transport_group
+* Creates a transport with its own network thread and event queue.
+* @param reuseport Whether the master socket could share the same address and port with other transports (SO_REUSEPORT). All these transports must set this option.
+* The kernel then load balances the incoming datagrams and connections across the transports.
+*/
+tnet_transport_t* tnet_transport_create_3(const char* host, tnet_port_t port, tnet_socket_type_t type, tsk_bool_t reuseport, const char* description)
 {
     tnet_transport_t* transport;
 
@@ -169,7 +214,7 @@ tnet_transport_t* tnet_transport_create(const char* host, tnet_port_t port, tnet
         transport->type = type;
         transport->context = tnet_transport_context_create();
 
-        if ((transport->master = tnet_socket_create(transport->local_host, transport->req_local_port, transport->type))) {
+        if ((transport->master = tnet_socket_create_3(transport->local_host, transport->req_local_port, transport->type, tsk_true, tsk_true, reuseport))) {
             transport->local_ip = tsk_strdup(transport->master->ip);
             transport->bind_local_port = transport->master->port;
 			transport->type = transport->master->type;
@@ -871,7 +916,7 @@ tnet_fd_t tnet_transport_connectto_3(const tnet_transport_handle_t *handle, stru
                 TSK_OBJECT_SAFE_FREE(socket->tlshandle);
                 socket->tlshandle = tsk_object_ref(tls_handle);
             }
-            if ((status = tnet_tls_socket_connect(tls_handle))) {
+            if ((status = tnet_tls_socket_connect_2(tls_handle, host, port))) {
                 tnet_sockfd_close(&fd);
                 goto bail;
             }
@@ -906,6 +951,40 @@ int tnet_transport_set_callback(const tnet_transport_handle_t *handle, tnet_tran
     return 0;
 }
 
+/**@ingroup tnet_transport_group
+* Enables or disables batched reception on datagram transports.
+* When enabled, all datagrams pending on a socket are read with a single system call (recvmmsg() when available) into pooled buffers
+* instead of one heap allocation and one queued event per datagram. The callback still receives one @ref event_data event per datagram.
+* Each datagram is received in a buffer of @ref TNET_TRANSPORT_BATCH_MTU bytes (2048 by default). A larger datagram is received on its own when
+* it's the next one to read, otherwise it's truncated then dropped.
+* @param handle The transport.
+* @param enabled Whether to enable batching. No effect on stream transports.
+* @retval Zero if succeed and non-zero error code otherwise.
+*/
+int tnet_transport_set_recv_batching(tnet_transport_handle_t *handle, tsk_bool_t enabled)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+
+    if (!transport) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!transport->recv_batch.pool) {
+        if (!enabled) {
+            return 0;
+        }
+        if (!(transport->recv_batch.pool = tsk_list_create())) {
+            TSK_DEBUG_ERROR("Failed to create batch pool");
+            return -2;
+        }
+        transport->recv_batch.capacity = TNET_TRANSPORT_BATCH_MIN_COUNT;
+    }
+    tsk_list_lock(transport->recv_batch.pool); // also creates the on-demand mutex before the network and consumer threads use it
+    transport->recv_batch.enabled = enabled;
+    tsk_list_unlock(transport->recv_batch.pool);
+    return 0;
+}
+
 int tnet_transport_set_proxy_auto_detect(tnet_transport_handle_t *handle, tsk_bool_t auto_detect)
 {
     tnet_transport_t *transport = (tnet_transport_t*)handle;
@@ -1021,13 +1100,357 @@ static int _tnet_transport_dtls_cb(const void* usrdata, tnet_dtls_socket_event_t
 }
 
 
+static tnet_transport_batch_t* _tnet_transport_batch_acquire(tnet_transport_t* transport)
+{
+    tnet_transport_batch_t* batch = tsk_null;
+    tsk_list_item_t* item;
+
+    tsk_list_lock(transport->recv_batch.pool);
+    if ((item = tsk_list_pop_first_item(transport->recv_batch.pool))) {
+        batch = (tnet_transport_batch_t*)tsk_object_ref(item->data);
+        TSK_OBJECT_SAFE_FREE(item);
+    }
+    tsk_list_unlock(transport->recv_batch.pool);
+
+    if (!batch && !(batch = tsk_object_new(tnet_transport_batch_def_t))) {
+        TSK_DEBUG_ERROR("Failed to create batch");
+        return tsk_null;
+    }
+    if (batch->capacity < transport->recv_batch.capacity) {
+        uint8_t* buffers = tsk_realloc(batch->buffers, (transport->recv_batch.capacity * TNET_TRANSPORT_BATCH_MTU));
+        if (buffers) {
+            batch->buffers = buffers;
+            batch->capacity = transport->recv_batch.capacity;
+        }
+        else if (!batch->capacity) {
+            TSK_DEBUG_ERROR("Failed to allocate %u batch buffers", (unsigned)transport->recv_batch.capacity);
+            TSK_OBJECT_SAFE_FREE(batch);
+            return tsk_null;
+        }
+    }
+    batch->count = 0;
+    return batch;
+}
+
+// Receives the next datagram, too big for the batch buffers, as a single "event_data" event like the unbatched path does
+static int _tnet_transport_recv_one(tnet_transport_t* transport, tnet_fd_t fd, tsk_size_t size)
+{
+    tnet_transport_event_t* e;
+    struct sockaddr_storage remote_addr;
+    uint8_t* buffer;
+    int ret, err;
+
+    if (!(buffer = tsk_calloc(size, sizeof(uint8_t)))) {
+        TSK_DEBUG_ERROR("Failed to allocate buffer with size = %u", (unsigned)size);
+        return 0;
+    }
+    if ((ret = tnet_sockfd_recvfrom(fd, buffer, size, 0, (struct sockaddr*)&remote_addr)) <= 0) {
+        TSK_FREE(buffer);
+        if (ret < 0 && (err = tnet_geterrno()) != TNET_ERROR_WOULDBLOCK && err != TNET_ERROR_INPROGRESS && err != TNET_ERROR_EAGAIN) {
+            TNET_PRINT_LAST_ERROR("recvfrom have failed");
+            return -1;
+        }
+        return 0;
+    }
+    transport->bytes_in += ret;
+    if (!(e = tnet_transport_event_create(event_data, transport->callback_data, fd))) {
+        TSK_FREE(buffer);
+        return 0;
+    }
+    e->data = buffer;
+    e->size = (tsk_size_t)ret;
+    e->remote_addr = remote_addr;
+    TSK_RUNNABLE_ENQUEUE_OBJECT_SAFE(TSK_RUNNABLE(transport), e);
+    return 1;
+}
+
+static void _tnet_transport_batch_release(tnet_transport_t* transport, tnet_transport_batch_t** batch)
+{
+    tsk_list_lock(transport->recv_batch.pool);
+    if (tsk_list_count(transport->recv_batch.pool, tsk_null, tsk_null) < TNET_TRANSPORT_BATCH_POOL_MAX) {
+        tsk_list_push_back_data(transport->recv_batch.pool, (void**)batch);
+    }
+    tsk_list_unlock(transport->recv_batch.pool);
+    TSK_OBJECT_SAFE_FREE(*batch);
+}
+
+/*
+* Reads all datagrams pending on "fd" (up to TNET_TRANSPORT_BATCH_MAX_COUNT) and queues them as a single "event_data_batch" event.
+* Called by the network thread when "recv_batch.enabled" is true.
+* Returns a positive value if datagrams could still be pending (all buffers filled), zero if the socket is drained or a negative value if the socket is in error and must be removed.
+*/
+int tnet_transport_recv_batch(tnet_transport_t* transport, tnet_fd_t fd)
+{
+    tnet_transport_batch_t* batch;
+    tnet_transport_event_t* e;
+    tsk_size_t i, count = 0, pending = 0;
+    tsk_bool_t full = tsk_false;
+    int ret, err = 0;
+#if HAVE_RECVMMSG
+    struct mmsghdr msgs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+    struct iovec iovecs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+#endif
+
+    if (!transport || !transport->recv_batch.pool) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return 0;
+    }
+
+#if HAVE_RECVMMSG
+    // on Linux, FIONREAD gives the size of the next datagram
+    if (tnet_ioctlt(fd, FIONREAD, &pending) == 0 && pending > TNET_TRANSPORT_BATCH_MTU) {
+        return _tnet_transport_recv_one(transport, fd, pending);
+    }
+    if (!(batch = _tnet_transport_batch_acquire(transport))) {
+        return 0;
+    }
+    memset(msgs, 0, (batch->capacity * sizeof(msgs[0])));
+    for (i = 0; i < batch->capacity; ++i) {
+        iovecs[i].iov_base = TNET_TRANSPORT_BATCH_BUFFER(batch, i);
+        iovecs[i].iov_len = TNET_TRANSPORT_BATCH_MTU;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+    }
+    if ((ret = recvmmsg(fd, msgs, (unsigned int)batch->capacity, MSG_DONTWAIT, tsk_null)) < 0) {
+        err = tnet_geterrno();
+    }
+    full = (ret >= (int)batch->capacity);
+    for (i = 0; i < (tsk_size_t)TSK_MAX(ret, 0); ++i) {
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            TSK_DEBUG_WARN("Dropping datagram bigger than %u bytes", (unsigned)TNET_TRANSPORT_BATCH_MTU);
+            continue;
+        }
+        if (msgs[i].msg_len > 0) {
+            if (count != i) {
+                memcpy(TNET_TRANSPORT_BATCH_BUFFER(batch, count), TNET_TRANSPORT_BATCH_BUFFER(batch, i), msgs[i].msg_len);
+                batch->addrs[count] = batch->addrs[i];
+            }
+            batch->sizes[count++] = msgs[i].msg_len;
+        }
+    }
+#else
+    if (!(batch = _tnet_transport_batch_acquire(transport))) {
+        return 0;
+    }
+    // no recvmmsg(): drain the socket (non-blocking) with recvfrom()
+    for (i = 0, full = tsk_true; i < batch->capacity; ++i) {
+        pending = 0;
+        if ((tnet_ioctlt(fd, FIONREAD, &pending) != 0 || !pending) && i > 0) {
+            full = tsk_false;
+            break;
+        }
+        if (pending > TNET_TRANSPORT_BATCH_MTU) { // could be the total size of the pending datagrams: read them one by one
+            if (count) {
+                break; // next time
+            }
+            _tnet_transport_batch_release(transport, &batch);
+            return _tnet_transport_recv_one(transport, fd, pending);
+        }
+        if ((ret = tnet_sockfd_recvfrom(fd, TNET_TRANSPORT_BATCH_BUFFER(batch, count), TNET_TRANSPORT_BATCH_MTU, 0, (struct sockaddr*)&batch->addrs[count])) < 0) {
+            full = tsk_false;
+            if (i == 0) {
+                err = tnet_geterrno();
+            }
+            break;
+        }
+        if (ret > 0) {
+            batch->sizes[count++] = (tsk_size_t)ret;
+        }
+    }
+#endif
+
+    if (full && transport->recv_batch.capacity < TNET_TRANSPORT_BATCH_MAX_COUNT) {
+        transport->recv_batch.capacity = TSK_MIN((transport->recv_batch.capacity << 1), TNET_TRANSPORT_BATCH_MAX_COUNT);
+    }
+
+    if (!count) {
+        _tnet_transport_batch_release(transport, &batch);
+        if (err) {
+            // do not remove the socket for i/o pending errors
+            if (err == TNET_ERROR_WOULDBLOCK || err == TNET_ERROR_INPROGRESS || err == TNET_ERROR_EAGAIN) {
+                return 0;
+            }
+            TNET_PRINT_LAST_ERROR("recvmmsg/recvfrom have failed");
+            return -1;
+        }
+        return full ? 1 : 0;
+    }
+
+    batch->count = count;
+    for (i = 0; i < count; ++i) {
+        transport->bytes_in += batch->sizes[i];
+    }
+    if (!(e = tnet_transport_event_create(event_data_batch, transport->callback_data, fd))) {
+        _tnet_transport_batch_release(transport, &batch);
+        return 0;
+    }
+    e->data = batch;
+    e->size = count;
+    TSK_RUNNABLE_ENQUEUE_OBJECT_SAFE(TSK_RUNNABLE(transport), e);
+
+    return full ? 1 : 0;
+}
+
+#if TNET_HAVE_UDP_GSO
+// Number of datagrams at the head of "sizes" that can be sent as a single GSO buffer: all with the same size except the last one which could be shorter
+static tsk_size_t _tnet_transport_gso_count(const tsk_size_t* sizes, tsk_size_t count)
+{
+    tsk_size_t i, total = sizes[0];
+    for (i = 1; i < count && i < TNET_UDP_GSO_MAX_SEGMENTS; ++i) {
+        if (sizes[i] > sizes[0] || (total + sizes[i]) > TNET_UDP_GSO_MAX_SIZE) {
+            break;
+        }
+        total += sizes[i];
+        if (sizes[i] < sizes[0]) {
+            return (i + 1);
+        }
+    }
+    return i;
+}
+
+static int _tnet_transport_sendto_gso(tnet_fd_t fd, const struct sockaddr *to, const void* const* bufs, const tsk_size_t* sizes, tsk_size_t count)
+{
+    struct msghdr msg;
+    struct iovec iovecs[TNET_UDP_GSO_MAX_SEGMENTS];
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr* cmsg;
+    tsk_size_t i;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    for (i = 0; i < count; ++i) {
+        iovecs[i].iov_base = (void*)bufs[i];
+        iovecs[i].iov_len = sizes[i];
+    }
+    msg.msg_name = (void*)to;
+    msg.msg_namelen = tnet_get_sockaddr_size(to);
+    msg.msg_iov = iovecs;
+    msg.msg_iovlen = count;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    *((uint16_t*)CMSG_DATA(cmsg)) = (uint16_t)sizes[0];
+
+    return (int)sendmsg(fd, &msg, 0);
+}
+#endif /* TNET_HAVE_UDP_GSO */
+
+/**@ingroup tnet_transport_group
+* Sends several datagrams to the same destination. Same as calling @ref tnet_transport_sendto() for each buffer but using as few system calls as possible:
+* sendmmsg() when available and UDP GSO (UDP_SEGMENT) for runs of same-sized datagrams.
+* @param handle The transport to use to send the data.
+* @param from The local socket from which to send the data.
+* @param to The remote address.
+* @param bufs The datagrams to send.
+* @param sizes The size of each datagram.
+* @param count The number of datagrams.
+* @retval The total number of bytes sent.
+*/
+tsk_size_t tnet_transport_sendto_batch(const tnet_transport_handle_t *handle, tnet_fd_t from, const struct sockaddr *to, const void* const* bufs, const tsk_size_t* sizes, tsk_size_t count)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+    tsk_size_t index = 0, sent = 0;
+    int ret, err;
+#if TNET_HAVE_UDP_GSO
+    tsk_bool_t gso;
+#endif
+#if HAVE_SENDMMSG
+    tsk_size_t i, n;
+    struct mmsghdr msgs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+    struct iovec iovecs[TNET_TRANSPORT_BATCH_MAX_COUNT];
+#endif
+
+    if (!transport || !to || !bufs || !sizes) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return 0;
+    }
+    if (!TNET_SOCKET_TYPE_IS_DGRAM(transport->master->type)) {
+        TSK_DEBUG_ERROR("In order to use sendto() you must use an udp transport.");
+        return 0;
+    }
+
+#if TNET_HAVE_UDP_GSO
+    gso = !transport->send_batch.gso_disabled;
+#endif
+    while (index < count) {
+#if TNET_HAVE_UDP_GSO
+        if (gso && (n = _tnet_transport_gso_count(&sizes[index], (count - index))) > 1) {
+            if ((ret = _tnet_transport_sendto_gso(from, to, &bufs[index], &sizes[index], n)) > 0) {
+                transport->bytes_out += ret;
+                sent += ret, index += n;
+                continue;
+            }
+            err = tnet_geterrno();
+            if (err == TNET_ERROR_WOULDBLOCK || err == TNET_ERROR_EAGAIN) {
+                TSK_DEBUG_WARN("sendmsg returned error code:%d", err);
+                break;
+            }
+            // EIO: no checksum offload, EINVAL/ENOPROTOOPT: kernel without UDP_SEGMENT
+            if (err == EIO || err == EINVAL || err == ENOPROTOOPT) {
+                TSK_DEBUG_INFO("UDP GSO not supported (error code = %d), using sendmmsg()", err);
+                transport->send_batch.gso_disabled = tsk_true;
+            }
+            else {
+                // transient error (e.g. ICMP unreachable): GSO is still tried on the next batches
+                TSK_DEBUG_WARN("UDP GSO sendmsg failed (error code = %d), using sendmmsg() for this batch", err);
+            }
+            gso = tsk_false;
+        }
+#endif /* TNET_HAVE_UDP_GSO */
+
+#if HAVE_SENDMMSG
+        n = TSK_MIN((count - index), TNET_TRANSPORT_BATCH_MAX_COUNT);
+        memset(msgs, 0, (n * sizeof(msgs[0])));
+        for (i = 0; i < n; ++i) {
+            iovecs[i].iov_base = (void*)bufs[index + i];
+            iovecs[i].iov_len = sizes[index + i];
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = (void*)to;
+            msgs[i].msg_hdr.msg_namelen = tnet_get_sockaddr_size(to);
+        }
+        if ((ret = sendmmsg(from, msgs, (unsigned int)n, 0)) > 0) {
+            for (i = 0; i < (tsk_size_t)ret; ++i) {
+                transport->bytes_out += msgs[i].msg_len;
+                sent += msgs[i].msg_len;
+            }
+            index += ret;
+            continue;
+        }
+        err = tnet_geterrno();
+        if (err == TNET_ERROR_WOULDBLOCK || err == TNET_ERROR_EAGAIN) {
+            TSK_DEBUG_WARN("sendmmsg returned error code:%d", err);
+            break;
+        }
+        TNET_PRINT_LAST_ERROR("sendmmsg have failed.");
+        ++index; // skip the datagram in error (e.g. ICMP unreachable)
+#else
+        // "bytes_out" updated by tnet_transport_sendto()
+        if ((ret = (int)tnet_transport_sendto(handle, from, to, bufs[index], sizes[index])) > 0) {
+            sent += ret;
+        }
+        else if ((err = tnet_geterrno()) == TNET_ERROR_WOULDBLOCK || err == TNET_ERROR_EAGAIN) {
+            break;
+        }
+        ++index;
+#endif /* HAVE_SENDMMSG */
+    }
+
+    return sent;
+}
+
 /*
  * Runnable interface implementation.
  */
 static void* TSK_STDCALL run(void* self)
 {
     int ret = 0;
-    tsk_list_item_t *curr;
+    tnet_transport_event_t *e;
     tnet_transport_t *transport = self;
 
     TSK_DEBUG_INFO("Transport::run(%s) - enter", transport->description);
@@ -1047,13 +1470,26 @@ static void* TSK_STDCALL run(void* self)
 
     TSK_RUNNABLE_RUN_BEGIN(transport);
 
-    if ((curr = TSK_RUNNABLE_POP_FIRST_SAFE(TSK_RUNNABLE(transport)))) {
-        const tnet_transport_event_t *e = (const tnet_transport_event_t*)curr->data;
-
-        if (transport->callback) {
+    if ((e = (tnet_transport_event_t*)tsk_runnable_pop(TSK_RUNNABLE(transport)))) {
+        if (e->type == event_data_batch) {
+            // expand the batch: one "event_data" per datagram, buffers are owned by the batch
+            tnet_transport_batch_t* batch = (tnet_transport_batch_t*)e->data;
+            tnet_transport_event_t e_data = *e;
+            tsk_size_t i;
+            e_data.type = event_data;
+            for (i = 0; i < batch->count && transport->callback; ++i) {
+                e_data.data = TNET_TRANSPORT_BATCH_BUFFER(batch, i);
+                e_data.size = batch->sizes[i];
+                e_data.remote_addr = batch->addrs[i];
+                transport->callback(&e_data);
+            }
+            e->data = tsk_null;
+            _tnet_transport_batch_release(transport, &batch);
+        }
+        else if (transport->callback) {
             transport->callback(e);
         }
-        tsk_object_unref(curr);
+        tsk_object_unref(e);
     }
 
     TSK_RUNNABLE_RUN_END(transport);
@@ -1092,6 +1528,9 @@ static tsk_object_t* tnet_transport_dtor(tsk_object_t * self)
         // proxy
         TSK_OBJECT_SAFE_FREE(transport->proxy.info);
 
+        // batched receive
+        TSK_OBJECT_SAFE_FREE(transport->recv_batch.pool);
+
         // (tls and dtls) = ssl
         TSK_FREE(transport->tls.ca);
         TSK_FREE(transport->tls.pbk);
@@ -1133,7 +1572,12 @@ static tsk_object_t* tnet_transport_event_dtor(tsk_object_t * self)
 {
     tnet_transport_event_t *e = self;
     if (e) {
-        TSK_FREE(e->data);
+        if (e->type == event_data_batch) {
+            TSK_OBJECT_SAFE_FREE(e->data);
+        }
+        else {
+            TSK_FREE(e->data);
+        }
     }
 
     return self;
@@ -1147,3 +1591,24 @@ static const tsk_object_def_t tnet_transport_event_def_s = {
 };
 const tsk_object_def_t *tnet_transport_event_def_t = &tnet_transport_event_def_s;
 
+
+
+//=================================================================================================
+//	Transport batch object definition
+//
+static tsk_object_t* tnet_transport_batch_dtor(tsk_object_t * self)
+{
+    tnet_transport_batch_t *batch = self;
+    if (batch) {
+        TSK_FREE(batch->buffers);
+    }
+    return self;
+}
+
+static const tsk_object_def_t tnet_transport_batch_def_s = {
+    sizeof(tnet_transport_batch_t),
+    tsk_null,
+    tnet_transport_batch_dtor,
+    0,
+};
+static const tsk_object_def_t *tnet_transport_batch_def_t = &tnet_transport_batch_def_s;
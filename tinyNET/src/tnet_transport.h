@@ -39,6 +39,20 @@ TNET_BEGIN_DECLS
 #define DGRAM_MAX_SIZE	8192
 #define STREAM_MAX_SIZE	8192
 
+/* Batched datagram receive (see tnet_transport_set_recv_batching()) */
+#if !defined(TNET_TRANSPORT_BATCH_MAX_COUNT)
+#	define TNET_TRANSPORT_BATCH_MAX_COUNT	32 /* Maximum number of datagrams read from a socket in a single call */
+#endif
+#if !defined(TNET_TRANSPORT_BATCH_MTU)
+#	define TNET_TRANSPORT_BATCH_MTU			2048 /* Size of each pooled receive buffer. A bigger datagram (e.g. IP-fragmented DTLS handshake flight) is received on its own when at the head of the socket queue */
+#endif
+#if !defined(TNET_TRANSPORT_BATCH_MIN_COUNT)
+#	define TNET_TRANSPORT_BATCH_MIN_COUNT	4 /* Number of buffers of the first batches, doubled (up to TNET_TRANSPORT_BATCH_MAX_COUNT) each time a read fills them all */
+#endif
+#if !defined(TNET_TRANSPORT_BATCH_POOL_MAX)
+#	define TNET_TRANSPORT_BATCH_POOL_MAX	8 /* Maximum number of free batches kept for reuse by each transport */
+#endif
+
 #define TNET_TRANSPORT_CB_F(callback)							((tnet_transport_cb_f)callback)
 
 typedef enum tnet_transport_event_type_e {
@@ -56,7 +70,9 @@ typedef enum tnet_transport_event_type_e {
     event_dtls_fingerprint_mismatch,
     event_dtls_srtp_data,
     event_dtls_srtp_profile_selected,
-    event_dtls_error
+    event_dtls_error,
+
+    event_data_batch, // internal: datagrams received in batch, forwarded to the callback as "event_data" events
 }
 tnet_transport_event_type_t;
 
@@ -98,9 +114,12 @@ TINYNET_API tnet_fd_t tnet_transport_connectto(const tnet_transport_handle_t *ha
 TINYNET_API tnet_fd_t tnet_transport_connectto_3(const tnet_transport_handle_t *handle, struct tnet_socket_s* socket, const char* host, tnet_port_t port, tnet_socket_type_t type);
 TINYNET_API tsk_size_t tnet_transport_send(const tnet_transport_handle_t *handle, tnet_fd_t from, const void* buf, tsk_size_t size);
 TINYNET_API tsk_size_t tnet_transport_sendto(const tnet_transport_handle_t *handle, tnet_fd_t from, const struct sockaddr *to, const void* buf, tsk_size_t size);
+TINYNET_API tsk_size_t tnet_transport_sendto_batch(const tnet_transport_handle_t *handle, tnet_fd_t from, const struct sockaddr *to, const void* const* bufs, const tsk_size_t* sizes, tsk_size_t count);
 
 TINYNET_API int tnet_transport_set_callback(const tnet_transport_handle_t *handle, tnet_transport_cb_f callback, const void* callback_data);
 
+TINYNET_API int tnet_transport_set_recv_batching(tnet_transport_handle_t *handle, tsk_bool_t enabled);
+
 TINYNET_API int tnet_transport_set_proxy_auto_detect(tnet_transport_handle_t *handle, tsk_bool_t auto_detect);
 TINYNET_API int tnet_transport_set_proxy_info(tnet_transport_handle_t *handle, enum tnet_proxy_type_e type, const char* host, tnet_port_t port, const char* login, const char* password);
 
@@ -172,13 +191,29 @@ typedef struct tnet_transport_s {
         struct tnet_proxyinfo_s* info; // manually set value
     }
     proxy;
+
+    /* Batched datagram receive */
+    struct {
+        tsk_bool_t enabled;
+        tsk_list_t* pool; // free "tnet_transport_batch_t" objects ready for reuse
+        tsk_size_t capacity; // number of buffers of the batches, grows with the bursts
+    }
+    recv_batch;
+
+    /* Batched datagram send */
+    struct {
+        tsk_bool_t gso_disabled; // UDP_SEGMENT rejected by the kernel or the NIC
+    }
+    send_batch;
 }
 tnet_transport_t;
 
 tsk_object_t* tnet_transport_context_create();
 TINYNET_API tnet_transport_t* tnet_transport_create(const char* host, tnet_port_t port, tnet_socket_type_t type, const char* description);
 TINYNET_API tnet_transport_t* tnet_transport_create_2(tnet_socket_t *master, const char* description);
+TINYNET_API tnet_transport_t* tnet_transport_create_3(const char* host, tnet_port_t port, tnet_socket_type_t type, tsk_bool_t reuseport, const char* description);
 tnet_transport_event_t* tnet_transport_event_create(tnet_transport_event_type_t type, const void* callback_data, tnet_fd_t fd);
+int tnet_transport_recv_batch(tnet_transport_t* transport, tnet_fd_t fd);
 
 TINYNET_GEXTERN const tsk_object_def_t *tnet_transport_def_t;
 TINYNET_GEXTERN const tsk_object_def_t *tnet_transport_event_def_t;
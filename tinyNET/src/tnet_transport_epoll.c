@@ -0,0 +1,1112 @@
+/*
+* Copyright (C) 2010-2011 Mamadou Diop
+* Copyright (C) 2012-2013 Doubango Telecom <http://www.doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tnet_transport_epoll.c
+ * @brief Network transport layer using Linux epoll().
+ *
+ * Same behavior as @ref tnet_transport_poll.c but the sockets are registered in the kernel only once (O(1) add/remove)
+ * and the main thread only visits the sockets with pending events. Enabled at build time with "USE_EPOLL".
+ * Set "TNET_EPOLL_EDGE_TRIGGERED" to 1 to use edge-triggered notifications: the sockets are then drained until they would block.
+ */
+#include "tnet_transport.h"
+#include "tnet_proxy_plugin.h"
+#include "tnet_proxydetect.h"
+
+#include "tsk_memory.h"
+#include "tsk_string.h"
+#include "tsk_debug.h"
+#include "tsk_thread.h"
+#include "tsk_time.h"
+#include "tsk_buffer.h"
+#include "tsk_safeobj.h"
+
+#if USE_EPOLL
+
+#include <sys/epoll.h>
+
+#if !defined(TNET_EPOLL_MAX_EVENTS)
+#   define TNET_EPOLL_MAX_EVENTS		256 /* Maximum number of events returned by a single epoll_wait() */
+#endif
+#if !defined(TNET_EPOLL_MIN_SOCKETS)
+#   define TNET_EPOLL_MIN_SOCKETS		64 /* Initial size of the fd-indexed sockets table */
+#endif
+#if !defined(TNET_EPOLL_MIN_HANDSHAKES)
+#   define TNET_EPOLL_MIN_HANDSHAKES	16 /* Initial size of the pending TLS handshakes table */
+#endif
+#if !defined(TNET_EPOLL_MAX_LISTEN)
+#   define TNET_EPOLL_MAX_LISTEN		SOMAXCONN
+#endif
+
+#if TNET_EPOLL_EDGE_TRIGGERED
+#   define TNET_EPOLL_ET				EPOLLET
+#else
+#   define TNET_EPOLL_ET				0
+#endif
+
+/* The epoll user data holds both the fd and the socket generation to ignore events queued for an fd which was closed and reused within the same epoll_wait() batch */
+#define TNET_EPOLL_DATA(fd, generation)		((((uint64_t)(generation)) << 32) | ((uint32_t)(fd)))
+#define TNET_EPOLL_DATA_FD(data)			((tnet_fd_t)((uint32_t)((data) & 0xFFFFFFFF)))
+#define TNET_EPOLL_DATA_GENERATION(data)	((uint32_t)((data) >> 32))
+
+/*== Socket description ==*/
+typedef struct transport_socket_xs {
+    tnet_fd_t fd;
+    tsk_bool_t owner;
+    tsk_bool_t connected;
+    tsk_bool_t paused;
+
+    tnet_socket_type_t type;
+    tnet_tls_socket_handle_t* tlshandle;
+
+    uint32_t events; /* epoll events registered for this socket */
+    uint32_t generation;
+}
+transport_socket_xt;
+
+/*== Transport context structure definition ==*/
+typedef struct transport_context_s {
+    TSK_DECLARE_OBJECT;
+
+    tsk_size_t count;
+    tnet_fd_t pipeW;
+    tnet_fd_t pipeR;
+    int epfd;
+    uint32_t generation;
+    transport_socket_xt** sockets; /* indexed by fd */
+    tsk_size_t sockets_size;
+    transport_socket_xt** handshakes; /* sockets doing the TLS handshake, checked for expiry instead of all the sockets */
+    tsk_size_t handshakes_count;
+    tsk_size_t handshakes_size;
+    struct epoll_event events[TNET_EPOLL_MAX_EVENTS];
+    tsk_bool_t polling; // whether we are epoll_wait()ing
+
+    TSK_DECLARE_SAFEOBJ;
+}
+transport_context_t;
+
+static transport_socket_xt* getSocket(transport_context_t *context, tnet_fd_t fd);
+static int addSocket(tnet_fd_t fd, tnet_socket_type_t type, tnet_transport_t *transport, tsk_bool_t take_ownership, tsk_bool_t is_client, tnet_tls_socket_handle_t* tlsHandle);
+static int removeSocket(tnet_fd_t fd, transport_context_t *context);
+static int modSocket(transport_context_t *context, transport_socket_xt* sock, uint32_t events);
+static int handshakeSocket(transport_context_t *context, transport_socket_xt* sock);
+static int addHandshake(transport_context_t *context, transport_socket_xt* sock);
+static void removeHandshake(transport_context_t *context, const transport_socket_xt* sock);
+static int expireHandshakes(tnet_transport_t *transport, transport_context_t *context);
+
+
+int tnet_transport_add_socket_2(const tnet_transport_handle_t *handle, tnet_fd_t fd, tnet_socket_type_t type, tsk_bool_t take_ownership, tsk_bool_t isClient, tnet_tls_socket_handle_t* tlsHandle, const char* dst_host, tnet_port_t dst_port, struct tnet_proxyinfo_s* proxy_info)
+{
+    // TODO: support for web-proxies not added yet
+    (void)(dst_host);
+    (void)(dst_port);
+    (void)(proxy_info);
+    return tnet_transport_add_socket(handle, fd, type, take_ownership, isClient, tlsHandle);
+}
+
+int tnet_transport_add_socket(const tnet_transport_handle_t *handle, tnet_fd_t fd, tnet_socket_type_t type, tsk_bool_t take_ownership, tsk_bool_t isClient, tnet_tls_socket_handle_t* tlsHandle)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+    transport_context_t* context;
+    int ret = -1;
+
+    if(!transport) {
+        TSK_DEBUG_ERROR("Invalid server handle.");
+        return ret;
+    }
+
+    if(!(context = (transport_context_t*)transport->context)) {
+        TSK_DEBUG_ERROR("Invalid context.");
+        return -2;
+    }
+
+    if(TNET_SOCKET_TYPE_IS_TLS(type) || TNET_SOCKET_TYPE_IS_WSS(type)) {
+        transport->tls.enabled = 1;
+    }
+
+    // no need to signal the main thread: the socket is registered in the kernel and will be reported by the next epoll_wait()
+    if((ret = addSocket(fd, type, transport, take_ownership, isClient, tlsHandle))) {
+        TSK_DEBUG_ERROR("Failed to add new Socket.");
+        return ret;
+    }
+
+    TSK_DEBUG_INFO("Socket added (external call) %d", fd);
+    return 0;
+}
+
+int tnet_transport_pause_socket(const tnet_transport_handle_t *handle, tnet_fd_t fd, tsk_bool_t pause)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+    transport_context_t *context;
+    transport_socket_xt* socket;
+
+    if(!transport || !(context = (transport_context_t*)transport->context)) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_safeobj_lock(context);
+    if((socket = getSocket(context, fd))) {
+        if(socket->paused != pause) {
+            socket->paused = pause;
+            // stop monitoring incoming data while paused (otherwise level-triggered epoll would spin)
+            modSocket(context, socket, pause ? (socket->events & ~EPOLLIN) : (socket->events | EPOLLIN));
+        }
+    }
+    else {
+        TSK_DEBUG_WARN("Socket does not exist in this context");
+    }
+    tsk_safeobj_unlock(context);
+    return 0;
+}
+
+/* Remove socket */
+int tnet_transport_remove_socket(const tnet_transport_handle_t *handle, tnet_fd_t *pfd)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+    transport_context_t *context;
+    transport_socket_xt* socket;
+    tnet_fd_t fd = *pfd;
+    int ret = -1;
+
+    TSK_DEBUG_INFO("Removing socket %d", fd);
+
+    if(!transport) {
+        TSK_DEBUG_ERROR("Invalid server handle.");
+        return ret;
+    }
+
+    if(!(context = (transport_context_t*)transport->context)) {
+        TSK_DEBUG_ERROR("Invalid context.");
+        return -2;
+    }
+
+    tsk_safeobj_lock(context);
+
+    if((socket = getSocket(context, fd))) {
+        tsk_bool_t self_ref = (&socket->fd == pfd);
+        removeSocket(fd, context); // socket will be destroyed
+        TSK_RUNNABLE_ENQUEUE(transport, event_removed, transport->callback_data, fd);
+        if(!self_ref) { // if self_ref then, pfd no longer valid after removeSocket()
+            *pfd = TNET_INVALID_FD;
+        }
+        ret = 0;
+    }
+
+    tsk_safeobj_unlock(context);
+
+    return ret;
+}
+
+
+tsk_size_t tnet_transport_send(const tnet_transport_handle_t *handle, tnet_fd_t from, const void* buf, tsk_size_t size)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+    int numberOfBytesSent = 0;
+
+    if(!transport) {
+        TSK_DEBUG_ERROR("Invalid transport handle.");
+        goto bail;
+    }
+
+    if(transport->tls.enabled) {
+        const transport_socket_xt* socket = getSocket(transport->context, from);
+        if(socket && socket->tlshandle) {
+            if(!tnet_tls_socket_send(socket->tlshandle, buf, size)) {
+                numberOfBytesSent = size;
+            }
+            else {
+                numberOfBytesSent = 0;
+            }
+            goto bail;
+        }
+    }
+    else if((numberOfBytesSent = tnet_sockfd_send(from, buf, size, 0)) <= 0) {
+        TNET_PRINT_LAST_ERROR("send have failed.");
+        goto bail;
+    }
+
+bail:
+    transport->bytes_out += numberOfBytesSent;
+    return numberOfBytesSent;
+}
+
+tsk_size_t tnet_transport_sendto(const tnet_transport_handle_t *handle, tnet_fd_t from, const struct sockaddr *to, const void* buf, tsk_size_t size)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+    int numberOfBytesSent = 0;
+
+    if(!transport) {
+        TSK_DEBUG_ERROR("Invalid server handle.");
+        goto bail;
+    }
+
+    if(!TNET_SOCKET_TYPE_IS_DGRAM(transport->master->type)) {
+        TSK_DEBUG_ERROR("In order to use sendto() you must use an udp transport.");
+        goto bail;
+    }
+
+    if((numberOfBytesSent = tnet_sockfd_sendto(from, to, buf, size)) <= 0) {
+        TNET_PRINT_LAST_ERROR("sendto have failed.");
+        goto bail;
+    }
+
+bail:
+    transport->bytes_out += numberOfBytesSent;
+    return numberOfBytesSent;
+}
+
+int tnet_transport_have_socket(const tnet_transport_handle_t *handle, tnet_fd_t fd)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+
+    if(!transport) {
+        TSK_DEBUG_ERROR("Invalid server handle.");
+        return 0;
+    }
+
+    return (getSocket((transport_context_t*)transport->context, fd) != 0);
+}
+
+const tnet_tls_socket_handle_t* tnet_transport_get_tlshandle(const tnet_transport_handle_t *handle, tnet_fd_t fd)
+{
+    tnet_transport_t *transport = (tnet_transport_t*)handle;
+    const transport_socket_xt *socket;
+
+    if(!transport) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return 0;
+    }
+
+    if((socket = getSocket((transport_context_t*)transport->context, fd))) {
+        return socket->tlshandle;
+    }
+    return 0;
+}
+
+
+/*== Get socket ==*/
+static transport_socket_xt* getSocket(transport_context_t *context, tnet_fd_t fd)
+{
+    transport_socket_xt* ret = 0;
+
+    if(context && fd >= 0) {
+        tsk_safeobj_lock(context);
+        if((tsk_size_t)fd < context->sockets_size) {
+            ret = context->sockets[fd];
+        }
+        tsk_safeobj_unlock(context);
+    }
+
+    return ret;
+}
+
+/*== Add new socket ==*/
+static int addSocket(tnet_fd_t fd, tnet_socket_type_t type, tnet_transport_t *transport, tsk_bool_t take_ownership, tsk_bool_t is_client, tnet_tls_socket_handle_t* tlsHandle)
+{
+    transport_context_t *context = transport?transport->context:0;
+    if(context) {
+        struct epoll_event ev;
+        transport_socket_xt *sock;
+
+        if(fd < 0 || context->epfd < 0) {
+            TSK_DEBUG_ERROR("Invalid fd(%d) or epoll not created yet", fd);
+            return -2;
+        }
+        if(!(sock = tsk_calloc(1, sizeof(transport_socket_xt)))) {
+            TSK_DEBUG_ERROR("Failed to allocate socket");
+            return -3;
+        }
+        sock->fd = fd;
+        sock->type = type;
+        sock->owner = take_ownership;
+
+        if((TNET_SOCKET_TYPE_IS_TLS(sock->type) || TNET_SOCKET_TYPE_IS_WSS(sock->type)) && transport->tls.enabled) {
+            if(tlsHandle) {
+                sock->tlshandle = tsk_object_ref(tlsHandle);
+            }
+            else {
+#if HAVE_OPENSSL
+                sock->tlshandle = tnet_tls_socket_create(sock->fd, is_client ? transport->tls.ctx_client : transport->tls.ctx_server);
+#endif
+            }
+        }
+
+        /* the pipe is never drained by the edge: always level-triggered */
+        sock->events = (fd == context->pipeR) ? EPOLLIN : (EPOLLIN | EPOLLERR | EPOLLHUP | TNET_EPOLL_ET);
+        if(TNET_SOCKET_TYPE_IS_STREAM(sock->type) && fd != context->pipeR) {
+            sock->events |= EPOLLOUT; // emulate WinSock2 FD_CONNECT event
+        }
+
+        tsk_safeobj_lock(context);
+
+        if((tsk_size_t)fd >= context->sockets_size) {
+            tsk_size_t size = TSK_MAX(TNET_EPOLL_MIN_SOCKETS, context->sockets_size);
+            transport_socket_xt** sockets;
+            while(size <= (tsk_size_t)fd) {
+                size <<= 1;
+            }
+            if(!(sockets = tsk_realloc(context->sockets, size * sizeof(transport_socket_xt*)))) {
+                tsk_safeobj_unlock(context);
+                TSK_DEBUG_ERROR("Failed to grow the sockets table to %u entries", (unsigned)size);
+                TSK_OBJECT_SAFE_FREE(sock->tlshandle);
+                TSK_FREE(sock);
+                return -4;
+            }
+            memset(&sockets[context->sockets_size], 0, (size - context->sockets_size) * sizeof(transport_socket_xt*));
+            context->sockets = sockets;
+            context->sockets_size = size;
+        }
+        if(context->sockets[fd]) {
+            tsk_safeobj_unlock(context);
+            TSK_DEBUG_WARN("Socket with fd=%d already added", fd);
+            TSK_OBJECT_SAFE_FREE(sock->tlshandle);
+            TSK_FREE(sock);
+            return 0;
+        }
+
+        sock->generation = ++context->generation;
+        ev.events = sock->events;
+        ev.data.u64 = TNET_EPOLL_DATA(fd, sock->generation);
+        if(epoll_ctl(context->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            tsk_safeobj_unlock(context);
+            TNET_PRINT_LAST_ERROR("epoll_ctl(EPOLL_CTL_ADD, %d) failed", fd);
+            TSK_OBJECT_SAFE_FREE(sock->tlshandle);
+            TSK_FREE(sock);
+            return -5;
+        }
+        context->sockets[fd] = sock;
+        context->count++;
+        if(sock->tlshandle && tnet_tls_socket_is_handshaking(sock->tlshandle)) {
+            addHandshake(context, sock); // connecting
+        }
+
+        tsk_safeobj_unlock(context);
+
+        TSK_DEBUG_INFO("Socket added[%s]: fd=%d, tail.count=%d", transport->description, fd, (int)context->count);
+
+        return 0;
+    }
+    else {
+        TSK_DEBUG_ERROR("Context is Null.");
+        return -1;
+    }
+}
+
+/*== Update the events monitored for a socket ==*/
+static int modSocket(transport_context_t *context, transport_socket_xt* sock, uint32_t events)
+{
+    struct epoll_event ev;
+    if(sock->events == events) {
+        return 0;
+    }
+    ev.events = events;
+    ev.data.u64 = TNET_EPOLL_DATA(sock->fd, sock->generation);
+    if(epoll_ctl(context->epfd, EPOLL_CTL_MOD, sock->fd, &ev) != 0) {
+        TNET_PRINT_LAST_ERROR("epoll_ctl(EPOLL_CTL_MOD, %d) failed", sock->fd);
+        return -1;
+    }
+    sock->events = events;
+    return 0;
+}
+
+/*== Advance the TLS handshake, returns a negative value if it failed and a positive value once done ==*/
+static int handshakeSocket(transport_context_t *context, transport_socket_xt* sock)
+{
+    switch(tnet_tls_socket_do_handshake(sock->tlshandle)) {
+    case tnet_tls_handshake_state_want_write:
+        modSocket(context, sock, (sock->events | EPOLLOUT));
+        return 0;
+    case tnet_tls_handshake_state_want_read:
+        return 0;
+    case tnet_tls_handshake_state_done:
+        if(sock->connected) {
+            modSocket(context, sock, (sock->events & ~EPOLLOUT));
+        }
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+/*== Track a socket doing the TLS handshake until it's done, failed, expired or removed (see expireHandshakes()) ==*/
+static int addHandshake(transport_context_t *context, transport_socket_xt* sock)
+{
+    tsk_safeobj_lock(context);
+    if(context->handshakes_count >= context->handshakes_size) {
+        tsk_size_t size = TSK_MAX(TNET_EPOLL_MIN_HANDSHAKES, (context->handshakes_size << 1));
+        transport_socket_xt** handshakes;
+        if(!(handshakes = tsk_realloc(context->handshakes, size * sizeof(transport_socket_xt*)))) {
+            tsk_safeobj_unlock(context);
+            TSK_DEBUG_ERROR("Failed to grow the handshakes table to %u entries", (unsigned)size);
+            return -1;
+        }
+        context->handshakes = handshakes;
+        context->handshakes_size = size;
+    }
+    context->handshakes[context->handshakes_count++] = sock;
+    tsk_safeobj_unlock(context);
+    return 0;
+}
+
+/*== Stop tracking a socket, must be called with the context locked ==*/
+static void removeHandshake(transport_context_t *context, const transport_socket_xt* sock)
+{
+    tsk_size_t i;
+    for(i = 0; i < context->handshakes_count; ++i) {
+        if(context->handshakes[i] == sock) {
+            context->handshakes[i] = context->handshakes[--context->handshakes_count]; // order doesn't matter
+            return;
+        }
+    }
+}
+
+/*== Close the sockets not done with the TLS handshake in time, returns the epoll_wait() timeout until the next expiry ==*/
+static int expireHandshakes(tnet_transport_t *transport, transport_context_t *context)
+{
+    int timeout = -1;
+    tsk_size_t i;
+    uint64_t now, expiry;
+    tnet_fd_t fd;
+    transport_socket_xt* sock;
+
+    if(!transport->tls.enabled) {
+        return -1;
+    }
+
+    now = tsk_time_now();
+    tsk_safeobj_lock(context);
+    for(i = 0; i < context->handshakes_count;) {
+        sock = context->handshakes[i];
+        if(!(expiry = tnet_tls_socket_get_handshake_expiry(sock->tlshandle))) {
+            context->handshakes[i] = context->handshakes[--context->handshakes_count]; // done or failed
+            continue;
+        }
+        if(expiry <= now) {
+            context->handshakes[i] = context->handshakes[--context->handshakes_count];
+            fd = sock->fd;
+            TSK_DEBUG_INFO("TLS handshake timeout (fd=%d)", fd);
+            tnet_transport_remove_socket(transport, &fd);
+            TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+            continue;
+        }
+        if(timeout < 0 || (expiry - now) < (uint64_t)timeout) {
+            timeout = (int)(expiry - now);
+        }
+        ++i;
+    }
+    tsk_safeobj_unlock(context);
+
+    return timeout;
+}
+
+/*== Remove socket ==*/
+static int removeSocket(tnet_fd_t fd, transport_context_t *context)
+{
+    transport_socket_xt* sock;
+
+    tsk_safeobj_lock(context);
+
+    if(fd >= 0 && (tsk_size_t)fd < context->sockets_size && (sock = context->sockets[fd])) {
+        TSK_DEBUG_INFO("Socket to remove: fd=%d, tail.count=%d", fd, (int)context->count);
+
+        // unlike poll(), it's safe to close a socket while epoll_wait()ing as long as it's unregistered first
+        if(epoll_ctl(context->epfd, EPOLL_CTL_DEL, fd, tsk_null) != 0) {
+            TSK_DEBUG_WARN("epoll_ctl(EPOLL_CTL_DEL, %d) failed", fd);
+        }
+        context->sockets[fd] = tsk_null;
+        context->count--;
+        if(sock->tlshandle) {
+            removeHandshake(context, sock);
+        }
+
+        /* Close the socket if we are the owner. */
+        if(sock->owner) {
+            tnet_sockfd_close(&sock->fd);
+        }
+
+        /* Free tls context */
+        TSK_OBJECT_SAFE_FREE(sock->tlshandle);
+
+        // Free socket
+        TSK_FREE(sock);
+    }
+
+    tsk_safeobj_unlock(context);
+
+    return 0;
+}
+
+/*== Remove all sockets ==*/
+static void removeSockets(transport_context_t *context)
+{
+    tsk_size_t i;
+    tsk_safeobj_lock(context);
+    for(i = 0; i < context->sockets_size && context->count; ++i) {
+        if(context->sockets[i]) {
+            removeSocket((tnet_fd_t)i, context);
+        }
+    }
+    tsk_safeobj_unlock(context);
+}
+
+int tnet_transport_stop(tnet_transport_t *transport)
+{
+    int ret;
+    transport_context_t *context;
+
+    if(!transport) {
+        return -1;
+    }
+
+    context = transport->context;
+
+    if((ret = tsk_runnable_stop(TSK_RUNNABLE(transport)))) {
+        return ret;
+    }
+
+    if(context) {
+        static char c = '\0';
+
+        // signal
+        tsk_safeobj_lock(context); // =>MUST
+        if(tnet_transport_have_socket(transport, context->pipeR)) { // to avoid SIGPIPE=> check that there is at least one reader
+            if(write(context->pipeW, &c, 1) < 0) {
+                TNET_PRINT_LAST_ERROR("Failed to write to the Pipe");
+            }
+        }
+        tsk_safeobj_unlock(context);
+    }
+
+    if(transport->mainThreadId[0]) {
+        return tsk_thread_join(transport->mainThreadId);
+    }
+    else {
+        /* already soppped */
+        return 0;
+    }
+}
+
+int tnet_transport_prepare(tnet_transport_t *transport)
+{
+    int ret = -1;
+    transport_context_t *context;
+    tnet_fd_t pipes[2];
+
+    TSK_DEBUG_INFO("tnet_transport_prepare()");
+
+    if(!transport || !transport->context) {
+        TSK_DEBUG_ERROR("Invalid parameter.");
+        return -1;
+    }
+    else {
+        context = transport->context;
+    }
+
+    if(transport->prepared) {
+        TSK_DEBUG_ERROR("Transport already prepared.");
+        return -2;
+    }
+
+    /* Prepare master */
+    if(!transport->master) {
+        if((transport->master = tnet_socket_create(transport->local_host, transport->req_local_port, transport->type))) {
+            tsk_strupdate(&transport->local_ip, transport->master->ip);
+            transport->bind_local_port = transport->master->port;
+        }
+        else {
+            TSK_DEBUG_ERROR("Failed to create master socket");
+            return -3;
+        }
+    }
+
+    /* Start listening */
+    if(TNET_SOCKET_TYPE_IS_STREAM(transport->master->type)) {
+        if((ret = tnet_sockfd_listen(transport->master->fd, TNET_EPOLL_MAX_LISTEN))) {
+            TNET_PRINT_LAST_ERROR("listen have failed.");
+            goto bail;
+        }
+    }
+
+    /* Create the epoll instance */
+    if(context->epfd < 0 && (context->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        TNET_PRINT_LAST_ERROR("epoll_create1() failed.");
+        ret = -4;
+        goto bail;
+    }
+
+    /* Create and add pipes to the epoll set (used to wake up the main thread on stop) */
+    if((ret = pipe(pipes))) {
+        TNET_PRINT_LAST_ERROR("Failed to create new pipes.");
+        goto bail;
+    }
+
+    /* set both R and W sides */
+    context->pipeR = pipes[0];
+    context->pipeW = pipes[1];
+
+    /* add R side */
+    TSK_DEBUG_INFO("pipeR fd=%d, pipeW=%d", context->pipeR, context->pipeW);
+    if((ret = addSocket(context->pipeR, transport->master->type, transport, tsk_true, tsk_false, tsk_null))) {
+        goto bail;
+    }
+
+    /* Add the master socket to the context. */
+    TSK_DEBUG_INFO("master fd=%d", transport->master->fd);
+    // don't take ownership: will be closed by the dctor() when refCount==0
+    // otherwise will be closed twice: dctor() and removeSocket()
+    if((ret = addSocket(transport->master->fd, transport->master->type, transport, tsk_false, tsk_false, tsk_null))) {
+        TSK_DEBUG_ERROR("Failed to add master socket");
+        goto bail;
+    }
+
+    transport->prepared = tsk_true;
+
+bail:
+    return ret;
+}
+
+int tnet_transport_unprepare(tnet_transport_t *transport)
+{
+    transport_context_t *context;
+
+    if(!transport || !transport->context) {
+        TSK_DEBUG_ERROR("Invalid parameter.");
+        return -1;
+    }
+    else {
+        context = transport->context;
+    }
+
+    if(!transport->prepared) {
+        return 0;
+    }
+
+    transport->prepared = tsk_false;
+
+    removeSockets(context);
+
+    /* reset both R and W sides */
+    if (context->pipeW != -1) {
+        if (close(context->pipeW)) {
+            TSK_DEBUG_ERROR("Failed to close pipeW:%d", context->pipeW);
+        }
+        context->pipeW = -1;
+    }
+    context->pipeR = -1;
+
+    if (context->epfd != -1) {
+        close(context->epfd);
+        context->epfd = -1;
+    }
+
+    // destroy master as it has been closed by removeSocket()
+    TSK_OBJECT_SAFE_FREE(transport->master);
+
+    return 0;
+}
+
+/* Handles EPOLLIN. Returns a negative value if the socket was removed, zero if there is nothing more to read
+* and a positive value if some data was consumed (edge-triggered mode must call it again). */
+static int recvSocket(tnet_transport_t *transport, transport_context_t *context, transport_socket_xt* active_socket, tsk_bool_t is_stream, tsk_bool_t first)
+{
+    int ret, status;
+    tsk_size_t len = 0;
+    void* buffer = tsk_null;
+    tnet_fd_t fd;
+    tnet_transport_event_t* e;
+    struct sockaddr_storage remote_addr = {0};
+
+    // TSK_DEBUG_INFO("NETWORK EVENT FOR SERVER [%s] -- TNET_POLLIN(%d)", transport->description, active_socket->fd);
+
+    /* check whether the socket is paused or not */
+    if(active_socket->paused) {
+        TSK_DEBUG_INFO("Socket is paused");
+        return 0;
+    }
+
+    /* TLS handshake in progress: no application data yet */
+    if(active_socket->tlshandle && tnet_tls_socket_is_handshaking(active_socket->tlshandle)) {
+        if((ret = handshakeSocket(context, active_socket)) < 0) {
+            fd = active_socket->fd;
+            tnet_transport_remove_socket(transport, &active_socket->fd);
+            TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+            return -1;
+        }
+        return ret; // once done, application data could already be pending
+    }
+
+    /* batched datagram receive: no FIONREAD, no per-packet allocation */
+    if(!is_stream && !active_socket->tlshandle && transport->recv_batch.enabled) {
+        if((ret = tnet_transport_recv_batch(transport, active_socket->fd)) < 0) {
+            removeSocket(active_socket->fd, context);
+            return -1;
+        }
+        return ret; // a short batch means the socket is drained
+    }
+
+    /* Retrieve the amount of pending data. */
+    ret = tnet_ioctlt(active_socket->fd, FIONREAD, &len);
+    if((ret < 0 || !len) && is_stream) {
+        /* It's probably an incoming connection --> try to accept() it */
+        int listening = 0, remove_socket = 0;
+        socklen_t socklen = sizeof(listening);
+
+        // getsockopt(SO_ACCEPTCONN) is not needed for the master socket
+        if(active_socket->fd == transport->master->fd) {
+            listening = 1;
+        }
+        else if(getsockopt(active_socket->fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &socklen) != 0) {
+            TNET_PRINT_LAST_ERROR("getsockopt(SO_ACCEPTCONN, %d) failed\n", active_socket->fd);
+            /* not socket accepted -> no socket to remove */
+            return 0;
+        }
+        if (listening) {
+            if((fd = accept(active_socket->fd, tsk_null, tsk_null)) != TNET_INVALID_SOCKET) {
+                TSK_DEBUG_INFO("NETWORK EVENT FOR SERVER [%s] -- FD_ACCEPT(fd=%d)", transport->description, fd);
+#if TNET_EPOLL_EDGE_TRIGGERED
+                tnet_sockfd_set_nonblocking(fd);
+#else
+                if(active_socket->tlshandle) {
+                    tnet_sockfd_set_nonblocking(fd); // the handshake must never block the loop
+                }
+#endif
+                if(addSocket(fd, transport->master->type, transport, tsk_true, tsk_false, tsk_null) != 0) {
+                    tnet_sockfd_close(&fd);
+                    return 1;
+                }
+                TSK_RUNNABLE_ENQUEUE(transport, event_accepted, transport->callback_data, fd);
+                if(active_socket->tlshandle) {
+                    transport_socket_xt* tls_socket;
+                    if((tls_socket = getSocket(context, fd))) {
+                        if(tnet_tls_socket_accept(tls_socket->tlshandle) != 0) {
+                            TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+                            tnet_transport_remove_socket(transport, &fd);
+                            TNET_PRINT_LAST_ERROR("SSL_accept() failed");
+                        }
+                        else if(tnet_tls_socket_is_handshaking(tls_socket->tlshandle)) {
+                            addHandshake(context, tls_socket);
+                        }
+                    }
+                }
+                return 1; // more connections could be pending
+            }
+            status = tnet_geterrno();
+            if (!first && (status == TNET_ERROR_WOULDBLOCK || status == TNET_ERROR_EAGAIN)) {
+                return 0; // backlog drained
+            }
+            TNET_PRINT_LAST_ERROR("accept(%d) failed", active_socket->fd);
+            remove_socket = 1;
+        }
+        else if (!first) {
+            // everything already read or the end of stream was received with the data (no other edge will report it)
+            char c;
+            if((ret = (int)recv(active_socket->fd, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT)) > 0) {
+                return 1; // received in the meantime
+            }
+            if(ret < 0 && ((status = tnet_geterrno()) == TNET_ERROR_WOULDBLOCK || status == TNET_ERROR_EAGAIN)) {
+                return 0;
+            }
+            TSK_DEBUG_INFO("Closing socket with fd = %d because the peer closed the connection", active_socket->fd);
+            remove_socket = 1;
+        }
+        else {
+            TSK_DEBUG_INFO("Closing socket with fd = %d because ioctlt() returned zero or failed", active_socket->fd);
+            remove_socket = 1;
+        }
+
+        if(remove_socket) {
+            fd = active_socket->fd;
+            tnet_transport_remove_socket(transport, &active_socket->fd);
+            TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+            return -1;
+        }
+        return 0;
+    }
+
+    if(len <= 0) {
+        return 0;
+    }
+
+    if (!(buffer = tsk_calloc(len, sizeof(uint8_t)))) {
+        TSK_DEBUG_ERROR("TSK_CALLOC FAILED");
+        return 0;
+    }
+
+    // Retrieve the remote address
+    if (is_stream) {
+        ret = tnet_getpeername(active_socket->fd, &remote_addr);
+    }
+
+    // Receive the waiting data
+    if (active_socket->tlshandle) {
+        int isEncrypted;
+        tsk_size_t tlslen = len;
+        if ((ret = tnet_tls_socket_recv(active_socket->tlshandle, &buffer, &tlslen, &isEncrypted)) == 0) {
+            if (isEncrypted) {
+                TSK_FREE(buffer);
+                return 0;
+            }
+            len = ret = tlslen;
+        }
+    }
+    else {
+        if (is_stream) {
+            ret = tnet_sockfd_recv(active_socket->fd, buffer, len, 0);
+        }
+        else {
+            ret = tnet_sockfd_recvfrom(active_socket->fd, buffer, len, 0, (struct sockaddr*)&remote_addr);
+        }
+    }
+
+    if(ret < 0) {
+        TSK_FREE(buffer);
+        status = tnet_geterrno();
+        // do not remove the socket for i/o pending errors
+        if (status == TNET_ERROR_WOULDBLOCK || status == TNET_ERROR_INPROGRESS || status == TNET_ERROR_EAGAIN) {
+            TSK_DEBUG_WARN("recv returned error code:%d", status);
+            return 0;
+        }
+        TNET_PRINT_LAST_ERROR("recv/recvfrom have failed");
+        removeSocket(active_socket->fd, context);
+        return -1;
+    }
+
+    len = (tsk_size_t)ret;
+    if(len > 0) {
+        transport->bytes_in += len;
+        e = tnet_transport_event_create(event_data, transport->callback_data, active_socket->fd);
+        e->data = buffer, buffer = tsk_null;
+        e->size = len;
+        e->remote_addr = remote_addr;
+
+        TSK_RUNNABLE_ENQUEUE_OBJECT_SAFE(TSK_RUNNABLE(transport), e);
+    }
+    TSK_FREE(buffer);
+
+    return (len > 0) ? 1 : 0;
+}
+
+/*=== Main thread */
+void *tnet_transport_mainthread(void *param)
+{
+    tnet_transport_t *transport = param;
+    transport_context_t *context = transport->context;
+    int ret, i, nfds;
+    uint32_t revents;
+    tsk_bool_t is_stream;
+    tnet_fd_t fd;
+    transport_socket_xt* active_socket;
+
+    /* check whether the transport is already prepared */
+    if(!transport->prepared) {
+        TSK_DEBUG_ERROR("Transport must be prepared before strating.");
+        goto bail;
+    }
+
+    is_stream = TNET_SOCKET_TYPE_IS_STREAM(transport->master->type);
+
+    TSK_DEBUG_INFO("Starting [%s] server with IP {%s} on port {%d} using master fd {%d} with type {%d} with epoll fd {%d}...",
+                   transport->description,
+                   transport->master->ip,
+                   transport->master->port,
+                   transport->master->fd,
+                   transport->master->type,
+                   context->epfd);
+
+    while(TSK_RUNNABLE(transport)->running || TSK_RUNNABLE(transport)->started) {
+        /* pending TLS handshakes wake us up when they expire */
+        ret = expireHandshakes(transport, context);
+        context->polling = tsk_true;
+        nfds = epoll_wait(context->epfd, context->events, TNET_EPOLL_MAX_EVENTS, ret);
+        context->polling = tsk_false;
+        if(nfds < 0) {
+            if(tnet_geterrno() == EINTR) {
+                continue;
+            }
+            TNET_PRINT_LAST_ERROR("epoll_wait() have failed.");
+            goto bail;
+        }
+
+        if(!TSK_RUNNABLE(transport)->running && !TSK_RUNNABLE(transport)->started) {
+            TSK_DEBUG_INFO("Stopping [%s] server with IP {%s} on port {%d} with type {%d}...", transport->description, transport->master->ip, transport->master->port, transport->master->type);
+            goto bail;
+        }
+
+        /* lock context */
+        tsk_safeobj_lock(context);
+
+        /* only the ready sockets are visited */
+        for(i = 0; i < nfds; i++) {
+            fd = TNET_EPOLL_DATA_FD(context->events[i].data.u64);
+            revents = context->events[i].events;
+
+            if(fd == context->pipeR) {
+                TSK_DEBUG_INFO("PipeR event = %u", revents);
+                if(revents & EPOLLIN) {
+                    static char __buffer[1024];
+                    if(read(context->pipeR, __buffer, sizeof(__buffer)) < 0) {
+                        TNET_PRINT_LAST_ERROR("Failed to read from the Pipe");
+                    }
+                }
+                else if(revents & EPOLLHUP) {
+                    TNET_PRINT_LAST_ERROR("Pipe Error");
+                    tsk_safeobj_unlock(context);
+                    goto bail;
+                }
+                continue;
+            }
+
+            /* Get active socket (could have been removed or reused while processing this batch) */
+            if(!(active_socket = getSocket(context, fd)) || active_socket->generation != TNET_EPOLL_DATA_GENERATION(context->events[i].data.u64)) {
+                continue;
+            }
+
+            /*================== EPOLLHUP ==================*/
+            if(revents & (EPOLLHUP)) {
+                if(revents & EPOLLOUT) {
+                    TSK_DEBUG_INFO("POLLOUT and POLLHUP are exclusive");
+                }
+                else {
+                    TSK_DEBUG_INFO("NETWORK EVENT FOR SERVER [%s] -- TNET_POLLHUP(%d)", transport->description, fd);
+
+                    tnet_transport_remove_socket(transport, &active_socket->fd);
+                    TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+                    continue;
+                }
+            }
+
+            /*================== EPOLLERR ==================*/
+            if(revents & (EPOLLERR)) {
+                TSK_DEBUG_INFO("NETWORK EVENT FOR SERVER [%s] -- TNET_POLLERR(%d)", transport->description, fd);
+
+                tnet_transport_remove_socket(transport, &active_socket->fd);
+                TSK_RUNNABLE_ENQUEUE(transport, event_error, transport->callback_data, fd);
+                continue;
+            }
+
+            /*================== EPOLLIN ==================*/
+            if(revents & EPOLLIN) {
+                if((ret = recvSocket(transport, context, active_socket, is_stream, tsk_true)) < 0) {
+                    continue; // removed
+                }
+#if TNET_EPOLL_EDGE_TRIGGERED
+                // no more notification until the socket is drained
+                while(ret > 0 && (active_socket = getSocket(context, fd))) {
+                    ret = recvSocket(transport, context, active_socket, is_stream, tsk_false);
+                }
+                if(ret < 0 || !(active_socket = getSocket(context, fd))) {
+                    continue; // removed
+                }
+#endif
+            }
+
+            /*================== EPOLLOUT ==================*/
+            if(revents & EPOLLOUT) {
+                TSK_DEBUG_INFO("NETWORK EVENT FOR SERVER [%s] -- TNET_POLLOUT", transport->description);
+                if(!active_socket->connected) {
+                    active_socket->connected = tsk_true;
+                    TSK_RUNNABLE_ENQUEUE(transport, event_connected, transport->callback_data, active_socket->fd);
+                }
+                modSocket(context, active_socket, (active_socket->events & ~EPOLLOUT));
+                if(active_socket->tlshandle && tnet_tls_socket_is_handshaking(active_socket->tlshandle)) {
+                    if((ret = handshakeSocket(context, active_socket)) < 0) {
+                        tnet_transport_remove_socket(transport, &active_socket->fd);
+                        TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+                        continue;
+                    }
+#if TNET_EPOLL_EDGE_TRIGGERED
+                    // completed on EPOLLOUT: the edge for the data read while handshaking is gone
+                    while(ret > 0 && (active_socket = getSocket(context, fd))) {
+                        ret = recvSocket(transport, context, active_socket, is_stream, tsk_false);
+                    }
+#endif
+                }
+            }
+
+            /*================== EPOLLPRI ==================*/
+            if(revents & EPOLLPRI) {
+                TSK_DEBUG_INFO("NETWORK EVENT FOR SERVER [%s] -- TNET_POLLPRI", transport->description);
+            }
+        }/* for */
+
+        /* unlock context */
+        tsk_safeobj_unlock(context);
+
+    } /* while */
+
+bail:
+
+    TSK_DEBUG_INFO("Stopped [%s] server with IP {%s} on port {%d}", transport->description, transport->master->ip, transport->master->port);
+    return 0;
+}
+
+
+
+
+
+
+
+
+void* tnet_transport_context_create()
+{
+    return tsk_object_new(tnet_transport_context_def_t);
+}
+
+
+//=================================================================================================
+//	Transport context object definition
+//
+static tsk_object_t* transport_context_ctor(tsk_object_t * self, va_list * app)
+{
+    transport_context_t *context = self;
+    if(context) {
+        context->pipeR = context->pipeW = -1;
+        context->epfd = -1;
+        tsk_safeobj_init(context);
+    }
+    return self;
+}
+
+static tsk_object_t* transport_context_dtor(tsk_object_t * self)
+{
+    transport_context_t *context = self;
+    if(context) {
+        removeSockets(context);
+        TSK_FREE(context->sockets);
+        TSK_FREE(context->handshakes);
+        if(context->epfd != -1) {
+            close(context->epfd);
+        }
+        tsk_safeobj_deinit(context);
+    }
+    return self;
+}
+
+static const tsk_object_def_t tnet_transport_context_def_s = {
+    sizeof(transport_context_t),
+    transport_context_ctor,
+    transport_context_dtor,
+    tsk_null,
+};
+const tsk_object_def_t *tnet_transport_context_def_t = &tnet_transport_context_def_s;
+
+#endif /* USE_EPOLL */
+
@@ -31,10 +31,11 @@
 #include "tsk_string.h"
 #include "tsk_debug.h"
 #include "tsk_thread.h"
+#include "tsk_time.h"
 #include "tsk_buffer.h"
 #include "tsk_safeobj.h"
 
-#if USE_POLL && !(__IPHONE_OS_VERSION_MIN_REQUIRED >= 40000)
+#if USE_POLL && !USE_EPOLL && !(__IPHONE_OS_VERSION_MIN_REQUIRED >= 40000)
 
 #include "tnet_poll.h"
 
@@ -49,6 +50,9 @@
 #       define TNET_MAX_FDS		(0xFFFF - 1)
 #   endif
 #endif
+#if !defined(TNET_POLL_MIN_HANDSHAKES)
+#   define TNET_POLL_MIN_HANDSHAKES	16 /* Initial size of the pending TLS handshakes table */
+#endif
 
 /*== Socket description ==*/
 typedef struct transport_socket_xs {
@@ -71,6 +75,9 @@ typedef struct transport_context_s {
     tnet_fd_t pipeR;
     tnet_pollfd_t ufds[TNET_MAX_FDS];
     transport_socket_xt* sockets[TNET_MAX_FDS];
+    transport_socket_xt** handshakes; /* sockets doing the TLS handshake, checked for expiry instead of all the sockets */
+    tsk_size_t handshakes_count;
+    tsk_size_t handshakes_size;
     tsk_bool_t polling; // whether we are poll()ing
 
     TSK_DECLARE_SAFEOBJ;
@@ -80,6 +87,10 @@ transport_context_t;
 static transport_socket_xt* getSocket(transport_context_t *context, tnet_fd_t fd);
 static int addSocket(tnet_fd_t fd, tnet_socket_type_t type, tnet_transport_t *transport, tsk_bool_t take_ownership, tsk_bool_t is_client, tnet_tls_socket_handle_t* tlsHandle);
 static int removeSocket(int index, transport_context_t *context);
+static int handshakeSocket(int index, transport_context_t *context);
+static int addHandshake(transport_context_t *context, transport_socket_xt* sock);
+static void removeHandshake(transport_context_t *context, const transport_socket_xt* sock);
+static int expireHandshakes(tnet_transport_t *transport, transport_context_t *context);
 
 
 int tnet_transport_add_socket_2(const tnet_transport_handle_t *handle, tnet_fd_t fd, tnet_socket_type_t type, tsk_bool_t take_ownership, tsk_bool_t isClient, tnet_tls_socket_handle_t* tlsHandle, const char* dst_host, tnet_port_t dst_port, struct tnet_proxyinfo_s* proxy_info)
@@ -337,6 +348,14 @@ int addSocket(tnet_fd_t fd, tnet_socket_type_t type, tnet_transport_t *transport
 
         tsk_safeobj_lock(context);
 
+        if(context->count >= TNET_MAX_FDS) {
+            tsk_safeobj_unlock(context);
+            TSK_DEBUG_ERROR("Too many sockets (%d)", (int)context->count);
+            TSK_OBJECT_SAFE_FREE(sock->tlshandle);
+            TSK_FREE(sock);
+            return -2;
+        }
+
         context->ufds[context->count].fd = fd;
         context->ufds[context->count].events = (fd == context->pipeR) ? TNET_POLLIN : (TNET_POLLIN | TNET_POLLNVAL | TNET_POLLERR);
         if(TNET_SOCKET_TYPE_IS_STREAM(sock->type) && fd != context->pipeR) {
@@ -346,6 +365,9 @@ int addSocket(tnet_fd_t fd, tnet_socket_type_t type, tnet_transport_t *transport
         context->sockets[context->count] = sock;
 
         context->count++;
+        if(sock->tlshandle && tnet_tls_socket_is_handshaking(sock->tlshandle)) {
+            addHandshake(context, sock); // connecting
+        }
 
         tsk_safeobj_unlock(context);
 
@@ -397,6 +419,9 @@ int removeSocket(int index, transport_context_t *context)
         }
 
         /* Free tls context */
+        if(context->sockets[index]->tlshandle) {
+            removeHandshake(context, context->sockets[index]);
+        }
         TSK_OBJECT_SAFE_FREE(context->sockets[index]->tlshandle);
 
         // Free socket
@@ -420,6 +445,94 @@ done:
     return 0;
 }
 
+/*== Advance the TLS handshake, returns non-zero if it failed ==*/
+static int handshakeSocket(int index, transport_context_t *context)
+{
+    switch(tnet_tls_socket_do_handshake(context->sockets[index]->tlshandle)) {
+    case tnet_tls_handshake_state_want_write:
+        context->ufds[index].events |= TNET_POLLOUT;
+        return 0;
+    case tnet_tls_handshake_state_failed:
+        return -1;
+    default:
+        if(context->sockets[index]->connected) {
+            context->ufds[index].events &= ~TNET_POLLOUT;
+        }
+        return 0;
+    }
+}
+
+/*== Track a socket doing the TLS handshake until it's done, failed, expired or removed (see expireHandshakes()) ==*/
+static int addHandshake(transport_context_t *context, transport_socket_xt* sock)
+{
+    tsk_safeobj_lock(context);
+    if(context->handshakes_count >= context->handshakes_size) {
+        tsk_size_t size = TSK_MAX(TNET_POLL_MIN_HANDSHAKES, (context->handshakes_size << 1));
+        transport_socket_xt** handshakes;
+        if(!(handshakes = tsk_realloc(context->handshakes, size * sizeof(transport_socket_xt*)))) {
+            tsk_safeobj_unlock(context);
+            TSK_DEBUG_ERROR("Failed to grow the handshakes table to %u entries", (unsigned)size);
+            return -1;
+        }
+        context->handshakes = handshakes;
+        context->handshakes_size = size;
+    }
+    context->handshakes[context->handshakes_count++] = sock;
+    tsk_safeobj_unlock(context);
+    return 0;
+}
+
+/*== Stop tracking a socket, must be called with the context locked ==*/
+static void removeHandshake(transport_context_t *context, const transport_socket_xt* sock)
+{
+    tsk_size_t i;
+    for(i = 0; i < context->handshakes_count; ++i) {
+        if(context->handshakes[i] == sock) {
+            context->handshakes[i] = context->handshakes[--context->handshakes_count]; // order doesn't matter
+            return;
+        }
+    }
+}
+
+/*== Close the sockets not done with the TLS handshake in time, returns the poll() timeout until the next expiry ==*/
+static int expireHandshakes(tnet_transport_t *transport, transport_context_t *context)
+{
+    int timeout = -1;
+    tsk_size_t i;
+    uint64_t now, expiry;
+    tnet_fd_t fd;
+    transport_socket_xt* sock;
+
+    if(!transport->tls.enabled) {
+        return -1;
+    }
+
+    now = tsk_time_now();
+    tsk_safeobj_lock(context);
+    for(i = 0; i < context->handshakes_count;) {
+        sock = context->handshakes[i];
+        if(!(expiry = tnet_tls_socket_get_handshake_expiry(sock->tlshandle))) {
+            context->handshakes[i] = context->handshakes[--context->handshakes_count]; // done or failed
+            continue;
+        }
+        if(expiry <= now) {
+            context->handshakes[i] = context->handshakes[--context->handshakes_count];
+            fd = sock->fd;
+            TSK_DEBUG_INFO("TLS handshake timeout (fd=%d)", fd);
+            tnet_transport_remove_socket(transport, &fd);
+            TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+            continue;
+        }
+        if(timeout < 0 || (expiry - now) < (uint64_t)timeout) {
+            timeout = (int)(expiry - now);
+        }
+        ++i;
+    }
+    tsk_safeobj_unlock(context);
+
+    return timeout;
+}
+
 int tnet_transport_stop(tnet_transport_t *transport)
 {
     int ret;
@@ -595,8 +708,10 @@ void *tnet_transport_mainthread(void *param)
                    sizeof(context->ufds)/sizeof(context->ufds[0]));
 
     while(TSK_RUNNABLE(transport)->running || TSK_RUNNABLE(transport)->started) {
+        /* pending TLS handshakes wake us up when they expire */
+        ret = expireHandshakes(transport, context);
         context->polling = tsk_true;
-        ret = tnet_poll(context->ufds, context->count, -1);
+        ret = tnet_poll(context->ufds, context->count, ret);
         context->polling = tsk_false;
         if(ret < 0) {
             TNET_PRINT_LAST_ERROR("poll() have failed.");
@@ -687,6 +802,25 @@ void *tnet_transport_mainthread(void *param)
                     goto TNET_POLLIN_DONE;
                 }
 
+                /* TLS handshake in progress: no application data yet */
+                if(active_socket->tlshandle && tnet_tls_socket_is_handshaking(active_socket->tlshandle)) {
+                    if(handshakeSocket(i, context) != 0) {
+                        fd = active_socket->fd;
+                        tnet_transport_remove_socket(transport, &active_socket->fd);
+                        TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+                        continue;
+                    }
+                    goto TNET_POLLIN_DONE;
+                }
+
+                /* batched datagram receive: no FIONREAD, no per-packet allocation */
+                if(!is_stream && !active_socket->tlshandle && transport->recv_batch.enabled) {
+                    if(tnet_transport_recv_batch(transport, active_socket->fd) < 0) {
+                        removeSocket(i, context);
+                    }
+                    goto TNET_POLLIN_DONE;
+                }
+
                 /* Retrieve the amount of pending data.
                  * IMPORTANT: If you are using Symbian please update your SDK to the latest build (August 2009) to have 'FIONREAD'.
                  * This apply whatever you are using the 3rd or 5th edition.
@@ -713,7 +847,13 @@ void *tnet_transport_mainthread(void *param)
                     if (listening) {
                         if((fd = accept(active_socket->fd, tsk_null, tsk_null)) != TNET_INVALID_SOCKET) {
                             TSK_DEBUG_INFO("NETWORK EVENT FOR SERVER [%s] -- FD_ACCEPT(fd=%d)", transport->description, fd);
-                            addSocket(fd, transport->master->type, transport, tsk_true, tsk_false, tsk_null);
+                            if(active_socket->tlshandle) {
+                                tnet_sockfd_set_nonblocking(fd); // the handshake must never block the loop
+                            }
+                            if(addSocket(fd, transport->master->type, transport, tsk_true, tsk_false, tsk_null) != 0) {
+                                tnet_sockfd_close(&fd);
+                                goto TNET_POLLIN_DONE;
+                            }
                             TSK_RUNNABLE_ENQUEUE(transport, event_accepted, transport->callback_data, fd);
                             if(active_socket->tlshandle) {
                                 transport_socket_xt* tls_socket;
@@ -724,6 +864,9 @@ void *tnet_transport_mainthread(void *param)
                                         TNET_PRINT_LAST_ERROR("SSL_accept() failed");
                                         continue;
                                     }
+                                    if(tnet_tls_socket_is_handshaking(tls_socket->tlshandle)) {
+                                        addHandshake(context, tls_socket);
+                                    }
                                 }
                             }
                         }
@@ -837,6 +980,12 @@ TNET_POLLIN_DONE:
                 //else{
                 context->ufds[i].events &= ~TNET_POLLOUT;
                 //}
+                if(active_socket->tlshandle && tnet_tls_socket_is_handshaking(active_socket->tlshandle) && handshakeSocket(i, context) != 0) {
+                    fd = active_socket->fd;
+                    tnet_transport_remove_socket(transport, &active_socket->fd);
+                    TSK_RUNNABLE_ENQUEUE(transport, event_closed, transport->callback_data, fd);
+                    continue;
+                }
             }
 
 
@@ -893,6 +1042,7 @@ static tsk_object_t* transport_context_dtor(tsk_object_t * self)
         while(context->count) {
             removeSocket(0, context);
         }
+        TSK_FREE(context->handshakes);
         tsk_safeobj_deinit(context);
     }
     return self;
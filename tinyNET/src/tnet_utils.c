@@ -32,6 +32,7 @@
 
 #include "tnet_socket.h"
 #include "tnet_endianness.h"
+#include "tnet_poll.h"
 #include "dns/tnet_dns_resolvconf.h"
 
 #include <string.h>
@@ -1544,6 +1545,19 @@ const char *tnet_inet_ntop(int af, const void *src, char *dst, int size)
 int tnet_sockfd_waitUntil(tnet_fd_t fd, long timeout, tsk_bool_t writable)
 {
     int ret = -1;
+#if USE_POLL && HAVE_POLL && !TNET_UNDER_WINDOWS /* select() cannot handle fds >= FD_SETSIZE, e.g. on servers with many TLS connections */
+    tnet_pollfd_t pfd;
+
+    if (fd <= 0) {
+        goto bail;
+    }
+
+    pfd.fd = fd;
+    pfd.events = writable ? TNET_POLLOUT : TNET_POLLIN;
+    pfd.revents = 0;
+
+    ret = tnet_poll(&pfd, 1, (int)timeout);
+#else
     fd_set fds;
     struct timeval timetowait;
 
@@ -1560,6 +1574,7 @@ int tnet_sockfd_waitUntil(tnet_fd_t fd, long timeout, tsk_bool_t writable)
     FD_SET(fd, &fds);
 
     ret = select(fd + 1, writable ? 0 : &fds, writable ? &fds : 0, 0, (timeout >= 0) ? &timetowait : 0);
+#endif
 
     if (ret == 0) { /* timedout */
         ret = -2;
@@ -1820,6 +1835,30 @@ int tnet_sockfd_reuseaddr(tnet_fd_t fd, int reuseAddr)
     return -1;
 }
 
+/**@ingroup tnet_utils_group
+* Allows several sockets to bind to the same address and port (SO_REUSEPORT). Incoming datagrams and connections are load balanced across these sockets by the kernel.
+* Must be called before binding the socket.
+* @retval Zero if succeed and non-zero error code otherwise (e.g. SO_REUSEPORT not supported).
+*/
+int tnet_sockfd_reuseport(tnet_fd_t fd, int reusePort)
+{
+    if (fd != TNET_INVALID_FD) {
+#if defined(SO_REUSEPORT)
+        int ret;
+        static const int yes = 1;
+        static const int no = 0;
+        if ((ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (const char*)(reusePort ? &yes : &no), sizeof(int)))) {
+            TNET_PRINT_LAST_ERROR("setsockopt(SO_REUSEPORT, fd=%d) have failed", fd);
+            return ret;
+        }
+        return 0;
+#else
+        TSK_DEBUG_ERROR("SO_REUSEPORT not supported");
+#endif
+    }
+    return -1;
+}
+
 /**@ingroup tnet_utils_group
  * Sends data to a specific destination.
  * @param fd The source socket.
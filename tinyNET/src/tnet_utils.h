@@ -147,6 +147,7 @@ TINYNET_API int tnet_sockfd_init(const char *host, tnet_port_t port, tnet_socket
 
 TINYNET_API int tnet_sockfd_set_mode(tnet_fd_t fd, int nonBlocking);
 TINYNET_API int tnet_sockfd_reuseaddr(tnet_fd_t fd, int reuseAddr);
+TINYNET_API int tnet_sockfd_reuseport(tnet_fd_t fd, int reusePort);
 #define tnet_sockfd_set_nonblocking(fd)	tnet_sockfd_set_mode(fd, 1)
 #define tnet_sockfd_set_blocking(fd)	tnet_sockfd_set_mode(fd, 0)
 
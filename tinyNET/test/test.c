@@ -35,6 +35,7 @@
 #include "test_dhcp.h"
 #include "test_dhcp6.h"
 #include "test_tls.h"
+#include "test_reactor.h"
 
 #define RUN_TEST_LOOP		0
 
@@ -50,6 +51,9 @@
 #define RUN_TEST_DHCP		0
 #define RUN_TEST_DHCP6		0
 #define RUN_TEST_TLS		0
+#define RUN_TEST_TLS_STALLED	0
+#define RUN_TEST_TLS_RESUMPTION	0
+#define RUN_TEST_REACTOR	0
 
 #ifdef _WIN32_WCE
 int _tmain(int argc, _TCHAR* argv[])
@@ -111,6 +115,18 @@ int main()
         test_tls();
 #endif
 
+#if RUN_TEST_ALL || RUN_TEST_TLS_STALLED
+        test_tls_stalled();
+#endif
+
+#if RUN_TEST_ALL || RUN_TEST_TLS_RESUMPTION
+        test_tls_resumption();
+#endif
+
+#if RUN_TEST_ALL || RUN_TEST_REACTOR
+        test_reactor();
+#endif
+
     }
 
     /* Cleanup the network stack */
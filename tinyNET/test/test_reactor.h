@@ -0,0 +1,136 @@
+/* Copyright (C) 2014 Mamadou DIOP.
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef TNET_TEST_REACTOR_H
+#define TNET_TEST_REACTOR_H
+
+#include "tnet_reactor.h"
+
+#define TEST_REACTOR_OWNERS		8 // sessions
+#define TEST_REACTOR_PKTS		50 // per socket
+
+typedef struct test_reactor_owner_s {
+    tnet_socket_t* sockets[2]; // RTP and RTCP
+    tnet_fd_t fds[2];
+    volatile long received;
+    volatile long inside; // callback running
+    tsk_thread_id_t thread_id; // the thread calling the callback
+    tsk_bool_t concurrent;
+}
+test_reactor_owner_t;
+
+static int test_reactor_cb(const void* usrdata, tnet_fd_t local_fd, const void* data, tsk_size_t size, const struct sockaddr_storage* remote_addr)
+{
+    test_reactor_owner_t* owner = (test_reactor_owner_t*)usrdata;
+    tsk_thread_id_t thread_id = tsk_thread_get_id();
+    if (owner->inside) {
+        owner->concurrent = tsk_true;
+    }
+    tsk_atomic_inc(&owner->inside);
+    if (!owner->received) {
+        owner->thread_id = thread_id;
+    }
+    else if (!tsk_thread_id_equals(&owner->thread_id, &thread_id)) {
+        owner->concurrent = tsk_true; // RTP and RTCP must be served by the same thread
+    }
+    if (size != sizeof(tnet_fd_t) || *((const tnet_fd_t*)data) != local_fd) {
+        TSK_DEBUG_ERROR("Invalid datagram received on %d", local_fd);
+    }
+    tsk_thread_sleep(1); // make sure the detach waits for the callback
+    tsk_atomic_inc(&owner->received);
+    tsk_atomic_dec(&owner->inside);
+    return 0;
+}
+
+void test_reactor()
+{
+    static test_reactor_owner_t owners[TEST_REACTOR_OWNERS];
+    struct sockaddr_storage to;
+    int i, j, k;
+    long received;
+    uint64_t timeout;
+
+    memset(owners, 0, sizeof(owners));
+    BAIL_IF_ERR(tnet_reactor_set_threads(2));
+
+    for (i = 0; i < TEST_REACTOR_OWNERS; ++i) {
+        for (j = 0; j < 2; ++j) {
+            if (!(owners[i].sockets[j] = tnet_socket_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_udp_ipv4))) {
+                goto bail;
+            }
+            owners[i].fds[j] = owners[i].sockets[j]->fd;
+        }
+        BAIL_IF_ERR(tnet_reactor_attach(owners[i].fds, 2, test_reactor_cb, &owners[i]));
+    }
+
+    // each datagram contains the fd of the destination socket
+    for (k = 0; k < TEST_REACTOR_PKTS; ++k) {
+        for (i = 0; i < TEST_REACTOR_OWNERS; ++i) {
+            for (j = 0; j < 2; ++j) {
+                BAIL_IF_ERR(tnet_sockaddr_init("127.0.0.1", owners[i].sockets[j]->port, tnet_socket_type_udp_ipv4, &to));
+                tnet_sockfd_sendto(owners[(i + 1) % TEST_REACTOR_OWNERS].fds[0], (const struct sockaddr *)&to, &owners[i].fds[j], sizeof(tnet_fd_t));
+            }
+        }
+    }
+    timeout = tsk_time_now() + 5000;
+    do {
+        for (i = 0, received = 0; i < TEST_REACTOR_OWNERS; ++i) {
+            received += owners[i].received;
+        }
+        tsk_thread_sleep(10);
+    }
+    while (received < (TEST_REACTOR_OWNERS * TEST_REACTOR_PKTS * 2) && tsk_time_now() < timeout);
+    TSK_DEBUG_INFO("Reactor: %ld/%d datagrams received", received, (TEST_REACTOR_OWNERS * TEST_REACTOR_PKTS * 2));
+    if (received != (TEST_REACTOR_OWNERS * TEST_REACTOR_PKTS * 2)) {
+        TSK_DEBUG_ERROR("Datagrams lost");
+    }
+
+    // detach while receiving: the callback must not be running when detach returns and must not be called anymore
+    BAIL_IF_ERR(tnet_sockaddr_init("127.0.0.1", owners[0].sockets[0]->port, tnet_socket_type_udp_ipv4, &to));
+    for (k = 0; k < TEST_REACTOR_PKTS; ++k) {
+        tnet_sockfd_sendto(owners[1].fds[0], (const struct sockaddr *)&to, &owners[0].fds[0], sizeof(tnet_fd_t));
+    }
+    tsk_thread_sleep(5);
+    BAIL_IF_ERR(tnet_reactor_detach(owners[0].fds, 2));
+    received = owners[0].received;
+    if (owners[0].inside) {
+        TSK_DEBUG_ERROR("Callback running after detach");
+    }
+    for (k = 0; k < TEST_REACTOR_PKTS; ++k) {
+        tnet_sockfd_sendto(owners[1].fds[0], (const struct sockaddr *)&to, &owners[0].fds[0], sizeof(tnet_fd_t));
+    }
+    tsk_thread_sleep(100);
+    if (owners[0].received != received) {
+        TSK_DEBUG_ERROR("Callback called after detach");
+    }
+
+    for (i = 0; i < TEST_REACTOR_OWNERS; ++i) {
+        if (owners[i].concurrent) {
+            TSK_DEBUG_ERROR("Callbacks of owner %d called concurrently", i);
+        }
+    }
+
+bail:
+    for (i = 0; i < TEST_REACTOR_OWNERS; ++i) {
+        tnet_reactor_detach(owners[i].fds, 2);
+        TSK_OBJECT_SAFE_FREE(owners[i].sockets[0]);
+        TSK_OBJECT_SAFE_FREE(owners[i].sockets[1]);
+    }
+}
+
+#endif /* TNET_TEST_REACTOR_H */
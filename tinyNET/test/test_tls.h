@@ -22,6 +22,15 @@
 #define TEST_TLS_REMOTE_IP "192.168.16.225"
 #define TEST_TLS_REMOTE_PORT 4061
 
+#define TEST_TLS_STALLED_COUNT		1000 // must be lower than TNET_MAX_FDS when poll() is used
+#define TEST_TLS_STALLED_PVK		"test_tls_stalled.pvk.pem"
+#define TEST_TLS_STALLED_PBK		"test_tls_stalled.pbk.pem"
+
+#if HAVE_OPENSSL
+#	include <openssl/pem.h>
+#	include <openssl/x509.h>
+#endif
+
 #define TLS_TEST_SIP_MESSAGE \
 	"REGISTER sip:micromethod.com SIP/2.0\r\n" \
 	"Via: SIP/2.0/%s %s:%d;rport;branch=z9hG4bK1245420841406%d\r\n" \
@@ -98,5 +107,259 @@ void test_tls()
     TSK_OBJECT_SAFE_FREE(transport);
 }
 
+typedef struct test_tls_stalled_server_s {
+    volatile long accepted;
+    volatile long closed;
+    volatile long received;
+}
+test_tls_stalled_server_t;
+
+static int test_tls_stalled_cb(const tnet_transport_event_t* e)
+{
+    test_tls_stalled_server_t* server = (test_tls_stalled_server_t*)e->callback_data;
+    switch(e->type) {
+    case event_accepted:
+        tsk_atomic_inc(&server->accepted);
+        break;
+    case event_closed:
+        tsk_atomic_inc(&server->closed);
+        break;
+    case event_data:
+        tsk_atomic_add(&server->received, (long)e->size);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+#if HAVE_OPENSSL
+// self-signed certificate for the server
+static int test_tls_stalled_write_certs()
+{
+    EVP_PKEY_CTX* pctx = tsk_null;
+    EVP_PKEY* pkey = tsk_null;
+    X509* x509 = tsk_null;
+    FILE *pvk = tsk_null, *pbk = tsk_null;
+    int ret = -1;
+
+    if (!(pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, tsk_null)) || EVP_PKEY_keygen_init(pctx) <= 0 || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0 || EVP_PKEY_keygen(pctx, &pkey) <= 0) {
+        goto bail;
+    }
+    if (!(x509 = X509_new())) {
+        goto bail;
+    }
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_get_notBefore(x509), 0);
+    X509_gmtime_adj(X509_get_notAfter(x509), 3600);
+    X509_set_pubkey(x509, pkey);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(x509), "CN", MBSTRING_ASC, (const unsigned char*)"doubango", -1, -1, 0);
+    X509_set_issuer_name(x509, X509_get_subject_name(x509));
+    if (!X509_sign(x509, pkey, EVP_sha256())) {
+        goto bail;
+    }
+    if (!(pvk = fopen(TEST_TLS_STALLED_PVK, "w")) || !(pbk = fopen(TEST_TLS_STALLED_PBK, "w"))) {
+        goto bail;
+    }
+    if (PEM_write_PrivateKey(pvk, pkey, tsk_null, tsk_null, 0, tsk_null, tsk_null) != 1 || PEM_write_X509(pbk, x509) != 1) {
+        goto bail;
+    }
+    ret = 0;
+
+bail:
+    if (pvk) {
+        fclose(pvk);
+    }
+    if (pbk) {
+        fclose(pbk);
+    }
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(pctx);
+    return ret;
+}
+#endif
+
+/* Clients never completing the handshake must not prevent the others from being served */
+void test_tls_stalled()
+{
+#if HAVE_OPENSSL
+    static test_tls_stalled_server_t server_data;
+    static tnet_fd_t stalled[TEST_TLS_STALLED_COUNT];
+    static const char __message[] = "OPTIONS sip:doubango.org SIP/2.0\r\n\r\n";
+    tnet_transport_handle_t *server = tsk_null, *client = tsk_null;
+    struct sockaddr_storage to;
+    tnet_fd_t fd;
+    uint64_t start, timeout;
+    int i;
+
+    memset(&server_data, 0, sizeof(server_data));
+    for (i = 0; i < TEST_TLS_STALLED_COUNT; ++i) {
+        stalled[i] = TNET_INVALID_FD;
+    }
+
+    if (test_tls_stalled_write_certs() != 0) {
+        TSK_DEBUG_ERROR("Failed to create the certificates [%s]", ERR_error_string(ERR_get_error(), tsk_null));
+        goto bail;
+    }
+    if (!(server = tnet_transport_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_tls_ipv4, "TLS/IPV4 SERVER"))) {
+        goto bail;
+    }
+    BAIL_IF_ERR(tnet_transport_tls_set_certs(server, tsk_null, TEST_TLS_STALLED_PBK, TEST_TLS_STALLED_PVK, tsk_false));
+    BAIL_IF_ERR(tnet_transport_set_callback(server, test_tls_stalled_cb, &server_data));
+    BAIL_IF_ERR(tnet_transport_start(server));
+    BAIL_IF_ERR(tnet_sockaddr_init("127.0.0.1", ((tnet_transport_t*)server)->master->port, tnet_socket_type_tcp_ipv4, &to));
+
+    // connect and then say nothing (or only a part of a record)
+    for (i = 0; i < TEST_TLS_STALLED_COUNT; ++i) {
+        BAIL_IF_ERR(tnet_sockfd_init("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_tcp_ipv4, &stalled[i]));
+        BAIL_IF_ERR(tnet_sockfd_connectto(stalled[i], &to));
+        BAIL_IF_ERR(tnet_sockfd_waitUntilWritable(stalled[i], TNET_CONNECT_TIMEOUT));
+        if (i & 1) {
+            tnet_sockfd_send(stalled[i], "\x16\x03", 2, 0);
+        }
+    }
+
+    // a well-behaved client
+    if (!(client = tnet_transport_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_tls_ipv4, "TLS/IPV4 CLIENT"))) {
+        goto bail;
+    }
+    BAIL_IF_ERR(tnet_transport_start(client));
+    start = tsk_time_now();
+    if ((fd = tnet_transport_connectto_2(client, "127.0.0.1", ((tnet_transport_t*)server)->master->port)) == TNET_INVALID_FD) {
+        TSK_DEBUG_ERROR("Failed to connect %s.", tnet_transport_get_description(client));
+        goto bail;
+    }
+    BAIL_IF_ERR(tnet_sockfd_waitUntilWritable(fd, TNET_CONNECT_TIMEOUT));
+    if (!tnet_transport_send(client, fd, __message, sizeof(__message) - 1)) {
+        TSK_DEBUG_ERROR("Failed to send data using %s.", tnet_transport_get_description(client));
+    }
+    timeout = start + (TNET_TLS_HANDSHAKE_TIMEOUT >> 1);
+    while (server_data.received < (long)(sizeof(__message) - 1) && tsk_time_now() < timeout) {
+        tsk_thread_sleep(10);
+    }
+    TSK_DEBUG_INFO("TLS: %ld stalled handshakes accepted, client served in %llu ms", server_data.accepted - 1, (tsk_time_now() - start));
+    if (server_data.received != (long)(sizeof(__message) - 1)) {
+        TSK_DEBUG_ERROR("Client not served while %d handshakes were stalled", TEST_TLS_STALLED_COUNT);
+    }
+
+    // the stalled ones are closed by the server
+    timeout = tsk_time_now() + TNET_TLS_HANDSHAKE_TIMEOUT + 2000;
+    while (server_data.closed < TEST_TLS_STALLED_COUNT && tsk_time_now() < timeout) {
+        tsk_thread_sleep(10);
+    }
+    if (server_data.closed != TEST_TLS_STALLED_COUNT) {
+        TSK_DEBUG_ERROR("%ld/%d stalled handshakes closed", server_data.closed, TEST_TLS_STALLED_COUNT);
+    }
+
+bail:
+    for (i = 0; i < TEST_TLS_STALLED_COUNT; ++i) {
+        tnet_sockfd_close(&stalled[i]);
+    }
+    TSK_OBJECT_SAFE_FREE(client);
+    TSK_OBJECT_SAFE_FREE(server);
+    remove(TEST_TLS_STALLED_PVK);
+    remove(TEST_TLS_STALLED_PBK);
+#else
+    TSK_DEBUG_INFO("OpenSSL not enabled");
+#endif
+}
+
+#if HAVE_OPENSSL
+// connects, sends a message and disconnects once the server received it
+static int test_tls_resumption_connect(tnet_transport_handle_t *client, tnet_port_t port, test_tls_stalled_server_t* server_data)
+{
+    static const char __message[] = "OPTIONS sip:doubango.org SIP/2.0\r\n\r\n";
+    long received = server_data->received;
+    uint64_t timeout;
+    tnet_fd_t fd;
+    int ret = -1;
+
+    if ((fd = tnet_transport_connectto_2(client, "127.0.0.1", port)) == TNET_INVALID_FD) {
+        return -1;
+    }
+    if (tnet_sockfd_waitUntilWritable(fd, TNET_CONNECT_TIMEOUT) == 0 && tnet_transport_send(client, fd, __message, sizeof(__message) - 1)) {
+        timeout = tsk_time_now() + 2000;
+        while (server_data->received < (received + (long)(sizeof(__message) - 1)) && tsk_time_now() < timeout) {
+            tsk_thread_sleep(10);
+        }
+        ret = (server_data->received == (received + (long)(sizeof(__message) - 1))) ? 0 : -2;
+    }
+    tsk_thread_sleep(100); // TLS 1.3: the tickets are received after the handshake
+    tnet_transport_remove_socket(client, &fd);
+    return ret;
+}
+#endif
+
+/* Reconnections use the cached session, tickets encrypted with a previous key are accepted but not older ones */
+void test_tls_resumption()
+{
+#if HAVE_OPENSSL
+    static test_tls_stalled_server_t server_data;
+    tnet_transport_handle_t *server = tsk_null, *client = tsk_null;
+    tnet_tls_stats_t before, after;
+    tnet_port_t port;
+    int i;
+
+    memset(&server_data, 0, sizeof(server_data));
+
+    if (test_tls_stalled_write_certs() != 0) {
+        TSK_DEBUG_ERROR("Failed to create the certificates [%s]", ERR_error_string(ERR_get_error(), tsk_null));
+        goto bail;
+    }
+    if (!(server = tnet_transport_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_tls_ipv4, "TLS/IPV4 SERVER"))) {
+        goto bail;
+    }
+    BAIL_IF_ERR(tnet_transport_tls_set_certs(server, tsk_null, TEST_TLS_STALLED_PBK, TEST_TLS_STALLED_PVK, tsk_false));
+    BAIL_IF_ERR(tnet_transport_set_callback(server, test_tls_stalled_cb, &server_data));
+    BAIL_IF_ERR(tnet_transport_start(server));
+    port = ((tnet_transport_t*)server)->master->port;
+    if (!(client = tnet_transport_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_tls_ipv4, "TLS/IPV4 CLIENT"))) {
+        goto bail;
+    }
+    BAIL_IF_ERR(tnet_transport_start(client));
+
+    // full, then resumed
+    BAIL_IF_ERR(tnet_tls_get_stats(&before));
+    BAIL_IF_ERR(test_tls_resumption_connect(client, port, &server_data));
+    BAIL_IF_ERR(test_tls_resumption_connect(client, port, &server_data));
+    BAIL_IF_ERR(tnet_tls_get_stats(&after));
+    if ((after.server_full - before.server_full) != 1 || (after.server_resumed - before.server_resumed) != 1 || (after.client_full - before.client_full) != 1 || (after.client_resumed - before.client_resumed) != 1) {
+        TSK_DEBUG_ERROR("Session not resumed");
+    }
+
+    // ticket from the previous key: still resumed
+    BAIL_IF_ERR(tnet_tls_rotate_ticket_keys());
+    before = after;
+    BAIL_IF_ERR(test_tls_resumption_connect(client, port, &server_data));
+    BAIL_IF_ERR(tnet_tls_get_stats(&after));
+    if ((after.server_resumed - before.server_resumed) != 1) {
+        TSK_DEBUG_ERROR("Ticket from the previous key not accepted");
+    }
+
+    // key no longer known: full handshake
+    for (i = 0; i < TNET_TLS_TICKET_KEY_COUNT; ++i) {
+        BAIL_IF_ERR(tnet_tls_rotate_ticket_keys());
+    }
+    before = after;
+    BAIL_IF_ERR(test_tls_resumption_connect(client, port, &server_data));
+    BAIL_IF_ERR(tnet_tls_get_stats(&after));
+    TSK_DEBUG_INFO("TLS: server full=%llu resumed=%llu, client full=%llu resumed=%llu, sessions=%u, rotations=%llu",
+                   after.server_full, after.server_resumed, after.client_full, after.client_resumed, after.client_sessions, after.ticket_key_rotations);
+    if ((after.server_full - before.server_full) != 1 || (after.server_resumed - before.server_resumed) != 0) {
+        TSK_DEBUG_ERROR("Ticket from an expired key accepted");
+    }
+
+bail:
+    TSK_OBJECT_SAFE_FREE(client);
+    TSK_OBJECT_SAFE_FREE(server);
+    remove(TEST_TLS_STALLED_PVK);
+    remove(TEST_TLS_STALLED_PBK);
+#else
+    TSK_DEBUG_INFO("OpenSSL not enabled");
+#endif
+}
+
 #endif /* TNET_TEST_TLS_H */
 
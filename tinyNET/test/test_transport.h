@@ -178,10 +178,252 @@ int test_transport_udp_ipv4(tnet_transport_handle_t *transport)
     return 0;
 }
 
+#if !TNET_UNDER_WINDOWS
+#	include <sys/resource.h>
+#endif
+
+#define TEST_SCALING_IDLE_COUNT		10000
+#define TEST_SCALING_ACTIVE_COUNT	100
+#define TEST_SCALING_MSG_COUNT		100 /* per active client */
+#define TEST_SCALING_MSG			"OPTIONS sip:bench@127.0.0.1 SIP/2.0\r\nContent-Length: 0\r\n\r\n"
+
+static volatile long test_scaling_bytes = 0;
+
+static int tnet_scaling_cb(const tnet_transport_event_t* e)
+{
+    if(e->type == event_data) {
+        test_scaling_bytes += (long)e->size; // always called from the same thread
+    }
+    return 0;
+}
+
+/* Connection-scaling benchmark: 10k idle TCP clients + 100 active ones sending messages to the same server transport.
+* With poll() every wakeup visits all the sockets while epoll() only reports the active ones. */
+void test_transport_scaling()
+{
+    int i, j, ready = 0, total = TEST_SCALING_IDLE_COUNT + TEST_SCALING_ACTIVE_COUNT;
+    tnet_ip_t ip;
+    tnet_port_t port;
+    uint64_t start, expected;
+    tnet_fd_t *fds = tsk_calloc(TEST_SCALING_IDLE_COUNT + TEST_SCALING_ACTIVE_COUNT, sizeof(tnet_fd_t));
+    tnet_transport_handle_t *server = tnet_transport_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_tcp_ipv4, "TCP/IPV4 SCALING");
+#if !TNET_UNDER_WINDOWS
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (2 * (TEST_SCALING_IDLE_COUNT + TEST_SCALING_ACTIVE_COUNT)) + 64) {
+        rl.rlim_cur = TSK_MIN(rl.rlim_max, (2 * (TEST_SCALING_IDLE_COUNT + TEST_SCALING_ACTIVE_COUNT)) + 64);
+        setrlimit(RLIMIT_NOFILE, &rl);
+        getrlimit(RLIMIT_NOFILE, &rl);
+    }
+    // each connection uses two fds (client and server sides)
+    total = TSK_MIN(total, (int)((rl.rlim_cur - 64) / 2));
+#endif
+
+    tnet_transport_set_callback(server, tnet_scaling_cb, tsk_null);
+    BAIL_IF_ERR(tnet_transport_start(server));
+    BAIL_IF_ERR(tnet_transport_get_ip_n_port_2(server, &ip, &port));
+
+    start = tsk_time_now();
+    for(i = 0; i < total; ++i) {
+        struct sockaddr_storage to;
+        fds[i] = TNET_INVALID_FD;
+        if(tnet_sockaddr_init("127.0.0.1", port, tnet_socket_type_tcp_ipv4, &to)) {
+            break;
+        }
+        if((fds[i] = (tnet_fd_t)socket(AF_INET, SOCK_STREAM, 0)) == TNET_INVALID_FD || connect(fds[i], (const struct sockaddr*)&to, tnet_get_sockaddr_size((const struct sockaddr*)&to))) {
+            TNET_PRINT_LAST_ERROR("Failed to connect client #%d", i);
+            break;
+        }
+        ++ready;
+    }
+    printf("test_transport_scaling - %d clients connected in %llu ms\n", ready, (unsigned long long)(tsk_time_now() - start));
+    if(ready < TEST_SCALING_ACTIVE_COUNT) {
+        goto bail;
+    }
+
+    /* the last clients are the active ones */
+    test_scaling_bytes = 0;
+    expected = (uint64_t)TEST_SCALING_ACTIVE_COUNT * TEST_SCALING_MSG_COUNT * (sizeof(TEST_SCALING_MSG) - 1);
+    start = tsk_time_now();
+    for(j = 0; j < TEST_SCALING_MSG_COUNT; ++j) {
+        for(i = ready - TEST_SCALING_ACTIVE_COUNT; i < ready; ++i) {
+            if(tnet_sockfd_send(fds[i], TEST_SCALING_MSG, (sizeof(TEST_SCALING_MSG) - 1), 0) <= 0) {
+                TNET_PRINT_LAST_ERROR("send() failed");
+            }
+        }
+    }
+    while((uint64_t)test_scaling_bytes < expected && (tsk_time_now() - start) < 30000) {
+        tsk_thread_sleep(1);
+    }
+    printf("test_transport_scaling - received %ld/%llu bytes from %d active clients (%d idle) in %llu ms\n",
+           test_scaling_bytes, (unsigned long long)expected, TEST_SCALING_ACTIVE_COUNT, (ready - TEST_SCALING_ACTIVE_COUNT), (unsigned long long)(tsk_time_now() - start));
+
+bail:
+    for(i = 0; i < ready; ++i) {
+        tnet_sockfd_close(&fds[i]);
+    }
+    TSK_FREE(fds);
+    TSK_OBJECT_SAFE_FREE(server);
+}
+
+#define TEST_RECV_BATCH_COUNT		100000
+#define TEST_RECV_BATCH_SIZE		172 /* RTP header + 20ms G.711 */
+#define TEST_RECV_BATCH_SIZE_LARGE	4000 /* bigger than the Ethernet MTU (IP-fragmented), e.g. DTLS handshake flight */
+
+static volatile long test_recv_batch_packets = 0;
+static volatile long test_recv_batch_packets_large = 0;
+
+static int tnet_recv_batch_cb(const tnet_transport_event_t* e)
+{
+    if(e->type == event_data && e->size == TEST_RECV_BATCH_SIZE) {
+        ++test_recv_batch_packets; // always called from the same thread
+    }
+    else if(e->type == event_data && e->size == TEST_RECV_BATCH_SIZE_LARGE) {
+        ++test_recv_batch_packets_large;
+    }
+    return 0;
+}
+
+/* Datagram receive benchmark: one client floods a UDP transport with RTP-sized packets, with and without batched receive */
+void test_transport_recv_batch(tsk_bool_t batching)
+{
+    int i;
+    tnet_ip_t ip;
+    tnet_port_t port;
+    uint64_t start;
+    uint8_t packet[TEST_RECV_BATCH_SIZE] = { 0x80 };
+    uint8_t packet_large[TEST_RECV_BATCH_SIZE_LARGE] = { 0x16 };
+    uint64_t bytes_in = 0, bytes_out = 0;
+    struct sockaddr_storage to;
+    tnet_socket_t* client = tnet_socket_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_udp_ipv4);
+    tnet_transport_handle_t *server = tnet_transport_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_udp_ipv4, "UDP/IPV4 RECV BATCH");
+    int rcvbuf = 4 * 1024 * 1024;
+
+    BAIL_IF_ERR(!client || !server);
+    tnet_transport_set_callback(server, tnet_recv_batch_cb, tsk_null);
+    BAIL_IF_ERR(tnet_transport_set_recv_batching(server, batching));
+    BAIL_IF_ERR(tnet_transport_start(server));
+    BAIL_IF_ERR(tnet_transport_get_ip_n_port_2(server, &ip, &port));
+    BAIL_IF_ERR(tnet_sockaddr_init("127.0.0.1", port, tnet_socket_type_udp_ipv4, &to));
+    setsockopt(((tnet_transport_t*)server)->master->fd, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf));
+
+    test_recv_batch_packets = 0;
+    start = tsk_time_now();
+    for(i = 0; i < TEST_RECV_BATCH_COUNT; ++i) {
+        tnet_sockfd_sendto(client->fd, (const struct sockaddr*)&to, packet, sizeof(packet));
+        if(!(i & 0xFF)) {
+            tsk_thread_sleep(0); // give the receiver a chance to keep up (loopback drops when the socket buffer is full)
+        }
+    }
+    while(test_recv_batch_packets < TEST_RECV_BATCH_COUNT && (tsk_time_now() - start) < 5000) {
+        tsk_thread_sleep(1);
+    }
+    tnet_transport_get_bytes_count(server, &bytes_in, &bytes_out);
+    printf("test_transport_recv_batch(%s) - received %ld/%d packets (%llu bytes) in %llu ms\n",
+           batching ? "batching" : "no batching", test_recv_batch_packets, TEST_RECV_BATCH_COUNT, (unsigned long long)bytes_in, (unsigned long long)(tsk_time_now() - start));
+
+    // datagrams bigger than the MTU must not be dropped
+    test_recv_batch_packets_large = 0;
+    start = tsk_time_now();
+    tnet_sockfd_sendto(client->fd, (const struct sockaddr*)&to, packet_large, sizeof(packet_large));
+    while(!test_recv_batch_packets_large && (tsk_time_now() - start) < 1000) {
+        tsk_thread_sleep(1);
+    }
+    if(test_recv_batch_packets_large != 1) {
+        TSK_DEBUG_ERROR("test_transport_recv_batch(%s) - datagram with size = %d not received", batching ? "batching" : "no batching", TEST_RECV_BATCH_SIZE_LARGE);
+    }
+
+bail:
+    TSK_OBJECT_SAFE_FREE(server);
+    TSK_OBJECT_SAFE_FREE(client);
+}
+
+#define TEST_PEER_CLOSE_COUNT		20
+
+static volatile long test_peer_close_closed = 0;
+static volatile tnet_fd_t test_peer_close_accepted = TNET_INVALID_FD;
+
+static int tnet_peer_close_cb(const tnet_transport_event_t* e)
+{
+    if(e->type == event_accepted) {
+        test_peer_close_accepted = e->local_fd;
+    }
+    else if(e->type == event_closed) {
+        ++test_peer_close_closed; // always called from the same thread
+    }
+    return 0;
+}
+
+/* The clients send a message and close the connection right away: the end of stream received with the data must be reported.
+* The accepted sockets are paused until both are pending to get a single notification (edge-triggered epoll). */
+void test_transport_peer_close()
+{
+    int i;
+    tnet_ip_t ip;
+    tnet_port_t port;
+    uint64_t start;
+    struct sockaddr_storage to;
+    tnet_fd_t fd = TNET_INVALID_FD;
+    tnet_transport_handle_t *server = tnet_transport_create("127.0.0.1", TNET_SOCKET_PORT_ANY, tnet_socket_type_tcp_ipv4, "TCP/IPV4 PEER CLOSE");
+
+    BAIL_IF_ERR(!server);
+    tnet_transport_set_callback(server, tnet_peer_close_cb, tsk_null);
+    BAIL_IF_ERR(tnet_transport_start(server));
+    BAIL_IF_ERR(tnet_transport_get_ip_n_port_2(server, &ip, &port));
+    BAIL_IF_ERR(tnet_sockaddr_init("127.0.0.1", port, tnet_socket_type_tcp_ipv4, &to));
+
+    test_peer_close_closed = 0;
+    for(i = 0; i < TEST_PEER_CLOSE_COUNT; ++i) {
+        test_peer_close_accepted = TNET_INVALID_FD;
+        if((fd = (tnet_fd_t)socket(AF_INET, SOCK_STREAM, 0)) == TNET_INVALID_FD || connect(fd, (const struct sockaddr*)&to, tnet_get_sockaddr_size((const struct sockaddr*)&to))) {
+            TNET_PRINT_LAST_ERROR("Failed to connect client #%d", i);
+            break;
+        }
+        start = tsk_time_now();
+        while(test_peer_close_accepted == TNET_INVALID_FD && (tsk_time_now() - start) < 1000) {
+            tsk_thread_sleep(1);
+        }
+        tnet_transport_pause_socket(server, test_peer_close_accepted, tsk_true);
+        tnet_sockfd_send(fd, TEST_SCALING_MSG, (sizeof(TEST_SCALING_MSG) - 1), 0);
+        tnet_sockfd_close(&fd);
+        tsk_thread_sleep(10);
+        tnet_transport_pause_socket(server, test_peer_close_accepted, tsk_false);
+    }
+    start = tsk_time_now();
+    while(test_peer_close_closed < i && (tsk_time_now() - start) < 2000) {
+        tsk_thread_sleep(1);
+    }
+    if(test_peer_close_closed != i) {
+        TSK_DEBUG_ERROR("test_transport_peer_close - %ld/%d connections reported as closed", test_peer_close_closed, i);
+    }
+
+bail:
+    tnet_sockfd_close(&fd);
+    TSK_OBJECT_SAFE_FREE(server);
+}
+
 void test_transport()
 {
 #define TEST_TCP 1
 #define TEST_UDP 0
+#define TEST_SCALING 0
+#define TEST_RECV_BATCH 0
+#define TEST_PEER_CLOSE 0
+
+#if TEST_SCALING
+    test_transport_scaling();
+    return;
+#endif
+
+#if TEST_RECV_BATCH
+    test_transport_recv_batch(tsk_false);
+    test_transport_recv_batch(tsk_true);
+    return;
+#endif
+
+#if TEST_PEER_CLOSE
+    test_transport_peer_close();
+    return;
+#endif
 
 
 #if TEST_UDP
@@ -41,9 +41,21 @@ trtp_rtcp_report_fb_t;
 typedef enum trtp_rtcp_rtpfb_fci_type_e {
     trtp_rtcp_rtpfb_fci_type_nack = 1, // RFC 4585
     trtp_rtcp_rtpfb_fci_type_tmmbn = 4, // RFC 5104
+    trtp_rtcp_rtpfb_fci_type_twcc = 15, // draft-holmer-rmcat-transport-wide-cc-extensions-01
 }
 trtp_rtcp_rtpfb_fci_type_t;
 
+// draft-holmer-rmcat-transport-wide-cc-extensions-01: 3.1.1. Packet Status Symbols
+typedef enum trtp_rtcp_rtpfb_twcc_status_e {
+    trtp_rtcp_rtpfb_twcc_status_not_received = 0,
+    trtp_rtcp_rtpfb_twcc_status_small_delta = 1, // receive delta in [0, 63.75]ms (8 bits)
+    trtp_rtcp_rtpfb_twcc_status_large_delta = 2, // negative or large receive delta (16 bits, signed)
+}
+trtp_rtcp_rtpfb_twcc_status_t;
+
+#define TRTP_RTCP_RTPFB_TWCC_DELTA_UNIT_US	250 // receive deltas are multiples of 250us
+#define TRTP_RTCP_RTPFB_TWCC_REF_UNIT_US	64000 // reference time is a multiple of 64ms
+
 // Transport layer FB message
 typedef struct trtp_rtcp_report_rtpfb_s {
     TRTP_DECLARE_RTCP_FB_PACKET;
@@ -62,6 +74,14 @@ typedef struct trtp_rtcp_report_rtpfb_s {
             uint32_t* MxTBR_Mantissa; // 17 bits
             uint16_t* MeasuredOverhead; // 9 bits
         } tmmbn;
+        struct { // draft-holmer-rmcat-transport-wide-cc-extensions-01: 3.1
+            uint16_t base_seq; // transport-wide sequence number of the first packet
+            uint16_t status_count; // number of packets (received or not) starting at "base_seq"
+            int32_t reference_time; // 24 bits (signed), multiples of 64ms
+            uint8_t fb_pkt_count; // 8 bits
+            uint8_t* status; // 'status_count' entries (trtp_rtcp_rtpfb_twcc_status_t): decoded from the packet chunks
+            int16_t* delta; // 'status_count' entries: receive delta in multiples of 250us, zero when not received
+        } twcc;
     };
 }
 trtp_rtcp_report_rtpfb_t;
@@ -70,6 +90,8 @@ trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_create_null();
 trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_create(struct trtp_rtcp_header_s* header);
 trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_create_2(trtp_rtcp_rtpfb_fci_type_t fci_type, uint32_t ssrc_sender, uint32_t ssrc_media_src);
 trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_create_nack(uint32_t ssrc_sender, uint32_t ssrc_media_src, const uint16_t* seq_nums, tsk_size_t count);
+trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_create_twcc(uint32_t ssrc_sender, uint32_t ssrc_media_src, uint16_t base_seq, uint8_t fb_pkt_count, const int64_t* arrival_times_us, tsk_size_t count);
+int trtp_rtcp_report_rtpfb_get_twcc_arrival_times(const trtp_rtcp_report_rtpfb_t* self, int64_t* arrival_times_us, tsk_size_t count);
 trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_deserialize(const void* data, tsk_size_t size);
 int trtp_rtcp_report_rtpfb_serialize_to(const trtp_rtcp_report_rtpfb_t* self, void* data, tsk_size_t size);
 tsk_size_t trtp_rtcp_report_rtpfb_get_size(const trtp_rtcp_report_rtpfb_t* self);
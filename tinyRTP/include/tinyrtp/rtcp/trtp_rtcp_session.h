@@ -58,6 +58,7 @@ int trtp_rtcp_session_process_rtp_out(struct trtp_rtcp_session_s* self, const st
 int trtp_rtcp_session_process_rtp_in(struct trtp_rtcp_session_s* self, const struct trtp_rtp_packet_s* packet_rtp, tsk_size_t size);
 int trtp_rtcp_session_process_rtcp_in(struct trtp_rtcp_session_s* self, const void* buffer, tsk_size_t size);
 int trtp_rtcp_session_signal_pkt_loss(struct trtp_rtcp_session_s* self, uint32_t ssrc_media, const uint16_t* seq_nums, tsk_size_t count);
+int trtp_rtcp_session_signal_twcc(struct trtp_rtcp_session_s* self, uint32_t ssrc_media, uint16_t base_seq, const int64_t* arrival_times_us, tsk_size_t count);
 int trtp_rtcp_session_signal_frame_corrupted(struct trtp_rtcp_session_s* self, uint32_t ssrc_media);
 int trtp_rtcp_session_signal_jb_error(struct trtp_rtcp_session_s* self, uint32_t ssrc_media);
 
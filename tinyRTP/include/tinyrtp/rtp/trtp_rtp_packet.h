@@ -57,6 +57,17 @@ typedef struct trtp_rtp_packet_s {
 trtp_rtp_packet_t;
 typedef tsk_list_t trtp_rtp_packets_L_t;
 
+/* RTP packet parsed in place over a receive buffer (no memory allocation).
+* The view is a stack object (refCount = 0): "payload.data" and "extension.data" point into the
+* buffer and are only valid until the buffer is reused. Use "trtp_rtp_packet_retain()" to keep the packet.
+*/
+typedef struct trtp_rtp_packet_view_s {
+    trtp_rtp_packet_t packet;
+    trtp_rtp_header_t header;
+}
+trtp_rtp_packet_view_t;
+#define TRTP_RTP_PACKET_IS_VIEW(self)	((self) && TSK_OBJECT_HEADER((self))->refCount == 0)
+
 TINYRTP_API trtp_rtp_packet_t* trtp_rtp_packet_create_null();
 TINYRTP_API trtp_rtp_packet_t* trtp_rtp_packet_create(uint32_t ssrc, uint16_t seq_num, uint32_t timestamp, uint8_t payload_type, tsk_bool_t marker);
 TINYRTP_API trtp_rtp_packet_t* trtp_rtp_packet_create_2(const trtp_rtp_header_t* header);
@@ -64,6 +75,8 @@ TINYRTP_API tsk_size_t trtp_rtp_packet_guess_serialbuff_size(const trtp_rtp_pack
 TINYRTP_API tsk_size_t trtp_rtp_packet_serialize_to(const trtp_rtp_packet_t *self, void* buffer, tsk_size_t size);
 TINYRTP_API tsk_buffer_t* trtp_rtp_packet_serialize(const trtp_rtp_packet_t *self, tsk_size_t num_bytes_pad);
 TINYRTP_API trtp_rtp_packet_t* trtp_rtp_packet_deserialize(const void *data, tsk_size_t size);
+TINYRTP_API trtp_rtp_packet_t* trtp_rtp_packet_view_init(trtp_rtp_packet_view_t* view, const void *data, tsk_size_t size);
+TINYRTP_API trtp_rtp_packet_t* trtp_rtp_packet_retain(const trtp_rtp_packet_t* self);
 
 
 TINYRTP_GEXTERN const tsk_object_def_t *trtp_rtp_packet_def_t;
@@ -0,0 +1,71 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_bwe.h
+ * @brief Send-side bandwidth estimation using the transport-wide congestion control feedback (draft-holmer-rmcat-transport-wide-cc-extensions-01).
+ *
+ * The sender remembers when each packet (identified by its transport-wide sequence number) was sent and the receiver reports when it arrived.
+ * The target bitrate is the lowest of a delay-based estimate (trend of the one-way delay variation driving an AIMD controller) and a loss-based estimate.
+ * It's used to set the encoder's bitrate and the pacing rate.
+ */
+#ifndef TINYRTP_BWE_H
+#define TINYRTP_BWE_H
+
+#include "tinyrtp_config.h"
+
+#include "tsk_object.h"
+
+TRTP_BEGIN_DECLS
+
+struct trtp_rtcp_report_rtpfb_s;
+struct trtp_bwe_s;
+
+typedef enum trtp_bwe_usage_e {
+    trtp_bwe_usage_normal,
+    trtp_bwe_usage_underusing, // queues draining: hold the bitrate
+    trtp_bwe_usage_overusing, // queues building up: decrease the bitrate
+}
+trtp_bwe_usage_t;
+
+typedef struct trtp_bwe_stats_s {
+    int32_t target_kbps; // min(delay_based_kbps, loss_based_kbps) clamped to the bounds
+    int32_t delay_based_kbps;
+    int32_t loss_based_kbps;
+    int32_t acked_kbps; // bitrate received by the peer, zero if unknown
+    float loss_fraction; // packets lost in the last feedback, within [0, 1]
+    double trend; // modified delay trend compared against the adaptive threshold
+    double threshold;
+    trtp_bwe_usage_t usage;
+    uint64_t feedbacks; // number of feedback messages processed
+    uint64_t pkts_unknown; // number of reported packets not (or no longer) in the send history
+}
+trtp_bwe_stats_t;
+
+TINYRTP_API struct trtp_bwe_s* trtp_bwe_create(int32_t start_kbps, int32_t min_kbps, int32_t max_kbps);
+TINYRTP_API int trtp_bwe_set_bounds(struct trtp_bwe_s* self, int32_t min_kbps, int32_t max_kbps);
+TINYRTP_API int trtp_bwe_on_packet_sent(struct trtp_bwe_s* self, uint16_t seq_num, tsk_size_t size, int64_t send_time_us);
+TINYRTP_API int trtp_bwe_on_feedback(struct trtp_bwe_s* self, const struct trtp_rtcp_report_rtpfb_s* twcc, int64_t now_us);
+TINYRTP_API int32_t trtp_bwe_get_target_kbps(struct trtp_bwe_s* self);
+TINYRTP_API int trtp_bwe_get_stats(struct trtp_bwe_s* self, trtp_bwe_stats_t* stats);
+
+TRTP_END_DECLS
+
+#endif /* TINYRTP_BWE_H */
@@ -0,0 +1,84 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_forward.h
+ * @brief Selective forwarding: relays the RTP packets received by a manager (the source) to other managers (the outputs) without decoding them.
+ *
+ * The packets are decrypted once by the source. Each output sends its own copy with the SSRC, sequence number, timestamp and payload type rewritten,
+ * encrypted using its own SRTP context. The feedback received by the outputs (RTCP-NACK, RTCP-PLI/FIR and RTCP-REMB) is aggregated and relayed to the source's peer.
+ */
+#ifndef TINYRTP_FORWARD_H
+#define TINYRTP_FORWARD_H
+
+#include "tinyrtp_config.h"
+
+#include "tsk_object.h"
+
+TRTP_BEGIN_DECLS
+
+struct trtp_manager_s;
+struct trtp_rtcp_packet_s;
+
+#define TRTP_FORWARD_PT_DROP 0xFF // payload type mapping used to drop the packets instead of forwarding them
+
+typedef struct trtp_forward_stats_s {
+    uint64_t forwarded; // number of packets sent by the output
+    uint64_t dropped; // number of packets not sent (output not ready, payload type dropped...)
+    uint64_t nack_relayed; // number of sequence numbers requested by the output's peer and relayed to the source
+    uint64_t pli_relayed; // number of RTCP-PLI/FIR requested by the output's peer and relayed to the source
+    int32_t remb_kbps; // last bandwidth reported by the output's peer (RTCP-REMB), zero if none
+}
+trtp_forward_stats_t;
+
+typedef struct trtp_forward_link_s {
+    TSK_DECLARE_OBJECT;
+
+    struct trtp_manager_s* source; // weak: the source owns the link
+    struct trtp_manager_s* output;
+
+    uint8_t pt_map[128]; // incoming payload type -> outgoing payload type or TRTP_FORWARD_PT_DROP
+
+    tsk_bool_t synced;
+    uint32_t ssrc_in; // SSRC of the stream being forwarded
+    uint16_t seq_num_offset; // seq_num(out) = seq_num(in) + seq_num_offset
+    uint32_t timestamp_offset; // timestamp(out) = timestamp(in) + timestamp_offset
+
+    struct {
+        uint8_t* ptr;
+        tsk_size_t size;
+    } buffer;
+
+    trtp_forward_stats_t stats;
+}
+trtp_forward_link_t;
+
+TINYRTP_API trtp_forward_link_t* trtp_forward_link_create(struct trtp_manager_s* source, struct trtp_manager_s* output);
+TINYRTP_API int trtp_forward_link_set_payload_type(trtp_forward_link_t* self, uint8_t pt_in, uint8_t pt_out);
+TINYRTP_API tsk_size_t trtp_forward_link_rewrite(trtp_forward_link_t* self, const void* data, tsk_size_t size, void* out_ptr, tsk_size_t out_size);
+TINYRTP_API tsk_size_t trtp_forward_link_send(trtp_forward_link_t* self, const void* data, tsk_size_t size);
+TINYRTP_API int trtp_forward_send(struct trtp_manager_s* source, const void* data, tsk_size_t size);
+TINYRTP_API int trtp_forward_handle_rtcp(struct trtp_manager_s* output, const struct trtp_rtcp_packet_s* packet);
+
+TINYRTP_GEXTERN const tsk_object_def_t *trtp_forward_link_def_t;
+
+TRTP_END_DECLS
+
+#endif /* TINYRTP_FORWARD_H */
@@ -29,6 +29,11 @@
 #include "tinyrtp/rtp/trtp_rtp_session.h"
 #include "tinyrtp/rtcp/trtp_rtcp_session.h"
 #include "tinyrtp/trtp_srtp.h"
+#include "tinyrtp/trtp_worker.h"
+#include "tinyrtp/trtp_forward.h"
+#include "tinyrtp/trtp_bwe.h"
+#include "tinyrtp/trtp_pacer.h"
+#include "tinyrtp/trtp_ports.h"
 
 #include "tinymedia/tmedia_defaults.h"
 
@@ -39,6 +44,10 @@ TRTP_BEGIN_DECLS
 struct trtp_rtp_packet_s;
 struct tnet_proxyinfo_s;
 
+#if !defined(TRTP_SEND_BATCH_MAX_COUNT)
+#	define TRTP_SEND_BATCH_MAX_COUNT	64 /* Maximum number of RTP packets queued between trtp_manager_send_batch_begin() and trtp_manager_send_batch_flush() */
+#endif
+
 /** RTP/RTCP manager */
 typedef struct trtp_manager_s {
     TSK_DECLARE_OBJECT;
@@ -78,6 +87,7 @@ typedef struct trtp_manager_s {
     struct {
         uint16_t start;
         uint16_t stop;
+        tnet_port_t acquired; // RTP port of the pair acquired from the allocator (see "trtp_ports.h"), zero if none
     } port_range;
 
     struct {
@@ -106,11 +116,34 @@ typedef struct trtp_manager_s {
             trtp_rtp_cb_f fun;
         } cb;
 
+        // queue to the media worker calling "cb" (null if the callback is called on the network thread)
+        trtp_worker_queue_t* worker_queue;
+
+        // spreads the packets over time at the target bitrate (null when pacing is disabled)
+        struct trtp_pacer_s* pacer;
+
+        // sockets read by the shared media reactor instead of the transport's threads (see "tnet_reactor.h")
+        struct {
+            tnet_fd_t fds[2]; // RTP then RTCP (if not muxed)
+            tsk_size_t count; // zero when not attached
+        } reactor;
+
         struct {
             void* ptr;
             tsk_size_t size;
-            tsk_size_t index;
+            tsk_size_t index; // size of the last packet serialized
+            const void* last; // last packet serialized (and encrypted): "ptr" or, when batching, its slot in "send_batch.ptr". Valid until the next packet is sent.
         } serial_buffer;
+
+        struct {
+            tsk_bool_t started;
+            tsk_thread_id_t thread_id; // thread which began the batch (encoder): packets sent from the other threads are not queued
+            uint8_t* ptr; // queued packets, back to back
+            tsk_size_t size;
+            tsk_size_t index;
+            tsk_size_t sizes[TRTP_SEND_BATCH_MAX_COUNT];
+            tsk_size_t count;
+        } send_batch;
     } rtp;
 
     struct {
@@ -134,13 +167,38 @@ typedef struct trtp_manager_s {
         struct trtp_rtcp_session_s* session;
     } rtcp;
 
+    // selective forwarding (see "trtp_forward.h")
+    struct {
+        tsk_list_t* links; // "trtp_forward_link_t": outputs relaying the RTP packets we receive
+        struct trtp_forward_link_s* link; // weak: set when we are an output relaying the packets received by another manager
+        tsk_bool_t remb_changed; // an output received a new RTCP-REMB
+        int32_t remb_kbps; // bandwidth (lowest RTCP-REMB from the outputs) last reported to our peer
+        uint64_t pli_time; // last time an RTCP-PLI/FIR from the outputs was relayed to our peer
+        uint16_t nack_seq_nums[TRTP_FORWARD_NACK_WINDOW];
+        uint64_t nack_times[TRTP_FORWARD_NACK_WINDOW]; // last time the sequence number was NACKed to our peer
+    } forward;
+
+    // transport-wide congestion control (draft-holmer-rmcat-transport-wide-cc-extensions-01)
+    struct {
+        uint8_t ext_id; // RTP header extension id ("a=extmap"), zero when not negotiated
+        uint16_t seq_num; // transport-wide sequence number of the next packet to send
+        struct trtp_bwe_s* bwe; // send-side estimator fed with the feedback from our peer
+        struct {
+            tsk_bool_t started;
+            uint16_t base_seq; // first sequence number not reported yet
+            tsk_size_t count;
+            int64_t arrival_times_us[TRTP_TWCC_FEEDBACK_MAX_COUNT]; // negative when not received
+            uint64_t fb_time; // last time a feedback was sent
+        } recv;
+    } twcc;
+
     TSK_DECLARE_SAFEOBJ;
 
 #if HAVE_SRTP
     enum tmedia_srtp_type_e srtp_type;
     enum tmedia_srtp_mode_e srtp_mode;
     trtp_srtp_state_t srtp_state;
-    trtp_srtp_ctx_xt srtp_contexts[2/*LINE_IDX*/][2/*CRYPTO_TYPE*/];
+    trtp_srtp_ctx_xt srtp_contexts[2/*LINE_IDX*/][SRTP_CRYPTO_TYPES_MAX/*CRYPTO_TYPE*/];
     const struct trtp_srtp_ctx_xs* srtp_ctx_neg_local;
     const struct trtp_srtp_ctx_xs* srtp_ctx_neg_remote;
 
@@ -218,12 +276,25 @@ TINYRTP_API int trtp_manager_set_proxy_info(trtp_manager_t* self, enum tnet_prox
 TINYRTP_API int trtp_manager_start(trtp_manager_t* self);
 TINYRTP_API tsk_size_t trtp_manager_send_rtp(trtp_manager_t* self, const void* data, tsk_size_t size, uint32_t duration, tsk_bool_t marker, tsk_bool_t last_packet);
 TINYRTP_API tsk_size_t trtp_manager_send_rtp_packet(trtp_manager_t* self, const struct trtp_rtp_packet_s* packet, tsk_bool_t bypass_encrypt);
+TINYRTP_API tsk_size_t trtp_manager_send_rtp_packet_2(trtp_manager_t* self, const struct trtp_rtp_packet_s* packet, tsk_bool_t bypass_encrypt, trtp_pacer_priority_t priority);
 TINYRTP_API int trtp_manager_get_bytes_count(trtp_manager_t* self, uint64_t* bytes_in, uint64_t* bytes_out);
+TINYRTP_API int trtp_manager_get_worker_stats(trtp_manager_t* self, trtp_worker_stats_t* stats);
 TINYRTP_API tsk_size_t trtp_manager_send_rtp_raw(trtp_manager_t* self, const void* data, tsk_size_t size);
+TINYRTP_API int trtp_manager_send_batch_begin(trtp_manager_t* self);
+TINYRTP_API int trtp_manager_send_batch_flush(trtp_manager_t* self);
+TINYRTP_API int trtp_manager_set_pacing(trtp_manager_t* self, tsk_bool_t enabled);
+TINYRTP_API int trtp_manager_get_pacer_stats(trtp_manager_t* self, trtp_pacer_stats_t* stats);
+TINYRTP_API int trtp_manager_set_twcc_ext_id(trtp_manager_t* self, uint8_t ext_id);
+TINYRTP_API int trtp_manager_get_bwe_target_kbps(trtp_manager_t* self, int32_t* target_kbps);
+TINYRTP_API int trtp_manager_get_bwe_stats(trtp_manager_t* self, trtp_bwe_stats_t* stats);
 TINYRTP_API int trtp_manager_set_app_bw_and_jcng(trtp_manager_t* self, int32_t bw_upload_kbps, int32_t bw_download_kbps, float jcng_q);
 TINYRTP_API int trtp_manager_signal_pkt_loss(trtp_manager_t* self, uint32_t ssrc_media, const uint16_t* seq_nums, tsk_size_t count);
 TINYRTP_API int trtp_manager_signal_frame_corrupted(trtp_manager_t* self, uint32_t ssrc_media);
 TINYRTP_API int trtp_manager_signal_jb_error(trtp_manager_t* self, uint32_t ssrc_media);
+TINYRTP_API int trtp_manager_forward_add(trtp_manager_t* self, trtp_manager_t* output);
+TINYRTP_API int trtp_manager_forward_set_payload_type(trtp_manager_t* self, trtp_manager_t* output, uint8_t pt_in, uint8_t pt_out);
+TINYRTP_API int trtp_manager_forward_get_stats(trtp_manager_t* self, trtp_manager_t* output, trtp_forward_stats_t* stats);
+TINYRTP_API int trtp_manager_forward_remove(trtp_manager_t* self, trtp_manager_t* output);
 TINYRTP_API int trtp_manager_stop(trtp_manager_t* self);
 
 TINYRTP_GEXTERN const tsk_object_def_t *trtp_manager_def_t;
@@ -0,0 +1,77 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_pacer.h
+ * @brief Leaky-bucket RTP pacer: spreads the packets of a video frame over time instead of sending them back-to-back.
+ *
+ * Each RTP manager owns a queue drained at TRTP_PACER_FACTOR times its target bitrate. A packet is sent right away while the budget allows it,
+ * otherwise it's queued and sent later by the pacing thread (shared by all sessions, waking up every TRTP_PACER_INTERVAL ms while packets are queued).
+ * Retransmissions are sent before the queued media and audio is never delayed (but counted in the budget).
+ */
+#ifndef TINYRTP_PACER_H
+#define TINYRTP_PACER_H
+
+#include "tinyrtp_config.h"
+
+#include "tsk_object.h"
+
+TRTP_BEGIN_DECLS
+
+struct trtp_pacer_s;
+
+typedef enum trtp_pacer_priority_e {
+    trtp_pacer_priority_audio, // sent immediately
+    trtp_pacer_priority_retransmission, // queued ahead of the media
+    trtp_pacer_priority_media,
+}
+trtp_pacer_priority_t;
+
+/** Sends a packet. Called on the pacing thread or on the thread pushing the packet.
+* @param tag The value passed to @ref trtp_pacer_push().
+* @retval Zero if succeed and non-zero error code otherwise.
+*/
+typedef int (*trtp_pacer_send_cb_f)(const void* usrdata, const void* data, tsk_size_t size, int32_t tag);
+
+typedef struct trtp_pacer_stats_s {
+    int32_t target_kbps; // zero when pacing is disabled
+    int32_t rate_kbps; // current draining rate
+    uint64_t pkts_sent;
+    uint64_t pkts_delayed; // number of packets sent by the pacing thread
+    uint64_t pkts_audio;
+    uint64_t pkts_retransmitted;
+    uint64_t pkts_overflow; // number of packets sent without pacing because the queue was full
+    tsk_size_t queue_pkts; // number of packets waiting
+    tsk_size_t queue_bytes;
+    uint64_t delay_avg; // average time (ms) spent in the queue, audio excluded
+    uint64_t delay_max;
+}
+trtp_pacer_stats_t;
+
+TINYRTP_API struct trtp_pacer_s* trtp_pacer_create(trtp_pacer_send_cb_f fun, const void* usrdata);
+TINYRTP_API int trtp_pacer_set_target_kbps(struct trtp_pacer_s* self, int32_t target_kbps);
+TINYRTP_API int trtp_pacer_start(struct trtp_pacer_s* self);
+TINYRTP_API int trtp_pacer_push(struct trtp_pacer_s* self, const void* data, tsk_size_t size, trtp_pacer_priority_t priority, int32_t tag);
+TINYRTP_API int trtp_pacer_stop(struct trtp_pacer_s* self);
+TINYRTP_API int trtp_pacer_get_stats(struct trtp_pacer_s* self, trtp_pacer_stats_t* stats);
+
+TRTP_END_DECLS
+
+#endif /* TINYRTP_PACER_H */
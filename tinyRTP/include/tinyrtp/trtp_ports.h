@@ -0,0 +1,61 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_ports.h
+ * @brief Process-wide RTP/RTCP port-pair allocator.
+ *
+ * The pairs (even port for RTP, next one for RTCP) used by all the sessions are tracked in a bitmap. Each port range has a ring of the free pairs, the least recently released first,
+ * so acquiring or releasing a pair doesn't depend on the occupancy. A pair which cannot be bound (e.g. used by another process) goes back to the end of the ring and binding only fails
+ * once all the free pairs were tried.
+ * Optionally, a few pairs per local address can be bound ahead of time (see @ref trtp_ports_warm_up()) and are then replenished when pairs are released.
+ */
+#ifndef TINYRTP_PORTS_H
+#define TINYRTP_PORTS_H
+
+#include "tinyrtp_config.h"
+
+#include "tnet_socket.h"
+
+TRTP_BEGIN_DECLS
+
+#if !defined(TRTP_PORTS_WARM_MAX_COUNT)
+#	define TRTP_PORTS_WARM_MAX_COUNT	64 /* Maximum number of pre-bound pairs per local address */
+#endif
+
+typedef struct trtp_ports_stats_s {
+    uint32_t pairs_total; // within the range
+    uint32_t pairs_used; // within the range, including the pre-bound ones and the ones used by overlapping ranges
+    uint32_t pairs_warm; // pre-bound pairs waiting, all ranges
+    uint64_t acquired; // all ranges
+    uint64_t warm_hits; // pairs taken from the pre-bound ones
+    uint64_t bind_failures; // pairs free for the allocator but which could not be bound
+    uint64_t exhausted; // number of failures because all the pairs were used
+}
+trtp_ports_stats_t;
+
+TINYRTP_API int trtp_ports_bind(const char* host, tnet_socket_type_t type, uint16_t start, uint16_t stop, tnet_port_t hint, tsk_bool_t rtcp, struct tnet_socket_s** rtp_socket, struct tnet_socket_s** rtcp_socket);
+TINYRTP_API int trtp_ports_release(tnet_port_t port);
+TINYRTP_API int trtp_ports_warm_up(const char* host, tnet_socket_type_t type, uint16_t start, uint16_t stop, tsk_size_t count);
+TINYRTP_API int trtp_ports_get_stats(uint16_t start, uint16_t stop, trtp_ports_stats_t* stats);
+
+TRTP_END_DECLS
+
+#endif /* TINYRTP_PORTS_H */
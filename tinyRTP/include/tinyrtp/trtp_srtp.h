@@ -29,6 +29,11 @@
 #	include "tsk_common.h"
 #	include <srtp/srtp.h>
 
+// AEAD_AES_128_GCM and AEAD_AES_256_GCM (rfc7714) require libsrtp >= 1.5 built with OpenSSL
+#if !defined(HAVE_SRTP_GCM)
+#	define HAVE_SRTP_GCM 0
+#endif /* HAVE_SRTP_GCM */
+
 struct trtp_manager_s;
 
 typedef enum trtp_srtp_dtls_event_type_e {
@@ -43,6 +48,8 @@ typedef enum trtp_srtp_crypto_type_e {
     NONE = -1,
     HMAC_SHA1_80,
     HMAC_SHA1_32,
+    AEAD_AES_128_GCM, // rfc7714, requires libsrtp built with GCM support (HAVE_SRTP_GCM)
+    AEAD_AES_256_GCM, // rfc7714, requires libsrtp built with GCM support (HAVE_SRTP_GCM)
 
     SRTP_CRYPTO_TYPES_MAX
 }
@@ -72,12 +79,16 @@ typedef int (*trtp_srtp_dtls_cb_f)(const void* usrdata,  enum trtp_srtp_dtls_eve
 
 #define TRTP_SRTP_AES_CM_128_HMAC_SHA1_80 "AES_CM_128_HMAC_SHA1_80"
 #define TRTP_SRTP_AES_CM_128_HMAC_SHA1_32 "AES_CM_128_HMAC_SHA1_32"
+#define TRTP_SRTP_AEAD_AES_128_GCM "AEAD_AES_128_GCM"
+#define TRTP_SRTP_AEAD_AES_256_GCM "AEAD_AES_256_GCM"
+
+#define TRTP_SRTP_MASTER_KEY_LEN_MAX	(32 + 12) /* AEAD_AES_256_GCM: 256-bit key and 96-bit salt */
 
 #define TRTP_SRTP_LINE_IDX_LOCAL	0
 #define TRTP_SRTP_LINE_IDX_REMOTE	1
 
-static const char* trtp_srtp_crypto_type_strings[2] = {
-    TRTP_SRTP_AES_CM_128_HMAC_SHA1_80, TRTP_SRTP_AES_CM_128_HMAC_SHA1_32
+static const char* trtp_srtp_crypto_type_strings[SRTP_CRYPTO_TYPES_MAX] = {
+    TRTP_SRTP_AES_CM_128_HMAC_SHA1_80, TRTP_SRTP_AES_CM_128_HMAC_SHA1_32, TRTP_SRTP_AEAD_AES_128_GCM, TRTP_SRTP_AEAD_AES_256_GCM
 };
 
 
@@ -85,7 +96,7 @@ typedef struct trtp_srtp_ctx_internal_xs {
     int32_t tag;
     trtp_srtp_crypto_type_t crypto_type;
     char key_str[SRTP_MAX_KEY_LEN];
-    char key_bin[SRTP_MASTER_KEY_LEN];
+    char key_bin[TRTP_SRTP_MASTER_KEY_LEN_MAX];
     tsk_bool_t have_valid_key;
 
     srtp_t session;
@@ -105,6 +116,8 @@ int trtp_srtp_ctx_internal_init(struct trtp_srtp_ctx_internal_xs* ctx, int32_t t
 int trtp_srtp_ctx_internal_deinit(struct trtp_srtp_ctx_internal_xs* ctx);
 int trtp_srtp_ctx_init(struct trtp_srtp_ctx_xs* ctx, int32_t tag, trtp_srtp_crypto_type_t type, uint32_t ssrc);
 int trtp_srtp_ctx_deinit(struct trtp_srtp_ctx_xs* ctx);
+TINYRTP_API tsk_bool_t trtp_srtp_crypto_type_is_supported(trtp_srtp_crypto_type_t type);
+TINYRTP_API int trtp_srtp_crypto_type_get_key_and_salt_lengths(trtp_srtp_crypto_type_t type, tsk_size_t* key_length, tsk_size_t* salt_length);
 TINYRTP_API int trtp_srtp_match_line(const char* crypto_line, int32_t* tag, int32_t* crypto_type, char* key, tsk_size_t key_size);
 
 TINYRTP_API int trtp_srtp_set_crypto(struct trtp_manager_s* rtp_mgr, const char* crypto_line, int32_t idx);
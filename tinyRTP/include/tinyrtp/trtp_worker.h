@@ -0,0 +1,95 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_worker.h
+ * @brief Media workers: threads decoding the incoming RTP packets out of the network thread.
+ *
+ * Each RTP manager owns a bounded single-producer (network thread)/single-consumer (worker) queue
+ * attached to one of the workers. The workers are shared by all sessions (sharded) and created on demand.
+ */
+#ifndef TINYRTP_WORKER_H
+#define TINYRTP_WORKER_H
+
+#include "tinyrtp_config.h"
+
+#include "tinyrtp/rtp/trtp_rtp_session.h"
+
+#include "tsk_object.h"
+
+TRTP_BEGIN_DECLS
+
+struct trtp_rtp_packet_s;
+struct trtp_worker_s;
+
+typedef struct trtp_worker_stats_s {
+    uint64_t enqueued; // number of packets queued by the network thread
+    uint64_t dropped; // number of packets dropped because the queue was full
+    uint64_t processed; // number of packets forwarded to the callback
+    tsk_size_t depth; // number of packets waiting to be processed
+    tsk_size_t depth_max; // highest number of packets waiting to be processed
+    uint64_t latency_avg; // average time (ms) between enqueue and processing
+    uint64_t latency_max; // highest time (ms) between enqueue and processing
+}
+trtp_worker_stats_t;
+
+typedef struct trtp_worker_cell_s {
+    struct trtp_rtp_packet_s* packet;
+    uint64_t time;
+}
+trtp_worker_cell_t;
+
+typedef struct trtp_worker_queue_s {
+    TSK_DECLARE_OBJECT;
+
+    struct trtp_worker_s* worker;
+    tsk_bool_t attached;
+
+    trtp_rtp_cb_f fun;
+    const void* usrdata;
+
+    struct {
+        trtp_worker_cell_t cells[TRTP_WORKER_QUEUE_CAPACITY];
+        volatile uintptr_t head; // next slot to fill (producer only)
+        volatile uintptr_t tail; // next slot to read (consumer only)
+    } ring;
+
+    struct {
+        uint64_t enqueued;
+        uint64_t dropped;
+        uint64_t processed;
+        tsk_size_t depth_max;
+        uint64_t latency_sum;
+        uint64_t latency_max;
+    } stats;
+}
+trtp_worker_queue_t;
+
+TINYRTP_API trtp_worker_queue_t* trtp_worker_queue_create(trtp_rtp_cb_f fun, const void* usrdata);
+TINYRTP_API int trtp_worker_queue_attach(trtp_worker_queue_t* self);
+TINYRTP_API int trtp_worker_queue_push(trtp_worker_queue_t* self, const struct trtp_rtp_packet_s* packet);
+TINYRTP_API int trtp_worker_queue_detach(trtp_worker_queue_t* self);
+TINYRTP_API int trtp_worker_queue_get_stats(const trtp_worker_queue_t* self, trtp_worker_stats_t* stats);
+
+TINYRTP_GEXTERN const tsk_object_def_t *trtp_worker_queue_def_t;
+
+TRTP_END_DECLS
+
+#endif /* TINYRTP_WORKER_H */
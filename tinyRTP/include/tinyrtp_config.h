@@ -75,6 +75,62 @@
 #   define TRTP_RTP_VERSION 2
 #endif /* TRTP_RTP_VERSION */
 
+// Maximum number of media worker threads (see "tmedia_defaults_set_media_workers()")
+#if !defined(TRTP_WORKER_MAX_COUNT)
+#   define TRTP_WORKER_MAX_COUNT 64
+#endif /* TRTP_WORKER_MAX_COUNT */
+// Number of RTP packets a session can have waiting to be decoded. MUST be power of 2.
+#if !defined(TRTP_WORKER_QUEUE_CAPACITY)
+#   define TRTP_WORKER_QUEUE_CAPACITY 512
+#endif /* TRTP_WORKER_QUEUE_CAPACITY */
+// Maximum number of RTP packets processed for a session before moving to the next one
+#if !defined(TRTP_WORKER_BATCH_MAX)
+#   define TRTP_WORKER_BATCH_MAX 32
+#endif /* TRTP_WORKER_BATCH_MAX */
+
+// Minimum time (ms) between two RTCP-PLI/FIR relayed to the sender of a forwarded stream, whatever the number of outputs asking
+#if !defined(TRTP_FORWARD_PLI_INTERVAL)
+#   define TRTP_FORWARD_PLI_INTERVAL 500
+#endif /* TRTP_FORWARD_PLI_INTERVAL */
+// Time (ms) during which a lost packet requested by several outputs is NACKed only once to the sender
+#if !defined(TRTP_FORWARD_NACK_INTERVAL)
+#   define TRTP_FORWARD_NACK_INTERVAL 100
+#endif /* TRTP_FORWARD_NACK_INTERVAL */
+// Number of NACKed sequence numbers remembered to filter the duplicates. MUST be power of 2.
+#if !defined(TRTP_FORWARD_NACK_WINDOW)
+#   define TRTP_FORWARD_NACK_WINDOW 512
+#endif /* TRTP_FORWARD_NACK_WINDOW */
+
+// Time (ms) between two transport-wide congestion control feedbacks (RTCP-RTPFB-TWCC) sent to the peer
+#if !defined(TRTP_TWCC_FEEDBACK_INTERVAL)
+#   define TRTP_TWCC_FEEDBACK_INTERVAL 100
+#endif /* TRTP_TWCC_FEEDBACK_INTERVAL */
+// Maximum number of packets reported per transport-wide congestion control feedback
+#if !defined(TRTP_TWCC_FEEDBACK_MAX_COUNT)
+#   define TRTP_TWCC_FEEDBACK_MAX_COUNT 512
+#endif /* TRTP_TWCC_FEEDBACK_MAX_COUNT */
+// Number of sent packets remembered by the bandwidth estimator to match the feedback. MUST be power of 2.
+#if !defined(TRTP_BWE_HISTORY_SIZE)
+#   define TRTP_BWE_HISTORY_SIZE 4096
+#endif /* TRTP_BWE_HISTORY_SIZE */
+
+// Time (ms) between two runs of the pacing thread while packets are queued (see "trtp_pacer.h")
+#if !defined(TRTP_PACER_INTERVAL)
+#   define TRTP_PACER_INTERVAL 5
+#endif /* TRTP_PACER_INTERVAL */
+// The queue is drained faster than the encoder's bitrate to absorb the key frames without delaying the next frames
+#if !defined(TRTP_PACER_FACTOR)
+#   define TRTP_PACER_FACTOR 2.5f
+#endif /* TRTP_PACER_FACTOR */
+// Maximum time (ms) a packet should wait in the queue, the draining rate is increased beyond
+#if !defined(TRTP_PACER_QUEUE_MAX_DELAY)
+#   define TRTP_PACER_QUEUE_MAX_DELAY 500
+#endif /* TRTP_PACER_QUEUE_MAX_DELAY */
+// Number of RTP packets a session can have waiting to be sent, per priority. MUST be power of 2.
+#if !defined(TRTP_PACER_QUEUE_CAPACITY)
+#   define TRTP_PACER_QUEUE_CAPACITY 1024
+#endif /* TRTP_PACER_QUEUE_CAPACITY */
+
 #include <stdint.h>
 #ifdef __SYMBIAN32__
 #   include <stdlib.h>
@@ -114,6 +114,11 @@ static tsk_object_t* trtp_rtcp_report_rtpfb_dtor(tsk_object_t * self)
             TSK_FREE(rtpfb->tmmbn.MeasuredOverhead);
             break;
         }
+        case trtp_rtcp_rtpfb_fci_type_twcc: {
+            TSK_FREE(rtpfb->twcc.status);
+            TSK_FREE(rtpfb->twcc.delta);
+            break;
+        }
         }
         // deinit base
         trtp_rtcp_packet_deinit(TRTP_RTCP_PACKET(rtpfb));
@@ -188,6 +193,225 @@ trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_create_nack(uint32_t ssrc_sende
     return rtpfb;
 }
 
+/* draft-holmer-rmcat-transport-wide-cc-extensions-01: 3.1
+    0                   1                   2                   3
+    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |      base sequence number     |      packet status count      |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |                 reference time                | fb pkt. count |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |          packet chunk         |         packet chunk          |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   .                                                               .
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |         packet chunk          |  recv delta   |  recv delta   |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   .                                                               .
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+*/
+// encodes the FCI (zero-padded to 32 bits) and returns its size, "pdata" could be null to only compute the size
+static tsk_size_t _trtp_rtcp_report_rtpfb_twcc_encode(const trtp_rtcp_report_rtpfb_t* self, uint8_t* pdata)
+{
+    const uint8_t* status = self->twcc.status;
+    const tsk_size_t count = self->twcc.status_count;
+    tsk_size_t i, k, n, size = 8;
+    uint16_t chunk;
+
+    if (pdata) {
+        pdata[0] = self->twcc.base_seq >> 8;
+        pdata[1] = (self->twcc.base_seq & 0xFF);
+        pdata[2] = self->twcc.status_count >> 8;
+        pdata[3] = (self->twcc.status_count & 0xFF);
+        pdata[4] = (self->twcc.reference_time >> 16) & 0xFF;
+        pdata[5] = (self->twcc.reference_time >> 8) & 0xFF;
+        pdata[6] = (self->twcc.reference_time & 0xFF);
+        pdata[7] = self->twcc.fb_pkt_count;
+    }
+
+    // packet chunks: run length when at least 14 symbols are the same (or for the remaining ones), status vector otherwise
+    for (i = 0; i < count; i += n) {
+        for (n = 1; (i + n) < count && n < 0x1FFF && status[i + n] == status[i]; ++n) ;
+        if (n >= 14 || (i + n) == count) {
+            chunk = (uint16_t)((status[i] << 13) | n);
+        }
+        else {
+            for (k = 0; k < 14 && (i + k) < count && status[i + k] < trtp_rtcp_rtpfb_twcc_status_large_delta; ++k) ;
+            if (k == 14 || (i + k) == count) { // one-bit symbols
+                for (chunk = 0x8000, n = 0; n < k; ++n) {
+                    chunk |= (status[i + n] << (13 - n));
+                }
+            }
+            else { // two-bit symbols
+                for (chunk = 0xC000, n = 0; n < 7 && (i + n) < count; ++n) {
+                    chunk |= (status[i + n] << ((6 - n) << 1));
+                }
+            }
+        }
+        if (pdata) {
+            pdata[size] = chunk >> 8;
+            pdata[size + 1] = (chunk & 0xFF);
+        }
+        size += 2;
+    }
+
+    // receive deltas
+    for (i = 0; i < count; ++i) {
+        if (status[i] == trtp_rtcp_rtpfb_twcc_status_small_delta) {
+            if (pdata) {
+                pdata[size] = (uint8_t)self->twcc.delta[i];
+            }
+            size += 1;
+        }
+        else if (status[i] == trtp_rtcp_rtpfb_twcc_status_large_delta) {
+            if (pdata) {
+                pdata[size] = (uint8_t)(((uint16_t)self->twcc.delta[i]) >> 8);
+                pdata[size + 1] = (uint8_t)(((uint16_t)self->twcc.delta[i]) & 0xFF);
+            }
+            size += 2;
+        }
+    }
+
+    while (size & 0x03) {
+        if (pdata) {
+            pdata[size] = 0;
+        }
+        ++size;
+    }
+    return size;
+}
+
+static int _trtp_rtcp_report_rtpfb_twcc_decode(trtp_rtcp_report_rtpfb_t* self, const uint8_t* pdata, tsk_size_t size)
+{
+    tsk_size_t i, n, k, index = 8;
+    uint16_t chunk;
+
+    if (size < 8) {
+        TSK_DEBUG_ERROR("Too short");
+        return -1;
+    }
+    self->twcc.base_seq = tnet_ntohs_2(&pdata[0]);
+    self->twcc.status_count = tnet_ntohs_2(&pdata[2]);
+    self->twcc.reference_time = (int32_t)((((uint32_t)pdata[4] << 24) | ((uint32_t)pdata[5] << 16) | ((uint32_t)pdata[6] << 8))) >> 8; // sign-extend
+    self->twcc.fb_pkt_count = pdata[7];
+    if (!self->twcc.status_count) {
+        return 0;
+    }
+    if (!(self->twcc.status = tsk_realloc(self->twcc.status, self->twcc.status_count)) || !(self->twcc.delta = tsk_calloc(self->twcc.status_count, sizeof(int16_t)))) {
+        TSK_DEBUG_ERROR("Failed to allocate TWCC status");
+        return -2;
+    }
+
+    for (i = 0; i < self->twcc.status_count; ) {
+        if ((index + 2) > size) {
+            TSK_DEBUG_ERROR("Too short to contain all packet chunks");
+            return -3;
+        }
+        chunk = tnet_ntohs_2(&pdata[index]);
+        index += 2;
+        if (!(chunk & 0x8000)) { // run length
+            for (n = (chunk & 0x1FFF), k = 0; k < n && i < self->twcc.status_count; ++k) {
+                self->twcc.status[i++] = (uint8_t)((chunk >> 13) & 0x03);
+            }
+        }
+        else if (!(chunk & 0x4000)) { // status vector: one-bit symbols
+            for (k = 0; k < 14 && i < self->twcc.status_count; ++k) {
+                self->twcc.status[i++] = (uint8_t)((chunk >> (13 - k)) & 0x01);
+            }
+        }
+        else { // status vector: two-bit symbols
+            for (k = 0; k < 7 && i < self->twcc.status_count; ++k) {
+                self->twcc.status[i++] = (uint8_t)((chunk >> ((6 - k) << 1)) & 0x03);
+            }
+        }
+    }
+
+    for (i = 0; i < self->twcc.status_count; ++i) {
+        if (self->twcc.status[i] == trtp_rtcp_rtpfb_twcc_status_small_delta) {
+            if ((index + 1) > size) {
+                break;
+            }
+            self->twcc.delta[i] = pdata[index];
+            index += 1;
+        }
+        else if (self->twcc.status[i] == trtp_rtcp_rtpfb_twcc_status_large_delta) {
+            if ((index + 2) > size) {
+                break;
+            }
+            self->twcc.delta[i] = (int16_t)tnet_ntohs_2(&pdata[index]);
+            index += 2;
+        }
+    }
+    if (i != self->twcc.status_count) {
+        TSK_DEBUG_ERROR("Too short to contain all receive deltas");
+        return -4;
+    }
+    return 0;
+}
+
+// "arrival_times_us[n]" is the arrival time (any clock, in microseconds) of the packet with transport-wide sequence number "base_seq + n" or a negative value when it's not received
+trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_create_twcc(uint32_t ssrc_sender, uint32_t ssrc_media_src, uint16_t base_seq, uint8_t fb_pkt_count, const int64_t* arrival_times_us, tsk_size_t count)
+{
+    trtp_rtcp_report_rtpfb_t* rtpfb;
+    if (!arrival_times_us || !count || count > 0xFFFF) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if ((rtpfb = trtp_rtcp_report_rtpfb_create_2(trtp_rtcp_rtpfb_fci_type_twcc, ssrc_sender, ssrc_media_src))) {
+        tsk_size_t i;
+        int64_t time_us = -1, delta;
+        rtpfb->twcc.base_seq = base_seq;
+        rtpfb->twcc.status_count = (uint16_t)count;
+        rtpfb->twcc.fb_pkt_count = fb_pkt_count;
+        rtpfb->twcc.status = tsk_calloc(count, sizeof(uint8_t));
+        rtpfb->twcc.delta = tsk_calloc(count, sizeof(int16_t));
+        if (!rtpfb->twcc.status || !rtpfb->twcc.delta) {
+            TSK_OBJECT_SAFE_FREE(rtpfb);
+            return tsk_null;
+        }
+        for (i = 0; i < count; ++i) {
+            if (arrival_times_us[i] < 0) {
+                continue; // not received
+            }
+            if (time_us < 0) {
+                rtpfb->twcc.reference_time = ((int32_t)((uint32_t)(arrival_times_us[i] / TRTP_RTCP_RTPFB_TWCC_REF_UNIT_US) << 8)) >> 8; // 24 bits, sign-extended as when deserialized
+                time_us = (arrival_times_us[i] / TRTP_RTCP_RTPFB_TWCC_REF_UNIT_US) * TRTP_RTCP_RTPFB_TWCC_REF_UNIT_US;
+            }
+            delta = (arrival_times_us[i] - time_us) / TRTP_RTCP_RTPFB_TWCC_DELTA_UNIT_US;
+            delta = TSK_CLAMP(-32768, delta, 32767);
+            rtpfb->twcc.status[i] = (delta >= 0 && delta <= 0xFF) ? trtp_rtcp_rtpfb_twcc_status_small_delta : trtp_rtcp_rtpfb_twcc_status_large_delta;
+            rtpfb->twcc.delta[i] = (int16_t)delta;
+            time_us += (delta * TRTP_RTCP_RTPFB_TWCC_DELTA_UNIT_US); // accumulate the rounded values to avoid drifting
+        }
+
+        TRTP_RTCP_PACKET(rtpfb)->header->length_in_bytes += (uint32_t)_trtp_rtcp_report_rtpfb_twcc_encode(rtpfb, tsk_null);
+        TRTP_RTCP_PACKET(rtpfb)->header->length_in_words_minus1 = ((TRTP_RTCP_PACKET(rtpfb)->header->length_in_bytes >> 2) - 1);
+    }
+    return rtpfb;
+}
+
+// reconstructs the arrival times (in microseconds, remote clock) from the reference time and the receive deltas, negative values for the packets not received
+int trtp_rtcp_report_rtpfb_get_twcc_arrival_times(const trtp_rtcp_report_rtpfb_t* self, int64_t* arrival_times_us, tsk_size_t count)
+{
+    tsk_size_t i;
+    int64_t time_us;
+    if (!self || self->fci_type != trtp_rtcp_rtpfb_fci_type_twcc || !arrival_times_us || count < self->twcc.status_count) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    time_us = ((int64_t)self->twcc.reference_time * TRTP_RTCP_RTPFB_TWCC_REF_UNIT_US);
+    for (i = 0; i < self->twcc.status_count; ++i) {
+        if (self->twcc.status && self->twcc.status[i] != trtp_rtcp_rtpfb_twcc_status_not_received) {
+            time_us += ((int64_t)self->twcc.delta[i] * TRTP_RTCP_RTPFB_TWCC_DELTA_UNIT_US);
+            arrival_times_us[i] = time_us;
+        }
+        else {
+            arrival_times_us[i] = -1;
+        }
+    }
+    return 0;
+}
+
 
 trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_deserialize(const void* data, tsk_size_t _size)
 {
@@ -247,6 +471,13 @@ trtp_rtcp_report_rtpfb_t* trtp_rtcp_report_rtpfb_deserialize(const void* data, t
                 }
                 break;
             }
+            case trtp_rtcp_rtpfb_fci_type_twcc: {
+                if (_trtp_rtcp_report_rtpfb_twcc_decode(rtpfb, pdata, size) != 0) {
+                    TSK_DEBUG_ERROR("Failed to decode transport-cc feedback");
+                    rtpfb->twcc.status_count = 0;
+                }
+                break;
+            }
 
             default: {
                 TSK_DEBUG_ERROR("Unsupported Feedback message type %d", (int)rtpfb->fci_type);
@@ -288,6 +519,10 @@ int trtp_rtcp_report_rtpfb_serialize_to(const trtp_rtcp_report_rtpfb_t* self, vo
         }
         break;
     }
+    case trtp_rtcp_rtpfb_fci_type_twcc: {
+        _trtp_rtcp_report_rtpfb_twcc_encode(self, pdata);
+        break;
+    }
     default: {
         TSK_DEBUG_ERROR("Not implemented");
         return -2;
@@ -301,6 +301,7 @@ typedef struct trtp_rtcp_session_s {
 
     // <RTCP-FB>
     uint8_t fir_seqnr;
+    uint8_t twcc_fb_pkt_count;
     // </RTCP-FB>
 
     // <sender>
@@ -757,6 +758,36 @@ int trtp_rtcp_session_signal_pkt_loss(trtp_rtcp_session_t* self, uint32_t ssrc_m
     return 0;
 }
 
+// Transport-wide congestion control feedback: arrival times of the packets with transport-wide sequence numbers [base_seq, base_seq + count[
+int trtp_rtcp_session_signal_twcc(trtp_rtcp_session_t* self, uint32_t ssrc_media, uint16_t base_seq, const int64_t* arrival_times_us, tsk_size_t count)
+{
+    trtp_rtcp_report_rr_t* rr;
+    if(!self || !self->source_local || !arrival_times_us || !count) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if(!self->is_started) {
+        TSK_DEBUG_ERROR("Not started");
+        return -1;
+    }
+
+    tsk_safeobj_lock(self);
+
+    if((rr = trtp_rtcp_report_rr_create_2(self->source_local->ssrc))) {
+        trtp_rtcp_report_rtpfb_t* rtpfb;
+        if((rtpfb = trtp_rtcp_report_rtpfb_create_twcc(self->source_local->ssrc, ssrc_media, base_seq, self->twcc_fb_pkt_count++, arrival_times_us, count))) {
+            trtp_rtcp_packet_add_packet((trtp_rtcp_packet_t*)rr,  (trtp_rtcp_packet_t*)rtpfb, tsk_false);
+            _trtp_rtcp_session_send_pkt(self, (trtp_rtcp_packet_t*)rr);
+            TSK_OBJECT_SAFE_FREE(rtpfb);
+        }
+        TSK_OBJECT_SAFE_FREE(rr);
+    }
+
+    tsk_safeobj_unlock(self);
+
+    return 0;
+}
+
 // Frame corrupted means the prediction chain is broken -> Send FIR
 int trtp_rtcp_session_signal_frame_corrupted(trtp_rtcp_session_t* self, uint32_t ssrc_media)
 {
@@ -156,17 +156,32 @@ tsk_buffer_t* trtp_rtp_header_serialize(const trtp_rtp_header_t *self)
 trtp_rtp_header_t* trtp_rtp_header_deserialize(const void *data, tsk_size_t size)
 {
     trtp_rtp_header_t* header = tsk_null;
+
+    if(!(header = trtp_rtp_header_create_null())) {
+        TSK_DEBUG_ERROR("Failed to create new RTP header");
+        return tsk_null;
+    }
+    if(trtp_rtp_header_deserialize_to(header, data, size) != 0) {
+        TSK_OBJECT_SAFE_FREE(header);
+    }
+    return header;
+}
+
+/** Deserialize binary buffer into an existing rtp header (no memory allocation) */
+// "header" could be a stack object (e.g. "trtp_rtp_packet_view_t")
+int trtp_rtp_header_deserialize_to(trtp_rtp_header_t *header, const void *data, tsk_size_t size)
+{
     const uint8_t* pdata = (const uint8_t*)data;
     uint8_t csrc_count, i;
 
-    if(!data) {
+    if(!header || !data) {
         TSK_DEBUG_ERROR("Invalid parameter");
-        return tsk_null;
+        return -1;
     }
 
     if(size <TRTP_RTP_HEADER_MIN_SIZE) {
         TSK_DEBUG_ERROR("Too short to contain RTP header");
-        return tsk_null;
+        return -2;
     }
 
     /* Before starting to deserialize, get the "csrc_count" and check the length validity
@@ -175,12 +190,7 @@ trtp_rtp_header_t* trtp_rtp_header_deserialize(const void *data, tsk_size_t size
     csrc_count = (*pdata & 0x0F);
     if(size <(tsk_size_t)TRTP_RTP_HEADER_MIN_SIZE + (csrc_count << 2)) {
         TSK_DEBUG_ERROR("Too short to contain RTP header");
-        return tsk_null;
-    }
-
-    if(!(header = trtp_rtp_header_create_null())) {
-        TSK_DEBUG_ERROR("Failed to create new RTP header");
-        return tsk_null;
+        return -2;
     }
 
     /* version (2bits) */
@@ -221,7 +231,7 @@ trtp_rtp_header_t* trtp_rtp_header_deserialize(const void *data, tsk_size_t size
         header->csrc[i] = pdata[0] << 24 | pdata[1] << 16 | pdata[2] << 8 | pdata[3];
     }
 
-    return header;
+    return 0;
 }
 
 
@@ -135,13 +135,49 @@ tsk_buffer_t* trtp_rtp_packet_serialize(const trtp_rtp_packet_t *self, tsk_size_
     return buffer;
 }
 
+/* locate the extension header and the payload (no copy)
+* RFC 3550 - 5.3.1 RTP Header Extension
+	If the X bit in the RTP header is one, a variable-length header
+	extension MUST be appended to the RTP header, following the CSRC list
+	if present.  The header extension contains a 16-bit length field that
+	counts the number of 32-bit words in the extension, excluding the
+	four-octet extension header (therefore zero is a valid length).  Only
+	a single extension can be appended to the RTP data header.
+	0                   1                   2                   3
+	0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |      defined by profile       |           length              |
+   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+   |                        header extension                       |
+   |                             ....                              |
+*/
+static int _trtp_rtp_packet_locate(const trtp_rtp_header_t* header, const uint8_t* data, tsk_size_t size,
+                                   const uint8_t** extension_ptr, tsk_size_t* extension_size, const uint8_t** payload_ptr, tsk_size_t* payload_size)
+{
+    /* do not need to check overflow (have been done by trtp_rtp_header_deserialize_to()) */
+    *payload_size = (size - TRTP_RTP_HEADER_MIN_SIZE - (header->csrc_count << 2));
+    *extension_ptr = data + (size - *payload_size);
+    *extension_size = 0;
+
+    if(header->extension && *payload_size >= 4 /* extension min-size */) {
+        *extension_size = 4 /* first two 16-bit fields */ + (tnet_ntohs_2(&(*extension_ptr)[2]) << 2/*words(32-bit)*/);
+        if(*extension_size > *payload_size) {
+            TSK_DEBUG_ERROR("Too short to contain RTP extension header (%u > %u)", (unsigned)*extension_size, (unsigned)*payload_size);
+            return -2;
+        }
+        *payload_size -= *extension_size;
+    }
+    *payload_ptr = (*extension_ptr + *extension_size);
+    return 0;
+}
+
 /** Deserialize rtp packet object from binary buffer */
 trtp_rtp_packet_t* trtp_rtp_packet_deserialize(const void *data, tsk_size_t size)
 {
     trtp_rtp_packet_t* packet = tsk_null;
     trtp_rtp_header_t *header;
-    tsk_size_t payload_size;
-    const uint8_t* pdata = data;
+    const uint8_t *extension_ptr = tsk_null, *payload_ptr = tsk_null;
+    tsk_size_t extension_size, payload_size;
 
     if(!data) {
         TSK_DEBUG_ERROR("Invalid parameter");
@@ -158,54 +194,123 @@ trtp_rtp_packet_t* trtp_rtp_packet_deserialize(const void *data, tsk_size_t size
         TSK_DEBUG_ERROR("Failed to deserialize RTP header");
         return tsk_null;
     }
+    if(_trtp_rtp_packet_locate(header, (const uint8_t*)data, size, &extension_ptr, &extension_size, &payload_ptr, &payload_size) != 0) {
+        TSK_OBJECT_SAFE_FREE(header);
+        return tsk_null;
+    }
+    /* create the packet */
+    if(!(packet = trtp_rtp_packet_create_null())) {
+        TSK_DEBUG_ERROR("Failed to create new RTP packet");
+        TSK_OBJECT_SAFE_FREE(header);
+        return tsk_null;
+    }
+    /* set the header */
+    packet->header = header,
+            header = tsk_null;
+
+    if(extension_size && (packet->extension.data = tsk_calloc(extension_size, sizeof(uint8_t)))) {
+        memcpy(packet->extension.data, extension_ptr, extension_size);
+        packet->extension.size = extension_size;
+    }
+
+    packet->payload.size = payload_size;
+    if(payload_size && (packet->payload.data = tsk_calloc(packet->payload.size, sizeof(uint8_t)))) {
+        memcpy(packet->payload.data, payload_ptr, packet->payload.size);
+    }
     else {
-        /* create the packet */
-        if(!(packet = trtp_rtp_packet_create_null())) {
-            TSK_DEBUG_ERROR("Failed to create new RTP packet");
-            TSK_OBJECT_SAFE_FREE(header);
-            return tsk_null;
-        }
-        /* set the header */
-        packet->header = header,
-                header = tsk_null;
-
-        /* do not need to check overflow (have been done by trtp_rtp_header_deserialize()) */
-        payload_size = (size - TRTP_RTP_HEADER_MIN_SIZE - (packet->header->csrc_count << 2));
-        pdata = ((const uint8_t*)data) + (size - payload_size);
-
-        /*	RFC 3550 - 5.3.1 RTP Header Extension
-        	If the X bit in the RTP header is one, a variable-length header
-        	extension MUST be appended to the RTP header, following the CSRC list
-        	if present.  The header extension contains a 16-bit length field that
-        	counts the number of 32-bit words in the extension, excluding the
-        	four-octet extension header (therefore zero is a valid length).  Only
-        	a single extension can be appended to the RTP data header.
-        	0                   1                   2                   3
-        	0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
-           +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-           |      defined by profile       |           length              |
-           +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-           |                        header extension                       |
-           |                             ....                              |
-        */
-        if(packet->header->extension && payload_size>=4 /* extension min-size */) {
-            packet->extension.size = 4 /* first two 16-bit fields */ + (tnet_ntohs(*((uint16_t*)&pdata[2])) << 2/*words(32-bit)*/);
-            if((packet->extension.data = tsk_calloc(packet->extension.size, sizeof(uint8_t)))) {
-                memcpy(packet->extension.data, pdata, packet->extension.size);
-            }
-            payload_size -= packet->extension.size;
-        }
+        TSK_DEBUG_ERROR("Failed to allocate new buffer");
+        packet->payload.size = 0;
+    }
+
+    return packet;
+}
+
+/** Parse rtp packet in place (no memory allocation)
+* @param view Stack object to initialize.
+* @param data Buffer holding the RTP packet. Must outlive the view.
+* @param size The size of the buffer.
+* @retval A pointer to the packet (&view->packet) or null if the buffer is not a valid RTP packet.
+*/
+trtp_rtp_packet_t* trtp_rtp_packet_view_init(trtp_rtp_packet_view_t* view, const void *data, tsk_size_t size)
+{
+    const uint8_t *extension_ptr = tsk_null, *payload_ptr = tsk_null;
+    tsk_size_t extension_size, payload_size;
+
+    if(!view || !data) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
 
-        packet->payload.size = payload_size;
-        if(payload_size && (packet->payload.data = tsk_calloc(packet->payload.size, sizeof(uint8_t)))) {
-            memcpy(packet->payload.data, (pdata + packet->extension.size), packet->payload.size);
+    // "refCount" = 0: tsk_object_ref() returns null and tsk_object_unref() is a no-op
+    // "__def__" is kept to allow checking the object type (e.g. RTCP session)
+    memset(view, 0, sizeof(*view));
+    TSK_OBJECT_HEADER(&view->packet)->__def__ = trtp_rtp_packet_def_t;
+    TSK_OBJECT_HEADER(&view->header)->__def__ = trtp_rtp_header_def_t;
+
+    if(trtp_rtp_header_deserialize_to(&view->header, data, size) != 0) {
+        TSK_DEBUG_ERROR("Failed to deserialize RTP header");
+        return tsk_null;
+    }
+    if(_trtp_rtp_packet_locate(&view->header, (const uint8_t*)data, size, &extension_ptr, &extension_size, &payload_ptr, &payload_size) != 0) {
+        return tsk_null;
+    }
+
+    view->packet.header = &view->header;
+    view->packet.extension.data = extension_size ? (void*)extension_ptr : tsk_null;
+    view->packet.extension.size = extension_size;
+    view->packet.payload.data = (void*)payload_ptr;
+    view->packet.payload.size = payload_size;
+
+    return &view->packet;
+}
+
+/** Gets a reference to the packet to keep it after the callback returns
+* @param self The packet to retain. Could be a view (see @ref trtp_rtp_packet_view_init()) or a real object.
+* @retval A new reference if @a self is a real object, otherwise a copy of the view. Must be released using @ref TSK_OBJECT_SAFE_FREE().
+*/
+trtp_rtp_packet_t* trtp_rtp_packet_retain(const trtp_rtp_packet_t* self)
+{
+    trtp_rtp_packet_t* packet;
+    const void* payload;
+
+    if(!self || !self->header) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if(!TRTP_RTP_PACKET_IS_VIEW(self)) {
+        return (trtp_rtp_packet_t*)tsk_object_ref(TSK_OBJECT(self));
+    }
+
+    if(!(packet = trtp_rtp_packet_create(self->header->ssrc, self->header->seq_num, self->header->timestamp, self->header->payload_type, self->header->marker))) {
+        TSK_DEBUG_ERROR("Failed to create new RTP packet");
+        return tsk_null;
+    }
+    packet->header->version = self->header->version;
+    packet->header->padding = self->header->padding;
+    packet->header->extension = self->header->extension;
+    packet->header->csrc_count = self->header->csrc_count;
+    memcpy(packet->header->csrc, self->header->csrc, sizeof(self->header->csrc));
+    packet->header->codec_id = self->header->codec_id;
+
+    if(self->extension.data && self->extension.size) {
+        if(!(packet->extension.data = tsk_malloc(self->extension.size))) {
+            TSK_DEBUG_ERROR("Failed to allocate new buffer");
+            TSK_OBJECT_SAFE_FREE(packet);
+            return tsk_null;
         }
-        else {
+        memcpy(packet->extension.data, self->extension.data, self->extension.size);
+        packet->extension.size = self->extension.size;
+    }
+    payload = self->payload.data_const ? self->payload.data_const : self->payload.data;
+    if(payload && self->payload.size) {
+        if(!(packet->payload.data = tsk_malloc(self->payload.size))) {
             TSK_DEBUG_ERROR("Failed to allocate new buffer");
-            packet->payload.size = 0;
+            TSK_OBJECT_SAFE_FREE(packet);
+            return tsk_null;
         }
+        memcpy(packet->payload.data, payload, self->payload.size);
+        packet->payload.size = self->payload.size;
     }
-
     return packet;
 }
 
@@ -216,7 +321,6 @@ trtp_rtp_packet_t* trtp_rtp_packet_deserialize(const void *data, tsk_size_t size
 
 
 
-
 //=================================================================================================
 //	RTP packet object definition
 //
@@ -0,0 +1,483 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_bwe.c
+ * @brief Send-side bandwidth estimation using the transport-wide congestion control feedback.
+ *
+ * Delay-based: the packets sent within 5ms are grouped and, for two consecutive groups, the delay variation is
+ * "(arrival(n) - arrival(n-1)) - (send(n) - send(n-1))". The trend (slope of the accumulated and smoothed variation) is
+ * compared against an adaptive threshold to detect the over-use (queues building up), the rate is then decreased to 85% of
+ * the bitrate received by the peer. Otherwise, it's increased by 8% per second or additively when close to the rate of the last decrease.
+ * Loss-based: decreased when more than 10% of the packets are lost, increased when less than 2% are lost.
+ */
+#include "tinyrtp/trtp_bwe.h"
+#include "tinyrtp/rtcp/trtp_rtcp_report_fb.h"
+
+#include "tsk_safeobj.h"
+#include "tsk_memory.h"
+#include "tsk_debug.h"
+
+#include <math.h> /* pow */
+
+#define TRTP_BWE_HISTORY_MASK (TRTP_BWE_HISTORY_SIZE - 1)
+
+#define TRTP_BWE_BURST_US				5000 // packets sent within 5ms are a single group
+#define TRTP_BWE_TRENDLINE_WINDOW		20 // number of delay variations used to compute the trend
+#define TRTP_BWE_TRENDLINE_SMOOTHING	0.9
+#define TRTP_BWE_TRENDLINE_GAIN			4.0
+#define TRTP_BWE_THRESHOLD_INIT			12.5
+#define TRTP_BWE_THRESHOLD_MIN			6.0
+#define TRTP_BWE_THRESHOLD_MAX			600.0
+#define TRTP_BWE_THRESHOLD_K_UP			0.0087
+#define TRTP_BWE_THRESHOLD_K_DOWN		0.039
+#define TRTP_BWE_OVERUSE_TIME_MS		10.0 // time the trend must be over the threshold to signal the over-use
+#define TRTP_BWE_DECREASE_FACTOR		0.85
+#define TRTP_BWE_DECREASE_INTERVAL_US	300000 // at most one decrease per round-trip (approx.)
+#define TRTP_BWE_INCREASE_FACTOR		1.08 // multiplicative increase, per second
+#define TRTP_BWE_INCREASE_ADDITIVE_KBPS	48 // one 1200 bytes packet per 200ms round-trip, per second
+#define TRTP_BWE_ACKED_WINDOW_US		300000
+#define TRTP_BWE_LOSS_HIGH				0.10f
+#define TRTP_BWE_LOSS_LOW				0.02f
+
+typedef struct trtp_bwe_packet_s {
+    tsk_bool_t valid;
+    uint16_t seq_num;
+    uint32_t size;
+    int64_t send_time_us;
+}
+trtp_bwe_packet_t;
+
+typedef struct trtp_bwe_group_s {
+    tsk_bool_t valid;
+    int64_t first_send_us;
+    int64_t last_send_us;
+    int64_t last_arrival_us;
+}
+trtp_bwe_group_t;
+
+typedef struct trtp_bwe_s {
+    TSK_DECLARE_OBJECT;
+
+    int32_t min_kbps;
+    int32_t max_kbps;
+
+    trtp_bwe_packet_t history[TRTP_BWE_HISTORY_SIZE]; // indexed by transport-wide sequence number
+    int64_t arrivals[TRTP_BWE_HISTORY_SIZE]; // arrival times reconstructed from the feedback
+
+    trtp_bwe_group_t group_curr;
+    trtp_bwe_group_t group_prev;
+
+    struct {
+        double acc_delay_ms;
+        double smoothed_delay_ms;
+        double x[TRTP_BWE_TRENDLINE_WINDOW]; // arrival time (ms)
+        double y[TRTP_BWE_TRENDLINE_WINDOW]; // smoothed accumulated delay (ms)
+        tsk_size_t count;
+        tsk_size_t index;
+        int64_t first_arrival_us;
+        uint32_t num_deltas;
+        double trend;
+        double trend_prev;
+        double threshold;
+        int64_t threshold_update_us;
+        double overuse_time_ms; // negative when not over-using
+        uint32_t overuse_count;
+        trtp_bwe_usage_t usage;
+    } delay;
+
+    struct {
+        double kbps;
+        double kbps_at_decrease; // zero if never decreased
+        int64_t update_us;
+        int64_t decrease_us;
+    } aimd;
+
+    struct {
+        double kbps;
+        float fraction;
+        int64_t update_us;
+        int64_t decrease_us;
+    } loss;
+
+    struct {
+        tsk_bool_t started;
+        uint64_t bytes; // received after "start_us"
+        int64_t start_us; // arrival time of the first packet in the window (peer's clock)
+        int32_t kbps;
+    } acked;
+
+    uint64_t feedbacks;
+    uint64_t pkts_unknown;
+
+    TSK_DECLARE_SAFEOBJ;
+}
+trtp_bwe_t;
+
+static const tsk_object_def_t *trtp_bwe_def_t;
+
+static void _trtp_bwe_detect(trtp_bwe_t* self, double send_delta_ms, int64_t arrival_us)
+{
+    double trend, dt_ms;
+    if (self->delay.num_deltas < 2) {
+        self->delay.usage = trtp_bwe_usage_normal;
+        return;
+    }
+    trend = TSK_MIN(self->delay.num_deltas, 60) * self->delay.trend * TRTP_BWE_TRENDLINE_GAIN;
+
+    if (trend > self->delay.threshold) {
+        self->delay.overuse_time_ms = (self->delay.overuse_time_ms < 0.0) ? (send_delta_ms / 2.0) : (self->delay.overuse_time_ms + send_delta_ms);
+        ++self->delay.overuse_count;
+        if (self->delay.overuse_time_ms > TRTP_BWE_OVERUSE_TIME_MS && self->delay.overuse_count > 1 && trend >= self->delay.trend_prev) {
+            self->delay.overuse_time_ms = 0.0;
+            self->delay.overuse_count = 0;
+            self->delay.usage = trtp_bwe_usage_overusing;
+        }
+    }
+    else if (trend < -self->delay.threshold) {
+        self->delay.overuse_time_ms = -1.0;
+        self->delay.overuse_count = 0;
+        self->delay.usage = trtp_bwe_usage_underusing;
+    }
+    else {
+        self->delay.overuse_time_ms = -1.0;
+        self->delay.overuse_count = 0;
+        self->delay.usage = trtp_bwe_usage_normal;
+    }
+    self->delay.trend_prev = trend;
+
+    // adaptive threshold: follows the trend slowly when over it and faster when under it (ignores the spikes)
+    if (!self->delay.threshold_update_us) {
+        self->delay.threshold_update_us = arrival_us;
+    }
+    if (fabs(trend) <= (self->delay.threshold + 15.0)) {
+        dt_ms = TSK_MIN((arrival_us - self->delay.threshold_update_us) / 1000.0, 100.0);
+        self->delay.threshold += ((fabs(trend) < self->delay.threshold) ? TRTP_BWE_THRESHOLD_K_DOWN : TRTP_BWE_THRESHOLD_K_UP) * (fabs(trend) - self->delay.threshold) * TSK_MAX(dt_ms, 0.0);
+        self->delay.threshold = TSK_CLAMP(TRTP_BWE_THRESHOLD_MIN, self->delay.threshold, TRTP_BWE_THRESHOLD_MAX);
+    }
+    self->delay.threshold_update_us = arrival_us;
+}
+
+// "delta_ms" is the delay variation between two groups
+static void _trtp_bwe_trendline_update(trtp_bwe_t* self, double delta_ms, double send_delta_ms, int64_t arrival_us)
+{
+    tsk_size_t i;
+    double x_avg = 0.0, y_avg = 0.0, num = 0.0, den = 0.0;
+
+    if (!self->delay.num_deltas) {
+        self->delay.first_arrival_us = arrival_us;
+    }
+    self->delay.num_deltas = TSK_MIN(self->delay.num_deltas + 1, 1000);
+    self->delay.acc_delay_ms += delta_ms;
+    self->delay.smoothed_delay_ms = (TRTP_BWE_TRENDLINE_SMOOTHING * self->delay.smoothed_delay_ms) + ((1.0 - TRTP_BWE_TRENDLINE_SMOOTHING) * self->delay.acc_delay_ms);
+
+    self->delay.x[self->delay.index] = (arrival_us - self->delay.first_arrival_us) / 1000.0;
+    self->delay.y[self->delay.index] = self->delay.smoothed_delay_ms;
+    self->delay.index = (self->delay.index + 1) % TRTP_BWE_TRENDLINE_WINDOW;
+    self->delay.count = TSK_MIN(self->delay.count + 1, TRTP_BWE_TRENDLINE_WINDOW);
+
+    // least squares: slope of the smoothed delay over the arrival time
+    if (self->delay.count == TRTP_BWE_TRENDLINE_WINDOW) {
+        for (i = 0; i < TRTP_BWE_TRENDLINE_WINDOW; ++i) {
+            x_avg += self->delay.x[i];
+            y_avg += self->delay.y[i];
+        }
+        x_avg /= TRTP_BWE_TRENDLINE_WINDOW;
+        y_avg /= TRTP_BWE_TRENDLINE_WINDOW;
+        for (i = 0; i < TRTP_BWE_TRENDLINE_WINDOW; ++i) {
+            num += (self->delay.x[i] - x_avg) * (self->delay.y[i] - y_avg);
+            den += (self->delay.x[i] - x_avg) * (self->delay.x[i] - x_avg);
+        }
+        if (den != 0.0) {
+            self->delay.trend = num / den;
+        }
+    }
+
+    _trtp_bwe_detect(self, send_delta_ms, arrival_us);
+}
+
+static void _trtp_bwe_on_packet_acked(trtp_bwe_t* self, const trtp_bwe_packet_t* packet, int64_t arrival_us)
+{
+    trtp_bwe_group_t* curr = &self->group_curr;
+    trtp_bwe_group_t* prev = &self->group_prev;
+    int64_t send_delta_us, arrival_delta_us;
+
+    // bitrate received by the peer (while over-using, this is the bottleneck's capacity)
+    if (!self->acked.started || arrival_us < self->acked.start_us) {
+        self->acked.started = tsk_true;
+        self->acked.start_us = arrival_us;
+        self->acked.bytes = 0;
+    }
+    else {
+        self->acked.bytes += packet->size;
+        if ((arrival_us - self->acked.start_us) >= TRTP_BWE_ACKED_WINDOW_US) {
+            self->acked.kbps = (int32_t)((self->acked.bytes * 8000) / (arrival_us - self->acked.start_us));
+            self->acked.start_us = arrival_us;
+            self->acked.bytes = 0;
+        }
+    }
+
+    if (!curr->valid) {
+        curr->valid = tsk_true;
+        curr->first_send_us = curr->last_send_us = packet->send_time_us;
+        curr->last_arrival_us = arrival_us;
+        return;
+    }
+    if (packet->send_time_us < curr->first_send_us) {
+        return; // reordered
+    }
+    if ((packet->send_time_us - curr->first_send_us) <= TRTP_BWE_BURST_US) {
+        curr->last_send_us = TSK_MAX(curr->last_send_us, packet->send_time_us);
+        curr->last_arrival_us = TSK_MAX(curr->last_arrival_us, arrival_us);
+        return;
+    }
+
+    // new group: compare the completed one with the previous
+    if (prev->valid) {
+        send_delta_us = (curr->last_send_us - prev->last_send_us);
+        arrival_delta_us = (curr->last_arrival_us - prev->last_arrival_us);
+        if (arrival_delta_us >= 0 && arrival_delta_us < 3000000) { // otherwise, the peer's clock jumped
+            _trtp_bwe_trendline_update(self, (arrival_delta_us - send_delta_us) / 1000.0, send_delta_us / 1000.0, curr->last_arrival_us);
+        }
+    }
+    *prev = *curr;
+    curr->first_send_us = curr->last_send_us = packet->send_time_us;
+    curr->last_arrival_us = arrival_us;
+}
+
+static void _trtp_bwe_update_rates(trtp_bwe_t* self, tsk_size_t received, tsk_size_t lost, int64_t now_us)
+{
+    double dt_s;
+
+    // delay-based (AIMD)
+    dt_s = self->aimd.update_us ? TSK_MIN((now_us - self->aimd.update_us) / 1000000.0, 1.0) : 0.0;
+    switch (self->delay.usage) {
+    case trtp_bwe_usage_overusing: {
+        if (!self->aimd.decrease_us || (now_us - self->aimd.decrease_us) >= TRTP_BWE_DECREASE_INTERVAL_US) {
+            double kbps = TRTP_BWE_DECREASE_FACTOR * (self->acked.kbps > 0 ? self->acked.kbps : self->aimd.kbps);
+            if (kbps < self->aimd.kbps) {
+                self->aimd.kbps_at_decrease = (self->acked.kbps > 0 ? self->acked.kbps : self->aimd.kbps);
+                self->aimd.kbps = kbps;
+                TSK_DEBUG_INFO("BWE: over-use detected, delay-based=%dkbps (acked=%dkbps)", (int32_t)kbps, self->acked.kbps);
+            }
+            self->aimd.decrease_us = now_us;
+        }
+        break;
+    }
+    case trtp_bwe_usage_normal: {
+        if (self->aimd.kbps_at_decrease > 0.0 && self->aimd.kbps > (self->aimd.kbps_at_decrease * 0.8) && self->aimd.kbps < (self->aimd.kbps_at_decrease * 1.2)) {
+            self->aimd.kbps += (TRTP_BWE_INCREASE_ADDITIVE_KBPS * dt_s); // close to the capacity
+        }
+        else {
+            self->aimd.kbps *= pow(TRTP_BWE_INCREASE_FACTOR, dt_s);
+        }
+        if (self->acked.kbps > 0) {
+            self->aimd.kbps = TSK_MIN(self->aimd.kbps, (self->acked.kbps * 1.5) + 10.0); // do not increase beyond what is really sent
+        }
+        break;
+    }
+    case trtp_bwe_usage_underusing:
+    default:
+        break; // hold until the queues are drained
+    }
+    self->aimd.kbps = TSK_CLAMP(self->min_kbps, self->aimd.kbps, self->max_kbps);
+    self->aimd.update_us = now_us;
+
+    // loss-based
+    if (received + lost) {
+        dt_s = self->loss.update_us ? TSK_MIN((now_us - self->loss.update_us) / 1000000.0, 1.0) : 0.0;
+        self->loss.fraction = (float)lost / (float)(received + lost);
+        if (self->loss.fraction > TRTP_BWE_LOSS_HIGH) {
+            if (!self->loss.decrease_us || (now_us - self->loss.decrease_us) >= TRTP_BWE_DECREASE_INTERVAL_US) {
+                self->loss.kbps *= (1.0 - (0.5 * self->loss.fraction));
+                self->loss.decrease_us = now_us;
+            }
+        }
+        else if (self->loss.fraction < TRTP_BWE_LOSS_LOW) {
+            // increase from the current target: unused headroom must not hide the next losses
+            self->loss.kbps = TSK_MIN(self->loss.kbps, self->aimd.kbps) * pow(TRTP_BWE_INCREASE_FACTOR, dt_s);
+        }
+        self->loss.kbps = TSK_CLAMP(self->min_kbps, self->loss.kbps, self->max_kbps);
+        self->loss.update_us = now_us;
+    }
+
+}
+
+/** Creates a send-side bandwidth estimator.
+* @param start_kbps The bitrate to use until the first feedback is received.
+* @param min_kbps The target bitrate will never be lower.
+* @param max_kbps The target bitrate will never be higher (e.g. the bandwidth negotiated using "b=AS").
+*/
+trtp_bwe_t* trtp_bwe_create(int32_t start_kbps, int32_t min_kbps, int32_t max_kbps)
+{
+    trtp_bwe_t* bwe;
+    if (min_kbps <= 0 || max_kbps < min_kbps) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if ((bwe = tsk_object_new(trtp_bwe_def_t))) {
+        bwe->min_kbps = min_kbps;
+        bwe->max_kbps = max_kbps;
+        bwe->aimd.kbps = bwe->loss.kbps = TSK_CLAMP(min_kbps, start_kbps, max_kbps);
+        bwe->delay.threshold = TRTP_BWE_THRESHOLD_INIT;
+        bwe->delay.overuse_time_ms = -1.0;
+    }
+    return bwe;
+}
+
+int trtp_bwe_set_bounds(trtp_bwe_t* self, int32_t min_kbps, int32_t max_kbps)
+{
+    if (!self || min_kbps <= 0 || max_kbps < min_kbps) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    self->min_kbps = min_kbps;
+    self->max_kbps = max_kbps;
+    self->aimd.kbps = TSK_CLAMP(min_kbps, self->aimd.kbps, max_kbps);
+    self->loss.kbps = TSK_CLAMP(min_kbps, self->loss.kbps, max_kbps);
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+/** Records a packet sent with the transport-wide sequence number @a seq_num.
+* @param size The size on the wire (including the SRTP trailer).
+* @param send_time_us The local time (any clock, in microseconds) when the packet was sent.
+*/
+int trtp_bwe_on_packet_sent(trtp_bwe_t* self, uint16_t seq_num, tsk_size_t size, int64_t send_time_us)
+{
+    trtp_bwe_packet_t* packet;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    packet = &self->history[seq_num & TRTP_BWE_HISTORY_MASK];
+    packet->valid = tsk_true;
+    packet->seq_num = seq_num;
+    packet->size = (uint32_t)size;
+    packet->send_time_us = send_time_us;
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+/** Updates the estimation using a transport-wide congestion control feedback (RTCP-RTPFB-TWCC) received from the peer.
+* @param now_us The local time (same clock as the one used for @ref trtp_bwe_on_packet_sent()).
+*/
+int trtp_bwe_on_feedback(trtp_bwe_t* self, const struct trtp_rtcp_report_rtpfb_s* twcc, int64_t now_us)
+{
+    tsk_size_t i, count, received = 0, lost = 0;
+    trtp_bwe_packet_t* packet;
+    uint16_t seq_num;
+
+    if (!self || !twcc || twcc->fci_type != trtp_rtcp_rtpfb_fci_type_twcc) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!(count = TSK_MIN(twcc->twcc.status_count, TRTP_BWE_HISTORY_SIZE))) {
+        return 0;
+    }
+
+    tsk_safeobj_lock(self);
+    if (trtp_rtcp_report_rtpfb_get_twcc_arrival_times(twcc, self->arrivals, TRTP_BWE_HISTORY_SIZE) == 0) {
+        for (i = 0; i < count; ++i) {
+            seq_num = (uint16_t)(twcc->twcc.base_seq + i);
+            packet = &self->history[seq_num & TRTP_BWE_HISTORY_MASK];
+            if (!packet->valid || packet->seq_num != seq_num) {
+                ++self->pkts_unknown;
+                continue;
+            }
+            if (self->arrivals[i] < 0) {
+                ++lost;
+                continue;
+            }
+            ++received;
+            _trtp_bwe_on_packet_acked(self, packet, self->arrivals[i]);
+            packet->valid = tsk_false; // reported
+        }
+        _trtp_bwe_update_rates(self, received, lost, now_us);
+        ++self->feedbacks;
+    }
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+/** Gets the bitrate the encoder should produce (and the pacer should send). */
+int32_t trtp_bwe_get_target_kbps(trtp_bwe_t* self)
+{
+    int32_t kbps;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return 0;
+    }
+    tsk_safeobj_lock(self);
+    kbps = (int32_t)TSK_MIN(self->aimd.kbps, self->loss.kbps);
+    kbps = TSK_CLAMP(self->min_kbps, kbps, self->max_kbps);
+    tsk_safeobj_unlock(self);
+    return kbps;
+}
+
+int trtp_bwe_get_stats(trtp_bwe_t* self, trtp_bwe_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    stats->target_kbps = trtp_bwe_get_target_kbps(self);
+    stats->delay_based_kbps = (int32_t)self->aimd.kbps;
+    stats->loss_based_kbps = (int32_t)self->loss.kbps;
+    stats->acked_kbps = self->acked.kbps;
+    stats->loss_fraction = self->loss.fraction;
+    stats->trend = self->delay.trend_prev;
+    stats->threshold = self->delay.threshold;
+    stats->usage = self->delay.usage;
+    stats->feedbacks = self->feedbacks;
+    stats->pkts_unknown = self->pkts_unknown;
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+//=================================================================================================
+//	BWE object definition
+//
+static tsk_object_t* trtp_bwe_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_bwe_t *bwe = self;
+    if (bwe) {
+        tsk_safeobj_init(bwe);
+    }
+    return self;
+}
+static tsk_object_t* trtp_bwe_dtor(tsk_object_t * self)
+{
+    trtp_bwe_t *bwe = self;
+    if (bwe) {
+        tsk_safeobj_deinit(bwe);
+    }
+    return self;
+}
+static const tsk_object_def_t trtp_bwe_def_s = {
+    sizeof(trtp_bwe_t),
+    trtp_bwe_ctor,
+    trtp_bwe_dtor,
+    tsk_null,
+};
+static const tsk_object_def_t *trtp_bwe_def_t = &trtp_bwe_def_s;
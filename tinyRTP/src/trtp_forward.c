@@ -0,0 +1,404 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_forward.c
+ * @brief Selective forwarding: relays the RTP packets received by a manager (the source) to other managers (the outputs) without decoding them.
+ *
+ * Locking order: source's links list -> output manager -> source manager.
+ * The feedback received by an output is relayed without holding the output's lock (see trtp_forward_handle_rtcp()).
+ */
+#include "tinyrtp/trtp_forward.h"
+#include "tinyrtp/trtp_manager.h"
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+#include "tinyrtp/rtcp/trtp_rtcp_packet.h"
+#include "tinyrtp/rtcp/trtp_rtcp_report_fb.h"
+#include "tinyrtp/rtcp/trtp_rtcp_session.h"
+
+#include "tnet_endianness.h"
+
+#include "tsk_memory.h"
+#include "tsk_time.h"
+#include "tsk_debug.h"
+
+#include <limits.h> /* INT_MAX */
+
+#define TRTP_FORWARD_NACK_MASK (TRTP_FORWARD_NACK_WINDOW - 1)
+#define TRTP_FORWARD_NACK_MAX_COUNT 256 // maximum number of sequence numbers relayed per RTCP-NACK
+
+trtp_forward_link_t* trtp_forward_link_create(struct trtp_manager_s* source, struct trtp_manager_s* output)
+{
+    trtp_forward_link_t* link;
+    uint8_t pt;
+    if (!source || !output) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if ((link = tsk_object_new(trtp_forward_link_def_t))) {
+        link->source = source;
+        link->output = tsk_object_ref(output);
+        for (pt = 0; pt < sizeof(link->pt_map); ++pt) {
+            link->pt_map[pt] = pt;
+        }
+    }
+    return link;
+}
+
+/** Maps the payload type of the incoming packets to the one negotiated by the output. Use @ref TRTP_FORWARD_PT_DROP as @a pt_out to drop the packets. */
+int trtp_forward_link_set_payload_type(trtp_forward_link_t* self, uint8_t pt_in, uint8_t pt_out)
+{
+    if (!self || pt_in > 127 || (pt_out > 127 && pt_out != TRTP_FORWARD_PT_DROP)) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    self->pt_map[pt_in] = pt_out;
+    return 0;
+}
+
+/** Copies the (decrypted) RTP packet into @a out_ptr with the SSRC, sequence number, timestamp and payload type expected by the output's peer.
+* The header extensions and the payload are copied "as is".
+* Must be called with the output locked.
+* @retval The size of the rewritten packet or zero if the packet must be dropped.
+*/
+tsk_size_t trtp_forward_link_rewrite(trtp_forward_link_t* self, const void* data, tsk_size_t size, void* out_ptr, tsk_size_t out_size)
+{
+    const uint8_t* in = (const uint8_t*)data;
+    uint8_t* out = (uint8_t*)out_ptr;
+    uint8_t pt_out;
+    uint16_t seq_num;
+    uint32_t timestamp, ssrc;
+
+    if (!self || !self->output || !data || size < TRTP_RTP_HEADER_MIN_SIZE || !out_ptr || out_size < size) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return 0;
+    }
+
+    if ((pt_out = self->pt_map[in[1] & 0x7F]) == TRTP_FORWARD_PT_DROP) {
+        return 0;
+    }
+
+    seq_num = tnet_ntohs_2(&in[2]);
+    timestamp = (uint32_t)tnet_ntohl_2(&in[4]);
+    ssrc = (uint32_t)tnet_ntohl_2(&in[8]);
+
+    // first packet or the sender restarted the stream: continue the output's numbering so that its peer sees a single stream
+    if (!self->synced || ssrc != self->ssrc_in) {
+        TSK_DEBUG_INFO("Forwarding SSRC=%u as SSRC=%u", ssrc, self->output->rtp.ssrc.local);
+        self->seq_num_offset = (uint16_t)(self->output->rtp.seq_num + 1 - seq_num);
+        self->timestamp_offset = (self->output->rtp.timestamp + (self->synced ? 1 : 0)) - timestamp;
+        self->ssrc_in = ssrc;
+        self->synced = tsk_true;
+    }
+
+    seq_num += self->seq_num_offset;
+    timestamp += self->timestamp_offset;
+    ssrc = self->output->rtp.ssrc.local;
+
+    memcpy(out, in, size);
+    out[1] = (in[1] & 0x80/* marker */) | pt_out;
+    out[2] = (uint8_t)(seq_num >> 8);
+    out[3] = (uint8_t)seq_num;
+    out[4] = (uint8_t)(timestamp >> 24);
+    out[5] = (uint8_t)(timestamp >> 16);
+    out[6] = (uint8_t)(timestamp >> 8);
+    out[7] = (uint8_t)timestamp;
+    out[8] = (uint8_t)(ssrc >> 24);
+    out[9] = (uint8_t)(ssrc >> 16);
+    out[10] = (uint8_t)(ssrc >> 8);
+    out[11] = (uint8_t)ssrc;
+
+    // packets sent by the output itself must continue the forwarded stream
+    if ((int16_t)(seq_num - self->output->rtp.seq_num) > 0) {
+        self->output->rtp.seq_num = seq_num;
+    }
+    if ((int32_t)(timestamp - self->output->rtp.timestamp) > 0) {
+        self->output->rtp.timestamp = timestamp;
+    }
+
+    return size;
+}
+
+/** Rewrites, encrypts then sends the (decrypted) RTP packet using the output.
+* @retval The number of bytes sent.
+*/
+tsk_size_t trtp_forward_link_send(trtp_forward_link_t* self, const void* data, tsk_size_t size)
+{
+    trtp_manager_t* output;
+    trtp_rtp_packet_view_t view;
+    const trtp_rtp_packet_t* packet;
+    tsk_size_t xsize, rtp_buff_pad_count = 0, ret = 0;
+    int data_size;
+
+    if (!self || !(output = self->output) || !data || !size) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return 0;
+    }
+
+    tsk_safeobj_lock(output);
+
+    if (!output->is_started || !output->transport || !output->transport->master) {
+        goto bail;
+    }
+#if HAVE_SRTP
+    if (output->srtp_state != trtp_srtp_state_none && output->srtp_state != trtp_srtp_state_started) {
+        goto bail;
+    }
+    if (output->srtp_ctx_neg_local) {
+        rtp_buff_pad_count = (SRTP_MAX_TRAILER_LEN + 0x04);
+    }
+#endif /* HAVE_SRTP */
+
+    xsize = size + rtp_buff_pad_count;
+    if (self->buffer.size < xsize) {
+        if (!(self->buffer.ptr = tsk_realloc(self->buffer.ptr, xsize))) {
+            TSK_DEBUG_ERROR("Failed to allocate buffer with size = %d", (int)xsize);
+            self->buffer.size = 0;
+            goto bail;
+        }
+        self->buffer.size = xsize;
+    }
+
+    if (!(data_size = (int)trtp_forward_link_rewrite(self, data, size, self->buffer.ptr, xsize))) {
+        goto bail;
+    }
+    // parsed before the payload is encrypted
+    packet = trtp_rtp_packet_view_init(&view, self->buffer.ptr, (tsk_size_t)data_size);
+#if HAVE_SRTP
+    if (output->srtp_ctx_neg_local) {
+        err_status_t status;
+        if ((status = srtp_protect(output->srtp_ctx_neg_local->rtp.session, self->buffer.ptr, &data_size)) != err_status_ok) {
+            TSK_DEBUG_ERROR("srtp_protect() failed with error code =%d", (int)status);
+            goto bail;
+        }
+    }
+#endif /* HAVE_SRTP */
+    if ((ret = trtp_manager_send_rtp_raw(output, self->buffer.ptr, (tsk_size_t)data_size)) > 0) {
+        // the output's peer must receive RTCP-SR matching the forwarded stream
+        if (output->rtcp.session && packet) {
+            trtp_rtcp_session_process_rtp_out(output->rtcp.session, packet, (tsk_size_t)data_size);
+        }
+    }
+
+bail:
+    if (ret > 0) {
+        ++self->stats.forwarded;
+    }
+    else {
+        ++self->stats.dropped;
+    }
+    tsk_safeobj_unlock(output);
+    return ret;
+}
+
+// must be called with the links locked
+static void _trtp_forward_update_remb(struct trtp_manager_s* source)
+{
+    const tsk_list_item_t* item;
+    int32_t remb_kbps = INT_MAX;
+
+    source->forward.remb_changed = tsk_false;
+
+    // the sender must not exceed the bandwidth of the slowest output
+    tsk_list_foreach(item, source->forward.links) {
+        const trtp_forward_link_t* link = (const trtp_forward_link_t*)item->data;
+        if (link->stats.remb_kbps > 0 && link->stats.remb_kbps < remb_kbps) {
+            remb_kbps = link->stats.remb_kbps;
+        }
+    }
+    if (source->app_bw_max_download > 0 && source->app_bw_max_download < remb_kbps) {
+        remb_kbps = source->app_bw_max_download;
+    }
+    if (remb_kbps != source->forward.remb_kbps && source->rtcp.session) {
+        TSK_DEBUG_INFO("Relaying RTCP-REMB (bw_dwn=%d kbps) from the outputs", remb_kbps);
+        source->forward.remb_kbps = remb_kbps;
+        trtp_rtcp_session_set_app_bw_and_jcng(source->rtcp.session, source->app_bw_max_upload, remb_kbps, source->app_jitter_cng);
+    }
+}
+
+/** Relays the (decrypted) RTP packet received by @a source to all its outputs. Called on the source's network thread. */
+int trtp_forward_send(struct trtp_manager_s* source, const void* data, tsk_size_t size)
+{
+    const tsk_list_item_t* item;
+
+    if (!source || !data || !size) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_list_lock(source->forward.links);
+    if (source->forward.remb_changed) {
+        _trtp_forward_update_remb(source);
+    }
+    tsk_list_foreach(item, source->forward.links) {
+        trtp_forward_link_send((trtp_forward_link_t*)item->data, data, size);
+    }
+    tsk_list_unlock(source->forward.links);
+
+    return 0;
+}
+
+// must be called with the source locked
+static tsk_size_t _trtp_forward_nack_filter(struct trtp_manager_s* source, uint16_t seq_num, uint64_t now, uint16_t* seq_nums, tsk_size_t count)
+{
+    tsk_size_t index = (seq_num & TRTP_FORWARD_NACK_MASK);
+    if (count >= TRTP_FORWARD_NACK_MAX_COUNT) {
+        return count;
+    }
+    // already requested by another output?
+    if (source->forward.nack_seq_nums[index] == seq_num && source->forward.nack_times[index] && (now - source->forward.nack_times[index]) < TRTP_FORWARD_NACK_INTERVAL) {
+        return count;
+    }
+    source->forward.nack_seq_nums[index] = seq_num;
+    source->forward.nack_times[index] = now;
+    seq_nums[count] = seq_num;
+    return count + 1;
+}
+
+/** Relays the feedback received by @a output (RTCP-NACK, RTCP-PLI/FIR and RTCP-REMB) to the source's peer. Called on the output's network thread.
+* - NACKs are translated to the source's sequence numbers. A packet lost by several outputs is requested once.
+* - PLI/FIR from all outputs are merged into at most one FIR every @ref TRTP_FORWARD_PLI_INTERVAL milliseconds.
+* - The lowest REMB from the outputs is reported when the next forwarded packet is relayed.
+*/
+int trtp_forward_handle_rtcp(struct trtp_manager_s* output, const struct trtp_rtcp_packet_s* packet)
+{
+    const trtp_rtcp_report_psfb_t* psfb;
+    const trtp_rtcp_report_rtpfb_t* rtpfb;
+    trtp_forward_link_t* link = tsk_null;
+    trtp_manager_t* source = tsk_null;
+    uint32_t ssrc_in;
+    uint16_t seq_num_offset;
+    tsk_size_t i, j;
+    uint64_t now;
+
+    if (!output || !packet) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    // the source must not be locked while holding the output: copy what is needed and keep references
+    // (null if the source is being destroyed) to lock the source's links then the source without the output
+    tsk_safeobj_lock(output);
+    if ((link = output->forward.link) && link->synced && link->source && (source = tsk_object_ref(link->source))) {
+        link = tsk_object_ref(link);
+        ssrc_in = link->ssrc_in;
+        seq_num_offset = link->seq_num_offset;
+    }
+    else {
+        link = tsk_null;
+    }
+    tsk_safeobj_unlock(output);
+    if (!source) {
+        return 0;
+    }
+
+    tsk_list_lock(source->forward.links);
+    tsk_safeobj_lock(source);
+    if (link->source != source || !source->rtcp.session) {
+        goto bail; // unlinked in the meantime
+    }
+    now = tsk_time_now();
+
+    i = 0;
+    while ((psfb = (const trtp_rtcp_report_psfb_t*)trtp_rtcp_packet_get_at(packet, trtp_rtcp_packet_type_psfb, i++))) {
+        switch (psfb->fci_type) {
+        case trtp_rtcp_psfb_fci_type_pli:
+        case trtp_rtcp_psfb_fci_type_fir: {
+            if (!source->forward.pli_time || (now - source->forward.pli_time) >= TRTP_FORWARD_PLI_INTERVAL) {
+                TSK_DEBUG_INFO("Relaying RTCP-%s from SSRC=%u to SSRC=%u", (psfb->fci_type == trtp_rtcp_psfb_fci_type_pli) ? "PLI" : "FIR", output->rtp.ssrc.local, ssrc_in);
+                trtp_rtcp_session_signal_frame_corrupted(source->rtcp.session, ssrc_in);
+                source->forward.pli_time = now;
+                ++link->stats.pli_relayed;
+            }
+            break;
+        }
+        case trtp_rtcp_psfb_fci_type_afb: {
+            if (psfb->afb.type == trtp_rtcp_psfb_afb_type_remb) {
+                int32_t remb_kbps = (int32_t)TSK_MIN((((uint64_t)psfb->afb.remb.mantissa << psfb->afb.remb.exp) >> 10), INT_MAX);
+                if (remb_kbps != link->stats.remb_kbps) {
+                    link->stats.remb_kbps = remb_kbps;
+                    source->forward.remb_changed = tsk_true;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    i = 0;
+    while ((rtpfb = (const trtp_rtcp_report_rtpfb_t*)trtp_rtcp_packet_get_at(packet, trtp_rtcp_packet_type_rtpfb, i++))) {
+        if (rtpfb->fci_type == trtp_rtcp_rtpfb_fci_type_nack && rtpfb->nack.pid && rtpfb->nack.blp) {
+            uint16_t seq_nums[TRTP_FORWARD_NACK_MAX_COUNT];
+            tsk_size_t count = 0;
+            for (j = 0; j < rtpfb->nack.count; ++j) {
+                // sequence numbers in the output's space -> source's space
+                uint16_t pid = (uint16_t)(rtpfb->nack.pid[j] - seq_num_offset);
+                uint16_t blp = rtpfb->nack.blp[j];
+                int32_t k;
+                count = _trtp_forward_nack_filter(source, pid, now, seq_nums, count);
+                for (k = 0; k < 16; ++k) {
+                    if (blp & (1 << k)) {
+                        count = _trtp_forward_nack_filter(source, (uint16_t)(pid + k + 1), now, seq_nums, count);
+                    }
+                }
+            }
+            if (count > 0) {
+                trtp_rtcp_session_signal_pkt_loss(source->rtcp.session, ssrc_in, seq_nums, count);
+                link->stats.nack_relayed += count;
+            }
+        }
+    }
+
+bail:
+    tsk_safeobj_unlock(source);
+    tsk_list_unlock(source->forward.links);
+    TSK_OBJECT_SAFE_FREE(link);
+    TSK_OBJECT_SAFE_FREE(source);
+    return 0;
+}
+
+
+//=================================================================================================
+//	Forward link object definition
+//
+static tsk_object_t* trtp_forward_link_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_forward_link_t *link = (trtp_forward_link_t*)self;
+    if (link) {
+    }
+    return self;
+}
+static tsk_object_t* trtp_forward_link_dtor(tsk_object_t * self)
+{
+    trtp_forward_link_t *link = (trtp_forward_link_t*)self;
+    if (link) {
+        TSK_OBJECT_SAFE_FREE(link->output);
+        TSK_FREE(link->buffer.ptr);
+    }
+    return self;
+}
+static const tsk_object_def_t trtp_forward_link_def_s = {
+    sizeof(trtp_forward_link_t),
+    trtp_forward_link_ctor,
+    trtp_forward_link_dtor,
+    tsk_null,
+};
+const tsk_object_def_t *trtp_forward_link_def_t = &trtp_forward_link_def_s;
@@ -27,8 +27,10 @@
 #include "tinyrtp/rtp/trtp_rtp_packet.h"
 #include "tinyrtp/rtcp/trtp_rtcp_packet.h"
 #include "tinyrtp/rtcp/trtp_rtcp_session.h"
+#include "tinyrtp/rtcp/trtp_rtcp_report_fb.h"
 
 #include "tnet_proxydetect.h"
+#include "tnet_reactor.h"
 #include "turn/tnet_turn_session.h"
 #include "ice/tnet_ice_candidate.h"
 
@@ -36,6 +38,7 @@
 #include "tsk_memory.h"
 #include "tsk_base64.h"
 #include "tsk_md5.h"
+#include "tsk_object_cache.h"
 #include "tsk_debug.h"
 
 #include <limits.h> /* INT_MAX */
@@ -68,10 +71,32 @@
 #if !defined(TRTP_DTLS_HANDSHAKING_TIMEOUT_MAX)
 #	define TRTP_DTLS_HANDSHAKING_TIMEOUT_MAX (TRTP_DTLS_HANDSHAKING_TIMEOUT << 20)
 #endif
+// "use_srtp" profiles (rfc5764 section 4.1), by order of preference. The GCM profiles (rfc7714) require OpenSSL >= 1.0.2
+#if !defined(TRTP_BWE_MIN_KBPS)
+#	define TRTP_BWE_MIN_KBPS 50
+#endif
+#if !defined(TRTP_BWE_START_KBPS)
+#	define TRTP_BWE_START_KBPS 300
+#endif
+#define TRTP_TWCC_EXT_SIZE 8 /* RFC 5285 one-byte header (4 bytes) + element (1 + 2 bytes) + padding (1 byte) */
+
+#if !defined(TRTP_DTLS_SRTP_PROFILES)
+#	if HAVE_SRTP_GCM
+#		define TRTP_DTLS_SRTP_PROFILES "SRTP_AEAD_AES_128_GCM:SRTP_AEAD_AES_256_GCM:SRTP_AES128_CM_SHA1_80:SRTP_AES128_CM_SHA1_32"
+#	else
+#		define TRTP_DTLS_SRTP_PROFILES "SRTP_AES128_CM_SHA1_80:SRTP_AES128_CM_SHA1_32"
+#	endif
+#endif
 
 static const tmedia_srtp_type_t __srtp_types[] = { tmedia_srtp_type_sdes, tmedia_srtp_type_dtls };
 
 static int _trtp_manager_recv_data(const trtp_manager_t* self, const uint8_t* data_ptr, tsk_size_t data_size, tnet_fd_t local_fd, const struct sockaddr_storage* remote_addr);
+static int _trtp_manager_worker_cb(const void* callback_data, const struct trtp_rtp_packet_s* packet);
+static void _trtp_manager_twcc_on_rtp(trtp_manager_t* self, const struct trtp_rtp_packet_s* packet);
+static int _trtp_manager_pacer_send_cb(const void* usrdata, const void* data, tsk_size_t size, int32_t tag);
+static void _trtp_manager_pacer_update_target(trtp_manager_t* self);
+static tsk_bool_t _trtp_manager_reactor_is_eligible(const trtp_manager_t* self);
+static int _trtp_manager_reactor_cb(const void* usrdata, tnet_fd_t local_fd, const void* data, tsk_size_t size, const struct sockaddr_storage* remote_addr);
 #define _trtp_manager_is_rtcpmux_active(self) ( (self) && ( (self)->use_rtcpmux && (!(self)->rtcp.local_socket || ((self)->transport && (self)->transport->master && (self)->transport->master->fd == (self)->rtcp.local_socket->fd)) ) )
 static int _trtp_manager_send_turn_dtls(struct tnet_ice_ctx_s* ice_ctx, const void* handshaking_data_ptr, tsk_size_t handshaking_data_size, tsk_bool_t use_rtcp_channel);
 #define _trtp_manager_send_turn_dtls_rtp(ice_ctx, handshaking_data_ptr, handshaking_data_size) _trtp_manager_send_turn_dtls((ice_ctx), (handshaking_data_ptr), (handshaking_data_size), /*use_rtcp_channel =*/tsk_false)
@@ -174,19 +199,11 @@ static int _trtp_transport_layer_cb(const tnet_transport_event_t* e)
         tsk_bool_t is_rtp = (manager->transport->master && manager->transport->master->fd == e->local_fd);
         tsk_bool_t is_rtcp = (manager->rtcp.local_socket && manager->rtcp.local_socket->fd == e->local_fd);
         if(is_rtp || is_rtcp) {
-            unsigned int master_salt_length, master_key_length;
+            tsk_size_t master_salt_length = 0, master_key_length = 0;
 
-#if HAVE_SRTP_PROFILE_GET_MASTER_KEY_LENGTH
-            master_key_length = srtp_profile_get_master_key_length(manager->dtls.crypto_selected == HMAC_SHA1_32 ? srtp_profile_aes128_cm_sha1_32 : srtp_profile_aes128_cm_sha1_80);
-#else
-            master_key_length = (128 >> 3); // cipher_key_length - rfc5764 4.1.2.  SRTP Protection Profiles
-#endif
-#if HAVE_SRTP_PROFILE_GET_MASTER_SALT_LENGTH
-            master_salt_length = srtp_profile_get_master_salt_length(manager->dtls.crypto_selected == HMAC_SHA1_32 ? srtp_profile_aes128_cm_sha1_32 : srtp_profile_aes128_cm_sha1_80);
-#else
-            master_salt_length = (112 >> 3); // cipher_salt_length - rfc5764 4.1.2.  SRTP Protection Profiles
-#endif
-            if(((master_key_length + master_salt_length) << 1) > e->size) {
+            // cipher_key_length and cipher_salt_length - rfc5764 4.1.2 and rfc7714 14.2.  SRTP Protection Profiles
+            trtp_srtp_crypto_type_get_key_and_salt_lengths(manager->dtls.crypto_selected, &master_key_length, &master_salt_length);
+            if(!master_key_length || ((master_key_length + master_salt_length) << 1) > e->size) {
                 TSK_DEBUG_ERROR("%d not a valid size for this profile", (int)e->size);
             }
             else {
@@ -253,12 +270,18 @@ static int _trtp_transport_layer_cb(const tnet_transport_event_t* e)
     }
     case event_dtls_srtp_profile_selected: {
         if(manager->transport->master && manager->transport->master->fd == e->local_fd) {
-            /* Only (SRTP_AES128_CM_SHA1_80 | SRTP_AES128_CM_SHA1_32) because of _trtp_manager_srtp_activate() */
-            TSK_DEBUG_INFO("event_dtls_srtp_profile_selected: %.*s", 22, (const char*)e->data);
+            /* Only the profiles listed in _trtp_manager_srtp_activate() */
+            TSK_DEBUG_INFO("event_dtls_srtp_profile_selected: %.*s", (int)e->size, (const char*)e->data);
             manager->dtls.crypto_selected = HMAC_SHA1_80;
             if(tsk_strnequals(e->data, "SRTP_AES128_CM_SHA1_32", 22)) {
                 manager->dtls.crypto_selected = HMAC_SHA1_32;
             }
+            else if(tsk_strnequals(e->data, "SRTP_AEAD_AES_128_GCM", 21)) {
+                manager->dtls.crypto_selected = AEAD_AES_128_GCM;
+            }
+            else if(tsk_strnequals(e->data, "SRTP_AEAD_AES_256_GCM", 21)) {
+                manager->dtls.crypto_selected = AEAD_AES_256_GCM;
+            }
         }
         break;
     }
@@ -376,6 +399,39 @@ static trtp_manager_t* _trtp_manager_create(tsk_bool_t use_rtcp, const char* loc
     return manager;
 }
 
+// Called on the media worker's thread
+static int _trtp_manager_worker_cb(const void* callback_data, const struct trtp_rtp_packet_s* packet)
+{
+    const trtp_manager_t* self = (const trtp_manager_t*)callback_data;
+    if (self->rtp.cb.fun) {
+        return self->rtp.cb.fun(self->rtp.cb.usrdata, packet);
+    }
+    return 0;
+}
+
+// Called on the network thread: relays the feedback to the source when forwarding then to the application
+static int _trtp_manager_rtcp_cb(const void* callback_data, const struct trtp_rtcp_packet_s* packet)
+{
+    trtp_manager_t* self = (trtp_manager_t*)callback_data;
+    if (self->forward.link) {
+        trtp_forward_handle_rtcp(self, packet);
+    }
+    if (self->twcc.bwe) {
+        const trtp_rtcp_report_rtpfb_t* rtpfb;
+        tsk_size_t i = 0;
+        while ((rtpfb = (const trtp_rtcp_report_rtpfb_t*)trtp_rtcp_packet_get_at(packet, trtp_rtcp_packet_type_rtpfb, i++))) {
+            if (rtpfb->fci_type == trtp_rtcp_rtpfb_fci_type_twcc) {
+                trtp_bwe_on_feedback(self->twcc.bwe, rtpfb, (int64_t)tsk_time_now() * 1000);
+            }
+        }
+        _trtp_manager_pacer_update_target(self);
+    }
+    if (self->rtcp.cb.fun) {
+        return self->rtcp.cb.fun(self->rtcp.cb.usrdata, packet);
+    }
+    return 0;
+}
+
 static int _trtp_manager_recv_data(const trtp_manager_t* self, const uint8_t* data_ptr, tsk_size_t data_size, tnet_fd_t local_fd, const struct sockaddr_storage* remote_addr)
 {
     tsk_bool_t is_rtp_rtcp, is_rtcp = tsk_false, is_rtp = tsk_false, is_stun, is_dtls;
@@ -494,8 +550,9 @@ static int _trtp_manager_recv_data(const trtp_manager_t* self, const uint8_t* da
             }
         }
 
-        if(self->rtp.cb.fun) {
-            trtp_rtp_packet_t* packet_rtp = tsk_null;
+        if(self->rtp.cb.fun || !TSK_LIST_IS_EMPTY(self->forward.links)) {
+            trtp_rtp_packet_view_t view_rtp; // parsed in place: consumers must use "trtp_rtp_packet_retain()" to keep the packet
+            const trtp_rtp_packet_t* packet_rtp;
 #if HAVE_SRTP
             err_status_t status;
             if(self->srtp_ctx_neg_remote) {
@@ -512,16 +569,28 @@ static int _trtp_manager_recv_data(const trtp_manager_t* self, const uint8_t* da
                 }
             }
 #endif
-            if((packet_rtp = trtp_rtp_packet_deserialize(data_ptr, data_size))) {
+            if((packet_rtp = trtp_rtp_packet_view_init(&view_rtp, data_ptr, data_size))) {
                 // update remote SSRC based on received RTP packet
                 ((trtp_manager_t*)self)->rtp.ssrc.remote = packet_rtp->header->ssrc;
-                // forward to the callback function (most likely "session_av")
-                self->rtp.cb.fun(self->rtp.cb.usrdata, packet_rtp);
+                // arrival time reported to the peer (transport-wide congestion control)
+                if (self->twcc.ext_id && packet_rtp->header->extension) {
+                    _trtp_manager_twcc_on_rtp((trtp_manager_t*)self, packet_rtp);
+                }
+                // relay to the linked managers (selective forwarding): decrypted once, re-encrypted by each output
+                if (!TSK_LIST_IS_EMPTY(self->forward.links)) {
+                    trtp_forward_send((trtp_manager_t*)self, data_ptr, data_size);
+                }
+                // forward to the callback function (most likely "session_av") or to the media worker
+                if (self->rtp.worker_queue && self->rtp.worker_queue->attached) {
+                    trtp_worker_queue_push(self->rtp.worker_queue, packet_rtp);
+                }
+                else if (self->rtp.cb.fun) {
+                    self->rtp.cb.fun(self->rtp.cb.usrdata, packet_rtp);
+                }
                 // forward packet to the RTCP session
                 if(self->rtcp.session) {
                     trtp_rtcp_session_process_rtp_in(self->rtcp.session, packet_rtp, data_size);
                 }
-                TSK_OBJECT_SAFE_FREE(packet_rtp);
                 return 0;
             }
             else {
@@ -586,6 +655,20 @@ static int _trtp_manager_srtp_set_enabled(trtp_manager_t* self, tmedia_srtp_type
                     HMAC_SHA1_32,
                     self->rtp.ssrc.local
                 );
+#if HAVE_SRTP_GCM
+                trtp_srtp_ctx_init(
+                    &self->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][AEAD_AES_128_GCM],
+                    3,
+                    AEAD_AES_128_GCM,
+                    self->rtp.ssrc.local
+                );
+                trtp_srtp_ctx_init(
+                    &self->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][AEAD_AES_256_GCM],
+                    4,
+                    AEAD_AES_256_GCM,
+                    self->rtp.ssrc.local
+                );
+#endif /* HAVE_SRTP_GCM */
             }
 
             if(srtp_type & tmedia_srtp_type_dtls) {
@@ -622,8 +705,10 @@ static int _trtp_manager_srtp_set_enabled(trtp_manager_t* self, tmedia_srtp_type
 
             // SRTP context is used by both DTLS and SDES -> only destroy them if requested to be disabled on both
             if((~srtp_type & self->srtp_type) == tmedia_srtp_type_none) {
-                trtp_srtp_ctx_deinit(&self->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][0]);
-                trtp_srtp_ctx_deinit(&self->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][1]);
+                int i;
+                for (i = 0; i < SRTP_CRYPTO_TYPES_MAX; ++i) {
+                    trtp_srtp_ctx_deinit(&self->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][i]);
+                }
                 self->srtp_ctx_neg_local = tsk_null;
                 self->srtp_ctx_neg_remote = tsk_null;
                 self->srtp_state = trtp_srtp_state_none;
@@ -669,7 +754,7 @@ static int _trtp_manager_srtp_activate(trtp_manager_t* self, tmedia_srtp_type_t
 
             // activate "use_srtp" (rfc5764 section 4.1) on the transport
             // this should be done before enabling DTLS sockets to be sure that newly created/enabled ones will use "use_srtp" extension
-            if((ret = tnet_transport_dtls_use_srtp(self->transport, "SRTP_AES128_CM_SHA1_80:SRTP_AES128_CM_SHA1_32", sockets, 2))) {
+            if((ret = tnet_transport_dtls_use_srtp(self->transport, TRTP_DTLS_SRTP_PROFILES, sockets, 2))) {
                 return ret;
             }
             // enabling DTLS on the sockets will create the "dtlshandle" field and change the type from UDP to DTLS
@@ -728,8 +813,9 @@ static int _trtp_manager_srtp_activate(trtp_manager_t* self, tmedia_srtp_type_t
 
 static int _trtp_manager_srtp_start(trtp_manager_t* self, tmedia_srtp_type_t srtp_type)
 {
-    const trtp_srtp_ctx_xt *ctx_remote, *ctx_local;
+    const trtp_srtp_ctx_xt *ctx_remote = tsk_null, *ctx_local;
     tsk_bool_t use_different_keys;
+    int32_t i;
 
     if(!self) {
         TSK_DEBUG_ERROR("Invalid parameter");
@@ -741,9 +827,14 @@ static int _trtp_manager_srtp_start(trtp_manager_t* self, tmedia_srtp_type_t srt
         return -2;
     }
 
-    ctx_remote = self->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][HMAC_SHA1_80].rtp.initialized
-                 ? &self->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][HMAC_SHA1_80]
-                 : &self->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][HMAC_SHA1_32];
+    for (i = 0; i < SRTP_CRYPTO_TYPES_MAX && !ctx_remote; ++i) {
+        if (self->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][i].rtp.initialized) {
+            ctx_remote = &self->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][i];
+        }
+    }
+    if (!ctx_remote) {
+        ctx_remote = &self->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][HMAC_SHA1_80];
+    }
 
     // dtls uses different keys for rtp and srtp which is not the case for sdes
     use_different_keys = !_trtp_manager_is_rtcpmux_active(self) && ((srtp_type & tmedia_srtp_type_dtls) == tmedia_srtp_type_dtls);
@@ -864,6 +955,7 @@ static int _trtp_manager_ice_init(trtp_manager_t* self)
 
     // set callback functions
     ret = tnet_transport_set_callback(self->transport, _trtp_transport_layer_cb, self); // NetTransport -> RtpManager
+    ret = tnet_transport_set_recv_batching(self->transport, tsk_true); // read all pending RTP/RTCP packets at once
     ret = tnet_ice_ctx_rtp_callback(self->ice_ctx, (tnet_ice_rtp_callback_f)_trtp_manager_recv_data, self); // ICE -> RtpManager
 
 bail:
@@ -937,51 +1029,37 @@ int trtp_manager_prepare(trtp_manager_t* self)
         rtcp_local_port = 1; // ICE default rtcp port, do not use zero which is reserved to disabled medias
     }
     else {
-#define __retry_count_max 5
-#define __retry_count_max_minus1 (__retry_count_max - 1)
-        uint8_t retry_count = __retry_count_max;
+        tnet_socket_t* rtp_socket = tsk_null;
+
+        // pair left by a previous start() which failed after freeing the transport
+        if (self->port_range.acquired) {
+            TSK_OBJECT_SAFE_FREE(self->rtcp.local_socket);
+            trtp_ports_release(self->port_range.acquired);
+            self->port_range.acquired = 0;
+        }
 
 		// If local IP is defined then check its address family
 		if (!tsk_strnullORempty(self->local_ip)) {
 			socket_type = tnet_get_type(self->local_ip, rtp_local_port); // IP address always returns IPv4Only or IPv6Only
 		}
 
-        /* Creates local rtp and rtcp sockets */
-        while(retry_count--) {
-            /* random number in the range 1024 to 65535 */
-            static int counter = 0;
-#if 0
-            tnet_port_t local_port = 6060;
-#else
-            // first check => try to use port from latest active session if exist
-            tnet_port_t local_port = (retry_count == __retry_count_max_minus1 && (self->port_range.start <= self->rtp.public_addr.port && self->rtp.public_addr.port <= self->port_range.stop))
-                                     ? self->rtp.public_addr.port
-                                     : (((rand() ^ ++counter) % (self->port_range.stop - self->port_range.start)) + self->port_range.start);
-#endif
-            local_port = (local_port & 0xFFFE); /* turn to even number */
-
-            /* beacuse failure will cause errors in the log, print a message to alert that there is
-            * nothing to worry about */
-            TSK_DEBUG_INFO("RTP/RTCP manager[Begin]: Trying to bind to random ports");
-
-            /* RTP */
-            if(!(self->transport = tnet_transport_create(self->local_ip, local_port, socket_type, TRTP_TRANSPORT_NAME))) {
-                TSK_DEBUG_ERROR("Failed to create RTP/RTCP Transport");
-                return -3;
-            }
-
-            /* RTCP */
-            if (self->use_rtcp) {
-                if(!(self->rtcp.local_socket = tnet_socket_create(self->local_ip, local_port+1, socket_type))) {
-                    TSK_DEBUG_WARN("Failed to bind to %d", local_port+1);
-                    TSK_OBJECT_SAFE_FREE(self->transport);
-                    continue;
-                }
-            }
+        /* Creates local rtp and rtcp sockets (first check => try to use port from latest active session if exist) */
+        if (trtp_ports_bind(self->local_ip, socket_type, self->port_range.start, self->port_range.stop, self->rtp.public_addr.port, self->use_rtcp, &rtp_socket, &self->rtcp.local_socket) != 0) {
+            TSK_DEBUG_ERROR("Failed to bind RTP/RTCP sockets within [%u, %u]", self->port_range.start, self->port_range.stop);
+            return -3;
+        }
+        self->port_range.acquired = rtp_socket->port;
 
-            TSK_DEBUG_INFO("RTP/RTCP manager[End]: Trying to bind to random ports");
-            break;
-        }// end-of-while(retry_count)
+        /* RTP */
+        self->transport = tnet_transport_create_2(rtp_socket, TRTP_TRANSPORT_NAME);
+        TSK_OBJECT_SAFE_FREE(rtp_socket);
+        if (!self->transport) {
+            TSK_DEBUG_ERROR("Failed to create RTP/RTCP Transport");
+            TSK_OBJECT_SAFE_FREE(self->rtcp.local_socket);
+            trtp_ports_release(self->port_range.acquired);
+            self->port_range.acquired = 0;
+            return -3;
+        }
 
         rtp_local_ip = self->transport->master->ip;
         rtp_local_port = self->transport->master->port;
@@ -1003,6 +1081,8 @@ int trtp_manager_prepare(trtp_manager_t* self)
     if(self->transport) {
         /* set callback function */
         tnet_transport_set_callback(self->transport, _trtp_transport_layer_cb, self);
+        /* read all pending RTP/RTCP packets at once */
+        tnet_transport_set_recv_batching(self->transport, tsk_true);
         /* Disable receiving until we start the transport (To avoid buffering) */
 #if TRTP_DISABLE_SOCKETS_BEFORE_START
         if(!self->socket_disabled) {
@@ -1274,9 +1354,6 @@ int trtp_manager_set_rtcp_callback(trtp_manager_t* self, trtp_rtcp_cb_f fun, con
 
     self->rtcp.cb.fun = fun;
     self->rtcp.cb.usrdata = usrdata;
-    if(self->rtcp.session) {
-        return trtp_rtcp_session_set_callback(self->rtcp.session, fun, usrdata);
-    }
 
     return 0;
 }
@@ -1384,6 +1461,7 @@ int trtp_manager_start(trtp_manager_t* self)
     int ret = 0;
     int rcv_buf = (int)tmedia_defaults_get_rtpbuff_size();
     int snd_buf = (int)tmedia_defaults_get_rtpbuff_size();
+    tsk_bool_t use_reactor = tsk_false;
 #if !TRTP_UNDER_WINDOWS_CE
     int32_t dscp_rtp;
 #endif
@@ -1415,6 +1493,7 @@ int trtp_manager_start(trtp_manager_t* self)
         ret = -2;
         goto bail;
     }
+    use_reactor = _trtp_manager_reactor_is_eligible(self);
 
     /* Proxy */
     // Proxy info
@@ -1505,10 +1584,10 @@ int trtp_manager_start(trtp_manager_t* self)
             /* do not exit */
         }
 
-        /* add RTCP socket to the transport */
+        /* add RTCP socket to the transport (or to the media reactor, see below) */
         if(self->rtcp.local_socket) {
             TSK_DEBUG_INFO("rtcp.local_ip=%s, rtcp.local_port=%d, rtcp.local_fd=%d", self->rtcp.local_socket->ip, self->rtcp.local_socket->port, self->rtcp.local_socket->fd);
-            if(ret == 0 && (ret = tnet_transport_add_socket(self->transport, self->rtcp.local_socket->fd, self->rtcp.local_socket->type, tsk_false/* do not take ownership */, tsk_true/* only Meaningful for tls*/, tsk_null))) {
+            if(ret == 0 && !use_reactor && (ret = tnet_transport_add_socket(self->transport, self->rtcp.local_socket->fd, self->rtcp.local_socket->type, tsk_false/* do not take ownership */, tsk_true/* only Meaningful for tls*/, tsk_null))) {
                 TSK_DEBUG_ERROR("Failed to add RTCP socket");
                 /* do not exit */
             }
@@ -1518,7 +1597,7 @@ int trtp_manager_start(trtp_manager_t* self)
             self->rtcp.session = trtp_rtcp_session_create_2(self->ice_ctx, self->rtp.ssrc.local, self->rtcp.cname);
         }
         if(self->rtcp.session) {
-            ret = trtp_rtcp_session_set_callback(self->rtcp.session, self->rtcp.cb.fun, self->rtcp.cb.usrdata);
+            ret = trtp_rtcp_session_set_callback(self->rtcp.session, _trtp_manager_rtcp_cb, self);
             ret = trtp_rtcp_session_set_app_bw_and_jcng(self->rtcp.session, self->app_bw_max_upload, self->app_bw_max_download, self->app_jitter_cng);
             ret = trtp_rtcp_session_set_net_transport(self->rtcp.session, self->transport);
             if((ret = trtp_rtcp_session_start(self->rtcp.session, local_rtcp_fd, (const struct sockaddr *)&self->rtcp.remote_addr))) {
@@ -1549,8 +1628,35 @@ int trtp_manager_start(trtp_manager_t* self)
 #endif /* HAVE_SRTP */
 
 
-    /* start the transport if TURN is not active (otherwise TURN data will be received directly on RTP manager with channel headers) */
-    if (!self->is_ice_turn_active && (ret = tnet_transport_start(self->transport))) {
+    /* decode on a media worker instead of the network thread */
+    if (tmedia_defaults_get_media_workers_count() > 0) {
+        if (!self->rtp.worker_queue && !(self->rtp.worker_queue = trtp_worker_queue_create(_trtp_manager_worker_cb, self))) {
+            TSK_DEBUG_ERROR("Failed to create media worker queue");
+            ret = -1;
+            goto bail;
+        }
+        if (trtp_worker_queue_attach(self->rtp.worker_queue) != 0) {
+            TSK_DEBUG_WARN("Failed to attach media worker queue: RTP packets will be decoded on the network thread");
+        }
+    }
+
+    /* spread the packets over time instead of sending them back-to-back */
+    if (self->rtp.pacer) {
+        _trtp_manager_pacer_update_target(self);
+        if (trtp_pacer_start(self->rtp.pacer) != 0) {
+            TSK_DEBUG_WARN("Failed to start the pacer: RTP packets will be sent without pacing");
+        }
+    }
+
+    /* read the sockets on the shared media reactor (attached once unlocked) or start the transport if TURN is not active (otherwise TURN data will be received directly on RTP manager with channel headers) */
+    if (use_reactor) {
+        self->rtp.reactor.fds[0] = self->transport->master->fd;
+        self->rtp.reactor.count = 1;
+        if (self->rtcp.local_socket && self->rtcp.local_socket->fd != self->transport->master->fd) {
+            self->rtp.reactor.fds[self->rtp.reactor.count++] = self->rtcp.local_socket->fd;
+        }
+    }
+    else if (!self->is_ice_turn_active && (ret = tnet_transport_start(self->transport))) {
         TSK_DEBUG_ERROR("Failed to start the RTP/RTCP transport");
         goto bail;
     }
@@ -1561,6 +1667,24 @@ bail:
 
     tsk_safeobj_unlock(self);
 
+    // must not hold the lock: the reactor's thread could be waiting for it while calling the callback of another session
+    if (use_reactor && ret == 0) {
+        int32_t threads = tmedia_defaults_get_media_reactor_threads();
+        tnet_reactor_set_threads(threads > 0 ? threads : 0); // negative means one per CPU
+        if (tnet_reactor_attach(self->rtp.reactor.fds, self->rtp.reactor.count, _trtp_manager_reactor_cb, self) != 0) {
+            TSK_DEBUG_WARN("Failed to attach the RTP/RTCP sockets to the media reactor: using the transport's threads");
+            tsk_safeobj_lock(self);
+            if (self->rtp.reactor.count > 1) {
+                tnet_transport_add_socket(self->transport, self->rtp.reactor.fds[1], self->rtcp.local_socket->type, tsk_false/* do not take ownership */, tsk_true/* only Meaningful for tls*/, tsk_null);
+            }
+            self->rtp.reactor.count = 0;
+            if ((ret = tnet_transport_start(self->transport))) {
+                TSK_DEBUG_ERROR("Failed to start the RTP/RTCP transport");
+            }
+            tsk_safeobj_unlock(self);
+        }
+    }
+
     return ret;
 }
 
@@ -1612,12 +1736,27 @@ tsk_size_t trtp_manager_send_rtp(trtp_manager_t* self, const void* data, tsk_siz
     return ret;
 }
 
-// serialize, encrypt then send the data
+static uint8_t* _trtp_manager_send_batch_reserve(trtp_manager_t* self, tsk_size_t size);
+static tsk_size_t _trtp_manager_send_batch_commit(trtp_manager_t* self, tsk_size_t size);
+static tsk_size_t _trtp_manager_twcc_set_ext(trtp_manager_t* self, uint8_t* data, tsk_size_t size, uint16_t seq_num);
+
 tsk_size_t trtp_manager_send_rtp_packet(trtp_manager_t* self, const struct trtp_rtp_packet_s* packet, tsk_bool_t bypass_encrypt)
+{
+    return trtp_manager_send_rtp_packet_2(self, packet, bypass_encrypt, trtp_pacer_priority_media);
+}
+
+// serialize, encrypt then send the data
+// when batching (see trtp_manager_send_batch_begin()) the packet is serialized and encrypted in place in the batch buffer
+// when pacing (see trtp_manager_set_pacing()) the packet is handed to the pacer with the given priority and could be sent later (returns the number of bytes queued)
+tsk_size_t trtp_manager_send_rtp_packet_2(trtp_manager_t* self, const struct trtp_rtp_packet_s* packet, tsk_bool_t bypass_encrypt, trtp_pacer_priority_t priority)
 {
     int ret = 0;
     tsk_size_t rtp_buff_pad_count = 0;
     tsk_size_t xsize;
+    tsk_bool_t batched, twcc;
+    uint16_t twcc_seq_num = 0;
+    tsk_thread_id_t thread_id;
+    void* data_ptr;
 
     /* check validity */
     if(!self || !packet) {
@@ -1629,6 +1768,7 @@ tsk_size_t trtp_manager_send_rtp_packet(trtp_manager_t* self, const struct trtp_
 
     // reset index
     self->rtp.serial_buffer.index = 0;
+    self->rtp.serial_buffer.last = tsk_null;
 
     /* check if transport is started */
     if(!self->is_started || !self->transport || !self->transport->master) {
@@ -1649,34 +1789,64 @@ tsk_size_t trtp_manager_send_rtp_packet(trtp_manager_t* self, const struct trtp_
 #endif /* HAVE_SRTP */
 
     xsize = (trtp_rtp_packet_guess_serialbuff_size(packet) + rtp_buff_pad_count);
-    if(self->rtp.serial_buffer.size < xsize) {
-        if(!(self->rtp.serial_buffer.ptr = tsk_realloc(self->rtp.serial_buffer.ptr, xsize))) {
-            TSK_DEBUG_ERROR("Failed to allocate buffer with size = %d", (int)xsize);
-            self->rtp.serial_buffer.size = 0;
+    // the transport-wide sequence number is added unless the packet already has a header extension
+    if ((twcc = (self->twcc.ext_id && self->twcc.bwe && !packet->header->extension))) {
+        xsize += TRTP_TWCC_EXT_SIZE;
+        twcc_seq_num = self->twcc.seq_num++;
+    }
+    thread_id = tsk_thread_get_id();
+    batched = (self->rtp.send_batch.started && tsk_thread_id_equals(&thread_id, &self->rtp.send_batch.thread_id) && !self->is_ice_turn_active && !self->rtp.pacer);
+    if (batched) {
+        // no intermediate copy: serialized and encrypted directly at the end of the batch
+        if (!(data_ptr = _trtp_manager_send_batch_reserve(self, xsize))) {
             goto bail;
         }
-        self->rtp.serial_buffer.size = xsize;
+    }
+    else {
+        if(self->rtp.serial_buffer.size < xsize) {
+            if(!(self->rtp.serial_buffer.ptr = tsk_realloc(self->rtp.serial_buffer.ptr, xsize))) {
+                TSK_DEBUG_ERROR("Failed to allocate buffer with size = %d", (int)xsize);
+                self->rtp.serial_buffer.size = 0;
+                goto bail;
+            }
+            self->rtp.serial_buffer.size = xsize;
+        }
+        data_ptr = self->rtp.serial_buffer.ptr;
     }
 
     /* serialize and send over the network */
-    if ((ret = (int)trtp_rtp_packet_serialize_to(packet, self->rtp.serial_buffer.ptr, xsize))) {
-        void* data_ptr = self->rtp.serial_buffer.ptr;
+    if ((ret = (int)trtp_rtp_packet_serialize_to(packet, data_ptr, xsize))) {
         int data_size = ret;
+        if (twcc) {
+            data_size = (int)_trtp_manager_twcc_set_ext(self, data_ptr, (tsk_size_t)data_size, twcc_seq_num);
+        }
 #if HAVE_SRTP
         err_status_t status;
         if(self->srtp_ctx_neg_local && !bypass_encrypt) {
             if((status = srtp_protect(self->srtp_ctx_neg_local->rtp.session, data_ptr, &data_size)) != err_status_ok) {
                 TSK_DEBUG_ERROR("srtp_protect() failed with error code =%d", (int)status);
+                ret = 0;
                 goto bail;
             }
         }
 #endif
         self->rtp.serial_buffer.index = data_size; // update index
-        if (/* number of bytes sent */(ret = (int)trtp_manager_send_rtp_raw(self, data_ptr, data_size)) > 0) {
+        self->rtp.serial_buffer.last = data_ptr;
+        if (self->rtp.pacer) {
+            // copied by the pacer if it cannot be sent now
+            ret = (trtp_pacer_push(self->rtp.pacer, data_ptr, (tsk_size_t)data_size, priority, twcc ? (int32_t)twcc_seq_num : -1) == 0) ? data_size : 0;
+        }
+        else {
+            ret = batched ? (int)_trtp_manager_send_batch_commit(self, data_size) : (int)trtp_manager_send_rtp_raw(self, data_ptr, data_size);
+        }
+        if (/* number of bytes sent */ret > 0) {
             // forward packet to the RTCP session
             if (self->rtcp.session) {
                 trtp_rtcp_session_process_rtp_out(self->rtcp.session, packet, data_size);
             }
+            if (twcc && !self->rtp.pacer) { // otherwise, when actually sent
+                trtp_bwe_on_packet_sent(self->twcc.bwe, twcc_seq_num, (tsk_size_t)data_size, (int64_t)tsk_time_now() * 1000);
+            }
         }
         else {
             ret = 0;
@@ -1691,6 +1861,52 @@ bail:
     return ret;
 }
 
+// must be called with the manager locked
+static tsk_size_t _trtp_manager_send_batch_send(trtp_manager_t* self)
+{
+    const void* bufs[TRTP_SEND_BATCH_MAX_COUNT];
+    tsk_size_t i, index, ret = 0;
+
+    if (self->rtp.send_batch.count && self->transport && self->transport->master) {
+        for (i = 0, index = 0; i < self->rtp.send_batch.count; ++i) {
+            bufs[i] = &self->rtp.send_batch.ptr[index];
+            index += self->rtp.send_batch.sizes[i];
+        }
+        ret = tnet_transport_sendto_batch(self->transport, self->transport->master->fd, (const struct sockaddr *)&self->rtp.remote_addr, bufs, self->rtp.send_batch.sizes, self->rtp.send_batch.count);
+    }
+    self->rtp.send_batch.count = 0;
+    self->rtp.send_batch.index = 0;
+    return ret;
+}
+
+// must be called with the manager locked
+// returns the address where to write the next packet (at most "size" bytes), valid until the next call
+static uint8_t* _trtp_manager_send_batch_reserve(trtp_manager_t* self, tsk_size_t size)
+{
+    if (self->rtp.send_batch.count >= TRTP_SEND_BATCH_MAX_COUNT) {
+        _trtp_manager_send_batch_send(self);
+    }
+    if ((self->rtp.send_batch.index + size) > self->rtp.send_batch.size) {
+        tsk_size_t xsize = TSK_MAX((self->rtp.send_batch.index + size), (self->rtp.send_batch.size << 1));
+        if (!(self->rtp.send_batch.ptr = tsk_realloc(self->rtp.send_batch.ptr, xsize))) {
+            TSK_DEBUG_ERROR("Failed to allocate buffer with size = %d", (int)xsize);
+            self->rtp.send_batch.size = self->rtp.send_batch.index = self->rtp.send_batch.count = 0;
+            return tsk_null;
+        }
+        self->rtp.send_batch.size = xsize;
+    }
+    return &self->rtp.send_batch.ptr[self->rtp.send_batch.index];
+}
+
+// must be called with the manager locked
+// queues the packet written at the address returned by the last call to "_trtp_manager_send_batch_reserve()"
+static tsk_size_t _trtp_manager_send_batch_commit(trtp_manager_t* self, tsk_size_t size)
+{
+    self->rtp.send_batch.index += size;
+    self->rtp.send_batch.sizes[self->rtp.send_batch.count++] = size;
+    return size;
+}
+
 // send raw data "as is" without adding any RTP header or SRTP encryption
 tsk_size_t trtp_manager_send_rtp_raw(trtp_manager_t* self, const void* data, tsk_size_t size)
 {
@@ -1716,6 +1932,37 @@ tsk_size_t trtp_manager_send_rtp_raw(trtp_manager_t* self, const void* data, tsk
     return ret;
 }
 
+/** Starts queuing the outgoing RTP packets instead of sending them one by one.
+* The packets are sent using a single call to "tnet_transport_sendto_batch()" when @ref trtp_manager_send_batch_flush() is called (e.g. after encoding a video frame).
+* Only the packets sent with @ref trtp_manager_send_rtp_packet_2() by the calling thread are queued: the others (e.g. NACK retransmissions, forwarded packets) are sent right away.
+*/
+int trtp_manager_send_batch_begin(trtp_manager_t* self)
+{
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    self->rtp.send_batch.started = tsk_true;
+    self->rtp.send_batch.thread_id = tsk_thread_get_id();
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+/** Sends the RTP packets queued since @ref trtp_manager_send_batch_begin() and stops queuing. */
+int trtp_manager_send_batch_flush(trtp_manager_t* self)
+{
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    _trtp_manager_send_batch_send(self);
+    self->rtp.send_batch.started = tsk_false;
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
 int trtp_manager_get_bytes_count(trtp_manager_t* self, uint64_t* bytes_in, uint64_t* bytes_out)
 {
     if (!self) {
@@ -1739,12 +1986,280 @@ int trtp_manager_get_bytes_count(trtp_manager_t* self, uint64_t* bytes_in, uint6
     return tnet_transport_get_bytes_count(self->transport, bytes_in, bytes_out);
 }
 
+/** Gets the queue-depth and latency metrics for the media worker decoding the incoming RTP packets
+* @retval Zero if succeed and non-zero error code otherwise (e.g. media workers disabled)
+*/
+int trtp_manager_get_worker_stats(trtp_manager_t* self, trtp_worker_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!self->rtp.worker_queue) {
+        return -2;
+    }
+    return trtp_worker_queue_get_stats(self->rtp.worker_queue, stats);
+}
+
+// inserts the transport-wide sequence number (RFC 5285 one-byte header extension) after the RTP header
+// "data" must have room for TRTP_TWCC_EXT_SIZE more bytes
+static tsk_size_t _trtp_manager_twcc_set_ext(trtp_manager_t* self, uint8_t* data, tsk_size_t size, uint16_t seq_num)
+{
+    tsk_size_t hdr_size = TRTP_RTP_HEADER_MIN_SIZE + ((data[0] & 0x0F) << 2); // + CSRC list
+    if (size < hdr_size) {
+        return size;
+    }
+    memmove(&data[hdr_size + TRTP_TWCC_EXT_SIZE], &data[hdr_size], (size - hdr_size));
+    data[0] |= 0x10; // X bit
+    data[hdr_size] = 0xBE;
+    data[hdr_size + 1] = 0xDE;
+    data[hdr_size + 2] = 0x00;
+    data[hdr_size + 3] = 0x01; // length in 32-bit words
+    data[hdr_size + 4] = (self->twcc.ext_id << 4) | 0x01; // ID and L = (2 bytes - 1)
+    data[hdr_size + 5] = seq_num >> 8;
+    data[hdr_size + 6] = (seq_num & 0xFF);
+    data[hdr_size + 7] = 0x00; // padding
+    return (size + TRTP_TWCC_EXT_SIZE);
+}
+
+static void _trtp_manager_twcc_send_feedback(trtp_manager_t* self, uint64_t now)
+{
+    if (self->twcc.recv.count && self->rtcp.session) {
+        trtp_rtcp_session_signal_twcc(self->rtcp.session, self->rtp.ssrc.remote, self->twcc.recv.base_seq, self->twcc.recv.arrival_times_us, self->twcc.recv.count);
+    }
+    self->twcc.recv.base_seq += (uint16_t)self->twcc.recv.count;
+    self->twcc.recv.count = 0;
+    self->twcc.recv.fb_time = now;
+}
+
+// Called on the network thread: records the arrival time then sends the feedback every TRTP_TWCC_FEEDBACK_INTERVAL milliseconds
+static void _trtp_manager_twcc_on_rtp(trtp_manager_t* self, const struct trtp_rtp_packet_s* packet)
+{
+    const uint8_t* ext = (const uint8_t*)packet->extension.data;
+    tsk_size_t i, len, index;
+    uint64_t now;
+    int16_t diff;
+    uint16_t seq_num;
+
+    // RFC 5285 one-byte header
+    if (!ext || packet->extension.size < 4 || ext[0] != 0xBE || ext[1] != 0xDE) {
+        return;
+    }
+    for (i = 4; i < packet->extension.size; i += (1 + len)) {
+        if (!ext[i]) {
+            len = 0; // padding
+            continue;
+        }
+        len = (ext[i] & 0x0F) + 1;
+        if ((ext[i] >> 4) == 0x0F || (i + 1 + len) > packet->extension.size) {
+            return;
+        }
+        if ((ext[i] >> 4) == self->twcc.ext_id && len == 2) {
+            break;
+        }
+    }
+    if (i >= packet->extension.size) {
+        return;
+    }
+    seq_num = tnet_ntohs_2(&ext[i + 1]);
+    now = tsk_time_now(); // the clock resolution is 1ms, the deltas are multiples of 4 x 250us
+
+    if (!self->twcc.recv.started) {
+        self->twcc.recv.started = tsk_true;
+        self->twcc.recv.base_seq = seq_num;
+        self->twcc.recv.count = 0;
+        self->twcc.recv.fb_time = now;
+    }
+    if ((diff = (int16_t)(seq_num - self->twcc.recv.base_seq)) < 0) {
+        return; // already reported as lost
+    }
+    if ((tsk_size_t)diff >= TRTP_TWCC_FEEDBACK_MAX_COUNT) {
+        _trtp_manager_twcc_send_feedback(self, now);
+        if ((diff = (int16_t)(seq_num - self->twcc.recv.base_seq)) < 0 || (tsk_size_t)diff >= TRTP_TWCC_FEEDBACK_MAX_COUNT) {
+            self->twcc.recv.base_seq = seq_num; // too many packets lost
+            diff = 0;
+        }
+    }
+    for (index = self->twcc.recv.count; index < (tsk_size_t)diff; ++index) {
+        self->twcc.recv.arrival_times_us[index] = -1;
+    }
+    self->twcc.recv.arrival_times_us[diff] = (int64_t)now * 1000;
+    self->twcc.recv.count = TSK_MAX(self->twcc.recv.count, (tsk_size_t)(diff + 1));
+
+    if ((now - self->twcc.recv.fb_time) >= TRTP_TWCC_FEEDBACK_INTERVAL) {
+        _trtp_manager_twcc_send_feedback(self, now);
+    }
+}
+
+// Called with the pacer locked, on the pacing thread or within "trtp_manager_send_rtp_packet_2()": must not lock the manager
+static int _trtp_manager_pacer_send_cb(const void* usrdata, const void* data, tsk_size_t size, int32_t tag)
+{
+    trtp_manager_t* self = (trtp_manager_t*)usrdata;
+    tsk_size_t sent;
+
+    if (!self->transport || !self->transport->master) {
+        return -1;
+    }
+    if (self->is_ice_turn_active) {
+        sent = (tnet_ice_ctx_send_turn_rtp(self->ice_ctx, data, size) == 0) ? size : 0;
+    }
+    else {
+        sent = tnet_transport_sendto(self->transport, self->transport->master->fd, (const struct sockaddr *)&self->rtp.remote_addr, data, size);
+    }
+    if (sent > 0 && tag >= 0 && self->twcc.bwe) {
+        trtp_bwe_on_packet_sent(self->twcc.bwe, (uint16_t)tag, size, (int64_t)tsk_time_now() * 1000);
+    }
+    return (sent > 0) ? 0 : -2;
+}
+
+// the send-side bandwidth estimate when available, otherwise the maximum upload bandwidth defined by the application (no pacing if not defined)
+static void _trtp_manager_pacer_update_target(trtp_manager_t* self)
+{
+    int32_t target_kbps;
+    if (!self->rtp.pacer) {
+        return;
+    }
+    if (trtp_manager_get_bwe_target_kbps(self, &target_kbps) != 0) {
+        target_kbps = (self->app_bw_max_upload > 0 && self->app_bw_max_upload != INT_MAX) ? self->app_bw_max_upload : 0;
+    }
+    trtp_pacer_set_target_kbps(self->rtp.pacer, target_kbps);
+}
+
+/** Enables or disables the pacing of the outgoing RTP packets (see "trtp_pacer.h").
+* The target bitrate is the send-side bandwidth estimate (see @ref trtp_manager_set_twcc_ext_id()) or the maximum upload bandwidth (see @ref trtp_manager_set_app_bw_and_jcng()).
+*/
+int trtp_manager_set_pacing(trtp_manager_t* self, tsk_bool_t enabled)
+{
+    int ret = 0;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    if (enabled && !self->rtp.pacer) {
+        if (!(self->rtp.pacer = trtp_pacer_create(_trtp_manager_pacer_send_cb, self))) {
+            TSK_DEBUG_ERROR("Failed to create pacer");
+            ret = -2;
+            goto bail;
+        }
+        if (self->is_started) {
+            _trtp_manager_pacer_update_target(self);
+            ret = trtp_pacer_start(self->rtp.pacer);
+        }
+    }
+    else if (!enabled && self->rtp.pacer) {
+        trtp_pacer_stop(self->rtp.pacer);
+        TSK_OBJECT_SAFE_FREE(self->rtp.pacer);
+    }
+bail:
+    tsk_safeobj_unlock(self);
+    return ret;
+}
+
+int trtp_manager_get_pacer_stats(trtp_manager_t* self, trtp_pacer_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!self->rtp.pacer) {
+        return -2;
+    }
+    return trtp_pacer_get_stats(self->rtp.pacer, stats);
+}
+
+// whether the RTP/RTCP sockets could be read by the shared media reactor instead of the transport's threads (see "tmedia_defaults_set_media_reactor_threads()")
+static tsk_bool_t _trtp_manager_reactor_is_eligible(const trtp_manager_t* self)
+{
+#if TNET_REACTOR_SUPPORTED
+    if (tmedia_defaults_get_media_reactor_threads() == 0 || self->is_ice_turn_active || !TNET_SOCKET_TYPE_IS_DGRAM(self->transport->master->type)) {
+        return tsk_false;
+    }
+#if HAVE_SRTP
+    if ((self->srtp_type & tmedia_srtp_type_dtls) == tmedia_srtp_type_dtls) {
+        return tsk_false; // DTLS records are handled by the transport
+    }
+#endif /* HAVE_SRTP */
+    return tsk_true;
+#else
+    return tsk_false;
+#endif /* TNET_REACTOR_SUPPORTED */
+}
+
+// Called on the reactor's thread, with the shard locked: must be detached without holding the manager's lock (see "trtp_manager_stop()")
+static int _trtp_manager_reactor_cb(const void* usrdata, tnet_fd_t local_fd, const void* data, tsk_size_t size, const struct sockaddr_storage* remote_addr)
+{
+    const trtp_manager_t* self = (const trtp_manager_t*)usrdata;
+    if (self->transport) {
+        self->transport->bytes_in += size; // as if received by the transport
+    }
+    return _trtp_manager_recv_data(self, (const uint8_t*)data, size, local_fd, remote_addr);
+}
+
+/** Enables the transport-wide congestion control: the transport-wide sequence numbers are added to the outgoing RTP packets, the arrival times of
+* the incoming ones are reported to the peer and the feedback from the peer drives the send-side bandwidth estimator (see @ref trtp_manager_get_bwe_target_kbps()).
+* @param ext_id The RTP header extension id negotiated using "a=extmap" (within [1, 14]) or zero to disable.
+*/
+int trtp_manager_set_twcc_ext_id(trtp_manager_t* self, uint8_t ext_id)
+{
+    int32_t max_kbps;
+    if (!self || ext_id > 14) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_safeobj_lock(self);
+    if (ext_id && !self->twcc.bwe) {
+        max_kbps = (self->app_bw_max_upload > 0) ? self->app_bw_max_upload : INT_MAX;
+        if (!(self->twcc.bwe = trtp_bwe_create(TSK_MIN(TRTP_BWE_START_KBPS, max_kbps), TSK_MIN(TRTP_BWE_MIN_KBPS, max_kbps), max_kbps))) {
+            TSK_DEBUG_ERROR("Failed to create bandwidth estimator");
+            tsk_safeobj_unlock(self);
+            return -2;
+        }
+    }
+    self->twcc.ext_id = ext_id;
+    tsk_safeobj_unlock(self);
+    return 0;
+}
+
+/** Gets the bitrate the video encoder should produce according to the send-side bandwidth estimator.
+* @retval Zero if succeed and non-zero error code otherwise (e.g. transport-wide congestion control not negotiated or no feedback received yet).
+*/
+int trtp_manager_get_bwe_target_kbps(trtp_manager_t* self, int32_t* target_kbps)
+{
+    trtp_bwe_stats_t stats;
+    if (!self || !target_kbps) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!self->twcc.ext_id || !self->twcc.bwe || trtp_bwe_get_stats(self->twcc.bwe, &stats) != 0 || !stats.feedbacks) {
+        return -2;
+    }
+    *target_kbps = stats.target_kbps;
+    return 0;
+}
+
+int trtp_manager_get_bwe_stats(trtp_manager_t* self, trtp_bwe_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!self->twcc.bwe) {
+        return -2;
+    }
+    return trtp_bwe_get_stats(self->twcc.bwe, stats);
+}
+
 int trtp_manager_set_app_bw_and_jcng(trtp_manager_t* self, int32_t bw_upload_kbps, int32_t bw_download_kbps, float q_jcng)
 {
     if(self) {
         self->app_bw_max_upload = bw_upload_kbps;
         self->app_bw_max_download = bw_download_kbps;
         self->app_jitter_cng = q_jcng;
+        if (self->twcc.bwe && bw_upload_kbps > 0) {
+            trtp_bwe_set_bounds(self->twcc.bwe, TSK_MIN(TRTP_BWE_MIN_KBPS, bw_upload_kbps), bw_upload_kbps);
+        }
+        _trtp_manager_pacer_update_target(self);
         if(self->rtcp.session) {
             return trtp_rtcp_session_set_app_bw_and_jcng(self->rtcp.session, bw_upload_kbps, bw_download_kbps, q_jcng);
         }
@@ -1777,6 +2292,127 @@ int trtp_manager_signal_jb_error(trtp_manager_t* self, uint32_t ssrc_media)
     return -1;
 }
 
+/** Relays the RTP packets received by @a self to @a output (selective forwarding) instead of decoding and re-encoding them.
+* The packets are decrypted once then each output sends its own copy with the SSRC, sequence number and timestamp it uses, encrypted with its own SRTP context.
+* The RTCP-NACK, RTCP-PLI/FIR and RTCP-REMB received by the outputs are aggregated and relayed to the peer of @a self.
+* The packets are still passed to the RTP callback of @a self, if any.
+* @param self The source.
+* @param output The manager sending the packets. An output can only be fed by a single source.
+* @retval Zero if succeed and non-zero error code otherwise.
+*/
+int trtp_manager_forward_add(trtp_manager_t* self, trtp_manager_t* output)
+{
+    trtp_forward_link_t* link;
+    int ret = 0;
+
+    if (!self || !output || self == output) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_list_lock(self->forward.links);
+    tsk_safeobj_lock(output);
+    if (output->forward.link) {
+        TSK_DEBUG_ERROR("RTP manager already used as forwarding output");
+        ret = -2;
+        goto bail;
+    }
+    if (!(link = trtp_forward_link_create(self, output))) {
+        TSK_DEBUG_ERROR("Failed to create forwarding link");
+        ret = -3;
+        goto bail;
+    }
+    output->forward.link = link;
+    tsk_list_push_back_data(self->forward.links, (void**)&link);
+
+bail:
+    tsk_safeobj_unlock(output);
+    tsk_list_unlock(self->forward.links);
+    return ret;
+}
+
+static int _trtp_manager_forward_pred_find_by_output(const tsk_list_item_t *item, const void *output)
+{
+    return (item && item->data && ((const trtp_forward_link_t*)item->data)->output == output) ? 0 : -1;
+}
+
+/** Maps the payload type of the packets received by @a self to the one negotiated by @a output. Use @ref TRTP_FORWARD_PT_DROP as @a pt_out to stop forwarding @a pt_in. */
+int trtp_manager_forward_set_payload_type(trtp_manager_t* self, trtp_manager_t* output, uint8_t pt_in, uint8_t pt_out)
+{
+    const tsk_list_item_t* item;
+    int ret;
+
+    if (!self || !output) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_list_lock(self->forward.links);
+    if ((item = tsk_list_find_item_by_pred(self->forward.links, _trtp_manager_forward_pred_find_by_output, output))) {
+        ret = trtp_forward_link_set_payload_type((trtp_forward_link_t*)item->data, pt_in, pt_out);
+    }
+    else {
+        TSK_DEBUG_ERROR("Not a forwarding output");
+        ret = -2;
+    }
+    tsk_list_unlock(self->forward.links);
+    return ret;
+}
+
+int trtp_manager_forward_get_stats(trtp_manager_t* self, trtp_manager_t* output, trtp_forward_stats_t* stats)
+{
+    const tsk_list_item_t* item;
+    int ret = 0;
+
+    if (!self || !output || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_list_lock(self->forward.links);
+    if ((item = tsk_list_find_item_by_pred(self->forward.links, _trtp_manager_forward_pred_find_by_output, output))) {
+        *stats = ((const trtp_forward_link_t*)item->data)->stats;
+    }
+    else {
+        ret = -2;
+    }
+    tsk_list_unlock(self->forward.links);
+    return ret;
+}
+
+// must be called with the links locked
+static void _trtp_manager_forward_unlink(trtp_manager_t* self, trtp_forward_link_t* link)
+{
+    tsk_safeobj_lock(link->output);
+    link->output->forward.link = tsk_null;
+    tsk_safeobj_unlock(link->output);
+    link->source = tsk_null;
+    self->forward.remb_changed = tsk_true; // the removed output could be the slowest one
+}
+
+/** Stops relaying the RTP packets received by @a self to @a output. */
+int trtp_manager_forward_remove(trtp_manager_t* self, trtp_manager_t* output)
+{
+    tsk_list_item_t* item;
+    int ret = 0;
+
+    if (!self || !output) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_list_lock(self->forward.links);
+    if ((item = tsk_list_pop_item_by_pred(self->forward.links, _trtp_manager_forward_pred_find_by_output, output))) {
+        _trtp_manager_forward_unlink(self, (trtp_forward_link_t*)item->data);
+        TSK_OBJECT_SAFE_FREE(item);
+    }
+    else {
+        ret = -2;
+    }
+    tsk_list_unlock(self->forward.links);
+    return ret;
+}
+
 /** Stops the RTP/RTCP manager */
 int trtp_manager_stop(trtp_manager_t* self)
 {
@@ -1789,6 +2425,16 @@ int trtp_manager_stop(trtp_manager_t* self)
 
     TSK_DEBUG_INFO("trtp_manager_stop()");
 
+    // Wait for the media worker to be done with the callback (must not hold the lock: the callback could use the manager)
+    if (self->rtp.worker_queue) {
+        trtp_worker_queue_detach(self->rtp.worker_queue);
+    }
+    // Same for the media reactor, before the sockets are closed
+    if (self->rtp.reactor.count) {
+        tnet_reactor_detach(self->rtp.reactor.fds, self->rtp.reactor.count);
+        self->rtp.reactor.count = 0;
+    }
+
     tsk_safeobj_lock(self);
 
     // We haven't started the ICE context which means we must not stop it
@@ -1810,6 +2456,13 @@ int trtp_manager_stop(trtp_manager_t* self)
         ret = trtp_rtcp_session_set_net_transport(self->rtcp.session, tsk_null);
     }
 
+    // Drop the queued packets
+    self->rtp.send_batch.count = self->rtp.send_batch.index = 0;
+    self->rtp.send_batch.started = tsk_false;
+    if (self->rtp.pacer) {
+        trtp_pacer_stop(self->rtp.pacer); // no more packets sent by the pacing thread when it returns
+    }
+
     // Free transport to force next call to start() to create new one with new sockets
     if (self->transport) {
         tnet_socket_t *master_copy = tsk_object_ref(self->transport->master); // "tnet_transport_shutdown" will free the master
@@ -1832,6 +2485,11 @@ int trtp_manager_stop(trtp_manager_t* self)
     }
     // Free RTCP info to make sure these values will be updated in next start()
     TSK_OBJECT_SAFE_FREE(self->rtcp.local_socket);
+    // Sockets closed: the ports could be used by other sessions
+    if (self->port_range.acquired) {
+        trtp_ports_release(self->port_range.acquired);
+        self->port_range.acquired = 0;
+    }
     TSK_OBJECT_SAFE_FREE(self->rtcp.session);
     self->rtcp.public_addr.port = self->rtcp.remote_port = 0;
     TSK_FREE(self->rtcp.public_addr.ip);
@@ -1867,6 +2525,10 @@ static tsk_object_t* trtp_manager_ctor(tsk_object_t * self, va_list * app)
         manager->app_bw_max_download = INT_MAX; // INT_MAX or <=0 means undefined
         manager->app_jitter_cng = 1.f; // Within [0, 1], in quality metric unit: 1 is best, 0 worst
 
+        // one packet and one header per RTP datagram: recycle their memory (no-op if already enabled)
+        tsk_object_cache_enable(trtp_rtp_packet_def_t, "trtp_rtp_packet_t", 0);
+        tsk_object_cache_enable(trtp_rtp_header_def_t, "trtp_rtp_header_t", 0);
+
         /* srtp */
 #if HAVE_SRTP
         manager->srtp_type = tmedia_defaults_get_srtp_type();
@@ -1893,6 +2555,10 @@ static tsk_object_t* trtp_manager_ctor(tsk_object_t * self, va_list * app)
         /* timer */
         manager->timer_mgr_global = tsk_timer_mgr_global_ref();
 
+        /* forwarding */
+        manager->forward.links = tsk_list_create();
+        manager->forward.remb_kbps = INT_MAX;
+
         tsk_safeobj_init(manager);
     }
     return self;
@@ -1902,6 +2568,23 @@ static tsk_object_t* trtp_manager_dtor(tsk_object_t * self)
 {
     trtp_manager_t *manager = self;
     if(manager) {
+        /* forwarding: release the outputs */
+        if (manager->forward.links) {
+            tsk_list_item_t* item;
+            tsk_list_lock(manager->forward.links);
+            while ((item = tsk_list_pop_first_item(manager->forward.links))) {
+                _trtp_manager_forward_unlink(manager, (trtp_forward_link_t*)item->data);
+                TSK_OBJECT_SAFE_FREE(item);
+            }
+            tsk_list_unlock(manager->forward.links);
+            TSK_OBJECT_SAFE_FREE(manager->forward.links);
+        }
+        if (manager->rtp.pacer) {
+            trtp_pacer_stop(manager->rtp.pacer); // could send packets (and use the estimator) until stopped
+            TSK_OBJECT_SAFE_FREE(manager->rtp.pacer);
+        }
+        TSK_OBJECT_SAFE_FREE(manager->twcc.bwe);
+
         /* callbacks */
         if (manager->ice_ctx) {
             tnet_ice_ctx_rtp_callback(manager->ice_ctx, tsk_null, tsk_null);
@@ -1911,6 +2594,10 @@ static tsk_object_t* trtp_manager_dtor(tsk_object_t * self)
         }
 
         /* stop */
+        if (manager->rtp.reactor.count) {
+            tnet_reactor_detach(manager->rtp.reactor.fds, manager->rtp.reactor.count);
+            manager->rtp.reactor.count = 0;
+        }
         if (manager->is_started) {
             trtp_manager_stop(manager);
         }
@@ -1923,6 +2610,11 @@ static tsk_object_t* trtp_manager_dtor(tsk_object_t * self)
         TSK_FREE(manager->rtp.remote_ip);
         TSK_FREE(manager->rtp.public_addr.ip);
         TSK_FREE(manager->rtp.serial_buffer.ptr);
+        TSK_FREE(manager->rtp.send_batch.ptr);
+        if (manager->rtp.worker_queue) {
+            trtp_worker_queue_detach(manager->rtp.worker_queue);
+            TSK_OBJECT_SAFE_FREE(manager->rtp.worker_queue);
+        }
 
         /* rtcp */
         TSK_OBJECT_SAFE_FREE(manager->rtcp.session);
@@ -1930,6 +2622,9 @@ static tsk_object_t* trtp_manager_dtor(tsk_object_t * self)
         TSK_FREE(manager->rtcp.public_addr.ip);
         TSK_FREE(manager->rtcp.cname);
         TSK_OBJECT_SAFE_FREE(manager->rtcp.local_socket);
+        if (manager->port_range.acquired) { // prepared but not started
+            trtp_ports_release(manager->port_range.acquired);
+        }
 
         /* SRTP */
 #if HAVE_SRTP
@@ -1943,7 +2638,7 @@ static tsk_object_t* trtp_manager_dtor(tsk_object_t * self)
                 manager->dtls.timer_hanshaking.id = TSK_INVALID_TIMER_ID;
             }
 
-            for(i = 0; i < 2; ++i) {
+            for(i = 0; i < SRTP_CRYPTO_TYPES_MAX; ++i) {
                 trtp_srtp_ctx_deinit(&manager->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][i]);
                 trtp_srtp_ctx_deinit(&manager->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][i]);
             }
@@ -0,0 +1,545 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_pacer.c
+ * @brief Leaky-bucket RTP pacer.
+ *
+ * The budget (bytes allowed to be sent now) grows at the pacing rate and every packet sent consumes its size.
+ * When the budget is exhausted the packets are copied into the session's queue and the pacing thread sends them as soon as the budget allows it.
+ */
+#include "tinyrtp/trtp_pacer.h"
+
+#include "tsk_thread.h"
+#include "tsk_semaphore.h"
+#include "tsk_mutex.h"
+#include "tsk_list.h"
+#include "tsk_memory.h"
+#include "tsk_time.h"
+#include "tsk_debug.h"
+
+#include <string.h> /* memcpy() */
+
+#define TRTP_PACER_QUEUE_MASK (TRTP_PACER_QUEUE_CAPACITY - 1)
+#define TRTP_PACER_RING_IS_EMPTY(ring) ((ring)->head == (ring)->tail)
+#define TRTP_PACER_RING_RTX		0
+#define TRTP_PACER_RING_MEDIA	1
+
+typedef struct trtp_pacer_cell_s {
+    uint8_t* data; // reused by the next packets
+    tsk_size_t size;
+    tsk_size_t capacity;
+    int32_t tag;
+    uint64_t time; // when queued
+}
+trtp_pacer_cell_t;
+
+typedef struct trtp_pacer_ring_s {
+    trtp_pacer_cell_t cells[TRTP_PACER_QUEUE_CAPACITY];
+    tsk_size_t head; // next slot to fill
+    tsk_size_t tail; // next slot to send
+}
+trtp_pacer_ring_t;
+
+typedef struct trtp_pacer_thread_s {
+    TSK_DECLARE_OBJECT;
+
+    tsk_thread_handle_t* h_thread;
+    tsk_semaphore_handle_t* semaphore;
+    tsk_mutex_handle_t* mutex; // protects "pacers" and held while the queued packets are sent
+    tsk_list_t* pacers; // started "trtp_pacer_t" objects
+    tsk_bool_t running;
+    volatile uintptr_t sleeping; // whether the thread is (about to be) blocked on "semaphore"
+}
+trtp_pacer_thread_t;
+static const tsk_object_def_t *trtp_pacer_thread_def_t;
+
+typedef struct trtp_pacer_s {
+    TSK_DECLARE_OBJECT;
+
+    trtp_pacer_send_cb_f fun;
+    const void* usrdata;
+    trtp_pacer_thread_t* thread; // set when started
+
+    int32_t target_kbps;
+    int32_t rate_kbps;
+    double budget; // negative after sending a packet larger than the remaining budget
+    uint64_t budget_time;
+
+    trtp_pacer_ring_t rings[2]; // retransmissions then media
+    tsk_size_t queue_bytes;
+
+    struct {
+        uint64_t pkts_sent;
+        uint64_t pkts_delayed;
+        uint64_t pkts_audio;
+        uint64_t pkts_retransmitted;
+        uint64_t pkts_overflow;
+        uint64_t delay_sum;
+        uint64_t delay_count;
+        uint64_t delay_max;
+    } stats;
+
+    tsk_mutex_handle_t* mutex; // held while sending
+}
+trtp_pacer_t;
+static const tsk_object_def_t *trtp_pacer_def_t;
+
+// The pacing thread is created on demand and lives until the process exits
+static trtp_pacer_thread_t* __trtp_pacer_thread = tsk_null;
+static tsk_mutex_handle_t* volatile __trtp_pacer_thread_mutex = tsk_null;
+
+static void* TSK_STDCALL _trtp_pacer_thread_run(void* arg);
+
+static trtp_pacer_thread_t* _trtp_pacer_thread_get()
+{
+    trtp_pacer_thread_t* thread;
+    tsk_mutex_lock(tsk_mutex_get_once(&__trtp_pacer_thread_mutex));
+    if (!__trtp_pacer_thread && (__trtp_pacer_thread = tsk_object_new(trtp_pacer_thread_def_t))) {
+        __trtp_pacer_thread->running = tsk_true;
+        if (!__trtp_pacer_thread->semaphore || !__trtp_pacer_thread->mutex || !__trtp_pacer_thread->pacers || tsk_thread_create(&__trtp_pacer_thread->h_thread, _trtp_pacer_thread_run, __trtp_pacer_thread) != 0) {
+            TSK_DEBUG_ERROR("Failed to start the pacing thread");
+            __trtp_pacer_thread->running = tsk_false;
+            TSK_OBJECT_SAFE_FREE(__trtp_pacer_thread);
+        }
+        else {
+            tsk_thread_set_priority(__trtp_pacer_thread->h_thread, TSK_THREAD_PRIORITY_TIME_CRITICAL);
+        }
+    }
+    thread = tsk_object_ref(__trtp_pacer_thread);
+    tsk_mutex_unlock(__trtp_pacer_thread_mutex);
+    return thread;
+}
+
+static void _trtp_pacer_thread_signal(trtp_pacer_thread_t* self)
+{
+    tsk_atomic_barrier(); // publish the queue before checking "sleeping"
+    if (self->sleeping && tsk_atomic_cas(&self->sleeping, 1, 0)) {
+        tsk_semaphore_increment(self->semaphore);
+    }
+}
+
+static tsk_bool_t _trtp_pacer_thread_is_empty(trtp_pacer_thread_t* self)
+{
+    const tsk_list_item_t* item;
+    const trtp_pacer_t* pacer;
+    tsk_bool_t empty = tsk_true;
+    tsk_mutex_lock(self->mutex);
+    tsk_list_foreach(item, self->pacers) {
+        pacer = (const trtp_pacer_t*)item->data;
+        tsk_mutex_lock(pacer->mutex);
+        empty = (pacer->queue_bytes == 0);
+        tsk_mutex_unlock(pacer->mutex);
+        if (!empty) {
+            break;
+        }
+    }
+    tsk_mutex_unlock(self->mutex);
+    return empty;
+}
+
+// Same logic as "tsk_runnable_wait()": the thread only wakes up periodically while packets are queued
+static void _trtp_pacer_thread_wait(trtp_pacer_thread_t* self)
+{
+    while (self->running && _trtp_pacer_thread_is_empty(self)) {
+        self->sleeping = 1;
+        tsk_atomic_barrier(); // publish "sleeping" before checking the queues again
+        if (!self->running || !_trtp_pacer_thread_is_empty(self)) {
+            if (!tsk_atomic_cas(&self->sleeping, 1, 0)) {
+                // a pacer already took the flag: consume its signal to keep the semaphore balanced
+                tsk_semaphore_decrement(self->semaphore);
+            }
+            break;
+        }
+        tsk_semaphore_decrement(self->semaphore);
+    }
+}
+
+// must be called with the pacer locked
+static void _trtp_pacer_update(trtp_pacer_t* self, uint64_t now)
+{
+    int32_t rate_kbps = (int32_t)(self->target_kbps * TRTP_PACER_FACTOR);
+    uint64_t elapsed = (now > self->budget_time) ? (now - self->budget_time) : 0;
+    // the packets must not wait longer than TRTP_PACER_QUEUE_MAX_DELAY (e.g. key frame followed by a lower target): drain faster
+    if (self->queue_bytes) {
+        rate_kbps = TSK_MAX(rate_kbps, (int32_t)((self->queue_bytes << 3) / TRTP_PACER_QUEUE_MAX_DELAY));
+    }
+    // 1kbps = 1/8 bytes per ms. Never more than two intervals in advance to avoid bursts after idle periods.
+    self->budget = TSK_MIN(self->budget + ((rate_kbps * (double)elapsed) / 8.0), (rate_kbps * (double)(TRTP_PACER_INTERVAL << 1)) / 8.0);
+    self->budget_time = now;
+    self->rate_kbps = rate_kbps;
+}
+
+// must be called with the pacer locked
+static int _trtp_pacer_send(trtp_pacer_t* self, const void* data, tsk_size_t size, int32_t tag)
+{
+    self->budget -= (double)size;
+    ++self->stats.pkts_sent;
+    return self->fun(self->usrdata, data, size, tag);
+}
+
+// must be called with the pacer locked
+static void _trtp_pacer_stats_delay(trtp_pacer_t* self, uint64_t delay)
+{
+    self->stats.delay_sum += delay;
+    ++self->stats.delay_count;
+    self->stats.delay_max = TSK_MAX(self->stats.delay_max, delay);
+}
+
+// must be called with the pacer locked: sends the queued packets allowed by the budget
+static void _trtp_pacer_process(trtp_pacer_t* self, uint64_t now)
+{
+    trtp_pacer_ring_t* ring;
+    trtp_pacer_cell_t* cell;
+    int i;
+
+    _trtp_pacer_update(self, now);
+    for (i = TRTP_PACER_RING_RTX; i <= TRTP_PACER_RING_MEDIA && self->budget > 0; ++i) {
+        ring = &self->rings[i];
+        while (self->budget > 0 && !TRTP_PACER_RING_IS_EMPTY(ring)) {
+            cell = &ring->cells[ring->tail & TRTP_PACER_QUEUE_MASK];
+            _trtp_pacer_send(self, cell->data, cell->size, cell->tag);
+            _trtp_pacer_stats_delay(self, (now > cell->time) ? (now - cell->time) : 0);
+            ++self->stats.pkts_delayed;
+            self->queue_bytes -= cell->size;
+            ++ring->tail;
+        }
+    }
+}
+
+static void* TSK_STDCALL _trtp_pacer_thread_run(void* arg)
+{
+    trtp_pacer_thread_t* self = (trtp_pacer_thread_t*)arg;
+    tsk_list_item_t* item;
+    trtp_pacer_t* pacer;
+    uint64_t now;
+
+    TSK_DEBUG_INFO("Pacing thread - ENTER");
+
+    while (self->running) {
+        _trtp_pacer_thread_wait(self);
+        if (!self->running) {
+            break;
+        }
+        now = tsk_time_now();
+        tsk_mutex_lock(self->mutex);
+        tsk_list_foreach(item, self->pacers) {
+            pacer = (trtp_pacer_t*)item->data;
+            tsk_mutex_lock(pacer->mutex);
+            _trtp_pacer_process(pacer, now);
+            tsk_mutex_unlock(pacer->mutex);
+        }
+        tsk_mutex_unlock(self->mutex);
+        tsk_thread_sleep(TRTP_PACER_INTERVAL);
+    }
+
+    TSK_DEBUG_INFO("Pacing thread - EXIT");
+    return tsk_null;
+}
+
+/**@ingroup trtp_pacer_group
+* Creates a pacer. Pacing is disabled (the packets are sent as they come) until a target bitrate is defined and the pacer started.
+* @param fun The function used to send the packets, called with the pacer locked. Must not lock the object pushing the packets (e.g. the RTP manager).
+* @param usrdata Opaque data to forward to @a fun.
+*/
+struct trtp_pacer_s* trtp_pacer_create(trtp_pacer_send_cb_f fun, const void* usrdata)
+{
+    trtp_pacer_t* pacer;
+    if (!fun) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if ((pacer = tsk_object_new(trtp_pacer_def_t))) {
+        if (!pacer->mutex) {
+            TSK_DEBUG_ERROR("Failed to create mutex");
+            TSK_OBJECT_SAFE_FREE(pacer);
+            return tsk_null;
+        }
+        pacer->fun = fun;
+        pacer->usrdata = usrdata;
+    }
+    return pacer;
+}
+
+/**@ingroup trtp_pacer_group
+* Sets the bitrate produced by the encoder. The queue is drained at TRTP_PACER_FACTOR times this value.
+* @param target_kbps The new bitrate. Zero or negative to disable pacing.
+*/
+int trtp_pacer_set_target_kbps(struct trtp_pacer_s* self, int32_t target_kbps)
+{
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_mutex_lock(self->mutex);
+    self->target_kbps = TSK_MAX(target_kbps, 0);
+    tsk_mutex_unlock(self->mutex);
+    return 0;
+}
+
+/**@ingroup trtp_pacer_group
+* Attaches the pacer to the pacing thread.
+*/
+int trtp_pacer_start(struct trtp_pacer_s* self)
+{
+    trtp_pacer_thread_t* thread;
+    trtp_pacer_t* pacer;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (self->thread) {
+        return 0;
+    }
+    if (!(thread = _trtp_pacer_thread_get())) {
+        return -2;
+    }
+    tsk_mutex_lock(thread->mutex);
+    tsk_mutex_lock(self->mutex);
+    self->thread = thread; // the pacer holds a reference while started
+    self->budget = 0.0;
+    self->budget_time = tsk_time_now();
+    memset(&self->stats, 0, sizeof(self->stats));
+    tsk_mutex_unlock(self->mutex);
+    pacer = (trtp_pacer_t*)tsk_object_ref(self); // the thread holds a reference while started
+    tsk_list_push_back_data(thread->pacers, (void**)&pacer);
+    tsk_mutex_unlock(thread->mutex);
+
+    return 0;
+}
+
+/**@ingroup trtp_pacer_group
+* Sends or queues a packet.
+* @param data The packet (serialized and encrypted). Copied when queued.
+* @param priority Audio packets are sent immediately. Retransmissions are sent before the queued media.
+* @param tag Opaque value forwarded to the send callback (e.g. transport-wide sequence number).
+* @retval Zero if the packet is sent or queued, non-zero error code otherwise.
+*/
+int trtp_pacer_push(struct trtp_pacer_s* self, const void* data, tsk_size_t size, trtp_pacer_priority_t priority, int32_t tag)
+{
+    trtp_pacer_ring_t *ring, *ring_rtx;
+    trtp_pacer_cell_t* cell;
+    trtp_pacer_thread_t* thread = tsk_null; // set when the packet is queued
+    uint64_t now;
+    int ret;
+
+    if (!self || !data || !size) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_mutex_lock(self->mutex);
+    now = tsk_time_now();
+    _trtp_pacer_update(self, now);
+
+    if (priority == trtp_pacer_priority_audio) {
+        ++self->stats.pkts_audio;
+        ret = _trtp_pacer_send(self, data, size, tag);
+        goto bail;
+    }
+
+    ring_rtx = &self->rings[TRTP_PACER_RING_RTX];
+    if (priority == trtp_pacer_priority_retransmission) {
+        ++self->stats.pkts_retransmitted;
+        ring = ring_rtx;
+    }
+    else {
+        ring = &self->rings[TRTP_PACER_RING_MEDIA];
+    }
+    // right away if not paced or if the budget allows it and nothing with the same priority (or higher) is waiting
+    if (!self->thread || self->target_kbps <= 0 || (self->budget > 0 && TRTP_PACER_RING_IS_EMPTY(ring) && TRTP_PACER_RING_IS_EMPTY(ring_rtx))) {
+        _trtp_pacer_stats_delay(self, 0);
+        ret = _trtp_pacer_send(self, data, size, tag);
+        goto bail;
+    }
+    cell = &ring->cells[ring->head & TRTP_PACER_QUEUE_MASK];
+    if ((ring->head - ring->tail) < TRTP_PACER_QUEUE_CAPACITY && cell->capacity < size) {
+        cell->capacity = (cell->data = tsk_realloc(cell->data, size)) ? size : 0;
+    }
+    if ((ring->head - ring->tail) >= TRTP_PACER_QUEUE_CAPACITY || !cell->data) {
+        // better late than never
+        if ((self->stats.pkts_overflow++ & 0xFF) == 0) {
+            TSK_DEBUG_WARN("Pacer queue full: %llu packets sent without pacing so far", self->stats.pkts_overflow);
+        }
+        _trtp_pacer_stats_delay(self, 0);
+        ret = _trtp_pacer_send(self, data, size, tag);
+        goto bail;
+    }
+    memcpy(cell->data, data, size);
+    cell->size = size;
+    cell->tag = tag;
+    cell->time = now;
+    ++ring->head;
+    self->queue_bytes += size;
+    thread = self->thread; // lives until the process exits
+    ret = 0;
+
+bail:
+    tsk_mutex_unlock(self->mutex);
+    if (thread) {
+        _trtp_pacer_thread_signal(thread);
+    }
+    return ret;
+}
+
+/**@ingroup trtp_pacer_group
+* Detaches the pacer from the pacing thread and drops the queued packets.
+* When this function returns the send callback is not running and will not be called again by the pacing thread.
+*/
+int trtp_pacer_stop(struct trtp_pacer_s* self)
+{
+    trtp_pacer_thread_t* thread;
+    trtp_pacer_stats_t stats;
+    int i;
+
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!(thread = self->thread)) {
+        return 0;
+    }
+    if (trtp_pacer_get_stats(self, &stats) == 0) {
+        TSK_DEBUG_INFO("Pacer: target=%dkbps, sent=%llu, delayed=%llu, audio=%llu, retransmitted=%llu, overflow=%llu, queued=%u, delay_avg=%llums, delay_max=%llums",
+                       stats.target_kbps, stats.pkts_sent, stats.pkts_delayed, stats.pkts_audio, stats.pkts_retransmitted, stats.pkts_overflow, (unsigned)stats.queue_pkts, stats.delay_avg, stats.delay_max);
+    }
+
+    tsk_mutex_lock(thread->mutex); // wait for the pacing thread to be done with the packets
+    tsk_mutex_lock(self->mutex);
+    self->thread = tsk_null;
+    for (i = TRTP_PACER_RING_RTX; i <= TRTP_PACER_RING_MEDIA; ++i) {
+        self->rings[i].tail = self->rings[i].head;
+    }
+    self->queue_bytes = 0;
+    tsk_mutex_unlock(self->mutex);
+    tsk_list_remove_item_by_data(thread->pacers, self);
+    tsk_mutex_unlock(thread->mutex);
+    TSK_OBJECT_SAFE_FREE(thread);
+
+    return 0;
+}
+
+/**@ingroup trtp_pacer_group
+* Gets the queue size and pacing-delay metrics.
+*/
+int trtp_pacer_get_stats(struct trtp_pacer_s* self, trtp_pacer_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    tsk_mutex_lock(self->mutex);
+    stats->target_kbps = self->target_kbps;
+    stats->rate_kbps = self->rate_kbps;
+    stats->pkts_sent = self->stats.pkts_sent;
+    stats->pkts_delayed = self->stats.pkts_delayed;
+    stats->pkts_audio = self->stats.pkts_audio;
+    stats->pkts_retransmitted = self->stats.pkts_retransmitted;
+    stats->pkts_overflow = self->stats.pkts_overflow;
+    stats->queue_pkts = (self->rings[TRTP_PACER_RING_RTX].head - self->rings[TRTP_PACER_RING_RTX].tail) + (self->rings[TRTP_PACER_RING_MEDIA].head - self->rings[TRTP_PACER_RING_MEDIA].tail);
+    stats->queue_bytes = self->queue_bytes;
+    stats->delay_avg = self->stats.delay_count ? (self->stats.delay_sum / self->stats.delay_count) : 0;
+    stats->delay_max = self->stats.delay_max;
+    tsk_mutex_unlock(self->mutex);
+    return 0;
+}
+
+
+//=================================================================================================
+//	Pacing thread object definition
+//
+static tsk_object_t* trtp_pacer_thread_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_pacer_thread_t *thread = self;
+    if (thread) {
+        thread->semaphore = tsk_semaphore_create();
+        thread->mutex = tsk_mutex_create();
+        thread->pacers = tsk_list_create();
+    }
+    return self;
+}
+static tsk_object_t* trtp_pacer_thread_dtor(tsk_object_t * self)
+{
+    trtp_pacer_thread_t *thread = self;
+    if (thread) {
+        if (thread->h_thread) {
+            thread->running = tsk_false;
+            tsk_semaphore_increment(thread->semaphore);
+            tsk_thread_join(&thread->h_thread);
+        }
+        TSK_OBJECT_SAFE_FREE(thread->pacers);
+        if (thread->mutex) {
+            tsk_mutex_destroy(&thread->mutex);
+        }
+        if (thread->semaphore) {
+            tsk_semaphore_destroy(&thread->semaphore);
+        }
+    }
+    return self;
+}
+static const tsk_object_def_t trtp_pacer_thread_def_s = {
+    sizeof(trtp_pacer_thread_t),
+    trtp_pacer_thread_ctor,
+    trtp_pacer_thread_dtor,
+    tsk_null,
+};
+static const tsk_object_def_t *trtp_pacer_thread_def_t = &trtp_pacer_thread_def_s;
+
+
+//=================================================================================================
+//	Pacer object definition
+//
+static tsk_object_t* trtp_pacer_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_pacer_t *pacer = self;
+    if (pacer) {
+        pacer->mutex = tsk_mutex_create();
+    }
+    return self;
+}
+static tsk_object_t* trtp_pacer_dtor(tsk_object_t * self)
+{
+    trtp_pacer_t *pacer = self;
+    if (pacer) {
+        int i;
+        tsk_size_t j;
+        // the thread holds a reference while started: nothing to stop
+        for (i = TRTP_PACER_RING_RTX; i <= TRTP_PACER_RING_MEDIA; ++i) {
+            for (j = 0; j < TRTP_PACER_QUEUE_CAPACITY; ++j) {
+                TSK_FREE(pacer->rings[i].cells[j].data);
+            }
+        }
+        if (pacer->mutex) {
+            tsk_mutex_destroy(&pacer->mutex);
+        }
+    }
+    return self;
+}
+static int trtp_pacer_cmp(const tsk_object_t *_p1, const tsk_object_t *_p2)
+{
+    return (_p1 == _p2) ? 0 : ((_p1 < _p2) ? -1 : 1);
+}
+static const tsk_object_def_t trtp_pacer_def_s = {
+    sizeof(trtp_pacer_t),
+    trtp_pacer_ctor,
+    trtp_pacer_dtor,
+    trtp_pacer_cmp,
+};
+static const tsk_object_def_t *trtp_pacer_def_t = &trtp_pacer_def_s;
@@ -0,0 +1,547 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_ports.c
+ * @brief Process-wide RTP/RTCP port-pair allocator.
+ *
+ */
+#include "tinyrtp/trtp_ports.h"
+
+#include "tsk_thread.h"
+#include "tsk_mutex.h"
+#include "tsk_list.h"
+#include "tsk_string.h"
+#include "tsk_memory.h"
+#include "tsk_debug.h"
+
+#include <stdlib.h> /* rand() */
+#include <string.h> /* memset() */
+
+// pairs are indexed by "port >> 1"
+#define TRTP_PORTS_BITMAP_TEST(bitmap, index)	((bitmap)[(index) >> 3] & (1 << ((index) & 7)))
+#define TRTP_PORTS_BITMAP_SET(bitmap, index)	((bitmap)[(index) >> 3] |= (uint8_t)(1 << ((index) & 7)))
+#define TRTP_PORTS_BITMAP_CLEAR(bitmap, index)	((bitmap)[(index) >> 3] &= (uint8_t)~(1 << ((index) & 7)))
+
+typedef struct trtp_ports_range_s {
+    TSK_DECLARE_OBJECT;
+
+    uint16_t start; // first RTP port (even)
+    uint16_t stop; // as configured
+    tsk_size_t count; // number of pairs
+    uint16_t* ring; // free pairs (index relative to "start"), the least recently released first
+    tsk_size_t head;
+    tsk_size_t size; // number of pairs in "ring"
+    uint8_t* queued; // whether the pair is in "ring"
+}
+trtp_ports_range_t;
+static const tsk_object_def_t *trtp_ports_range_def_t;
+
+typedef struct trtp_ports_warm_s {
+    TSK_DECLARE_OBJECT;
+
+    char* host;
+    tnet_socket_type_t type;
+    trtp_ports_range_t* range;
+    tsk_size_t target; // number of pairs to keep bound
+    tsk_size_t count;
+    tnet_socket_t* sockets[TRTP_PORTS_WARM_MAX_COUNT][2]; // RTP and RTCP
+}
+trtp_ports_warm_t;
+static const tsk_object_def_t *trtp_ports_warm_def_t;
+
+// Process-wide state, protected by "__trtp_ports_mutex" (never held while binding or closing sockets)
+static uint8_t __trtp_ports_used[(65536 >> 1) >> 3] = { 0 };
+static tsk_list_t* __trtp_ports_ranges = tsk_null;
+static tsk_list_t* __trtp_ports_warms = tsk_null;
+static uint64_t __trtp_ports_acquired = 0;
+static uint64_t __trtp_ports_warm_hits = 0;
+static uint64_t __trtp_ports_bind_failures = 0;
+static uint64_t __trtp_ports_exhausted = 0;
+static tsk_mutex_handle_t* volatile __trtp_ports_mutex = tsk_null;
+
+static void _trtp_ports_lock()
+{
+    tsk_mutex_lock(tsk_mutex_get_once(&__trtp_ports_mutex));
+}
+
+static void _trtp_ports_unlock()
+{
+    tsk_mutex_unlock(__trtp_ports_mutex);
+}
+
+static tsk_bool_t _trtp_ports_host_equals(const char* host1, const char* host2)
+{
+    if (tsk_strnullORempty(host1) || tsk_strnullORempty(host2)) {
+        return (tsk_strnullORempty(host1) && tsk_strnullORempty(host2));
+    }
+    return tsk_striequals(host1, host2);
+}
+
+// must be called with the allocator locked
+static trtp_ports_range_t* _trtp_ports_range_get(uint16_t start, uint16_t stop)
+{
+    tsk_list_item_t* item;
+    trtp_ports_range_t* range;
+    tsk_size_t i, j;
+    uint16_t tmp;
+
+    tsk_list_foreach(item, __trtp_ports_ranges) {
+        range = (trtp_ports_range_t*)item->data;
+        if (range->stop == stop && range->start == TSK_MAX(((start + 1) & 0xFFFE), 2)) {
+            return range;
+        }
+    }
+    if (!__trtp_ports_ranges && !(__trtp_ports_ranges = tsk_list_create())) {
+        return tsk_null;
+    }
+    if (!(range = tsk_object_new(trtp_ports_range_def_t))) {
+        TSK_DEBUG_ERROR("Failed to create port range");
+        return tsk_null;
+    }
+    range->start = TSK_MAX(((start + 1) & 0xFFFE), 2); // port zero means "any"
+    range->stop = stop;
+    range->count = (stop > range->start) ? ((((tsk_size_t)stop - 1 - range->start) >> 1) + 1) : 0;
+    if (!range->count) {
+        TSK_DEBUG_ERROR("[%u, %u] not valid as port range", start, stop);
+        TSK_OBJECT_SAFE_FREE(range);
+        return tsk_null;
+    }
+    if (!(range->ring = tsk_malloc(range->count * sizeof(uint16_t))) || !(range->queued = tsk_calloc(((range->count + 7) >> 3), sizeof(uint8_t)))) {
+        TSK_OBJECT_SAFE_FREE(range);
+        return tsk_null;
+    }
+    // all the pairs are free, in random order to limit collisions with other processes using the same range
+    for (i = 0; i < range->count; ++i) {
+        range->ring[i] = (uint16_t)i;
+        TRTP_PORTS_BITMAP_SET(range->queued, i);
+    }
+    for (i = range->count - 1; i > 0; --i) {
+        j = (tsk_size_t)rand() % (i + 1);
+        tmp = range->ring[i], range->ring[i] = range->ring[j], range->ring[j] = tmp;
+    }
+    range->size = range->count;
+    tsk_list_push_back_data(__trtp_ports_ranges, (void**)&range);
+    return (trtp_ports_range_t*)__trtp_ports_ranges->tail->data;
+}
+
+// must be called with the allocator locked
+static tnet_port_t _trtp_ports_range_pop(trtp_ports_range_t* self, tnet_port_t hint)
+{
+    tsk_size_t index;
+    tnet_port_t port;
+
+    // the hint stays in the ring (if queued) and will be skipped when popped
+    if (hint && !(hint & 1) && hint >= self->start && (hint + 1) <= self->stop && !TRTP_PORTS_BITMAP_TEST(__trtp_ports_used, (hint >> 1))) {
+        TRTP_PORTS_BITMAP_SET(__trtp_ports_used, (hint >> 1));
+        return hint;
+    }
+    while (self->size) {
+        index = self->ring[self->head];
+        self->head = (self->head + 1) % self->count;
+        --self->size;
+        TRTP_PORTS_BITMAP_CLEAR(self->queued, index);
+        port = (tnet_port_t)(self->start + (index << 1));
+        if (!TRTP_PORTS_BITMAP_TEST(__trtp_ports_used, (port >> 1))) { // otherwise, used by an overlapping range or acquired as hint
+            TRTP_PORTS_BITMAP_SET(__trtp_ports_used, (port >> 1));
+            return port;
+        }
+    }
+    return 0;
+}
+
+// must be called with the allocator locked
+static void _trtp_ports_free(tnet_port_t port)
+{
+    tsk_list_item_t* item;
+    trtp_ports_range_t* range;
+    tsk_size_t index;
+
+    TRTP_PORTS_BITMAP_CLEAR(__trtp_ports_used, (port >> 1));
+    // back to the end of the ring of each range containing the pair
+    tsk_list_foreach(item, __trtp_ports_ranges) {
+        range = (trtp_ports_range_t*)item->data;
+        if (port >= range->start && (port + 1) <= range->stop) {
+            index = ((port - range->start) >> 1);
+            if (!TRTP_PORTS_BITMAP_TEST(range->queued, index)) {
+                range->ring[(range->head + range->size) % range->count] = (uint16_t)index;
+                ++range->size;
+                TRTP_PORTS_BITMAP_SET(range->queued, index);
+            }
+        }
+    }
+}
+
+// must be called with the allocator locked
+static trtp_ports_warm_t* _trtp_ports_warm_find(const char* host, tnet_socket_type_t type, uint16_t start, uint16_t stop)
+{
+    tsk_list_item_t* item;
+    trtp_ports_warm_t* warm;
+    tsk_list_foreach(item, __trtp_ports_warms) {
+        warm = (trtp_ports_warm_t*)item->data;
+        if (warm->type == type && warm->range->stop == stop && warm->range->start == TSK_MAX(((start + 1) & 0xFFFE), 2) && _trtp_ports_host_equals(warm->host, host)) {
+            return warm;
+        }
+    }
+    return tsk_null;
+}
+
+// must be called without the allocator locked: tries all the free pairs until one can be bound
+static int _trtp_ports_bind_range(trtp_ports_range_t* range, const char* host, tnet_socket_type_t type, tnet_port_t hint, tsk_bool_t rtcp, tnet_socket_t** rtp_socket, tnet_socket_t** rtcp_socket)
+{
+    tsk_size_t attempts;
+    tnet_port_t port = 0;
+
+    _trtp_ports_lock();
+    attempts = range->size + (hint ? 1 : 0);
+    _trtp_ports_unlock();
+
+    while (attempts--) {
+        _trtp_ports_lock();
+        port = _trtp_ports_range_pop(range, hint);
+        _trtp_ports_unlock();
+        if (!port) {
+            break;
+        }
+        hint = 0;
+
+        if ((*rtp_socket = tnet_socket_create(host, port, type)) && (!rtcp || (*rtcp_socket = tnet_socket_create(host, port + 1, type)))) {
+            return 0;
+        }
+        /* beacuse failure will cause errors in the log, print a message to alert that there is nothing to worry about */
+        TSK_DEBUG_WARN("Failed to bind to %u/%u (used by another process?): trying next pair", port, port + 1);
+        TSK_OBJECT_SAFE_FREE(*rtp_socket);
+        if (rtcp_socket) {
+            TSK_OBJECT_SAFE_FREE(*rtcp_socket);
+        }
+        _trtp_ports_lock();
+        ++__trtp_ports_bind_failures;
+        _trtp_ports_free(port); // retried once all the other pairs are used
+        _trtp_ports_unlock();
+    }
+
+    _trtp_ports_lock();
+    ++__trtp_ports_exhausted;
+    _trtp_ports_unlock();
+    TSK_DEBUG_ERROR("No free RTP/RTCP port pair within [%u, %u]", range->start, range->stop);
+    return -3;
+}
+
+// binds pairs until the warm pool reaches its target
+static void _trtp_ports_warm_fill(trtp_ports_warm_t* self)
+{
+    tnet_socket_t *rtp_socket, *rtcp_socket;
+    tsk_bool_t fill;
+    tnet_port_t port;
+
+    for (;;) {
+        _trtp_ports_lock();
+        fill = (self->count < self->target);
+        _trtp_ports_unlock();
+        if (!fill) {
+            break;
+        }
+        rtp_socket = rtcp_socket = tsk_null;
+        if (_trtp_ports_bind_range(self->range, self->host, self->type, 0, tsk_true, &rtp_socket, &rtcp_socket) != 0) {
+            break;
+        }
+        _trtp_ports_lock();
+        if (self->count < self->target) {
+            self->sockets[self->count][0] = rtp_socket;
+            self->sockets[self->count][1] = rtcp_socket;
+            ++self->count;
+            rtp_socket = rtcp_socket = tsk_null;
+        }
+        _trtp_ports_unlock();
+        if (rtp_socket) { // filled by another thread
+            port = rtp_socket->port;
+            TSK_OBJECT_SAFE_FREE(rtp_socket);
+            TSK_OBJECT_SAFE_FREE(rtcp_socket);
+            _trtp_ports_lock();
+            _trtp_ports_free(port);
+            _trtp_ports_unlock();
+        }
+    }
+}
+
+/**@ingroup trtp_ports_group
+* Acquires and binds a free port pair: the RTP socket is bound to an even port and the RTCP socket to the next one.
+* The pair must be released using @ref trtp_ports_release() once the sockets are closed.
+* @param host The local IP address (null or empty for any).
+* @param type The socket type.
+* @param start The first port of the range.
+* @param stop The last port of the range.
+* @param hint The RTP port to use if free (e.g. the one used before restarting the session), zero for any.
+* @param rtcp Whether to create the RTCP socket. The RTCP port is reserved anyway.
+* @param rtp_socket The RTP socket.
+* @param rtcp_socket The RTCP socket.
+* @retval Zero if succeed and non-zero error code otherwise (e.g. all the pairs within the range are used).
+*/
+int trtp_ports_bind(const char* host, tnet_socket_type_t type, uint16_t start, uint16_t stop, tnet_port_t hint, tsk_bool_t rtcp, struct tnet_socket_s** rtp_socket, struct tnet_socket_s** rtcp_socket)
+{
+    trtp_ports_range_t* range;
+    trtp_ports_warm_t* warm;
+    tnet_socket_t* rtcp_socket_unused = tsk_null;
+    int ret;
+
+    if (!rtp_socket || (rtcp && !rtcp_socket)) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    *rtp_socket = tsk_null;
+    if (rtcp_socket) {
+        *rtcp_socket = tsk_null;
+    }
+
+    _trtp_ports_lock();
+    // pair bound ahead of time
+    if ((warm = _trtp_ports_warm_find(host, type, start, stop)) && warm->count) {
+        --warm->count;
+        *rtp_socket = warm->sockets[warm->count][0];
+        if (rtcp) {
+            *rtcp_socket = warm->sockets[warm->count][1];
+        }
+        else {
+            rtcp_socket_unused = warm->sockets[warm->count][1];
+        }
+        warm->sockets[warm->count][0] = warm->sockets[warm->count][1] = tsk_null;
+        ++__trtp_ports_warm_hits;
+        ++__trtp_ports_acquired;
+        _trtp_ports_unlock();
+        TSK_OBJECT_SAFE_FREE(rtcp_socket_unused);
+        return 0;
+    }
+    range = tsk_object_ref(_trtp_ports_range_get(start, stop));
+    _trtp_ports_unlock();
+
+    if (!range) {
+        return -2;
+    }
+    if ((ret = _trtp_ports_bind_range(range, host, type, hint, rtcp, rtp_socket, rtcp_socket)) == 0) {
+        _trtp_ports_lock();
+        ++__trtp_ports_acquired;
+        _trtp_ports_unlock();
+    }
+    TSK_OBJECT_SAFE_FREE(range);
+    return ret;
+}
+
+/**@ingroup trtp_ports_group
+* Releases a pair acquired using @ref trtp_ports_bind(). The sockets must be closed.
+* The pair will be reused once all the other free pairs within the range are used. The warm pools (if any) are refilled.
+* @param port The RTP port.
+*/
+int trtp_ports_release(tnet_port_t port)
+{
+    tsk_list_item_t* item;
+    trtp_ports_warm_t* warm = tsk_null;
+
+    if (!port || (port & 1)) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    _trtp_ports_lock();
+    if (!TRTP_PORTS_BITMAP_TEST(__trtp_ports_used, (port >> 1))) {
+        _trtp_ports_unlock();
+        TSK_DEBUG_WARN("Port pair %u/%u not acquired", port, port + 1);
+        return -2;
+    }
+    _trtp_ports_free(port);
+    tsk_list_foreach(item, __trtp_ports_warms) {
+        if (((trtp_ports_warm_t*)item->data)->count < ((trtp_ports_warm_t*)item->data)->target) {
+            warm = tsk_object_ref(item->data);
+            break;
+        }
+    }
+    _trtp_ports_unlock();
+
+    if (warm) {
+        _trtp_ports_warm_fill(warm);
+        TSK_OBJECT_SAFE_FREE(warm);
+    }
+    return 0;
+}
+
+/**@ingroup trtp_ports_group
+* Binds port pairs ahead of time so that @ref trtp_ports_bind() doesn't have to. The pairs taken are replenished when pairs are released.
+* @param host The local IP address (null or empty for any), as passed to @ref trtp_ports_bind().
+* @param type The socket type, as passed to @ref trtp_ports_bind().
+* @param start The first port of the range.
+* @param stop The last port of the range.
+* @param count The number of pairs to keep bound, at most TRTP_PORTS_WARM_MAX_COUNT. Zero to close the pre-bound sockets.
+* @retval Zero if succeed and non-zero error code otherwise.
+*/
+int trtp_ports_warm_up(const char* host, tnet_socket_type_t type, uint16_t start, uint16_t stop, tsk_size_t count)
+{
+    trtp_ports_warm_t* warm;
+    tnet_socket_t* extras[TRTP_PORTS_WARM_MAX_COUNT][2];
+    tsk_size_t i, extras_count = 0;
+    int ret = 0;
+
+    if (count > TRTP_PORTS_WARM_MAX_COUNT) {
+        TSK_DEBUG_ERROR("%u not valid as warm pool size", (unsigned)count);
+        return -1;
+    }
+
+    _trtp_ports_lock();
+    if (!(warm = _trtp_ports_warm_find(host, type, start, stop)) && count) {
+        if ((__trtp_ports_warms || (__trtp_ports_warms = tsk_list_create())) && (warm = tsk_object_new(trtp_ports_warm_def_t))) {
+            warm->host = tsk_strdup(host);
+            warm->type = type;
+            if ((warm->range = tsk_object_ref(_trtp_ports_range_get(start, stop)))) {
+                tsk_list_push_back_data(__trtp_ports_warms, (void**)&warm);
+                warm = (trtp_ports_warm_t*)__trtp_ports_warms->tail->data;
+            }
+            else {
+                TSK_OBJECT_SAFE_FREE(warm);
+            }
+        }
+        if (!warm) {
+            ret = -2;
+        }
+    }
+    if (warm) {
+        warm->target = count;
+        while (warm->count > warm->target) {
+            --warm->count;
+            extras[extras_count][0] = warm->sockets[warm->count][0];
+            extras[extras_count++][1] = warm->sockets[warm->count][1];
+            warm->sockets[warm->count][0] = warm->sockets[warm->count][1] = tsk_null;
+        }
+        warm = tsk_object_ref(warm);
+    }
+    _trtp_ports_unlock();
+
+    // close the sockets then release the ports
+    for (i = 0; i < extras_count; ++i) {
+        tnet_port_t port = extras[i][0]->port;
+        TSK_OBJECT_SAFE_FREE(extras[i][0]);
+        TSK_OBJECT_SAFE_FREE(extras[i][1]);
+        _trtp_ports_lock();
+        _trtp_ports_free(port);
+        _trtp_ports_unlock();
+    }
+    if (warm) {
+        _trtp_ports_warm_fill(warm);
+        if (warm->count < count) {
+            TSK_DEBUG_WARN("Only %u/%u port pairs bound ahead of time", (unsigned)warm->count, (unsigned)count);
+            ret = -3;
+        }
+        TSK_OBJECT_SAFE_FREE(warm);
+    }
+    return ret;
+}
+
+/**@ingroup trtp_ports_group
+* Gets the occupancy of a port range and the allocator's counters.
+*/
+int trtp_ports_get_stats(uint16_t start, uint16_t stop, trtp_ports_stats_t* stats)
+{
+    tsk_list_item_t* item;
+    trtp_ports_range_t* range;
+    tsk_size_t i;
+
+    if (!stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    _trtp_ports_lock();
+    if ((range = _trtp_ports_range_get(start, stop))) {
+        stats->pairs_total = (uint32_t)range->count;
+        for (i = 0; i < range->count; ++i) {
+            if (TRTP_PORTS_BITMAP_TEST(__trtp_ports_used, ((range->start >> 1) + i))) {
+                ++stats->pairs_used;
+            }
+        }
+    }
+    tsk_list_foreach(item, __trtp_ports_warms) {
+        stats->pairs_warm += (uint32_t)((const trtp_ports_warm_t*)item->data)->count;
+    }
+    stats->acquired = __trtp_ports_acquired;
+    stats->warm_hits = __trtp_ports_warm_hits;
+    stats->bind_failures = __trtp_ports_bind_failures;
+    stats->exhausted = __trtp_ports_exhausted;
+    _trtp_ports_unlock();
+
+    return range ? 0 : -2;
+}
+
+
+//=================================================================================================
+//	Port range object definition
+//
+static tsk_object_t* trtp_ports_range_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_ports_range_t *range = self;
+    if (range) {
+    }
+    return self;
+}
+static tsk_object_t* trtp_ports_range_dtor(tsk_object_t * self)
+{
+    trtp_ports_range_t *range = self;
+    if (range) {
+        TSK_FREE(range->ring);
+        TSK_FREE(range->queued);
+    }
+    return self;
+}
+static const tsk_object_def_t trtp_ports_range_def_s = {
+    sizeof(trtp_ports_range_t),
+    trtp_ports_range_ctor,
+    trtp_ports_range_dtor,
+    tsk_null,
+};
+static const tsk_object_def_t *trtp_ports_range_def_t = &trtp_ports_range_def_s;
+
+
+//=================================================================================================
+//	Warm pool object definition
+//
+static tsk_object_t* trtp_ports_warm_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_ports_warm_t *warm = self;
+    if (warm) {
+    }
+    return self;
+}
+static tsk_object_t* trtp_ports_warm_dtor(tsk_object_t * self)
+{
+    trtp_ports_warm_t *warm = self;
+    if (warm) {
+        tsk_size_t i;
+        for (i = 0; i < warm->count; ++i) {
+            TSK_OBJECT_SAFE_FREE(warm->sockets[i][0]);
+            TSK_OBJECT_SAFE_FREE(warm->sockets[i][1]);
+        }
+        TSK_FREE(warm->host);
+        TSK_OBJECT_SAFE_FREE(warm->range);
+    }
+    return self;
+}
+static const tsk_object_def_t trtp_ports_warm_def_s = {
+    sizeof(trtp_ports_warm_t),
+    trtp_ports_warm_ctor,
+    trtp_ports_warm_dtor,
+    tsk_null,
+};
+static const tsk_object_def_t *trtp_ports_warm_def_t = &trtp_ports_warm_def_s;
@@ -28,11 +28,94 @@
 extern err_status_t
 crypto_get_random(unsigned char *buffer, unsigned int length);
 
+// order used to list the local contexts (SDES offer): the first one is the preferred
+static const trtp_srtp_crypto_type_t __trtp_srtp_crypto_types_pref[SRTP_CRYPTO_TYPES_MAX] = {
+    AEAD_AES_128_GCM, AEAD_AES_256_GCM, HMAC_SHA1_80, HMAC_SHA1_32
+};
+
+static int _trtp_srtp_set_policy(srtp_policy_t* policy, trtp_srtp_crypto_type_t type)
+{
+    switch (type) {
+    case HMAC_SHA1_80: {
+        crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy->rtp);
+        crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy->rtcp);
+        return 0;
+    }
+    case HMAC_SHA1_32: {
+        crypto_policy_set_aes_cm_128_hmac_sha1_32(&policy->rtp);
+        crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy->rtcp); // RTCP always 80
+        return 0;
+    }
+#if HAVE_SRTP_GCM
+    // rfc7714 - 14.2: 16 octets authentication tag for both SRTP and SRTCP
+    case AEAD_AES_128_GCM: {
+        crypto_policy_set_aes_gcm_128_16_auth(&policy->rtp);
+        crypto_policy_set_aes_gcm_128_16_auth(&policy->rtcp);
+        return 0;
+    }
+    case AEAD_AES_256_GCM: {
+        crypto_policy_set_aes_gcm_256_16_auth(&policy->rtp);
+        crypto_policy_set_aes_gcm_256_16_auth(&policy->rtcp);
+        return 0;
+    }
+#endif /* HAVE_SRTP_GCM */
+    default: {
+        TSK_DEBUG_ERROR("SRTP crypto type %d not supported", (int)type);
+        return -1;
+    }
+    }
+}
+
+tsk_bool_t trtp_srtp_crypto_type_is_supported(trtp_srtp_crypto_type_t type)
+{
+    switch (type) {
+    case HMAC_SHA1_80:
+    case HMAC_SHA1_32:
+        return tsk_true;
+    case AEAD_AES_128_GCM:
+    case AEAD_AES_256_GCM:
+        return HAVE_SRTP_GCM ? tsk_true : tsk_false;
+    default:
+        return tsk_false;
+    }
+}
+
+// rfc5764 - 4.1.2 and rfc7714 - 14.2: master key and salt lengths (in bytes)
+int trtp_srtp_crypto_type_get_key_and_salt_lengths(trtp_srtp_crypto_type_t type, tsk_size_t* key_length, tsk_size_t* salt_length)
+{
+    tsk_size_t key_len, salt_len;
+    switch (type) {
+    case HMAC_SHA1_80:
+    case HMAC_SHA1_32:
+        key_len = (128 >> 3);
+        salt_len = (112 >> 3);
+        break;
+    case AEAD_AES_128_GCM:
+        key_len = (128 >> 3);
+        salt_len = (96 >> 3);
+        break;
+    case AEAD_AES_256_GCM:
+        key_len = (256 >> 3);
+        salt_len = (96 >> 3);
+        break;
+    default:
+        TSK_DEBUG_ERROR("Invalid SRTP crypto type %d", (int)type);
+        return -1;
+    }
+    if (key_length) {
+        *key_length = key_len;
+    }
+    if (salt_length) {
+        *salt_length = salt_len;
+    }
+    return 0;
+}
+
 int trtp_srtp_ctx_internal_init(struct trtp_srtp_ctx_internal_xs* ctx, int32_t tag, trtp_srtp_crypto_type_t type, uint32_t ssrc)
 {
     char* key_str = ctx->key_str;
     err_status_t srtp_err;
-    tsk_size_t size;
+    tsk_size_t size, key_len, salt_len;
 
     if (!ctx) {
         TSK_DEBUG_ERROR("Invalid parameter");
@@ -43,30 +126,24 @@ int trtp_srtp_ctx_internal_init(struct trtp_srtp_ctx_internal_xs* ctx, int32_t t
         trtp_srtp_ctx_internal_deinit(ctx);
     }
 
+    if (trtp_srtp_crypto_type_get_key_and_salt_lengths(type, &key_len, &salt_len)) {
+        return -1;
+    }
+
     ctx->tag = tag;
     ctx->crypto_type = type;
     if (!ctx->have_valid_key) { // use same key to avoid unseless SRTP re-negs (also fix interop-issues against buggy clients -reINVITEs-)
-        if ((srtp_err = crypto_get_random((unsigned char*)ctx->key_bin, sizeof(ctx->key_bin))) != err_status_ok) {
+        if ((srtp_err = crypto_get_random((unsigned char*)ctx->key_bin, (unsigned int)(key_len + salt_len))) != err_status_ok) {
             TSK_DEBUG_ERROR("crypto_get_random() failed");
             return -2;
         }
-        size = tsk_base64_encode((const uint8_t*)ctx->key_bin, sizeof(ctx->key_bin), &key_str);
+        size = tsk_base64_encode((const uint8_t*)ctx->key_bin, (key_len + salt_len), &key_str);
         key_str[size] = '\0';
         ctx->have_valid_key = tsk_true;
     }
 
-    switch(ctx->crypto_type) {
-    case HMAC_SHA1_80: {
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&ctx->policy.rtp);
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&ctx->policy.rtcp);
-        break;
-    }
-    case HMAC_SHA1_32:
-    default: {
-        crypto_policy_set_aes_cm_128_hmac_sha1_32(&ctx->policy.rtp);
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&ctx->policy.rtcp); // RTCP always 80
-        break;
-    }
+    if (_trtp_srtp_set_policy(&ctx->policy, ctx->crypto_type)) {
+        return -1;
     }
 
     ctx->policy.key = (unsigned char*)ctx->key_bin;
@@ -138,20 +215,19 @@ int trtp_srtp_match_line(const char* crypto_line, int32_t* tag, int32_t* crypto_
             break;
         }
         case 1: {
-            if(tsk_striequals(v, TRTP_SRTP_AES_CM_128_HMAC_SHA1_80)) {
-                if(crypto_type) {
-                    *crypto_type = HMAC_SHA1_80;
+            int32_t i;
+            for (i = 0; i < SRTP_CRYPTO_TYPES_MAX; ++i) {
+                if (tsk_striequals(v, trtp_srtp_crypto_type_strings[i])) {
+                    break;
                 }
             }
-            else if(tsk_striequals(v, TRTP_SRTP_AES_CM_128_HMAC_SHA1_32)) {
-                if(crypto_type) {
-                    *crypto_type = HMAC_SHA1_32;
-                }
-            }
-            else {
+            if (i == SRTP_CRYPTO_TYPES_MAX) {
                 ret = -0xFF;
                 goto bail;
             }
+            if(crypto_type) {
+                *crypto_type = i;
+            }
             break;
         }
         case 2: {
@@ -180,17 +256,16 @@ bail:
 
 tsk_size_t trtp_srtp_get_local_contexts(trtp_manager_t* rtp_mgr, const struct trtp_srtp_ctx_xs ** contexts, tsk_size_t contexts_count)
 {
-    tsk_size_t ret = 0;
+    tsk_size_t ret = 0, i;
     if(!rtp_mgr || !contexts) {
         TSK_DEBUG_ERROR("Invalid parameter");
         return 0;
     }
 
-    if (contexts_count > ret && rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_80].rtp.initialized) {
-        contexts[ret++] = &rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_80];
-    }
-    if (contexts_count > ret && rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_32].rtp.initialized) {
-        contexts[ret++] = &rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_32];
+    for (i = 0; i < SRTP_CRYPTO_TYPES_MAX && contexts_count > ret; ++i) {
+        if (rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][__trtp_srtp_crypto_types_pref[i]].rtp.initialized) {
+            contexts[ret++] = &rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][__trtp_srtp_crypto_types_pref[i]];
+        }
     }
     return ret;
 }
@@ -202,7 +277,8 @@ int trtp_srtp_set_crypto(struct trtp_manager_s* rtp_mgr, const char* crypto_line
     int ret;
     uint8_t *key_bin;
     err_status_t srtp_err;
-    int32_t tag, crypto_type;
+    int32_t tag, crypto_type, i;
+    tsk_size_t key_len, salt_len;
     char key_str[SRTP_MAX_KEY_LEN + 1];
 
     memset(key_str, 0, sizeof(key_str));
@@ -210,6 +286,16 @@ int trtp_srtp_set_crypto(struct trtp_manager_s* rtp_mgr, const char* crypto_line
     if ((ret = trtp_srtp_match_line(crypto_line, &tag, &crypto_type, key_str, sizeof(key_str) - 1))) {
         return ret;
     }
+    if (!trtp_srtp_crypto_type_is_supported((trtp_srtp_crypto_type_t)crypto_type)) {
+        TSK_DEBUG_INFO("SRTP crypto type '%s' not supported", trtp_srtp_crypto_type_strings[crypto_type]);
+        return -0xFF;
+    }
+    trtp_srtp_crypto_type_get_key_and_salt_lengths((trtp_srtp_crypto_type_t)crypto_type, &key_len, &salt_len);
+    // base64(key||salt) without padding must fit and "tsk_base64_decode()" must not overflow "key_bin"
+    if (tsk_strlen(key_str) < (((key_len + salt_len) << 2) / 3) || tsk_strlen(key_str) > (((key_len + salt_len + 2) / 3) << 2)) {
+        TSK_DEBUG_ERROR("Invalid key length for '%s': %s", trtp_srtp_crypto_type_strings[crypto_type], key_str);
+        return -0xFF;
+    }
 
     srtp_ctx = &rtp_mgr->srtp_contexts[idx][crypto_type];
     ret = trtp_srtp_ctx_deinit(srtp_ctx);
@@ -218,29 +304,18 @@ int trtp_srtp_set_crypto(struct trtp_manager_s* rtp_mgr, const char* crypto_line
     srtp_ctx->rtp.crypto_type = (trtp_srtp_crypto_type_t)crypto_type;
     memcpy(srtp_ctx->rtp.key_str, key_str, sizeof(srtp_ctx->rtp.key_str));
 
-    switch(srtp_ctx->rtp.crypto_type) {
-    case HMAC_SHA1_80: {
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&srtp_ctx->rtp.policy.rtp);
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&srtp_ctx->rtp.policy.rtcp);
-        if (idx == TRTP_SRTP_LINE_IDX_REMOTE) {
-            trtp_srtp_ctx_deinit(&rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_32]);
-            rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_80].rtp.tag =
-                rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_80].rtcp.tag = srtp_ctx->rtp.tag;
-        }
-        break;
+    if ((ret = _trtp_srtp_set_policy(&srtp_ctx->rtp.policy, srtp_ctx->rtp.crypto_type))) {
+        return ret;
     }
-    case HMAC_SHA1_32: {
-        crypto_policy_set_aes_cm_128_hmac_sha1_32(&srtp_ctx->rtp.policy.rtp);
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&srtp_ctx->rtp.policy.rtcp); // RTCP always 80
-        if (idx == TRTP_SRTP_LINE_IDX_REMOTE) {
-            trtp_srtp_ctx_deinit(&rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_80]);
-            rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_32].rtp.tag =
-                rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][HMAC_SHA1_32].rtcp.tag = srtp_ctx->rtp.tag;
+    if (idx == TRTP_SRTP_LINE_IDX_REMOTE) {
+        // keep the local context matching the remote crypto type only
+        for (i = 0; i < SRTP_CRYPTO_TYPES_MAX; ++i) {
+            if (i != crypto_type) {
+                trtp_srtp_ctx_deinit(&rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][i]);
+            }
         }
-        break;
-    }
-    default:
-        break;
+        rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][crypto_type].rtp.tag =
+            rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][crypto_type].rtcp.tag = srtp_ctx->rtp.tag;
     }
 
     key_bin = (unsigned char*)srtp_ctx->rtp.key_bin;
@@ -262,7 +337,7 @@ int trtp_srtp_set_key_and_salt(trtp_manager_t* rtp_mgr, trtp_srtp_crypto_type_t
     int ret;
     trtp_srtp_ctx_internal_xt* srtp_ctx;
     err_status_t srtp_err;
-    if (!rtp_mgr || !key || !key_size || !salt || !salt_size) {
+    if (!rtp_mgr || !key || !key_size || !salt || !salt_size || (key_size + salt_size) > TRTP_SRTP_MASTER_KEY_LEN_MAX) {
         TSK_DEBUG_ERROR("Invalid parameter");
         return -1;
     }
@@ -272,18 +347,8 @@ int trtp_srtp_set_key_and_salt(trtp_manager_t* rtp_mgr, trtp_srtp_crypto_type_t
         return ret;
     }
 
-    switch ((srtp_ctx->crypto_type = crypto_type)) {
-    case HMAC_SHA1_80:
-    default: {
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&srtp_ctx->policy.rtp);
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&srtp_ctx->policy.rtcp);
-        break;
-    }
-    case HMAC_SHA1_32: {
-        crypto_policy_set_aes_cm_128_hmac_sha1_32(&srtp_ctx->policy.rtp);
-        crypto_policy_set_aes_cm_128_hmac_sha1_80(&srtp_ctx->policy.rtcp); // always 80
-        break;
-    }
+    if ((ret = _trtp_srtp_set_policy(&srtp_ctx->policy, (srtp_ctx->crypto_type = crypto_type)))) {
+        return ret;
     }
 
     memcpy(srtp_ctx->key_bin, key, key_size);
@@ -307,11 +372,16 @@ int trtp_srtp_set_key_and_salt(trtp_manager_t* rtp_mgr, trtp_srtp_crypto_type_t
 
 tsk_bool_t trtp_srtp_is_initialized(trtp_manager_t* rtp_mgr)
 {
+    int32_t i;
+    tsk_bool_t local = tsk_false, remote = tsk_false;
     if (!rtp_mgr) {
         return tsk_false;
     }
-    return ((rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][0].rtp.initialized || rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][1].rtp.initialized)
-            && rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][0].rtp.initialized);
+    for (i = 0; i < SRTP_CRYPTO_TYPES_MAX; ++i) {
+        local |= rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_LOCAL][i].rtp.initialized;
+        remote |= rtp_mgr->srtp_contexts[TRTP_SRTP_LINE_IDX_REMOTE][i].rtp.initialized;
+    }
+    return (local && remote);
 }
 
 tsk_bool_t trtp_srtp_is_started(trtp_manager_t* rtp_mgr)
@@ -0,0 +1,465 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+/**@file trtp_worker.c
+ * @brief Media workers: threads decoding the incoming RTP packets out of the network thread.
+ *
+ */
+#include "tinyrtp/trtp_worker.h"
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+
+#include "tinymedia/tmedia_defaults.h"
+
+#include "tsk_thread.h"
+#include "tsk_semaphore.h"
+#include "tsk_mutex.h"
+#include "tsk_list.h"
+#include "tsk_time.h"
+#include "tsk_debug.h"
+
+#include <string.h> /* memset() */
+
+#define TRTP_WORKER_QUEUE_MASK (TRTP_WORKER_QUEUE_CAPACITY - 1)
+#define TRTP_WORKER_QUEUE_DEPTH(self) ((tsk_size_t)((self)->ring.head - (self)->ring.tail))
+
+typedef struct trtp_worker_s {
+    TSK_DECLARE_OBJECT;
+
+    int32_t index;
+    tsk_thread_handle_t* h_thread;
+    tsk_thread_id_t id_thread;
+    tsk_semaphore_handle_t* semaphore;
+    tsk_mutex_handle_t* mutex; // protects "queues" and held while the callbacks are called
+    tsk_list_t* queues; // attached "trtp_worker_queue_t" objects
+    tsk_size_t queues_count;
+    tsk_bool_t running;
+    volatile uintptr_t sleeping; // whether the worker is (about to be) blocked on "semaphore"
+}
+trtp_worker_t;
+static const tsk_object_def_t *trtp_worker_def_t;
+
+// The workers are created on demand and live until the process exits
+static trtp_worker_t* __trtp_workers[TRTP_WORKER_MAX_COUNT] = { tsk_null };
+static tsk_mutex_handle_t* volatile __trtp_workers_mutex = tsk_null;
+
+static void* TSK_STDCALL _trtp_worker_run(void* arg);
+
+static void _trtp_workers_lock()
+{
+    tsk_mutex_lock(tsk_mutex_get_once(&__trtp_workers_mutex));
+}
+
+static void _trtp_workers_unlock()
+{
+    tsk_mutex_unlock(__trtp_workers_mutex);
+}
+
+static trtp_worker_t* _trtp_worker_create(int32_t index)
+{
+    trtp_worker_t* worker;
+    if (!(worker = tsk_object_new(trtp_worker_def_t))) {
+        TSK_DEBUG_ERROR("Failed to create media worker");
+        return tsk_null;
+    }
+    worker->index = index;
+    worker->running = tsk_true;
+    if (!worker->semaphore || !worker->mutex || !worker->queues || tsk_thread_create(&worker->h_thread, _trtp_worker_run, worker) != 0) {
+        TSK_DEBUG_ERROR("Failed to start media worker #%d", index);
+        worker->running = tsk_false;
+        TSK_OBJECT_SAFE_FREE(worker);
+        return tsk_null;
+    }
+    if (tmedia_defaults_get_media_workers_affinity()) {
+        tsk_thread_set_affinity(worker->h_thread, (index % tsk_thread_get_cpu_count())); // more workers than CPUs: wrap around
+    }
+    TSK_DEBUG_INFO("Media worker #%d started", index);
+    return worker;
+}
+
+// Gets the least loaded worker (round-robin on equality)
+static trtp_worker_t* _trtp_worker_select()
+{
+    int32_t i, count = TSK_MIN(tmedia_defaults_get_media_workers_count(), TRTP_WORKER_MAX_COUNT);
+    trtp_worker_t* best = tsk_null;
+
+    _trtp_workers_lock();
+    for (i = 0; i < count; ++i) {
+        if (!__trtp_workers[i]) {
+            __trtp_workers[i] = _trtp_worker_create(i);
+        }
+        if (__trtp_workers[i] && (!best || __trtp_workers[i]->queues_count < best->queues_count)) {
+            best = __trtp_workers[i];
+        }
+    }
+    best = tsk_object_ref(best);
+    _trtp_workers_unlock();
+
+    return best;
+}
+
+static void _trtp_worker_signal(trtp_worker_t* self)
+{
+    tsk_atomic_barrier(); // publish the queue before checking "sleeping"
+    if (self->sleeping && tsk_atomic_cas(&self->sleeping, 1, 0)) {
+        tsk_semaphore_increment(self->semaphore);
+    }
+}
+
+static tsk_bool_t _trtp_worker_is_empty(trtp_worker_t* self)
+{
+    const tsk_list_item_t* item;
+    tsk_bool_t empty = tsk_true;
+    tsk_mutex_lock(self->mutex);
+    tsk_list_foreach(item, self->queues) {
+        if (TRTP_WORKER_QUEUE_DEPTH((const trtp_worker_queue_t*)item->data) > 0) {
+            empty = tsk_false;
+            break;
+        }
+    }
+    tsk_mutex_unlock(self->mutex);
+    return empty;
+}
+
+// Same logic as "tsk_runnable_wait()": a burst of packets costs at most one wakeup
+static void _trtp_worker_wait(trtp_worker_t* self)
+{
+    while (self->running && _trtp_worker_is_empty(self)) {
+        self->sleeping = 1;
+        tsk_atomic_barrier(); // publish "sleeping" before checking the queues again
+        if (!self->running || !_trtp_worker_is_empty(self)) {
+            if (!tsk_atomic_cas(&self->sleeping, 1, 0)) {
+                // a producer already took the flag: consume its signal to keep the semaphore balanced
+                tsk_semaphore_decrement(self->semaphore);
+            }
+            break;
+        }
+        tsk_semaphore_decrement(self->semaphore);
+    }
+}
+
+// Consumer side: must be called by the worker or after the queue is detached.
+// Forwarding stops as soon as a callback detaches the queue: the remaining packets are dropped by the worker.
+static tsk_size_t _trtp_worker_queue_process(trtp_worker_queue_t* self, tsk_size_t max, tsk_bool_t forward)
+{
+    tsk_size_t count = 0;
+    uintptr_t tail = self->ring.tail;
+    trtp_worker_cell_t* cell;
+    trtp_rtp_packet_t* packet;
+    uint64_t now = 0, latency;
+
+    while (count < max && tail != self->ring.head) {
+        tsk_atomic_barrier(); // read the cell after "head"
+        cell = &self->ring.cells[tail & TRTP_WORKER_QUEUE_MASK];
+        packet = cell->packet, cell->packet = tsk_null;
+        if (forward) {
+            if (!now) {
+                now = tsk_time_now();
+            }
+            latency = (now > cell->time) ? (now - cell->time) : 0;
+            self->stats.latency_sum += latency;
+            self->stats.latency_max = TSK_MAX(self->stats.latency_max, latency);
+        }
+        tsk_atomic_barrier(); // release the slot only when the cell is read
+        self->ring.tail = ++tail;
+
+        if (forward) {
+            ++self->stats.processed;
+            if (self->fun) {
+                self->fun(self->usrdata, packet);
+            }
+        }
+        TSK_OBJECT_SAFE_FREE(packet);
+        ++count;
+        if (forward && !self->attached) {
+            break;
+        }
+    }
+    return count;
+}
+
+static int _trtp_worker_pred_queue_detached(const tsk_list_item_t* item, const void* data)
+{
+    return ((const trtp_worker_queue_t*)item->data)->attached ? -1 : 0;
+}
+
+static void* TSK_STDCALL _trtp_worker_run(void* arg)
+{
+    trtp_worker_t* self = (trtp_worker_t*)arg;
+    tsk_list_item_t* item;
+    trtp_worker_queue_t* queue;
+
+    self->id_thread = tsk_thread_get_id();
+    TSK_DEBUG_INFO("Media worker #%d - ENTER", self->index);
+
+    while (self->running) {
+        _trtp_worker_wait(self);
+        if (!self->running) {
+            break;
+        }
+        // round-robin between the sessions to make sure a single session cannot starve the others
+        tsk_mutex_lock(self->mutex);
+        tsk_list_foreach(item, self->queues) {
+            queue = (trtp_worker_queue_t*)item->data;
+            if (queue->attached) {
+                _trtp_worker_queue_process(queue, TRTP_WORKER_BATCH_MAX, tsk_true);
+            }
+        }
+        // queues detached from the callbacks (see "trtp_worker_queue_detach()"): drop their pending packets
+        tsk_list_foreach(item, self->queues) {
+            queue = (trtp_worker_queue_t*)item->data;
+            if (!queue->attached) {
+                _trtp_worker_queue_process(queue, TRTP_WORKER_QUEUE_CAPACITY, tsk_false);
+            }
+        }
+        while (tsk_list_remove_item_by_pred(self->queues, _trtp_worker_pred_queue_detached, tsk_null)) ;
+        tsk_mutex_unlock(self->mutex);
+    }
+
+    TSK_DEBUG_INFO("Media worker #%d - EXIT", self->index);
+    return tsk_null;
+}
+
+/**@ingroup trtp_worker_group
+* Creates a queue used to forward the RTP packets from the network thread to a media worker.
+* @param fun The function to call (on the worker's thread) for each packet.
+* @param usrdata Opaque data to forward to @a fun.
+*/
+trtp_worker_queue_t* trtp_worker_queue_create(trtp_rtp_cb_f fun, const void* usrdata)
+{
+    trtp_worker_queue_t* queue;
+    if ((queue = tsk_object_new(trtp_worker_queue_def_t))) {
+        queue->fun = fun;
+        queue->usrdata = usrdata;
+    }
+    return queue;
+}
+
+/**@ingroup trtp_worker_group
+* Attaches the queue to the least loaded media worker. Must be called before the network thread starts pushing packets.
+* @retval Zero if succeed and non-zero error code otherwise (e.g. media workers disabled).
+*/
+int trtp_worker_queue_attach(trtp_worker_queue_t* self)
+{
+    trtp_worker_t* worker;
+    trtp_worker_queue_t* queue;
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (self->worker) {
+        return 0;
+    }
+    if (!(worker = _trtp_worker_select())) {
+        return -2;
+    }
+    // drop packets pushed after the last detach()
+    _trtp_worker_queue_process(self, TRTP_WORKER_QUEUE_CAPACITY, tsk_false);
+    memset(&self->stats, 0, sizeof(self->stats));
+
+    tsk_mutex_lock(worker->mutex);
+    tsk_list_remove_item_by_data(worker->queues, self); // could be pending removal
+    self->worker = worker;
+    self->attached = tsk_true;
+    queue = (trtp_worker_queue_t*)tsk_object_ref(self); // the worker holds a reference while attached
+    tsk_list_push_back_data(worker->queues, (void**)&queue);
+    ++worker->queues_count;
+    tsk_mutex_unlock(worker->mutex);
+
+    return 0;
+}
+
+/**@ingroup trtp_worker_group
+* Queues a packet for the media worker. Must only be called by the network thread (single producer).
+* @param packet The packet to queue. Retained using "trtp_rtp_packet_retain()" which means it could be a view.
+* @retval Zero if succeed and non-zero error code otherwise (e.g. queue full or detached).
+*/
+int trtp_worker_queue_push(trtp_worker_queue_t* self, const trtp_rtp_packet_t* packet)
+{
+    uintptr_t head;
+    trtp_worker_cell_t* cell;
+    tsk_size_t depth;
+    trtp_worker_t* worker;
+
+    if (!self || !packet) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!self->attached || !(worker = self->worker)) {
+        return -2;
+    }
+    head = self->ring.head;
+    if ((depth = (tsk_size_t)(head - self->ring.tail)) >= TRTP_WORKER_QUEUE_CAPACITY) {
+        // decoder too slow: drop the newest packet (RTCP-NACK/FEC/PLC will do the rest)
+        if ((self->stats.dropped++ & 0xFF) == 0) {
+            TSK_DEBUG_WARN("Media worker queue full: %llu packets dropped so far", self->stats.dropped);
+        }
+        return -3;
+    }
+    cell = &self->ring.cells[head & TRTP_WORKER_QUEUE_MASK];
+    if (!(cell->packet = trtp_rtp_packet_retain(packet))) {
+        return -4;
+    }
+    cell->time = tsk_time_now();
+    tsk_atomic_barrier(); // the cell must be visible before "head"
+    self->ring.head = head + 1;
+
+    ++self->stats.enqueued;
+    self->stats.depth_max = TSK_MAX(self->stats.depth_max, depth + 1);
+
+    _trtp_worker_signal(worker);
+    return 0;
+}
+
+/**@ingroup trtp_worker_group
+* Detaches the queue from its media worker and drops the pending packets.
+* When this function returns the callback is not running and will not be called again
+* (unless called from the callback itself: then no other packet is forwarded once the callback returns
+* and the worker drops the pending ones).
+*/
+int trtp_worker_queue_detach(trtp_worker_queue_t* self)
+{
+    trtp_worker_t* worker;
+    tsk_thread_id_t id_thread;
+    tsk_bool_t from_worker;
+    trtp_worker_stats_t stats;
+
+    if (!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!(worker = self->worker)) {
+        return 0;
+    }
+
+    id_thread = tsk_thread_get_id();
+    from_worker = tsk_thread_id_equals(&id_thread, &worker->id_thread);
+    tsk_mutex_lock(worker->mutex); // wait for the worker to be done with the callbacks
+    self->attached = tsk_false;
+    if (!from_worker) {
+        tsk_list_remove_item_by_data(worker->queues, self);
+    } // otherwise, the worker will drop the pending packets and remove the queue after the callback returns
+    --worker->queues_count;
+    self->worker = tsk_null;
+    tsk_mutex_unlock(worker->mutex);
+
+    if (trtp_worker_queue_get_stats(self, &stats) == 0) {
+        TSK_DEBUG_INFO("Media worker #%d: enqueued=%llu, dropped=%llu, processed=%llu, depth_max=%u, latency_avg=%llums, latency_max=%llums",
+                       worker->index, stats.enqueued, stats.dropped, stats.processed, (unsigned)stats.depth_max, stats.latency_avg, stats.latency_max);
+    }
+    if (!from_worker) { // the worker is the only consumer while processing the queue
+        _trtp_worker_queue_process(self, TRTP_WORKER_QUEUE_CAPACITY, tsk_false);
+    }
+    TSK_OBJECT_SAFE_FREE(worker);
+
+    return 0;
+}
+
+/**@ingroup trtp_worker_group
+* Gets the queue-depth and latency metrics. The values are updated without locking which means they're only estimations.
+*/
+int trtp_worker_queue_get_stats(const trtp_worker_queue_t* self, trtp_worker_stats_t* stats)
+{
+    if (!self || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    stats->enqueued = self->stats.enqueued;
+    stats->dropped = self->stats.dropped;
+    stats->processed = self->stats.processed;
+    stats->depth = TRTP_WORKER_QUEUE_DEPTH(self);
+    stats->depth_max = self->stats.depth_max;
+    stats->latency_avg = stats->processed ? (self->stats.latency_sum / stats->processed) : 0;
+    stats->latency_max = self->stats.latency_max;
+    return 0;
+}
+
+
+//=================================================================================================
+//	Media worker object definition
+//
+static tsk_object_t* trtp_worker_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_worker_t *worker = self;
+    if (worker) {
+        worker->semaphore = tsk_semaphore_create();
+        worker->mutex = tsk_mutex_create();
+        worker->queues = tsk_list_create();
+    }
+    return self;
+}
+static tsk_object_t* trtp_worker_dtor(tsk_object_t * self)
+{
+    trtp_worker_t *worker = self;
+    if (worker) {
+        if (worker->h_thread) {
+            worker->running = tsk_false;
+            tsk_semaphore_increment(worker->semaphore);
+            tsk_thread_join(&worker->h_thread);
+        }
+        TSK_OBJECT_SAFE_FREE(worker->queues);
+        if (worker->mutex) {
+            tsk_mutex_destroy(&worker->mutex);
+        }
+        if (worker->semaphore) {
+            tsk_semaphore_destroy(&worker->semaphore);
+        }
+    }
+    return self;
+}
+static const tsk_object_def_t trtp_worker_def_s = {
+    sizeof(trtp_worker_t),
+    trtp_worker_ctor,
+    trtp_worker_dtor,
+    tsk_null,
+};
+static const tsk_object_def_t *trtp_worker_def_t = &trtp_worker_def_s;
+
+
+//=================================================================================================
+//	Media worker queue object definition
+//
+static tsk_object_t* trtp_worker_queue_ctor(tsk_object_t * self, va_list * app)
+{
+    trtp_worker_queue_t *queue = self;
+    if (queue) {
+    }
+    return self;
+}
+static tsk_object_t* trtp_worker_queue_dtor(tsk_object_t * self)
+{
+    trtp_worker_queue_t *queue = self;
+    if (queue) {
+        // the worker holds a reference while attached: nothing to detach
+        _trtp_worker_queue_process(queue, TRTP_WORKER_QUEUE_CAPACITY, tsk_false);
+    }
+    return self;
+}
+static int trtp_worker_queue_cmp(const tsk_object_t *_q1, const tsk_object_t *_q2)
+{
+    return (_q1 == _q2) ? 0 : ((_q1 < _q2) ? -1 : 1);
+}
+static const tsk_object_def_t trtp_worker_queue_def_s = {
+    sizeof(trtp_worker_queue_t),
+    trtp_worker_queue_ctor,
+    trtp_worker_queue_dtor,
+    trtp_worker_queue_cmp,
+};
+const tsk_object_def_t *trtp_worker_queue_def_t = &trtp_worker_queue_def_s;
@@ -29,9 +29,21 @@
 #define RUN_TEST_ALL				0
 #define RUN_TEST_PARSER				0
 #define RUN_TEST_MANAGER			1
+#define RUN_TEST_WORKER				0
+#define RUN_TEST_FORWARD			0
+#define RUN_TEST_SRTP				0
+#define RUN_TEST_BWE				0
+#define RUN_TEST_PACER				0
+#define RUN_TEST_PORTS				0
 
 #include "test_parser.h"
 #include "test_manager.h"
+#include "test_worker.h"
+#include "test_forward.h"
+#include "test_srtp.h"
+#include "test_bwe.h"
+#include "test_pacer.h"
+#include "test_ports.h"
 
 
 
@@ -55,6 +67,30 @@ int main()
         test_manager();
 #endif
 
+#if RUN_TEST_WORKER || RUN_TEST_ALL
+        test_worker();
+#endif
+
+#if RUN_TEST_FORWARD || RUN_TEST_ALL
+        test_forward();
+#endif
+
+#if RUN_TEST_SRTP || RUN_TEST_ALL
+        test_srtp();
+#endif
+
+#if RUN_TEST_BWE || RUN_TEST_ALL
+        test_bwe();
+#endif
+
+#if RUN_TEST_PACER || RUN_TEST_ALL
+        test_pacer();
+#endif
+
+#if RUN_TEST_PORTS || RUN_TEST_ALL
+        test_ports();
+#endif
+
     }
     while(LOOP);
 
@@ -0,0 +1,190 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef TINYRTP_TEST_BWE_H
+#define TINYRTP_TEST_BWE_H
+
+#include "tinyrtp/trtp_bwe.h"
+#include "tinyrtp/rtcp/trtp_rtcp_report_fb.h"
+
+#define TEST_BWE_FPS			30
+#define TEST_BWE_PKT_SIZE		1200
+#define TEST_BWE_PROPAGATION_US	20000 // one-way
+#define TEST_BWE_QUEUE_MAX_US	500000 // drop-tail when the bottleneck queue is longer
+#define TEST_BWE_FB_INTERVAL_US	100000
+#define TEST_BWE_PKTS_MAX		2048
+
+// feedback serialized then parsed back: same arrival times (rounded to 250us), losses and large/negative deltas preserved
+static void test_bwe_twcc_packet()
+{
+    static const int64_t arrival_times_us[] = {
+        -1, 1000000, 1000250, 1001000, -1, -1, 1000500 /* reordered */, 1200000 /* large */,
+        1200000, 1200250, 1200500, 1200750, 1201000, 1201250, 1201500, 1201750,
+        1202000, 1202250, 1202500, 1202750, 1203000, 1203250, 1203500, 1203750, -1
+    };
+    const tsk_size_t count = sizeof(arrival_times_us) / sizeof(arrival_times_us[0]);
+    int64_t arrival_times_out[sizeof(arrival_times_us) / sizeof(arrival_times_us[0])];
+    trtp_rtcp_report_rtpfb_t *rtpfb_out, *rtpfb_in = tsk_null;
+    uint8_t buffer[256];
+    tsk_size_t i, size;
+
+    if (!(rtpfb_out = trtp_rtcp_report_rtpfb_create_twcc(0x11111111, 0x22222222, 65530 /* wraps */, 7, arrival_times_us, count))) {
+        TSK_DEBUG_ERROR("Failed to create TWCC feedback");
+        return;
+    }
+    size = trtp_rtcp_report_rtpfb_get_size(rtpfb_out);
+    if (trtp_rtcp_report_rtpfb_serialize_to(rtpfb_out, buffer, sizeof(buffer)) != 0 || (size & 0x03)) {
+        TSK_DEBUG_ERROR("Failed to serialize TWCC feedback");
+        goto bail;
+    }
+    if (!(rtpfb_in = trtp_rtcp_report_rtpfb_deserialize(buffer, size)) || rtpfb_in->fci_type != trtp_rtcp_rtpfb_fci_type_twcc) {
+        TSK_DEBUG_ERROR("Failed to parse TWCC feedback");
+        goto bail;
+    }
+    if (rtpfb_in->twcc.base_seq != 65530 || rtpfb_in->twcc.status_count != count || rtpfb_in->twcc.fb_pkt_count != 7
+            || trtp_rtcp_report_rtpfb_get_twcc_arrival_times(rtpfb_in, arrival_times_out, count) != 0) {
+        TSK_DEBUG_ERROR("Invalid TWCC feedback");
+        goto bail;
+    }
+    for (i = 0; i < count; ++i) {
+        if ((arrival_times_us[i] < 0) != (arrival_times_out[i] < 0)
+                || (arrival_times_us[i] >= 0 && (arrival_times_out[i] - arrival_times_out[1]) != (arrival_times_us[i] - arrival_times_us[1]))) {
+            TSK_DEBUG_ERROR("Invalid arrival time at index %u: %lld != %lld", (unsigned)i, arrival_times_out[i], arrival_times_us[i]);
+        }
+    }
+    TSK_DEBUG_INFO("TWCC feedback: %u packets in %u bytes", (unsigned)count, (unsigned)size);
+
+bail:
+    TSK_OBJECT_SAFE_FREE(rtpfb_out);
+    TSK_OBJECT_SAFE_FREE(rtpfb_in);
+}
+
+typedef struct test_bwe_link_s {
+    int32_t capacity_kbps;
+    int32_t loss_modulo; // every nth packet is lost, zero for none
+    int64_t busy_until_us; // bottleneck queue
+    int64_t budget; // bytes produced by the encoder and not sent yet
+    uint16_t seq_num;
+    tsk_size_t count; // number of packets sent since the last feedback
+    uint16_t base_seq;
+    int64_t arrivals[TEST_BWE_PKTS_MAX];
+    uint8_t fb_pkt_count;
+}
+test_bwe_link_t;
+
+// video sent at the target bitrate (no pacing, one burst per frame) through a bottleneck then reported every 100ms
+// returns the target bitrate at the end
+static int32_t test_bwe_simulate(struct trtp_bwe_s* bwe, test_bwe_link_t* link, int64_t* now_us, int64_t duration_us, int64_t* time_to_converge_us)
+{
+    const int64_t end_us = *now_us + duration_us;
+    int64_t next_fb_us = *now_us + TEST_BWE_FB_INTERVAL_US, arrival_us, queue_us;
+    int32_t target_kbps;
+    trtp_rtcp_report_rtpfb_t* rtpfb;
+
+    *time_to_converge_us = -1;
+    for (; *now_us < end_us; *now_us += (1000000 / TEST_BWE_FPS)) {
+        target_kbps = trtp_bwe_get_target_kbps(bwe);
+        if (*time_to_converge_us < 0 && target_kbps <= link->capacity_kbps && target_kbps >= (link->capacity_kbps * 6) / 10) {
+            *time_to_converge_us = (*now_us - (end_us - duration_us));
+        }
+        for (link->budget += ((target_kbps * 1000) / 8 / TEST_BWE_FPS); link->budget >= TEST_BWE_PKT_SIZE; link->budget -= TEST_BWE_PKT_SIZE) {
+            trtp_bwe_on_packet_sent(bwe, link->seq_num, TEST_BWE_PKT_SIZE, *now_us);
+            queue_us = TSK_MAX(link->busy_until_us - *now_us, 0);
+            if (queue_us > TEST_BWE_QUEUE_MAX_US || (link->loss_modulo && (link->seq_num % link->loss_modulo) == 0)) {
+                arrival_us = -1;
+            }
+            else {
+                link->busy_until_us = TSK_MAX(link->busy_until_us, *now_us) + ((TEST_BWE_PKT_SIZE * 8 * 1000) / link->capacity_kbps);
+                arrival_us = link->busy_until_us + TEST_BWE_PROPAGATION_US;
+            }
+            if (link->count < TEST_BWE_PKTS_MAX) {
+                link->arrivals[link->count++] = arrival_us;
+            }
+            ++link->seq_num;
+        }
+        // the receiver sends the feedback when all packets sent until now are received (simplification)
+        if (*now_us >= next_fb_us && link->count) {
+            if ((rtpfb = trtp_rtcp_report_rtpfb_create_twcc(0x11111111, 0x22222222, link->base_seq, link->fb_pkt_count++, link->arrivals, link->count))) {
+                trtp_bwe_on_feedback(bwe, rtpfb, *now_us + TEST_BWE_PROPAGATION_US + queue_us);
+                TSK_OBJECT_SAFE_FREE(rtpfb);
+            }
+            link->base_seq += (uint16_t)link->count;
+            link->count = 0;
+            next_fb_us += TEST_BWE_FB_INTERVAL_US;
+        }
+    }
+    return trtp_bwe_get_target_kbps(bwe);
+}
+
+static void test_bwe_convergence()
+{
+    static test_bwe_link_t link;
+    struct trtp_bwe_s* bwe;
+    trtp_bwe_stats_t stats;
+    int64_t now_us = 0, time_us;
+    int32_t kbps;
+
+    memset(&link, 0, sizeof(link));
+    if (!(bwe = trtp_bwe_create(300, 50, 5000))) {
+        TSK_DEBUG_ERROR("Failed to create BWE");
+        return;
+    }
+
+    // ramp-up to 1.5Mbps
+    link.capacity_kbps = 1500;
+    kbps = test_bwe_simulate(bwe, &link, &now_us, 20000000, &time_us);
+    trtp_bwe_get_stats(bwe, &stats);
+    TSK_DEBUG_INFO("BWE capacity=%dkbps: target=%dkbps (delay=%dkbps, loss=%dkbps, acked=%dkbps), converged in %lldms",
+                   link.capacity_kbps, kbps, stats.delay_based_kbps, stats.loss_based_kbps, stats.acked_kbps, time_us / 1000);
+    if (kbps > link.capacity_kbps || kbps < (link.capacity_kbps * 6) / 10) {
+        TSK_DEBUG_ERROR("BWE did not converge");
+    }
+
+    // capacity divided by 3: must follow within a second
+    link.capacity_kbps = 500;
+    kbps = test_bwe_simulate(bwe, &link, &now_us, 10000000, &time_us);
+    trtp_bwe_get_stats(bwe, &stats);
+    TSK_DEBUG_INFO("BWE capacity=%dkbps: target=%dkbps (delay=%dkbps, loss=%dkbps, acked=%dkbps), converged in %lldms",
+                   link.capacity_kbps, kbps, stats.delay_based_kbps, stats.loss_based_kbps, stats.acked_kbps, time_us / 1000);
+    if (time_us < 0 || time_us > 1000000 || kbps > link.capacity_kbps || kbps < (link.capacity_kbps * 6) / 10) {
+        TSK_DEBUG_ERROR("BWE did not follow the capacity drop");
+    }
+
+    // random losses (20%) without congestion: the loss-based estimate must decrease
+    link.capacity_kbps = 100000;
+    link.loss_modulo = 5;
+    kbps = test_bwe_simulate(bwe, &link, &now_us, 5000000, &time_us);
+    trtp_bwe_get_stats(bwe, &stats);
+    TSK_DEBUG_INFO("BWE 20%% loss: target=%dkbps (delay=%dkbps, loss=%dkbps), loss fraction=%f", kbps, stats.delay_based_kbps, stats.loss_based_kbps, stats.loss_fraction);
+    if (kbps > 200) {
+        TSK_DEBUG_ERROR("BWE did not decrease on loss");
+    }
+
+    TSK_OBJECT_SAFE_FREE(bwe);
+}
+
+void test_bwe()
+{
+    test_bwe_twcc_packet();
+    test_bwe_convergence();
+}
+
+#endif /* TINYRTP_TEST_BWE_H */
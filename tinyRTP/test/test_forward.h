@@ -0,0 +1,230 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef TINYRTP_TEST_FORWARD_H
+#define TINYRTP_TEST_FORWARD_H
+
+#include "tinyrtp/trtp_manager.h"
+#include "tinyrtp/trtp_forward.h"
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+#include "tinyrtp/rtcp/trtp_rtcp_packet.h"
+#include "tinyrtp/rtcp/trtp_rtcp_report_fb.h"
+
+#define TEST_FORWARD_PACKETS	200
+#define TEST_FORWARD_PT_IN		100
+#define TEST_FORWARD_PT_OUT		96
+
+typedef struct test_forward_peer_s {
+    trtp_manager_t* manager;
+    volatile long received;
+    uint16_t seq_num_next;
+    long errors;
+    volatile long fir_count;
+    volatile long nack_count;
+    uint16_t nack_first;
+}
+test_forward_peer_t;
+
+static int test_forward_rtp_cb(const void* callback_data, const struct trtp_rtp_packet_s* packet)
+{
+    test_forward_peer_t* peer = (test_forward_peer_t*)callback_data;
+    if (peer->received && packet->header->seq_num != peer->seq_num_next) {
+        ++peer->errors;
+    }
+    if (packet->header->payload_type != TEST_FORWARD_PT_OUT || packet->payload.size != 160) {
+        ++peer->errors;
+    }
+    peer->seq_num_next = packet->header->seq_num + 1;
+    tsk_atomic_inc(&peer->received);
+    return 0;
+}
+
+static int test_forward_rtcp_cb(const void* callback_data, const struct trtp_rtcp_packet_s* packet)
+{
+    test_forward_peer_t* peer = (test_forward_peer_t*)callback_data;
+    const trtp_rtcp_report_psfb_t* psfb;
+    const trtp_rtcp_report_rtpfb_t* rtpfb;
+    tsk_size_t i = 0;
+    while ((psfb = (const trtp_rtcp_report_psfb_t*)trtp_rtcp_packet_get_at(packet, trtp_rtcp_packet_type_psfb, i++))) {
+        if (psfb->fci_type == trtp_rtcp_psfb_fci_type_fir && ((const trtp_rtcp_report_fb_t*)psfb)->ssrc_media == peer->manager->rtp.ssrc.local) {
+            tsk_atomic_inc(&peer->fir_count);
+        }
+    }
+    i = 0;
+    while ((rtpfb = (const trtp_rtcp_report_rtpfb_t*)trtp_rtcp_packet_get_at(packet, trtp_rtcp_packet_type_rtpfb, i++))) {
+        if (rtpfb->fci_type == trtp_rtcp_rtpfb_fci_type_nack && rtpfb->nack.count && ((const trtp_rtcp_report_fb_t*)rtpfb)->ssrc_media == peer->manager->rtp.ssrc.local) {
+            peer->nack_first = rtpfb->nack.pid[0];
+            tsk_atomic_inc(&peer->nack_count);
+        }
+    }
+    return 0;
+}
+
+static trtp_manager_t* test_forward_create_manager(test_forward_peer_t* peer)
+{
+    trtp_manager_t* manager = trtp_manager_create(tsk_true, "127.0.0.1", tsk_false, tmedia_srtp_type_none, tmedia_srtp_mode_none);
+    if (manager) {
+        trtp_manager_prepare(manager);
+        if (peer) {
+            peer->manager = manager;
+            trtp_manager_set_rtp_callback(manager, test_forward_rtp_cb, peer);
+            trtp_manager_set_rtcp_callback(manager, test_forward_rtcp_cb, peer);
+        }
+    }
+    return manager;
+}
+
+static void test_forward_connect(trtp_manager_t* a, trtp_manager_t* b)
+{
+    trtp_manager_set_rtp_remote(a, b->rtp.public_addr.ip, b->rtp.public_addr.port);
+    trtp_manager_set_rtcp_remote(a, b->rtcp.public_addr.ip, b->rtcp.public_addr.port);
+    trtp_manager_set_rtp_remote(b, a->rtp.public_addr.ip, a->rtp.public_addr.port);
+    trtp_manager_set_rtcp_remote(b, a->rtcp.public_addr.ip, a->rtcp.public_addr.port);
+}
+
+static void test_forward_rewrite()
+{
+    trtp_manager_t *source = test_forward_create_manager(tsk_null), *output = test_forward_create_manager(tsk_null);
+    trtp_forward_link_t* link = trtp_forward_link_create(source, output);
+    trtp_rtp_packet_t* packet = trtp_rtp_packet_create(0x11111111, 65534, 0xFFFFFF00, TEST_FORWARD_PT_IN, tsk_true);
+    uint8_t payload[160], in[512], out[512];
+    uint16_t seq_num_first = output->rtp.seq_num + 1;
+    tsk_size_t size, i;
+    trtp_rtp_packet_view_t view;
+    const trtp_rtp_packet_t* rewritten;
+
+    memset(payload, 0xD5, sizeof(payload));
+    packet->payload.data_const = payload;
+    packet->payload.size = sizeof(payload);
+    trtp_forward_link_set_payload_type(link, TEST_FORWARD_PT_IN, TEST_FORWARD_PT_OUT);
+
+    for (i = 0; i < 4; ++i) {
+        if (i == 2) {
+            // sender restarted the stream: numbering must continue
+            packet->header->ssrc = 0x22222222;
+            packet->header->seq_num = 1000;
+        }
+        size = trtp_rtp_packet_serialize_to(packet, in, sizeof(in));
+        if (trtp_forward_link_rewrite(link, in, size, out, sizeof(out)) != size || !(rewritten = trtp_rtp_packet_view_init(&view, out, size))) {
+            TSK_DEBUG_ERROR("Failed to rewrite packet %u", (unsigned)i);
+            continue;
+        }
+        if (rewritten->header->ssrc != output->rtp.ssrc.local || rewritten->header->seq_num != (uint16_t)(seq_num_first + i)
+                || rewritten->header->payload_type != TEST_FORWARD_PT_OUT || !rewritten->header->marker
+                || rewritten->payload.size != sizeof(payload) || memcmp(rewritten->payload.data, payload, sizeof(payload))) {
+            TSK_DEBUG_ERROR("Packet %u not rewritten as expected", (unsigned)i);
+        }
+        ++packet->header->seq_num;
+        packet->header->timestamp += 160;
+    }
+
+    trtp_forward_link_set_payload_type(link, TEST_FORWARD_PT_IN, TRTP_FORWARD_PT_DROP);
+    if (trtp_forward_link_rewrite(link, in, size, out, sizeof(out)) != 0) {
+        TSK_DEBUG_ERROR("Packet with dropped payload type rewritten");
+    }
+
+    packet->payload.data_const = tsk_null;
+    TSK_OBJECT_SAFE_FREE(packet);
+    TSK_OBJECT_SAFE_FREE(link);
+    TSK_OBJECT_SAFE_FREE(source);
+    TSK_OBJECT_SAFE_FREE(output);
+}
+
+// sender -> source => output -> receiver
+static void test_forward_loopback()
+{
+    test_forward_peer_t sender, receiver;
+    trtp_manager_t *source, *output;
+    trtp_forward_stats_t stats;
+    uint8_t payload[160];
+    uint16_t nack_seq_num;
+    tsk_size_t i;
+
+    memset(&sender, 0, sizeof(sender));
+    memset(&receiver, 0, sizeof(receiver));
+    memset(payload, 0xD5, sizeof(payload));
+
+    test_forward_create_manager(&sender);
+    test_forward_create_manager(&receiver);
+    source = test_forward_create_manager(tsk_null);
+    output = test_forward_create_manager(tsk_null);
+    test_forward_connect(sender.manager, source);
+    test_forward_connect(output, receiver.manager);
+    trtp_manager_set_payload_type(sender.manager, TEST_FORWARD_PT_IN);
+
+    trtp_manager_forward_add(source, output);
+    trtp_manager_forward_set_payload_type(source, output, TEST_FORWARD_PT_IN, TEST_FORWARD_PT_OUT);
+    if (trtp_manager_forward_add(receiver.manager, output) == 0) {
+        TSK_DEBUG_ERROR("Output linked to two sources");
+    }
+
+    trtp_manager_start(sender.manager);
+    trtp_manager_start(source);
+    trtp_manager_start(output);
+    trtp_manager_start(receiver.manager);
+
+    for (i = 0; i < TEST_FORWARD_PACKETS; ++i) {
+        trtp_manager_send_rtp(sender.manager, payload, sizeof(payload), 160, tsk_false, tsk_true);
+        tsk_thread_sleep(1);
+    }
+    for (i = 0; i < 100 && receiver.received < TEST_FORWARD_PACKETS; ++i) {
+        tsk_thread_sleep(10);
+    }
+    if (receiver.received != TEST_FORWARD_PACKETS || receiver.errors) {
+        TSK_DEBUG_ERROR("received=%ld, errors=%ld", receiver.received, receiver.errors);
+    }
+
+    // two PLI/FIR from the receiver -> a single FIR to the sender
+    trtp_manager_signal_frame_corrupted(receiver.manager, output->rtp.ssrc.local);
+    trtp_manager_signal_frame_corrupted(receiver.manager, output->rtp.ssrc.local);
+    // NACK for the last forwarded packet -> NACK for the last sent packet
+    nack_seq_num = output->rtp.seq_num;
+    trtp_manager_signal_pkt_loss(receiver.manager, output->rtp.ssrc.local, &nack_seq_num, 1);
+    trtp_manager_signal_pkt_loss(receiver.manager, output->rtp.ssrc.local, &nack_seq_num, 1);
+    for (i = 0; i < 100 && (!sender.fir_count || !sender.nack_count); ++i) {
+        tsk_thread_sleep(10);
+    }
+    tsk_thread_sleep(100);
+    if (sender.fir_count != 1 || sender.nack_count != 1 || sender.nack_first != sender.manager->rtp.seq_num) {
+        TSK_DEBUG_ERROR("fir_count=%ld, nack_count=%ld, nack_first=%u", sender.fir_count, sender.nack_count, sender.nack_first);
+    }
+
+    trtp_manager_forward_get_stats(source, output, &stats);
+    TSK_DEBUG_INFO("forwarded=%llu, dropped=%llu, nack_relayed=%llu, pli_relayed=%llu", stats.forwarded, stats.dropped, stats.nack_relayed, stats.pli_relayed);
+
+    trtp_manager_forward_remove(source, output);
+    if (output->forward.link || trtp_manager_forward_remove(source, output) == 0) {
+        TSK_DEBUG_ERROR("Output still linked");
+    }
+
+    TSK_OBJECT_SAFE_FREE(sender.manager);
+    TSK_OBJECT_SAFE_FREE(receiver.manager);
+    TSK_OBJECT_SAFE_FREE(source);
+    TSK_OBJECT_SAFE_FREE(output);
+}
+
+void test_forward()
+{
+    test_forward_rewrite();
+    test_forward_loopback();
+}
+
+#endif /* TINYRTP_TEST_FORWARD_H */
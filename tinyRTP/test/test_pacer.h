@@ -0,0 +1,117 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef TINYRTP_TEST_PACER_H
+#define TINYRTP_TEST_PACER_H
+
+#include "tinyrtp/trtp_pacer.h"
+
+#define TEST_PACER_TARGET_KBPS	1000
+#define TEST_PACER_PKT_SIZE		1200
+#define TEST_PACER_MEDIA_PKTS	80 // key frame: ~96KB
+#define TEST_PACER_RTX_PKTS		5
+#define TEST_PACER_AUDIO_PKTS	5
+
+typedef struct test_pacer_sink_s {
+    volatile long sent;
+    uint64_t times[TEST_PACER_MEDIA_PKTS + TEST_PACER_RTX_PKTS + TEST_PACER_AUDIO_PKTS]; // when sent, indexed by tag
+    int32_t order[TEST_PACER_MEDIA_PKTS + TEST_PACER_RTX_PKTS + TEST_PACER_AUDIO_PKTS]; // tags, in the order sent
+}
+test_pacer_sink_t;
+
+// tags: media within [0, 80), retransmissions within [80, 85) and audio within [85, 90)
+static int test_pacer_send_cb(const void* usrdata, const void* data, tsk_size_t size, int32_t tag)
+{
+    test_pacer_sink_t* sink = (test_pacer_sink_t*)usrdata;
+    if (size != TEST_PACER_PKT_SIZE || ((const uint8_t*)data)[0] != (uint8_t)tag) {
+        TSK_DEBUG_ERROR("Invalid packet with tag=%d", tag);
+    }
+    sink->times[tag] = tsk_time_now();
+    sink->order[sink->sent] = tag;
+    tsk_atomic_inc(&sink->sent);
+    return 0;
+}
+
+void test_pacer()
+{
+    static test_pacer_sink_t sink;
+    struct trtp_pacer_s* pacer;
+    trtp_pacer_stats_t stats;
+    uint8_t packet[TEST_PACER_PKT_SIZE];
+    const long total = (TEST_PACER_MEDIA_PKTS + TEST_PACER_RTX_PKTS + TEST_PACER_AUDIO_PKTS);
+    uint64_t start, duration;
+    int32_t i, first_rtx = -1, last_media = -1;
+
+    memset(&sink, 0, sizeof(sink));
+    if (!(pacer = trtp_pacer_create(test_pacer_send_cb, &sink))) {
+        TSK_DEBUG_ERROR("Failed to create pacer");
+        return;
+    }
+    trtp_pacer_set_target_kbps(pacer, TEST_PACER_TARGET_KBPS);
+    trtp_pacer_start(pacer);
+
+    // key frame sent back-to-back by the encoder then a few retransmissions and audio packets
+    start = tsk_time_now();
+    for (i = 0; i < total; ++i) {
+        memset(packet, (uint8_t)i, sizeof(packet));
+        trtp_pacer_push(pacer, packet, sizeof(packet),
+                        (i < TEST_PACER_MEDIA_PKTS) ? trtp_pacer_priority_media : ((i < (TEST_PACER_MEDIA_PKTS + TEST_PACER_RTX_PKTS)) ? trtp_pacer_priority_retransmission : trtp_pacer_priority_audio),
+                        i);
+    }
+    for (i = (TEST_PACER_MEDIA_PKTS + TEST_PACER_RTX_PKTS); i < total; ++i) {
+        if (!sink.times[i] || (sink.times[i] - start) > 10) {
+            TSK_DEBUG_ERROR("Audio packet %d delayed", i);
+        }
+    }
+    while (sink.sent < total) {
+        tsk_thread_sleep(1);
+    }
+    duration = (tsk_time_now() - start);
+
+    // ~96KB drained at 2.5Mbps: ~300ms instead of a single burst
+    if (duration < 200 || duration > 500) {
+        TSK_DEBUG_ERROR("Burst drained in %llums", duration);
+    }
+    // retransmissions before the remaining media
+    for (i = 0; i < total; ++i) {
+        if (sink.order[i] < TEST_PACER_MEDIA_PKTS) {
+            last_media = i;
+        }
+        else if (sink.order[i] < (TEST_PACER_MEDIA_PKTS + TEST_PACER_RTX_PKTS) && first_rtx < 0) {
+            first_rtx = i;
+        }
+    }
+    if (first_rtx < 0 || first_rtx > last_media) {
+        TSK_DEBUG_ERROR("Retransmissions not sent ahead of the queued media");
+    }
+
+    trtp_pacer_get_stats(pacer, &stats);
+    TSK_DEBUG_INFO("Pacer: burst of %d packets drained in %llums, delayed=%llu, delay_avg=%llums, delay_max=%llums, rate=%dkbps",
+                   (int)total, duration, stats.pkts_delayed, stats.delay_avg, stats.delay_max, stats.rate_kbps);
+    if (stats.pkts_sent != (uint64_t)total || stats.pkts_audio != TEST_PACER_AUDIO_PKTS || stats.pkts_retransmitted != TEST_PACER_RTX_PKTS || stats.pkts_overflow || stats.queue_pkts) {
+        TSK_DEBUG_ERROR("Invalid stats");
+    }
+
+    trtp_pacer_stop(pacer);
+    TSK_OBJECT_SAFE_FREE(pacer);
+}
+
+#endif /* TINYRTP_TEST_PACER_H */
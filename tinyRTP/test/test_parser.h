@@ -291,7 +291,7 @@ char packet_10[] = {
 	/* deserialize the packet*/ \
 	if((packet = trtp_rtp_packet_deserialize(packet_##n, sizeof(packet_##n)))){ \
 		/* serialize the packet */ \
-		if((buffer = trtp_rtp_packet_serialize(packet))){ \
+		if((buffer = trtp_rtp_packet_serialize(packet, 0))){ \
 			/* compare data */ \
 			if(sizeof(packet_##n) != buffer->size){ \
 				TSK_DEBUG_ERROR("Test-%d: Sizes are different", n); \
@@ -319,8 +319,34 @@ char packet_10[] = {
 		TSK_DEBUG_ERROR("Failed to deserialize packet-%d", n); \
 	}
 
+/* parse in place then retain (copy) the view */
+#define MAKE_VIEW_TEST(n) \
+	buffer = tsk_null; \
+	if((packet = trtp_rtp_packet_view_init(&view, packet_##n, sizeof(packet_##n)))){ \
+		if(tsk_object_ref(packet) || packet->payload.data < (void*)packet_##n || (const void*)(((const uint8_t*)packet->payload.data) + packet->payload.size) != (const void*)(packet_##n + sizeof(packet_##n))){ \
+			TSK_DEBUG_ERROR("View-%d: Payload not parsed in place", n); \
+		} \
+		if((packet = trtp_rtp_packet_retain(packet)) && (buffer = trtp_rtp_packet_serialize(packet, 0))){ \
+			if(sizeof(packet_##n) != buffer->size || memcmp(packet_##n, buffer->data, buffer->size)){ \
+				TSK_DEBUG_ERROR("View-%d: Data is different", n); \
+			} \
+			else{ \
+				TSK_DEBUG_INFO("View-%d: OK", n); \
+			} \
+		} \
+		else{ \
+			TSK_DEBUG_ERROR("Failed to retain packet-%d", n); \
+		} \
+		TSK_OBJECT_SAFE_FREE(buffer); \
+		TSK_OBJECT_SAFE_FREE(packet); \
+	} \
+	else{ \
+		TSK_DEBUG_ERROR("Failed to parse packet-%d", n); \
+	}
+
 void test_parser()
 {
+    trtp_rtp_packet_view_t view;
     trtp_rtp_packet_t* packet;
     tsk_buffer_t* buffer;
     tsk_size_t i;
@@ -336,6 +362,11 @@ void test_parser()
     MAKE_TEST(8);
     MAKE_TEST(9);
     MAKE_TEST(10);
+
+    MAKE_VIEW_TEST(0);
+    MAKE_VIEW_TEST(1);
+    MAKE_VIEW_TEST(2);
+    MAKE_VIEW_TEST(10);
 }
 
 
@@ -0,0 +1,140 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef TINYRTP_TEST_PORTS_H
+#define TINYRTP_TEST_PORTS_H
+
+#include "tinyrtp/trtp_ports.h"
+
+#define TEST_PORTS_HOST		"127.0.0.1"
+#define TEST_PORTS_START	40001 // odd: the first pair is 40002/40003
+#define TEST_PORTS_STOP		40020 // 40019 not usable as RTP port
+#define TEST_PORTS_PAIRS	9
+
+void test_ports()
+{
+    struct tnet_socket_s *rtp[TEST_PORTS_PAIRS + 1] = { tsk_null }, *rtcp[TEST_PORTS_PAIRS + 1] = { tsk_null }, *foreign = tsk_null;
+    trtp_ports_stats_t stats;
+    tnet_port_t port;
+    int i;
+
+    // exhaust the range
+    for (i = 0; i < TEST_PORTS_PAIRS; ++i) {
+        if (trtp_ports_bind(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 0, tsk_true, &rtp[i], &rtcp[i]) != 0) {
+            TSK_DEBUG_ERROR("Failed to bind pair #%d", i);
+            goto bail;
+        }
+        if ((rtp[i]->port & 1) || rtcp[i]->port != (rtp[i]->port + 1) || rtp[i]->port < 40002 || rtcp[i]->port > TEST_PORTS_STOP) {
+            TSK_DEBUG_ERROR("Invalid pair %u/%u", rtp[i]->port, rtcp[i]->port);
+        }
+    }
+    if (trtp_ports_bind(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 0, tsk_true, &rtp[i], &rtcp[i]) == 0) {
+        TSK_DEBUG_ERROR("Bound more pairs than the range contains");
+    }
+    trtp_ports_get_stats(TEST_PORTS_START, TEST_PORTS_STOP, &stats);
+    if (stats.pairs_total != TEST_PORTS_PAIRS || stats.pairs_used != TEST_PORTS_PAIRS || !stats.exhausted) {
+        TSK_DEBUG_ERROR("Invalid stats");
+    }
+
+    // the released pair is the only free one
+    port = rtp[3]->port;
+    TSK_OBJECT_SAFE_FREE(rtp[3]);
+    TSK_OBJECT_SAFE_FREE(rtcp[3]);
+    trtp_ports_release(port);
+    if (trtp_ports_bind(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 0, tsk_true, &rtp[3], &rtcp[3]) != 0 || rtp[3]->port != port) {
+        TSK_DEBUG_ERROR("Released pair not reused");
+    }
+
+    // pair used by another process: skipped, then deterministic failure
+    port = rtp[5]->port;
+    TSK_OBJECT_SAFE_FREE(rtp[5]);
+    TSK_OBJECT_SAFE_FREE(rtcp[5]);
+    trtp_ports_release(port);
+    foreign = tnet_socket_create(TEST_PORTS_HOST, port + 1, tnet_socket_type_udp_ipv4);
+    if (trtp_ports_bind(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, port, tsk_true, &rtp[5], &rtcp[5]) == 0) {
+        TSK_DEBUG_ERROR("Bound to a port used by another socket");
+    }
+    TSK_OBJECT_SAFE_FREE(foreign);
+    if (trtp_ports_bind(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 0, tsk_true, &rtp[5], &rtcp[5]) != 0 || rtp[5]->port != port) {
+        TSK_DEBUG_ERROR("Pair not reused once free");
+    }
+    trtp_ports_get_stats(TEST_PORTS_START, TEST_PORTS_STOP, &stats);
+    if (!stats.bind_failures) {
+        TSK_DEBUG_ERROR("Invalid stats");
+    }
+
+    // release all, then the hint is honored
+    for (i = 0; i < TEST_PORTS_PAIRS; ++i) {
+        port = rtp[i]->port;
+        TSK_OBJECT_SAFE_FREE(rtp[i]);
+        TSK_OBJECT_SAFE_FREE(rtcp[i]);
+        trtp_ports_release(port);
+    }
+    if (trtp_ports_bind(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 40010, tsk_false, &rtp[0], tsk_null) != 0 || rtp[0]->port != 40010) {
+        TSK_DEBUG_ERROR("Hint not honored");
+    }
+    port = rtp[0] ? rtp[0]->port : 0;
+    TSK_OBJECT_SAFE_FREE(rtp[0]);
+    if (port) {
+        trtp_ports_release(port);
+    }
+
+    // pairs bound ahead of time, replenished on release
+    if (trtp_ports_warm_up(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 2) != 0) {
+        TSK_DEBUG_ERROR("Failed to bind pairs ahead of time");
+    }
+    trtp_ports_get_stats(TEST_PORTS_START, TEST_PORTS_STOP, &stats);
+    if (stats.pairs_warm != 2 || stats.pairs_used != 2) {
+        TSK_DEBUG_ERROR("Invalid stats");
+    }
+    if (trtp_ports_bind(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 0, tsk_true, &rtp[0], &rtcp[0]) != 0) {
+        TSK_DEBUG_ERROR("Failed to take pre-bound pair");
+    }
+    port = rtp[0] ? rtp[0]->port : 0;
+    TSK_OBJECT_SAFE_FREE(rtp[0]);
+    TSK_OBJECT_SAFE_FREE(rtcp[0]);
+    if (port) {
+        trtp_ports_release(port);
+    }
+    trtp_ports_get_stats(TEST_PORTS_START, TEST_PORTS_STOP, &stats);
+    TSK_DEBUG_INFO("Ports: total=%u, used=%u, warm=%u, acquired=%llu, warm_hits=%llu, bind_failures=%llu, exhausted=%llu",
+                   (unsigned)stats.pairs_total, (unsigned)stats.pairs_used, (unsigned)stats.pairs_warm, stats.acquired, stats.warm_hits, stats.bind_failures, stats.exhausted);
+    if (stats.pairs_warm != 2 || stats.pairs_used != 2 || stats.warm_hits != 1) {
+        TSK_DEBUG_ERROR("Invalid stats");
+    }
+    trtp_ports_warm_up(TEST_PORTS_HOST, tnet_socket_type_udp_ipv4, TEST_PORTS_START, TEST_PORTS_STOP, 0);
+    trtp_ports_get_stats(TEST_PORTS_START, TEST_PORTS_STOP, &stats);
+    if (stats.pairs_warm || stats.pairs_used) {
+        TSK_DEBUG_ERROR("Invalid stats");
+    }
+
+bail:
+    for (i = 0; i <= TEST_PORTS_PAIRS; ++i) {
+        if (rtp[i]) {
+            port = rtp[i]->port;
+            TSK_OBJECT_SAFE_FREE(rtp[i]);
+            TSK_OBJECT_SAFE_FREE(rtcp[i]);
+            trtp_ports_release(port);
+        }
+    }
+}
+
+#endif /* TINYRTP_TEST_PORTS_H */
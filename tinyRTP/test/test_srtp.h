@@ -0,0 +1,142 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef TINYRTP_TEST_SRTP_H
+#define TINYRTP_TEST_SRTP_H
+
+#include "tinyrtp/trtp_srtp.h"
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+
+#include "tsk_time.h"
+
+#define TEST_SRTP_CHUNKS		50
+#define TEST_SRTP_CHUNK_PKTS	4096 /* packets timed together (the clock resolution is 1ms) */
+#define TEST_SRTP_PACKETS		(TEST_SRTP_CHUNKS * TEST_SRTP_CHUNK_PKTS)
+#define TEST_SRTP_PAY_SIZE		1200 /* video */
+#define TEST_SRTP_PKT_SIZE		(TEST_SRTP_PAY_SIZE + TRTP_RTP_HEADER_MIN_SIZE + SRTP_MAX_TRAILER_LEN + 4)
+
+#if HAVE_SRTP
+// packets/sec on a single core for srtp_protect() and srtp_unprotect(), encrypting in place
+static void test_srtp_bench(trtp_srtp_crypto_type_t type)
+{
+    static trtp_srtp_ctx_internal_xt ctx_out, ctx_in;
+    static uint8_t buffers[TEST_SRTP_CHUNK_PKTS][TEST_SRTP_PKT_SIZE];
+    static int sizes[TEST_SRTP_CHUNK_PKTS];
+    trtp_rtp_packet_t* packet = trtp_rtp_packet_create(0x12345678, 0, 0, 96, tsk_false);
+    uint8_t payload[TEST_SRTP_PAY_SIZE];
+    uint64_t time_protect = 0, time_unprotect = 0, start;
+    int32_t tag, crypto_type;
+    tsk_size_t i, j;
+    int errors = 0;
+    char* line = tsk_null;
+
+    memset(&ctx_out, 0, sizeof(ctx_out));
+    memset(&ctx_in, 0, sizeof(ctx_in));
+    memset(payload, 0xD5, sizeof(payload));
+    packet->payload.data_const = payload;
+    packet->payload.size = sizeof(payload);
+
+    if (trtp_srtp_ctx_internal_init(&ctx_out, 1, type, packet->header->ssrc) != 0) {
+        TSK_DEBUG_ERROR("Failed to create SRTP context for '%s'", trtp_srtp_crypto_type_strings[type]);
+        goto bail;
+    }
+    // SDES "crypto" line must match the profile
+    tsk_sprintf(&line, "%d %s inline:%s", ctx_out.tag, trtp_srtp_crypto_type_strings[type], ctx_out.key_str);
+    if (trtp_srtp_match_line(line, &tag, &crypto_type, tsk_null, 0) != 0 || crypto_type != type) {
+        TSK_DEBUG_ERROR("Failed to match '%s'", line);
+    }
+    // receiver: same key||salt
+    ctx_in.policy = ctx_out.policy;
+    ctx_in.policy.key = (unsigned char*)ctx_out.key_bin;
+    ctx_in.policy.ssrc.type = ssrc_any_inbound;
+    if (srtp_create(&ctx_in.session, &ctx_in.policy) != err_status_ok) {
+        TSK_DEBUG_ERROR("srtp_create() failed");
+        goto bail;
+    }
+    ctx_in.initialized = tsk_true;
+
+    for (i = 0; i < TEST_SRTP_CHUNKS; ++i) {
+        for (j = 0; j < TEST_SRTP_CHUNK_PKTS; ++j) {
+            packet->header->seq_num = (uint16_t)((i * TEST_SRTP_CHUNK_PKTS) + j);
+            packet->header->timestamp = (uint32_t)((((i * TEST_SRTP_CHUNK_PKTS) + j) / 30) * 3000);
+            sizes[j] = (int)trtp_rtp_packet_serialize_to(packet, buffers[j], sizeof(buffers[j]));
+        }
+
+        start = tsk_time_now();
+        for (j = 0; j < TEST_SRTP_CHUNK_PKTS; ++j) {
+            if (srtp_protect(ctx_out.session, buffers[j], &sizes[j]) != err_status_ok) {
+                ++errors;
+            }
+        }
+        time_protect += (tsk_time_now() - start);
+
+        start = tsk_time_now();
+        for (j = 0; j < TEST_SRTP_CHUNK_PKTS; ++j) {
+            if (srtp_unprotect(ctx_in.session, buffers[j], &sizes[j]) != err_status_ok) {
+                ++errors;
+            }
+        }
+        time_unprotect += (tsk_time_now() - start);
+
+        for (j = 0; j < TEST_SRTP_CHUNK_PKTS; ++j) {
+            if (sizes[j] != (int)(TRTP_RTP_HEADER_MIN_SIZE + sizeof(payload)) || memcmp(&buffers[j][TRTP_RTP_HEADER_MIN_SIZE], payload, sizeof(payload))) {
+                ++errors;
+            }
+        }
+    }
+
+    TSK_DEBUG_INFO("SRTP %s: protect=%llu pkts/sec, unprotect=%llu pkts/sec (%u bytes, %d errors)",
+                   trtp_srtp_crypto_type_strings[type],
+                   (unsigned long long)((TEST_SRTP_PACKETS * 1000) / TSK_MAX(time_protect, 1)),
+                   (unsigned long long)((TEST_SRTP_PACKETS * 1000) / TSK_MAX(time_unprotect, 1)),
+                   (unsigned)sizeof(payload), errors);
+
+bail:
+    trtp_srtp_ctx_internal_deinit(&ctx_out);
+    trtp_srtp_ctx_internal_deinit(&ctx_in);
+    TSK_FREE(line);
+    packet->payload.data_const = tsk_null;
+    TSK_OBJECT_SAFE_FREE(packet);
+}
+#endif /* HAVE_SRTP */
+
+void test_srtp()
+{
+#if HAVE_SRTP
+    int32_t i;
+    static tsk_bool_t __srtp_initialized = tsk_false;
+    if (!__srtp_initialized) {
+        __srtp_initialized = (srtp_init() == err_status_ok);
+    }
+    for (i = 0; i < SRTP_CRYPTO_TYPES_MAX; ++i) {
+        if (trtp_srtp_crypto_type_is_supported((trtp_srtp_crypto_type_t)i)) {
+            test_srtp_bench((trtp_srtp_crypto_type_t)i);
+        }
+        else {
+            TSK_DEBUG_INFO("SRTP %s: not supported", trtp_srtp_crypto_type_strings[i]);
+        }
+    }
+#else
+    TSK_DEBUG_INFO("SRTP not enabled");
+#endif /* HAVE_SRTP */
+}
+
+#endif /* TINYRTP_TEST_SRTP_H */
@@ -0,0 +1,165 @@
+/*
+* Copyright (C) 2012 Doubango Telecom <http://www.doubango.org>
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango.org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef TINYRTP_TEST_WORKER_H
+#define TINYRTP_TEST_WORKER_H
+
+#include "tinyrtp/trtp_worker.h"
+#include "tinyrtp/rtp/trtp_rtp_packet.h"
+
+#define TEST_WORKER_SESSIONS	8
+#define TEST_WORKER_PACKETS		20000
+#define TEST_WORKER_DETACH_AT	5
+
+typedef struct test_worker_session_s {
+    trtp_worker_queue_t* queue;
+    uint16_t seq_num_next;
+    volatile long received;
+    long errors;
+}
+test_worker_session_t;
+
+static int test_worker_cb(const void* callback_data, const struct trtp_rtp_packet_s* packet)
+{
+    test_worker_session_t* session = (test_worker_session_t*)callback_data;
+    // packets from the same session must be decoded in order (no drop in this test)
+    if (packet->header->seq_num != session->seq_num_next || packet->payload.size != 160) {
+        ++session->errors;
+    }
+    session->seq_num_next = packet->header->seq_num + 1;
+    tsk_atomic_inc(&session->received);
+    return 0;
+}
+
+// Detaches its own queue: the packets already queued must not be forwarded anymore
+static int test_worker_cb_detach(const void* callback_data, const struct trtp_rtp_packet_s* packet)
+{
+    test_worker_session_t* session = (test_worker_session_t*)callback_data;
+    if (!packet || packet->header->seq_num != session->seq_num_next) {
+        ++session->errors;
+        return 0;
+    }
+    session->seq_num_next = packet->header->seq_num + 1;
+    if (session->received == 0) {
+        tsk_thread_sleep(50); // let the network thread fill the queue
+    }
+    tsk_atomic_inc(&session->received);
+    if (session->received == TEST_WORKER_DETACH_AT) {
+        trtp_worker_queue_detach(session->queue);
+    }
+    return 0;
+}
+
+static void test_worker_detach_from_callback(trtp_rtp_packet_t* packet)
+{
+    test_worker_session_t session;
+    trtp_rtp_packet_view_t view;
+    trtp_worker_stats_t stats;
+    uint8_t buffer[512];
+    tsk_size_t size, i;
+
+    memset(&session, 0, sizeof(session));
+    tmedia_defaults_set_media_workers(1, tsk_false);
+    session.queue = trtp_worker_queue_create(test_worker_cb_detach, &session);
+    if (trtp_worker_queue_attach(session.queue) != 0) {
+        TSK_DEBUG_ERROR("Failed to attach queue");
+    }
+    for (i = 0; i < (TEST_WORKER_DETACH_AT << 2); ++i) {
+        packet->header->seq_num = (uint16_t)i;
+        size = trtp_rtp_packet_serialize_to(packet, buffer, sizeof(buffer));
+        trtp_worker_queue_push(session.queue, trtp_rtp_packet_view_init(&view, buffer, size));
+    }
+    while (session.queue->worker) {
+        tsk_thread_sleep(1);
+    }
+    tsk_thread_sleep(50); // would be called again by now
+    trtp_worker_queue_get_stats(session.queue, &stats);
+    if (session.errors || session.received != TEST_WORKER_DETACH_AT || stats.depth) {
+        TSK_DEBUG_ERROR("Detached from the callback: errors=%ld, received=%ld, pending=%u", session.errors, session.received, (unsigned)stats.depth);
+    }
+    TSK_OBJECT_SAFE_FREE(session.queue);
+    tmedia_defaults_set_media_workers(0, tsk_false);
+}
+
+void test_worker()
+{
+    test_worker_session_t sessions[TEST_WORKER_SESSIONS];
+    trtp_rtp_packet_t* packet = trtp_rtp_packet_create(0x12345678, 0, 0, 0, tsk_false);
+    trtp_rtp_packet_view_t view;
+    trtp_worker_stats_t stats;
+    uint8_t payload[160], buffer[512];
+    tsk_size_t size, i, j;
+    uint64_t start;
+
+    memset(payload, 0xD5, sizeof(payload));
+    memset(sessions, 0, sizeof(sessions));
+    packet->payload.data_const = payload;
+    packet->payload.size = sizeof(payload);
+
+    tmedia_defaults_set_media_workers(2, tsk_false);
+    for (j = 0; j < TEST_WORKER_SESSIONS; ++j) {
+        sessions[j].queue = trtp_worker_queue_create(test_worker_cb, &sessions[j]);
+        if (trtp_worker_queue_attach(sessions[j].queue) != 0) {
+            TSK_DEBUG_ERROR("Failed to attach queue");
+        }
+    }
+
+    start = tsk_time_now();
+    for (i = 0; i < TEST_WORKER_PACKETS; ++i) {
+        packet->header->seq_num = (uint16_t)i;
+        packet->header->timestamp = (uint32_t)(i * 160);
+        size = trtp_rtp_packet_serialize_to(packet, buffer, sizeof(buffer));
+        for (j = 0; j < TEST_WORKER_SESSIONS; ++j) {
+            // parsed in place (as the network thread does) and retained by the queue
+            while (trtp_worker_queue_push(sessions[j].queue, trtp_rtp_packet_view_init(&view, buffer, size)) == -3) {
+                --sessions[j].queue->stats.dropped; // not a real drop: retry
+                tsk_thread_sleep(1);
+            }
+        }
+    }
+    for (j = 0; j < TEST_WORKER_SESSIONS; ++j) {
+        while (sessions[j].received < TEST_WORKER_PACKETS) {
+            tsk_thread_sleep(1);
+        }
+    }
+    TSK_DEBUG_INFO("%u packets decoded by the media workers in %llu ms", (unsigned)(TEST_WORKER_PACKETS * TEST_WORKER_SESSIONS), (tsk_time_now() - start));
+
+    for (j = 0; j < TEST_WORKER_SESSIONS; ++j) {
+        trtp_worker_queue_get_stats(sessions[j].queue, &stats);
+        if (sessions[j].errors || stats.processed != TEST_WORKER_PACKETS || stats.dropped) {
+            TSK_DEBUG_ERROR("Session %u: errors=%ld, processed=%llu, dropped=%llu", (unsigned)j, sessions[j].errors, stats.processed, stats.dropped);
+        }
+        trtp_worker_queue_detach(sessions[j].queue);
+        // detached: packets are not forwarded anymore
+        if (trtp_worker_queue_push(sessions[j].queue, trtp_rtp_packet_view_init(&view, buffer, size)) == 0) {
+            TSK_DEBUG_ERROR("Packet pushed to a detached queue");
+        }
+        TSK_OBJECT_SAFE_FREE(sessions[j].queue);
+    }
+    tmedia_defaults_set_media_workers(0, tsk_false);
+
+    test_worker_detach_from_callback(packet);
+
+    packet->payload.data_const = tsk_null;
+    TSK_OBJECT_SAFE_FREE(packet);
+}
+
+#endif /* TINYRTP_TEST_WORKER_H */
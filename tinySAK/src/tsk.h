@@ -54,6 +54,7 @@ TSK_BEGIN_DECLS
 #include "tsk_runnable.h"
 #include "tsk_safeobj.h"
 #include "tsk_object.h"
+#include "tsk_object_cache.h"
 
 #include "tsk_debug.h"
 
@@ -29,6 +29,7 @@
  */
 #include "tsk_mutex.h"
 #include "tsk_memory.h"
+#include "tsk_common.h"
 #include "tsk_debug.h"
 
 #if TSK_UNDER_WINDOWS
@@ -112,6 +113,27 @@ tsk_mutex_handle_t* tsk_mutex_create_2(tsk_bool_t recursive)
     return handle;
 }
 
+/**@ingroup tsk_mutex_group
+* Gets the process-wide recursive mutex stored in @a handle, created on first use. Used to protect static state without an explicit initialization.
+* Concurrent first calls each create a mutex but only one is kept. The mutex is never destroyed.
+* @param handle The static handle, initially null.
+* @retval The mutex handle or null if the creation failed.
+*/
+tsk_mutex_handle_t* tsk_mutex_get_once(tsk_mutex_handle_t* volatile* handle)
+{
+    tsk_mutex_handle_t* mutex;
+    if(!handle) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if(!*handle && (mutex = tsk_mutex_create())) {
+        if(!tsk_atomic_cas(handle, tsk_null, mutex)) {
+            tsk_mutex_destroy(&mutex); // created by another thread
+        }
+    }
+    return *handle;
+}
+
 /**@ingroup tsk_mutex_group
 * Lock a mutex. You must use @ref tsk_mutex_unlock to unlock the mutex.
 * @param handle The handle of the mutex to lock.
@@ -41,6 +41,7 @@ typedef void tsk_mutex_handle_t;
 
 TINYSAK_API tsk_mutex_handle_t* tsk_mutex_create();
 TINYSAK_API tsk_mutex_handle_t* tsk_mutex_create_2(tsk_bool_t recursive);
+TINYSAK_API tsk_mutex_handle_t* tsk_mutex_get_once(tsk_mutex_handle_t* volatile* handle);
 TINYSAK_API int tsk_mutex_lock(tsk_mutex_handle_t* handle);
 TINYSAK_API int tsk_mutex_unlock(tsk_mutex_handle_t* handle);
 TINYSAK_API void tsk_mutex_destroy(tsk_mutex_handle_t** handle);
@@ -22,6 +22,7 @@
  *
  */
 #include "tsk_object.h"
+#include "tsk_object_cache.h"
 #include "tsk_memory.h"
 #include "tsk_debug.h"
 #include "tsk_common.h"
@@ -51,7 +52,10 @@ static int tsk_objects_count = 0;
 tsk_object_t* tsk_object_new(const tsk_object_def_t *objdef, ...)
 {
     // Do not check "objdef", let the application die if it's null
-    tsk_object_t *newobj = tsk_calloc(1, objdef->size);
+    tsk_object_t *newobj;
+    if (!tsk_object_cache_alloc(objdef, &newobj)) {
+        newobj = tsk_calloc(1, objdef->size);
+    }
     if(newobj) {
         (*(const tsk_object_def_t **) newobj) = objdef;
         TSK_OBJECT_HEADER(newobj)->refCount = 1;
@@ -66,7 +70,9 @@ tsk_object_t* tsk_object_new(const tsk_object_def_t *objdef, ...)
                 if(objdef->destructor) {
                     objdef->destructor(newobj_);
                 }
-                tsk_free(&newobj_);
+                if (!tsk_object_cache_free(objdef, newobj_)) {
+                    tsk_free(&newobj_);
+                }
             }
 
 #if TSK_DEBUG_OBJECTS
@@ -93,7 +99,10 @@ tsk_object_t* tsk_object_new(const tsk_object_def_t *objdef, ...)
 */
 tsk_object_t* tsk_object_new_2(const tsk_object_def_t *objdef, va_list* ap)
 {
-    tsk_object_t *newobj = tsk_calloc(1, objdef->size);
+    tsk_object_t *newobj;
+    if (!tsk_object_cache_alloc(objdef, &newobj)) {
+        newobj = tsk_calloc(1, objdef->size);
+    }
     if (newobj) {
         (*(const tsk_object_def_t **) newobj) = objdef;
         TSK_OBJECT_HEADER(newobj)->refCount = 1;
@@ -220,8 +229,9 @@ void tsk_object_delete(tsk_object_t *self)
 {
     const tsk_object_def_t ** objdef = (const tsk_object_def_t **)self;
     if(self && *objdef) {
-        if ((*objdef)->destructor) {
-            self = (*objdef)->destructor(self);
+        const tsk_object_def_t* def = *objdef; // the destructor could clear the header
+        if (def->destructor) {
+            self = def->destructor(self);
 #if TSK_DEBUG_OBJECTS
             TSK_DEBUG_INFO("N∞ objects:%d", --tsk_objects_count);
 #endif
@@ -229,7 +239,7 @@ void tsk_object_delete(tsk_object_t *self)
         else {
             TSK_DEBUG_WARN("No destructor found.");
         }
-        if (self) {
+        if (self && !tsk_object_cache_free(def, self)) {
             free(self);
         }
     }
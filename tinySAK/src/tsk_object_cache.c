@@ -0,0 +1,429 @@
+/* Copyright (C) 2010-2015 Mamadou DIOP.
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tsk_object_cache.c
+ * @brief Per-type object caches used by @ref tsk_object_new() and @ref tsk_object_delete().
+ * Each cached type has a depot of free objects (locked) and each thread has its own magazine of free objects
+ * (lock-free) refilled/drained from/to the depot @ref TSK_OBJECT_CACHE_MAGAZINE_SIZE objects at a time.
+ */
+#include "tsk_object_cache.h"
+#include "tsk_mutex.h"
+#include "tsk_memory.h"
+#include "tsk_time.h"
+#include "tsk_debug.h"
+
+#if TSK_UNDER_WINDOWS
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#endif
+
+/**@defgroup tsk_object_cache_group Per-type object caches.
+* @brief Recycles the memory of short-lived objects instead of calling calloc()/free() for each of them.
+*/
+
+// Thread-local magazines need a destructor to give the objects back when the thread exits:
+// fiber local storage on Windows desktop and pthread keys elsewhere. Otherwise only the (locked) depots are used.
+#if TSK_UNDER_WINDOWS_RT || TSK_UNDER_WINDOWS_CE
+#	define TSK_OBJECT_CACHE_HAVE_TLS 0
+#else
+#	define TSK_OBJECT_CACHE_HAVE_TLS 1
+#endif
+
+// open addressing table indexed by the definition's address
+#define TSK_OBJECT_CACHE_TABLE_SIZE (TSK_OBJECT_CACHE_MAX_TYPES << 1)
+
+typedef struct tsk_object_cache_s {
+    const tsk_object_def_t* objdef;
+    const char* name;
+    tsk_size_t index; // index in "__tsk_object_caches", also used for the thread-local magazines
+    tsk_size_t max_bytes;
+
+    tsk_mutex_handle_t* mutex; // protects the depot and the rate
+    tsk_object_t* depot[TSK_OBJECT_CACHE_DEPOT_SIZE];
+    tsk_size_t depot_count;
+
+    volatile long allocs;
+    volatile long frees;
+    volatile long owned; // objects allocated from the system and not freed yet (live + cached)
+    volatile long failures;
+
+    long rate_allocs;
+    uint64_t rate_time;
+}
+tsk_object_cache_t;
+
+typedef struct tsk_object_magazine_s {
+    tsk_object_t* objects[TSK_OBJECT_CACHE_MAGAZINE_SIZE << 1];
+    tsk_size_t count;
+    long allocs; // not folded into the cache's counters yet
+    long frees;
+}
+tsk_object_magazine_t;
+
+typedef struct tsk_object_magazines_s {
+    tsk_object_magazine_t* magazines[TSK_OBJECT_CACHE_MAX_TYPES];
+}
+tsk_object_magazines_t;
+
+static tsk_object_cache_t* __tsk_object_caches[TSK_OBJECT_CACHE_MAX_TYPES];
+static tsk_object_cache_t* volatile __tsk_object_caches_table[TSK_OBJECT_CACHE_TABLE_SIZE];
+static volatile long __tsk_object_caches_count = 0;
+static tsk_mutex_handle_t* volatile __tsk_object_caches_mutex = tsk_null;
+
+#if TSK_OBJECT_CACHE_HAVE_TLS
+static tsk_bool_t __tsk_object_caches_tls_created = tsk_false;
+#	if TSK_UNDER_WINDOWS
+static DWORD __tsk_object_caches_tls = FLS_OUT_OF_INDEXES;
+#	else
+static pthread_key_t __tsk_object_caches_tls;
+#	endif
+#endif
+
+static tsk_size_t _tsk_object_cache_hash(const tsk_object_def_t* objdef)
+{
+    uintptr_t h = (uintptr_t)objdef;
+    return (tsk_size_t)(((h >> 3) ^ (h >> 11)) % TSK_OBJECT_CACHE_TABLE_SIZE);
+}
+
+static tsk_object_cache_t* _tsk_object_cache_find(const tsk_object_def_t* objdef)
+{
+    tsk_size_t i, h;
+    tsk_object_cache_t* cache;
+    if (!__tsk_object_caches_count) {
+        return tsk_null; // fast path: no cache at all
+    }
+    for (i = 0, h = _tsk_object_cache_hash(objdef); i < TSK_OBJECT_CACHE_TABLE_SIZE; ++i, h = (h + 1) % TSK_OBJECT_CACHE_TABLE_SIZE) {
+        if (!(cache = __tsk_object_caches_table[h])) {
+            return tsk_null;
+        }
+        if (cache->objdef == objdef) {
+            return cache;
+        }
+    }
+    return tsk_null;
+}
+
+static void _tsk_object_cache_fold(tsk_object_cache_t* cache, tsk_object_magazine_t* magazine)
+{
+    if (magazine->allocs) {
+        tsk_atomic_add(&cache->allocs, magazine->allocs);
+        magazine->allocs = 0;
+    }
+    if (magazine->frees) {
+        tsk_atomic_add(&cache->frees, magazine->frees);
+        magazine->frees = 0;
+    }
+}
+
+// moves the objects from the magazine to the depot, returns the extra objects to the system
+static void _tsk_object_cache_drain(tsk_object_cache_t* cache, tsk_object_magazine_t* magazine, tsk_size_t count)
+{
+    tsk_size_t n;
+    tsk_mutex_lock(cache->mutex);
+    n = TSK_MIN(count, (TSK_OBJECT_CACHE_DEPOT_SIZE - cache->depot_count));
+    memcpy(&cache->depot[cache->depot_count], &magazine->objects[magazine->count - n], n * sizeof(tsk_object_t*));
+    cache->depot_count += n;
+    magazine->count -= n;
+    tsk_mutex_unlock(cache->mutex);
+    for (; n < count; ++n) {
+        free(magazine->objects[--magazine->count]);
+        tsk_atomic_dec(&cache->owned);
+    }
+}
+
+static void _tsk_object_cache_refill(tsk_object_cache_t* cache, tsk_object_magazine_t* magazine)
+{
+    tsk_size_t n;
+    tsk_mutex_lock(cache->mutex);
+    n = TSK_MIN(TSK_OBJECT_CACHE_MAGAZINE_SIZE, cache->depot_count);
+    cache->depot_count -= n;
+    memcpy(&magazine->objects[magazine->count], &cache->depot[cache->depot_count], n * sizeof(tsk_object_t*));
+    magazine->count += n;
+    tsk_mutex_unlock(cache->mutex);
+}
+
+#if TSK_OBJECT_CACHE_HAVE_TLS
+static void _tsk_object_cache_thread_exit(void* data)
+{
+    tsk_object_magazines_t* magazines = (tsk_object_magazines_t*)data;
+    tsk_size_t i;
+    if (magazines) {
+        for (i = 0; i < TSK_OBJECT_CACHE_MAX_TYPES; ++i) {
+            if (magazines->magazines[i]) {
+                _tsk_object_cache_drain(__tsk_object_caches[i], magazines->magazines[i], magazines->magazines[i]->count);
+                _tsk_object_cache_fold(__tsk_object_caches[i], magazines->magazines[i]);
+                tsk_free((void**)&magazines->magazines[i]);
+            }
+        }
+        tsk_free((void**)&magazines);
+    }
+}
+#	if TSK_UNDER_WINDOWS
+static VOID WINAPI _tsk_object_cache_thread_exit_fls(PVOID data)
+{
+    _tsk_object_cache_thread_exit(data);
+}
+#	endif
+#endif /* TSK_OBJECT_CACHE_HAVE_TLS */
+
+static tsk_object_magazine_t* _tsk_object_cache_magazine(tsk_object_cache_t* cache)
+{
+#if TSK_OBJECT_CACHE_HAVE_TLS
+    tsk_object_magazines_t* magazines;
+#	if TSK_UNDER_WINDOWS
+    magazines = (tsk_object_magazines_t*)FlsGetValue(__tsk_object_caches_tls);
+#	else
+    magazines = (tsk_object_magazines_t*)pthread_getspecific(__tsk_object_caches_tls);
+#	endif
+    if (!magazines) {
+        if (!(magazines = (tsk_object_magazines_t*)tsk_calloc(1, sizeof(tsk_object_magazines_t)))) {
+            return tsk_null;
+        }
+#	if TSK_UNDER_WINDOWS
+        FlsSetValue(__tsk_object_caches_tls, magazines);
+#	else
+        pthread_setspecific(__tsk_object_caches_tls, magazines);
+#	endif
+    }
+    if (!magazines->magazines[cache->index]) {
+        magazines->magazines[cache->index] = (tsk_object_magazine_t*)tsk_calloc(1, sizeof(tsk_object_magazine_t));
+    }
+    return magazines->magazines[cache->index];
+#else
+    return tsk_null;
+#endif
+}
+
+/**@ingroup tsk_object_cache_group
+* Enables the cache for a type of objects. Should be called before the first object of this type is created.
+* Calling this function again only updates the cap.
+* @param objdef The definition of the objects to cache.
+* @param name Name used by @ref tsk_object_cache_dump(). Must be a static string.
+* @param max_bytes Maximum memory used by the objects of this type (live and cached). Zero means unlimited.
+* Once the cap is reached @ref tsk_object_new() returns null for this type.
+* @retval Zero if succeed and nonzero error code otherwise.
+*/
+int tsk_object_cache_enable(const tsk_object_def_t* objdef, const char* name, tsk_size_t max_bytes)
+{
+#if TSK_OBJECT_CACHE_ENABLED
+    int ret = 0;
+    tsk_size_t h;
+    tsk_object_cache_t* cache;
+
+    if (!objdef || !objdef->size) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    tsk_mutex_lock(tsk_mutex_get_once(&__tsk_object_caches_mutex));
+    if ((cache = _tsk_object_cache_find(objdef))) {
+        cache->max_bytes = max_bytes;
+        goto bail;
+    }
+    if (__tsk_object_caches_count >= TSK_OBJECT_CACHE_MAX_TYPES) {
+        TSK_DEBUG_ERROR("Too many object caches (max=%d)", TSK_OBJECT_CACHE_MAX_TYPES);
+        ret = -2;
+        goto bail;
+    }
+#if TSK_OBJECT_CACHE_HAVE_TLS
+    if (!__tsk_object_caches_tls_created) {
+#	if TSK_UNDER_WINDOWS
+        __tsk_object_caches_tls_created = ((__tsk_object_caches_tls = FlsAlloc(_tsk_object_cache_thread_exit_fls)) != FLS_OUT_OF_INDEXES);
+#	else
+        __tsk_object_caches_tls_created = (pthread_key_create(&__tsk_object_caches_tls, _tsk_object_cache_thread_exit) == 0);
+#	endif
+        if (!__tsk_object_caches_tls_created) {
+            TSK_DEBUG_ERROR("Failed to create the thread-local storage");
+            ret = -3;
+            goto bail;
+        }
+    }
+#endif
+    if (!(cache = (tsk_object_cache_t*)tsk_calloc(1, sizeof(tsk_object_cache_t))) || !(cache->mutex = tsk_mutex_create_2(tsk_false))) {
+        TSK_DEBUG_ERROR("Failed to create object cache");
+        TSK_FREE(cache);
+        ret = -4;
+        goto bail;
+    }
+    cache->objdef = objdef;
+    cache->name = name ? name : "unnamed";
+    cache->max_bytes = max_bytes;
+    cache->index = (tsk_size_t)__tsk_object_caches_count;
+    cache->rate_time = tsk_time_now();
+    __tsk_object_caches[cache->index] = cache;
+
+    for (h = _tsk_object_cache_hash(objdef); __tsk_object_caches_table[h]; h = (h + 1) % TSK_OBJECT_CACHE_TABLE_SIZE) ;
+    tsk_atomic_barrier(); // the cache must be fully initialized before being visible
+    __tsk_object_caches_table[h] = cache;
+    tsk_atomic_inc(&__tsk_object_caches_count);
+
+bail:
+    tsk_mutex_unlock(__tsk_object_caches_mutex);
+    return ret;
+#else
+    return 0;
+#endif /* TSK_OBJECT_CACHE_ENABLED */
+}
+
+/**@ingroup tsk_object_cache_group
+* Checks whether the objects of this type are cached.
+*/
+tsk_bool_t tsk_object_cache_is_enabled(const tsk_object_def_t* objdef)
+{
+    return (_tsk_object_cache_find(objdef) != tsk_null);
+}
+
+/**@ingroup tsk_object_cache_group
+* Gets the counters of a cache.
+* @param objdef The definition of the cached objects.
+* @param stats The counters.
+* @retval Zero if succeed and nonzero error code otherwise.
+*/
+int tsk_object_cache_get_stats(const tsk_object_def_t* objdef, tsk_object_cache_stats_t* stats)
+{
+    tsk_object_cache_t* cache;
+    long allocs, frees, owned;
+    uint64_t now;
+    if (!objdef || !stats) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!(cache = _tsk_object_cache_find(objdef))) {
+        TSK_DEBUG_ERROR("No cache for this type of objects");
+        return -2;
+    }
+    allocs = cache->allocs, frees = cache->frees, owned = cache->owned;
+    stats->name = cache->name;
+    stats->object_size = objdef->size;
+    stats->live = (allocs > frees) ? (tsk_size_t)(allocs - frees) : 0; // objects created before enabling the cache could make it negative
+    stats->cached = (owned > (long)stats->live) ? (tsk_size_t)owned - stats->live : 0;
+    stats->slab_bytes = (stats->live + stats->cached) * objdef->size;
+    stats->max_bytes = cache->max_bytes;
+    stats->allocs = (uint64_t)(unsigned long)allocs;
+    stats->failures = (uint64_t)(unsigned long)cache->failures;
+
+    tsk_mutex_lock(cache->mutex);
+    now = tsk_time_now();
+    stats->allocs_per_sec = (now > cache->rate_time) ? ((double)(allocs - cache->rate_allocs) * 1000.0) / (double)(now - cache->rate_time) : 0.0;
+    cache->rate_allocs = allocs;
+    cache->rate_time = now;
+    tsk_mutex_unlock(cache->mutex);
+    return 0;
+}
+
+/**@ingroup tsk_object_cache_group
+* Prints the counters of all caches (INFO level).
+*/
+int tsk_object_cache_dump()
+{
+    long i;
+    tsk_object_cache_stats_t stats;
+    for (i = 0; i < __tsk_object_caches_count; ++i) {
+        if (tsk_object_cache_get_stats(__tsk_object_caches[i]->objdef, &stats) == 0) {
+            TSK_DEBUG_INFO("Object cache '%s': size=%u, live=%u, cached=%u, bytes=%u/%u, allocs=%llu (%.0f/s), failures=%llu",
+                           stats.name, (unsigned)stats.object_size, (unsigned)stats.live, (unsigned)stats.cached,
+                           (unsigned)stats.slab_bytes, (unsigned)stats.max_bytes, stats.allocs, stats.allocs_per_sec, stats.failures);
+        }
+    }
+    return 0;
+}
+
+/* Allocates a zeroed object. Returns false if the type isn't cached, "*object" is null on failure. */
+tsk_bool_t tsk_object_cache_alloc(const tsk_object_def_t* objdef, tsk_object_t** object)
+{
+    tsk_object_cache_t* cache;
+    tsk_object_magazine_t* magazine;
+    if (!(cache = _tsk_object_cache_find(objdef))) {
+        return tsk_false;
+    }
+    *object = tsk_null;
+    if ((magazine = _tsk_object_cache_magazine(cache))) {
+        if (!magazine->count) {
+            _tsk_object_cache_refill(cache, magazine);
+        }
+        if (magazine->count) {
+            *object = magazine->objects[--magazine->count];
+        }
+    }
+    else {
+        tsk_mutex_lock(cache->mutex);
+        if (cache->depot_count) {
+            *object = cache->depot[--cache->depot_count];
+        }
+        tsk_mutex_unlock(cache->mutex);
+    }
+
+    if (*object) {
+        memset(*object, 0, objdef->size);
+    }
+    else {
+        if (cache->max_bytes && ((tsk_size_t)(cache->owned + 1) * objdef->size) > cache->max_bytes) {
+            tsk_atomic_inc(&cache->failures);
+            TSK_DEBUG_ERROR("Object cache '%s': memory cap reached (%u bytes)", cache->name, (unsigned)cache->max_bytes);
+            return tsk_true;
+        }
+        if (!(*object = tsk_calloc(1, objdef->size))) {
+            return tsk_true;
+        }
+        tsk_atomic_inc(&cache->owned);
+    }
+
+    if (magazine) {
+        if (++magazine->allocs >= TSK_OBJECT_CACHE_MAGAZINE_SIZE) {
+            _tsk_object_cache_fold(cache, magazine);
+        }
+    }
+    else {
+        tsk_atomic_inc(&cache->allocs);
+    }
+    return tsk_true;
+}
+
+/* Gives back an object (already destroyed). Returns false if the type isn't cached. */
+tsk_bool_t tsk_object_cache_free(const tsk_object_def_t* objdef, tsk_object_t* object)
+{
+    tsk_object_cache_t* cache;
+    tsk_object_magazine_t* magazine;
+    if (!(cache = _tsk_object_cache_find(objdef))) {
+        return tsk_false;
+    }
+    if ((magazine = _tsk_object_cache_magazine(cache))) {
+        if (magazine->count == (TSK_OBJECT_CACHE_MAGAZINE_SIZE << 1)) {
+            _tsk_object_cache_drain(cache, magazine, TSK_OBJECT_CACHE_MAGAZINE_SIZE);
+        }
+        magazine->objects[magazine->count++] = object;
+        if (++magazine->frees >= TSK_OBJECT_CACHE_MAGAZINE_SIZE) {
+            _tsk_object_cache_fold(cache, magazine);
+        }
+    }
+    else {
+        tsk_mutex_lock(cache->mutex);
+        if (cache->depot_count < TSK_OBJECT_CACHE_DEPOT_SIZE) {
+            cache->depot[cache->depot_count++] = object, object = tsk_null;
+        }
+        tsk_mutex_unlock(cache->mutex);
+        if (object) {
+            free(object);
+            tsk_atomic_dec(&cache->owned);
+        }
+        tsk_atomic_inc(&cache->frees);
+    }
+    return tsk_true;
+}
@@ -0,0 +1,84 @@
+/* Copyright (C) 2010-2015 Mamadou DIOP.
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tsk_object_cache.h
+ * @brief Per-type object caches used by @ref tsk_object_new() and @ref tsk_object_delete().
+ */
+#ifndef _TINYSAK_OBJECT_CACHE_H_
+#define _TINYSAK_OBJECT_CACHE_H_
+
+#include "tinysak_config.h"
+#include "tsk_object.h"
+
+TSK_BEGIN_DECLS
+
+/**@ingroup tsk_object_cache_group
+* Whether the object caches are compiled in. When disabled @ref tsk_object_cache_enable() is a no-op.
+*/
+#if !defined(TSK_OBJECT_CACHE_ENABLED)
+#	define TSK_OBJECT_CACHE_ENABLED 1
+#endif
+/**@ingroup tsk_object_cache_group
+* Maximum number of object types with a cache.
+*/
+#if !defined(TSK_OBJECT_CACHE_MAX_TYPES)
+#	define TSK_OBJECT_CACHE_MAX_TYPES 64
+#endif
+/**@ingroup tsk_object_cache_group
+* Number of objects moved at once between a thread's magazine and the type's depot.
+*/
+#if !defined(TSK_OBJECT_CACHE_MAGAZINE_SIZE)
+#	define TSK_OBJECT_CACHE_MAGAZINE_SIZE 32
+#endif
+/**@ingroup tsk_object_cache_group
+* Maximum number of free objects kept in a type's depot. Extra objects are returned to the system.
+*/
+#if !defined(TSK_OBJECT_CACHE_DEPOT_SIZE)
+#	define TSK_OBJECT_CACHE_DEPOT_SIZE 2048
+#endif
+
+/**@ingroup tsk_object_cache_group
+* Counters of an object cache. The per-thread counts are folded into the global ones every
+* @ref TSK_OBJECT_CACHE_MAGAZINE_SIZE operations which means the values are approximate.
+*/
+typedef struct tsk_object_cache_stats_s {
+    const char* name;
+    tsk_size_t object_size;
+    tsk_size_t live; /**< Objects in use. */
+    tsk_size_t cached; /**< Free objects kept in the depot and the per-thread magazines. */
+    tsk_size_t slab_bytes; /**< Memory owned by the cache: (live + cached) * object_size. */
+    tsk_size_t max_bytes; /**< Cap on "slab_bytes", zero means unlimited. */
+    uint64_t allocs; /**< Total number of allocations. */
+    uint64_t failures; /**< Allocations refused because of the cap. */
+    double allocs_per_sec; /**< Allocation rate since the previous call to @ref tsk_object_cache_get_stats(). */
+}
+tsk_object_cache_stats_t;
+
+TINYSAK_API int tsk_object_cache_enable(const tsk_object_def_t* objdef, const char* name, tsk_size_t max_bytes);
+TINYSAK_API tsk_bool_t tsk_object_cache_is_enabled(const tsk_object_def_t* objdef);
+TINYSAK_API int tsk_object_cache_get_stats(const tsk_object_def_t* objdef, tsk_object_cache_stats_t* stats);
+TINYSAK_API int tsk_object_cache_dump();
+
+// Internal functions used by tsk_object_new() and tsk_object_delete()
+tsk_bool_t tsk_object_cache_alloc(const tsk_object_def_t* objdef, tsk_object_t** object);
+tsk_bool_t tsk_object_cache_free(const tsk_object_def_t* objdef, tsk_object_t* object);
+
+TSK_END_DECLS
+
+#endif /* _TINYSAK_OBJECT_CACHE_H_ */
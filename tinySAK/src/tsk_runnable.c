@@ -29,13 +29,19 @@
  */
 #include "tsk_runnable.h"
 #include "tsk_thread.h"
+#include "tsk_memory.h"
 #include "tsk_debug.h"
 
 #if TSK_UNDER_WINDOWS
 #	include <windows.h>
 #endif
 
+#if (TSK_RUNNABLE_QUEUE_CAPACITY & (TSK_RUNNABLE_QUEUE_CAPACITY - 1)) || TSK_RUNNABLE_QUEUE_CAPACITY < 2
+#	error "TSK_RUNNABLE_QUEUE_CAPACITY must be a power of two"
+#endif
+
 static void* TSK_STDCALL __async_join(void* self);
+static void _tsk_runnable_signal(tsk_runnable_t *self);
 
 /**@defgroup tsk_runnable_group Base class for runnable object.
 */
@@ -74,14 +80,28 @@ tsk_runnable_t* tsk_runnable_create_2(int32_t priority)
 static int tsk_runnable_init(tsk_runnable_t *self, const tsk_object_def_t *objdef)
 {
     if(self && objdef) {
+        uintptr_t i;
         if(self->initialized) {
             TSK_DEBUG_ERROR("Already initialized");
             return -2;
         }
 
+        if (!(self->queue.cells = (tsk_runnable_cell_t*)tsk_calloc(TSK_RUNNABLE_QUEUE_CAPACITY, sizeof(tsk_runnable_cell_t)))) {
+            TSK_DEBUG_ERROR("Failed to allocate the queue");
+            return -3;
+        }
+        for (i = 0; i < TSK_RUNNABLE_QUEUE_CAPACITY; ++i) {
+            self->queue.cells[i].sequence = i;
+        }
+        self->queue.mask = TSK_RUNNABLE_QUEUE_CAPACITY - 1;
+        self->queue.head = self->queue.tail = 0;
+        self->queue.overflow = tsk_list_create();
+        self->queue.spilled = tsk_null;
+        self->queue.overflow_count = 0;
+        self->queue.sleeping = 0;
+
         self->semaphore = tsk_semaphore_create();
         self->objdef = objdef;
-        self->objects = tsk_list_create();
 
         self->initialized = tsk_true;
         return 0;
@@ -99,6 +119,7 @@ static int tsk_runnable_init(tsk_runnable_t *self, const tsk_object_def_t *objde
 static int tsk_runnable_deinit(tsk_runnable_t *self)
 {
     if(self) {
+        tsk_object_t* object;
         if(!self->initialized) {
             return 0; /* Already deinitialized */
         }
@@ -107,8 +128,13 @@ static int tsk_runnable_deinit(tsk_runnable_t *self)
             return -3;
         }
 
+        /* drop the objects not consumed yet */
+        while ((object = tsk_runnable_pop(self))) {
+            TSK_OBJECT_SAFE_FREE(object);
+        }
         tsk_semaphore_destroy(&self->semaphore);
-        TSK_OBJECT_SAFE_FREE(self->objects);
+        TSK_FREE(self->queue.cells);
+        TSK_OBJECT_SAFE_FREE(self->queue.overflow);
 
         self->initialized = tsk_false;
 
@@ -237,7 +263,7 @@ int tsk_runnable_stop(tsk_runnable_t *self)
 
 stop:
         self->running = tsk_false;
-        tsk_semaphore_increment(self->semaphore);
+        _tsk_runnable_signal(self);
         // To avoid deadlock we don't join() the thread if this funcion is called from the "run()" function
         // setting "self::running" to false is enough to exit the thread after the call to "TSK_RUNNABLE_RUN_BEGIN(self)"
         id_curr_thread = tsk_thread_get_id();
@@ -267,6 +293,160 @@ stop:
     return ret;
 }
 
+/**@ingroup tsk_runnable_group
+* Enqueues an object to be consumed by the runnable's thread. Lock-free unless the queue is full.
+* @param self The runnable object.
+* @param object The object to enqueue. The queue takes the ownership: @a *object is set to null.
+* @retval Zero if succeed and nonzero error code otherwise.
+*/
+int tsk_runnable_enqueue_object(tsk_runnable_t *self, tsk_object_t** object)
+{
+#if TSK_HAVE_ATOMIC_CAS
+    tsk_runnable_cell_t* cell;
+    uintptr_t pos;
+    intptr_t dif;
+#endif
+    if (!self || !object || !*object) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if (!self->initialized) {
+        TSK_DEBUG_WARN("Invalid/uninitialized runnable object.");
+        TSK_OBJECT_SAFE_FREE(*object);
+        return -2;
+    }
+
+#if TSK_HAVE_ATOMIC_CAS
+    // once the ring overflowed, keep using the overflow list until it's drained to preserve FIFO order
+    if (self->queue.overflow_count == 0) {
+        pos = self->queue.head;
+        for (;;) {
+            cell = &self->queue.cells[pos & self->queue.mask];
+            dif = (intptr_t)cell->sequence - (intptr_t)pos;
+            if (dif == 0) {
+                if (tsk_atomic_cas(&self->queue.head, pos, pos + 1)) {
+                    cell->object = *object;
+                    *object = tsk_null;
+                    tsk_atomic_barrier(); // "object" must be visible before "sequence"
+                    cell->sequence = pos + 1;
+                    goto signal;
+                }
+            }
+            else if (dif < 0) {
+                break; // full
+            }
+            pos = self->queue.head;
+        }
+    }
+#endif
+
+    tsk_list_lock(self->queue.overflow);
+    tsk_list_push_back_data(self->queue.overflow, (void**)object);
+    tsk_atomic_inc(&self->queue.overflow_count);
+    tsk_list_unlock(self->queue.overflow);
+
+#if TSK_HAVE_ATOMIC_CAS
+signal:
+#endif
+    _tsk_runnable_signal(self);
+    return 0;
+}
+
+/**@ingroup tsk_runnable_group
+* Pops the first enqueued object. Must only be called from the runnable's thread (single consumer).
+* @param self The runnable object.
+* @retval The object (the caller takes the ownership) or null if the queue is empty or if the next object is still being enqueued.
+*/
+tsk_object_t* tsk_runnable_pop(tsk_runnable_t *self)
+{
+    tsk_object_t* object = tsk_null;
+    tsk_list_item_t* item;
+#if TSK_HAVE_ATOMIC_CAS
+    tsk_runnable_cell_t* cell;
+#endif
+    if (!self || !self->initialized) {
+        return tsk_null;
+    }
+#if TSK_HAVE_ATOMIC_CAS
+    cell = &self->queue.cells[self->queue.tail & self->queue.mask];
+    if (cell->sequence == self->queue.tail + 1) {
+        tsk_atomic_barrier(); // read "object" after "sequence"
+        object = cell->object;
+        cell->object = tsk_null;
+        tsk_atomic_barrier(); // release the slot only when "object" is read
+        cell->sequence = self->queue.tail + self->queue.mask + 1;
+        ++self->queue.tail;
+        return object;
+    }
+    if (self->queue.head != self->queue.tail) {
+        // slot claimed but not published yet: older than the spilled objects, the caller retries (not empty) until it's published
+        return tsk_null;
+    }
+#endif
+    if (self->queue.overflow_count > 0) {
+        if (!self->queue.spilled) {
+            // take the whole list to lock only once per burst
+            tsk_list_lock(self->queue.overflow);
+            self->queue.spilled = self->queue.overflow->head;
+            self->queue.overflow->head = self->queue.overflow->tail = tsk_null;
+            tsk_list_unlock(self->queue.overflow);
+        }
+        if ((item = self->queue.spilled)) {
+            self->queue.spilled = item->next;
+            item->next = tsk_null;
+            object = item->data, item->data = tsk_null;
+            TSK_OBJECT_SAFE_FREE(item);
+            tsk_atomic_dec(&self->queue.overflow_count); // only now: the producers keep spilling while older objects are pending
+        }
+    }
+    return object;
+}
+
+/**@ingroup tsk_runnable_group
+* Checks whether the queue is empty. Slots claimed by a producer but not published yet are counted.
+*/
+tsk_bool_t tsk_runnable_is_empty(const tsk_runnable_t *self)
+{
+    if (!self || !self->initialized) {
+        return tsk_true;
+    }
+    return (self->queue.head == self->queue.tail && self->queue.overflow_count == 0);
+}
+
+/**@ingroup tsk_runnable_group
+* Blocks the runnable's thread until the queue is not empty or the runnable is stopped.
+* The producers only signal the semaphore when the consumer is sleeping which means a burst of
+* enqueued objects costs at most one wakeup.
+*/
+int tsk_runnable_wait(tsk_runnable_t *self)
+{
+    if (!self || !self->initialized) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    while (self->running && tsk_runnable_is_empty(self)) {
+        self->queue.sleeping = 1;
+        tsk_atomic_barrier(); // publish "sleeping" before checking the queue again
+        if (!self->running || !tsk_runnable_is_empty(self)) {
+            if (!tsk_atomic_cas(&self->queue.sleeping, 1, 0)) {
+                // a producer already took the flag: consume its signal to keep the semaphore balanced
+                tsk_semaphore_decrement(self->semaphore);
+            }
+            break;
+        }
+        tsk_semaphore_decrement(self->semaphore);
+    }
+    return 0;
+}
+
+static void _tsk_runnable_signal(tsk_runnable_t *self)
+{
+    tsk_atomic_barrier(); // publish the queue (or "running") before checking "sleeping"
+    if (self->queue.sleeping && tsk_atomic_cas(&self->queue.sleeping, 1, 0)) {
+        tsk_semaphore_increment(self->semaphore);
+    }
+}
+
 static void* TSK_STDCALL __async_join(void* arg)
 {
     tsk_runnable_t *self = (tsk_runnable_t *)arg;
@@ -47,6 +47,23 @@ typedef void* (TSK_STDCALL *tsk_runnable_func_run)(void* self);
 */
 #define TSK_RUNNABLE(self)	((tsk_runnable_t*)(self))
 
+/**@ingroup tsk_runnable_group
+* Number of slots in the runnable's lock-free queue. Must be a power of two.
+* When the ring is full the producers spill into a locked overflow list.
+*/
+#if !defined(TSK_RUNNABLE_QUEUE_CAPACITY)
+#	define TSK_RUNNABLE_QUEUE_CAPACITY 1024
+#endif
+
+/**@ingroup tsk_runnable_group
+* Slot of the runnable's multi-producer/single-consumer ring.
+*/
+typedef struct tsk_runnable_cell_s {
+    volatile uintptr_t sequence;
+    tsk_object_t* object;
+}
+tsk_runnable_cell_t;
+
 /**@ingroup tsk_runnable_group
 * Runnable.
 */
@@ -71,7 +88,18 @@ typedef struct tsk_runnable_s {
 
     int32_t priority;
 
-    tsk_list_t *objects;
+    /* Multi-producer/single-consumer queue: bounded ring with per-slot sequence numbers (no allocation per item).
+    * The ring owns the enqueued objects until they are popped by the consumer. */
+    struct {
+        tsk_runnable_cell_t* cells;
+        uintptr_t mask;
+        volatile uintptr_t head; // next slot to fill (producers)
+        uintptr_t tail; // next slot to read (consumer only)
+        tsk_list_t* overflow; // used when the ring is full, locked
+        tsk_list_item_t* spilled; // items taken from "overflow" in one go (consumer only)
+        volatile long overflow_count;
+        volatile uintptr_t sleeping; // whether the consumer is (about to be) blocked on "semaphore"
+    } queue;
 }
 tsk_runnable_t;
 
@@ -86,6 +114,10 @@ TINYSAK_API int tsk_runnable_start(tsk_runnable_t *self, const tsk_object_def_t
 TINYSAK_API int tsk_runnable_set_important(tsk_runnable_t *self, tsk_bool_t important);
 TINYSAK_API int tsk_runnable_set_priority(tsk_runnable_t *self, int32_t priority);
 TINYSAK_API int tsk_runnable_enqueue(tsk_runnable_t *self, ...);
+TINYSAK_API int tsk_runnable_enqueue_object(tsk_runnable_t *self, tsk_object_t** object);
+TINYSAK_API tsk_object_t* tsk_runnable_pop(tsk_runnable_t *self);
+TINYSAK_API tsk_bool_t tsk_runnable_is_empty(const tsk_runnable_t *self);
+TINYSAK_API int tsk_runnable_wait(tsk_runnable_t *self);
 TINYSAK_API int tsk_runnable_stop(tsk_runnable_t *self);
 
 TINYSAK_GEXTERN const tsk_object_def_t *tsk_runnable_def_t;
@@ -101,9 +133,9 @@ TINYSAK_GEXTERN const tsk_object_def_t *tsk_runnable_def_t;
 	TSK_RUNNABLE(self)->running = tsk_true;	\
 	TSK_RUNNABLE(self)->id_thread = tsk_thread_get_id(); \
 	for(;;) { \
-		tsk_semaphore_decrement(TSK_RUNNABLE(self)->semaphore); \
+		tsk_runnable_wait(TSK_RUNNABLE(self)); \
 		if(!TSK_RUNNABLE(self)->running &&  \
-			(!TSK_RUNNABLE(self)->important || (TSK_RUNNABLE(self)->important && TSK_LIST_IS_EMPTY(TSK_RUNNABLE(self)->objects)))) \
+			(!TSK_RUNNABLE(self)->important || (TSK_RUNNABLE(self)->important && tsk_runnable_is_empty(TSK_RUNNABLE(self))))) \
 			break;
 
 
@@ -121,8 +153,7 @@ TINYSAK_GEXTERN const tsk_object_def_t *tsk_runnable_def_t;
 {																					\
 	if((self) && TSK_RUNNABLE(self)->initialized){												\
 		tsk_object_t *object = tsk_object_new(TSK_RUNNABLE(self)->objdef, ##__VA_ARGS__);		\
-		tsk_list_push_back_data(TSK_RUNNABLE(self)->objects, (void**)&object);							\
-		tsk_semaphore_increment(TSK_RUNNABLE(self)->semaphore);									\
+		tsk_runnable_enqueue_object(TSK_RUNNABLE(self), &object);						\
 	}																				\
 	else{																			\
 		TSK_DEBUG_WARN("Invalid/uninitialized runnable object.");					\
@@ -132,8 +163,7 @@ TINYSAK_GEXTERN const tsk_object_def_t *tsk_runnable_def_t;
 #define TSK_RUNNABLE_ENQUEUE_OBJECT(self, object)									\
 {																					\
 	if((self) && TSK_RUNNABLE(self)->initialized){									\
-		tsk_list_push_back_data(TSK_RUNNABLE(self)->objects, (void**)&object);		\
-		tsk_semaphore_increment(TSK_RUNNABLE(self)->semaphore);						\
+		tsk_runnable_enqueue_object(TSK_RUNNABLE(self), (tsk_object_t**)&object);	\
 	}																				\
 	else{																			\
 		TSK_DEBUG_WARN("Invalid/uninitialized runnable object.");					\
@@ -141,32 +171,26 @@ TINYSAK_GEXTERN const tsk_object_def_t *tsk_runnable_def_t;
 	}																				\
 }
 
-#define TSK_RUNNABLE_ENQUEUE_OBJECT_SAFE(self, object)								\
-{																					\
-	if((self) && TSK_RUNNABLE(self)->initialized){									\
-		tsk_list_lock(TSK_RUNNABLE(self)->objects);									\
-		tsk_list_push_back_data(TSK_RUNNABLE(self)->objects, (void**)&object);		\
-		tsk_list_unlock(TSK_RUNNABLE(self)->objects);								\
-		tsk_semaphore_increment(TSK_RUNNABLE(self)->semaphore);						\
-	}																				\
-	else{																			\
-		TSK_DEBUG_WARN("Invalid/uninitialized runnable object.");					\
-		TSK_OBJECT_SAFE_FREE(object);												\
-	}																				\
-}
+/* The queue is lock-free: kept for backward compatibility */
+#define TSK_RUNNABLE_ENQUEUE_OBJECT_SAFE(self, object) TSK_RUNNABLE_ENQUEUE_OBJECT(self, object)
 
 /**@ingroup tsk_runnable_group
+* Pops the first object and wraps it into a list item. Deprecated: use @ref tsk_runnable_pop() which doesn't allocate.
 */
 #define TSK_RUNNABLE_POP_FIRST(self) \
-	tsk_list_pop_first_item(TSK_RUNNABLE(self)->objects)
+	TSK_RUNNABLE_POP_FIRST_SAFE(TSK_RUNNABLE(self))
 
 TSK_GCC_DISABLE_WARNINGS_BEGIN("-Wunused-function")
 static tsk_list_item_t* TSK_RUNNABLE_POP_FIRST_SAFE(tsk_runnable_t* self)
 {
-    tsk_list_item_t* item;
-    tsk_list_lock(self->objects);
-    item= tsk_list_pop_first_item(self->objects);
-    tsk_list_unlock(self->objects);
+    tsk_list_item_t* item = tsk_null;
+    tsk_object_t* object;
+    if ((object = tsk_runnable_pop(self)) && (item = tsk_list_item_create())) {
+        item->data = object;
+    }
+    else {
+        TSK_OBJECT_SAFE_FREE(object);
+    }
     return item;
 }
 TSK_GCC_DISABLE_WARNINGS_END()
@@ -27,12 +27,17 @@
  *
 
  */
+#if defined(__linux__) && !defined(__ANDROID__) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE /* pthread_setaffinity_np() */
+#endif
 #include "tsk_thread.h"
 #include "tsk_debug.h"
 #include "tsk_memory.h"
 
 #if TSK_UNDER_WINDOWS
 #	include <windows.h>
+#else
+#	include <unistd.h> /* sysconf() */
 #endif
 #if TSK_UNDER_WINDOWS_RT
 #	include "../winrt/ThreadEmulation.h"
@@ -110,6 +115,63 @@ int tsk_thread_set_priority(tsk_thread_handle_t* handle, int32_t priority)
 #endif
 }
 
+/**@ingroup tsk_thread_group
+* Binds a thread to a single CPU.
+* @param handle The handle of the thread to bind.
+* @param cpu The zero-based index of the CPU.
+* @retval Zero if succeed and non-zero error code otherwise (e.g. not supported on this platform).
+*/
+int tsk_thread_set_affinity(tsk_thread_handle_t* handle, int32_t cpu)
+{
+    if(!handle || cpu < 0) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+#if TSK_UNDER_WINDOWS && !TSK_UNDER_WINDOWS_RT
+    if(cpu >= (int32_t)(sizeof(DWORD_PTR) << 3)) {
+        TSK_DEBUG_ERROR("CPU index %d out of range", cpu);
+        return -1;
+    }
+    return SetThreadAffinityMask(handle, (((DWORD_PTR)1) << cpu)) ? 0 : -1;
+#elif defined(__linux__) && !defined(__ANDROID__)
+    {
+        cpu_set_t set;
+        int ret;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if((ret = pthread_setaffinity_np(*((pthread_t*)handle), sizeof(set), &set))) {
+            TSK_DEBUG_ERROR("Failed to bind thread to cpu %d with error code=%d", cpu, ret);
+            return ret;
+        }
+        return 0;
+    }
+#else
+    TSK_DEBUG_WARN("Thread affinity not supported on this platform");
+    return -2;
+#endif
+}
+
+/**@ingroup tsk_thread_group
+* Gets the number of online CPUs.
+* @retval The number of CPUs (at least 1).
+*/
+int32_t tsk_thread_get_cpu_count()
+{
+    int32_t count = 1;
+#if TSK_UNDER_WINDOWS
+    SYSTEM_INFO SystemInfo;
+#	if TSK_UNDER_WINDOWS_RT
+    GetNativeSystemInfo(&SystemInfo);
+#	else
+    GetSystemInfo(&SystemInfo);
+#	endif
+    count = (int32_t)SystemInfo.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    count = (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (count > 0) ? count : 1;
+}
+
 /**@ingroup tsk_thread_group
  */
 int tsk_thread_set_priority_2(int32_t priority)
@@ -55,6 +55,8 @@ TINYSAK_API void tsk_thread_sleep(uint64_t ms);
 TINYSAK_API int tsk_thread_create(tsk_thread_handle_t** handle, void *(TSK_STDCALL *start) (void *), void *arg);
 TINYSAK_API int tsk_thread_set_priority(tsk_thread_handle_t* handle, int32_t priority);
 TINYSAK_API int tsk_thread_set_priority_2(int32_t priority);
+TINYSAK_API int tsk_thread_set_affinity(tsk_thread_handle_t* handle, int32_t cpu);
+TINYSAK_API int32_t tsk_thread_get_cpu_count();
 TINYSAK_API tsk_thread_id_t tsk_thread_get_id();
 TINYSAK_API tsk_bool_t tsk_thread_id_equals(tsk_thread_id_t* id_1, tsk_thread_id_t *id_2);
 TINYSAK_API int tsk_thread_destroy(tsk_thread_handle_t** handle);
@@ -28,6 +28,7 @@
 * @date Created: Sat Nov 8 16:54:58 2009 mdiop
 */
 #include "tsk_timer.h"
+#include "tsk_memory.h"
 #include "tsk_debug.h"
 #include "tsk_list.h"
 #include "tsk_thread.h"
@@ -46,7 +47,18 @@
 
 #define TSK_TIMER_CREATE(timeout, callback, arg)	tsk_object_new(tsk_timer_def_t, timeout, callback, arg)
 #define TSK_TIMER_TIMEOUT(self)						((tsk_timer_t*)self)->timeout
-#define TSK_TIMER_GET_FIRST()						(manager->timers && manager->timers->head) ? (tsk_timer_t*)(((tsk_list_item_t*)(manager->timers->head))->data) : 0
+#define TSK_TIMER_GET_FIRST()						(manager->heap_count ? manager->heap[0] : tsk_null)
+
+/* The pending timers are stored in a 4-ary min-heap ordered by (timeout, id) and indexed by id
+* using a chained hash table. Schedule and cancel are O(log4(n)) for the heap and O(1) for the lookup.
+*/
+#define TSK_TIMER_HEAP_ARITY						4
+#define TSK_TIMER_HEAP_PARENT(index)				(((index) - 1) / TSK_TIMER_HEAP_ARITY)
+#define TSK_TIMER_HEAP_CHILD(index)					(((index) * TSK_TIMER_HEAP_ARITY) + 1)
+#define TSK_TIMER_HEAP_INVALID_INDEX				((tsk_size_t)-1)
+#define TSK_TIMER_HEAP_MIN_CAPACITY					64
+#define TSK_TIMER_HASH_MIN_SIZE						64 /* MUST be power of 2 */
+#define TSK_TIMER_HASH_INDEX(id, size)				((tsk_size_t)(id) & ((size) - 1))
 
 /**
  * @struct	tsk_timer_s
@@ -60,6 +72,9 @@ typedef struct tsk_timer_s {
     uint64_t timeout; /**< When the timer will timeout(as EPOCH time). */
     tsk_timer_callback_f callback; /**< The callback function to call after @ref timeout milliseconds. */
 
+    tsk_size_t heap_index; /**< Position in the manager's heap or @ref TSK_TIMER_HEAP_INVALID_INDEX if not scheduled. */
+    struct tsk_timer_s* hash_next; /**< Next timer in the same hash bucket. */
+
     unsigned canceled:1;
 }
 tsk_timer_t;
@@ -78,15 +93,24 @@ typedef struct tsk_timer_manager_s {
     tsk_mutex_handle_t *mutex;
     tsk_semaphore_handle_t *sem;
 
-    tsk_timers_L_t *timers;
+    tsk_timer_t** heap; /**< 4-ary min-heap of the pending timers (each entry holds a reference). */
+    tsk_size_t heap_count;
+    tsk_size_t heap_capacity;
+
+    tsk_timer_t** buckets; /**< Hash table (id -> timer) used to cancel timers in constant time. */
+    tsk_size_t buckets_count;
 }
 tsk_timer_manager_t;
 typedef tsk_list_t tsk_timer_manager_L_t; /**< List of @ref tsk_timer_manager_t elements. */
 
 /*== Definitions */
 static void* TSK_STDCALL __tsk_timer_manager_mainthread(void *param);
-static int __tsk_pred_find_timer_by_id(const tsk_list_item_t *item, const void *id);
 static void* TSK_STDCALL run(void* self);
+static int _tsk_timer_manager_push(tsk_timer_manager_t *manager, tsk_timer_t *timer);
+static tsk_timer_t* _tsk_timer_manager_find(const tsk_timer_manager_t *manager, tsk_timer_id_t id);
+static tsk_timer_t* _tsk_timer_manager_remove(tsk_timer_manager_t *manager, tsk_timer_t *timer);
+static void _tsk_timer_manager_clear(tsk_timer_manager_t *manager);
+static int tsk_timer_cmp(const tsk_object_t *obj1, const tsk_object_t *obj2);
 
 /**@ingroup tsk_timer_group
 */
@@ -136,13 +160,12 @@ void tsk_timer_manager_debug(tsk_timer_manager_handle_t *self)
 {
     tsk_timer_manager_t *manager = (tsk_timer_manager_t*)self;
     if(manager) {
-        //int index = 0;
-        tsk_list_item_t *item = tsk_null;
+        tsk_size_t index;
 
         tsk_mutex_lock(manager->mutex);
 
-        tsk_list_foreach(item, manager->timers) {
-            tsk_timer_t* timer = (tsk_timer_t*)item->data;
+        for (index = 0; index < manager->heap_count; ++index) {
+            tsk_timer_t* timer = manager->heap[index];
             TSK_DEBUG_INFO("timer [%ld]- %llu, %llu", timer->id, timer->timeout, tsk_time_now());
         }
 
@@ -183,7 +206,9 @@ int tsk_timer_manager_stop(tsk_timer_manager_handle_t *self)
     }
 
 bail:
-    tsk_list_clear_items(manager->timers);
+    tsk_mutex_lock(manager->mutex);
+    _tsk_timer_manager_clear(manager);
+    tsk_mutex_unlock(manager->mutex);
     return ret;
 }
 
@@ -196,17 +221,30 @@ tsk_timer_id_t tsk_timer_manager_schedule(tsk_timer_manager_handle_t *self, uint
 
     if(manager && (TSK_RUNNABLE(manager)->running || TSK_RUNNABLE(manager)->started)) {
         tsk_timer_t *timer;
+        tsk_bool_t was_empty, is_first;
 
-        timer = (tsk_timer_t*)TSK_TIMER_CREATE(timeout, callback, arg);
-        timer_id = timer->id;
+        if (!(timer = (tsk_timer_t*)TSK_TIMER_CREATE(timeout, callback, arg))) {
+            TSK_DEBUG_ERROR("Failed to create timer");
+            return TSK_INVALID_TIMER_ID;
+        }
         tsk_mutex_lock(manager->mutex);
-        tsk_list_push_ascending_data(manager->timers, ((void**) &timer));
+        was_empty = (manager->heap_count == 0);
+        if (_tsk_timer_manager_push(manager, timer) == 0) {
+            timer_id = timer->id;
+        }
+        is_first = (timer_id != TSK_INVALID_TIMER_ID && timer->heap_index == 0);
         tsk_mutex_unlock(manager->mutex);
+        TSK_OBJECT_SAFE_FREE(timer); // the heap holds its own reference
 
         // tsk_timer_manager_debug(self);
 
-        tsk_condwait_signal(manager->condwait);
-        tsk_semaphore_increment(manager->sem);
+        // wake up the main thread only if it's sleeping on the empty heap or waiting on a later timer
+        if (is_first) {
+            tsk_condwait_signal(manager->condwait);
+            if (was_empty) {
+                tsk_semaphore_increment(manager->sem);
+            }
+        }
     }
 
     return timer_id;
@@ -224,23 +262,24 @@ int tsk_timer_manager_cancel(tsk_timer_manager_handle_t *self, tsk_timer_id_t id
         return 0;
     }
 
-    if(!TSK_LIST_IS_EMPTY(manager->timers) && TSK_RUNNABLE(manager)->running) {
-        const tsk_list_item_t *item;
+    if(manager && manager->heap_count > 0 && TSK_RUNNABLE(manager)->running) {
+        tsk_timer_t *timer;
+        tsk_bool_t was_first = tsk_false;
         tsk_mutex_lock(manager->mutex);
-        item = tsk_list_find_item_by_pred(manager->timers, __tsk_pred_find_timer_by_id, &id);
-        if(item && item->data) {
-            tsk_timer_t *timer = (tsk_timer_t*)item->data;
+        if ((timer = _tsk_timer_manager_find(manager, id))) {
             timer->canceled = 1;
             timer->callback = tsk_null;
-
-            if(item == manager->timers->head) {
-                /* The timer we are waiting on ? ==> remove it now. */
-                tsk_condwait_signal(manager->condwait);
-            }
-
+            was_first = (timer->heap_index == 0);
+            timer = _tsk_timer_manager_remove(manager, timer);
             ret = 0;
         }
         tsk_mutex_unlock(manager->mutex);
+
+        if (was_first) {
+            /* The timer we are waiting on ? ==> wake up to wait on the next one. */
+            tsk_condwait_signal(manager->condwait);
+        }
+        TSK_OBJECT_SAFE_FREE(timer);
     }
     return ret;
 }
@@ -258,7 +297,7 @@ int tsk_timer_manager_destroy(tsk_timer_manager_handle_t **self)
 static void* TSK_STDCALL run(void* self)
 {
     int ret;
-    tsk_list_item_t *curr;
+    tsk_timer_t *timer;
     tsk_timer_manager_t *manager = (tsk_timer_manager_t*)self;
 
     TSK_RUNNABLE(manager)->running = tsk_true; // VERY IMPORTANT --> needed by the main thread
@@ -273,12 +312,11 @@ static void* TSK_STDCALL run(void* self)
 
     TSK_RUNNABLE_RUN_BEGIN(manager);
 
-    if((curr = TSK_RUNNABLE_POP_FIRST_SAFE(TSK_RUNNABLE(manager)))) {
-        tsk_timer_t *timer = (tsk_timer_t *)curr->data;
+    if((timer = (tsk_timer_t *)tsk_runnable_pop(TSK_RUNNABLE(manager)))) {
         if(timer->callback) {
             timer->callback(timer->arg, timer->id);
         }
-        tsk_object_unref(curr);
+        tsk_object_unref(timer);
     }
 
     TSK_RUNNABLE_RUN_END(manager);
@@ -288,21 +326,11 @@ static void* TSK_STDCALL run(void* self)
     return tsk_null;
 }
 
-static int __tsk_pred_find_timer_by_id(const tsk_list_item_t *item, const void *id)
-{
-    tsk_timer_t *timer;
-    if(item && item->data) {
-        timer = (tsk_timer_t*)item->data;
-        return (int)(timer->id - *((tsk_timer_id_t*)id));
-    }
-    return -1;
-}
-
 static void* TSK_STDCALL __tsk_timer_manager_mainthread(void *param)
 {
     int ret;
     tsk_timer_t *curr;
-    uint64_t now;
+    uint64_t now, next_timeout;
     tsk_timer_manager_t *manager = (tsk_timer_manager_t*)param;
 
     TSK_DEBUG_INFO("TIMER MANAGER -- START");
@@ -315,37 +343,32 @@ peek_first:
             break;
         }
 
-        tsk_mutex_lock(manager->mutex);
-        curr = TSK_TIMER_GET_FIRST();
-        tsk_mutex_unlock(manager->mutex);
+        next_timeout = 0;
 
-        if (curr && !curr->canceled) {
-            now = tsk_time_now();
-            if (now >= curr->timeout) {
-                tsk_timer_t *timer = (tsk_timer_t*)tsk_object_ref(curr);
-                //TSK_DEBUG_INFO("Timer raise %llu", timer->id);
-
-                tsk_mutex_lock(manager->mutex); // must lock() before enqueue()
-                TSK_RUNNABLE_ENQUEUE_OBJECT_SAFE(TSK_RUNNABLE(manager), timer);
-                tsk_list_remove_item_by_data(manager->timers, curr);
-                tsk_mutex_unlock(manager->mutex);
-                TSK_OBJECT_SAFE_FREE(timer);
+        tsk_mutex_lock(manager->mutex); // must lock() before enqueue()
+        now = tsk_time_now();
+        /* Raise all expired timers at once: the runnable's queue is lock-free and wakes up the consumer only once per burst */
+        while ((curr = TSK_TIMER_GET_FIRST()) && now >= curr->timeout) {
+            //TSK_DEBUG_INFO("Timer raise %llu", curr->id);
+            curr = _tsk_timer_manager_remove(manager, curr); // transfer the heap's reference to the queue
+            if (TSK_RUNNABLE(manager)->initialized) {
+                tsk_runnable_enqueue_object(TSK_RUNNABLE(manager), (tsk_object_t**)&curr);
             }
             else {
-                if((ret = tsk_condwait_timedwait(manager->condwait, (curr->timeout - now)))) {
-                    TSK_DEBUG_ERROR("CONWAIT for timer manager failed [%d]", ret);
-                    break;
-                }
-                else {
-                    goto peek_first;
-                }
+                TSK_OBJECT_SAFE_FREE(curr); // dropped, as TSK_RUNNABLE_ENQUEUE_OBJECT_SAFE() does, otherwise the first timer stays expired and the wait below never ends
             }
         }
-        else if(curr) {
-            tsk_mutex_lock(manager->mutex);
-            /* TSK_DEBUG_INFO("Timer canceled %llu", curr->id); */
-            tsk_list_remove_item_by_data(manager->timers, curr);
-            tsk_mutex_unlock(manager->mutex);
+        if ((curr = TSK_TIMER_GET_FIRST())) {
+            next_timeout = curr->timeout;
+        }
+        tsk_mutex_unlock(manager->mutex);
+
+        if (next_timeout) {
+            if((ret = tsk_condwait_timedwait(manager->condwait, (next_timeout - now)))) {
+                TSK_DEBUG_ERROR("CONWAIT for timer manager failed [%d]", ret);
+                break;
+            }
+            goto peek_first;
         }
     } /* while() */
 
@@ -354,7 +377,142 @@ peek_first:
     return tsk_null;
 }
 
+/* Inserts the timer in the heap and the hash table. Must be called with the manager's mutex held. */
+static int _tsk_timer_manager_push(tsk_timer_manager_t *manager, tsk_timer_t *timer)
+{
+    tsk_size_t index, parent, bucket;
+
+    if (manager->heap_count >= manager->heap_capacity) {
+        tsk_size_t capacity = TSK_MAX(TSK_TIMER_HEAP_MIN_CAPACITY, (manager->heap_capacity << 1));
+        tsk_timer_t** heap = (tsk_timer_t**)tsk_realloc(manager->heap, capacity * sizeof(tsk_timer_t*));
+        if (!heap) {
+            TSK_DEBUG_ERROR("Failed to grow the timers heap to %u entries", (unsigned)capacity);
+            return -1;
+        }
+        manager->heap = heap;
+        manager->heap_capacity = capacity;
+    }
+    if (manager->heap_count >= manager->buckets_count) {
+        tsk_size_t count = TSK_MAX(TSK_TIMER_HASH_MIN_SIZE, (manager->buckets_count << 1)), i;
+        tsk_timer_t** buckets = (tsk_timer_t**)tsk_calloc(count, sizeof(tsk_timer_t*));
+        if (!buckets) {
+            TSK_DEBUG_ERROR("Failed to grow the timers hash table to %u buckets", (unsigned)count);
+            return -1;
+        }
+        for (i = 0; i < manager->buckets_count; ++i) {
+            tsk_timer_t *curr = manager->buckets[i], *next;
+            while (curr) {
+                next = curr->hash_next;
+                bucket = TSK_TIMER_HASH_INDEX(curr->id, count);
+                curr->hash_next = buckets[bucket];
+                buckets[bucket] = curr;
+                curr = next;
+            }
+        }
+        TSK_FREE(manager->buckets);
+        manager->buckets = buckets;
+        manager->buckets_count = count;
+    }
+
+    bucket = TSK_TIMER_HASH_INDEX(timer->id, manager->buckets_count);
+    timer->hash_next = manager->buckets[bucket];
+    manager->buckets[bucket] = timer;
+
+    /* sift up */
+    index = manager->heap_count++;
+    while (index > 0) {
+        parent = TSK_TIMER_HEAP_PARENT(index);
+        if (tsk_timer_cmp(manager->heap[parent], timer) <= 0) {
+            break;
+        }
+        manager->heap[index] = manager->heap[parent];
+        manager->heap[index]->heap_index = index;
+        index = parent;
+    }
+    manager->heap[index] = (tsk_timer_t*)tsk_object_ref(timer);
+    timer->heap_index = index;
+    return 0;
+}
+
+/* Must be called with the manager's mutex held. */
+static tsk_timer_t* _tsk_timer_manager_find(const tsk_timer_manager_t *manager, tsk_timer_id_t id)
+{
+    tsk_timer_t *timer = tsk_null;
+    if (manager->buckets_count) {
+        timer = manager->buckets[TSK_TIMER_HASH_INDEX(id, manager->buckets_count)];
+        while (timer && timer->id != id) {
+            timer = timer->hash_next;
+        }
+    }
+    return timer;
+}
+
+/* Removes the timer from the heap and the hash table and returns the reference the heap was holding.
+* Must be called with the manager's mutex held. */
+static tsk_timer_t* _tsk_timer_manager_remove(tsk_timer_manager_t *manager, tsk_timer_t *timer)
+{
+    tsk_size_t index = timer->heap_index, child, last, i;
+    tsk_timer_t **pprev, *moved;
+
+    if (index >= manager->heap_count || manager->heap[index] != timer) {
+        TSK_DEBUG_ERROR("Timer with id=%ld not scheduled", timer->id);
+        return tsk_null;
+    }
+
+    pprev = &manager->buckets[TSK_TIMER_HASH_INDEX(timer->id, manager->buckets_count)];
+    while (*pprev && *pprev != timer) {
+        pprev = &(*pprev)->hash_next;
+    }
+    if (*pprev) {
+        *pprev = timer->hash_next;
+    }
+    timer->hash_next = tsk_null;
+    timer->heap_index = TSK_TIMER_HEAP_INVALID_INDEX;
+
+    /* move the last entry into the hole then restore the heap property */
+    moved = manager->heap[--manager->heap_count];
+    if (index < manager->heap_count) {
+        while (index > 0 && tsk_timer_cmp(manager->heap[TSK_TIMER_HEAP_PARENT(index)], moved) > 0) {
+            manager->heap[index] = manager->heap[TSK_TIMER_HEAP_PARENT(index)];
+            manager->heap[index]->heap_index = index;
+            index = TSK_TIMER_HEAP_PARENT(index);
+        }
+        for (;;) {
+            if ((child = TSK_TIMER_HEAP_CHILD(index)) >= manager->heap_count) {
+                break;
+            }
+            last = TSK_MIN(child + TSK_TIMER_HEAP_ARITY, manager->heap_count);
+            for (i = child + 1; i < last; ++i) {
+                if (tsk_timer_cmp(manager->heap[i], manager->heap[child]) < 0) {
+                    child = i;
+                }
+            }
+            if (tsk_timer_cmp(manager->heap[child], moved) >= 0) {
+                break;
+            }
+            manager->heap[index] = manager->heap[child];
+            manager->heap[index]->heap_index = index;
+            index = child;
+        }
+        manager->heap[index] = moved;
+        moved->heap_index = index;
+    }
+    return timer;
+}
 
+/* Must be called with the manager's mutex held. */
+static void _tsk_timer_manager_clear(tsk_timer_manager_t *manager)
+{
+    while (manager->heap_count > 0) {
+        tsk_timer_t *timer = manager->heap[--manager->heap_count];
+        timer->heap_index = TSK_TIMER_HEAP_INVALID_INDEX;
+        timer->hash_next = tsk_null;
+        TSK_OBJECT_SAFE_FREE(timer);
+    }
+    if (manager->buckets_count) {
+        memset(manager->buckets, 0, manager->buckets_count * sizeof(tsk_timer_t*));
+    }
+}
 
 
 
@@ -435,7 +593,6 @@ static tsk_object_t* tsk_timer_manager_ctor(tsk_object_t * self, va_list * app)
 {
     tsk_timer_manager_t *manager = (tsk_timer_manager_t*)self;
     if(manager) {
-        manager->timers = tsk_list_create();
         manager->sem = tsk_semaphore_create();
         manager->condwait = tsk_condwait_create();
         manager->mutex = tsk_mutex_create();
@@ -453,7 +610,8 @@ static tsk_object_t* tsk_timer_manager_dtor(tsk_object_t * self)
         tsk_semaphore_destroy(&manager->sem);
         tsk_condwait_destroy(&manager->condwait);
         tsk_mutex_destroy(&manager->mutex);
-        TSK_OBJECT_SAFE_FREE(manager->timers);
+        TSK_FREE(manager->heap);
+        TSK_FREE(manager->buckets);
     }
 
     return self;
@@ -485,6 +643,7 @@ static tsk_object_t* tsk_timer_ctor(tsk_object_t * self, va_list * app)
         timer->timeout = va_arg(*app, uint64_t);
         timer->callback = va_arg(*app, tsk_timer_callback_f);
         timer->arg = va_arg(*app, const void *);
+        timer->heap_index = TSK_TIMER_HEAP_INVALID_INDEX;
 
         timer->timeout += tsk_time_now();
     }
@@ -506,7 +665,11 @@ static int tsk_timer_cmp(const tsk_object_t *obj1, const tsk_object_t *obj2)
     const tsk_timer_t *t2 = (const tsk_timer_t *)obj2;
 
     if(t1 && t2) {
-        return (int)(t1->timeout - t2->timeout);
+        /* ties are broken on the id to raise timers with same timeout in the scheduling order */
+        if (t1->timeout != t2->timeout) {
+            return (t1->timeout < t2->timeout) ? -1 : 1;
+        }
+        return (t1->id == t2->id) ? 0 : ((t1->id < t2->id) ? -1 : 1);
     }
     else if(!t1 && !t2) {
         return 0;
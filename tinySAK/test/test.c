@@ -44,6 +44,7 @@
 #define RUN_TEST_SEMAPHORE			0
 #define RUN_TEST_SAFEOBJECT			0
 #define RUN_TEST_OBJECT				0
+#define RUN_TEST_OBJECT_CACHE		0
 #define RUN_TEST_PARAMS				0
 #define RUN_TEST_OPTIONS			0
 #define RUN_TEST_TIMER				0
@@ -95,6 +96,10 @@
 #include "test_object.h"
 #endif
 
+#if RUN_TEST_OBJECT_CACHE || RUN_TEST_ALL
+#include "test_object_cache.h"
+#endif
+
 #if RUN_TEST_PARAMS || RUN_TEST_ALL
 #include "test_params.h"
 #endif
@@ -221,6 +226,12 @@ int main()
         printf("\n\n");
 #endif
 
+#if RUN_TEST_OBJECT_CACHE || RUN_TEST_ALL
+        /* object cache */
+        test_object_cache();
+        printf("\n\n");
+#endif
+
 #if RUN_TEST_PARAMS || RUN_TEST_ALL
         /* parameters */
         test_params();
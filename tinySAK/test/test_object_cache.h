@@ -0,0 +1,131 @@
+/*
+* Copyright (C) 2010-2015 Mamadou DIOP.
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+#ifndef _TEST_OBJECT_CACHE_H_
+#define _TEST_OBJECT_CACHE_H_
+
+#define TEST_OBJECT_CACHE_COUNT		2000000
+#define TEST_OBJECT_CACHE_THREADS	4
+#define TEST_OBJECT_CACHE_BURST		50
+
+typedef struct test_cached_s {
+    TSK_DECLARE_OBJECT;
+
+    uint32_t value;
+    uint8_t payload[48];
+}
+test_cached_t;
+
+static tsk_object_t* test_cached_ctor(tsk_object_t * self, va_list * app)
+{
+    test_cached_t *cached = self;
+    if(cached) {
+        assert(cached->value == 0); // recycled objects must be zeroed
+        cached->value = va_arg(*app, uint32_t);
+    }
+    return self;
+}
+static tsk_object_t* test_cached_dtor(tsk_object_t * self)
+{
+    return self;
+}
+static const tsk_object_def_t test_cached_def_s = {
+    sizeof(test_cached_t),
+    test_cached_ctor,
+    test_cached_dtor,
+    tsk_null,
+};
+const tsk_object_def_t *test_cached_def_t = &test_cached_def_s;
+
+/* Creates/destroys objects by bursts (like the network and RTP threads do) */
+static void* TSK_STDCALL test_object_cache_worker(void* arg)
+{
+    size_t i, j;
+    test_cached_t* objects[TEST_OBJECT_CACHE_BURST];
+    for(i = 0; i < (TEST_OBJECT_CACHE_COUNT / TEST_OBJECT_CACHE_THREADS); i += TEST_OBJECT_CACHE_BURST) {
+        for(j = 0; j < TEST_OBJECT_CACHE_BURST; ++j) {
+            objects[j] = tsk_object_new(test_cached_def_t, (uint32_t)(j + 1));
+        }
+        for(j = 0; j < TEST_OBJECT_CACHE_BURST; ++j) {
+            assert(objects[j] && objects[j]->value == (uint32_t)(j + 1));
+            TSK_OBJECT_SAFE_FREE(objects[j]);
+        }
+    }
+    return tsk_null;
+}
+
+static uint64_t test_object_cache_run()
+{
+    size_t i;
+    void* threads[TEST_OBJECT_CACHE_THREADS];
+    uint64_t start = tsk_time_now();
+    for(i = 0; i < TEST_OBJECT_CACHE_THREADS; ++i) {
+        tsk_thread_create(&threads[i], test_object_cache_worker, tsk_null);
+    }
+    for(i = 0; i < TEST_OBJECT_CACHE_THREADS; ++i) {
+        tsk_thread_join(&threads[i]);
+    }
+    return (tsk_time_now() - start);
+}
+
+void test_object_cache()
+{
+    size_t i, count;
+    int ret;
+    tsk_object_cache_stats_t stats;
+    test_cached_t** objects;
+
+    printf("test_object_cache - calloc/free: %u objects in %llu ms\n", TEST_OBJECT_CACHE_COUNT, test_object_cache_run());
+
+    ret = tsk_object_cache_enable(test_cached_def_t, "test_cached_t", 0);
+    assert(ret == 0);
+    assert(tsk_object_cache_is_enabled(test_cached_def_t));
+    printf("test_object_cache - cached: %u objects in %llu ms\n", TEST_OBJECT_CACHE_COUNT, test_object_cache_run());
+
+    // the workers exited: their magazines were flushed and counters folded
+    ret = tsk_object_cache_get_stats(test_cached_def_t, &stats);
+    assert(ret == 0);
+    printf("test_object_cache - live=%u cached=%u bytes=%u allocs=%llu\n", (unsigned)stats.live, (unsigned)stats.cached, (unsigned)stats.slab_bytes, stats.allocs);
+    assert(stats.live == 0);
+    assert(stats.allocs == TEST_OBJECT_CACHE_COUNT);
+
+    // cap: the objects already owned by the cache plus one
+    objects = (test_cached_t**)tsk_calloc(stats.cached + 2, sizeof(test_cached_t*));
+    ret = tsk_object_cache_enable(test_cached_def_t, "test_cached_t", (stats.cached + 1) * sizeof(test_cached_t));
+    assert(ret == 0);
+    for(i = 0, count = 0; i < stats.cached + 2; ++i) {
+        if((objects[i] = tsk_object_new(test_cached_def_t, (uint32_t)1))) {
+            ++count;
+        }
+    }
+    assert(count == stats.cached + 1);
+    for(i = 0; i < stats.cached + 2; ++i) {
+        TSK_OBJECT_SAFE_FREE(objects[i]);
+    }
+    TSK_FREE(objects);
+    ret = tsk_object_cache_get_stats(test_cached_def_t, &stats);
+    assert(ret == 0);
+    assert(stats.failures == 1);
+    ret = tsk_object_cache_enable(test_cached_def_t, "test_cached_t", 0); // no cap
+    assert(ret == 0);
+
+    tsk_object_cache_dump();
+}
+
+#endif /* _TEST_OBJECT_CACHE_H_ */
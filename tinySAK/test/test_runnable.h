@@ -74,15 +74,13 @@ const tsk_object_def_t *tsk_obj_def_t = &tsk_obj_def_s;
 
 void *run(void* self)
 {
-    int i = 0;
-    tsk_list_item_t *curr;
+    tsk_obj_t *obj;
 
     TSK_RUNNABLE_RUN_BEGIN(self);
 
-    if(curr = TSK_RUNNABLE_POP_FIRST(self)) {
-        const tsk_obj_t *obj = (const tsk_obj_t*)curr->data;
+    if((obj = (tsk_obj_t*)tsk_runnable_pop(TSK_RUNNABLE(self)))) {
         printf("\n\nRunnable event-id===>[%llu]\n\n", obj->timer_id);
-        tsk_object_unref(curr);
+        tsk_object_unref(obj);
     }
 
     TSK_RUNNABLE_RUN_END(self);
@@ -90,6 +88,87 @@ void *run(void* self)
     return 0;
 }
 
+#define TEST_RUNNABLE_BENCH_PRODUCERS	4
+#define TEST_RUNNABLE_BENCH_COUNT		500000 /* per producer */
+
+static volatile long test_runnable_bench_consumed = 0;
+static tsk_timer_id_t test_runnable_bench_last[TEST_RUNNABLE_BENCH_PRODUCERS];
+static tsk_bool_t test_runnable_bench_ordered = tsk_true;
+
+static void* TSK_STDCALL test_runnable_bench_run(void* self)
+{
+    tsk_obj_t *obj;
+
+    TSK_RUNNABLE_RUN_BEGIN(self);
+
+    if((obj = (tsk_obj_t*)tsk_runnable_pop(TSK_RUNNABLE(self)))) {
+        // id = (producer << 24) | sequence: each producer's objects must be received in order
+        size_t producer = (size_t)(obj->timer_id >> 24);
+        if(obj->timer_id <= test_runnable_bench_last[producer]) {
+            test_runnable_bench_ordered = tsk_false;
+        }
+        test_runnable_bench_last[producer] = obj->timer_id;
+        ++test_runnable_bench_consumed;
+        tsk_object_unref(obj);
+    }
+
+    TSK_RUNNABLE_RUN_END(self);
+
+    return 0;
+}
+
+typedef struct test_runnable_bench_producer_s {
+    tsk_runnable_t* runnable;
+    tsk_timer_id_t index;
+}
+test_runnable_bench_producer_t;
+
+static void* TSK_STDCALL test_runnable_bench_produce(void* arg)
+{
+    test_runnable_bench_producer_t* producer = (test_runnable_bench_producer_t*)arg;
+    tsk_timer_id_t i;
+    for(i = 1; i <= TEST_RUNNABLE_BENCH_COUNT; ++i) {
+        TSK_RUNNABLE_ENQUEUE(producer->runnable, ((producer->index << 24) | i));
+    }
+    return tsk_null;
+}
+
+/* Several threads enqueue into the same runnable: measures the throughput under contention */
+void test_runnable_bench()
+{
+    size_t i;
+    uint64_t start;
+    void* threads[TEST_RUNNABLE_BENCH_PRODUCERS];
+    test_runnable_bench_producer_t producers[TEST_RUNNABLE_BENCH_PRODUCERS];
+    const long total = TEST_RUNNABLE_BENCH_PRODUCERS * TEST_RUNNABLE_BENCH_COUNT;
+    tsk_runnable_t* runnable = tsk_runnable_create();
+
+    test_runnable_bench_consumed = 0;
+    test_runnable_bench_ordered = tsk_true;
+    runnable->run = test_runnable_bench_run;
+    tsk_runnable_set_important(runnable, tsk_true); // consume everything before exiting
+    tsk_runnable_start(runnable, tsk_obj_def_t);
+    tsk_thread_sleep(100); // give the consumer time to start
+
+    start = tsk_time_now();
+    for(i = 0; i < TEST_RUNNABLE_BENCH_PRODUCERS; ++i) {
+        test_runnable_bench_last[i] = ((tsk_timer_id_t)i << 24);
+        producers[i].runnable = runnable;
+        producers[i].index = i;
+        tsk_thread_create(&threads[i], test_runnable_bench_produce, &producers[i]);
+    }
+    for(i = 0; i < TEST_RUNNABLE_BENCH_PRODUCERS; ++i) {
+        tsk_thread_join(&threads[i]);
+    }
+    while(test_runnable_bench_consumed < total) {
+        tsk_thread_sleep(1);
+    }
+    printf("test_runnable_bench - %d producers: %ld objects in %llu ms\n", TEST_RUNNABLE_BENCH_PRODUCERS, total, (tsk_time_now() - start));
+    assert(test_runnable_bench_ordered);
+
+    TSK_OBJECT_SAFE_FREE(runnable);
+}
+
 static int test_runnable_timer_callback(const void* arg, tsk_timer_id_t timer_id)
 {
     const tsk_runnable_t* runnable = arg;
@@ -120,6 +199,8 @@ void test_runnable()
     /* Stops and frees both timer manager and runnable object */
     TSK_OBJECT_SAFE_FREE(runnable);
     TSK_OBJECT_SAFE_FREE(timer_mgr);
+
+    test_runnable_bench();
 }
 
 #endif /* _TEST_RUNNABLE_H_ */
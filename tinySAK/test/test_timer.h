@@ -50,7 +50,7 @@ static int test_timer_callback(const void* arg, tsk_timer_id_t timer_id)
 void test_global_timer()
 {
     size_t i;
-    tsk_timer_mgr_global_ref();
+    tsk_timer_manager_handle_t *mgr_global = tsk_timer_mgr_global_ref();
 
     // for test: start it two times
     tsk_timer_mgr_global_start();
@@ -65,11 +65,8 @@ void test_global_timer()
 
     tsk_thread_sleep(4000);
 
-    // for test: stop it only one time
-    tsk_timer_mgr_global_stop();
-    tsk_timer_mgr_global_stop();
-
-    tsk_timer_mgr_global_unref();
+    // stops and frees the global timer manager
+    tsk_timer_mgr_global_unref(&mgr_global);
 }
 
 void test_single_timer()
@@ -93,10 +90,64 @@ void test_single_timer()
     TSK_OBJECT_SAFE_FREE(handle);
 }
 
+#define TEST_TIMER_BENCH_COUNT		1000000
+
+static volatile long test_timer_bench_raised = 0;
+
+static int test_timer_bench_callback(const void* arg, tsk_timer_id_t timer_id)
+{
+    tsk_atomic_inc(&test_timer_bench_raised);
+    return 0;
+}
+
+/* Schedules and cancels 1M timers then checks that a batch of timers sharing the same timeout are all raised */
+void test_timer_bench()
+{
+    size_t i;
+    int ret;
+    uint64_t start;
+    tsk_timer_id_t *ids = (tsk_timer_id_t*)tsk_calloc(TEST_TIMER_BENCH_COUNT, sizeof(tsk_timer_id_t));
+    tsk_timer_manager_handle_t *handle = tsk_timer_manager_create();
+
+    tsk_timer_manager_start(handle);
+    tsk_thread_sleep(500); // give the threads time to start
+
+    start = tsk_time_now();
+    for(i = 0; i < TEST_TIMER_BENCH_COUNT; ++i) {
+        // spread the timeouts over [1min, 2min] to have a non-trivial ordering
+        ids[i] = tsk_timer_manager_schedule(handle, 60000 + ((i * 7919) % 60000), test_timer_bench_callback, tsk_null);
+        assert(TSK_TIMER_ID_IS_VALID(ids[i]));
+    }
+    printf("test_timer_bench - schedule: %u timers in %llu ms\n", TEST_TIMER_BENCH_COUNT, (tsk_time_now() - start));
+
+    start = tsk_time_now();
+    for(i = 0; i < TEST_TIMER_BENCH_COUNT; ++i) {
+        // cancel in a different order than the scheduling one (7 is coprime with the count)
+        size_t index = (i * 7) % TEST_TIMER_BENCH_COUNT;
+        ret = tsk_timer_manager_cancel(handle, ids[index]);
+        assert(ret == 0);
+    }
+    printf("test_timer_bench - cancel: %u timers in %llu ms\n", TEST_TIMER_BENCH_COUNT, (tsk_time_now() - start));
+    ret = tsk_timer_manager_cancel(handle, ids[0]);
+    assert(ret != 0); // already canceled
+
+    test_timer_bench_raised = 0;
+    for(i = 0; i < 10000; ++i) {
+        ids[i] = tsk_timer_manager_schedule(handle, 100, test_timer_bench_callback, tsk_null);
+    }
+    tsk_thread_sleep(1000);
+    printf("test_timer_bench - raised: %ld/10000\n", test_timer_bench_raised);
+    assert(test_timer_bench_raised == 10000);
+
+    TSK_OBJECT_SAFE_FREE(handle);
+    TSK_FREE(ids);
+}
+
 void test_timer()
 {
     //test_single_timer();
     test_global_timer();
+    test_timer_bench();
 }
 
 #endif /* _TEST_TIMER_H_ */
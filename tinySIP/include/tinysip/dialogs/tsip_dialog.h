@@ -55,6 +55,7 @@ TSIP_BEGIN_DECLS
 #define TSIP_DIALOG_GET_FSM(self)											TSIP_DIALOG((self))->fsm
 #define TSIP_DIALOG_GET_SS(self)											TSIP_DIALOG((self))->ss
 #define TSIP_DIALOG_GET_STACK(self)											TSIP_STACK(TSIP_DIALOG_GET_SS((self))->stack)
+#define TSIP_DIALOG_GET_LAYER(self)											((TSIP_DIALOG_GET_SS((self)) && TSIP_DIALOG_GET_SS((self))->stack) ? TSIP_DIALOG_GET_STACK((self))->layer_dialog : tsk_null)
 
 #define TSIP_DIALOG_TIMER_CANCEL(TX) \
 	tsk_timer_mgr_global_cancel(self->timer##TX.id)
@@ -161,6 +162,16 @@ typedef struct tsip_dialog_s {
 
     tsip_dialog_event_callback_f callback;
 
+    /* Dialog layer's hash indexes. Only accessed with the layer locked. */
+    struct {
+        tsk_bool_t listed; // whether the dialog is managed by the layer
+        tsk_bool_t active_call; // whether the dialog is counted in the layer's active calls
+        uint32_t callid_hash;
+        tsip_ssession_id_t ssid;
+        struct tsip_dialog_s* callid_next;
+        struct tsip_dialog_s* ssid_next;
+    } index;
+
     TSK_DECLARE_SAFEOBJ;
 }
 tsip_dialog_t;
@@ -41,12 +41,23 @@
 
 TSIP_BEGIN_DECLS
 
+/* Chained hash table of dialogs (the links are in the dialogs) */
+typedef struct tsip_dialog_index_s {
+    struct tsip_dialog_s** buckets;
+    tsk_size_t buckets_count; // power of 2
+    tsk_size_t count;
+}
+tsip_dialog_index_t;
+
 typedef struct tsip_dialog_layer_s {
     TSK_DECLARE_OBJECT;
 
     const tsip_stack_t *stack;
 
     tsip_dialogs_L_t *dialogs;
+    tsip_dialog_index_t index_callid; // case-insensitive Call-ID, tags compared in the bucket
+    tsip_dialog_index_t index_ssid; // SIP session id
+    tsk_size_t active_calls; // INVITE dialogs in early or established state
 
     struct {
         tsk_bool_t inprogress;
@@ -76,6 +87,7 @@ int tsip_dialog_layer_signal_peer_disconnected(tsip_dialog_layer_t *self, const
 int tsip_dialog_layer_remove_callid_from_stream_peers(tsip_dialog_layer_t *self, const char* callid);
 tsip_dialog_t* tsip_dialog_layer_new(tsip_dialog_layer_t *self, tsip_dialog_type_t type, const tsip_ssession_t *ss);
 int tsip_dialog_layer_remove(tsip_dialog_layer_t *self, const tsip_dialog_t *dialog);
+int tsip_dialog_layer_set_state(tsip_dialog_layer_t *self, tsip_dialog_t *dialog, tsip_dialog_state_t state);
 
 int tsip_dialog_layer_handle_incoming_msg(const tsip_dialog_layer_t *self, tsip_message_t* message);
 
@@ -0,0 +1,68 @@
+/*
+* Copyright (C) 2010-2015 Mamadou Diop.
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango[dot]org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+
+/**@file tsip_header_Lazy.h
+ * @brief Header stored as a slice of the received message and only parsed on first access.
+ *
+ * @author Mamadou Diop <diopmamadou(at)doubango[dot]org>
+ *
+
+ */
+#ifndef _TSIP_HEADER_LAZY_H_
+#define _TSIP_HEADER_LAZY_H_
+
+#include "tinysip_config.h"
+#include "tinysip/headers/tsip_header.h"
+
+TSIP_BEGIN_DECLS
+
+#define TSIP_HEADER_IS_LAZY(self)		((self) && *((const void* const*)(self)) == (const void*)tsip_header_Lazy_def_t)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+/// @brief	Header not parsed yet.
+///
+/// Created by @ref tsip_message_parse_2() for the headers not needed to route the message. The header type
+/// is the one the parser will produce (@ref tsip_htype_Dummy for the headers without a parser).
+/// @ref tsip_message_get_headerAt() replaces the header by the parsed one(s) on first access.
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+typedef struct tsip_header_Lazy_s {
+    TSIP_DECLARE_HEADER;
+
+    const char* name; /**< Well-known name of the header. */
+    tsk_buffer_t* buffer; /**< Copy of the raw message shared by all lazy headers of the message. */
+    tsk_size_t offset; /**< Start of the header (name included) in the buffer. */
+    tsk_size_t size; /**< Size of the header (CRLF included). */
+    tsk_size_t value_offset; /**< Start of the header value in the buffer. */
+}
+tsip_header_Lazy_t;
+
+tsip_header_Lazy_t* tsip_header_Lazy_create(const char* data, tsk_size_t data_size, tsk_size_t offset, tsk_size_t size, tsk_buffer_t** buffer);
+tsip_headers_L_t* tsip_header_Lazy_parse(const tsip_header_Lazy_t* self);
+
+TINYSIP_GEXTERN const tsk_object_def_t *tsip_header_Lazy_def_t;
+
+TSIP_END_DECLS
+
+#endif /* _TSIP_HEADER_LAZY_H_ */
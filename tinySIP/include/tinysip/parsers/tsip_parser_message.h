@@ -37,6 +37,7 @@
 TSIP_BEGIN_DECLS
 
 TINYSIP_API tsk_bool_t tsip_message_parse(tsk_ragel_state_t *state, tsip_message_t **result, tsk_bool_t extract_content);
+TINYSIP_API tsk_bool_t tsip_message_parse_2(tsk_ragel_state_t *state, tsip_message_t **result, tsk_bool_t extract_content, tsk_bool_t lazy_headers);
 
 TSIP_END_DECLS
 
@@ -52,6 +52,7 @@ TSIP_BEGIN_DECLS
 #define TSIP_TRANSAC_GET_DST(self)				TSIP_TRANSAC((self))->dst
 #define TSIP_TRANSAC_GET_STACK(self)			TSIP_TRANSAC_GET_DST((self))->stack
 #define TSIP_TRANSAC_GET_TIMER_MGR(self)		TSIP_TRANSAC_GET_STACK((self))->timer_mgr
+#define TSIP_TRANSAC_GET_LAYER(self)			((TSIP_TRANSAC_GET_DST((self)) && TSIP_TRANSAC_GET_STACK((self))) ? TSIP_TRANSAC_GET_STACK((self))->layer_transac : tsk_null)
 
 #define TSIP_TRANSAC_IS_CLIENT(self)			((self) && ((self)->type == tsip_transac_type_ict || (self)->type == tsip_transac_type_nict))
 #define TSIP_TRANSAC_IS_SERVER(self)			!TSIP_TRANSAC_IS_CLIENT((self))
@@ -148,6 +149,15 @@ typedef struct tsip_transac_s {
     char* callid;
 
     tsip_transac_event_callback_f callback;
+
+    /* Transaction layer's hash indexes. Only accessed with the layer locked. */
+    struct {
+        tsk_bool_t listed; // whether the transaction is managed by the layer
+        uint32_t branch_hash;
+        uint32_t callid_hash;
+        struct tsip_transac_s* branch_next;
+        struct tsip_transac_s* callid_next;
+    } index;
 }
 tsip_transac_t;
 
@@ -40,12 +40,22 @@
 
 TSIP_BEGIN_DECLS
 
+/* Chained hash table of transactions (the links are in the transactions) */
+typedef struct tsip_transac_index_s {
+    struct tsip_transac_s** buckets;
+    tsk_size_t buckets_count; // power of 2
+    tsk_size_t count;
+}
+tsip_transac_index_t;
+
 typedef struct tsip_transac_layer_s {
     TSK_DECLARE_OBJECT;
 
     const struct tsip_stack_s *stack;
 
     tsip_transacs_L_t *transactions;
+    tsip_transac_index_t index_branch; // top Via branch, CSeq method compared in the bucket (CANCEL shares the branch)
+    tsip_transac_index_t index_callid; // Call-ID and CSeq number, used to match ACKs
 
     TSK_DECLARE_SAFEOBJ;
 }
@@ -58,6 +68,7 @@ tsip_transac_layer_t* tsip_transac_layer_create(tsip_stack_t* stack);
 
 tsip_transac_t* tsip_transac_layer_new(const tsip_transac_layer_t *self, tsk_bool_t isCT, const tsip_message_t* msg, tsip_transac_dst_t* dst);
 int tsip_transac_layer_remove(tsip_transac_layer_t *self, const tsip_transac_t *transac);
+int tsip_transac_layer_set_branch(tsip_transac_layer_t *self, tsip_transac_t *transac, const char* branch);
 int tsip_transac_layer_cancel_by_dialog(tsip_transac_layer_t *self, const struct tsip_dialog_s* dialog);
 
 tsip_transac_t* tsip_transac_layer_find_client(const tsip_transac_layer_t *self, const tsip_message_t* message);
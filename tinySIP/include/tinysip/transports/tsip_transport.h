@@ -33,6 +33,7 @@
 #include "tinysip_config.h"
 
 #include "tinysip/tsip_message.h"
+#include "tinysip/transports/tsip_transport_framer.h"
 
 #include "tnet_transport.h"
 
@@ -77,8 +78,9 @@ typedef struct tsip_transport_stream_peer_s {
     uint64_t time_added; // in milliseconds
     tsk_bool_t got_valid_sip_msg; // whether we got at least one valid SIP message on this peer
 
-    tsk_buffer_t *rcv_buff_stream;
+    tsk_buffer_t *rcv_buff_stream; // websocket frames
     tsk_buffer_t *snd_buff_stream;
+    tsip_transport_framer_t *rcv_framer; // TCP, TLS and SCTP
 
     // list of dialogs managed by this peer
     tsk_strings_L_t *dialogs_cids;
@@ -127,6 +129,7 @@ tsip_transport_t;
 typedef tsk_list_t tsip_transports_L_t; /**< List of @ref tsip_transport_t elements. */
 
 int tsip_transport_init(tsip_transport_t* self, tnet_socket_type_t type, const struct tsip_stack_s *stack, const char *host, tnet_port_t port, const char* description);
+int tsip_transport_init_2(tsip_transport_t* self, tnet_socket_type_t type, const struct tsip_stack_s *stack, const char *host, tnet_port_t port, tsk_bool_t reuseport, const char* description);
 int tsip_transport_deinit(tsip_transport_t* self);
 
 int tsip_transport_tls_set_certs(tsip_transport_t *self, const char* ca, const char* pbk, const char* pvk);
@@ -174,6 +177,7 @@ int tsip_transport_stream_peers_cleanup(tsip_transport_t *self);
 #define tsip_transport_shutdown(transport)												(transport ? tnet_transport_shutdown(transport->net_transport) : -1)
 
 tsip_transport_t* tsip_transport_create(struct tsip_stack_s* stack, const char* host, tnet_port_t port, tnet_socket_type_t type, const char* description);
+tsip_transport_t* tsip_transport_create_2(struct tsip_stack_s* stack, const char* host, tnet_port_t port, tnet_socket_type_t type, tsk_bool_t reuseport, const char* description);
 
 TINYSIP_GEXTERN const tsk_object_def_t *tsip_transport_def_t;
 
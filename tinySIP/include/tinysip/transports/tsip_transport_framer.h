@@ -0,0 +1,74 @@
+/*
+* Copyright (C) 2010-2015 Mamadou Diop.
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango[dot]org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tsip_transport_framer.h
+ * @brief Incremental framing of the SIP messages received over stream-oriented transports (RFC 3261 - 7.5).
+ *
+ * The framer remembers where the search for the end of the headers stopped and parses the headers (and the Content-Length) only once,
+ * whatever the number of chunks the message arrived in. The consumed bytes are not moved: only the incomplete message at the end of
+ * the buffer is moved back to the front, when more room is needed.
+ *
+ * @author Mamadou Diop <diopmamadou(at)doubango[dot]org>
+ *
+
+ */
+#ifndef TINYSIP_TRANSPORT_FRAMER_H
+#define TINYSIP_TRANSPORT_FRAMER_H
+
+#include "tinysip_config.h"
+
+#include "tinysip/tsip_message.h"
+
+#include "tsk_object.h"
+
+TSIP_BEGIN_DECLS
+
+/* max size of the pending (incomplete) data to form a valid SIP message */
+#if !defined(TSIP_TRANSPORT_FRAMER_MAX_SIZE)
+#	define TSIP_TRANSPORT_FRAMER_MAX_SIZE 0xFFFF
+#endif
+
+typedef struct tsip_transport_framer_s {
+    TSK_DECLARE_OBJECT;
+
+    uint8_t* data;
+    tsk_size_t capacity;
+    tsk_size_t start; // first byte not consumed yet
+    tsk_size_t end; // end of the received bytes
+    tsk_size_t scan; // where to resume the search for the end of the headers
+
+    tsip_message_t* message; // headers already parsed, waiting for the content
+    tsk_size_t clen;
+}
+tsip_transport_framer_t;
+
+TINYSIP_API tsip_transport_framer_t* tsip_transport_framer_create();
+TINYSIP_API int tsip_transport_framer_append(tsip_transport_framer_t* self, const void* data, tsk_size_t size);
+TINYSIP_API int tsip_transport_framer_pop(tsip_transport_framer_t* self, tsip_message_t** message);
+TINYSIP_API tsk_size_t tsip_transport_framer_get_pending(const tsip_transport_framer_t* self);
+TINYSIP_API int tsip_transport_framer_reset(tsip_transport_framer_t* self);
+
+TINYSIP_GEXTERN const tsk_object_def_t *tsip_transport_framer_def_t;
+
+TSIP_END_DECLS
+
+#endif /* TINYSIP_TRANSPORT_FRAMER_H */
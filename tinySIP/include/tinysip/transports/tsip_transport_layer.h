@@ -53,6 +53,7 @@ const tsip_transport_t* tsip_transport_layer_find_by_type(const tsip_transport_l
 const tsip_transport_t* tsip_transport_layer_find_by_idx(const tsip_transport_layer_t* self, int32_t idx);
 
 int tsip_transport_layer_add(tsip_transport_layer_t* self, const char* local_host, tnet_port_t local_port, tnet_socket_type_t type, const char* description);
+int tsip_transport_layer_add_2(tsip_transport_layer_t* self, const char* local_host, tnet_port_t local_port, tnet_socket_type_t type, const char* description, tsk_size_t workers);
 int tsip_transport_layer_remove(tsip_transport_layer_t* self, const char* description);
 
 int tsip_transport_layer_send(const tsip_transport_layer_t* self, const char *branch, tsip_message_t *msg);
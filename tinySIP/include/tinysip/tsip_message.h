@@ -51,6 +51,7 @@
 
 #include "tsk_object.h"
 #include "tsk_buffer.h"
+#include "tsk_mutex.h"
 
 TSIP_BEGIN_DECLS
 
@@ -139,6 +140,7 @@ typedef struct tsip_message_s {
 
     /*== OTHER HEADERS*/
     tsip_headers_L_t *headers;
+    tsk_mutex_handle_t* lazy_mutex; /**< Guards "headers" while the lazy headers are parsed on first access. Only created by @ref tsip_message_parse_2() for the messages with lazy headers. */
 
     /*== to hack the message */
     char* sigcomp_id;
@@ -185,6 +187,7 @@ static void TSIP_MESSAGE_ADD_HEADER(tsip_message_t *self, ...)
 #endif
 
 TINYSIP_API const tsip_header_t *tsip_message_get_headerAt(const tsip_message_t *self, tsip_header_type_t type, tsk_size_t index);
+TINYSIP_API int tsip_message_parse_lazy_headers(const tsip_message_t *self);
 TINYSIP_API const tsip_header_t *tsip_message_get_headerLast(const tsip_message_t *self, tsip_header_type_t type);
 TINYSIP_API const tsip_header_t *tsip_message_get_header(const tsip_message_t *self, tsip_header_type_t type);
 TINYSIP_API tsk_bool_t tsip_message_allowed(const tsip_message_t *self, const char* method);
@@ -80,6 +80,11 @@
 #   define TSIP_COMPACT_HEADERS 0
 #endif
 
+/* Whether to only parse the headers needed to route the incoming messages, the others being parsed on first access (see tsip_message_parse_2()) */
+#if !defined(TSIP_MESSAGE_LAZY_HEADERS)
+#   define TSIP_MESSAGE_LAZY_HEADERS 1
+#endif
+
 #include <stdint.h>
 #ifdef __SYMBIAN32__
 #include <stdlib.h>
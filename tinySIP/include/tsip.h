@@ -94,6 +94,7 @@ typedef enum tsip_stack_param_type_e {
     tsip_pname_dnsserver,
     tsip_pname_max_fds,
     tsip_pname_mode,
+    tsip_pname_transport_workers,
 
 
     /* === Security === */
@@ -344,6 +345,17 @@ int ret = tsip_stack_set(stack,
               TSIP_STACK_SET_NULL());
 * @endcode
 */
+/**@ingroup tsip_stack_group
+* @def TSIP_STACK_SET_TRANSPORT_WORKERS
+* Sets the number of network workers (thread + event queue) listening on the same local address and port for each UDP, TCP, TLS, WS and WSS transport.
+* The workers share the port using SO_REUSEPORT and the kernel load balances the incoming traffic. Must be set before starting the stack.
+* Default value is 1. Ignored for IPSec.
+* @code
+int ret = tsip_stack_set(stack,
+              TSIP_STACK_SET_TRANSPORT_WORKERS(4),
+              TSIP_STACK_SET_NULL());
+* @endcode
+*/
 #define TSIP_STACK_SET_REALM(URI_STR)															tsip_pname_realm, (const char*)URI_STR
 #define TSIP_STACK_SET_LOCAL_IP_2(TRANSPORT_STR, IP_STR)										tsip_pname_local_ip, (const char*)TRANSPORT_STR, (const char*)IP_STR
 #define TSIP_STACK_SET_LOCAL_PORT_2(TRANSPORT_STR, PORT_UINT)									tsip_pname_local_port, (const char*)TRANSPORT_STR, (unsigned)PORT_UINT
@@ -357,6 +369,7 @@ int ret = tsip_stack_set(stack,
 #define TSIP_STACK_SET_DNS_SERVER(IP_STR)														tsip_pname_dnsserver, (const char*)IP_STR
 #define TSIP_STACK_SET_MAX_FDS(MAX_FDS_UINT)													tsip_pname_max_fds, (unsigned)MAX_FDS_UINT
 #define TSIP_STACK_SET_MODE(MODE_ENUM)															tsip_pname_mode, (tsip_stack_mode_t)MODE_ENUM
+#define TSIP_STACK_SET_TRANSPORT_WORKERS(WORKERS_UINT)											tsip_pname_transport_workers, (unsigned)WORKERS_UINT
 
 /* === Security === */
 /**@ingroup tsip_stack_group
@@ -593,6 +606,7 @@ typedef struct tsip_stack_s {
         tsk_bool_t discovery_dhcp;
 
         tsk_size_t max_fds;
+        tsk_size_t transport_workers;
     } network;
 
     /* === Security === */
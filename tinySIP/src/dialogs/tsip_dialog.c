@@ -774,7 +774,7 @@ int tsip_dialog_update(tsip_dialog_t *self, const tsip_response_t* response)
 #endif
             }
 
-            self->state = state;
+            tsip_dialog_layer_set_state(TSIP_DIALOG_GET_LAYER(self), self, state);
             return 0;
         }
     }
@@ -820,7 +820,7 @@ int tsip_dialog_update_2(tsip_dialog_t *self, const tsip_request_t* invite)
         }
     }
 
-    self->state = tsip_established;
+    tsip_dialog_layer_set_state(TSIP_DIALOG_GET_LAYER(self), self, tsip_established);
 
     return 0;
 }
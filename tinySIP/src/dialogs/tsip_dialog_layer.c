@@ -40,8 +40,20 @@
 #include "tinysip/transactions/tsip_transac_layer.h"
 #include "tinysip/transports/tsip_transport_layer.h"
 
+#include "tsk_memory.h"
 #include "tsk_debug.h"
 
+#include <ctype.h>
+
+#define TSIP_DIALOG_LAYER_HASH_MIN_SIZE 64 /* MUST be power of 2 */
+#define TSIP_DIALOG_LAYER_HASH_INDEX(hash, size) ((tsk_size_t)(hash) & ((size) - 1))
+
+typedef enum tsip_dialog_index_type_e {
+    tsip_dialog_index_type_callid,
+    tsip_dialog_index_type_ssid
+}
+tsip_dialog_index_type_t;
+
 extern tsip_ssession_handle_t *tsip_ssession_create_2(const tsip_stack_t* stack, const struct tsip_message_s* message);
 
 /*== Predicate function to find dialog by type */
@@ -66,13 +78,123 @@ static int pred_find_dialog_by_not_type(const tsk_list_item_t *item, const void
     return -1;
 }
 
-/*== Predicate function to find dialog by callid */
-static int pred_find_dialog_by_callid(const tsk_list_item_t *item, const void *callid)
+/* FNV-1a, case-insensitive because Call-IDs are matched with tsk_striequals() by tsip_dialog_layer_find_by_callid() */
+static uint32_t _tsip_dialog_layer_hash_callid(const char* callid)
 {
-    if(item && item->data && callid) {
-        return tsk_strcmp(((tsip_dialog_t*)item->data)->callid, ((const char*)callid));
+    uint32_t hash = 2166136261u;
+    if(callid) {
+        while(*callid) {
+            hash ^= (uint8_t)tolower((uint8_t)*callid++);
+            hash *= 16777619u;
+        }
     }
-    return -1;
+    return hash;
+}
+
+static uint32_t _tsip_dialog_layer_hash_ssid(tsip_ssession_id_t ssid)
+{
+    return (uint32_t)(ssid ^ (ssid >> 32)); // ids are sequential
+}
+
+static tsip_dialog_t** _tsip_dialog_layer_next(tsip_dialog_t* dialog, tsip_dialog_index_type_t type)
+{
+    return (type == tsip_dialog_index_type_callid) ? &dialog->index.callid_next : &dialog->index.ssid_next;
+}
+
+static uint32_t _tsip_dialog_layer_hash(const tsip_dialog_t* dialog, tsip_dialog_index_type_t type)
+{
+    return (type == tsip_dialog_index_type_callid) ? dialog->index.callid_hash : _tsip_dialog_layer_hash_ssid(dialog->index.ssid);
+}
+
+/* Appends to the tail of the bucket to keep the creation order (first created, first matched) */
+static void _tsip_dialog_layer_index_link(tsip_dialog_t** buckets, tsk_size_t buckets_count, tsip_dialog_t* dialog, tsip_dialog_index_type_t type)
+{
+    tsip_dialog_t** link = &buckets[TSIP_DIALOG_LAYER_HASH_INDEX(_tsip_dialog_layer_hash(dialog, type), buckets_count)];
+    while(*link) {
+        link = _tsip_dialog_layer_next(*link, type);
+    }
+    *link = dialog;
+    *_tsip_dialog_layer_next(dialog, type) = tsk_null;
+}
+
+static int _tsip_dialog_layer_index_add(tsip_dialog_index_t* index, tsip_dialog_t* dialog, tsip_dialog_index_type_t type)
+{
+    if(index->count >= index->buckets_count) {
+        tsk_size_t i, buckets_count = TSK_MAX(TSIP_DIALOG_LAYER_HASH_MIN_SIZE, (index->count << 1));
+        tsip_dialog_t *it, *next, **buckets = tsk_calloc(buckets_count, sizeof(tsip_dialog_t*));
+        if(!buckets) {
+            TSK_DEBUG_ERROR("Failed to allocate dialog index with %u buckets", (unsigned)buckets_count);
+            return -1;
+        }
+        for(i = 0; i < index->buckets_count; ++i) {
+            for(it = index->buckets[i]; it; it = next) {
+                next = *_tsip_dialog_layer_next(it, type);
+                _tsip_dialog_layer_index_link(buckets, buckets_count, it, type);
+            }
+        }
+        TSK_FREE(index->buckets);
+        index->buckets = buckets;
+        index->buckets_count = buckets_count;
+    }
+    _tsip_dialog_layer_index_link(index->buckets, index->buckets_count, dialog, type);
+    ++index->count;
+    return 0;
+}
+
+static void _tsip_dialog_layer_index_remove(tsip_dialog_index_t* index, tsip_dialog_t* dialog, tsip_dialog_index_type_t type)
+{
+    tsip_dialog_t** link;
+    if(!index->buckets) {
+        return;
+    }
+    link = &index->buckets[TSIP_DIALOG_LAYER_HASH_INDEX(_tsip_dialog_layer_hash(dialog, type), index->buckets_count)];
+    while(*link) {
+        if(*link == dialog) {
+            *link = *_tsip_dialog_layer_next(dialog, type);
+            *_tsip_dialog_layer_next(dialog, type) = tsk_null;
+            --index->count;
+            return;
+        }
+        link = _tsip_dialog_layer_next(*link, type);
+    }
+}
+
+static tsip_dialog_t* _tsip_dialog_layer_index_head(const tsip_dialog_index_t* index, uint32_t hash)
+{
+    return index->buckets ? index->buckets[TSIP_DIALOG_LAYER_HASH_INDEX(hash, index->buckets_count)] : tsk_null;
+}
+
+static tsk_bool_t _tsip_dialog_layer_is_active_call(const tsip_dialog_t* dialog)
+{
+    return (dialog->type == tsip_dialog_INVITE && dialog->state != tsip_initial && dialog->state != tsip_terminated);
+}
+
+/* Adds the dialog to the list and the indexes. Takes ownership of the dialog, even on failure. */
+static int _tsip_dialog_layer_add(tsip_dialog_layer_t *self, tsip_dialog_t** dialog)
+{
+    int ret = 0;
+    tsip_dialog_t* d = *dialog;
+
+    tsk_safeobj_lock(self);
+    d->index.callid_hash = _tsip_dialog_layer_hash_callid(d->callid);
+    d->index.ssid = tsip_ssession_get_id(d->ss);
+    if((ret = _tsip_dialog_layer_index_add(&self->index_callid, d, tsip_dialog_index_type_callid)) != 0) {
+        TSK_OBJECT_SAFE_FREE(*dialog);
+    }
+    else if((ret = _tsip_dialog_layer_index_add(&self->index_ssid, d, tsip_dialog_index_type_ssid)) != 0) {
+        _tsip_dialog_layer_index_remove(&self->index_callid, d, tsip_dialog_index_type_callid);
+        TSK_OBJECT_SAFE_FREE(*dialog);
+    }
+    else {
+        d->index.listed = tsk_true;
+        if((d->index.active_call = _tsip_dialog_layer_is_active_call(d))) {
+            ++self->active_calls;
+        }
+        tsk_list_push_back_data(self->dialogs, (void**)dialog);
+    }
+    tsk_safeobj_unlock(self);
+
+    return ret;
 }
 
 tsip_dialog_layer_t* tsip_dialog_layer_create(tsip_stack_t* stack)
@@ -91,13 +213,11 @@ tsip_dialog_t* tsip_dialog_layer_find_by_ssid(tsip_dialog_layer_t *self, tsip_ss
 {
     tsip_dialog_t *ret = 0;
     tsip_dialog_t *dialog;
-    tsk_list_item_t *item;
 
     tsk_safeobj_lock(self);
 
-    tsk_list_foreach(item, self->dialogs) {
-        dialog = item->data;
-        if(tsip_ssession_get_id(dialog->ss) == ssid) {
+    for(dialog = _tsip_dialog_layer_index_head(&self->index_ssid, _tsip_dialog_layer_hash_ssid(ssid)); dialog; dialog = dialog->index.ssid_next) {
+        if(dialog->index.ssid == ssid) {
             ret = dialog;
             break;
         }
@@ -116,16 +236,16 @@ tsip_dialog_t* tsip_dialog_layer_find_by_callid(tsip_dialog_layer_t *self, const
         return tsk_null;
     }
     else {
-        tsip_dialog_t *dialog = tsk_null;
-        tsk_list_item_t *item;
-        //--tsk_safeobj_lock(self);
-        tsk_list_foreach(item, self->dialogs) {
-            if(tsk_striequals(TSIP_DIALOG(item->data)->callid, callid)) {
-                dialog = tsk_object_ref(item->data);
+        tsip_dialog_t *dialog;
+        const uint32_t hash = _tsip_dialog_layer_hash_callid(callid);
+        tsk_safeobj_lock(self);
+        for(dialog = _tsip_dialog_layer_index_head(&self->index_callid, hash); dialog; dialog = dialog->index.callid_next) {
+            if(dialog->index.callid_hash == hash && tsk_striequals(dialog->callid, callid)) {
                 break;
             }
         }
-        //--tsk_safeobj_unlock(self);
+        dialog = tsk_object_ref(dialog);
+        tsk_safeobj_unlock(self);
         return dialog;
     }
 }
@@ -133,10 +253,12 @@ tsip_dialog_t* tsip_dialog_layer_find_by_callid(tsip_dialog_layer_t *self, const
 tsk_bool_t tsip_dialog_layer_have_dialog_with_callid(const tsip_dialog_layer_t *self, const char* callid)
 {
     tsk_bool_t found = tsk_false;
-    if(self) {
+    if(self && callid) {
+        const tsip_dialog_t *dialog;
+        const uint32_t hash = _tsip_dialog_layer_hash_callid(callid);
         tsk_safeobj_lock(self);
-        if(tsk_list_find_item_by_pred(self->dialogs, pred_find_dialog_by_callid, callid) != tsk_null) {
-            found = tsk_true;
+        for(dialog = _tsip_dialog_layer_index_head(&self->index_callid, hash); dialog && !found; dialog = dialog->index.callid_next) {
+            found = (dialog->index.callid_hash == hash && tsk_strequals(dialog->callid, callid));
         }
         tsk_safeobj_unlock(self);
     }
@@ -148,15 +270,14 @@ tsip_dialog_t* tsip_dialog_layer_find(const tsip_dialog_layer_t *self, const cha
 {
     tsip_dialog_t *ret = tsk_null;
     tsip_dialog_t *dialog;
-    tsk_list_item_t *item;
+    const uint32_t hash = _tsip_dialog_layer_hash_callid(callid);
 
     *cid_matched = tsk_false;
 
     tsk_safeobj_lock(self);
 
-    tsk_list_foreach(item, self->dialogs) {
-        dialog = item->data;
-        if(tsk_strequals(dialog->callid, callid)) {
+    for(dialog = _tsip_dialog_layer_index_head(&self->index_callid, hash); dialog; dialog = dialog->index.callid_next) {
+        if(dialog->index.callid_hash == hash && tsk_strequals(dialog->callid, callid)) {
             tsk_bool_t is_cancel = (type == tsip_CANCEL); // Incoming CANCEL
             tsk_bool_t is_register = (type == tsip_REGISTER); // Incoming REGISTER
             tsk_bool_t is_notify = (type == tsip_NOTIFY); // Incoming NOTIFY
@@ -194,19 +315,10 @@ tsip_dialog_t* tsip_dialog_layer_find(const tsip_dialog_layer_t *self, const cha
 
 tsk_size_t tsip_dialog_layer_count_active_calls(tsip_dialog_layer_t *self)
 {
-    tsk_size_t count = 0;
-
-    tsip_dialog_t *dialog;
-    tsk_list_item_t *item;
+    tsk_size_t count;
 
     tsk_safeobj_lock(self);
-
-    tsk_list_foreach(item, self->dialogs) {
-        if ((dialog = item->data) && dialog->type == tsip_dialog_INVITE && dialog->state != tsip_initial && dialog->state != tsip_terminated) {
-            ++count;
-        }
-    }
-
+    count = self->active_calls;
     tsk_safeobj_unlock(self);
 
     return count;
@@ -363,6 +475,7 @@ int tsip_dialog_layer_signal_peer_disconnected(tsip_dialog_layer_t *self, const
 {
     tsip_dialog_t *dialog;
     const tsk_list_item_t *item;
+    tsk_list_t *dialogs_cids;
 
     if(!self || !peer) {
         TSK_DEBUG_ERROR("Invalid parameter");
@@ -371,10 +484,16 @@ int tsip_dialog_layer_signal_peer_disconnected(tsip_dialog_layer_t *self, const
 
     //!\ must not lock the entire layer
 
-    // tsk_safeobj_lock(self);
-
+    // use a copy: the layer must not be locked while holding the peer's lock (destroying a dialog locks the peer)
+    if(!(dialogs_cids = tsk_list_create())) {
+        TSK_DEBUG_ERROR("Failed to create list");
+        return -1;
+    }
     tsk_list_lock(peer->dialogs_cids);
-    tsk_list_foreach(item, peer->dialogs_cids) {
+    tsk_list_pushback_list(dialogs_cids, peer->dialogs_cids);
+    tsk_list_unlock(peer->dialogs_cids);
+
+    tsk_list_foreach(item, dialogs_cids) {
         if((dialog = tsip_dialog_layer_find_by_callid(self, TSK_STRING_STR(item->data)))) {
             tsip_dialog_signal_transport_error(dialog);
             TSK_OBJECT_SAFE_FREE(dialog);
@@ -384,9 +503,7 @@ int tsip_dialog_layer_signal_peer_disconnected(tsip_dialog_layer_t *self, const
             TSK_DEBUG_WARN("Stream peer holds call-id='%s' but the dialog layer doesn't know it", TSK_STRING_STR(item->data));
         }
     }
-    tsk_list_unlock(peer->dialogs_cids);
-
-    // tsk_safeobj_unlock(self);
+    TSK_OBJECT_SAFE_FREE(dialogs_cids);
 
     return 0;
 }
@@ -414,49 +531,63 @@ tsip_dialog_t* tsip_dialog_layer_new(tsip_dialog_layer_t *self, tsip_dialog_type
     case tsip_dialog_INVITE: {
         if((dialog = (tsip_dialog_t*)tsip_dialog_invite_create(ss, tsk_null))) {
             ret = tsk_object_ref(dialog);
-            tsk_list_push_back_data(self->dialogs, (void**)&dialog);
+            if(_tsip_dialog_layer_add(self, &dialog) != 0) {
+                TSK_OBJECT_SAFE_FREE(ret);
+            }
         }
         break;
     }
     case tsip_dialog_MESSAGE: {
         if((dialog = (tsip_dialog_t*)tsip_dialog_message_create(ss))) {
             ret = tsk_object_ref(dialog);
-            tsk_list_push_back_data(self->dialogs, (void**)&dialog);
+            if(_tsip_dialog_layer_add(self, &dialog) != 0) {
+                TSK_OBJECT_SAFE_FREE(ret);
+            }
         }
         break;
     }
     case tsip_dialog_INFO: {
         if((dialog = (tsip_dialog_t*)tsip_dialog_info_create(ss))) {
             ret = tsk_object_ref(dialog);
-            tsk_list_push_back_data(self->dialogs, (void**)&dialog);
+            if(_tsip_dialog_layer_add(self, &dialog) != 0) {
+                TSK_OBJECT_SAFE_FREE(ret);
+            }
         }
         break;
     }
     case tsip_dialog_OPTIONS: {
         if((dialog = (tsip_dialog_t*)tsip_dialog_options_create(ss))) {
             ret = tsk_object_ref(dialog);
-            tsk_list_push_back_data(self->dialogs, (void**)&dialog);
+            if(_tsip_dialog_layer_add(self, &dialog) != 0) {
+                TSK_OBJECT_SAFE_FREE(ret);
+            }
         }
         break;
     }
     case tsip_dialog_PUBLISH: {
         if((dialog = (tsip_dialog_t*)tsip_dialog_publish_create(ss))) {
             ret = tsk_object_ref(dialog);
-            tsk_list_push_back_data(self->dialogs, (void**)&dialog);
+            if(_tsip_dialog_layer_add(self, &dialog) != 0) {
+                TSK_OBJECT_SAFE_FREE(ret);
+            }
         }
         break;
     }
     case tsip_dialog_REGISTER: {
         if((dialog = (tsip_dialog_t*)tsip_dialog_register_create(ss, tsk_null))) {
             ret = tsk_object_ref(dialog);
-            tsk_list_push_back_data(self->dialogs, (void**)&dialog);
+            if(_tsip_dialog_layer_add(self, &dialog) != 0) {
+                TSK_OBJECT_SAFE_FREE(ret);
+            }
         }
         break;
     }
     case tsip_dialog_SUBSCRIBE: {
         if((dialog = (tsip_dialog_t*)tsip_dialog_subscribe_create(ss))) {
             ret = tsk_object_ref(dialog);
-            tsk_list_push_back_data(self->dialogs, (void**)&dialog);
+            if(_tsip_dialog_layer_add(self, &dialog) != 0) {
+                TSK_OBJECT_SAFE_FREE(ret);
+            }
         }
         break;
     }
@@ -478,7 +609,16 @@ int tsip_dialog_layer_remove(tsip_dialog_layer_t *self, const tsip_dialog_t *dia
         tsk_safeobj_lock(self);
 
         /* remove the dialog */
-        tsk_list_remove_item_by_data(self->dialogs, dialog);
+        if(dialog->index.listed) {
+            _tsip_dialog_layer_index_remove(&self->index_callid, (tsip_dialog_t*)dialog, tsip_dialog_index_type_callid);
+            _tsip_dialog_layer_index_remove(&self->index_ssid, (tsip_dialog_t*)dialog, tsip_dialog_index_type_ssid);
+            if(dialog->index.active_call) {
+                --self->active_calls;
+            }
+            ((tsip_dialog_t*)dialog)->index.listed = tsk_false;
+            ((tsip_dialog_t*)dialog)->index.active_call = tsk_false;
+        }
+        tsk_list_remove_item_by_data(self->dialogs, dialog); // could destroy the dialog
 
         /* whether shutting down? */
         if(self->shutdown.inprogress) {
@@ -506,6 +646,34 @@ int tsip_dialog_layer_remove(tsip_dialog_layer_t *self, const tsip_dialog_t *dia
     return -1;
 }
 
+/* Updates the state of the dialog and the number of active calls */
+int tsip_dialog_layer_set_state(tsip_dialog_layer_t *self, tsip_dialog_t *dialog, tsip_dialog_state_t state)
+{
+    tsk_bool_t active_call;
+    if(!dialog) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if(!self) { // not managed by a layer
+        dialog->state = state;
+        return 0;
+    }
+
+    tsk_safeobj_lock(self);
+    dialog->state = state;
+    if(dialog->index.listed && (active_call = _tsip_dialog_layer_is_active_call(dialog)) != dialog->index.active_call) {
+        if((dialog->index.active_call = active_call)) {
+            ++self->active_calls;
+        }
+        else {
+            --self->active_calls;
+        }
+    }
+    tsk_safeobj_unlock(self);
+
+    return 0;
+}
+
 // this function is only called if no transaction match
 // for responses, the transaction will always match
 int tsip_dialog_layer_handle_incoming_msg(const tsip_dialog_layer_t *self, tsip_message_t* message)
@@ -657,7 +825,7 @@ int tsip_dialog_layer_handle_incoming_msg(const tsip_dialog_layer_t *self, tsip_
                 if(message->local_fd > 0 && TNET_SOCKET_TYPE_IS_STREAM(message->src_net_type)) {
                     tsip_dialog_set_connected_fd(newdialog, message->local_fd);
                 }
-                tsk_list_push_back_data(self->dialogs, (void**)&newdialog); /* add new dialog to the layer */
+                _tsip_dialog_layer_add((tsip_dialog_layer_t*)self, &newdialog); /* add new dialog to the layer */
                 TSK_OBJECT_SAFE_FREE(dst);
             }
 
@@ -739,6 +907,8 @@ static tsk_object_t* tsip_dialog_layer_dtor(tsk_object_t * self)
     tsip_dialog_layer_t *layer = self;
     if(layer) {
         TSK_OBJECT_SAFE_FREE(layer->dialogs);
+        TSK_FREE(layer->index_callid.buckets);
+        TSK_FREE(layer->index_ssid.buckets);
 
         /* condwait */
         if(layer->shutdown.condwait) {
@@ -30,6 +30,7 @@
 #include "tinysip/headers/tsip_header.h"
 
 #include "tinysip/headers/tsip_header_Dummy.h"
+#include "tinysip/headers/tsip_header_Lazy.h"
 
 
 #include "tsk_debug.h"
@@ -302,7 +303,10 @@ const char *tsip_header_get_name(tsip_header_type_t type)
 const char *tsip_header_get_name_2(const tsip_header_t *self)
 {
     if(self) {
-        if(self->type == tsip_htype_Dummy) {
+        if(TSIP_HEADER_IS_LAZY(self)) {
+            return ((const tsip_header_Lazy_t*)self)->name;
+        }
+        else if(self->type == tsip_htype_Dummy) {
             return ((tsip_header_Dummy_t*)self)->name;
         }
         else {
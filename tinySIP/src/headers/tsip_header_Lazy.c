@@ -0,0 +1,275 @@
+/*
+* Copyright (C) 2010-2015 Mamadou Diop.
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango[dot]org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+
+/**@file tsip_header_Lazy.c
+ * @brief Header stored as a slice of the received message and only parsed on first access.
+ *
+ * @author Mamadou Diop <diopmamadou(at)doubango[dot]org>
+ *
+
+ */
+#include "tinysip/headers/tsip_header_Lazy.h"
+
+#include "tinysip/parsers/tsip_parser_header.h"
+#include "tinysip/tsip_message.h"
+
+#include "tsk_debug.h"
+#include "tsk_memory.h"
+
+#include <string.h>
+
+/* Headers which could be parsed later. The routing-critical headers (Via, From, To, Call-ID, CSeq, Contact, Route,
+* Content-Length) and the ones with a dedicated field in the message (Expires, Content-Type) are always parsed
+* immediately, as are the compact forms and the extension headers.
+*/
+typedef struct tsip_header_lazy_name_s {
+    const char* name;
+    tsk_size_t size;
+    tsip_header_type_t type; // type produced by the parser
+}
+tsip_header_lazy_name_t;
+
+static const tsip_header_lazy_name_t __lazy_names[] = {
+    { "Accept", 6, tsip_htype_Dummy },
+    { "Accept-Contact", 14, tsip_htype_Dummy },
+    { "Accept-Encoding", 15, tsip_htype_Dummy },
+    { "Accept-Language", 15, tsip_htype_Dummy },
+    { "Accept-Resource-Priority", 24, tsip_htype_Dummy },
+    { "Alert-Info", 10, tsip_htype_Dummy },
+    { "Allow", 5, tsip_htype_Allow },
+    { "Allow-Events", 12, tsip_htype_Allow_Events },
+    { "Authentication-Info", 19, tsip_htype_Dummy },
+    { "Authorization", 13, tsip_htype_Authorization },
+    { "Call-Info", 9, tsip_htype_Dummy },
+    { "Content-Disposition", 19, tsip_htype_Dummy },
+    { "Content-Encoding", 16, tsip_htype_Dummy },
+    { "Content-Language", 16, tsip_htype_Dummy },
+    { "Date", 4, tsip_htype_Date },
+    { "Error-Info", 10, tsip_htype_Dummy },
+    { "Event", 5, tsip_htype_Event },
+    { "History-Info", 12, tsip_htype_Dummy },
+    { "Identity", 8, tsip_htype_Dummy },
+    { "Identity-Info", 13, tsip_htype_Dummy },
+    { "In-Reply-To", 11, tsip_htype_Dummy },
+    { "Join", 4, tsip_htype_Dummy },
+    { "Max-Forwards", 12, tsip_htype_Max_Forwards },
+    { "MIME-Version", 12, tsip_htype_Dummy },
+    { "Min-Expires", 11, tsip_htype_Min_Expires },
+    { "Min-SE", 6, tsip_htype_Min_SE },
+    { "Organization", 12, tsip_htype_Dummy },
+    { "Path", 4, tsip_htype_Path },
+    { "Priority", 8, tsip_htype_Dummy },
+    { "Privacy", 7, tsip_htype_Privacy },
+    { "Proxy-Authenticate", 18, tsip_htype_Proxy_Authenticate },
+    { "Proxy-Authorization", 19, tsip_htype_Proxy_Authorization },
+    { "Proxy-Require", 13, tsip_htype_Proxy_Require },
+    { "RAck", 4, tsip_htype_RAck },
+    { "Reason", 6, tsip_htype_Dummy },
+    { "Record-Route", 12, tsip_htype_Record_Route },
+    { "Refer-Sub", 9, tsip_htype_Refer_Sub },
+    { "Refer-To", 8, tsip_htype_Refer_To },
+    { "Referred-By", 11, tsip_htype_Referred_By },
+    { "Reject-Contact", 14, tsip_htype_Dummy },
+    { "Replaces", 8, tsip_htype_Dummy },
+    { "Reply-To", 8, tsip_htype_Dummy },
+    { "Request-Disposition", 19, tsip_htype_Dummy },
+    { "Require", 7, tsip_htype_Require },
+    { "Resource-Priority", 17, tsip_htype_Dummy },
+    { "Retry-After", 11, tsip_htype_Dummy },
+    { "RSeq", 4, tsip_htype_RSeq },
+    { "Security-Client", 15, tsip_htype_Security_Client },
+    { "Security-Server", 15, tsip_htype_Security_Server },
+    { "Security-Verify", 15, tsip_htype_Security_Verify },
+    { "Server", 6, tsip_htype_Server },
+    { "Service-Route", 13, tsip_htype_Service_Route },
+    { "Session-Expires", 15, tsip_htype_Session_Expires },
+    { "SIP-ETag", 8, tsip_htype_SIP_ETag },
+    { "SIP-If-Match", 12, tsip_htype_SIP_If_Match },
+    { "Subject", 7, tsip_htype_Dummy },
+    { "Subscription-State", 18, tsip_htype_Subscription_State },
+    { "Supported", 9, tsip_htype_Supported },
+    { "Target-Dialog", 13, tsip_htype_Dummy },
+    { "Timestamp", 9, tsip_htype_Dummy },
+    { "Unsupported", 11, tsip_htype_Dummy },
+    { "User-Agent", 10, tsip_htype_User_Agent },
+    { "Warning", 7, tsip_htype_Warning },
+    { "WWW-Authenticate", 16, tsip_htype_WWW_Authenticate },
+    { "P-Access-Network-Info", 21, tsip_htype_P_Access_Network_Info },
+    { "P-Answer-State", 14, tsip_htype_Dummy },
+    { "P-Asserted-Identity", 19, tsip_htype_P_Asserted_Identity },
+    { "P-Associated-URI", 16, tsip_htype_P_Associated_URI },
+    { "P-Called-Party-ID", 17, tsip_htype_Dummy },
+    { "P-Charging-Function-Addresses", 29, tsip_htype_P_Charging_Function_Addresses },
+    { "P-Charging-Vector", 17, tsip_htype_Dummy },
+    { "P-DCS-Billing-Info", 18, tsip_htype_Dummy },
+    { "P-DCS-LAES", 10, tsip_htype_Dummy },
+    { "P-DCS-OSPS", 10, tsip_htype_Dummy },
+    { "P-DCS-Redirect", 14, tsip_htype_Dummy },
+    { "P-DCS-Trace-Party-ID", 20, tsip_htype_Dummy },
+    { "P-Early-Media", 13, tsip_htype_Dummy },
+    { "P-Media-Authorization", 21, tsip_htype_Dummy },
+    { "P-Preferred-Identity", 20, tsip_htype_P_Preferred_Identity },
+    { "P-Profile-Key", 13, tsip_htype_Dummy },
+    { "P-User-Database", 15, tsip_htype_Dummy },
+    { "P-Visited-Network-ID", 20, tsip_htype_Dummy },
+};
+
+static const tsip_header_lazy_name_t* _tsip_header_Lazy_find_name(const char* name, tsk_size_t size)
+{
+    tsk_size_t i;
+    for(i = 0; i < sizeof(__lazy_names) / sizeof(__lazy_names[0]); ++i) {
+        if(__lazy_names[i].size == size && tsk_strniequals(__lazy_names[i].name, name, size)) {
+            return &__lazy_names[i];
+        }
+    }
+    return tsk_null;
+}
+
+/**@ingroup tsip_header_group
+* Creates a lazy header from a header line of the raw message.
+* @param data The raw message.
+* @param data_size The size of the raw message.
+* @param offset Start of the header line in @a data.
+* @param size Size of the header line, CRLF included.
+* @param buffer Copy of @a data shared by all lazy headers of the message. Created with the first lazy header.
+* @retval New lazy header or @a tsk_null if the header must be parsed now.
+*/
+tsip_header_Lazy_t* tsip_header_Lazy_create(const char* data, tsk_size_t data_size, tsk_size_t offset, tsk_size_t size, tsk_buffer_t** buffer)
+{
+    const char *start, *end, *p;
+    const tsip_header_lazy_name_t* name;
+
+    if(!data || !buffer || (offset + size) > data_size || size < 2) {
+        return tsk_null;
+    }
+    start = p = data + offset;
+    end = start + size - 2/*CRLF*/;
+    while(p < end && *p != ':' && *p != ' ' && *p != '\t') {
+        ++p;
+    }
+    if(!(name = _tsip_header_Lazy_find_name(start, (tsk_size_t)(p - start)))) {
+        return tsk_null;
+    }
+    while(p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    if(p == end || *p++ != ':') {
+        return tsk_null;
+    }
+    while(p < end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    if(!*buffer && !(*buffer = tsk_buffer_create(data, data_size))) {
+        return tsk_null;
+    }
+    return tsk_object_new(tsip_header_Lazy_def_t, name, *buffer, offset, size, (tsk_size_t)(p - start) + offset);
+}
+
+/**@ingroup tsip_header_group
+* Parses a lazy header.
+* @retval The list of parsed headers (a header line could hold several values) or @a tsk_null if parsing failed.
+*/
+tsip_headers_L_t* tsip_header_Lazy_parse(const tsip_header_Lazy_t* self)
+{
+    tsip_headers_L_t* headers = tsk_null;
+    tsip_message_t* message;
+    tsk_ragel_state_t state;
+
+    if(!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return tsk_null;
+    }
+    if(!(message = tsip_message_create())) {
+        return tsk_null;
+    }
+    tsk_ragel_state_init(&state, ((const char*)TSK_BUFFER_DATA(self->buffer)) + self->offset, self->size);
+    state.tag_start = state.p;
+    state.tag_end = state.pe;
+    if(tsip_header_parse(&state, message) && !TSK_LIST_IS_EMPTY(message->headers)) {
+        headers = tsk_object_ref(message->headers);
+    }
+    else {
+        TSK_DEBUG_ERROR("Failed to parse header - %.*s", (int)self->size, state.tag_start);
+    }
+    TSK_OBJECT_SAFE_FREE(message);
+    return headers;
+}
+
+static int tsip_header_Lazy_serialize(const tsip_header_t* header, tsk_buffer_t* output)
+{
+    if(header) {
+        const tsip_header_Lazy_t *Lazy = (const tsip_header_Lazy_t *)header;
+        tsk_size_t end = Lazy->offset + Lazy->size - 2/*CRLF*/;
+        if(end > Lazy->value_offset) {
+            tsk_buffer_append(output, ((const char*)TSK_BUFFER_DATA(Lazy->buffer)) + Lazy->value_offset, (end - Lazy->value_offset));
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+//========================================================
+//	Lazy header object definition
+//
+
+static tsk_object_t* tsip_header_Lazy_ctor(tsk_object_t *self, va_list * app)
+{
+    tsip_header_Lazy_t *Lazy = self;
+    if(Lazy) {
+        const tsip_header_lazy_name_t* name = va_arg(*app, const tsip_header_lazy_name_t*);
+        TSIP_HEADER(Lazy)->type = name->type;
+        TSIP_HEADER(Lazy)->serialize = tsip_header_Lazy_serialize;
+        Lazy->name = name->name;
+        Lazy->buffer = tsk_object_ref(va_arg(*app, tsk_buffer_t*));
+        Lazy->offset = va_arg(*app, tsk_size_t);
+        Lazy->size = va_arg(*app, tsk_size_t);
+        Lazy->value_offset = va_arg(*app, tsk_size_t);
+    }
+    else {
+        TSK_DEBUG_ERROR("Failed to create new Lazy header.");
+    }
+    return self;
+}
+
+static tsk_object_t* tsip_header_Lazy_dtor(tsk_object_t *self)
+{
+    tsip_header_Lazy_t *Lazy = self;
+    if(Lazy) {
+        TSK_OBJECT_SAFE_FREE(Lazy->buffer);
+        TSK_OBJECT_SAFE_FREE(TSIP_HEADER_PARAMS(Lazy));
+    }
+    else {
+        TSK_DEBUG_ERROR("Null Lazy header.");
+    }
+
+    return self;
+}
+
+static const tsk_object_def_t tsip_header_Lazy_def_s = {
+    sizeof(tsip_header_Lazy_t),
+    tsip_header_Lazy_ctor,
+    tsip_header_Lazy_dtor,
+    tsk_null
+};
+const tsk_object_def_t *tsip_header_Lazy_def_t = &tsip_header_Lazy_def_s;
@@ -34,12 +34,23 @@
 
 #include "tinysip/parsers/tsip_parser_uri.h"
 
+#include "tinysip/headers/tsip_header_Lazy.h"
+
 #include "tsk_debug.h"
 #include "tsk_memory.h"
 
-static void tsip_message_parser_execute(tsk_ragel_state_t *state, tsip_message_t *message, tsk_bool_t extract_content);
+/* Headers stored as slices of the raw message */
+typedef struct tsip_message_parser_lazy_s {
+    const char* data; // raw message
+    tsk_size_t size;
+    tsk_buffer_t* buffer; // copy of the raw message shared by the lazy headers
+}
+tsip_message_parser_lazy_t;
+
+static void tsip_message_parser_execute(tsk_ragel_state_t *state, tsip_message_t *message, tsk_bool_t extract_content, tsip_message_parser_lazy_t* lazy);
 static void tsip_message_parser_init(tsk_ragel_state_t *state);
 static void tsip_message_parser_eoh(tsk_ragel_state_t *state, tsip_message_t *message, tsk_bool_t extract_content);
+static tsk_bool_t tsip_message_parser_header(tsk_ragel_state_t *state, tsip_message_t *message, tsip_message_parser_lazy_t* lazy);
 
 // Check if we have ",CRLF" ==> See WWW-Authenticate header
 // As :>CRLF is preceded by any+ ==> p will be at least (start + 1)
@@ -200,6 +211,23 @@ static const int tsip_machine_parser_message_en_main = 1;
 
 tsk_bool_t tsip_message_parse(tsk_ragel_state_t *state, tsip_message_t **result, tsk_bool_t extract_content)
 {
+    return tsip_message_parse_2(state, result, extract_content, tsk_false);
+}
+
+/**@ingroup tsip_message_group
+* Parses a SIP message.
+* @param state The ragel state holding the data to parse.
+* @param result The parsed message. Created if null.
+* @param extract_content Whether to extract the content.
+* @param lazy_headers Whether to only parse the headers needed to route the message (Via, From, To, Call-ID, CSeq, Contact,
+* Route, Content-Length, Content-Type and Expires). The others are kept as slices of a copy of the raw message and parsed on
+* first access (see @ref tsip_message_get_headerAt()).
+* @retval @a tsk_true if succeed and @a tsk_false otherwise.
+*/
+tsk_bool_t tsip_message_parse_2(tsk_ragel_state_t *state, tsip_message_t **result, tsk_bool_t extract_content, tsk_bool_t lazy_headers)
+{
+    tsip_message_parser_lazy_t lazy;
+
     if(!state || state->pe <= state->p) {
         return tsk_false;
     }
@@ -211,10 +239,15 @@ tsk_bool_t tsip_message_parse(tsk_ragel_state_t *state, tsip_message_t **result,
     /* Ragel init */
     tsip_message_parser_init(state);
 
+    lazy.data = state->p;
+    lazy.size = (tsk_size_t)(state->pe - state->p);
+    lazy.buffer = tsk_null;
+
     /*
     *	State mechine execution.
     */
-    tsip_message_parser_execute(state, *result, extract_content);
+    tsip_message_parser_execute(state, *result, extract_content, lazy_headers ? &lazy : tsk_null);
+    TSK_OBJECT_SAFE_FREE(lazy.buffer); // now owned by the headers
 
     /* Check result */
 
@@ -247,7 +280,7 @@ static void tsip_message_parser_init(tsk_ragel_state_t *state)
     state->cs = cs;
 }
 
-static void tsip_message_parser_execute(tsk_ragel_state_t *state, tsip_message_t *message, tsk_bool_t extract_content)
+static void tsip_message_parser_execute(tsk_ragel_state_t *state, tsip_message_t *message, tsk_bool_t extract_content, tsip_message_parser_lazy_t* lazy)
 {
     int cs = state->cs;
     const char *p = state->p;
@@ -462,7 +495,7 @@ _match:
                 state->tag_end = p;
                 len = (int)(state->tag_end  - state->tag_start);
 
-                if(tsip_header_parse(state, message)) {
+                if(tsip_message_parser_header(state, message, lazy)) {
                     //TSK_DEBUG_INFO("TSIP_MESSAGE_PARSER::PARSE_HEADER len=%d state=%d", len, state->cs);
                 }
                 else {
@@ -537,3 +570,19 @@ static void tsip_message_parser_eoh(tsk_ragel_state_t *state, tsip_message_t *me
     state->eof = eof;
     state->eoh = eoh;
 }
+
+static tsk_bool_t tsip_message_parser_header(tsk_ragel_state_t *state, tsip_message_t *message, tsip_message_parser_lazy_t* lazy)
+{
+    if(lazy) {
+        tsip_header_Lazy_t* header;
+        if(!message->lazy_mutex && !(message->lazy_mutex = tsk_mutex_create())) {
+            return tsip_header_parse(state, message); // parsed by the getters from any thread: not without the lock
+        }
+        header = tsip_header_Lazy_create(lazy->data, lazy->size, (tsk_size_t)(state->tag_start - lazy->data), (tsk_size_t)(state->tag_end - state->tag_start), &lazy->buffer);
+        if(header) {
+            tsk_list_push_back_data(message->headers, (void**)&header);
+            return tsk_true;
+        }
+    }
+    return tsip_header_parse(state, message);
+}
@@ -78,6 +78,7 @@
 
  */
 #include "tinysip/transactions/tsip_transac_ict.h"
+#include "tinysip/transactions/tsip_transac_layer.h"
 
 #include "tsk_debug.h"
 
@@ -346,14 +347,18 @@ int tsip_transac_ict_start(tsip_transac_ict_t *self, const tsip_request_t* reque
     if(self && request && !TSIP_TRANSAC(self)->running) {
         /* Add branch to the new client transaction
         * - Transac will use request branch if exit (e.g. when request received over websocket)
+        * The branch is set by the layer to keep its index up to date.
         */
         if((request->firstVia && !tsk_strnullORempty(request->firstVia->branch))) {
-            tsk_strupdate(&TSIP_TRANSAC(self)->branch, (request->firstVia ? request->firstVia->branch : "doubango"));
+            tsip_transac_layer_set_branch(TSIP_TRANSAC_GET_LAYER(self), TSIP_TRANSAC(self), request->firstVia->branch);
         }
-        else if((TSIP_TRANSAC(self)->branch = tsk_strdup(TSIP_TRANSAC_MAGIC_COOKIE))) {
-            tsk_istr_t branch;
-            tsk_strrandom(&branch);
-            tsk_strcat_2(&(TSIP_TRANSAC(self)->branch), "-%s", branch);
+        else {
+            tsk_istr_t random;
+            char* branch = tsk_null;
+            tsk_strrandom(&random);
+            tsk_sprintf(&branch, TSIP_TRANSAC_MAGIC_COOKIE "-%s", random);
+            tsip_transac_layer_set_branch(TSIP_TRANSAC_GET_LAYER(self), TSIP_TRANSAC(self), branch);
+            TSK_FREE(branch);
         }
 
         TSIP_TRANSAC(self)->running = 1;
@@ -35,8 +35,106 @@
 #include "tinysip/transactions/tsip_transac_nist.h"
 
 #include "tsk_string.h"
+#include "tsk_memory.h"
 #include "tsk_debug.h"
 
+#include <string.h>
+
+#define TSIP_TRANSAC_LAYER_HASH_MIN_SIZE 64 /* MUST be power of 2 */
+#define TSIP_TRANSAC_LAYER_HASH_INDEX(hash, size) ((tsk_size_t)(hash) & ((size) - 1))
+
+typedef enum tsip_transac_index_type_e {
+    tsip_transac_index_type_branch,
+    tsip_transac_index_type_callid
+}
+tsip_transac_index_type_t;
+
+/* FNV-1a */
+static uint32_t _tsip_transac_layer_hash_str(const char* str)
+{
+    uint32_t hash = 2166136261u;
+    if(str) {
+        while(*str) {
+            hash ^= (uint8_t)*str++;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+static uint32_t _tsip_transac_layer_hash_callid(const char* callid, int32_t cseq_value)
+{
+    return _tsip_transac_layer_hash_str(callid) ^ ((uint32_t)cseq_value * 2654435761u);
+}
+
+static tsip_transac_t** _tsip_transac_layer_next(tsip_transac_t* transac, tsip_transac_index_type_t type)
+{
+    return (type == tsip_transac_index_type_branch) ? &transac->index.branch_next : &transac->index.callid_next;
+}
+
+static uint32_t _tsip_transac_layer_hash(const tsip_transac_t* transac, tsip_transac_index_type_t type)
+{
+    return (type == tsip_transac_index_type_branch) ? transac->index.branch_hash : transac->index.callid_hash;
+}
+
+/* Appends to the tail of the bucket to keep the creation order (e.g. the oldest transaction matches a CANCEL first) */
+static void _tsip_transac_layer_index_link(tsip_transac_t** buckets, tsk_size_t buckets_count, tsip_transac_t* transac, tsip_transac_index_type_t type)
+{
+    tsip_transac_t** link = &buckets[TSIP_TRANSAC_LAYER_HASH_INDEX(_tsip_transac_layer_hash(transac, type), buckets_count)];
+    while(*link) {
+        link = _tsip_transac_layer_next(*link, type);
+    }
+    *link = transac;
+    *_tsip_transac_layer_next(transac, type) = tsk_null;
+}
+
+static int _tsip_transac_layer_index_add(tsip_transac_index_t* index, tsip_transac_t* transac, tsip_transac_index_type_t type)
+{
+    if(index->count >= index->buckets_count) {
+        tsk_size_t i, buckets_count = TSK_MAX(TSIP_TRANSAC_LAYER_HASH_MIN_SIZE, (index->count << 1));
+        tsip_transac_t *it, *next, **buckets = tsk_calloc(buckets_count, sizeof(tsip_transac_t*));
+        if(!buckets) {
+            TSK_DEBUG_ERROR("Failed to allocate transaction index with %u buckets", (unsigned)buckets_count);
+            return -1;
+        }
+        for(i = 0; i < index->buckets_count; ++i) {
+            for(it = index->buckets[i]; it; it = next) {
+                next = *_tsip_transac_layer_next(it, type);
+                _tsip_transac_layer_index_link(buckets, buckets_count, it, type);
+            }
+        }
+        TSK_FREE(index->buckets);
+        index->buckets = buckets;
+        index->buckets_count = buckets_count;
+    }
+    _tsip_transac_layer_index_link(index->buckets, index->buckets_count, transac, type);
+    ++index->count;
+    return 0;
+}
+
+static void _tsip_transac_layer_index_remove(tsip_transac_index_t* index, tsip_transac_t* transac, tsip_transac_index_type_t type)
+{
+    tsip_transac_t** link;
+    if(!index->buckets) {
+        return;
+    }
+    link = &index->buckets[TSIP_TRANSAC_LAYER_HASH_INDEX(_tsip_transac_layer_hash(transac, type), index->buckets_count)];
+    while(*link) {
+        if(*link == transac) {
+            *link = *_tsip_transac_layer_next(transac, type);
+            *_tsip_transac_layer_next(transac, type) = tsk_null;
+            --index->count;
+            return;
+        }
+        link = _tsip_transac_layer_next(*link, type);
+    }
+}
+
+static tsip_transac_t* _tsip_transac_layer_index_head(const tsip_transac_index_t* index, uint32_t hash)
+{
+    return index->buckets ? index->buckets[TSIP_TRANSAC_LAYER_HASH_INDEX(hash, index->buckets_count)] : tsk_null;
+}
+
 tsip_transac_layer_t* tsip_transac_layer_create(tsip_stack_t* stack)
 {
     return tsk_object_new(tsip_transac_layer_def_t, stack);
@@ -78,8 +176,21 @@ tsip_transac_t* tsip_transac_layer_new(const tsip_transac_layer_t *self, tsk_boo
 
             /* Add new transaction */
             if(transac) {
-                ret = tsk_object_ref(transac);
-                tsk_list_push_back_data(self->transactions, (void**)&transac);
+                tsip_transac_layer_t* layer = (tsip_transac_layer_t*)self;
+                transac->index.branch_hash = _tsip_transac_layer_hash_str(transac->branch);
+                transac->index.callid_hash = _tsip_transac_layer_hash_callid(transac->callid, transac->cseq_value);
+                if(_tsip_transac_layer_index_add(&layer->index_branch, transac, tsip_transac_index_type_branch) != 0) {
+                    TSK_OBJECT_SAFE_FREE(transac);
+                }
+                else if(_tsip_transac_layer_index_add(&layer->index_callid, transac, tsip_transac_index_type_callid) != 0) {
+                    _tsip_transac_layer_index_remove(&layer->index_branch, transac, tsip_transac_index_type_branch);
+                    TSK_OBJECT_SAFE_FREE(transac);
+                }
+                else {
+                    transac->index.listed = tsk_true;
+                    ret = tsk_object_ref(transac);
+                    tsk_list_push_back_data(self->transactions, (void**)&transac);
+                }
             }
         }
     }
@@ -93,7 +204,12 @@ int tsip_transac_layer_remove(tsip_transac_layer_t *self, const tsip_transac_t *
 {
     if(transac && self) {
         tsk_safeobj_lock(self);
-        tsk_list_remove_item_by_data(self->transactions, transac);
+        if(transac->index.listed) {
+            _tsip_transac_layer_index_remove(&self->index_branch, (tsip_transac_t*)transac, tsip_transac_index_type_branch);
+            _tsip_transac_layer_index_remove(&self->index_callid, (tsip_transac_t*)transac, tsip_transac_index_type_callid);
+            ((tsip_transac_t*)transac)->index.listed = tsk_false;
+        }
+        tsk_list_remove_item_by_data(self->transactions, transac); // must be last: could destroy the transaction
         tsk_safeobj_unlock(self);
 
         return 0;
@@ -102,6 +218,33 @@ int tsip_transac_layer_remove(tsip_transac_layer_t *self, const tsip_transac_t *
     return -1;
 }
 
+/* Updates the branch of a client transaction (known only when the request is sent) and re-indexes it */
+int tsip_transac_layer_set_branch(tsip_transac_layer_t *self, tsip_transac_t *transac, const char* branch)
+{
+    if(!transac) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if(!self) { // not managed by a layer
+        tsk_strupdate(&transac->branch, branch);
+        return 0;
+    }
+
+    tsk_safeobj_lock(self);
+    if(transac->index.listed) {
+        _tsip_transac_layer_index_remove(&self->index_branch, transac, tsip_transac_index_type_branch);
+    }
+    tsk_strupdate(&transac->branch, branch);
+    transac->index.branch_hash = _tsip_transac_layer_hash_str(transac->branch);
+    if(transac->index.listed) {
+        // cannot fail: the bucket array never shrinks
+        _tsip_transac_layer_index_add(&self->index_branch, transac, tsip_transac_index_type_branch);
+    }
+    tsk_safeobj_unlock(self);
+
+    return 0;
+}
+
 /* cancel all transactions related to this dialog */
 int tsip_transac_layer_cancel_by_dialog(tsip_transac_layer_t *self, const struct tsip_dialog_s* dialog)
 {
@@ -156,7 +299,7 @@ tsip_transac_t* tsip_transac_layer_find_client(const tsip_transac_layer_t *self,
     */
     tsip_transac_t *ret = tsk_null;
     tsip_transac_t *transac;
-    tsk_list_item_t *item;
+    uint32_t hash;
 
     /*	Check first Via/CSeq validity.
     */
@@ -164,11 +307,13 @@ tsip_transac_t* tsip_transac_layer_find_client(const tsip_transac_layer_t *self,
         return tsk_null;
     }
 
+    hash = _tsip_transac_layer_hash_str(response->firstVia->branch);
+
     tsk_safeobj_lock(self);
 
-    tsk_list_foreach(item, self->transactions) {
-        transac = item->data;
-        if( tsk_strequals(transac->branch, response->firstVia->branch)
+    for(transac = _tsip_transac_layer_index_head(&self->index_branch, hash); transac; transac = transac->index.branch_next) {
+        if(transac->index.branch_hash == hash
+                && tsk_strequals(transac->branch, response->firstVia->branch)
                 && tsk_strequals(transac->cseq_method, response->CSeq->method)
           ) {
             ret = tsk_object_ref(transac);
@@ -210,7 +355,7 @@ tsip_transac_t* tsip_transac_layer_find_server(const tsip_transac_layer_t *self,
     */
     tsip_transac_t *ret = tsk_null;
     tsip_transac_t *transac;
-    tsk_list_item_t *item;
+    uint32_t hash;
     //const char* sent_by;
 
     /*	Check first Via/CSeq validity */
@@ -218,20 +363,35 @@ tsip_transac_t* tsip_transac_layer_find_server(const tsip_transac_layer_t *self,
         return tsk_null;
     }
 
-    tsk_safeobj_lock(self);
+    if(TSIP_REQUEST_IS_ACK(message)) { /* 1. ACK branch won't match INVITE's but they MUST have the same CSeq/CallId values */
+        if(!message->Call_ID) {
+            return tsk_null;
+        }
+        hash = _tsip_transac_layer_hash_callid(message->Call_ID->value, message->CSeq->seq);
 
-    tsk_list_foreach(item, self->transactions) {
-        transac = item->data;
-        if(TSIP_REQUEST_IS_ACK(message) && tsk_strequals(transac->callid, message->Call_ID->value)) { /* 1. ACK branch won't match INVITE's but they MUST have the same CSeq/CallId values */
+        tsk_safeobj_lock(self);
+        for(transac = _tsip_transac_layer_index_head(&self->index_callid, hash); transac; transac = transac->index.callid_next) {
             // [transac->type == tsip_transac_type_ist] is used to avoid looping in webrtc2sip mode (e.g. browser <->(breaker)<->browser)
             // (browser-1) -> INVITE -> (breaker) -> INVITE - (server) -> INVITE -> (breaker) -> (browser-2)
             // the breaker will have two transactions (IST and ICT) with same cseq value and call-id (if not changed by the server)
-            if(transac->type == tsip_transac_type_ist && tsk_striequals(transac->cseq_method, "INVITE") && message->CSeq->seq == transac->cseq_value) {
+            if(transac->index.callid_hash == hash && tsk_strequals(transac->callid, message->Call_ID->value)
+                    && transac->type == tsip_transac_type_ist && tsk_striequals(transac->cseq_method, "INVITE") && message->CSeq->seq == transac->cseq_value) {
                 ret = tsk_object_ref(transac);
                 break;
             }
         }
-        else if(tsk_strequals(transac->branch, message->firstVia->branch) /* 2. Compare branches*/
+        tsk_safeobj_unlock(self);
+
+        return ret;
+    }
+
+    hash = _tsip_transac_layer_hash_str(message->firstVia->branch);
+
+    tsk_safeobj_lock(self);
+
+    for(transac = _tsip_transac_layer_index_head(&self->index_branch, hash); transac; transac = transac->index.branch_next) {
+        if(transac->index.branch_hash == hash
+                && tsk_strequals(transac->branch, message->firstVia->branch) /* 2. Compare branches*/
                 && (1 == 1) /* FIXME: compare host:ip */
                ) {
             if(tsk_strequals(transac->cseq_method, message->CSeq->method)) {
@@ -324,6 +484,8 @@ static tsk_object_t* tsip_transac_layer_dtor(tsk_object_t * self)
     tsip_transac_layer_t *layer = self;
     if(layer) {
         TSK_OBJECT_SAFE_FREE(layer->transactions);
+        TSK_FREE(layer->index_branch.buckets);
+        TSK_FREE(layer->index_callid.buckets);
 
         tsk_safeobj_deinit(layer);
 
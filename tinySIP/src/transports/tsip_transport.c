@@ -105,9 +105,15 @@ static int _pred_find_stream_peer_by_local_fd(const tsk_list_item_t *item, const
 
 /* creates new SIP transport */
 tsip_transport_t* tsip_transport_create(tsip_stack_t* stack, const char* host, tnet_port_t port, tnet_socket_type_t type, const char* description)
+{
+    return tsip_transport_create_2(stack, host, port, type, tsk_false, description);
+}
+
+/* creates new SIP transport. "reuseport" must be set on all transports (workers) sharing the same local address and port */
+tsip_transport_t* tsip_transport_create_2(tsip_stack_t* stack, const char* host, tnet_port_t port, tnet_socket_type_t type, tsk_bool_t reuseport, const char* description)
 {
     tsip_transport_t* transport;
-    if((transport = tsk_object_new(tsip_transport_def_t, stack, host, port, type, description))) {
+    if((transport = tsk_object_new(tsip_transport_def_t, stack, host, port, type, reuseport, description))) {
         int i;
         for(i = 0; i < sizeof(_tsip_transport_idxs_xs)/sizeof(_tsip_transport_idxs_xs[0]); ++i) {
             if(_tsip_transport_idxs_xs[i].type & type) {
@@ -915,13 +921,18 @@ int tsip_transport_stream_peers_cleanup(tsip_transport_t *self)
 }
 
 int tsip_transport_init(tsip_transport_t* self, tnet_socket_type_t type, const struct tsip_stack_s *stack, const char *host, tnet_port_t port, const char* description)
+{
+    return tsip_transport_init_2(self, type, stack, host, port, tsk_false, description);
+}
+
+int tsip_transport_init_2(tsip_transport_t* self, tnet_socket_type_t type, const struct tsip_stack_s *stack, const char *host, tnet_port_t port, tsk_bool_t reuseport, const char* description)
 {
     if(!self || self->initialized) {
         return -1;
     }
 
     self->stack = stack;
-    self->net_transport = tnet_transport_create(host, port, type, description);
+    self->net_transport = tnet_transport_create_3(host, port, type, reuseport, description);
 	self->type = tnet_transport_get_type(self->net_transport); // Type could be "ipv46" or any fancy protocol. Update it using the transport master
 
     self->scheme = "sip";
@@ -1006,9 +1017,10 @@ static tsk_object_t* tsip_transport_ctor(tsk_object_t * self, va_list * app)
         tnet_port_t port = va_arg(*app, tnet_port_t);
 #endif
         tnet_socket_type_t type = va_arg(*app, tnet_socket_type_t);
+        tsk_bool_t reuseport = va_arg(*app, tsk_bool_t);
         const char *description = va_arg(*app, const char*);
 
-        if(tsip_transport_init(transport, type, stack, host, port, description)) {
+        if(tsip_transport_init_2(transport, type, stack, host, port, reuseport, description)) {
             TSK_DEBUG_ERROR("Failed to initialize transport");
             return tsk_null;
         }
@@ -1061,6 +1073,9 @@ static tsk_object_t* tsip_transport_stream_peer_ctor(tsk_object_t * self, va_lis
         if (!(peer->snd_buff_stream = tsk_buffer_create_null())) {
             return tsk_null;
         }
+        if (!(peer->rcv_framer = tsip_transport_framer_create())) {
+            return tsk_null;
+        }
         if (!(peer->dialogs_cids = tsk_list_create())) {
             return tsk_null;
         }
@@ -1074,6 +1089,7 @@ static tsk_object_t* tsip_transport_stream_peer_dtor(tsk_object_t * self)
         TSK_DEBUG_INFO("*** Stream Peer destroyed ***");
         TSK_OBJECT_SAFE_FREE(peer->rcv_buff_stream);
         TSK_OBJECT_SAFE_FREE(peer->snd_buff_stream);
+        TSK_OBJECT_SAFE_FREE(peer->rcv_framer);
 
         TSK_SAFE_FREE(peer->ws.rcv_buffer);
         peer->ws.rcv_buffer_size = 0;
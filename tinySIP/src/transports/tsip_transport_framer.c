@@ -0,0 +1,211 @@
+/*
+* Copyright (C) 2010-2015 Mamadou Diop.
+*
+* Contact: Mamadou Diop <diopmamadou(at)doubango[dot]org>
+*
+* This file is part of Open Source Doubango Framework.
+*
+* DOUBANGO is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* DOUBANGO is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with DOUBANGO.
+*
+*/
+
+/**@file tsip_transport_framer.c
+ * @brief Incremental framing of the SIP messages received over stream-oriented transports (RFC 3261 - 7.5).
+ *
+ * @author Mamadou Diop <diopmamadou(at)doubango[dot]org>
+ *
+
+ */
+#include "tinysip/transports/tsip_transport_framer.h"
+
+#include "tinysip/parsers/tsip_parser_message.h"
+
+#include "tsk_memory.h"
+#include "tsk_debug.h"
+
+#include <string.h>
+
+#define TSIP_TRANSPORT_FRAMER_MIN_CAPACITY 0x800
+
+/** Creates a new stream framer.
+*/
+tsip_transport_framer_t* tsip_transport_framer_create()
+{
+    return tsk_object_new(tsip_transport_framer_def_t);
+}
+
+/** Appends data received on the stream.
+* The bytes of the incomplete message are moved to the front of the buffer only when the free room at the end is too small,
+* and the buffer grows when they take more than half of it.
+*/
+int tsip_transport_framer_append(tsip_transport_framer_t* self, const void* data, tsk_size_t size)
+{
+    tsk_size_t pending, capacity;
+
+    if(!self || (!data && size)) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    /* Check if the pending data is too big to be valid (have we missed some chuncks?) */
+    if((pending = (self->end - self->start)) >= TSIP_TRANSPORT_FRAMER_MAX_SIZE) {
+        TSK_DEBUG_ERROR("Stream buffer is too big to be valid");
+        tsip_transport_framer_reset(self);
+        pending = 0;
+    }
+
+    if((self->end + size) > self->capacity) {
+        if(self->start && (pending + size) <= (self->capacity >> 1)) {
+            memmove(self->data, self->data + self->start, pending);
+        }
+        else {
+            uint8_t* newdata;
+            capacity = TSK_MAX(TSK_MAX(self->capacity << 1, pending + size), TSIP_TRANSPORT_FRAMER_MIN_CAPACITY);
+            if(self->start) {
+                memmove(self->data, self->data + self->start, pending);
+            }
+            if(!(newdata = tsk_realloc(self->data, capacity + 1/* always null-terminated, like tsk_buffer_t */))) {
+                TSK_DEBUG_ERROR("Failed to allocate buffer with size = %u", (unsigned)capacity);
+                tsip_transport_framer_reset(self);
+                return -2;
+            }
+            self->data = newdata;
+            self->capacity = capacity;
+        }
+        self->scan -= self->start;
+        self->end = pending;
+        self->start = 0;
+    }
+
+    if(size) {
+        memcpy(self->data + self->end, data, size);
+        self->end += size;
+        self->data[self->end] = '\0';
+    }
+    return 0;
+}
+
+/** Extracts the next complete SIP message.
+* @param self The framer.
+* @param message The extracted message or null if more data is needed.
+* @retval Zero if succeed and non-zero error code otherwise. On error, the pending data is dropped.
+*/
+int tsip_transport_framer_pop(tsip_transport_framer_t* self, tsip_message_t** message)
+{
+    if(!self || !message) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+
+    *message = tsk_null;
+
+    if(!self->message) {
+        const uint8_t *pstart, *pscan, *pend, *plf;
+        tsk_ragel_state_t state;
+
+        /* RFC 3261 - 7.5: Implementations processing SIP messages over stream-oriented transports MUST ignore any CRLF appearing before the start-line */
+        while(self->scan == self->start && self->start < self->end && (self->data[self->start] == '\r' || self->data[self->start] == '\n')) {
+            self->scan = ++self->start;
+        }
+
+        /* Resume the search for the end of the headers (2CRLF) */
+        pstart = self->data + self->start;
+        pscan = self->data + self->scan;
+        pend = self->data + self->end;
+        for(;;) {
+            if(!(plf = (const uint8_t*)memchr(pscan, '\n', (pend - pscan)))) {
+                self->scan = self->end;
+                goto bail;
+            }
+            pscan = plf + 1;
+            if((plf - pstart) >= 3 && plf[-1] == '\r' && plf[-2] == '\n' && plf[-3] == '\r') {
+                break;
+            }
+        }
+        self->scan = (pscan - self->data);
+
+        /* Parse the SIP headers only once, the content is added when complete */
+        tsk_ragel_state_init(&state, (const char*)pstart, (pscan - pstart));
+        if(tsip_message_parse_2(&state, &self->message, tsk_false/* do not extract the content */, TSIP_MESSAGE_LAZY_HEADERS) != tsk_true || !self->message) {
+            TSK_DEBUG_ERROR("Failed to parse pending stream....reset buffer");
+            tsip_transport_framer_reset(self);
+            return -2;
+        }
+        self->clen = TSIP_MESSAGE_CONTENT_LENGTH(self->message); /* MUST have content-length header (see RFC 3261 - 7.5). If no CL header then the macro return zero. */
+        self->start = self->scan;
+    }
+
+    if((self->end - self->start) < self->clen) {
+        goto bail; /* There is content but not all the content. */
+    }
+    if(self->clen) {
+        tsip_message_add_content(self->message, tsk_null, self->data + self->start, self->clen);
+        self->start += self->clen;
+        self->scan = self->start;
+    }
+    *message = self->message;
+    self->message = tsk_null;
+    self->clen = 0;
+
+bail:
+    if(self->start == self->end) {
+        self->start = self->end = self->scan = 0;
+    }
+    return 0;
+}
+
+/** Gets the number of bytes received but not consumed yet.
+*/
+tsk_size_t tsip_transport_framer_get_pending(const tsip_transport_framer_t* self)
+{
+    return self ? (self->end - self->start) : 0;
+}
+
+/** Drops the pending data.
+*/
+int tsip_transport_framer_reset(tsip_transport_framer_t* self)
+{
+    if(!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    TSK_OBJECT_SAFE_FREE(self->message);
+    self->clen = 0;
+    self->start = self->end = self->scan = 0;
+    return 0;
+}
+
+//========================================================
+//	SIP transport stream framer object definition
+//
+static tsk_object_t* tsip_transport_framer_ctor(tsk_object_t * self, va_list * app)
+{
+    return self;
+}
+static tsk_object_t* tsip_transport_framer_dtor(tsk_object_t * self)
+{
+    tsip_transport_framer_t *framer = self;
+    if(framer) {
+        TSK_OBJECT_SAFE_FREE(framer->message);
+        TSK_FREE(framer->data);
+    }
+    return self;
+}
+static const tsk_object_def_t tsip_transport_framer_def_s = {
+    sizeof(tsip_transport_framer_t),
+    tsip_transport_framer_ctor,
+    tsip_transport_framer_dtor,
+    tsk_null,
+};
+const tsk_object_def_t *tsip_transport_framer_def_t = &tsip_transport_framer_def_s;
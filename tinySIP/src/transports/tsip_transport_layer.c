@@ -130,10 +130,8 @@ int tsip_transport_layer_handle_incoming_msg(const tsip_transport_t *transport,
 /*== Non-blocking callback function (STREAM: TCP, TLS and SCTP) */
 static int tsip_transport_layer_stream_cb(const tnet_transport_event_t* e)
 {
-    int ret = -1;
-    tsk_ragel_state_t state;
+    int ret = 0;
     tsip_message_t *message = tsk_null;
-    int endOfheaders = -1;
     tsip_transport_t *transport = (tsip_transport_t *)e->callback_data;
     tsip_transport_stream_peer_t* peer;
 
@@ -225,12 +223,6 @@ static int tsip_transport_layer_stream_cb(const tnet_transport_event_t* e)
     	  messages are sent over stream-oriented transports.
     */
 
-    /* Check if buffer is too big to be valid (have we missed some chuncks?) */
-    if(TSK_BUFFER_SIZE(peer->rcv_buff_stream) >= TSIP_MAX_STREAM_CHUNCK_SIZE) {
-        TSK_DEBUG_ERROR("TCP Buffer is too big to be valid");
-        tsk_buffer_cleanup(peer->rcv_buff_stream);
-    }
-
     /* === SigComp === */
     if(TSIP_IS_SIGCOMP_DATA(e->data)) {
         char SigCompBuffer[TSIP_SIGCOMP_MAX_BUFF_SIZE];
@@ -250,7 +242,7 @@ static int tsip_transport_layer_stream_cb(const tnet_transport_event_t* e)
             }
             else {
                 // append result
-                tsk_buffer_append(peer->rcv_buff_stream, SigCompBuffer, data_size);
+                tsip_transport_framer_append(peer->rcv_framer, SigCompBuffer, data_size);
             }
         }
         else { /* Partial message? */
@@ -265,72 +257,37 @@ static int tsip_transport_layer_stream_cb(const tnet_transport_event_t* e)
             }
             else {
                 // append result
-                tsk_buffer_append(peer->rcv_buff_stream, SigCompBuffer, (next_size - data_size));
+                tsip_transport_framer_append(peer->rcv_framer, SigCompBuffer, (next_size - data_size));
                 data_size = next_size;
             }
         }
     }
     else {
         /* Append new content. */
-        tsk_buffer_append(peer->rcv_buff_stream, e->data, e->size);
+        tsip_transport_framer_append(peer->rcv_framer, e->data, e->size);
     }
 
-    /* Check if we have all SIP/WS headers. */
-parse_buffer:
-    if((endOfheaders = tsk_strindexOf(TSK_BUFFER_DATA(peer->rcv_buff_stream),TSK_BUFFER_SIZE(peer->rcv_buff_stream), "\r\n\r\n"/*2CRLF*/)) < 0) {
-        TSK_DEBUG_INFO("No all SIP headers in the TCP buffer.");
-        goto bail;
-    }
-
-    /* If we are there this mean that we have all SIP headers.
-    *	==> Parse the SIP message without the content.
+    /* Extract all the complete SIP messages: the framer resumes where the previous chunk stopped and
+    *	the headers of a message are only parsed once, whatever the number of chunks it arrived in.
     */
-    tsk_ragel_state_init(&state, TSK_BUFFER_DATA(peer->rcv_buff_stream), endOfheaders + 4/*2CRLF*/);
-    if(tsip_message_parse(&state, &message, tsk_false/* do not extract the content */) == tsk_true) {
-        tsk_size_t clen = TSIP_MESSAGE_CONTENT_LENGTH(message); /* MUST have content-length header (see RFC 3261 - 7.5). If no CL header then the macro return zero. */
-        if(clen == 0) { /* No content */
-            tsk_buffer_remove(peer->rcv_buff_stream, 0, (endOfheaders + 4/*2CRLF*/)); /* Remove SIP headers and CRLF */
-        }
-        else { /* There is a content */
-            if((endOfheaders + 4/*2CRLF*/ + clen) > TSK_BUFFER_SIZE(peer->rcv_buff_stream)) { /* There is content but not all the content. */
-                TSK_DEBUG_INFO("No all SIP content in the TCP buffer (clen=%u and %u > %u).", clen, (endOfheaders + 4/*2CRLF*/ + clen), TSK_BUFFER_SIZE(peer->rcv_buff_stream));
-                goto bail;
-            }
-            else {
-                /* Add the content to the message. */
-                tsip_message_add_content(message, tsk_null, TSK_BUFFER_TO_U8(peer->rcv_buff_stream) + endOfheaders + 4/*2CRLF*/, clen);
-                /* Remove SIP headers, CRLF and the content. */
-                tsk_buffer_remove(peer->rcv_buff_stream, 0, (endOfheaders + 4/*2CRLF*/ + clen));
-            }
+    while(tsip_transport_framer_pop(peer->rcv_framer, &message) == 0 && message) {
+        if(message->firstVia && message->Call_ID && message->CSeq && message->From && message->To) {
+            /* Signal we got at least one valid SIP message */
+            peer->got_valid_sip_msg = tsk_true;
+            /* Set fd */
+            message->local_fd = e->local_fd;
+            message->src_net_type = transport->type;
+            /* Alert transaction/dialog layer */
+            ret = tsip_transport_layer_handle_incoming_msg(transport, message);
         }
-    }
-    else {
-        TSK_DEBUG_ERROR("Failed to parse pending stream....reset buffer");
-        tsk_buffer_cleanup(peer->rcv_buff_stream);
-    }
-
-    if(message && message->firstVia && message->Call_ID && message->CSeq && message->From && message->To) {
-        /* Signal we got at least one valid SIP message */
-        peer->got_valid_sip_msg = tsk_true;
-        /* Set fd */
-        message->local_fd = e->local_fd;
-        message->src_net_type = transport->type;
-        /* Alert transaction/dialog layer */
-        ret = tsip_transport_layer_handle_incoming_msg(transport, message);
-        /* Parse next chunck */
-        if(TSK_BUFFER_SIZE(peer->rcv_buff_stream) >= TSIP_MIN_STREAM_CHUNCK_SIZE) {
-            /* message already passed to the dialog/transac layers */
-            TSK_OBJECT_SAFE_FREE(message);
-            goto parse_buffer;
+        else {
+            TSK_DEBUG_ERROR("Failed to parse SIP message");
+            ret = -15;
         }
-    }
-    else {
-        TSK_DEBUG_ERROR("Failed to parse SIP message");
-        ret = -15;
+        /* message already passed to the dialog/transac layers */
+        TSK_OBJECT_SAFE_FREE(message);
     }
 
-bail:
-    TSK_OBJECT_SAFE_FREE(message);
     TSK_OBJECT_SAFE_FREE(peer);
 
     return ret;
@@ -603,7 +560,7 @@ parse_buffer:
     //	==> Parse the SIP message without the content.
     TSK_DEBUG_INFO("Receiving SIP o/ WebSocket message: %.*s", pay_len, (const char*)peer->ws.rcv_buffer);
     tsk_ragel_state_init(&state, peer->ws.rcv_buffer, (tsk_size_t)pay_len);
-    if (tsip_message_parse(&state, &message, tsk_false/* do not extract the content */) == tsk_true) {
+    if (tsip_message_parse_2(&state, &message, tsk_false/* do not extract the content */, TSIP_MESSAGE_LAZY_HEADERS) == tsk_true) {
         const uint8_t* body_start = (const uint8_t*)state.eoh;
         int64_t clen = (pay_len - (int64_t)(body_start - ((const uint8_t*)peer->ws.rcv_buffer)));
         if (clen > 0) {
@@ -700,7 +657,7 @@ static int tsip_transport_layer_dgram_cb(const tnet_transport_event_t* e)
     }
 
     tsk_ragel_state_init(&state, data_ptr, data_size);
-    if(tsip_message_parse(&state, &message, tsk_true) == tsk_true
+    if(tsip_message_parse_2(&state, &message, tsk_true, TSIP_MESSAGE_LAZY_HEADERS) == tsk_true
             && message->firstVia &&  message->Call_ID && message->CSeq && message->From && message->To) {
         /* Set local fd used to receive the message and the address of the remote peer */
         message->local_fd = e->local_fd;
@@ -739,6 +696,29 @@ static int tsip_transport_layer_dgram_cb(const tnet_transport_event_t* e)
     return ret;
 }
 
+// With several workers (see TSIP_STACK_SET_TRANSPORT_WORKERS()) a stream connection is only known by the worker which accepted or created it
+static const tsip_transport_t* _tsip_transport_layer_find_stream_worker(const tsip_transport_layer_t* self, const tsip_transport_t* transport, const char* remote_ip, tnet_port_t remote_port)
+{
+    const tsk_list_item_t *item;
+    const tsip_transport_t* curr;
+    tsip_transport_stream_peer_t* peer;
+
+    if(!transport || self->stack->network.transport_workers < 2 || !TNET_SOCKET_TYPE_IS_STREAM(transport->type) || tsk_strnullORempty(remote_ip)) {
+        return transport;
+    }
+    tsk_list_foreach(item, self->transports) {
+        curr = (const tsip_transport_t*)item->data;
+        if(curr->idx != transport->idx || curr->type != transport->type) {
+            continue;
+        }
+        if((peer = tsip_transport_find_stream_peer_by_remote_ip(TSIP_TRANSPORT(curr), remote_ip, remote_port, curr->type))) {
+            TSK_OBJECT_SAFE_FREE(peer);
+            return curr;
+        }
+    }
+    return transport;
+}
+
 static const tsip_transport_t* tsip_transport_layer_find(const tsip_transport_layer_t* self, tsip_message_t *msg, char** destIP, int32_t *destPort)
 {
     const tsip_transport_t* transport = tsk_null;
@@ -892,6 +872,8 @@ clean_routes:
                 *destPort = 5060;
             }
         }
+
+        transport = _tsip_transport_layer_find_stream_worker(self, transport, *destIP, (tnet_port_t)*destPort);
     }
 
 
@@ -916,6 +898,7 @@ clean_routes:
         if(self->stack->network.mode == tsip_stack_mode_webrtc2sip) {
             if(TNET_SOCKET_TYPE_IS_WSS(msg->src_net_type) || TNET_SOCKET_TYPE_IS_WS(msg->src_net_type)) { // response over WS or WSS
                 transport = tsip_transport_layer_find_by_idx(self, tsip_transport_get_idx_by_name(msg->firstVia->transport));
+                transport = _tsip_transport_layer_find_stream_worker(self, transport, msg->firstVia->host, (tnet_port_t)msg->firstVia->port);
                 if(transport) {
                     tsk_strupdate(destIP, msg->firstVia->host);
                     *destPort = msg->firstVia->port;
@@ -930,6 +913,7 @@ clean_routes:
                 if(via_2nd && (via_ws_transport || via_ws_hacked)) {
                     int t_idx = tsip_transport_get_idx_by_name(via_ws_transport ? via_2nd->transport : TSIP_HEADER_GET_PARAM_VALUE(via_2nd, "ws-hacked"));
                     const tsip_transport_t* ws_transport = tsip_transport_layer_find_by_idx(self, t_idx);
+                    ws_transport = _tsip_transport_layer_find_stream_worker(self, ws_transport, via_2nd->host, (tnet_port_t)via_2nd->port);
                     if(ws_transport) {
                         tsip_transport_stream_peer_t* peer = tsip_transport_find_stream_peer_by_remote_ip(TSIP_TRANSPORT(ws_transport), via_2nd->host, via_2nd->port, ws_transport->type);
                         if(peer) {
@@ -1052,29 +1036,53 @@ bail:
 }
 
 int tsip_transport_layer_add(tsip_transport_layer_t* self, const char* local_host, tnet_port_t local_port, tnet_socket_type_t type, const char* description)
+{
+    return tsip_transport_layer_add_2(self, local_host, local_port, type, description, 1);
+}
+
+/* "workers": number of transports (each with its own network thread and event queue) sharing the same local address and port using SO_REUSEPORT.
+* Incoming messages from all workers go through the same transaction and dialog layers. */
+int tsip_transport_layer_add_2(tsip_transport_layer_t* self, const char* local_host, tnet_port_t local_port, tnet_socket_type_t type, const char* description, tsk_size_t workers)
 {
     // FIXME: CHECK IF already exist
     if(self && description) {
-        tsip_transport_t *transport =
-            (TNET_SOCKET_TYPE_IS_IPSEC(type) || self->stack->security.enable_secagree_ipsec) ?
-            (tsip_transport_t *)tsip_transport_ipsec_create((tsip_stack_t*)self->stack, local_host, local_port, type, description) /* IPSec is a special case. All other are ok. */
-            : tsip_transport_create((tsip_stack_t*)self->stack, local_host, local_port, type, description); /* UDP, SCTP, TCP, TLS, WS, WSS */
-
-        if(transport && transport->net_transport && self->stack) {
-            /* Set TLS certs */
-            if(TNET_SOCKET_TYPE_IS_TLS(type) || TNET_SOCKET_TYPE_IS_WSS(type) || TNET_SOCKET_TYPE_IS_DTLS(type) || self->stack->security.enable_secagree_tls) {
-                tsip_transport_tls_set_certs(transport, self->stack->security.tls.ca, self->stack->security.tls.pbk, self->stack->security.tls.pvk, self->stack->security.tls.verify);
+        tsk_size_t i;
+        tsk_bool_t is_ipsec = (TNET_SOCKET_TYPE_IS_IPSEC(type) || self->stack->security.enable_secagree_ipsec);
+        if(is_ipsec || TNET_SOCKET_TYPE_IS_SCTP(type) || (TNET_SOCKET_TYPE_IS_STREAM(type) && !TSIP_STACK_MODE_IS_SERVER(self->stack))) {
+            workers = 1; // a client connects to the Proxy-CSCF only once
+        }
+        workers = TSK_MAX(workers, 1);
+        for(i = 0; i < workers; ++i) {
+            tsip_transport_t *transport =
+                is_ipsec ?
+                (tsip_transport_t *)tsip_transport_ipsec_create((tsip_stack_t*)self->stack, local_host, local_port, type, description) /* IPSec is a special case. All other are ok. */
+                : tsip_transport_create_2((tsip_stack_t*)self->stack, local_host, local_port, type, (workers > 1), description); /* UDP, SCTP, TCP, TLS, WS, WSS */
+
+            if(transport && transport->net_transport && self->stack) {
+                /* Set TLS certs */
+                if(TNET_SOCKET_TYPE_IS_TLS(type) || TNET_SOCKET_TYPE_IS_WSS(type) || TNET_SOCKET_TYPE_IS_DTLS(type) || self->stack->security.enable_secagree_tls) {
+                    tsip_transport_tls_set_certs(transport, self->stack->security.tls.ca, self->stack->security.tls.pbk, self->stack->security.tls.pvk, self->stack->security.tls.verify);
+                }
+                /* Nat Traversal context */
+                if(self->stack->natt.ctx) {
+                    tnet_transport_set_natt_ctx(transport->net_transport, self->stack->natt.ctx);
+                }
+                /* next workers must bind to the same port (could be random) */
+                if(workers > 1) {
+                    tnet_ip_t ip;
+                    tnet_transport_get_ip_n_port_2(transport->net_transport, &ip, &local_port);
+                }
+                tsk_list_push_back_data(self->transports, (void**)&transport);
             }
-            /* Nat Traversal context */
-            if(self->stack->natt.ctx) {
-                tnet_transport_set_natt_ctx(transport->net_transport, self->stack->natt.ctx);
+            else {
+                TSK_OBJECT_SAFE_FREE(transport);
+                return -2;
             }
-            tsk_list_push_back_data(self->transports, (void**)&transport);
-            return 0;
         }
-        else {
-            return -2;
+        if(workers > 1) {
+            TSK_DEBUG_INFO("'%s' transport: %u workers listening on port %u", description, (unsigned)workers, (unsigned)local_port);
         }
+        return 0;
     }
     return -1;
 }
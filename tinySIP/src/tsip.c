@@ -27,6 +27,7 @@
 #include "tinysip/tsip_event.h"
 
 #include "tinysip/parsers/tsip_parser_uri.h"
+#include "tinysip/headers/tsip_header_Max_Forwards.h"
 
 #include "tinysip/transactions/tsip_transac_layer.h"
 #include "tinysip/dialogs/tsip_dialog_layer.h"
@@ -41,6 +42,7 @@
 #include "tnet.h"
 
 #include "tsk_memory.h"
+#include "tsk_object_cache.h"
 #include "tsk_debug.h"
 #include "tsk_time.h"
 
@@ -332,6 +334,11 @@ static int __tsip_stack_set(tsip_stack_t *self, va_list* app)
             self->network.mode = va_arg(*app, tsip_stack_mode_t);
             break;
         }
+        case tsip_pname_transport_workers: {
+            /* (unsigned)WORKERS_UINT */
+            self->network.transport_workers = TSK_MAX(va_arg(*app, unsigned), 1);
+            break;
+        }
 
 
 
@@ -525,6 +532,15 @@ tsip_stack_handle_t* tsip_stack_create(tsip_stack_callback_f callback, const cha
         goto bail;
     }
 
+    /* === headers present in every message: recycle their memory (no-op if already enabled) === */
+    tsk_object_cache_enable(tsip_header_Via_def_t, "tsip_header_Via_t", 0);
+    tsk_object_cache_enable(tsip_header_From_def_t, "tsip_header_From_t", 0);
+    tsk_object_cache_enable(tsip_header_To_def_t, "tsip_header_To_t", 0);
+    tsk_object_cache_enable(tsip_header_Call_ID_def_t, "tsip_header_Call_ID_t", 0);
+    tsk_object_cache_enable(tsip_header_CSeq_def_t, "tsip_header_CSeq_t", 0);
+    tsk_object_cache_enable(tsip_header_Content_Length_def_t, "tsip_header_Content_Length_t", 0);
+    tsk_object_cache_enable(tsip_header_Max_Forwards_def_t, "tsip_header_Max_Forwards_t", 0);
+
     /* === create the stack === */
     if(!(stack = tsk_object_new(tsip_stack_def_t))) { /* should never happen */
         TSK_DEBUG_ERROR("Failed to create the stack.");
@@ -555,6 +571,7 @@ tsip_stack_handle_t* tsip_stack_create(tsip_stack_callback_f callback, const cha
         stack->network.proxy_cscf_type[i] = tnet_socket_type_invalid;
     }
     stack->network.max_fds = tmedia_defaults_get_max_fds();
+    stack->network.transport_workers = 1;
 
     // all events should be delivered to the user before the stack stop
     tsk_runnable_set_important(TSK_RUNNABLE(stack), tsk_true);
@@ -794,7 +811,7 @@ int tsip_stack_start(tsip_stack_handle_t *self)
         if(!TNET_SOCKET_TYPE_IS_VALID(tx_values[t_idx])) {
             continue;
         }
-        if((ret = tsip_transport_layer_add(stack->layer_transport, stack->network.local_ip[t_idx], stack->network.local_port[t_idx], tx_values[t_idx], "SIP transport"))) {
+        if((ret = tsip_transport_layer_add_2(stack->layer_transport, stack->network.local_ip[t_idx], stack->network.local_port[t_idx], tx_values[t_idx], "SIP transport", stack->network.transport_workers))) {
             stack_error_desc = "Failed to add new transport";
             TSK_DEBUG_ERROR("%s", stack_error_desc);
             goto bail;
@@ -1122,20 +1139,19 @@ tsip_uri_t* tsip_stack_get_pcscf_uri(const tsip_stack_t *stack, tnet_socket_type
 
 static void* TSK_STDCALL run(void* self)
 {
-    tsk_list_item_t *curr;
+    tsip_event_t *sipevent;
     tsip_stack_t *stack = self;
 
     TSK_DEBUG_INFO("SIP STACK::run -- START");
 
     TSK_RUNNABLE_RUN_BEGIN(stack);
 
-    if((curr = TSK_RUNNABLE_POP_FIRST(stack))) {
-        tsip_event_t *sipevent = (tsip_event_t*)curr->data;
+    if((sipevent = (tsip_event_t*)tsk_runnable_pop(TSK_RUNNABLE(stack)))) {
         if(stack->callback) {
             sipevent->userdata = stack->userdata; // needed by sessionless events
             stack->callback(sipevent);
         }
-        tsk_object_unref(curr);
+        tsk_object_unref(sipevent);
     }
 
     TSK_RUNNABLE_RUN_END(self);
@@ -32,6 +32,7 @@
 
 #include "tinysip/headers/tsip_header_Allow.h"
 #include "tinysip/headers/tsip_header_Contact.h"
+#include "tinysip/headers/tsip_header_Lazy.h"
 #include "tinysip/headers/tsip_header_Max_Forwards.h"
 #include "tinysip/headers/tsip_header_Require.h"
 #include "tinysip/headers/tsip_header_Supported.h"
@@ -164,6 +165,59 @@ int tsip_message_add_content(tsip_message_t *self, const char* content_type, con
     return -1;
 }
 
+/* Replaces a lazy header by the parsed header(s). Only the representation of the message changes, this is why "self" is const.
+* Must be called with "lazy_mutex" locked: the same message is read by several layers (and threads). */
+static tsk_bool_t _tsip_message_parse_lazy_header(const tsip_message_t *self, tsk_list_item_t *item)
+{
+    tsip_headers_L_t* headers;
+    tsk_list_item_t *it, *next;
+
+    if(!(headers = tsip_header_Lazy_parse(item->data))) {
+        return tsk_false; // kept as is: skipped by the getters but still serialized
+    }
+    TSK_OBJECT_SAFE_FREE(item->data);
+    for(it = headers->head; it; it = it->next) {
+        if(!item->data) {
+            item->data = tsk_object_ref(it->data);
+        }
+        else if((next = tsk_list_item_create())) {
+            next->data = tsk_object_ref(it->data);
+            next->next = item->next;
+            item->next = next;
+            if(self->headers->tail == item) {
+                self->headers->tail = next;
+            }
+            item = next;
+        }
+    }
+    TSK_OBJECT_SAFE_FREE(headers);
+    return tsk_true;
+}
+
+/**@ingroup tsip_message_group
+* Parses the headers kept as slices of the raw message by @ref tsip_message_parse_2().
+* Only needed before iterating through "self->headers", the getters parse the headers on demand.
+* The headers which failed to parse are kept as is and never change afterwards.
+*/
+int tsip_message_parse_lazy_headers(const tsip_message_t *self)
+{
+    tsk_list_item_t *item;
+    if(!self) {
+        TSK_DEBUG_ERROR("Invalid parameter");
+        return -1;
+    }
+    if(self->lazy_mutex) {
+        tsk_mutex_lock(self->lazy_mutex);
+        tsk_list_foreach(item, self->headers) {
+            if(TSIP_HEADER_IS_LAZY(item->data)) {
+                _tsip_message_parse_lazy_header(self, item);
+            }
+        }
+        tsk_mutex_unlock(self->lazy_mutex);
+    }
+    return 0;
+}
+
 const tsip_header_t *tsip_message_get_headerAt(const tsip_message_t *self, tsip_header_type_t type, tsk_size_t index)
 {
     /* Do not forget to update tinyWRAP::SipMessage::getHeaderAt() */
@@ -258,7 +312,14 @@ const tsip_header_t *tsip_message_get_headerAt(const tsip_message_t *self, tsip_
             break;
         }
 
+        // the parsed headers are never replaced: still valid once unlocked
+        if(self->lazy_mutex) {
+            tsk_mutex_lock(self->lazy_mutex);
+        }
         tsk_list_foreach(item, self->headers) {
+            if(TSIP_HEADER_IS_LAZY(item->data) && (TSIP_HEADER(item->data)->type != type || !_tsip_message_parse_lazy_header(self, (tsk_list_item_t*)item))) {
+                continue;
+            }
             if(!__pred_find_header_by_type(item, &type)) {
                 if(pos++ >= index) {
                     hdr = item->data;
@@ -266,6 +327,9 @@ const tsip_header_t *tsip_message_get_headerAt(const tsip_message_t *self, tsip_
                 }
             }
         }
+        if(self->lazy_mutex) {
+            tsk_mutex_unlock(self->lazy_mutex);
+        }
     }
 
 bail:
@@ -422,9 +486,15 @@ int tsip_message_tostring(const tsip_message_t *self, tsk_buffer_t *output)
     /* All other headers */
     {
         tsk_list_item_t *item;
+        if(self->lazy_mutex) {
+            tsk_mutex_lock(self->lazy_mutex);
+        }
         tsk_list_foreach(item, self->headers) {
             tsip_header_serialize(TSIP_HEADER(item->data), output);
         }
+        if(self->lazy_mutex) {
+            tsk_mutex_unlock(self->lazy_mutex);
+        }
     }
 
     /* EMPTY LINE */
@@ -676,6 +746,9 @@ static tsk_object_t* tsip_message_dtor(tsk_object_t *self)
         TSK_OBJECT_SAFE_FREE(message->Content);
 
         TSK_OBJECT_SAFE_FREE(message->headers);
+        if(message->lazy_mutex) {
+            tsk_mutex_destroy(&message->lazy_mutex);
+        }
 
         TSK_FREE(message->sigcomp_id);
 
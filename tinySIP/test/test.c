@@ -22,6 +22,8 @@
 
 #include "stdafx.h"
 
+#include <assert.h>
+
 #include "tinysip.h"
 
 #include "test_sipmessages.h"
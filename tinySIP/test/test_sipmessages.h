@@ -22,6 +22,8 @@
 #ifndef _TEST_SIPMESSAGES_H
 #define _TEST_SIPMESSAGES_H
 
+#include "tinysip/transports/tsip_transport_framer.h"
+
 #define SIP_REQUEST \
 	"REGISTER sip:open-ims.test SIP/2.0\r\n" \
 	"Test-Header: 0\r\n" \
@@ -254,9 +256,304 @@ void test_responses()
     TSK_OBJECT_SAFE_FREE(response);
 }
 
+#define SIP_BENCH_LOOP 20000
+#define SIP_BENCH_THREADS 4
+
+static volatile long test_parser_bench_errors = 0;
+
+static void* TSK_STDCALL test_parser_bench_getters(void* arg)
+{
+    const tsip_message_t* message = (const tsip_message_t*)arg;
+    const tsip_header_Max_Forwards_t* header_mf = (const tsip_header_Max_Forwards_t*)tsip_message_get_header(message, tsip_htype_Max_Forwards);
+    const tsip_header_Allow_t* header_allow = (const tsip_header_Allow_t*)tsip_message_get_header(message, tsip_htype_Allow);
+    if(!header_mf || header_mf->value != 70 || !header_allow || tsk_list_count_all(header_allow->methods) != 10) {
+        tsk_atomic_inc(&test_parser_bench_errors);
+    }
+    return tsk_null;
+}
+
+static uint64_t test_parser_bench_loop(tsk_bool_t lazy_headers)
+{
+    static const char* corpus[] = { SIP_REQUEST, SIP_RESPONSE, SIP_MESSAGE, SIP_OPTIONS, SIP_COMPACT };
+    tsk_ragel_state_t state;
+    tsip_message_t *message;
+    uint64_t start = tsk_time_now();
+    tsk_size_t i, j;
+
+    for(i = 0; i < SIP_BENCH_LOOP; ++i) {
+        for(j = 0; j < sizeof(corpus)/sizeof(corpus[0]); ++j) {
+            message = tsk_null;
+            tsk_ragel_state_init(&state, corpus[j], tsk_strlen(corpus[j]));
+            tsip_message_parse_2(&state, &message, tsk_true, lazy_headers);
+            if(!message || !message->Call_ID || !message->CSeq || !message->firstVia) {
+                TSK_DEBUG_ERROR("Failed to parse message #%u", (unsigned)j);
+            }
+            TSK_OBJECT_SAFE_FREE(message);
+        }
+    }
+    return (tsk_time_now() - start);
+}
+
+void test_parser_bench()
+{
+    tsk_ragel_state_t state;
+    tsip_message_t *message = tsk_null;
+    tsk_buffer_t *buffer = tsk_buffer_create_null();
+    const tsip_header_Allow_t* header_allow;
+    const tsip_header_Max_Forwards_t* header_mf;
+    tsk_size_t count = SIP_BENCH_LOOP * 5;
+    uint64_t duration;
+    void* threads[SIP_BENCH_THREADS];
+    tsk_size_t i;
+    int ret;
+
+    /* Unparsed headers are serialized as received */
+    tsk_ragel_state_init(&state, SIP_MESSAGE, tsk_strlen(SIP_MESSAGE));
+    tsip_message_parse_2(&state, &message, tsk_true, tsk_true);
+    tsip_message_tostring(message, buffer);
+    if(!tsk_strcontains(TSK_BUFFER_TO_STRING(buffer), buffer->size, "\r\nAllow: INVITE, ACK, CANCEL, BYE, MESSAGE, OPTIONS, NOTIFY, PRACK, UPDATE, REFER\r\n")) {
+        TSK_DEBUG_ERROR("Unparsed Allow header not serialized as received");
+    }
+
+    /* Headers are materialized on first access */
+    header_mf = (const tsip_header_Max_Forwards_t*)tsip_message_get_header(message, tsip_htype_Max_Forwards);
+    if(!header_mf || header_mf->value != 70) {
+        TSK_DEBUG_ERROR("Max-Forwards header not parsed on first access");
+    }
+    header_allow = (const tsip_header_Allow_t*)tsip_message_get_header(message, tsip_htype_Allow);
+    if(!header_allow || tsk_list_count_all(header_allow->methods) != 10) {
+        TSK_DEBUG_ERROR("Allow header not parsed on first access");
+    }
+    TSK_OBJECT_SAFE_FREE(message);
+    TSK_OBJECT_SAFE_FREE(buffer);
+
+    tsk_ragel_state_init(&state, SIP_OPTIONS, tsk_strlen(SIP_OPTIONS));
+    tsip_message_parse_2(&state, &message, tsk_true, tsk_true);
+    if((ret = tsip_message_parse_lazy_headers(message)) != 0) {
+        TSK_DEBUG_ERROR("tsip_message_parse_lazy_headers() failed with error code = %d", ret);
+    }
+    if(!tsip_message_get_header(message, tsip_htype_Supported)) {
+        TSK_DEBUG_ERROR("Supported header not parsed");
+    }
+    TSK_OBJECT_SAFE_FREE(message);
+
+    /* The same message is read by several layers (and threads) */
+    tsk_ragel_state_init(&state, SIP_MESSAGE, tsk_strlen(SIP_MESSAGE));
+    tsip_message_parse_2(&state, &message, tsk_true, tsk_true);
+    test_parser_bench_errors = 0;
+    for(i = 0; i < SIP_BENCH_THREADS; ++i) {
+        tsk_thread_create(&threads[i], test_parser_bench_getters, message);
+    }
+    for(i = 0; i < SIP_BENCH_THREADS; ++i) {
+        tsk_thread_join(&threads[i]);
+    }
+    if(test_parser_bench_errors) {
+        TSK_DEBUG_ERROR("%ld threads failed to get the lazy headers", test_parser_bench_errors);
+    }
+    TSK_OBJECT_SAFE_FREE(message);
+
+    duration = test_parser_bench_loop(tsk_false);
+    TSK_DEBUG_INFO("eager: %u messages in %llu ms (%llu msg/s)", (unsigned)count, duration, duration ? (count * 1000) / duration : 0);
+    duration = test_parser_bench_loop(tsk_true);
+    TSK_DEBUG_INFO("lazy: %u messages in %llu ms (%llu msg/s)", (unsigned)count, duration, duration ? (count * 1000) / duration : 0);
+}
+
+#define SIP_FRAMER_LOOP 20
+#define SIP_FRAMER_SDP_CANDIDATES 60
+
+/* INVITE with a large SDP, as sent by WebRTC clients */
+static tsk_buffer_t* test_framer_invite()
+{
+    tsk_buffer_t *sdp = tsk_buffer_create_null(), *invite = tsk_buffer_create_null();
+    int i;
+
+    tsk_buffer_append_2(sdp, "v=0\r\no=- 3589548301 3589548301 IN IP4 192.168.0.12\r\ns=-\r\nc=IN IP4 192.168.0.12\r\nt=0 0\r\n"
+                        "m=audio 35318 RTP/SAVPF 111 0 8 101\r\na=rtpmap:111 opus/48000/2\r\na=rtpmap:101 telephone-event/8000\r\n");
+    for(i = 0; i < SIP_FRAMER_SDP_CANDIDATES; ++i) {
+        tsk_buffer_append_2(sdp, "a=candidate:%d 1 udp 2113937151 192.168.0.%d %d typ host generation 0\r\n", i, (i % 250) + 1, 35318 + (i << 1));
+    }
+    tsk_buffer_append_2(invite, "INVITE sip:alice@open-ims.test SIP/2.0\r\n"
+                        "Via: SIP/2.0/TCP 192.168.0.12:58827;branch=z9hG4bK1261611942868;rport\r\n"
+                        "From: <sip:bob@open-ims.test>;tag=29358\r\n"
+                        "To: <sip:alice@open-ims.test>\r\n"
+                        "Call-ID: M-fa53180346f7f55ceb8d8670f9223dbb\r\n"
+                        "CSeq: 1 INVITE\r\n"
+                        "Contact: <sip:bob@192.168.0.12:58827;transport=tcp>\r\n"
+                        "Max-Forwards: 70\r\n"
+                        "Allow: INVITE, ACK, CANCEL, BYE, MESSAGE, OPTIONS, NOTIFY, PRACK, UPDATE, REFER\r\n"
+                        "Supported: timer, 100rel, path\r\n"
+                        "Content-Type: application/sdp\r\n"
+                        "Content-Length: %u\r\n"
+                        "\r\n", (unsigned)sdp->size);
+    tsk_buffer_append(invite, sdp->data, sdp->size);
+    TSK_OBJECT_SAFE_FREE(sdp);
+    return invite;
+}
+
+/* Feeds the stream 'chunk' bytes at a time and returns the number of messages */
+static tsk_size_t test_framer_feed(tsip_transport_framer_t* framer, const uint8_t* data, tsk_size_t size, tsk_size_t chunk)
+{
+    tsip_message_t *message;
+    tsk_size_t i, count = 0;
+    int ret;
+
+    for(i = 0; i < size; i += chunk) {
+        if((ret = tsip_transport_framer_append(framer, &data[i], TSK_MIN(chunk, size - i))) != 0) {
+            TSK_DEBUG_ERROR("Failed to append %u bytes at offset %u (%d)", (unsigned)TSK_MIN(chunk, size - i), (unsigned)i, ret);
+            break;
+        }
+        while(tsip_transport_framer_pop(framer, &message) == 0 && message) {
+            if(!message->Call_ID || !message->CSeq || !message->firstVia) {
+                TSK_DEBUG_ERROR("Message #%u extracted without Call-ID, CSeq or Via", (unsigned)count);
+            }
+            else if(TSIP_MESSAGE_CONTENT_LENGTH(message) != TSIP_MESSAGE_CONTENT_DATA_LENGTH(message)) {
+                TSK_DEBUG_ERROR("Message #%u extracted with %u bytes of content instead of %u", (unsigned)count,
+                                (unsigned)TSIP_MESSAGE_CONTENT_DATA_LENGTH(message), (unsigned)TSIP_MESSAGE_CONTENT_LENGTH(message));
+            }
+            else {
+                ++count;
+            }
+            TSK_OBJECT_SAFE_FREE(message);
+        }
+    }
+    return count;
+}
+
+/* Previous implementation: the whole buffer is searched and parsed again on each chunk.
+* The buffer is kept null-terminated as tsk_strindexOf() and the URI parser rely on strstr(). */
+static void test_framer_legacy_terminate(tsk_buffer_t* buffer)
+{
+    tsk_buffer_append(buffer, "", 1);
+    buffer->size -= 1;
+}
+
+
+static tsk_size_t test_framer_feed_legacy(tsk_buffer_t* buffer, const uint8_t* data, tsk_size_t size)
+{
+    tsk_ragel_state_t state;
+    tsip_message_t *message;
+    tsk_size_t i, clen, count = 0;
+    int endOfheaders;
+
+    for(i = 0; i < size; ++i) {
+        tsk_buffer_append(buffer, &data[i], 1);
+        test_framer_legacy_terminate(buffer);
+        while((endOfheaders = tsk_strindexOf(TSK_BUFFER_DATA(buffer), TSK_BUFFER_SIZE(buffer), "\r\n\r\n")) >= 0) {
+            message = tsk_null;
+            tsk_ragel_state_init(&state, TSK_BUFFER_DATA(buffer), endOfheaders + 4);
+            if(tsip_message_parse_2(&state, &message, tsk_false, TSIP_MESSAGE_LAZY_HEADERS) != tsk_true) {
+                tsk_buffer_cleanup(buffer);
+                TSK_OBJECT_SAFE_FREE(message);
+                break;
+            }
+            clen = TSIP_MESSAGE_CONTENT_LENGTH(message);
+            if((endOfheaders + 4 + clen) > TSK_BUFFER_SIZE(buffer)) {
+                TSK_OBJECT_SAFE_FREE(message);
+                break;
+            }
+            tsip_message_add_content(message, tsk_null, TSK_BUFFER_TO_U8(buffer) + endOfheaders + 4, clen);
+            tsk_buffer_remove(buffer, 0, (endOfheaders + 4 + clen));
+            if(buffer->size) {
+                test_framer_legacy_terminate(buffer);
+            }
+            TSK_OBJECT_SAFE_FREE(message);
+            ++count;
+        }
+    }
+    return count;
+}
+
+void test_framer()
+{
+    static const char __keepalive[] = "\r\n\r\n";
+    static const char __invalid[] = "NOT A SIP MESSAGE\r\n\r\n";
+    tsip_transport_framer_t *framer = tsip_transport_framer_create();
+    tsk_buffer_t *invite = test_framer_invite(), *stream = tsk_buffer_create_null(), *legacy = tsk_buffer_create_null();
+    tsip_message_t *message = tsk_null;
+    uint64_t start, duration;
+    tsk_size_t i, count, clen;
+    int ret;
+
+    /* keep-alive, INVITE with SDP, response without content, MESSAGE with content and INVITE back-to-back */
+    tsk_buffer_append(stream, __keepalive, sizeof(__keepalive) - 1);
+    tsk_buffer_append(stream, invite->data, invite->size);
+    tsk_buffer_append(stream, SIP_OPTIONS, tsk_strlen(SIP_OPTIONS));
+    tsk_buffer_append(stream, __keepalive, sizeof(__keepalive) - 1);
+    tsk_buffer_append(stream, SIP_MESSAGE, tsk_strlen(SIP_MESSAGE));
+    tsk_buffer_append(stream, invite->data, invite->size);
+
+    /* whole stream, then chunks splitting the 2CRLF and the content at every position */
+    if((count = test_framer_feed(framer, stream->data, stream->size, stream->size)) != 4) {
+        TSK_DEBUG_ERROR("Whole stream: %u messages extracted instead of 4", (unsigned)count);
+    }
+    for(i = 1; i <= 7; ++i) {
+        if((count = test_framer_feed(framer, stream->data, stream->size, i)) != 4) {
+            TSK_DEBUG_ERROR("Chunks of %u bytes: %u messages extracted instead of 4", (unsigned)i, (unsigned)count);
+        }
+        if(tsip_transport_framer_get_pending(framer) != 0) {
+            TSK_DEBUG_ERROR("Chunks of %u bytes: %u bytes still pending", (unsigned)i, (unsigned)tsip_transport_framer_get_pending(framer));
+            tsip_transport_framer_reset(framer);
+        }
+    }
+
+    /* garbage drops the pending data and the next message is still extracted */
+    tsip_transport_framer_append(framer, __invalid, sizeof(__invalid) - 1);
+    if((ret = tsip_transport_framer_pop(framer, &message)) == 0 || message) {
+        TSK_DEBUG_ERROR("Garbage not rejected (%d)", ret);
+        TSK_OBJECT_SAFE_FREE(message);
+    }
+    if((count = test_framer_feed(framer, (const uint8_t*)SIP_OPTIONS, tsk_strlen(SIP_OPTIONS), 1)) != 1) {
+        TSK_DEBUG_ERROR("%u messages extracted after the garbage instead of 1", (unsigned)count);
+    }
+
+    /* the content is kept when the whole message is appended at once */
+    tsip_transport_framer_append(framer, invite->data, invite->size);
+    if((ret = tsip_transport_framer_pop(framer, &message)) != 0 || !message) {
+        TSK_DEBUG_ERROR("Failed to extract the INVITE (%d)", ret);
+    }
+    else {
+        clen = invite->size - (tsk_strindexOf(invite->data, invite->size, "\r\n\r\n") + 4);
+        if(TSIP_MESSAGE_CONTENT_DATA_LENGTH(message) != clen) {
+            TSK_DEBUG_ERROR("INVITE extracted with %u bytes of content instead of %u", (unsigned)TSIP_MESSAGE_CONTENT_DATA_LENGTH(message), (unsigned)clen);
+        }
+        else if(!tsk_strcontains((const char*)TSIP_MESSAGE_CONTENT_DATA(message), TSIP_MESSAGE_CONTENT_DATA_LENGTH(message), "typ host")) {
+            TSK_DEBUG_ERROR("INVITE extracted without the SDP candidates");
+        }
+    }
+    TSK_OBJECT_SAFE_FREE(message);
+
+    /* benchmark: INVITE received one byte at a time */
+    start = tsk_time_now();
+    for(i = 0, count = 0; i < SIP_FRAMER_LOOP; ++i) {
+        count += test_framer_feed_legacy(legacy, invite->data, invite->size);
+    }
+    duration = tsk_time_now() - start;
+    if(count != SIP_FRAMER_LOOP) {
+        TSK_DEBUG_ERROR("legacy: %u messages extracted instead of %u", (unsigned)count, (unsigned)SIP_FRAMER_LOOP);
+    }
+    TSK_DEBUG_INFO("legacy: %u x %u bytes in %llu ms", (unsigned)SIP_FRAMER_LOOP, (unsigned)invite->size, duration);
+
+    start = tsk_time_now();
+    for(i = 0, count = 0; i < SIP_FRAMER_LOOP; ++i) {
+        count += test_framer_feed(framer, invite->data, invite->size, 1);
+    }
+    duration = tsk_time_now() - start;
+    if(count != SIP_FRAMER_LOOP) {
+        TSK_DEBUG_ERROR("framer: %u messages extracted instead of %u", (unsigned)count, (unsigned)SIP_FRAMER_LOOP);
+    }
+    TSK_DEBUG_INFO("framer: %u x %u bytes in %llu ms", (unsigned)SIP_FRAMER_LOOP, (unsigned)invite->size, duration);
+
+    TSK_OBJECT_SAFE_FREE(framer);
+    TSK_OBJECT_SAFE_FREE(invite);
+    TSK_OBJECT_SAFE_FREE(stream);
+    TSK_OBJECT_SAFE_FREE(legacy);
+}
+
 void test_messages()
 {
     test_parser();
+    test_parser_bench();
+    test_framer();
     //test_requests();
     //test_responses();
 }
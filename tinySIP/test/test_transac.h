@@ -22,13 +22,145 @@
 #ifndef _TEST_TRANSAC_H
 #define _TEST_TRANSAC_H
 
-void test_transac()
+#include "tinysip/transactions/tsip_transac_layer.h"
+
+#define TEST_TRANSAC_COUNT 5000
+
+#define TEST_TRANSAC_MSG_FMT \
+"%s sip:open-ims.test SIP/2.0\r\n" \
+"Via: SIP/2.0/UDP 192.168.0.11:5060;branch=%s;rport\r\n" \
+"From: <sip:bob@open-ims.test>;tag=1234\r\n" \
+"To: <sip:bob@open-ims.test>\r\n" \
+"Call-ID: %s\r\n" \
+"CSeq: %d %s\r\n" \
+"Max-Forwards: 70\r\n" \
+"Content-Length: 0\r\n" \
+"\r\n"
+
+#define TEST_TRANSAC_RESP_FMT \
+"SIP/2.0 200 OK\r\n" \
+"Via: SIP/2.0/UDP 192.168.0.11:5060;branch=%s;rport\r\n" \
+"From: <sip:bob@open-ims.test>;tag=1234\r\n" \
+"To: <sip:bob@open-ims.test>;tag=5678\r\n" \
+"Call-ID: %s\r\n" \
+"CSeq: %d %s\r\n" \
+"Content-Length: 0\r\n" \
+"\r\n"
+
+static tsip_message_t* test_transac_msg(const char* fmt, ...)
+{
+    tsk_ragel_state_t state;
+    tsip_message_t *message = tsk_null;
+    char* str = tsk_null;
+    va_list ap;
+
+    va_start(ap, fmt);
+    tsk_sprintf_2(&str, fmt, &ap);
+    va_end(ap);
+
+    tsk_ragel_state_init(&state, str, tsk_strlen(str));
+    tsip_message_parse(&state, &message, tsk_true);
+    TSK_FREE(str);
+    return message;
+}
+
+/* Matching of requests and responses with many transactions: the lookup time must not grow with the number of transactions */
+static void test_transac_layer()
 {
-    //tsip_transac_nict_t transact;
+    tsk_timer_manager_handle_t *timer_mgr = tsk_timer_mgr_global_ref(); // used by the transactions
+    tsip_transac_layer_t *layer = tsip_transac_layer_create(tsk_null);
+    tsip_transac_dst_t *dst = tsip_transac_dst_net_create(tsk_null);
+    tsip_message_t **requests = tsk_calloc(TEST_TRANSAC_COUNT, sizeof(tsip_message_t*));
+    tsip_transac_t **transacs = tsk_calloc(TEST_TRANSAC_COUNT, sizeof(tsip_transac_t*));
+    tsip_transac_t *ist, *nict, *found;
+    tsip_message_t *msg;
+    char branch[64], callid[64];
+    uint64_t start, elapsed;
+    int i;
 
-    //tsip_transac_nict_init(&transact);
+    tsk_timer_mgr_global_start();
 
-    //tsk_thread_sleep(2000);
+    // NIST for each REGISTER
+    for(i = 0; i < TEST_TRANSAC_COUNT; ++i) {
+        sprintf(branch, "z9hG4bK-server-%d", i);
+        sprintf(callid, "callid-%d@open-ims.test", i);
+        requests[i] = test_transac_msg(TEST_TRANSAC_MSG_FMT, "REGISTER", branch, callid, i + 1, "REGISTER");
+        transacs[i] = tsip_transac_layer_new(layer, tsk_false, requests[i], dst);
+        tsk_object_unref(transacs[i]); // owned by the layer
+    }
+
+    // Retransmissions
+    start = tsk_time_now();
+    for(i = 0; i < TEST_TRANSAC_COUNT; ++i) {
+        found = tsip_transac_layer_find_server(layer, requests[i]);
+        assert(found == transacs[i]);
+        tsk_object_unref(found);
+    }
+    elapsed = (tsk_time_now() - start);
+    TSK_DEBUG_INFO("find_server: %d lookups with %d transactions in %llu millis", TEST_TRANSAC_COUNT, TEST_TRANSAC_COUNT, elapsed);
+
+    // IST: ACK matched by Call-ID and CSeq, CANCEL by branch only
+    msg = test_transac_msg(TEST_TRANSAC_MSG_FMT, "INVITE", "z9hG4bK-invite", "callid-invite@open-ims.test", 10, "INVITE");
+    ist = tsip_transac_layer_new(layer, tsk_false, msg, dst);
+    assert(ist && ist->type == tsip_transac_type_ist);
+    TSK_OBJECT_SAFE_FREE(msg);
+    msg = test_transac_msg(TEST_TRANSAC_MSG_FMT, "ACK", "z9hG4bK-ack", "callid-invite@open-ims.test", 10, "ACK");
+    found = tsip_transac_layer_find_server(layer, msg);
+    assert(found == ist);
+    tsk_object_unref(found);
+    TSK_OBJECT_SAFE_FREE(msg);
+    msg = test_transac_msg(TEST_TRANSAC_MSG_FMT, "ACK", "z9hG4bK-ack", "callid-invite@open-ims.test", 11, "ACK");
+    found = tsip_transac_layer_find_server(layer, msg);
+    assert(found == tsk_null);
+    TSK_OBJECT_SAFE_FREE(found);
+    TSK_OBJECT_SAFE_FREE(msg);
+    msg = test_transac_msg(TEST_TRANSAC_MSG_FMT, "CANCEL", "z9hG4bK-invite", "callid-invite@open-ims.test", 10, "CANCEL");
+    found = tsip_transac_layer_find_server(layer, msg);
+    assert(found == ist);
+    tsk_object_unref(found);
+    TSK_OBJECT_SAFE_FREE(msg);
+
+    // NICT: the branch is set when the request is sent
+    msg = test_transac_msg(TEST_TRANSAC_MSG_FMT, "MESSAGE", "z9hG4bK-unused", "callid-client@open-ims.test", 1, "MESSAGE");
+    nict = tsip_transac_layer_new(layer, tsk_true, msg, dst);
+    assert(nict && nict->type == tsip_transac_type_nict);
+    TSK_OBJECT_SAFE_FREE(msg);
+    tsip_transac_layer_set_branch(layer, nict, "z9hG4bK-client");
+    msg = test_transac_msg(TEST_TRANSAC_RESP_FMT, "z9hG4bK-client", "callid-client@open-ims.test", 1, "MESSAGE");
+    found = tsip_transac_layer_find_client(layer, msg);
+    assert(found == nict);
+    tsk_object_unref(found);
+    TSK_OBJECT_SAFE_FREE(msg);
+    msg = test_transac_msg(TEST_TRANSAC_RESP_FMT, "z9hG4bK-client", "callid-client@open-ims.test", 1, "INFO");
+    found = tsip_transac_layer_find_client(layer, msg);
+    assert(found == tsk_null);
+    TSK_OBJECT_SAFE_FREE(found);
+    TSK_OBJECT_SAFE_FREE(msg);
+
+    tsip_transac_layer_remove(layer, ist);
+    TSK_OBJECT_SAFE_FREE(ist);
+    tsip_transac_layer_remove(layer, nict);
+    TSK_OBJECT_SAFE_FREE(nict);
+
+    for(i = 0; i < TEST_TRANSAC_COUNT; ++i) {
+        tsip_transac_layer_remove(layer, transacs[i]);
+        found = tsip_transac_layer_find_server(layer, requests[i]);
+        assert(found == tsk_null);
+        TSK_OBJECT_SAFE_FREE(found);
+        TSK_OBJECT_SAFE_FREE(requests[i]);
+    }
+    assert(layer->index_branch.count == 0 && layer->index_callid.count == 0);
+
+    TSK_FREE(requests);
+    TSK_FREE(transacs);
+    TSK_OBJECT_SAFE_FREE(dst);
+    TSK_OBJECT_SAFE_FREE(layer);
+    tsk_timer_mgr_global_unref(&timer_mgr);
+}
+
+void test_transac()
+{
+    test_transac_layer();
 }
 
 #endif /* _TEST_TRANSAC_H */